@@ -50,6 +50,10 @@
 
 #include "yadifa.h"
 #include "yadifa-config.h"
+#include "yabench.h"
+#include "yabench-config.h"
+#include "yamicrobench.h"
+#include "yamicrobench-config.h"
 
 #if HAS_YAO
 #include "yao.h"
@@ -106,6 +110,22 @@ int (*generic_run)(void);
                                         generic_run=&command__ ## _run;}
 
 
+/* commands of yadifa that are programs of their own */
+
+struct yadifa_command_alias_s
+{
+    const char *command;
+    const char *program_name;
+};
+
+static const struct yadifa_command_alias_s yadifa_command_aliases[] =
+{
+    {"bench",      "yabench"     },
+    {"microbench", "yamicrobench"},
+    {NULL, NULL}
+};
+
+
 /*----------------------------------------------------------------------------*/
 #pragma mark FUNCTIONS
 
@@ -204,6 +224,23 @@ main(int argc, char *argv[])
     ya_result                                                   return_code;
 
     char                              *program_name = base_of_path(argv[0]);
+
+    /* "yadifa bench ..." is the same as "yabench ..." and "yadifa microbench ..." as "yamicrobench ..." */
+    if((argc > 1) && (strcmp(program_name, "yadifa") == 0))
+    {
+        for(const struct yadifa_command_alias_s *alias = yadifa_command_aliases; alias->command != NULL; ++alias)
+        {
+            if(strcmp(argv[1], alias->command) == 0)
+            {
+                program_name = (char*)alias->program_name;
+                argv[1] = argv[0];
+                ++argv;
+                --argc;
+                break;
+            }
+        }
+    }
+
     char                               *rc_file = get_rc_file(program_name);
 
 
@@ -226,6 +263,9 @@ main(int argc, char *argv[])
     GENERIC_COMMAND_BEGIN("yadifa",yadifa)
 #endif
 
+    GENERIC_COMMAND("yabench",yabench)
+    GENERIC_COMMAND("yamicrobench",yamicrobench)
+
 
 
 #if HAS_YAO
@@ -0,0 +1,384 @@
+/*------------------------------------------------------------------------------
+*
+* Copyright (c) 2011-2019, EURid vzw. All rights reserved.
+* The YADIFA TM software product is provided under the BSD 3-clause license:
+* 
+* Redistribution and use in source and binary forms, with or without 
+* modification, are permitted provided that the following conditions
+* are met:
+*
+*        * Redistributions of source code must retain the above copyright 
+*          notice, this list of conditions and the following disclaimer.
+*        * Redistributions in binary form must reproduce the above copyright 
+*          notice, this list of conditions and the following disclaimer in the 
+*          documentation and/or other materials provided with the distribution.
+*        * Neither the name of EURid nor the names of its contributors may be 
+*          used to endorse or promote products derived from this software 
+*          without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*------------------------------------------------------------------------------
+*
+*/
+
+/** @defgroup yabench
+ *  @ingroup yadifa
+ *  @brief load generator and latency benchmark
+ */
+
+#include <sys/stat.h>
+
+#include <dnscore/logger_handle.h>
+#include <dnscore/cmdline.h>
+#include <dnscore/config-cmdline.h>
+#include <dnscore/config_settings.h>
+
+// automatic created include file
+#include "client-config.h"
+
+#include "yadifa-config.h"
+#include "yabench-config.h"
+#include "common-config.h"
+
+/*----------------------------------------------------------------------------*/
+#pragma mark GLOBAL VARIABLES
+
+extern logger_handle *g_client_logger;
+#define MODULE_MSG_HANDLE g_client_logger
+
+static value_name_table yabench_mode_enum[] =
+{
+    {YABENCH_MODE_UDP,  "udp" },
+    {YABENCH_MODE_TCP,  "tcp" },
+    {YABENCH_MODE_AXFR, "axfr"},
+    {0, NULL}
+};
+
+/*----------------------------------------------------------------------------*/
+#pragma mark CONFIG
+
+#define CONFIG_TYPE config_yabench_settings_s
+CONFIG_BEGIN(config_yabench_desc)
+
+CONFIG_HOST_LIST_EX( server,        DEF_VAL_SERVER,       CONFIG_HOST_LIST_FLAGS_DEFAULT, 1        )
+CONFIG_FQDN(         origin,        "."                                                            )
+CONFIG_STRING(       query_file,    NULL                                                           )
+CONFIG_STRING(       tsig_key_name, NULL                                                           )
+CONFIG_STRING(       config_file,   NULL                                                           )
+CONFIG_ENUM(         mode,          "udp",                yabench_mode_enum                        )
+CONFIG_U32(          names,         "1000"                                                         )
+CONFIG_U32(          qps,           "0"                                                            ) // 0 = as fast as the in-flight limit allows
+CONFIG_U32(          duration,      "10"                                                           )
+CONFIG_U32(          threads,       "4"                                                            )
+CONFIG_U32(          sockets,       "4"                                                            )
+CONFIG_U32(          inflight,      "256"                                                          )
+CONFIG_U32(          timeout,       "2000"                                                         )
+CONFIG_DNS_TYPE(     qtype,         "A"                                                            )
+CONFIG_BOOL(         zipf,          "off"                                                          )
+
+CONFIG_END(config_yabench_desc)
+#undef CONFIG_TYPE
+
+config_yabench_settings_s g_yabench_settings;
+
+/*----------------------------------------------------------------------------*/
+#pragma mark COMMAND LINE
+
+CMDLINE_BEGIN(yabench_cmdline)
+
+CMDLINE_SECTION(  "yabench")
+CMDLINE_OPT(      "config",          'c', "config_file"                )
+CMDLINE_OPT(      "server",          's', "server"                     )
+CMDLINE_OPT(      "mode",            'm', "mode"                       )
+CMDLINE_OPT(      "file",            'f', "query_file"                 )
+CMDLINE_OPT(      "origin",          'o', "origin"                     )
+CMDLINE_OPT(      "names",           'n', "names"                      )
+CMDLINE_BOOL(     "zipf",            'z', "zipf"                       )
+CMDLINE_OPT(      "type",            't', "qtype"                      )
+CMDLINE_OPT(      "qps",             'Q', "qps"                        )
+CMDLINE_OPT(      "duration",        'd', "duration"                   )
+CMDLINE_OPT(      "threads",         'T', "threads"                    )
+CMDLINE_OPT(      "sockets",         'S', "sockets"                    )
+CMDLINE_OPT(      "inflight",        'i', "inflight"                   )
+CMDLINE_OPT(      "timeout",         'w', "timeout"                    )
+CMDLINE_OPT(      "key-name",        'K', "tsig_key_name"              )
+
+CMDLINE_VERSION_HELP(yabench_cmdline)
+
+CMDLINE_END(yabench_cmdline)
+
+/*----------------------------------------------------------------------------*/
+#pragma mark FUNCTIONS
+
+/** @brief  yabench_print_usage prints the help page
+ *
+ *  @param -- nothing --
+ *  @return -- nothing --
+ */
+void
+yabench_print_usage(void)
+{
+    println("\n"
+            "Usage: yabench [-c config] [-s server] [options]\n"
+            "       yadifa bench [-c config] [-s server] [options]\n\n"
+            "\toptions:\n"
+            "\t\t--config/-c <config_file>   : use <config_file> as configuration (for the TSIG keys)\n"
+            "\t\t--server/-s <host>          : <host> can be an ip address or\n"
+            "\t\t                            : an ip address with portnumber\n"
+            "\t\t                            : e.g. \"192.0.2.1 port 53\"\n"
+            "\t\t@<host>                     : <host> is the same as for [-s <host>]\n"
+            "\t\t--mode/-m <udp|tcp|axfr>    : the transport, or an AXFR storm of the origin\n"
+            "\t\t--file/-f <file>            : replays the queries of <file>, one \"name [type]\" per line\n"
+            "\t\t--origin/-o <fqdn>          : without a file, queries <n>.<fqdn> with n in [0;names[\n"
+            "\t\t--names/-n <count>          : the number of generated names\n"
+            "\t\t--zipf/-z                   : the generated names follow a Zipf distribution\n"
+            "\t\t                            : instead of an uniform one\n"
+            "\t\t--type/-t <type>            : the type of the generated queries\n"
+            "\t\t--qps/-Q <rate>             : the target rate, 0 for the highest one\n"
+            "\t\t--duration/-d <seconds>     : the duration of the run\n"
+            "\t\t--threads/-T <count>        : the number of threads (the concurrent transfers with axfr)\n"
+            "\t\t--sockets/-S <count>        : the number of sockets per thread\n"
+            "\t\t--inflight/-i <count>       : the maximum number of queries in flight per thread\n"
+            "\t\t--timeout/-w <ms>           : after this time, a query is counted as lost\n"
+            "\t\t--key-name/-K <keyname>     : signs the queries with the key <keyname>\n"
+            "\n"
+            "\t\t--version/-V                : view version\n"
+            "\t\t--help/-h                   : show this help text\n"
+            "\n"
+        );
+}
+
+/** @brief  yabench_config_finalise
+ *
+ *  @param -- nothing --
+ *  @return ya_result
+ */
+ya_result
+yabench_config_finalise()
+{
+    config_error_s                                                   cfgerr;
+    ya_result                                                   return_code;
+
+    /*    ------------------------------------------------------------    */
+
+    config_set_source(CONFIG_SOURCE_DEFAULT);
+
+    if(ISOK(return_code = config_set_default(&cfgerr)))
+    {
+        config_postprocess();
+    }
+    else
+    {
+        formatln("defaults: internal error: %s:%u : '%s': %r", cfgerr.file, cfgerr.line_number, cfgerr.line, return_code);
+    }
+
+    /* set all the server ports to the default value if they are 0 */
+    host_set_default_port_value(g_yabench_settings.server, htons(DEF_VAL_SERVER_PORT));
+
+    if(g_yabench_settings.threads == 0)
+    {
+        g_yabench_settings.threads = 1;
+    }
+
+    if(g_yabench_settings.sockets == 0)
+    {
+        g_yabench_settings.sockets = 1;
+    }
+
+    if(g_yabench_settings.inflight == 0)
+    {
+        g_yabench_settings.inflight = 1;
+    }
+
+    if(g_yabench_settings.names == 0)
+    {
+        g_yabench_settings.names = 1;
+    }
+
+    return return_code;
+}
+
+/** @brief  yabench_config_cmdline_callback
+*
+*  @param desc const struct cmdline_desc_s *
+*  @param arg_name const char *
+*  @param callback_owned void *
+*  @return ya_result
+*/
+static ya_result
+yabench_config_cmdline_callback(const struct cmdline_desc_s *desc, const char *arg_name, void *callback_owned)
+{
+    ya_result return_code;
+
+    if(strcmp(arg_name, "--") == 0)
+    {
+        return CMDLINE_ARG_STOP_PROCESSING_FLAG_OPTIONS;
+    }
+
+    if(arg_name[0] == '@')
+    {
+        config_section_descriptor_s *desc = config_section_get_descriptor("yabench");
+
+        if(desc != NULL)
+        {
+            if(ISOK(return_code = config_value_set(desc, "server", &arg_name[1])))
+            {
+                /* values >= MUST be 0 or CMDLINE_ARG_STOP_PROCESSING_FLAG_OPTIONS */
+                return_code = 0;
+            }
+        }
+        else
+        {
+            return_code = ERROR; // bug
+        }
+    }
+    else
+    {
+        osformatln(termerr, "unexpected parameter %s", arg_name);
+        return_code = ERROR;
+    }
+
+    return return_code;
+}
+
+/** @brief  yabench_config_cmdline
+ *
+ *  @param argc int
+ *  @param argv char **
+ *  @return ya_result
+ */
+ya_result
+yabench_config_cmdline(int argc, char **argv)
+{
+    input_stream                                                  config_is;
+    config_error_s                                                   cfgerr;
+    ya_result                                                   return_code;
+
+    /*    ------------------------------------------------------------    */
+
+    config_set_source(CONFIG_SOURCE_HIGHEST);
+
+    if(FAIL(return_code = cmdline_parse(yabench_cmdline, argc, argv, yabench_config_cmdline_callback, NULL, &config_is)))
+    {
+        return return_code;
+    }
+
+    config_set_source(CONFIG_SOURCE_CMDLINE);
+
+    if(FAIL(return_code = config_read_from_buffer((const char*)bytearray_input_stream_buffer(&config_is),
+                    bytearray_input_stream_size(&config_is),  "command-line",
+                    &cfgerr)))
+    {
+        formatln("%s: parsing error: %s:%u : '%s': %r", "cmdline", cfgerr.file, cfgerr.line_number, cfgerr.line, return_code);
+        flushout();
+
+        input_stream_close(&config_is);
+
+        return return_code;
+    }
+
+    input_stream_close(&config_is);
+    flushout();
+
+    return_code = 0;
+
+    /* check if cmd '--version' */
+    if(cmdline_version_get() > 0)
+    {
+        yadifa_print_version(cmdline_version_get());
+
+        return_code++;
+    }
+
+    /* check if cmd '--help' */
+    if(cmdline_help_get())
+    {
+        yabench_print_usage();
+        return_code++;
+    }
+
+    return return_code;
+}
+
+/** @brief yabench_config_init
+ *
+ *  @param -- nothing --
+ *  @return ya_result
+ */
+ya_result
+yabench_config_init()
+{
+    ya_result                                                   return_code;
+
+    /*    ------------------------------------------------------------    */
+
+    logger_handle_create("client", &g_client_logger);
+
+    if(FAIL(return_code = config_init()))
+    {
+        return return_code;
+    }
+
+    /* register command line options: version and help */
+    config_set_source(CONFIG_SOURCE_CMDLINE);
+
+    if(FAIL(return_code = config_register_cmdline(6)))
+    {
+        return return_code;
+    }
+
+    ZEROMEMORY(&g_yabench_settings, sizeof(g_yabench_settings));
+
+    if(FAIL(return_code = config_register_struct("yabench", config_yabench_desc, &g_yabench_settings, 5)))
+    {
+        return return_code;
+    }
+
+    if(FAIL(return_code = config_register_key("key", 7)))
+    {
+        return return_code;
+    }
+
+    return return_code;
+}
+
+char *
+yabench_config_file_get()
+{
+    struct stat fileinfo;
+
+    if((g_yabench_settings.config_file != NULL) && (strlen(g_yabench_settings.config_file) > 0))
+    {
+        if(stat(g_yabench_settings.config_file, &fileinfo) < 0)
+        {
+            formatln("error: %s has error: %lu", g_yabench_settings.config_file, ERRNO_ERROR);
+
+            return NULL;
+        }
+
+        /* Is it a regular file */
+        if(!S_ISREG(fileinfo.st_mode))
+        {
+            formatln("error: %s is not a regular file", g_yabench_settings.config_file);
+
+            return NULL;
+        }
+
+        return g_yabench_settings.config_file;
+    }
+
+    return NULL;
+}
+
+/*    ------------------------------------------------------------    */
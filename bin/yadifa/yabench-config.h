@@ -0,0 +1,81 @@
+/*------------------------------------------------------------------------------
+*
+* Copyright (c) 2011-2019, EURid vzw. All rights reserved.
+* The YADIFA TM software product is provided under the BSD 3-clause license:
+* 
+* Redistribution and use in source and binary forms, with or without 
+* modification, are permitted provided that the following conditions
+* are met:
+*
+*        * Redistributions of source code must retain the above copyright 
+*          notice, this list of conditions and the following disclaimer.
+*        * Redistributions in binary form must reproduce the above copyright 
+*          notice, this list of conditions and the following disclaimer in the 
+*          documentation and/or other materials provided with the distribution.
+*        * Neither the name of EURid nor the names of its contributors may be 
+*          used to endorse or promote products derived from this software 
+*          without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*------------------------------------------------------------------------------
+*
+*/
+#pragma once
+
+/** @defgroup yabench
+ *  @ingroup yadifa
+ *  @brief load generator and latency benchmark
+ */
+
+#include <dnscore/sys_error.h>
+#include <dnscore/host_address.h>
+
+#define YABENCH_MODE_UDP                                                  0
+#define YABENCH_MODE_TCP                                                  1
+#define YABENCH_MODE_AXFR                                                 2
+
+typedef struct config_yabench_settings_s config_yabench_settings_s;
+
+struct config_yabench_settings_s
+{
+    host_address                                                    *server;
+    u8                                                              *origin;
+    char                                                        *query_file;
+    char                                                     *tsig_key_name;
+    char                                                       *config_file;
+
+    u32                                                                mode;
+    u32                                                               names;
+    u32                                                                 qps;
+    u32                                                            duration; // seconds
+    u32                                                             threads;
+    u32                                                             sockets; // per thread
+    u32                                                            inflight; // per thread
+    u32                                                             timeout; // milliseconds
+
+    u16                                                               qtype;
+
+    bool                                                               zipf;
+};
+
+/*----------------------------------------------------------------------------*/
+#pragma mark PROTOTYPES
+
+ya_result yabench_config_init();
+ya_result yabench_config_cmdline(int argc, char **argv);
+ya_result yabench_config_finalise();
+char *yabench_config_file_get();
+void yabench_print_usage(void);
+
+/*    ------------------------------------------------------------    */
@@ -0,0 +1,1138 @@
+/*------------------------------------------------------------------------------
+*
+* Copyright (c) 2011-2019, EURid vzw. All rights reserved.
+* The YADIFA TM software product is provided under the BSD 3-clause license:
+* 
+* Redistribution and use in source and binary forms, with or without 
+* modification, are permitted provided that the following conditions
+* are met:
+*
+*        * Redistributions of source code must retain the above copyright 
+*          notice, this list of conditions and the following disclaimer.
+*        * Redistributions in binary form must reproduce the above copyright 
+*          notice, this list of conditions and the following disclaimer in the 
+*          documentation and/or other materials provided with the distribution.
+*        * Neither the name of EURid nor the names of its contributors may be 
+*          used to endorse or promote products derived from this software 
+*          without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*------------------------------------------------------------------------------
+*
+*/
+
+/** @defgroup yabench
+ *  @ingroup yadifa
+ *  @brief load generator and latency benchmark
+ *
+ *  Sends queries to a server at a target rate from several threads, each using several sockets,
+ *  and reports the latency percentiles, the rcode mix and the losses.
+ *
+ *  The queries are either replayed from a file or generated as <n>.<origin> with n following an
+ *  uniform or a Zipf distribution.  UDP, TCP (one query in flight per connection) and AXFR storms
+ *  (one transfer at a time per thread) are supported, optionally signed with TSIG.
+ */
+
+#define _GNU_SOURCE 1
+
+#define MODULE_MSG_HANDLE g_client_logger
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include <dnscore/logger.h>
+#include <dnscore/message.h>
+#include <dnscore/packet_reader.h>
+#include <dnscore/fdtools.h>
+#include <dnscore/random.h>
+#include <dnscore/timems.h>
+#include <dnscore/histogram.h>
+#include <dnscore/tsig.h>
+
+#include "yabench-config.h"
+#include "yabench.h"
+
+/*----------------------------------------------------------------------------*/
+#pragma mark GLOBAL VARIABLES
+
+extern logger_handle *g_client_logger;
+extern config_yabench_settings_s g_yabench_settings;
+
+#define YABENCH_QUERY_TAG  0x5952514843424159
+#define YABENCH_THREAD_TAG 0x5248544843424159
+
+#define YABENCH_SWEEP_PERIOD_US 100000
+
+struct yabench_query_s
+{
+    u8 *fqdn;
+    u16 qtype; // network order
+};
+
+typedef struct yabench_query_s yabench_query_s;
+
+struct yabench_thread_s
+{
+    pthread_t tid;
+    u32 index;
+
+    u64 sent;
+    u64 received;
+    u64 lost;
+    u64 errors;
+    u64 truncated;
+    u64 records;   // axfr
+    u64 bytes;     // axfr
+    u64 rcodes[16];
+
+    histogram_s latency; // us
+};
+
+typedef struct yabench_thread_s yabench_thread_s;
+
+static yabench_query_s *yabench_queries = NULL;
+static u32 yabench_queries_count = 0;
+static u32 *yabench_zipf_cumulative = NULL; // scaled to 2^32 - 1
+static volatile u64 yabench_replay_index = 0;
+static const tsig_item *yabench_tsig = NULL;
+static socketaddress yabench_server_sa;
+static socklen_t yabench_server_sa_len;
+static u64 yabench_start_us;
+static u64 yabench_deadline_us;
+
+/*----------------------------------------------------------------------------*/
+#pragma mark FUNCTIONS
+
+/**
+ * Loads the "name [type]" lines of the query file.
+ * Empty lines and lines starting with ';' or '#' are ignored.
+ */
+
+static ya_result
+yabench_queries_load(const char *file_name)
+{
+    FILE *f = fopen(file_name, "r");
+
+    if(f == NULL)
+    {
+        return ERRNO_ERROR;
+    }
+
+    u32 size = 1024;
+    u32 count = 0;
+    yabench_query_s *queries;
+    MALLOC_OR_DIE(yabench_query_s*, queries, sizeof(yabench_query_s) * size, YABENCH_QUERY_TAG);
+
+    char line[1024];
+    u32 line_number = 0;
+
+    while(fgets(line, sizeof(line), f) != NULL)
+    {
+        ++line_number;
+
+        char *saveptr = NULL;
+        char *name = strtok_r(line, " \t\r\n", &saveptr);
+
+        if((name == NULL) || (name[0] == ';') || (name[0] == '#'))
+        {
+            continue;
+        }
+
+        char *type_text = strtok_r(NULL, " \t\r\n", &saveptr);
+
+        u8 fqdn[MAX_DOMAIN_LENGTH];
+        u16 qtype = htons(g_yabench_settings.qtype);
+
+        if(FAIL(cstr_to_dnsname_with_check(fqdn, name)) || ((type_text != NULL) && FAIL(get_type_from_case_name(type_text, &qtype))))
+        {
+            osformatln(termerr, "%s:%u: cannot parse '%s %s'", file_name, line_number, name, (type_text != NULL)?type_text:"");
+            continue;
+        }
+
+        if(count == size)
+        {
+            size *= 2;
+            REALLOC_OR_DIE(yabench_query_s*, queries, sizeof(yabench_query_s) * size, YABENCH_QUERY_TAG);
+        }
+
+        queries[count].fqdn = dnsname_dup(fqdn);
+        queries[count].qtype = qtype;
+        ++count;
+    }
+
+    fclose(f);
+
+    if(count == 0)
+    {
+        free(queries);
+        return ERROR;
+    }
+
+    yabench_queries = queries;
+    yabench_queries_count = count;
+
+    return count;
+}
+
+/**
+ * Generates the <n>.<origin> names.
+ * With the Zipf distribution, the cumulated weights 1/(n+1) are scaled to 32 bits.
+ */
+
+static ya_result
+yabench_queries_generate(const u8 *origin, u32 names, u16 qtype, bool zipf)
+{
+    yabench_query_s *queries;
+    MALLOC_OR_DIE(yabench_query_s*, queries, sizeof(yabench_query_s) * names, YABENCH_QUERY_TAG);
+
+    u32 origin_len = dnsname_len(origin);
+
+    for(u32 i = 0; i < names; ++i)
+    {
+        u8 fqdn[MAX_DOMAIN_LENGTH];
+        char label[16];
+        int label_len = snprintf(label, sizeof(label), "%u", i);
+
+        if(label_len + 1 + origin_len > MAX_DOMAIN_LENGTH)
+        {
+            free(queries);
+            return DOMAIN_TOO_LONG;
+        }
+
+        fqdn[0] = (u8)label_len;
+        memcpy(&fqdn[1], label, label_len);
+        memcpy(&fqdn[1 + label_len], origin, origin_len);
+
+        queries[i].fqdn = dnsname_dup(fqdn);
+        queries[i].qtype = qtype;
+    }
+
+    if(zipf)
+    {
+        MALLOC_OR_DIE(u32*, yabench_zipf_cumulative, sizeof(u32) * names, YABENCH_QUERY_TAG);
+
+        double total = 0;
+
+        for(u32 i = 0; i < names; ++i)
+        {
+            total += 1.0 / (i + 1);
+        }
+
+        double sum = 0;
+
+        for(u32 i = 0; i < names; ++i)
+        {
+            sum += 1.0 / (i + 1);
+            yabench_zipf_cumulative[i] = (u32)((sum / total) * MAX_U32);
+        }
+
+        yabench_zipf_cumulative[names - 1] = MAX_U32;
+    }
+
+    yabench_queries = queries;
+    yabench_queries_count = names;
+
+    return names;
+}
+
+static void
+yabench_queries_finalize()
+{
+    for(u32 i = 0; i < yabench_queries_count; ++i)
+    {
+        free(yabench_queries[i].fqdn);
+    }
+
+    free(yabench_queries);
+    yabench_queries = NULL;
+    yabench_queries_count = 0;
+
+    free(yabench_zipf_cumulative);
+    yabench_zipf_cumulative = NULL;
+}
+
+/**
+ * Picks the next query: in order for a replayed file, randomly for generated names.
+ */
+
+static const yabench_query_s *
+yabench_query_next(random_ctx rnd)
+{
+    u32 index;
+
+    if(g_yabench_settings.query_file != NULL)
+    {
+        index = (u32)(__sync_fetch_and_add(&yabench_replay_index, 1) % yabench_queries_count);
+    }
+    else if(yabench_zipf_cumulative != NULL)
+    {
+        u32 r = random_next(rnd);
+        u32 lo = 0;
+        u32 hi = yabench_queries_count - 1;
+
+        while(lo < hi)
+        {
+            u32 mid = (lo + hi) >> 1;
+
+            if(yabench_zipf_cumulative[mid] < r)
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+
+        index = lo;
+    }
+    else
+    {
+        index = random_next(rnd) % yabench_queries_count;
+    }
+
+    return &yabench_queries[index];
+}
+
+/**
+ * Writes the query in mesg and signs it if a key was given.
+ * Returns SUCCESS, or the error code of the signature.
+ */
+
+static ya_result
+yabench_query_make(message_data *mesg, u16 id, const u8 *fqdn, u16 qtype)
+{
+    message_make_query(mesg, id, fqdn, qtype, CLASS_IN);
+
+#if DNSCORE_HAS_TSIG_SUPPORT
+    if(yabench_tsig != NULL)
+    {
+        ya_result return_code;
+
+        if(FAIL(return_code = message_sign_query(mesg, yabench_tsig)))
+        {
+            return return_code;
+        }
+    }
+#endif
+
+    return SUCCESS;
+}
+
+static inline void
+yabench_record_answer(yabench_thread_s *t, const u8 *answer, u64 latency_us)
+{
+    ++t->received;
+    ++t->rcodes[MESSAGE_RCODE(answer)];
+
+    if(MESSAGE_TC(answer) != 0)
+    {
+        ++t->truncated;
+    }
+
+    histogram_record(&t->latency, latency_us);
+}
+
+static int
+yabench_socket_open(int type)
+{
+    int fd = socket(yabench_server_sa.sa.sa_family, type, 0);
+
+    if(fd < 0)
+    {
+        return ERRNO_ERROR;
+    }
+
+    if(type == SOCK_STREAM)
+    {
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        struct timeval tv;
+        tv.tv_sec = g_yabench_settings.timeout / 1000;
+        tv.tv_usec = (g_yabench_settings.timeout % 1000) * 1000;
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    }
+
+    if(connect(fd, &yabench_server_sa.sa, yabench_server_sa_len) < 0)
+    {
+        int err = ERRNO_ERROR;
+        close_ex(fd);
+        return err;
+    }
+
+    if(type == SOCK_DGRAM)
+    {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    }
+
+    return fd;
+}
+
+/**
+ * Returns the time in us at which the thread should send its next query.
+ * The rate is shared evenly by the threads.
+ */
+
+static inline u64
+yabench_pacing_interval_ns()
+{
+    if(g_yabench_settings.qps == 0)
+    {
+        return 0;
+    }
+
+    return (1000000000ULL * g_yabench_settings.threads) / g_yabench_settings.qps;
+}
+
+/**
+ * UDP: each thread keeps up to "inflight" queries in flight over its sockets.
+ * The answers are matched with their query by id, the ids being unique per thread.
+ */
+
+static void*
+yabench_udp_thread(void *args)
+{
+    yabench_thread_s *t = (yabench_thread_s*)args;
+    u32 sockets = g_yabench_settings.sockets;
+    u32 inflight_max = MIN(g_yabench_settings.inflight, 32768);
+    u64 timeout_us = g_yabench_settings.timeout * 1000ULL;
+    u64 interval_ns = yabench_pacing_interval_ns();
+
+    random_ctx rnd = random_init_auto();
+    message_data *mesg;
+    MALLOC_OR_DIE(message_data*, mesg, sizeof(message_data), YABENCH_THREAD_TAG);
+    u64 *pending;
+    MALLOC_OR_DIE(u64*, pending, sizeof(u64) * 65536, YABENCH_THREAD_TAG);
+    ZEROMEMORY(pending, sizeof(u64) * 65536);
+    struct pollfd *pfd;
+    MALLOC_OR_DIE(struct pollfd*, pfd, sizeof(struct pollfd) * sockets, YABENCH_THREAD_TAG);
+
+    for(u32 i = 0; i < sockets; ++i)
+    {
+        int fd = yabench_socket_open(SOCK_DGRAM);
+
+        if(fd < 0)
+        {
+            osformatln(termerr, "udp socket: %r", fd);
+            pfd[i].fd = -1;
+            ++t->errors;
+        }
+        else
+        {
+            pfd[i].fd = fd;
+        }
+
+        pfd[i].events = POLLIN;
+        pfd[i].revents = 0;
+    }
+
+    u16 next_id = (u16)random_next(rnd);
+    u32 inflight = 0;
+    u32 socket_index = 0;
+    u64 next_send_ns = timeus() * 1000ULL;
+    u64 next_sweep = timeus() + YABENCH_SWEEP_PERIOD_US;
+    u64 stop_sending = yabench_deadline_us;
+    u64 stop = yabench_deadline_us + timeout_us; // lets the last answers come back
+
+    for(;;)
+    {
+        u64 now = timeus();
+
+        if((now >= stop) || ((now >= stop_sending) && (inflight == 0)))
+        {
+            break;
+        }
+
+        // send what is due
+
+        while((now < stop_sending) && (inflight < inflight_max) && ((interval_ns == 0) || (next_send_ns <= now * 1000ULL)))
+        {
+            const yabench_query_s *q = yabench_query_next(rnd);
+            int fd = pfd[socket_index].fd;
+
+            if(++socket_index == sockets)
+            {
+                socket_index = 0;
+            }
+
+            next_send_ns += interval_ns;
+
+            if(fd < 0)
+            {
+                continue;
+            }
+
+            if(FAIL(yabench_query_make(mesg, next_id++, q->fqdn, q->qtype)))
+            {
+                ++t->errors;
+                continue;
+            }
+
+            u16 id = MESSAGE_ID(mesg->buffer);
+
+            if(pending[id] != 0)
+            {
+                // the id wrapped on a query that never came back
+
+                ++t->lost;
+                --inflight;
+            }
+
+            if(send(fd, mesg->buffer, mesg->send_length, 0) < 0)
+            {
+                pending[id] = 0;
+                ++t->errors;
+                continue;
+            }
+
+            pending[id] = now;
+            ++inflight;
+            ++t->sent;
+        }
+
+        if((interval_ns > 0) && (next_send_ns + 1000000000ULL < now * 1000ULL))
+        {
+            // the target cannot be reached: do not try to catch up with a burst
+
+            next_send_ns = now * 1000ULL;
+        }
+
+        // wait for the answers until the next query is due
+
+        struct timespec ts;
+        u64 wait_ns = 1000000; // 1ms
+
+        if((interval_ns > 0) && (inflight < inflight_max) && (now < stop_sending))
+        {
+            u64 now_ns = now * 1000ULL;
+            wait_ns = (next_send_ns > now_ns)?MIN(next_send_ns - now_ns, wait_ns):0;
+        }
+
+        ts.tv_sec = 0;
+        ts.tv_nsec = wait_ns;
+
+        if(ppoll(pfd, sockets, &ts, NULL) > 0)
+        {
+            for(u32 i = 0; i < sockets; ++i)
+            {
+                if((pfd[i].revents & POLLIN) == 0)
+                {
+                    continue;
+                }
+
+                for(;;)
+                {
+                    ssize_t n = recv(pfd[i].fd, mesg->buffer, sizeof(mesg->buffer), 0);
+
+                    if(n < 0)
+                    {
+                        break;
+                    }
+
+                    if(n < DNS_HEADER_LENGTH)
+                    {
+                        ++t->errors;
+                        continue;
+                    }
+
+                    u16 id = MESSAGE_ID(mesg->buffer);
+
+                    if(pending[id] == 0)
+                    {
+                        continue; // late or unexpected
+                    }
+
+                    yabench_record_answer(t, mesg->buffer, timeus() - pending[id]);
+
+                    pending[id] = 0;
+                    --inflight;
+                }
+            }
+        }
+
+        // expire the queries that took too long
+
+        if(now >= next_sweep)
+        {
+            for(u32 id = 0; id < 65536; ++id)
+            {
+                if((pending[id] != 0) && (now - pending[id] > timeout_us))
+                {
+                    pending[id] = 0;
+                    ++t->lost;
+                    --inflight;
+                }
+            }
+
+            next_sweep = now + YABENCH_SWEEP_PERIOD_US;
+        }
+    }
+
+    t->lost += inflight;
+
+    for(u32 i = 0; i < sockets; ++i)
+    {
+        if(pfd[i].fd >= 0)
+        {
+            close_ex(pfd[i].fd);
+        }
+    }
+
+    free(pfd);
+    free(pending);
+    free(mesg);
+    random_finalize(rnd);
+
+    return NULL;
+}
+
+/**
+ * TCP: each thread keeps one query in flight per connection.
+ * A connection that fails or times out is counted as an error or a loss and re-opened.
+ */
+
+static void*
+yabench_tcp_thread(void *args)
+{
+    yabench_thread_s *t = (yabench_thread_s*)args;
+    u32 sockets = g_yabench_settings.sockets;
+    u64 timeout_us = g_yabench_settings.timeout * 1000ULL;
+    u64 interval_ns = yabench_pacing_interval_ns();
+
+    random_ctx rnd = random_init_auto();
+    message_data *mesg;
+    MALLOC_OR_DIE(message_data*, mesg, sizeof(message_data), YABENCH_THREAD_TAG);
+    struct pollfd *pfd;
+    MALLOC_OR_DIE(struct pollfd*, pfd, sizeof(struct pollfd) * sockets, YABENCH_THREAD_TAG);
+    u64 *pending;
+    MALLOC_OR_DIE(u64*, pending, sizeof(u64) * sockets, YABENCH_THREAD_TAG);
+
+    for(u32 i = 0; i < sockets; ++i)
+    {
+        pfd[i].fd = -1;
+        pfd[i].events = POLLIN;
+        pfd[i].revents = 0;
+        pending[i] = 0;
+    }
+
+    u16 next_id = (u16)random_next(rnd);
+    u64 next_send_ns = timeus() * 1000ULL;
+
+    for(;;)
+    {
+        u64 now = timeus();
+        bool busy = FALSE;
+
+        for(u32 i = 0; i < sockets; ++i)
+        {
+            if(pending[i] != 0)
+            {
+                if(now - pending[i] > timeout_us)
+                {
+                    close_ex(pfd[i].fd);
+                    pfd[i].fd = -1;
+                    pending[i] = 0;
+                    ++t->lost;
+                }
+                else
+                {
+                    busy = TRUE;
+                }
+            }
+        }
+
+        if((now >= yabench_deadline_us) && !busy)
+        {
+            break;
+        }
+
+        // send on the idle connections what is due
+
+        for(u32 i = 0; (i < sockets) && (now < yabench_deadline_us); ++i)
+        {
+            if(pending[i] != 0)
+            {
+                continue;
+            }
+
+            if((interval_ns > 0) && (next_send_ns > now * 1000ULL))
+            {
+                break;
+            }
+
+            if(pfd[i].fd < 0)
+            {
+                int fd = yabench_socket_open(SOCK_STREAM);
+
+                if(fd < 0)
+                {
+                    ++t->errors;
+                    continue;
+                }
+
+                pfd[i].fd = fd;
+            }
+
+            const yabench_query_s *q = yabench_query_next(rnd);
+
+            next_send_ns += interval_ns;
+
+            if(FAIL(yabench_query_make(mesg, next_id++, q->fqdn, q->qtype)))
+            {
+                ++t->errors;
+                continue;
+            }
+
+            message_update_tcp_length(mesg);
+
+            if(writefully(pfd[i].fd, mesg->buffer_tcp_len, mesg->send_length + 2) != mesg->send_length + 2)
+            {
+                close_ex(pfd[i].fd);
+                pfd[i].fd = -1;
+                ++t->errors;
+                continue;
+            }
+
+            pending[i] = now;
+            ++t->sent;
+        }
+
+        if((interval_ns > 0) && (next_send_ns + 1000000000ULL < now * 1000ULL))
+        {
+            next_send_ns = now * 1000ULL;
+        }
+
+        // wait for the answers
+
+        for(u32 i = 0; i < sockets; ++i)
+        {
+            pfd[i].events = (pending[i] != 0)?POLLIN:0;
+            pfd[i].revents = 0;
+        }
+
+        struct timespec ts;
+        ts.tv_sec = 0;
+        ts.tv_nsec = 1000000; // 1ms
+
+        if(ppoll(pfd, sockets, &ts, NULL) > 0)
+        {
+            for(u32 i = 0; i < sockets; ++i)
+            {
+                if((pfd[i].revents & (POLLIN|POLLHUP|POLLERR)) == 0)
+                {
+                    continue;
+                }
+
+                u16 len;
+
+                if((readfully(pfd[i].fd, &len, 2) == 2) &&
+                   ((len = ntohs(len)) >= DNS_HEADER_LENGTH) &&
+                   (readfully(pfd[i].fd, mesg->buffer, len) == len))
+                {
+                    yabench_record_answer(t, mesg->buffer, timeus() - pending[i]);
+                }
+                else
+                {
+                    close_ex(pfd[i].fd);
+                    pfd[i].fd = -1;
+                    ++t->errors;
+                }
+
+                pending[i] = 0;
+            }
+        }
+    }
+
+    for(u32 i = 0; i < sockets; ++i)
+    {
+        if(pfd[i].fd >= 0)
+        {
+            close_ex(pfd[i].fd);
+        }
+    }
+
+    free(pending);
+    free(pfd);
+    free(mesg);
+    random_finalize(rnd);
+
+    return NULL;
+}
+
+/**
+ * Reads one AXFR transfer to its end (the second SOA).
+ * Returns the number of records or an error code.
+ */
+
+static ya_result
+yabench_axfr_read(int fd, message_data *mesg, u64 *bytesp)
+{
+    u32 records = 0;
+    u32 soa_count = 0;
+    u64 bytes = 0;
+
+    for(;;)
+    {
+        u16 len;
+
+        if(readfully(fd, &len, 2) != 2)
+        {
+            return ERRNO_ERROR;
+        }
+
+        len = ntohs(len);
+
+        if((len < DNS_HEADER_LENGTH) || (readfully(fd, mesg->buffer, len) != len))
+        {
+            return UNEXPECTED_EOF;
+        }
+
+        bytes += len + 2;
+
+        if(MESSAGE_RCODE(mesg->buffer) != RCODE_NOERROR)
+        {
+            return MAKE_DNSMSG_ERROR(MESSAGE_RCODE(mesg->buffer));
+        }
+
+        packet_unpack_reader_data pr;
+        packet_reader_init(&pr, mesg->buffer, len);
+        pr.offset = DNS_HEADER_LENGTH;
+
+        for(u16 qd = ntohs(MESSAGE_QD(mesg->buffer)); qd > 0; --qd)
+        {
+            if(FAIL(packet_reader_skip_fqdn(&pr)) || FAIL(packet_reader_skip(&pr, 4)))
+            {
+                return INVALID_MESSAGE;
+            }
+        }
+
+        for(u16 an = ntohs(MESSAGE_AN(mesg->buffer)); an > 0; --an)
+        {
+            u16 rtype;
+            u16 rdata_size;
+
+            if(FAIL(packet_reader_skip_fqdn(&pr)) ||
+               FAIL(packet_reader_read_u16(&pr, &rtype)) ||
+               FAIL(packet_reader_skip(&pr, 6)) ||
+               FAIL(packet_reader_read_u16(&pr, &rdata_size)) ||
+               FAIL(packet_reader_skip(&pr, ntohs(rdata_size))))
+            {
+                return INVALID_MESSAGE;
+            }
+
+            ++records;
+
+            if((rtype == TYPE_SOA) && (++soa_count == 2))
+            {
+                *bytesp += bytes;
+
+                return records;
+            }
+        }
+    }
+}
+
+/**
+ * AXFR storm: each thread transfers the origin (or the names of the query file) repeatedly,
+ * on a new connection each time.  The latency is the duration of the whole transfer.
+ */
+
+static void*
+yabench_axfr_thread(void *args)
+{
+    yabench_thread_s *t = (yabench_thread_s*)args;
+    u64 interval_ns = yabench_pacing_interval_ns();
+
+    random_ctx rnd = random_init_auto();
+    message_data *mesg;
+    MALLOC_OR_DIE(message_data*, mesg, sizeof(message_data), YABENCH_THREAD_TAG);
+
+    u64 next_send_ns = timeus() * 1000ULL;
+
+    for(;;)
+    {
+        u64 now = timeus();
+
+        if(now >= yabench_deadline_us)
+        {
+            break;
+        }
+
+        if(interval_ns > 0)
+        {
+            u64 now_ns = now * 1000ULL;
+
+            if(next_send_ns > now_ns)
+            {
+                usleep((next_send_ns - now_ns) / 1000);
+                continue;
+            }
+
+            next_send_ns += interval_ns;
+
+            if(next_send_ns + 1000000000ULL < now_ns)
+            {
+                next_send_ns = now_ns;
+            }
+        }
+
+        const u8 *fqdn = (g_yabench_settings.query_file != NULL)?yabench_query_next(rnd)->fqdn:g_yabench_settings.origin;
+
+        if(FAIL(yabench_query_make(mesg, (u16)random_next(rnd), fqdn, TYPE_AXFR)))
+        {
+            ++t->errors;
+            usleep(1000);
+            continue;
+        }
+
+        message_update_tcp_length(mesg);
+
+        int fd = yabench_socket_open(SOCK_STREAM);
+
+        if(fd < 0)
+        {
+            ++t->errors;
+            usleep(1000);
+            continue;
+        }
+
+        now = timeus();
+
+        if(writefully(fd, mesg->buffer_tcp_len, mesg->send_length + 2) != mesg->send_length + 2)
+        {
+            close_ex(fd);
+            ++t->errors;
+            continue;
+        }
+
+        ++t->sent;
+
+        ya_result return_code = yabench_axfr_read(fd, mesg, &t->bytes);
+
+        close_ex(fd);
+
+        if(ISOK(return_code))
+        {
+            t->records += return_code;
+            yabench_record_answer(t, mesg->buffer, timeus() - now);
+        }
+        else if(return_code == MAKE_ERRNO_ERROR(EAGAIN))
+        {
+            ++t->lost;
+        }
+        else if((return_code & 0xffff0000) == DNSMSG_ERROR_BASE)
+        {
+            ++t->received;
+            ++t->rcodes[return_code & 15];
+        }
+        else
+        {
+            ++t->errors;
+        }
+    }
+
+    free(mesg);
+    random_finalize(rnd);
+
+    return NULL;
+}
+
+static void
+yabench_print_report(yabench_thread_s *threads, u32 threads_count, u64 elapsed_us)
+{
+    yabench_thread_s total;
+    ZEROMEMORY(&total, sizeof(total));
+    histogram_init(&total.latency);
+
+    for(u32 i = 0; i < threads_count; ++i)
+    {
+        yabench_thread_s *t = &threads[i];
+        total.sent += t->sent;
+        total.received += t->received;
+        total.lost += t->lost;
+        total.errors += t->errors;
+        total.truncated += t->truncated;
+        total.records += t->records;
+        total.bytes += t->bytes;
+
+        for(u32 j = 0; j < 16; ++j)
+        {
+            total.rcodes[j] += t->rcodes[j];
+        }
+
+        histogram_merge(&total.latency, &t->latency);
+    }
+
+    double seconds = elapsed_us / 1000000.0;
+    double loss = (total.sent > 0)?(100.0 * total.lost) / total.sent:0.0;
+
+    osformatln(termout, "duration:   %.3fs", seconds);
+    osformatln(termout, "sent:       %llu (%.1f/s)", total.sent, total.sent / seconds);
+    osformatln(termout, "received:   %llu (%.1f/s)", total.received, total.received / seconds);
+    osformatln(termout, "lost:       %llu (%.3f%%)", total.lost, loss);
+    osformatln(termout, "errors:     %llu", total.errors);
+
+    if(g_yabench_settings.mode == YABENCH_MODE_AXFR)
+    {
+        osformatln(termout, "records:    %llu (%.1f/s)", total.records, total.records / seconds);
+        osformatln(termout, "bytes:      %llu (%.1f/s)", total.bytes, total.bytes / seconds);
+    }
+    else
+    {
+        osformatln(termout, "truncated:  %llu", total.truncated);
+    }
+
+    osformatln(termout, "latency us: min=%llu mean=%llu p50=%llu p90=%llu p99=%llu p999=%llu max=%llu",
+            total.latency.min,
+            histogram_mean(&total.latency),
+            histogram_value_at_percentile(&total.latency, 50.0),
+            histogram_value_at_percentile(&total.latency, 90.0),
+            histogram_value_at_percentile(&total.latency, 99.0),
+            histogram_value_at_percentile(&total.latency, 99.9),
+            total.latency.max);
+
+    for(u32 j = 0; j < 16; ++j)
+    {
+        if(total.rcodes[j] > 0)
+        {
+            osformatln(termout, "rcode %9s %llu (%.2f%%)", get_rcode(j), total.rcodes[j], (100.0 * total.rcodes[j]) / total.received);
+        }
+    }
+
+    flushout();
+}
+
+/** @brief yabench_run
+ *
+ *  @param none
+ *  @return ya_result
+ */
+ya_result
+yabench_run()
+{
+    ya_result return_code;
+
+    if(FAIL(return_code = host_address2sockaddr(&yabench_server_sa, g_yabench_settings.server)))
+    {
+        osformatln(termerr, "bad server address: %r", return_code);
+        return return_code;
+    }
+
+    yabench_server_sa_len = (yabench_server_sa.sa.sa_family == AF_INET)?sizeof(struct sockaddr_in):sizeof(struct sockaddr_in6);
+
+#if DNSCORE_HAS_TSIG_SUPPORT
+    if(g_yabench_settings.tsig_key_name != NULL)
+    {
+        u8 key_name[MAX_DOMAIN_LENGTH];
+
+        if(FAIL(return_code = cstr_to_dnsname_with_check(key_name, g_yabench_settings.tsig_key_name)))
+        {
+            osformatln(termerr, "bad key name '%s': %r", g_yabench_settings.tsig_key_name, return_code);
+            return return_code;
+        }
+
+        if((yabench_tsig = tsig_get(key_name)) == NULL)
+        {
+            osformatln(termerr, "unknown key '%s'", g_yabench_settings.tsig_key_name);
+            return TSIG_BADKEY;
+        }
+    }
+#endif
+
+    if(g_yabench_settings.query_file != NULL)
+    {
+        return_code = yabench_queries_load(g_yabench_settings.query_file);
+
+        if(FAIL(return_code))
+        {
+            osformatln(termerr, "cannot load queries from '%s': %r", g_yabench_settings.query_file, return_code);
+            return return_code;
+        }
+    }
+    else if(g_yabench_settings.mode != YABENCH_MODE_AXFR)
+    {
+        if(FAIL(return_code = yabench_queries_generate(g_yabench_settings.origin, g_yabench_settings.names, htons(g_yabench_settings.qtype), g_yabench_settings.zipf)))
+        {
+            osformatln(termerr, "cannot generate the names: %r", return_code);
+            return return_code;
+        }
+    }
+
+    void *(*thread_function)(void*);
+
+    switch(g_yabench_settings.mode)
+    {
+        case YABENCH_MODE_TCP:
+            thread_function = yabench_tcp_thread;
+            break;
+        case YABENCH_MODE_AXFR:
+            thread_function = yabench_axfr_thread;
+            break;
+        default:
+            thread_function = yabench_udp_thread;
+            break;
+    }
+
+    u32 threads_count = g_yabench_settings.threads;
+    yabench_thread_s *threads;
+    MALLOC_OR_DIE(yabench_thread_s*, threads, sizeof(yabench_thread_s) * threads_count, YABENCH_THREAD_TAG);
+    ZEROMEMORY(threads, sizeof(yabench_thread_s) * threads_count);
+
+    osformatln(termout, "benchmarking %{hostaddr} for %us with %u threads", g_yabench_settings.server, g_yabench_settings.duration, threads_count);
+    flushout();
+
+    yabench_start_us = timeus();
+    yabench_deadline_us = yabench_start_us + g_yabench_settings.duration * 1000000ULL;
+
+    u32 started = 0;
+
+    for(u32 i = 0; i < threads_count; ++i)
+    {
+        threads[i].index = i;
+        histogram_init(&threads[i].latency);
+
+        int err;
+
+        if((err = pthread_create(&threads[i].tid, NULL, thread_function, &threads[i])) != 0)
+        {
+            osformatln(termerr, "cannot start thread: %r", MAKE_ERRNO_ERROR(err));
+            break;
+        }
+
+        ++started;
+    }
+
+    for(u32 i = 0; i < started; ++i)
+    {
+        pthread_join(threads[i].tid, NULL);
+    }
+
+    u64 elapsed_us = MIN(timeus(), yabench_deadline_us) - yabench_start_us;
+
+    yabench_print_report(threads, started, MAX(elapsed_us, 1));
+
+    free(threads);
+    yabench_queries_finalize();
+
+    return SUCCESS;
+}
+
+/*    ------------------------------------------------------------    */
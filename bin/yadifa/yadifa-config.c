@@ -179,6 +179,8 @@ const ctrl_type_table ctrl_type[] = {
 
     { TYPE_CTRL_ZONERELOAD,       TYPE_CTRL_ZONERELOAD_NAME       },
     { TYPE_CTRL_ZONEUNFREEZE,     TYPE_CTRL_ZONEUNFREEZE_NAME     },
+    { TYPE_CTRL_SRVSTATS,         TYPE_CTRL_SRVSTATS_NAME         },
+    { TYPE_CTRL_SRVLOCKS,         TYPE_CTRL_SRVLOCKS_NAME         },
 
 #endif
     { 0,                          NULL                            }
@@ -208,6 +210,8 @@ static command_translation_table yadifa_commands_translation_table[] =
     { "freeze",        "qtype", NULL,                             TYPE_CTRL_ZONEFREEZE_NAME,    "qname"  },
     { "unfreeze",      "qtype", NULL,                             TYPE_CTRL_ZONEUNFREEZE_NAME,  "qname"  },
     { "shutdown",      "qtype", TYPE_CTRL_SHUTDOWN_NAME,          NULL,                         NULL     },
+    { "stats",         "qtype", TYPE_CTRL_SRVSTATS_NAME,          NULL,                         NULL     },
+    { "locks",         "qtype", TYPE_CTRL_SRVLOCKS_NAME,          NULL,                         NULL     },
 
     {NULL, NULL, NULL, NULL, NULL}
 };
@@ -337,6 +341,8 @@ yadifa_print_usage(void)
             "\t\tloglevel <level>            : sets up the maximum level of log [0;15], 6 = INFO, 15 = NULL\n"
             "\t\tlogreopen                   : closes and reopens all log files\n"
             "\t\tshutdown                    : shuts down the server\n"
+            "\t\tstats                       : prints the query statistics of the server as JSON\n"
+            "\t\tlocks                       : prints the worst zone lock waits and holds of the server as JSON\n"
 
             "\n"
             "\tnote:\n"
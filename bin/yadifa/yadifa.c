@@ -47,6 +47,9 @@
 #include <dnscore/message.h>
 #include <dnscore/tcp_io_stream.h>
 #include <dnscore/ctrl-rfc.h>
+#include <dnscore/packet_reader.h>
+#include <dnscore/packet_writer.h>
+#include <dnscore/bytearray_output_stream.h>
 
 #include <dnslg/dns.h>
 
@@ -115,6 +118,206 @@ time_now(struct timeval *tv)
 
 
 
+/** @brief yadifa_json_page_read reads the part of the JSON object answered to the stats and locks commands
+ *
+ *  The answer starts with a paging record (snapshot id, page, page count) followed by TXT records.
+ *  The object is split in the character-strings of the TXT records.
+ *
+ *  @param mesg the answer
+ *  @param qtype the command
+ *  @param os receives the JSON
+ *  @param paging receives the snapshot id, the page and the page count
+ *  @retrun OK or an error code
+ */
+static ya_result
+yadifa_json_page_read(message_data *mesg, u16 qtype, output_stream *os, u32 *paging)
+{
+    packet_unpack_reader_data pr;
+    struct type_class_ttl_rdlen tctr;
+    ya_result return_code;
+    u16 an = ntohs(MESSAGE_AN(mesg->buffer));
+
+    if(an == 0)
+    {
+        return INVALID_MESSAGE;
+    }
+
+    packet_reader_init(&pr, mesg->buffer, mesg->received);
+    packet_reader_skip(&pr, DNS_HEADER_LENGTH);
+    packet_reader_skip_fqdn(&pr);
+    packet_reader_skip(&pr, 4);
+
+    for(u16 i = 0; i < an; ++i)
+    {
+        packet_reader_skip_fqdn(&pr);
+
+        if(FAIL(return_code = packet_reader_read(&pr, &tctr, 10)))
+        {
+            return return_code;
+        }
+
+        u32 rdata_end = pr.offset + ntohs(tctr.rdlen);
+
+        if(rdata_end > pr.packet_size)
+        {
+            return INVALID_MESSAGE;
+        }
+
+        if(i == 0)
+        {
+            if((tctr.qtype != qtype) || (tctr.rdlen != NU16(3 * sizeof(u32))))
+            {
+                return INVALID_MESSAGE;
+            }
+
+            for(int j = 0; j < 3; ++j)
+            {
+                paging[j] = ntohl(GET_U32_AT(pr.packet[pr.offset]));
+                pr.offset += sizeof(u32);
+            }
+
+            continue;
+        }
+
+        if(tctr.qtype != TYPE_TXT)
+        {
+            return INVALID_MESSAGE;
+        }
+
+        while(pr.offset < rdata_end)
+        {
+            u8 chunk_size = pr.packet[pr.offset++];
+
+            if(pr.offset + chunk_size > rdata_end)
+            {
+                return INVALID_MESSAGE;
+            }
+
+            output_stream_write(os, &pr.packet[pr.offset], chunk_size);
+            pr.offset += chunk_size;
+        }
+    }
+
+    return OK;
+}
+
+/** @brief yadifa_query_json_page queries the next page of the JSON object of the stats and locks commands
+ *
+ *  @param mesg the message, receives the answer
+ *  @param qtype the command
+ *  @param snapshot_id the snapshot id given in the answer of the first page
+ *  @param page the page
+ *  @retrun OK or an error code
+ */
+static ya_result
+yadifa_query_json_page(message_data *mesg, u16 qtype, u32 snapshot_id, u32 page)
+{
+    u8 root_fqdn[1] = {0};
+    u32 paging[2] = {htonl(snapshot_id), htonl(page)};
+    ya_result return_code;
+    u16 id = dns_new_id();
+
+    message_make_query(mesg, id, root_fqdn, qtype, CLASS_CTRL);
+
+    packet_writer pw;
+    packet_writer_init(&pw, mesg->buffer, mesg->send_length, sizeof(mesg->buffer));
+    packet_writer_add_record(&pw, root_fqdn, qtype, CLASS_CTRL, 0, (const u8*)paging, sizeof(paging));
+    MESSAGE_SET_AN(mesg->buffer, htons(1));
+    mesg->send_length = packet_writer_get_offset(&pw);
+
+    MESSAGE_SET_OP(mesg->buffer, OPCODE_CTRL);
+
+    if(FAIL(return_code = message_sign_query_by_name(mesg, g_yadifa_main_settings.tsig_key_name)))
+    {
+        return return_code;
+    }
+
+    message_update_tcp_length(mesg);
+
+    if(FAIL(return_code = message_query_tcp_with_timeout(mesg, g_yadifa_main_settings.server, 3)))
+    {
+        return return_code;
+    }
+
+    if(MESSAGE_ID(mesg->buffer) != id)
+    {
+        return MESSAGE_HAS_WRONG_ID;
+    }
+
+    return (MESSAGE_RCODE(mesg->buffer) == RCODE_NOERROR)?OK:MAKE_DNSMSG_ERROR(MESSAGE_RCODE(mesg->buffer));
+}
+
+/** @brief yadifa_print_json prints the JSON object of the stats and locks commands
+ *
+ *  Reads the first page, already answered, then queries and reads the next ones.
+ *  If the object changed on the server meanwhile, the pages are queried again from the first one.
+ *  The object is printed once complete.
+ *
+ *  @param mesg the answer to the command
+ *  @param qtype the command
+ *  @retrun OK or an error code
+ */
+static ya_result
+yadifa_print_json(message_data *mesg, u16 qtype)
+{
+    output_stream os;
+    ya_result return_code;
+    u32 paging[3];
+
+    bytearray_output_stream_init(&os, NULL, 0);
+
+    for(int attempt = 0; attempt < 3; ++attempt)
+    {
+        if(attempt > 0)
+        {
+            // the object changed on the server between two pages: start again
+
+            bytearray_output_stream_reset(&os);
+
+            if(FAIL(return_code = yadifa_query_json_page(mesg, qtype, 0, 0)))
+            {
+                break;
+            }
+        }
+
+        if(FAIL(return_code = yadifa_json_page_read(mesg, qtype, &os, paging)))
+        {
+            break;
+        }
+
+        u32 snapshot_id = paging[0];
+        u32 page_count = paging[2];
+
+        for(u32 page = 1; page < page_count; ++page)
+        {
+            if(FAIL(return_code = yadifa_query_json_page(mesg, qtype, snapshot_id, page)))
+            {
+                break;
+            }
+
+            if(FAIL(return_code = yadifa_json_page_read(mesg, qtype, &os, paging)))
+            {
+                break;
+            }
+        }
+
+        if(return_code != MAKE_DNSMSG_ERROR(RCODE_SERVFAIL))
+        {
+            break;
+        }
+    }
+
+    if(ISOK(return_code))
+    {
+        output_stream_write(termout, bytearray_output_stream_buffer(&os), bytearray_output_stream_size(&os));
+        println("");
+    }
+
+    output_stream_close(&os);
+
+    return return_code;
+}
+
 /** @brief yadifa_run main function for controlling yadifad
  *
  *  @param none
@@ -359,7 +562,14 @@ yadifa_run()
         }
     }
 
-    if(ISOK(return_code))
+    if(ISOK(return_code) && ((qtype == TYPE_CTRL_SRVSTATS) || (qtype == TYPE_CTRL_SRVLOCKS)) && (MESSAGE_RCODE(mesg.buffer) == RCODE_NOERROR))
+    {
+        if(FAIL(return_code = yadifa_print_json(&mesg, qtype)))
+        {
+            osformatln(termerr, "error: %r", return_code);
+        }
+    }
+    else if(ISOK(return_code))
     {
         osformatln(termout, "%s", get_rcode(MESSAGE_RCODE(mesg.buffer)));
     }
@@ -0,0 +1,307 @@
+/*------------------------------------------------------------------------------
+*
+* Copyright (c) 2011-2019, EURid vzw. All rights reserved.
+* The YADIFA TM software product is provided under the BSD 3-clause license:
+* 
+* Redistribution and use in source and binary forms, with or without 
+* modification, are permitted provided that the following conditions
+* are met:
+*
+*        * Redistributions of source code must retain the above copyright 
+*          notice, this list of conditions and the following disclaimer.
+*        * Redistributions in binary form must reproduce the above copyright 
+*          notice, this list of conditions and the following disclaimer in the 
+*          documentation and/or other materials provided with the distribution.
+*        * Neither the name of EURid nor the names of its contributors may be 
+*          used to endorse or promote products derived from this software 
+*          without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*------------------------------------------------------------------------------
+*
+*/
+
+/** @defgroup yamicrobench
+ *  @ingroup yadifa
+ *  @brief microbenchmarks of the dnscore/dnsdb primitives
+ */
+
+#include <dnscore/logger_handle.h>
+#include <dnscore/cmdline.h>
+#include <dnscore/config-cmdline.h>
+#include <dnscore/config_settings.h>
+
+// automatic created include file
+#include "client-config.h"
+
+#include "yadifa-config.h"
+#include "yamicrobench-config.h"
+#include "common-config.h"
+
+/*----------------------------------------------------------------------------*/
+#pragma mark GLOBAL VARIABLES
+
+extern logger_handle *g_client_logger;
+#define MODULE_MSG_HANDLE g_client_logger
+
+/*----------------------------------------------------------------------------*/
+#pragma mark CONFIG
+
+#define CONFIG_TYPE config_yamicrobench_settings_s
+CONFIG_BEGIN(config_yamicrobench_desc)
+
+CONFIG_FQDN(         origin,        "microbench."                                                  )
+CONFIG_STRING(       suites,        NULL                                                           )
+CONFIG_STRING(       output_file,   NULL                                                           )
+CONFIG_STRING(       workdir,       "/tmp"                                                         )
+CONFIG_U32(          names,         "100000"                                                       )
+CONFIG_U32(          warmup,        "200"                                                          )
+CONFIG_U32(          repetitions,   "200"                                                          )
+CONFIG_U32(          sample,        "1000"                                                         )
+CONFIG_BOOL(         signed_zone,   "off"                                                          )
+CONFIG_BOOL(         json,          "off"                                                          )
+
+CONFIG_END(config_yamicrobench_desc)
+#undef CONFIG_TYPE
+
+config_yamicrobench_settings_s g_yamicrobench_settings;
+
+/*----------------------------------------------------------------------------*/
+#pragma mark COMMAND LINE
+
+CMDLINE_BEGIN(yamicrobench_cmdline)
+
+CMDLINE_SECTION(  "yamicrobench")
+CMDLINE_OPT(      "suites",          's', "suites"                     )
+CMDLINE_OPT(      "origin",          'o', "origin"                     )
+CMDLINE_OPT(      "names",           'n', "names"                      )
+CMDLINE_BOOL(     "signed",          'S', "signed_zone"                )
+CMDLINE_OPT(      "warmup",          'w', "warmup"                     )
+CMDLINE_OPT(      "repetitions",     'r', "repetitions"                )
+CMDLINE_OPT(      "sample",          'u', "sample"                     )
+CMDLINE_BOOL(     "json",            'j', "json"                       )
+CMDLINE_OPT(      "output",          'O', "output_file"                )
+CMDLINE_OPT(      "workdir",         'D', "workdir"                    )
+
+CMDLINE_VERSION_HELP(yamicrobench_cmdline)
+
+CMDLINE_END(yamicrobench_cmdline)
+
+/*----------------------------------------------------------------------------*/
+#pragma mark FUNCTIONS
+
+/** @brief  yamicrobench_print_usage prints the help page
+ *
+ *  @param -- nothing --
+ *  @return -- nothing --
+ */
+void
+yamicrobench_print_usage(void)
+{
+    println("\n"
+            "Usage: yamicrobench [options]\n"
+            "       yadifa microbench [options]\n\n"
+            "\toptions:\n"
+            "\t\t--suites/-s <list>          : only runs the comma-separated suites of <list>\n"
+            "\t\t                            : dnsname,packet_writer,dictionary,rrset,zdb,nsec3,zalloc,tsig\n"
+            "\t\t--origin/-o <fqdn>          : the origin of the synthetic zone\n"
+            "\t\t--names/-n <count>          : the number of names <n>.<origin> in the synthetic zone\n"
+            "\t\t--signed/-S                 : the synthetic zone has an NSEC3 chain and signatures\n"
+            "\t\t--warmup/-w <ms>            : the warmup time of each benchmark\n"
+            "\t\t--repetitions/-r <count>    : the number of timed samples of each benchmark\n"
+            "\t\t--sample/-u <us>            : the targeted duration of a sample\n"
+            "\t\t--json/-j                   : prints the results as JSON\n"
+            "\t\t--output/-O <file>          : writes the results in <file> instead of the terminal\n"
+            "\t\t--workdir/-D <directory>    : where the synthetic zone file is generated\n"
+            "\n"
+            "\t\t--version/-V                : view version\n"
+            "\t\t--help/-h                   : show this help text\n"
+            "\n"
+        );
+}
+
+/** @brief  yamicrobench_config_finalise
+ *
+ *  @param -- nothing --
+ *  @return ya_result
+ */
+ya_result
+yamicrobench_config_finalise()
+{
+    config_error_s                                                   cfgerr;
+    ya_result                                                   return_code;
+
+    /*    ------------------------------------------------------------    */
+
+    config_set_source(CONFIG_SOURCE_DEFAULT);
+
+    if(ISOK(return_code = config_set_default(&cfgerr)))
+    {
+        config_postprocess();
+    }
+    else
+    {
+        formatln("defaults: internal error: %s:%u : '%s': %r", cfgerr.file, cfgerr.line_number, cfgerr.line, return_code);
+    }
+
+    if(g_yamicrobench_settings.names == 0)
+    {
+        g_yamicrobench_settings.names = 1;
+    }
+
+    if(g_yamicrobench_settings.repetitions == 0)
+    {
+        g_yamicrobench_settings.repetitions = 1;
+    }
+
+    if(g_yamicrobench_settings.sample == 0)
+    {
+        g_yamicrobench_settings.sample = 1;
+    }
+
+    return return_code;
+}
+
+/** @brief  yamicrobench_config_cmdline_callback
+*
+*  @param desc const struct cmdline_desc_s *
+*  @param arg_name const char *
+*  @param callback_owned void *
+*  @return ya_result
+*/
+static ya_result
+yamicrobench_config_cmdline_callback(const struct cmdline_desc_s *desc, const char *arg_name, void *callback_owned)
+{
+    (void)desc;
+    (void)callback_owned;
+
+    if(strcmp(arg_name, "--") == 0)
+    {
+        return CMDLINE_ARG_STOP_PROCESSING_FLAG_OPTIONS;
+    }
+
+    osformatln(termerr, "unexpected parameter %s", arg_name);
+
+    return ERROR;
+}
+
+/** @brief  yamicrobench_config_cmdline
+ *
+ *  @param argc int
+ *  @param argv char **
+ *  @return ya_result
+ */
+ya_result
+yamicrobench_config_cmdline(int argc, char **argv)
+{
+    input_stream                                                  config_is;
+    config_error_s                                                   cfgerr;
+    ya_result                                                   return_code;
+
+    /*    ------------------------------------------------------------    */
+
+    config_set_source(CONFIG_SOURCE_HIGHEST);
+
+    if(FAIL(return_code = cmdline_parse(yamicrobench_cmdline, argc, argv, yamicrobench_config_cmdline_callback, NULL, &config_is)))
+    {
+        return return_code;
+    }
+
+    config_set_source(CONFIG_SOURCE_CMDLINE);
+
+    if(FAIL(return_code = config_read_from_buffer((const char*)bytearray_input_stream_buffer(&config_is),
+                    bytearray_input_stream_size(&config_is),  "command-line",
+                    &cfgerr)))
+    {
+        formatln("%s: parsing error: %s:%u : '%s': %r", "cmdline", cfgerr.file, cfgerr.line_number, cfgerr.line, return_code);
+        flushout();
+
+        input_stream_close(&config_is);
+
+        return return_code;
+    }
+
+    input_stream_close(&config_is);
+    flushout();
+
+    return_code = 0;
+
+    /* check if cmd '--version' */
+    if(cmdline_version_get() > 0)
+    {
+        yadifa_print_version(cmdline_version_get());
+
+        return_code++;
+    }
+
+    /* check if cmd '--help' */
+    if(cmdline_help_get())
+    {
+        yamicrobench_print_usage();
+        return_code++;
+    }
+
+    return return_code;
+}
+
+/** @brief yamicrobench_config_init
+ *
+ *  @param -- nothing --
+ *  @return ya_result
+ */
+ya_result
+yamicrobench_config_init()
+{
+    ya_result                                                   return_code;
+
+    /*    ------------------------------------------------------------    */
+
+    logger_handle_create("client", &g_client_logger);
+
+    if(FAIL(return_code = config_init()))
+    {
+        return return_code;
+    }
+
+    /* register command line options: version and help */
+    config_set_source(CONFIG_SOURCE_CMDLINE);
+
+    if(FAIL(return_code = config_register_cmdline(6)))
+    {
+        return return_code;
+    }
+
+    ZEROMEMORY(&g_yamicrobench_settings, sizeof(g_yamicrobench_settings));
+
+    if(FAIL(return_code = config_register_struct("yamicrobench", config_yamicrobench_desc, &g_yamicrobench_settings, 5)))
+    {
+        return return_code;
+    }
+
+    return return_code;
+}
+
+/** @brief yamicrobench_config_file_get
+ *
+ *  The microbenchmarks have no configuration file.
+ *
+ *  @return NULL
+ */
+char *
+yamicrobench_config_file_get()
+{
+    return NULL;
+}
+
+/*    ------------------------------------------------------------    */
@@ -0,0 +1,1090 @@
+/*------------------------------------------------------------------------------
+*
+* Copyright (c) 2011-2019, EURid vzw. All rights reserved.
+* The YADIFA TM software product is provided under the BSD 3-clause license:
+* 
+* Redistribution and use in source and binary forms, with or without 
+* modification, are permitted provided that the following conditions
+* are met:
+*
+*        * Redistributions of source code must retain the above copyright 
+*          notice, this list of conditions and the following disclaimer.
+*        * Redistributions in binary form must reproduce the above copyright 
+*          notice, this list of conditions and the following disclaimer in the 
+*          documentation and/or other materials provided with the distribution.
+*        * Neither the name of EURid nor the names of its contributors may be 
+*          used to endorse or promote products derived from this software 
+*          without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*------------------------------------------------------------------------------
+*
+*/
+
+/** @defgroup yamicrobench
+ *  @ingroup yadifa
+ *  @brief microbenchmarks of the dnscore/dnsdb primitives
+ *
+ *  Generates a synthetic zone of <n>.<origin> names (the same ones yabench queries), optionally
+ *  with an NSEC3 chain and (fake) signatures, loads it through the zone file reader and times the
+ *  hot primitives over its names.
+ *
+ *  Each benchmark calls its function with a batch of operations.  The batch size is calibrated
+ *  during the warmup so a sample lasts about the configured sample time, then the configured
+ *  number of samples is timed.  The per-operation times go into a histogram and are reported as
+ *  percentiles, in text or JSON.
+ */
+
+#define MODULE_MSG_HANDLE g_client_logger
+
+#include <unistd.h>
+#include <time.h>
+#include <openssl/sha.h>
+
+#include <dnscore/logger.h>
+#include <dnscore/message.h>
+#include <dnscore/packet_writer.h>
+#include <dnscore/file_output_stream.h>
+#include <dnscore/buffer_output_stream.h>
+#include <dnscore/base32hex.h>
+#include <dnscore/base64.h>
+#include <dnscore/random.h>
+#include <dnscore/timems.h>
+#include <dnscore/histogram.h>
+#include <dnscore/zalloc.h>
+#include <dnscore/tsig.h>
+
+#include <dnsdb/zdb.h>
+#include <dnsdb/zdb_zone.h>
+#include <dnsdb/zdb-zone-arc.h>
+#include <dnsdb/zdb-zone-garbage.h>
+#include <dnsdb/zdb_zone_load.h>
+#include <dnsdb/zdb_rr_label.h>
+#include <dnsdb/zdb_record.h>
+#include <dnsdb/nsec3.h>
+#include <dnsdb/nsec3_hash.h>
+
+#include <dnszone/zone_file_reader.h>
+
+#include "yamicrobench-config.h"
+#include "yamicrobench.h"
+
+/*----------------------------------------------------------------------------*/
+#pragma mark GLOBAL VARIABLES
+
+extern logger_handle *g_client_logger;
+extern config_yamicrobench_settings_s g_yamicrobench_settings;
+
+#define YAMBNAME_TAG 0x454d414e424d4159
+#define YAMBDATA_TAG 0x41544144424d4159
+
+#define YAMICROBENCH_ORDER_SIZE     65536   // power of two
+#define YAMICROBENCH_NSEC3_SALT     "\xca\xfe\xba\xbe"
+#define YAMICROBENCH_NSEC3_SALT_LEN 4
+#define YAMICROBENCH_NSEC3_SALT_TXT "CAFEBABE"
+#define YAMICROBENCH_NSEC3_ITER     1
+#define YAMICROBENCH_PW_RESET       32      // names written in a packet before starting a new one
+#define YAMICROBENCH_PW_FULL        60000   // bytes written in a packet before starting a new one (full variants)
+#define YAMICROBENCH_ZALLOC_BATCH   64
+#define YAMICROBENCH_TSIG_NAME      (const u8*)"\003key\014yamicrobench\000"
+
+#if ZDB_RR_COLLECTION_BLOCK
+#define YAMICROBENCH_RR_COLLECTION  "block"
+#else
+#define YAMICROBENCH_RR_COLLECTION  "btree"
+#endif
+
+struct yamicrobench_data_s
+{
+    zdb db;
+    zdb_zone *zone;
+    u8 **names;         // the names of the zone
+    zdb_rr_label **labels; // the labels of the names, once the zone is loaded
+    u8 **missing;       // names that are not in the zone
+    u8 *names_buffer;
+    u8 *missing_buffer;
+    u32 *order;         // a random visit of the names
+    u32 names_count;
+    u32 cursor;
+    message_data *mesg;
+    packet_writer *pw;
+    u8 *packet;
+    void *pointers[YAMICROBENCH_ZALLOC_BATCH];
+#if DNSCORE_HAS_TSIG_SUPPORT
+    const tsig_item *tsig; // an HMAC-SHA256 key
+#endif
+    volatile u64 sink;  // keeps the results alive
+    bool dnssec;
+};
+
+typedef struct yamicrobench_data_s yamicrobench_data_s;
+
+typedef void yamicrobench_function(yamicrobench_data_s *data, u32 count);
+
+struct yamicrobench_case_s
+{
+    const char *suite;
+    const char *name;
+    yamicrobench_function *function;
+};
+
+typedef struct yamicrobench_case_s yamicrobench_case_s;
+
+/*----------------------------------------------------------------------------*/
+#pragma mark FUNCTIONS
+
+static inline u64
+yamicrobench_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline u32
+yamicrobench_next(yamicrobench_data_s *data)
+{
+    return data->order[data->cursor++ & (YAMICROBENCH_ORDER_SIZE - 1)];
+}
+
+/*
+ * dnsname
+ */
+
+static void
+yamicrobench_dnsname_compare(yamicrobench_data_s *data, u32 count)
+{
+    u64 sink = 0;
+
+    while(count-- > 0)
+    {
+        const u8 *a = data->names[yamicrobench_next(data)];
+        const u8 *b = data->names[yamicrobench_next(data)];
+        sink += dnsname_compare(a, b);
+    }
+
+    data->sink += sink;
+}
+
+static void
+yamicrobench_dnsname_equals_ignorecase(yamicrobench_data_s *data, u32 count)
+{
+    u64 sink = 0;
+
+    while(count-- > 0)
+    {
+        u32 i = yamicrobench_next(data);
+        sink += dnsname_equals_ignorecase(data->names[i], data->names[i]);
+    }
+
+    data->sink += sink;
+}
+
+/*
+ * packet_writer
+ */
+
+static void
+yamicrobench_packet_writer_add_fqdn(yamicrobench_data_s *data, u32 count)
+{
+    while(count > 0)
+    {
+        u32 n = MIN(count, YAMICROBENCH_PW_RESET);
+        count -= n;
+
+        packet_writer_create(data->pw, data->packet, DNSPACKET_MAX_LENGTH);
+
+        while(n-- > 0)
+        {
+            packet_writer_add_fqdn(data->pw, data->names[yamicrobench_next(data)]);
+        }
+    }
+
+    data->sink += data->pw->packet_offset;
+}
+
+static void
+yamicrobench_packet_writer_add_fqdn_uncompressed(yamicrobench_data_s *data, u32 count)
+{
+    while(count > 0)
+    {
+        u32 n = MIN(count, YAMICROBENCH_PW_RESET);
+        count -= n;
+
+        packet_writer_create(data->pw, data->packet, DNSPACKET_MAX_LENGTH);
+
+        while(n-- > 0)
+        {
+            packet_writer_add_fqdn_uncompressed(data->pw, data->names[yamicrobench_next(data)]);
+        }
+    }
+
+    data->sink += data->pw->packet_offset;
+}
+
+/*
+ * Fills messages of the size of a transfer, with the given compression dictionary
+ */
+
+static void
+yamicrobench_packet_writer_add_fqdn_full(yamicrobench_data_s *data, u32 count, bool hashed)
+{
+    while(count > 0)
+    {
+        packet_writer_create(data->pw, data->packet, DNSPACKET_MAX_LENGTH);
+        packet_writer_set_hashed_compression(data->pw, hashed);
+
+        while((count > 0) && (data->pw->packet_offset < YAMICROBENCH_PW_FULL))
+        {
+            packet_writer_add_fqdn(data->pw, data->names[yamicrobench_next(data)]);
+            --count;
+        }
+    }
+
+    data->sink += data->pw->packet_offset;
+}
+
+static void
+yamicrobench_packet_writer_add_fqdn_full_tree(yamicrobench_data_s *data, u32 count)
+{
+    yamicrobench_packet_writer_add_fqdn_full(data, count, FALSE);
+}
+
+static void
+yamicrobench_packet_writer_add_fqdn_full_hashed(yamicrobench_data_s *data, u32 count)
+{
+    yamicrobench_packet_writer_add_fqdn_full(data, count, TRUE);
+}
+
+/*
+ * dictionary (the labels of the zone)
+ */
+
+static void
+yamicrobench_dictionary_find(yamicrobench_data_s *data, u32 count)
+{
+    u64 sink = 0;
+
+    while(count-- > 0)
+    {
+        sink += (intptr)zdb_rr_label_find_from_name(data->zone, data->names[yamicrobench_next(data)]);
+    }
+
+    data->sink += sink;
+}
+
+static void
+yamicrobench_dictionary_find_missing(yamicrobench_data_s *data, u32 count)
+{
+    u64 sink = 0;
+
+    while(count-- > 0)
+    {
+        sink += (intptr)zdb_rr_label_find_from_name(data->zone, data->missing[data->cursor++ & (YAMICROBENCH_ORDER_SIZE - 1)]);
+    }
+
+    data->sink += sink;
+}
+
+/*
+ * rrset (the RRsets of a label)
+ */
+
+static void
+yamicrobench_rrset_find(yamicrobench_data_s *data, u32 count)
+{
+    u64 sink = 0;
+
+    while(count-- > 0)
+    {
+        sink += (intptr)zdb_record_find(&data->labels[yamicrobench_next(data)]->resource_record_set, TYPE_A);
+    }
+
+    data->sink += sink;
+}
+
+static void
+yamicrobench_rrset_find_missing(yamicrobench_data_s *data, u32 count)
+{
+    u64 sink = 0;
+
+    while(count-- > 0)
+    {
+        sink += (intptr)zdb_record_find(&data->labels[yamicrobench_next(data)]->resource_record_set, TYPE_AAAA);
+    }
+
+    data->sink += sink;
+}
+
+/*
+ * zdb
+ */
+
+static inline ya_result
+yamicrobench_query(yamicrobench_data_s *data, const u8 *fqdn)
+{
+    message_data *mesg = data->mesg;
+
+    message_make_query_ex(mesg, (u16)data->cursor, fqdn, TYPE_A, CLASS_IN, (data->dnssec)?MESSAGE_EDNS0_DNSSEC:0);
+    mesg->received = mesg->send_length;
+
+    ya_result return_code = message_process_query(mesg);
+
+    if(return_code == SUCCESS)
+    {
+        zdb_query_and_update(&data->db, mesg, mesg->pool_buffer);
+        return_code = MESSAGE_RCODE(mesg->buffer);
+    }
+
+    return return_code;
+}
+
+static void
+yamicrobench_zdb_query(yamicrobench_data_s *data, u32 count)
+{
+    u64 sink = 0;
+
+    while(count-- > 0)
+    {
+        yamicrobench_query(data, data->names[yamicrobench_next(data)]);
+        sink += data->mesg->send_length;
+    }
+
+    data->sink += sink;
+}
+
+static void
+yamicrobench_zdb_query_nxdomain(yamicrobench_data_s *data, u32 count)
+{
+    u64 sink = 0;
+
+    while(count-- > 0)
+    {
+        yamicrobench_query(data, data->missing[data->cursor++ & (YAMICROBENCH_ORDER_SIZE - 1)]);
+        sink += data->mesg->send_length;
+    }
+
+    data->sink += sink;
+}
+
+/*
+ * nsec3
+ */
+
+static inline void
+yamicrobench_nsec3_hash(yamicrobench_data_s *data, u32 count, u32 iterations)
+{
+    nsec3_hash_function *hash = nsec3_hash_get_function(NSEC3_DIGEST_ALGORITHM_SHA1);
+    u8 digest[64];
+    u64 sink = 0;
+
+    while(count-- > 0)
+    {
+        const u8 *fqdn = data->names[yamicrobench_next(data)];
+        hash(fqdn, dnsname_len(fqdn), (const u8*)YAMICROBENCH_NSEC3_SALT, YAMICROBENCH_NSEC3_SALT_LEN, iterations, digest, FALSE);
+        sink += digest[0];
+    }
+
+    data->sink += sink;
+}
+
+static void
+yamicrobench_nsec3_hash_1(yamicrobench_data_s *data, u32 count)
+{
+    yamicrobench_nsec3_hash(data, count, 1);
+}
+
+static void
+yamicrobench_nsec3_hash_10(yamicrobench_data_s *data, u32 count)
+{
+    yamicrobench_nsec3_hash(data, count, 10);
+}
+
+/*
+ * zalloc
+ */
+
+static void
+yamicrobench_zalloc_64(yamicrobench_data_s *data, u32 count)
+{
+    while(count > 0)
+    {
+        u32 n = MIN(count, YAMICROBENCH_ZALLOC_BATCH);
+        count -= n;
+
+        for(u32 i = 0; i < n; ++i)
+        {
+            u8 *p;
+            ZALLOC_ARRAY_OR_DIE(u8*, p, 64, YAMBDATA_TAG);
+            data->pointers[i] = p;
+        }
+
+        for(u32 i = 0; i < n; ++i)
+        {
+            ZFREE_ARRAY(data->pointers[i], 64);
+        }
+    }
+}
+
+static void
+yamicrobench_malloc_64(yamicrobench_data_s *data, u32 count)
+{
+    while(count > 0)
+    {
+        u32 n = MIN(count, YAMICROBENCH_ZALLOC_BATCH);
+        count -= n;
+
+        for(u32 i = 0; i < n; ++i)
+        {
+            u8 *p;
+            MALLOC_OR_DIE(u8*, p, 64, YAMBDATA_TAG);
+            data->pointers[i] = p;
+        }
+
+        for(u32 i = 0; i < n; ++i)
+        {
+            free(data->pointers[i]);
+        }
+    }
+}
+
+/*
+ * tsig
+ */
+
+#if DNSCORE_HAS_TSIG_SUPPORT
+
+static void
+yamicrobench_tsig_hmac_acquire_release(yamicrobench_data_s *data, u32 count)
+{
+    while(count-- > 0)
+    {
+        tsig_hmac_t hmac = tsig_hmac_acquire(data->tsig);
+        tsig_hmac_release(hmac);
+    }
+}
+
+static void
+yamicrobench_tsig_sign_query(yamicrobench_data_s *data, u32 count)
+{
+    message_data *mesg = data->mesg;
+    u64 sink = 0;
+
+    while(count-- > 0)
+    {
+        message_make_query(mesg, (u16)data->cursor, data->names[yamicrobench_next(data)], TYPE_A, CLASS_IN);
+        message_sign_query(mesg, data->tsig);
+        sink += mesg->send_length;
+    }
+
+    data->sink += sink;
+}
+
+#endif
+
+static const yamicrobench_case_s yamicrobench_cases[] =
+{
+    {"dnsname",       "compare",                 yamicrobench_dnsname_compare},
+    {"dnsname",       "equals_ignorecase",       yamicrobench_dnsname_equals_ignorecase},
+    {"packet_writer", "add_fqdn",                yamicrobench_packet_writer_add_fqdn},
+    {"packet_writer", "add_fqdn_uncompressed",   yamicrobench_packet_writer_add_fqdn_uncompressed},
+    {"packet_writer", "add_fqdn_full_tree",      yamicrobench_packet_writer_add_fqdn_full_tree},
+    {"packet_writer", "add_fqdn_full_hashed",    yamicrobench_packet_writer_add_fqdn_full_hashed},
+    {"dictionary",    "find",                    yamicrobench_dictionary_find},
+    {"dictionary",    "find_missing",            yamicrobench_dictionary_find_missing},
+    {"rrset",         "find",                    yamicrobench_rrset_find},
+    {"rrset",         "find_missing",            yamicrobench_rrset_find_missing},
+    {"zdb",           "query",                   yamicrobench_zdb_query},
+    {"zdb",           "query_nxdomain",          yamicrobench_zdb_query_nxdomain},
+    {"nsec3",         "hash_1",                  yamicrobench_nsec3_hash_1},
+    {"nsec3",         "hash_10",                 yamicrobench_nsec3_hash_10},
+    {"zalloc",        "zalloc_free_64",          yamicrobench_zalloc_64},
+    {"zalloc",        "malloc_free_64",          yamicrobench_malloc_64},
+#if DNSCORE_HAS_TSIG_SUPPORT
+    {"tsig",          "hmac_acquire_release",    yamicrobench_tsig_hmac_acquire_release},
+    {"tsig",          "sign_query",              yamicrobench_tsig_sign_query},
+#endif
+    {NULL, NULL, NULL}
+};
+
+/*
+ * synthetic zone
+ */
+
+static u32
+yamicrobench_fqdn_make(u8 *fqdn, u32 n, const u8 *origin)
+{
+    char label[16];
+    u32 label_len = snformat(label, sizeof(label), "%u", n);
+    fqdn[0] = label_len;
+    memcpy(&fqdn[1], label, label_len);
+    u32 origin_len = dnsname_len(origin);
+    memcpy(&fqdn[1 + label_len], origin, origin_len);
+    return 1 + label_len + origin_len;
+}
+
+struct yamicrobench_nsec3_node_s
+{
+    u8 digest[SHA_DIGEST_LENGTH];
+    u32 index;  // 0 for the apex, n + 1 for the name n
+};
+
+typedef struct yamicrobench_nsec3_node_s yamicrobench_nsec3_node_s;
+
+static int
+yamicrobench_nsec3_node_compare(const void *a, const void *b)
+{
+    return memcmp(a, b, SHA_DIGEST_LENGTH);
+}
+
+static void
+yamicrobench_zone_rrsig_write(output_stream *os, const char *type, u32 labels, const char *signature)
+{
+    osformatln(os, "\tRRSIG\t%s 13 %u 86400 20380101000000 20200101000000 4242 %{dnsname} %s",
+               type, labels, g_yamicrobench_settings.origin, signature);
+}
+
+/**
+ * Writes the synthetic zone.  Signed zones get an NSEC3 chain and one RRSIG per RRSET, made of
+ * random bytes: the loader does not verify them and the query path only copies them.
+ */
+
+static ya_result
+yamicrobench_zone_write(const char *path, u32 names_count, bool dnssec)
+{
+    output_stream os;
+    ya_result return_code;
+
+    if(FAIL(return_code = file_output_stream_create(&os, path, 0644)))
+    {
+        return return_code;
+    }
+
+    buffer_output_stream_init(&os, &os, 65536);
+
+    const u8 *origin = g_yamicrobench_settings.origin;
+    u32 origin_labels = dnsname_getdepth(origin);
+
+    char signature[128];
+    char dnskey[128];
+
+    if(dnssec)
+    {
+        u8 bytes[64];
+        random_ctx rnd = random_init(0);
+        for(u32 i = 0; i < sizeof(bytes); ++i)
+        {
+            bytes[i] = random_next(rnd);
+        }
+        signature[base64_encode(bytes, sizeof(bytes), signature)] = '\0';
+        for(u32 i = 0; i < sizeof(bytes); ++i)
+        {
+            bytes[i] = random_next(rnd);
+        }
+        dnskey[base64_encode(bytes, sizeof(bytes), dnskey)] = '\0';
+        random_finalize(rnd);
+    }
+
+    osformatln(&os, "$ORIGIN %{dnsname}", origin);
+    osformatln(&os, "$TTL 86400");
+    osformatln(&os, "@\tIN\tSOA\tns hostmaster 1 3600 900 604800 3600");
+    osformatln(&os, "@\tNS\tns");
+
+    if(dnssec)
+    {
+        osformatln(&os, "@\tDNSKEY\t257 3 13 %s", dnskey);
+        osformatln(&os, "@\tNSEC3PARAM\t1 0 %u %s", YAMICROBENCH_NSEC3_ITER, YAMICROBENCH_NSEC3_SALT_TXT);
+        yamicrobench_zone_rrsig_write(&os, "SOA", origin_labels, signature);
+        yamicrobench_zone_rrsig_write(&os, "NS", origin_labels, signature);
+        yamicrobench_zone_rrsig_write(&os, "DNSKEY", origin_labels, signature);
+        yamicrobench_zone_rrsig_write(&os, "NSEC3PARAM", origin_labels, signature);
+    }
+
+    osformatln(&os, "ns\tA\t192.0.2.1");
+
+    if(dnssec)
+    {
+        yamicrobench_zone_rrsig_write(&os, "A", origin_labels + 1, signature);
+    }
+
+    for(u32 i = 0; i < names_count; ++i)
+    {
+        osformatln(&os, "%u\tA\t10.%u.%u.%u", i, (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff);
+
+        if(dnssec)
+        {
+            yamicrobench_zone_rrsig_write(&os, "A", origin_labels + 1, signature);
+        }
+    }
+
+    if(dnssec)
+    {
+        // the chain covers the apex, ns and the names
+
+        u32 nodes_count = names_count + 2;
+        yamicrobench_nsec3_node_s *nodes;
+        MALLOC_OR_DIE(yamicrobench_nsec3_node_s*, nodes, sizeof(yamicrobench_nsec3_node_s) * nodes_count, YAMBDATA_TAG);
+
+        nsec3_hash_function *hash = nsec3_hash_get_function(NSEC3_DIGEST_ALGORITHM_SHA1);
+        u8 fqdn[MAX_DOMAIN_LENGTH];
+
+        hash(origin, dnsname_len(origin), (const u8*)YAMICROBENCH_NSEC3_SALT, YAMICROBENCH_NSEC3_SALT_LEN, YAMICROBENCH_NSEC3_ITER, nodes[0].digest, FALSE);
+        nodes[0].index = 0;
+
+        fqdn[0] = 2;
+        fqdn[1] = 'n';
+        fqdn[2] = 's';
+        memcpy(&fqdn[3], origin, dnsname_len(origin));
+        hash(fqdn, dnsname_len(fqdn), (const u8*)YAMICROBENCH_NSEC3_SALT, YAMICROBENCH_NSEC3_SALT_LEN, YAMICROBENCH_NSEC3_ITER, nodes[1].digest, FALSE);
+        nodes[1].index = 1;
+
+        for(u32 i = 0; i < names_count; ++i)
+        {
+            u32 fqdn_len = yamicrobench_fqdn_make(fqdn, i, origin);
+            hash(fqdn, fqdn_len, (const u8*)YAMICROBENCH_NSEC3_SALT, YAMICROBENCH_NSEC3_SALT_LEN, YAMICROBENCH_NSEC3_ITER, nodes[i + 2].digest, FALSE);
+            nodes[i + 2].index = i + 2;
+        }
+
+        qsort(nodes, nodes_count, sizeof(yamicrobench_nsec3_node_s), yamicrobench_nsec3_node_compare);
+
+        char owner[SHA_DIGEST_LENGTH * 2];
+        char next[SHA_DIGEST_LENGTH * 2];
+
+        for(u32 i = 0; i < nodes_count; ++i)
+        {
+            const yamicrobench_nsec3_node_s *node = &nodes[i];
+            const yamicrobench_nsec3_node_s *next_node = &nodes[(i + 1) % nodes_count];
+
+            owner[base32hex_encode(node->digest, SHA_DIGEST_LENGTH, owner)] = '\0';
+            next[base32hex_encode(next_node->digest, SHA_DIGEST_LENGTH, next)] = '\0';
+
+            osformatln(&os, "%s\tNSEC3\t1 0 %u %s %s %s", owner, YAMICROBENCH_NSEC3_ITER, YAMICROBENCH_NSEC3_SALT_TXT, next,
+                       (node->index == 0)?"NS SOA RRSIG DNSKEY NSEC3PARAM":"A RRSIG");
+            osformat(&os, "%s", owner);
+            yamicrobench_zone_rrsig_write(&os, "NSEC3", origin_labels + 1, signature);
+        }
+
+        free(nodes);
+    }
+
+    output_stream_close(&os);
+
+    return SUCCESS;
+}
+
+static ya_result
+yamicrobench_zone_load(yamicrobench_data_s *data, const char *path)
+{
+    zone_reader zr;
+    ya_result return_code;
+
+    if(FAIL(return_code = zone_file_reader_open(path, &zr)))
+    {
+        return return_code;
+    }
+
+    u16 flags = ZDB_ZONE_MOUNT_ON_LOAD;
+
+    if(data->dnssec)
+    {
+        // as a slave, an inconsistent chain is an error instead of being fixed
+
+        flags |= ZDB_ZONE_NSEC3 | ZDB_ZONE_IS_SLAVE;
+    }
+
+    return_code = zdb_zone_load(&data->db, &zr, &data->zone, g_yamicrobench_settings.origin, flags);
+
+    zone_reader_close(&zr);
+
+    return return_code;
+}
+
+static ya_result
+yamicrobench_data_init(yamicrobench_data_s *data)
+{
+    const u8 *origin = g_yamicrobench_settings.origin;
+    u32 names_count = g_yamicrobench_settings.names;
+    u32 origin_len = dnsname_len(origin);
+    u32 stride = origin_len + 12; // the label of a 32 bits integer
+
+    data->names_count = names_count;
+    data->dnssec = g_yamicrobench_settings.signed_zone;
+
+    MALLOC_OR_DIE(u8**, data->names, sizeof(u8*) * names_count, YAMBNAME_TAG);
+    MALLOC_OR_DIE(u8*, data->names_buffer, (size_t)stride * names_count, YAMBNAME_TAG);
+    MALLOC_OR_DIE(u8**, data->missing, sizeof(u8*) * YAMICROBENCH_ORDER_SIZE, YAMBNAME_TAG);
+    MALLOC_OR_DIE(u8*, data->missing_buffer, (size_t)stride * YAMICROBENCH_ORDER_SIZE, YAMBNAME_TAG);
+    MALLOC_OR_DIE(u32*, data->order, sizeof(u32) * YAMICROBENCH_ORDER_SIZE, YAMBDATA_TAG);
+    MALLOC_OR_DIE(message_data*, data->mesg, sizeof(message_data), YAMBDATA_TAG);
+    MALLOC_OR_DIE(packet_writer*, data->pw, sizeof(packet_writer), YAMBDATA_TAG);
+    MALLOC_OR_DIE(u8*, data->packet, DNSPACKET_MAX_LENGTH, YAMBDATA_TAG);
+
+    ZEROMEMORY(data->mesg, sizeof(message_data));
+
+    u8 *p = data->names_buffer;
+
+    for(u32 i = 0; i < names_count; ++i)
+    {
+        data->names[i] = p;
+        p += yamicrobench_fqdn_make(p, i, origin);
+    }
+
+    random_ctx rnd = random_init(names_count);
+
+    p = data->missing_buffer;
+
+    for(u32 i = 0; i < YAMICROBENCH_ORDER_SIZE; ++i)
+    {
+        data->order[i] = random_next(rnd) % names_count;
+        data->missing[i] = p;
+        p += yamicrobench_fqdn_make(p, names_count + (random_next(rnd) % (names_count + YAMICROBENCH_ORDER_SIZE)), origin);
+    }
+
+    random_finalize(rnd);
+
+#if DNSCORE_HAS_TSIG_SUPPORT
+    u8 mac[32];
+
+    for(u32 i = 0; i < sizeof(mac); ++i)
+    {
+        mac[i] = (u8)(i * 37 + 11);
+    }
+
+    ya_result return_code = tsig_register(YAMICROBENCH_TSIG_NAME, mac, sizeof(mac), HMAC_SHA256);
+
+    if(FAIL(return_code))
+    {
+        return return_code;
+    }
+
+    data->tsig = tsig_get(YAMICROBENCH_TSIG_NAME);
+#endif
+
+    return SUCCESS;
+}
+
+static void
+yamicrobench_data_finalize(yamicrobench_data_s *data)
+{
+    free(data->packet);
+    free(data->pw);
+    free(data->mesg);
+    free(data->labels);
+    free(data->order);
+    free(data->missing_buffer);
+    free(data->missing);
+    free(data->names_buffer);
+    free(data->names);
+}
+
+/*
+ * harness
+ */
+
+static bool
+yamicrobench_suite_selected(const char *suite)
+{
+    const char *list = g_yamicrobench_settings.suites;
+
+    if((list == NULL) || (*list == '\0'))
+    {
+        return TRUE;
+    }
+
+    size_t suite_len = strlen(suite);
+
+    for(const char *p = list; (p = strstr(p, suite)) != NULL; p += suite_len)
+    {
+        if(((p == list) || (p[-1] == ',')) && ((p[suite_len] == ',') || (p[suite_len] == '\0')))
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ * Runs a benchmark and records the time of each operation, in picoseconds.
+ *
+ * @return the batch size
+ */
+
+static u32
+yamicrobench_case_run(const yamicrobench_case_s *c, yamicrobench_data_s *data, histogram_s *ps_per_op)
+{
+    u64 sample_ns = g_yamicrobench_settings.sample * 1000ULL;
+    u64 warmup_end = yamicrobench_now_ns() + g_yamicrobench_settings.warmup * 1000000ULL;
+    u32 batch = 1;
+
+    // warmup, growing the batch until a sample lasts long enough
+
+    for(;;)
+    {
+        u64 start = yamicrobench_now_ns();
+        c->function(data, batch);
+        u64 stop = yamicrobench_now_ns();
+
+        if((stop - start < sample_ns) && (batch < (1U << 30)))
+        {
+            batch <<= 1;
+        }
+        else if(stop >= warmup_end)
+        {
+            break;
+        }
+    }
+
+    histogram_init(ps_per_op);
+
+    for(u32 i = 0; i < g_yamicrobench_settings.repetitions; ++i)
+    {
+        u64 start = yamicrobench_now_ns();
+        c->function(data, batch);
+        u64 stop = yamicrobench_now_ns();
+        histogram_record(ps_per_op, ((stop - start) * 1000ULL) / batch);
+    }
+
+    return batch;
+}
+
+static void
+yamicrobench_result_print(output_stream *os, const yamicrobench_case_s *c, u32 batch, const histogram_s *h, bool first)
+{
+    double mean = histogram_mean(h) / 1000.0;
+    double ops = (mean > 0)?1000000000.0 / mean:0;
+
+    if(g_yamicrobench_settings.json)
+    {
+        osformat(os, "%s\n    {\"suite\": \"%s\", \"name\": \"%s\", \"batch\": %u, \"samples\": %llu, "
+                "\"ns_per_op\": {\"min\": %.3f, \"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f}, "
+                "\"ops_per_second\": %.0f}",
+                first?"":",", c->suite, c->name, batch, h->count,
+                h->min / 1000.0, mean,
+                histogram_value_at_percentile(h, 50.0) / 1000.0,
+                histogram_value_at_percentile(h, 90.0) / 1000.0,
+                histogram_value_at_percentile(h, 99.0) / 1000.0,
+                h->max / 1000.0, ops);
+    }
+    else
+    {
+        char name[64];
+        snformat(name, sizeof(name), "%s/%s", c->suite, c->name);
+
+        // "%-" right-justifies
+
+        osformatln(os, "%40s %-10.3f %-10.3f %-10.3f %-10.3f %-10.3f %-14.0f",
+                name,
+                h->min / 1000.0,
+                histogram_value_at_percentile(h, 50.0) / 1000.0,
+                histogram_value_at_percentile(h, 90.0) / 1000.0,
+                histogram_value_at_percentile(h, 99.0) / 1000.0,
+                h->max / 1000.0, ops);
+    }
+
+    output_stream_flush(os);
+}
+
+/** @brief yamicrobench_run
+ *
+ *  @param none
+ *  @return ya_result
+ */
+ya_result
+yamicrobench_run()
+{
+    yamicrobench_data_s *data;
+    output_stream file_os;
+    output_stream *os = termout;
+    char path[PATH_MAX];
+    ya_result return_code;
+
+    zdb_init();
+    zone_file_reader_init_error_codes();
+
+    MALLOC_OR_DIE(yamicrobench_data_s*, data, sizeof(yamicrobench_data_s), YAMBDATA_TAG);
+    ZEROMEMORY(data, sizeof(yamicrobench_data_s));
+
+    if(FAIL(return_code = yamicrobench_data_init(data)))
+    {
+        yamicrobench_data_finalize(data);
+        free(data);
+        return return_code;
+    }
+
+    zdb_create(&data->db);
+
+    snformat(path, sizeof(path), "%s/yamicrobench-%u-%u%s.zone", g_yamicrobench_settings.workdir,
+             getpid(), g_yamicrobench_settings.names, (data->dnssec)?"-signed":"");
+
+    u64 write_start = timeus();
+
+    if(FAIL(return_code = yamicrobench_zone_write(path, data->names_count, data->dnssec)))
+    {
+        osformatln(termerr, "cannot write the zone file '%s': %r", path, return_code);
+        return return_code;
+    }
+
+    u64 load_start = timeus();
+
+    return_code = yamicrobench_zone_load(data, path);
+
+    u64 load_stop = timeus();
+
+    unlink(path);
+
+    if(FAIL(return_code))
+    {
+        osformatln(termerr, "cannot load the zone file '%s': %r", path, return_code);
+        return return_code;
+    }
+
+    // the answers are checked once, a benchmark of a failing path would be meaningless
+
+    if((return_code = yamicrobench_query(data, data->names[0])) != RCODE_NOERROR)
+    {
+        osformatln(termerr, "the query of %{dnsname} failed: %r", data->names[0], return_code);
+        return ERROR;
+    }
+
+    if((return_code = yamicrobench_query(data, data->missing[0])) != RCODE_NXDOMAIN)
+    {
+        osformatln(termerr, "the query of %{dnsname} did not fail: %r", data->missing[0], return_code);
+        return ERROR;
+    }
+
+    // the labels of the names, and the memory used by their RRset collections
+
+    u64 rr_collection_bytes = 0;
+
+    MALLOC_OR_DIE(zdb_rr_label**, data->labels, sizeof(zdb_rr_label*) * data->names_count, YAMBDATA_TAG);
+
+    for(u32 i = 0; i < data->names_count; ++i)
+    {
+        data->labels[i] = zdb_rr_label_find_from_name(data->zone, data->names[i]);
+        rr_collection_bytes += zdb_rr_collection_memory(data->labels[i]->resource_record_set);
+    }
+
+    // the memory taken from the arena of the zone
+
+    u64 arena_used = 0;
+    u64 arena_mapped = 0;
+
+#if ZDB_ZONE_ARENA_SUPPORT
+    if(data->zone->arena != NULL)
+    {
+        arena_used = data->zone->arena->used;
+        arena_mapped = zdb_zone_arena_mapped(data->zone->arena);
+    }
+#endif
+
+    if(g_yamicrobench_settings.output_file != NULL)
+    {
+        if(FAIL(return_code = file_output_stream_create(&file_os, g_yamicrobench_settings.output_file, 0644)))
+        {
+            osformatln(termerr, "cannot create '%s': %r", g_yamicrobench_settings.output_file, return_code);
+            return return_code;
+        }
+
+        os = &file_os;
+    }
+
+    if(g_yamicrobench_settings.json)
+    {
+        osformat(os, "{\n  \"origin\": \"%{dnsname}\", \"names\": %u, \"signed\": %s, \"warmup_ms\": %u, \"repetitions\": %u, \"sample_us\": %u,\n"
+                "  \"zone_write_ms\": %.3f, \"zone_load_ms\": %.3f, \"rr_collection\": \"%s\", \"rr_collection_bytes\": %llu,\n"
+                "  \"zone_arena_used\": %llu, \"zone_arena_mapped\": %llu,\n  \"results\": [",
+                g_yamicrobench_settings.origin, data->names_count, (data->dnssec)?"true":"false",
+                g_yamicrobench_settings.warmup, g_yamicrobench_settings.repetitions, g_yamicrobench_settings.sample,
+                (load_start - write_start) / 1000.0, (load_stop - load_start) / 1000.0,
+                YAMICROBENCH_RR_COLLECTION, rr_collection_bytes, arena_used, arena_mapped);
+    }
+    else
+    {
+        osformatln(os, "zone %{dnsname}: %u names%s, written in %.3fms, loaded in %.3fms",
+                g_yamicrobench_settings.origin, data->names_count, (data->dnssec)?" (signed)":"",
+                (load_start - write_start) / 1000.0, (load_stop - load_start) / 1000.0);
+        osformatln(os, "RRset collections: %s, %llu bytes", YAMICROBENCH_RR_COLLECTION, rr_collection_bytes);
+        osformatln(os, "zone arena: %llu bytes used, %llu bytes mapped", arena_used, arena_mapped);
+        osformatln(os, "%40s %-10s %-10s %-10s %-10s %-10s %-14s", "ns/op", "min", "p50", "p90", "p99", "max", "ops/s");
+    }
+
+    histogram_s *ps_per_op;
+    MALLOC_OR_DIE(histogram_s*, ps_per_op, sizeof(histogram_s), YAMBDATA_TAG);
+
+    bool first = TRUE;
+
+    for(const yamicrobench_case_s *c = yamicrobench_cases; c->suite != NULL; ++c)
+    {
+        if(!yamicrobench_suite_selected(c->suite))
+        {
+            continue;
+        }
+
+        u32 batch = yamicrobench_case_run(c, data, ps_per_op);
+        yamicrobench_result_print(os, c, batch, ps_per_op, first);
+        first = FALSE;
+    }
+
+    free(ps_per_op);
+
+    // the destruction of the zone, as done when it is replaced: unmounted, released, then collected
+
+    zdb_zone_arena_teardown_stats teardown_before;
+    zdb_zone_arena_teardown_stats teardown_after;
+    zdb_zone_arena_teardown_stats_get(&teardown_before);
+
+    u64 teardown_start = timeus();
+
+    zdb_zone *mounted_zone = zdb_remove_zone_from_dnsname(&data->db, g_yamicrobench_settings.origin);
+
+    if(mounted_zone != NULL)
+    {
+        zdb_zone_release(mounted_zone);
+    }
+
+    zdb_zone_release(data->zone);
+    data->zone = NULL;
+    zdb_zone_garbage_run();
+
+    u64 teardown_stop = timeus();
+
+    zdb_zone_arena_teardown_stats_get(&teardown_after);
+    bool arena_released = teardown_after.released > teardown_before.released;
+
+    if(g_yamicrobench_settings.json)
+    {
+        osformat(os, "\n  ],\n  \"zone_teardown_ms\": %.3f, \"zone_teardown_arena_released\": %s\n}\n",
+                (teardown_stop - teardown_start) / 1000.0, (arena_released)?"true":"false");
+    }
+    else
+    {
+        osformatln(os, "zone %{dnsname}: destroyed in %.3fms%s", g_yamicrobench_settings.origin, (teardown_stop - teardown_start) / 1000.0,
+                (arena_released)?" (arena released)":"");
+    }
+
+    output_stream_flush(os);
+
+    if(os == &file_os)
+    {
+        output_stream_close(os);
+    }
+
+    yamicrobench_data_finalize(data);
+    free(data);
+
+    return SUCCESS;
+}
+
+/*    ------------------------------------------------------------    */
@@ -100,6 +100,8 @@
 
 #define     TYPE_CTRL_SRVLOGREOPEN_NAME     "LOGREOPEN"     /// @todo 20150217 gve -- needs to be removed (twice declared)
 #define     TYPE_CTRL_SRVCFGRELOAD_NAME     "CFGRELOAD"
+#define     TYPE_CTRL_SRVSTATS_NAME         "STATS"
+#define     TYPE_CTRL_SRVLOCKS_NAME         "LOCKS"
 
 #if 1//HAS_DYNAMIC_PROVISIONING
 #define     TYPE_CTRL_CFGMERGE_NAME         "CFGMERGE"
@@ -393,6 +395,24 @@
 /* DOMAIN NAME = . */
 /* RDATASIZE = 0 */
 
+/*
+ * Q: . SRVSTATS CTRL
+ * A: . TXT CTRL json
+ *
+ * The answer is a JSON object split in character-strings
+ */
+
+#define     TYPE_CTRL_SRVSTATS              NU16(0x2b0f)
+
+/*
+ * Q: . SRVLOCKS CTRL
+ * A: . TXT CTRL json
+ *
+ * The answer is the zone lock contention profile, a JSON object split in character-strings
+ */
+
+#define     TYPE_CTRL_SRVLOCKS              NU16(0x2b10)
+
 
 /**
  * @}
@@ -89,6 +89,88 @@ ya_result dnskey_signature_sign(dnskey_signature *ds, const dnssec_key *key, voi
 void dnskey_signature_finalise(dnskey_signature *ds);
 
 ya_result dnskey_signature_rrset_sign_with_key(const dnssec_key *key, ptr_vector *rrset, bool canonize, resource_record_view *view, void **out_rrsig);
+
+/**
+ * A signer prepared for one key and one validity period.
+ * 
+ * The constant part of the RRSIG rdata header (validity, tag and signer name)
+ * is built once and the digest context is initialised once, then copied for
+ * each signed RRset.
+ */
+
+struct dnskey_signer
+{
+    const dnssec_key *key;
+    digest_s digest_template;
+    u32 inception;
+    u32 expiration;
+    u16 header_size;                // RRSIG_RDATA_HEADER_LEN + signer name length
+    u8 algorithm;
+    u8 header[RRSIG_RDATA_HEADER_LEN + MAX_DOMAIN_LENGTH];
+};
+
+typedef struct dnskey_signer dnskey_signer;
+
+/**
+ * An RRset to sign in a batch and the result of its signature.
+ */
+
+struct dnskey_signature_batch_item
+{
+    ptr_vector *rrset;              // the records of the set, in canonical order
+    resource_record_view view;
+    void *rrsig_rr;                 // the RRSIG record, instantiated by the view, or NULL
+    ya_result ret;                  // the size of the RRSIG rdata or an error code
+};
+
+typedef struct dnskey_signature_batch_item dnskey_signature_batch_item;
+
+/**
+ * Sorts the records of an RRset in canonical order.
+ * Needs only to be done once for all the keys signing the set.
+ */
+
+void dnskey_signature_canonize(ptr_vector *rrset, resource_record_view *view);
+
+/**
+ * Prepares a signer for the key.
+ * 
+ * @param signer the signer to initialise
+ * @param key the private key
+ * @param from the inception of the signatures
+ * @param to the expiration of the signatures
+ * 
+ * @return an error code
+ */
+
+ya_result dnskey_signer_init(dnskey_signer *signer, const dnssec_key *key, time_t from, time_t to);
+
+/**
+ * Signs a batch of canonised RRsets with the signer.
+ * All the digests of a chunk are computed first, then signed in one go.
+ * The result of each signature is stored in its item.
+ * 
+ * @param signer the signer
+ * @param items the RRsets to sign
+ * @param count the number of items
+ * 
+ * @return the number of signatures generated
+ */
+
+s32 dnskey_signer_sign_batch(dnskey_signer *signer, dnskey_signature_batch_item *items, s32 count);
+
+void dnskey_signer_finalise(dnskey_signer *signer);
+
+/**
+ * Writes the number of signatures made by each algorithm since the start,
+ * the time spent making them and the resulting rate, as a JSON object.
+ * 
+ * @param os the output stream
+ * 
+ * @return an error code
+ */
+
+ya_result dnskey_signature_stats_write_json(output_stream *os);
 //ya_result dnskey_signature_rrset_verify(dnskey_signature *ds, const dnssec_key *key, ptr_vector *rrset, resource_record_view *view);
 
 /**
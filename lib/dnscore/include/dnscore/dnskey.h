@@ -102,6 +102,7 @@
 #endif
 
 #define SSL_API_LT_100 (OPENSSL_VERSION_NUMBER < 0x10000000L) 
+#define SSL_API_LT_300 (OPENSSL_VERSION_NUMBER < 0x30000000L)
 #else
 #define SSL_API 0
 #endif
@@ -0,0 +1,163 @@
+/*------------------------------------------------------------------------------
+*
+* Copyright (c) 2011-2019, EURid vzw. All rights reserved.
+* The YADIFA TM software product is provided under the BSD 3-clause license:
+* 
+* Redistribution and use in source and binary forms, with or without 
+* modification, are permitted provided that the following conditions
+* are met:
+*
+*        * Redistributions of source code must retain the above copyright 
+*          notice, this list of conditions and the following disclaimer.
+*        * Redistributions in binary form must reproduce the above copyright 
+*          notice, this list of conditions and the following disclaimer in the 
+*          documentation and/or other materials provided with the distribution.
+*        * Neither the name of EURid nor the names of its contributors may be 
+*          used to endorse or promote products derived from this software 
+*          without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*------------------------------------------------------------------------------
+*
+*/
+
+/** @defgroup dnscore
+ *  @ingroup dnscore
+ *  @brief Log-linear latency histogram
+ *
+ *  Values are sorted into buckets whose width grows with the magnitude of the value,
+ *  keeping a relative error below 1/HISTOGRAM_SUB_BUCKET_COUNT (about 3%) over the
+ *  whole 64 bits range, in a fixed amount of memory.
+ *
+ *  A histogram is meant to be updated by a single thread.  Aggregation is done by
+ *  merging the histograms of the threads.
+ *
+ * @{
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <dnscore/sys_types.h>
+
+#define HISTOGRAM_SUB_BUCKET_BITS  5
+#define HISTOGRAM_SUB_BUCKET_COUNT (1 << HISTOGRAM_SUB_BUCKET_BITS)
+
+// values below 2 * HISTOGRAM_SUB_BUCKET_COUNT are exact, every power of two above has its sub-buckets
+
+#define HISTOGRAM_BUCKET_COUNT ((64 - HISTOGRAM_SUB_BUCKET_BITS + 1) * HISTOGRAM_SUB_BUCKET_COUNT)
+
+struct histogram_s
+{
+    u64 count;
+    u64 sum;
+    u64 min;
+    u64 max;
+    u64 buckets[HISTOGRAM_BUCKET_COUNT];
+};
+
+typedef struct histogram_s histogram_s;
+
+/**
+ * Returns the bucket index of a value.
+ */
+
+static inline u32
+histogram_bucket_index(u64 value)
+{
+    if(value < 2 * HISTOGRAM_SUB_BUCKET_COUNT)
+    {
+        return (u32)value;
+    }
+
+    u32 msb = 63 - __builtin_clzll(value);
+    u32 shift = msb - HISTOGRAM_SUB_BUCKET_BITS;
+
+    return ((shift + 1) << HISTOGRAM_SUB_BUCKET_BITS) + (u32)((value >> shift) - HISTOGRAM_SUB_BUCKET_COUNT);
+}
+
+/**
+ * Returns the highest value that would be stored in the bucket at the given index.
+ */
+
+u64 histogram_bucket_highest_value(u32 index);
+
+/**
+ * Clears the histogram.
+ */
+
+void histogram_init(histogram_s *h);
+
+/**
+ * Records a value.
+ */
+
+static inline void
+histogram_record(histogram_s *h, u64 value)
+{
+    ++h->buckets[histogram_bucket_index(value)];
+
+    if(h->count == 0)
+    {
+        h->min = value;
+        h->max = value;
+    }
+    else
+    {
+        if(value < h->min)
+        {
+            h->min = value;
+        }
+
+        if(value > h->max)
+        {
+            h->max = value;
+        }
+    }
+
+    ++h->count;
+    h->sum += value;
+}
+
+/**
+ * Adds the values of src into dst.
+ */
+
+void histogram_merge(histogram_s *dst, const histogram_s *src);
+
+/**
+ * Returns the value under which the given percentage of the recorded values lie.
+ * The result is the highest value of the bucket, capped by the maximum recorded value.
+ *
+ * @param h the histogram
+ * @param percentile in [0;100], ie: 99.9
+ *
+ * @return the value at the percentile, 0 if the histogram is empty
+ */
+
+u64 histogram_value_at_percentile(const histogram_s *h, double percentile);
+
+/**
+ * Returns the mean of the recorded values, 0 if the histogram is empty
+ */
+
+static inline u64
+histogram_mean(const histogram_s *h)
+{
+    return (h->count > 0)?h->sum / h->count:0;
+}
+
+#endif // HISTOGRAM_H
+
+/** @} */
@@ -276,6 +276,9 @@ struct message_data
     volatile u64 recv_us;
     volatile u64 pushed_us;
     volatile u64 popped_us;
+    volatile u64 recv_ns;   // monotonic, set when the reception and the answer are not done by the same thread
+    
+    u8 pool_node;           // the NUMA node of the handoff pool the message goes back to, not part of the header
 };
 
 
@@ -411,8 +414,51 @@ ya_result message_query_udp_with_time_out(message_data *mesg, const host_address
 ya_result message_query_udp_with_time_out_and_retries(message_data *mesg, const host_address *server, int seconds, int useconds, u8 retries, u8 flags); 
 ya_result message_query_serial(const u8 *origin, const host_address *server, u32 *serial_out);
 
+/**
+ * Initialises the pool of the messages handed from a service to another.
+ * Until then, the messages are simply allocated and freed.
+ */
+
+void message_handoff_pool_init();
+void message_handoff_pool_finalize();
+
+/**
+ * Takes a message from the pool of the handoffs.
+ * Its content is undefined.
+ * 
+ * @return a message, to be given back with message_free
+ */
+
+message_data *message_new_instance();
+
+/**
+ * Gives a message back to the pool of the handoffs.
+ * 
+ * @param mesg a message from message_new_instance, message_dup or message_handoff
+ */
+
+void message_free(message_data *mesg);
+
+/**
+ * Moves a received message to another service, without copying it.
+ * 
+ * The message is replaced in *mesgp by a message from the pool with the same
+ * reception setup (socket, protocol, size limit, ...) and nothing to send, so
+ * the caller can keep on receiving with it.  The caller must re-bind any
+ * reference it had on the buffers of the previous message.
+ * 
+ * @param mesgp a pointer to a message from message_new_instance
+ * 
+ * @return the message, now owned by the caller of message_handoff, to be given back with message_free
+ */
+
+message_data *message_handoff(message_data **mesgp);
+
 /*
  * Does not clone the pool.
+ * Only copies the header and the bytes of the message actually used.
+ * 
+ * The clone is to be given back with message_free.
  */
 
 message_data *message_dup(message_data *mesg);
@@ -56,14 +56,24 @@ extern "C"
 typedef struct packet_dictionary_node packet_dictionary_node;
 
 
-struct packet_dictionary_node // 16 / 28
+struct packet_dictionary_node // 20 / 32
 {
     packet_dictionary_node* next;
-    packet_dictionary_node* child;
+    packet_dictionary_node* child;      // hashed dictionary: the node of the rest of the name
     u8* label;
     u32 offset;
+    u32 hash;                           // hashed dictionary: the hash of the name from this label
 };
 
+/**
+ * Above this size limit, the compression dictionary of a writer is a table of the hashes of the names
+ * written in the packet, instead of a tree of labels searched sibling by sibling.
+ * Large answers and transfer messages hold thousands of names.
+ */
+
+#define PACKET_WRITER_HASHED_COMPRESSION_THRESHOLD 4096
+#define PACKET_WRITER_HASH_BUCKETS 1024 // power of two
+
 typedef struct packet_writer packet_writer;
 
 struct packet_writer
@@ -75,8 +85,11 @@ struct packet_writer
 
     u32 packet_offset;                  //    16 28
     u32 packet_limit;                   //    20 32
+    
+    packet_dictionary_node** buckets;   //    24 40 the hashed dictionary, NULL if the tree is used
 
-    packet_dictionary_node pool[4096];  // 65556 114720 or 131104 (depending on struct alignment)
+    packet_dictionary_node pool[4096];
+    packet_dictionary_node* bucket_table[PACKET_WRITER_HASH_BUCKETS];
 };
 
 /**
@@ -103,6 +116,16 @@ void packet_writer_create(packet_writer *pw, u8* packet, u32 limit);
 
 ya_result packet_writer_init(packet_writer *pw, u8* packet, u32 packet_offset, u32 size_limit);
 
+/**
+ * Chooses the compression dictionary of a writer, overriding the choice made from the size limit.
+ * Only valid before any name has been written.
+ * 
+ * @param pw
+ * @param hashed TRUE for the hashed dictionary, FALSE for the tree
+ */
+
+void packet_writer_set_hashed_compression(packet_writer *pw, bool hashed);
+
 /**
  * @note uncompressed names will not be compressed, of course *** BUT ***
  *       they will not be used in the compression dictionnary either
@@ -143,6 +143,8 @@ struct parser_s
 
     u32 line_number;
     u32 input_stream_stack_size;
+
+    u64 bytes_read;     // total bytes read from the streams, for throughput measurements
     
     char multiline;     // TODO: stack of multilines
     char cutchar;       // 
@@ -198,6 +200,16 @@ parser_text(const parser_s *parser)
     return parser->text;
 }
 
+/**
+ * Returns the number of bytes read from the input streams so far.
+ */
+
+static inline u64
+parser_bytes_read(const parser_s *parser)
+{
+    return parser->bytes_read;
+}
+
 /**
  * 
  * sets a terminating zero at the end of the current text returned by parser_text(parser)
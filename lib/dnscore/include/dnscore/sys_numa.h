@@ -0,0 +1,132 @@
+/*------------------------------------------------------------------------------
+*
+* Copyright (c) 2011-2019, EURid vzw. All rights reserved.
+* The YADIFA TM software product is provided under the BSD 3-clause license:
+* 
+* Redistribution and use in source and binary forms, with or without 
+* modification, are permitted provided that the following conditions
+* are met:
+*
+*        * Redistributions of source code must retain the above copyright 
+*          notice, this list of conditions and the following disclaimer.
+*        * Redistributions in binary form must reproduce the above copyright 
+*          notice, this list of conditions and the following disclaimer in the 
+*          documentation and/or other materials provided with the distribution.
+*        * Neither the name of EURid nor the names of its contributors may be 
+*          used to endorse or promote products derived from this software 
+*          without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*------------------------------------------------------------------------------
+*
+*/
+/** @defgroup cpu CPU
+ *  @ingroup dnscore
+ *  @brief NUMA topology
+ *
+ *  The nodes, their CPUs and the node of the network interfaces, as told by /sys on Linux.
+ *  On any other system, or if the information is not available, there is one node with all the CPUs.
+ *
+ * @{
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef _SYS_NUMA_H
+#define	_SYS_NUMA_H
+
+#include <sys/socket.h>
+#include <dnscore/sys_types.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/**
+ * Nodes beyond this limit are folded onto the first ones.
+ */
+
+#define SYS_NUMA_NODE_COUNT_MAX 8
+
+/**
+ * Reads the topology.  Called by dnscore_init.
+ */
+
+void sys_numa_init();
+
+/**
+ * @return the number of nodes, at least 1
+ */
+
+int sys_numa_node_count();
+
+/**
+ * @return the node of the CPU, 0 if it is not known
+ */
+
+int sys_numa_cpu_node(int cpu);
+
+/**
+ * Picks a CPU of a node.
+ *
+ * @param node the node, or -1 to pick from all the CPUs
+ * @param index the index of the CPU in the node, modulo the number of CPUs of the node
+ *
+ * @return the CPU, index itself if node is -1 or if there is only one node
+ */
+
+int sys_numa_node_cpu(int node, int index);
+
+/**
+ * @return the node of the CPU the caller is running on
+ */
+
+int sys_numa_current_node();
+
+/**
+ * @return the node the device of the network interface is attached to, -1 if it is not known
+ */
+
+int sys_numa_interface_node(const char *ifname);
+
+/**
+ * @return the node of the network interface having the address, -1 if it is not known (e.g. wildcard)
+ */
+
+int sys_numa_address_node(const struct sockaddr *sa);
+
+/**
+ * Maps anonymous memory, preferably on the node.
+ * 
+ * @param size the size of the memory
+ * @param node the node, or -1 for no preference
+ * 
+ * @return a pointer to the memory, or NULL if it could not be mapped
+ */
+
+void *sys_numa_alloc(size_t size, int node);
+
+/**
+ * Unmaps the memory from sys_numa_alloc
+ */
+
+void sys_numa_free(void *ptr, size_t size);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _SYS_NUMA_H */
+/** @} */
+
+/*----------------------------------------------------------------------------*/
+
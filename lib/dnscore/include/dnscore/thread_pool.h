@@ -119,6 +119,23 @@ struct thread_pool_s *thread_pool_init_ex(u8 thread_count, u32 queue_size, const
 
 struct thread_pool_s *thread_pool_init(u8 thread_count, u32 queue_size);
 
+/**
+ * Initialises a work-stealing thread pool
+ * 
+ * Each thread has its own task queue.  Tasks are spread over the queues and
+ * a thread without work takes tasks from the queues of the others.
+ * Enqueuing does not allocate memory and there is no single lock shared by
+ * every producer and consumer.
+ * The task order is only kept per thread: use it for independent tasks.
+ * 
+ * @param thread_count number of threads in the pool (max 255)
+ * @param queue_size number of pending tasks (when reached, enqueue will block until below)
+ * @param pool_name the friendly name of the thread pool
+ * @return 
+ */
+
+struct thread_pool_s *thread_pool_init_work_stealing(u8 thread_count, u32 queue_size, const char* pool_name);
+
 /**
  * Enqueues a function to be executed by a thread pool
  * Do NOT use this function for concurrent producer-consumer spawning on the same pool as
@@ -212,6 +229,43 @@ u8 thread_pool_get_size(struct thread_pool_s *tp);
 
 int thread_pool_queue_size(struct thread_pool_s *tp);
 
+struct thread_pool_stats
+{
+    u64 executed;           // number of tasks that have been run
+    u64 wait_us_total;      // time spent by the tasks in the queue
+    u64 wait_us_max;        // longest time spent by a task in the queue
+    u64 busy_us_total;      // time spent running tasks
+    u64 uptime_us;          // time since the creation of the pool
+    u64 steals;             // work-stealing: tasks taken from the queue of another thread
+    s32 queued;             // tasks currently waiting in the queue
+    u8 thread_count;
+};
+
+typedef struct thread_pool_stats thread_pool_stats;
+
+/**
+ * Gets the queue latency and utilisation statistics of a pool.
+ * The values are gathered from the threads without locking them.
+ * 
+ * The average queue latency is wait_us_total / executed
+ * The utilisation is busy_us_total / (uptime_us * thread_count)
+ * 
+ * @param tp the thread pool
+ * @param out_stats receives the statistics
+ */
+
+void thread_pool_get_stats(struct thread_pool_s *tp, thread_pool_stats *out_stats);
+
+struct logger_handle;
+
+/**
+ * Logs the statistics of all the pools.
+ * 
+ * @param handle the logger to use
+ */
+
+void thread_pool_log_stats_all(struct logger_handle *handle);
+
 // before and after a fork
 
 ya_result thread_pool_stop_all();
@@ -67,6 +67,12 @@ time_t timegm_internal(struct tm *tv);
 
 u64 timeus();
 
+/*
+ * Return the time in ns from a monotonic clock, only meaningful to measure durations
+ */
+
+u64 timens_monotonic();
+
 /*
  * Return the time in ms
  */
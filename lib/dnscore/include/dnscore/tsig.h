@@ -48,6 +48,7 @@
 #include <dnscore/dnskey.h>
 #include <dnscore/sys_types.h>
 #include <dnscore/packet_reader.h>
+#include <dnscore/mutex.h>
 
 #define HMAC_UNKNOWN	  0
 #define HMAC_MD5        157
@@ -97,12 +98,16 @@ union tsig_children_union
 
 typedef struct tsig_item tsig_item;
 
+struct tsig_hmac_template_s;
+
 struct tsig_item
 {
     const u8 *name;
     const u8 *mac;
     const u8 *mac_algorithm_name;
     const EVP_MD *evp_md;
+    struct tsig_hmac_template_s *hmac_template; // keyed context, cloned for each message (NULL if not registered)
+    mutex_t hmac_template_mtx; // guards the template pointer while it is referenced or replaced
     u16 name_len;
     u16 mac_algorithm_name_len;
     u16 mac_size;
@@ -277,6 +282,20 @@ typedef HMAC_CTX* tsig_hmac_t;
 tsig_hmac_t tsig_hmac_allocate();
 void tsig_hmac_free(tsig_hmac_t t);
 
+/**
+ * Gets an HMAC context keyed for the tsig item.
+ * The context is taken from the thread's pool and cloned from the keyed template of the item.
+ * Release it with tsig_hmac_release.
+ */
+
+tsig_hmac_t tsig_hmac_acquire(const tsig_item *tsig);
+
+/**
+ * Gives back an HMAC context obtained with tsig_hmac_acquire to the pool of the current thread.
+ */
+
+void tsig_hmac_release(tsig_hmac_t t);
+
 #ifdef	__cplusplus
 }
 #endif
@@ -51,23 +51,49 @@
 extern logger_handle *g_system_logger;
 
 /*
- * List of events (double-linked), sorted by epoch (then insersion time).
- * Array of handles (expandable), with the list of events they hold. (so they can easily be foud by id and closed)
+ * Events are kept in a hierarchical timing wheel, and in the list of their handle.
  * 
- * The descriptions are stored in both collections. (two double-linked structures)
- *
- * TIMELIST->[TIME#0]->[TIME#1]->...->[TIME#n]
- *              |         |
- *              v       [NODE]
- * HNDLLIST->[NODE]--+    |
- *                   +->[NODE]-- ...
+ * The wheel has a root level of 256 one-second slots and three upper levels of
+ * 64 slots each (256s, 4.5h, 12d per slot), covering about two years.
+ * An event is put in the slot of the lowest level that can hold its epoch.
+ * When the root level wraps, the current slot of the level above is cascaded down
+ * (its events are put back in the wheel relatively to the new time).
+ * Events further than the range of the wheel are put in the last slot of the
+ * top level and are re-evaluated when it is cascaded.
+ * 
+ * The slots are circular double-linked lists with a sentinel, so an event can be
+ * removed without knowing where it is: inserting and removing are O(1).
+ * 
+ * The handle lists allow to cancel all the events of a handle at once.
+ * 
+ * ROOT   [0][1][2]...[255]
+ *               |
+ *             [NODE]<->[NODE]<-+
+ *                               \
+ * HNDLLIST->[NODE]--+            |
+ *                   +->[NODE]----+ ...
  */
 
 #define ALARM_NODE_LIST_TAG 0x5453494c4d524c41
 #define ALARM_NODE_DESC_TAG 0x4353444e4d524c41
-#define ALARM_NODE_TIME_TAG 0x454d49544d524c41
 #define ALARM_HANDLE_TAG    0x4c444e484d524c41
 
+#define ALARM_WHEEL_ROOT_BITS   8
+#define ALARM_WHEEL_ROOT_SIZE   (1 << ALARM_WHEEL_ROOT_BITS)
+#define ALARM_WHEEL_ROOT_MASK   (ALARM_WHEEL_ROOT_SIZE - 1)
+#define ALARM_WHEEL_LEVEL_BITS  6
+#define ALARM_WHEEL_LEVEL_SIZE  (1 << ALARM_WHEEL_LEVEL_BITS)
+#define ALARM_WHEEL_LEVEL_MASK  (ALARM_WHEEL_LEVEL_SIZE - 1)
+#define ALARM_WHEEL_LEVELS      3   // above the root
+
+// the epoch bit where the slot index of an upper level starts
+
+#define ALARM_WHEEL_SHIFT(level_) (ALARM_WHEEL_ROOT_BITS + (level_) * ALARM_WHEEL_LEVEL_BITS)
+
+// the time covered by the wheel
+
+#define ALARM_WHEEL_SPAN        (1U << ALARM_WHEEL_SHIFT(ALARM_WHEEL_LEVELS))
+
 struct alarm_event_list
 {
     alarm_event_node *first;
@@ -84,18 +110,11 @@ struct alarm_handle
 
 typedef struct alarm_handle alarm_handle;
 
-struct alarm_time_node
-{
-    struct alarm_time_node *next;
-    alarm_event_list events;
-    u32 epoch;
-};
-
-typedef struct alarm_time_node alarm_time_node;
-
 static ptr_vector alarm_handles = EMPTY_PTR_VECTOR;
-static alarm_time_node doomsday = { NULL, {NULL, NULL}, MAX_U32 }; // nothing after this point
-static alarm_time_node time_list = { &doomsday, {NULL, NULL}, 0 };
+static alarm_event_node alarm_wheel_root[ALARM_WHEEL_ROOT_SIZE];
+static alarm_event_node alarm_wheel_level[ALARM_WHEEL_LEVELS][ALARM_WHEEL_LEVEL_SIZE];
+static alarm_event_node alarm_wheel_expired;    // events set for the past, run at the next tick
+static u32 alarm_wheel_now = 0;                 // all the events up to this epoch have been processed
 static pthread_mutex_t alarm_mutex = PTHREAD_MUTEX_INITIALIZER;
 static int alarm_handles_next_free = -1;
 #ifdef DEBUG
@@ -197,323 +216,288 @@ alarm_event_list_init(alarm_event_list *head)
 #endif
 }
 
+/**
+ * Initialises a wheel slot (an empty circular list)
+ */
+
 static void
-alarm_event_list_finalize(alarm_event_list *head)
+alarm_wheel_slot_init(alarm_event_node *slot)
 {
-    if(head->first != NULL && head->first == head->last)
-    {
-        alarm_event_free(head->first);
-        head->first = NULL;
-        head->last = NULL;
-    }
+    ZEROMEMORY(slot, sizeof(alarm_event_node));
+    slot->time_next = slot;
+    slot->time_prev = slot;
 #ifdef DEBUG
-    else
-    {
-        log_warn("alarm_event_list_finalize called on an non-empty list");
-    }
+    slot->text = "ALARM WHEEL SLOT SENTINEL";
 #endif
 }
 
-static bool
-alarm_event_list_isempty(alarm_event_list *head)
+static inline bool
+alarm_wheel_slot_isempty(alarm_event_node *slot)
 {
-    assert(alarm_pthread_mutex_locked);
-    
-    return head->first == head->last;
+    return slot->time_next == slot;
 }
 
-static alarm_event_node *
-alarm_event_list_removefirst(alarm_event_list *time_event)
+static inline void
+alarm_wheel_slot_append(alarm_event_node *slot, alarm_event_node *node)
 {
-    assert(alarm_pthread_mutex_locked);
-    assert(!alarm_event_list_isempty(time_event));
-    assert((time_event->first != NULL) && (time_event->last != NULL));
-    
-    // prerequisite: (time node) list is not empty
+    node->time_prev = slot->time_prev;
+    node->time_next = slot;
+    slot->time_prev->time_next = node;
+    slot->time_prev = node;
     
-    // detach from the (time node) list
+#ifdef DEBUG
+    ++alarm_event_in_time_count;
+#endif
+}
 
-    alarm_event_node *time_node = time_event->first;
-    time_event->first = time_node->time_next;
-    time_event->first->time_prev = NULL;
+static inline void
+alarm_wheel_unlink(alarm_event_node *node)
+{
+    node->time_prev->time_next = node->time_next;
+    node->time_next->time_prev = node->time_prev;
     
 #ifdef DEBUG
+    node->time_next = (alarm_event_node*)~0;
+    node->time_prev = (alarm_event_node*)~0;
+    
     --alarm_event_in_time_count;
 #endif
+}
 
-    assert(time_node->hndl_next != NULL);
-    
-    // detach from the handle list
+/**
+ * Returns the slot where an event for the epoch has to be put.
+ * 
+ * @param epoch
+ * @return the slot
+ */
 
-    if(time_node->hndl_prev != NULL)
-    {
-        // in the middle of the list : easy
-        time_node->hndl_prev->hndl_next = time_node->hndl_next;
-    }
-    else
+static alarm_event_node *
+alarm_wheel_slot_get(u32 epoch)
+{
+    assert(alarm_pthread_mutex_locked);
+    
+    if(epoch <= alarm_wheel_now)
     {
-        // at the beginning of the list : have to find the list first
-        alarm_event_list *handler_list = ptr_vector_get(&alarm_handles, time_node->handle);
-        handler_list->first = time_node->hndl_next;
+        return &alarm_wheel_expired;
     }
-        
-    /* if(node->hndl_next != NULL) There is at least the sentinel */
-    
-    time_node->hndl_next->hndl_prev = time_node->hndl_prev;
     
-#ifdef DEBUG
+    u32 delta = epoch - alarm_wheel_now;
     
-    time_node->hndl_next = (alarm_event_node*)~0;
-    time_node->hndl_prev = (alarm_event_node*)~0;
+    if(delta < ALARM_WHEEL_ROOT_SIZE)
+    {
+        return &alarm_wheel_root[epoch & ALARM_WHEEL_ROOT_MASK];
+    }
     
-    time_node->time_next = (alarm_event_node*)~0;
-    time_node->time_prev = (alarm_event_node*)~0;
+    for(int level = 0; level < ALARM_WHEEL_LEVELS; ++level)
+    {
+        if(delta < (1U << ALARM_WHEEL_SHIFT(level + 1)))
+        {
+            return &alarm_wheel_level[level][(epoch >> ALARM_WHEEL_SHIFT(level)) & ALARM_WHEEL_LEVEL_MASK];
+        }
+    }
     
-    --alarm_event_in_handles_count;
-#endif
+    // beyond the wheel: the last slot to be cascaded, the event will be re-evaluated then
     
-#ifdef DEBUG
-    log_debug6("alarm_event_list_removefirst(%p %08x '%s' %T)", time_node, time_node->key, time_node->text, time_node->epoch);
-#endif
+    return &alarm_wheel_level[ALARM_WHEEL_LEVELS - 1][((alarm_wheel_now >> ALARM_WHEEL_SHIFT(ALARM_WHEEL_LEVELS - 1)) - 1) & ALARM_WHEEL_LEVEL_MASK];
+}
 
-    return time_node;
+/**
+ * Puts the node in the wheel.
+ */
+
+static inline void
+alarm_wheel_insert(alarm_event_node *node)
+{
+    alarm_wheel_slot_append(alarm_wheel_slot_get(node->epoch), node);
 }
 
-/*
- * Append at end.
+/**
+ * Moves all the events of a slot in the list of the target slot.
  */
 
 static void
-alarm_event_append(alarm_event_list *handle_list, alarm_event_list *time_list, alarm_event_node *node)
+alarm_wheel_slot_move_all(alarm_event_node *slot, alarm_event_node *target)
 {
-    assert(alarm_pthread_mutex_locked);
-    
-    /*
-     * List not empty ?
-     */
-    
-#ifdef DEBUG
-    log_debug6("alarm_event_append(%p,%p,%p %08x '%s' %T)", handle_list, time_list, node, node->key, node->text, node->epoch);
-#endif
-    
-    if(handle_list->first != handle_list->last)
+    while(!alarm_wheel_slot_isempty(slot))
     {
-        /*
-         * Insert the node before the last one.
-         */
-        
-        handle_list->last->hndl_prev->hndl_next = node;    // BL ->N   L
-        node->hndl_prev = handle_list->last->hndl_prev;    // BL<->N   L
-
-        handle_list->last->hndl_prev = node;               // BL<->N<- L
-        node->hndl_next = handle_list->last;               // BL<->N<->L
+        alarm_event_node *node = slot->time_next;
+        alarm_wheel_unlink(node);
+        alarm_wheel_slot_append(target, node);
     }
-    else
+}
+
+/**
+ * Puts back in the wheel all the events of a slot, relatively to the current time.
+ */
+
+static void
+alarm_wheel_cascade(alarm_event_node *slot)
+{
+    alarm_event_node tmp;
+    alarm_wheel_slot_init(&tmp);
+    alarm_wheel_slot_move_all(slot, &tmp);
+    
+    while(!alarm_wheel_slot_isempty(&tmp))
     {
-        handle_list->first = node;                         // F = N   L
-        node->hndl_next = handle_list->last;               //   ->F ->L
-        handle_list->last->hndl_prev = node;               //   ->F<->L
-        node->hndl_prev = NULL;                     // 0<->F<->L
+        alarm_event_node *node = tmp.time_next;
+        alarm_wheel_unlink(node);
+        alarm_wheel_insert(node);
     }
+}
+
+/**
+ * Moves the wheel one second forward and moves the events of that second into the due slot.
+ */
+
+static void
+alarm_wheel_advance(alarm_event_node *due)
+{
+    ++alarm_wheel_now;
     
-#ifdef DEBUG
-    ++alarm_event_in_handles_count;
-#endif
+    // top-down so that nothing is put in a slot that has already been cascaded
     
-    if(time_list->first != time_list->last)
+    for(int level = ALARM_WHEEL_LEVELS - 1; level >= 0; --level)
     {
-        time_list->last->time_prev->time_next = node;
-        node->time_prev = time_list->last->time_prev;
+        if((alarm_wheel_now & ((1U << ALARM_WHEEL_SHIFT(level)) - 1)) == 0)
+        {
+            alarm_wheel_cascade(&alarm_wheel_level[level][(alarm_wheel_now >> ALARM_WHEEL_SHIFT(level)) & ALARM_WHEEL_LEVEL_MASK]);
+        }
+    }
+    
+    alarm_wheel_slot_move_all(&alarm_wheel_root[alarm_wheel_now & ALARM_WHEEL_ROOT_MASK], due);
+    
+    // a cascade puts the events for the current second in the expired slot
+    
+    alarm_wheel_slot_move_all(&alarm_wheel_expired, due);
+}
+
+/**
+ * Moves the wheel to the epoch at once: every event is put back relatively to the new time.
+ * Used when the clock jumped too far to go second by second, or went back.
+ */
 
-        time_list->last->time_prev = node;
-        node->time_next = time_list->last;
+static void
+alarm_wheel_rebase(u32 epoch)
+{
+    alarm_event_node tmp;
+    alarm_wheel_slot_init(&tmp);
+    
+    for(int i = 0; i < ALARM_WHEEL_ROOT_SIZE; ++i)
+    {
+        alarm_wheel_slot_move_all(&alarm_wheel_root[i], &tmp);
     }
-    else
+    
+    for(int level = 0; level < ALARM_WHEEL_LEVELS; ++level)
     {
-        time_list->first = node;
-        node->time_next = time_list->last;
-        time_list->last->time_prev = node;
-        node->time_prev = NULL;
+        for(int i = 0; i < ALARM_WHEEL_LEVEL_SIZE; ++i)
+        {
+            alarm_wheel_slot_move_all(&alarm_wheel_level[level][i], &tmp);
+        }
     }
     
-#ifdef DEBUG
-    ++alarm_event_in_time_count;
-#endif
+    alarm_wheel_now = epoch;
+    
+    while(!alarm_wheel_slot_isempty(&tmp))
+    {
+        alarm_event_node *node = tmp.time_next;
+        alarm_wheel_unlink(node);
+        alarm_wheel_insert(node);
+    }
 }
 
 /**
- * Removes the node from both the handle list and the time list.
- * Does not releases memory.
+ * Removes the node from the list of its handle.
  * 
  * @param handle_list
- * @param time_list
  * @param node
  */
 
 static void
-alarm_event_remove(alarm_event_list *handle_list, alarm_event_list *time_list, alarm_event_node *node)
+alarm_event_handle_remove(alarm_event_list *handle_list, alarm_event_node *node)
 {
-    assert(alarm_pthread_mutex_locked);
-    assert(time_list != NULL);
-    assert(node != NULL);
-    
-#ifdef DEBUG
-    log_debug6("alarm_event_remove(%p,%p,%p %08x '%s' %T)", handle_list, time_list, node, node->key, node->text, node->epoch);
-#endif
-    
     if(node->hndl_prev != NULL)                             // A<- N<->B ?
     {
         node->hndl_prev->hndl_next = node->hndl_next;       // N<--N<->B
     }
     else
     {
-        handle_list->first = node->hndl_next;                      // F = N<->B
+        handle_list->first = node->hndl_next;               // F = N<->B
     }
     
     node->hndl_next->hndl_prev = node->hndl_prev;           // 0/A<-?B
     
 #ifdef DEBUG
-    --alarm_event_in_handles_count;
-#endif    
-
-    if(node->time_prev != NULL)
-    {
-        node->time_prev->time_next = node->time_next;
-    }
-    else
-    {
-        time_list->first = node->time_next;
-        // scan-build false positive : time cannot be null because the call
-        // that provides the value only gives a null for non-existing nodes
-        // AND the call is made using an existing node (not null).
-    }
-
-    node->time_next->time_prev = node->time_prev;
-    
-#ifdef DEBUG
-    
     node->hndl_next = (alarm_event_node*)~0;
     node->hndl_prev = (alarm_event_node*)~0;
     
-    node->time_next = (alarm_event_node*)~0;
-    node->time_prev = (alarm_event_node*)~0;
-    
-    --alarm_event_in_time_count;
+    --alarm_event_in_handles_count;
 #endif    
-
 }
 
-static alarm_time_node *
-alarm_time_alloc()
-{
-    alarm_time_node *time_node;
-    ZALLOC_OR_DIE(alarm_time_node*, time_node, alarm_time_node, ALARM_NODE_TIME_TAG);
-
-#ifdef DEBUG
-    memset(time_node, 0xff,sizeof(alarm_time_node));
-    log_debug6("alarm_time_alloc() = %p", time_node);
-#endif
-
-    assert(alarm_pthread_mutex_locked);
-    
-    alarm_event_list_init(&time_node->events); /* newly allocated : NO LOCK */
-
-    /* node->next : for the caller */
-    return time_node;
-}
+/*
+ * Append at end.
+ */
 
 static void
-alarm_time_free(alarm_time_node *time_node)
+alarm_event_append(alarm_event_list *handle_list, alarm_event_node *node)
 {
     assert(alarm_pthread_mutex_locked);
-    assert(time_node->events.first == time_node->events.last);
-#ifdef DEBUG
-    log_debug6("alarm_time_free(%p)", time_node);
     
-    alarm_event_list_finalize(&time_node->events);
+    /*
+     * List not empty ?
+     */
     
-    memset(time_node, 0xfe,sizeof(alarm_time_node));
+#ifdef DEBUG
+    log_debug6("alarm_event_append(%p,%p %08x '%s' %T)", handle_list, node, node->key, node->text, node->epoch);
 #endif
-    ZFREE(time_node, alarm_time_node);
-}
-
-/*
- * Get the time node for the exact epoch ...
- */
-
-static alarm_time_node *
-alarm_time_get(u32 epoch)
-{
-    assert(alarm_pthread_mutex_locked);
-    assert(epoch != MAX_U32);
-
-    alarm_time_node *time_node = time_list.next;
-
-    while(time_node->epoch < epoch)
+    
+    if(handle_list->first != handle_list->last)
     {
-        time_node = time_node->next;
-    }
+        /*
+         * Insert the node before the last one.
+         */
+        
+        handle_list->last->hndl_prev->hndl_next = node;    // BL ->N   L
+        node->hndl_prev = handle_list->last->hndl_prev;    // BL<->N   L
 
-    if(time_node->epoch == epoch)
-    {
-#ifdef DEBUG
-        log_debug6("alarm_time_get(%T) = %p", epoch, time_node);
-#endif
-        return time_node;
+        handle_list->last->hndl_prev = node;               // BL<->N<- L
+        node->hndl_next = handle_list->last;               // BL<->N<->L
     }
     else
     {
+        handle_list->first = node;                         // F = N   L
+        node->hndl_next = handle_list->last;               //   ->F ->L
+        handle_list->last->hndl_prev = node;               //   ->F<->L
+        node->hndl_prev = NULL;                     // 0<->F<->L
+    }
+    
 #ifdef DEBUG
-        log_debug6("alarm_time_get(%T) = %p", epoch, NULL);
+    ++alarm_event_in_handles_count;
 #endif
-        return NULL;
-    }
+    
+    alarm_wheel_insert(node);
 }
 
-static alarm_time_node *
-alarm_time_create(u32 epoch)
+/**
+ * Removes the node from both the handle list and the wheel.
+ * Does not releases memory.
+ * 
+ * @param handle_list
+ * @param node
+ */
+
+static void
+alarm_event_remove(alarm_event_list *handle_list, alarm_event_node *node)
 {
     assert(alarm_pthread_mutex_locked);
-    assert(epoch > 0);
-    assert(epoch != MAX_U32);
-        
-    alarm_time_node *time_prev = &time_list;
-    alarm_time_node *time_node = time_list.next;
+    assert(node != NULL);
     
-    // find a node at or after the one we need
-
-    while(time_node->epoch < epoch)
-    {
-        time_prev = time_node;
-        time_node = time_node->next;
-        
-        assert(time_node->epoch > time_prev->epoch);
-    }
-
-    // if it's a match, return it
-
-    if(time_node->epoch == epoch)
-    {
-#ifdef DEBUG
-        log_debug6("alarm_time_create(%T) = %p", epoch, time_node);
-#endif
-
-        return time_node;
-    }
-    else // else insert a node just after it
-    {
-
-        alarm_time_node *new_time_node = alarm_time_alloc();
-        time_prev->next = new_time_node;
-        new_time_node->next = time_node;
-        new_time_node->epoch = epoch;
-
 #ifdef DEBUG
-        log_debug6("alarm_time_create(%T) = %p", epoch, new_time_node);
+    log_debug6("alarm_event_remove(%p,%p %08x '%s' %T)", handle_list, node, node->key, node->text, node->epoch);
 #endif
-
-        return new_time_node;
-    }
+    
+    alarm_event_handle_remove(handle_list, node);
+    alarm_wheel_unlink(node);
 }
 
 void
@@ -523,7 +507,22 @@ alarm_init()
     {
         ptr_vector_resize(&alarm_handles, 64);
 
-        alarm_event_list_init(&time_list.events); /* init: NO LOCK */
+        for(int i = 0; i < ALARM_WHEEL_ROOT_SIZE; ++i)
+        {
+            alarm_wheel_slot_init(&alarm_wheel_root[i]);
+        }
+        
+        for(int level = 0; level < ALARM_WHEEL_LEVELS; ++level)
+        {
+            for(int i = 0; i < ALARM_WHEEL_LEVEL_SIZE; ++i)
+            {
+                alarm_wheel_slot_init(&alarm_wheel_level[level][i]);
+            }
+        }
+        
+        alarm_wheel_slot_init(&alarm_wheel_expired);
+        
+        alarm_wheel_now = time(NULL);
     }
 }
 
@@ -568,18 +567,11 @@ alarm_finalise()
         
         pthread_mutex_lock(&alarm_mutex);
         
-        if(alarm_event_list_isempty(&time_list.events))
-        {
-            alarm_event_list_finalize(&time_list.events);
-        }
-        else
-        {
-            log_debug("alarm: event list not empty");
-        }
-        
         ptr_vector_destroy(&alarm_handles);
     }
 
+    ptr_vector_destroy(&to_close);
+    
 #ifdef DEBUG
     alarm_pthread_mutex_locked = FALSE;
 #endif
@@ -678,30 +670,18 @@ alarm_handle_close(alarm_handle *handle_struct)
 #ifdef DEBUG
     u32 removed_events = 0;
 #endif
-    
-    bool obsolete_times = FALSE;
 
-    while(node != NULL)
+    // every event of the handle is removed from the wheel in O(1)
+    
+    while(node != handle_struct->events.last)
     {   
         alarm_event_node *node_next = node->hndl_next;
         
-        alarm_time_node *time_node = alarm_time_get(node->epoch);
-        
-        if(time_node != NULL)
-        {
-            alarm_event_list *time_list = &time_node->events;
-
-            alarm_event_remove(&handle_struct->events, time_list, node);
-            
-            if(alarm_event_list_isempty(&time_node->events))
-            {
-                obsolete_times = TRUE;
-            }
+        alarm_event_remove(&handle_struct->events, node);
             
 #ifdef DEBUG
-            ++removed_events;
+        ++removed_events;
 #endif
-        }
         
         if(node->function != NULL)
         {
@@ -713,29 +693,7 @@ alarm_handle_close(alarm_handle *handle_struct)
         node = node_next;
     }
     
-    // clear the obsolete times
-    
-    if(obsolete_times)
-    {
-        
-        alarm_time_node *time_node_prev = &time_list;
-        alarm_time_node *time_node = time_node_prev->next;
-        
-        while(time_node->next != NULL)
-        {
-            if(!alarm_event_list_isempty(&time_node->events))
-            {
-                time_node_prev = time_node;
-                time_node = time_node->next;
-            }
-            else
-            {
-                time_node_prev->next = time_node->next;                
-                alarm_time_free(time_node);
-                time_node = time_node_prev->next;
-            }
-        }
-    }
+    alarm_event_free(handle_struct->events.last); // the sentinel
     
 #ifdef DEBUG
     log_debug("alarm_handle_close(%p) removed %u events for %{dnsname}",
@@ -876,12 +834,10 @@ alarm_set(alarm_t hndl, alarm_event_node *desc)
 
                     alarm_event_node *node_next = node->hndl_next;
                     
-                    alarm_time_node *events_node_at_epoch = alarm_time_get(node->epoch);
 #ifdef DEBUG
-                    log_debug6("about to alarm_event_remove(%p,%p,%p %08x '%s' %T) (earlier)", hndl, &events_node_at_epoch->events, node, node->key, node->text, node->epoch);
+                    log_debug6("about to alarm_event_remove(%p,%p %08x '%s' %T) (earlier)", hndl, node, node->key, node->text, node->epoch);
 #endif
-                    yassert(events_node_at_epoch != NULL);
-                    alarm_event_remove(head, &events_node_at_epoch->events, node);
+                    alarm_event_remove(head, node);
                     
                     // cancel the event
                     node->function(node->args, TRUE);
@@ -924,12 +880,10 @@ alarm_set(alarm_t hndl, alarm_event_node *desc)
                     }
                     
                     alarm_event_node *node_next = node->hndl_next;
-                    alarm_time_node *events_node_at_epoch = alarm_time_get(node->epoch);
 #ifdef DEBUG
-                    log_debug6("alarm_set: about to alarm_event_remove(%p,%p,%p %08x '%s' %T) (latest)", head, &events_node_at_epoch->events, node, node->key, node->text, node->epoch);
+                    log_debug6("alarm_set: about to alarm_event_remove(%p,%p %08x '%s' %T) (latest)", head, node, node->key, node->text, node->epoch);
 #endif
-                    yassert(events_node_at_epoch != NULL);
-                    alarm_event_remove(head, &events_node_at_epoch->events, node);
+                    alarm_event_remove(head, node);
                     
                     // cancel the event
                     node->function(node->args, TRUE);
@@ -948,14 +902,10 @@ alarm_set(alarm_t hndl, alarm_event_node *desc)
     log_debug("alarm_set: %p: added", desc);
 #endif
 
-    /* Create/get the time head */
-
-    alarm_time_node *time_node = alarm_time_create(desc->epoch);
-
-    /* Link desc at the end of time list and in the hndl list */
+    /* Link desc in the wheel and at the end of the hndl list */
 
     desc->handle = hndl;
-    alarm_event_append(head, &time_node->events, desc);
+    alarm_event_append(head, desc);
 
 #ifdef DEBUG
     alarm_pthread_mutex_locked = FALSE;
@@ -978,51 +928,62 @@ alarm_run_tick(u32 epoch)
     s64 fetch_start = timeus();
     s32 event_count = 0;
     
-    // while the time node is in the past or the present
+    // gather the events up to the epoch: the ones set for the past, then second by second
     
-    alarm_event_node event_dummy;
-    alarm_event_node *event_stack = &event_dummy;
+    alarm_event_node due;
+    alarm_wheel_slot_init(&due);
     
-    for(;;)
+    alarm_wheel_slot_move_all(&alarm_wheel_expired, &due);
+    
+    if(epoch > alarm_wheel_now)
     {
-        // detach the node
-        
-        alarm_time_node *time_node = time_list.next;
-                
-        if(time_node->epoch > epoch)
+        if(epoch - alarm_wheel_now < ALARM_WHEEL_SPAN)
         {
-            break;
+            while(alarm_wheel_now < epoch)
+            {
+                alarm_wheel_advance(&due);
+            }
         }
-        
-        time_list.next = time_node->next;
-        
-        // while there are events in the time node
-                
-        while(!alarm_event_list_isempty(&time_node->events))
+        else
         {
-            // process all the events at that time
+            // the clock jumped: the due events end up in the expired slot
             
-            // take the next event of the time node
-            alarm_event_node *event = alarm_event_list_removefirst(&time_node->events);
+            log_debug("alarm: time moved from %u to %u, rebasing the wheel", alarm_wheel_now, epoch);
             
-            event_stack->time_next = event;
-            event_stack = event;
-            
-            ++event_count;
+            alarm_wheel_rebase(epoch);
+            alarm_wheel_slot_move_all(&alarm_wheel_expired, &due);
         }
+    }
+    else if(epoch < alarm_wheel_now)
+    {
+        // the clock went back: the wheel follows, else the events set from now on up to the old time would run early
+        
+        log_debug("alarm: time moved back from %u to %u, rebasing the wheel", alarm_wheel_now, epoch);
         
-        yassert(time_node->events.first->time_prev == NULL);
-        yassert(time_node->events.last->time_next == NULL);
-        yassert(time_node->events.first == time_node->events.last);
+        alarm_wheel_rebase(epoch);
+    }
+    
+    // detach the events from their handle and stack them (using time_next) for the execution
+    
+    alarm_event_node event_dummy;
+    alarm_event_node *event_stack = &event_dummy;
+    
+    while(!alarm_wheel_slot_isempty(&due))
+    {
+        alarm_event_node *event = due.time_next;
+        alarm_wheel_unlink(event);
+        
+        alarm_event_list *handle_list = (alarm_event_list*)ptr_vector_get(&alarm_handles, event->handle);
+        alarm_event_handle_remove(handle_list, event);
         
 #ifdef DEBUG
-        log_debug("alarm: releasing time node %d@%p, next time node is %d@%p",
-                time_node->epoch, time_node,
-                time_node->next->epoch, time_node->next
-                );
+        log_debug6("alarm: %p %08x '%s' %T is due", event, event->key, event->text, event->epoch);
 #endif
         
-        alarm_time_free(time_node);
+        event_stack->time_next = event;
+        event_stack = event;
+
+        ++event_count;
     }
     
     s64 fetch_stop = timeus();
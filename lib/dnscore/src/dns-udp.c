@@ -32,7 +32,11 @@
 *
 */
 
+#define _GNU_SOURCE 1 // recvmmsg, before any header
+
 #include "dnscore/dnscore-config.h"
+
+#include <sys/socket.h>
 #include <netinet/in.h>
 #include <signal.h>
 #include <unistd.h>
@@ -79,6 +83,13 @@ extern logger_handle *g_system_logger;
 
 #define DNS_UDP_READ_BUFFER_COUNT       4096
 
+#if defined(__linux__) && defined(MSG_WAITFORONE)
+#define DNS_UDP_HAS_RECVMMSG            1
+#define DNS_UDP_RECV_BATCH              32      // datagrams read with one call
+#else
+#define DNS_UDP_HAS_RECVMMSG            0
+#endif
+
 static const u8 V4_WRAPPED_IN_V6[12] = {0,0,0,0,0,0,0,0,0,0,255,255};
 
 static struct service_s dns_udp_send_handler = UNINITIALIZED_SERVICE;
@@ -131,12 +142,80 @@ static struct thread_pool_s *tcp_query_thread_pool = NULL;
 
 static int dns_udp_send_simple_message_node_compare(const void *key_a, const void *key_b);
 
-static ptr_set message_collection = { NULL, dns_udp_send_simple_message_node_compare };
-static mutex_t message_collection_mtx = MUTEX_INITIALIZER;
+/**
+ * The queries waiting for an answer are spread over shards, each with its own lock.
+ * The shard is chosen using a hash of the key (class, type, name server, fqdn) so
+ * senders, receivers and the timeout service only contend on the same shard.
+ * This keeps each tree small and the locks short with a large number of queries in flight.
+ */
+
+#define DNS_UDP_MESSAGE_COLLECTION_SHARDS 64 // must be a power of 2
+
+struct dns_udp_message_collection_shard_s
+{
+    mutex_t mtx;
+    ptr_set set;
+} __attribute__((aligned(64)));
+
+typedef struct dns_udp_message_collection_shard_s dns_udp_message_collection_shard_s;
+
+static dns_udp_message_collection_shard_s message_collection[DNS_UDP_MESSAGE_COLLECTION_SHARDS];
 
 static volatile s64 message_collection_keys = 0;
 static volatile s64 message_collection_size = 0;
 
+/**
+ * FNV-1a
+ */
+
+static inline u32
+dns_udp_hash_bytes(u32 h, const u8 *bytes, size_t size)
+{
+    for(size_t i = 0; i < size; ++i)
+    {
+        h ^= bytes[i];
+        h *= 16777619U;
+    }
+    
+    return h;
+}
+
+static u32
+dns_udp_host_address_hash(const host_address *host)
+{
+    u32 h = 2166136261U;
+    
+    switch(host->version)
+    {
+        case HOST_ADDRESS_IPV4:
+            h = dns_udp_hash_bytes(h, host->ip.v4.bytes, 4);
+            break;
+        case HOST_ADDRESS_IPV6:
+            h = dns_udp_hash_bytes(h, host->ip.v6.bytes, 16);
+            break;
+        case HOST_ADDRESS_DNAME:
+            h = dns_udp_hash_bytes(h, host->ip.dname.dname, dnsname_len(host->ip.dname.dname));
+            break;
+    }
+    
+    h = dns_udp_hash_bytes(h, (const u8*)&host->port, sizeof(host->port));
+    h = dns_udp_hash_bytes(h, &host->version, 1);
+    
+    return h;
+}
+
+static inline dns_udp_message_collection_shard_s*
+dns_udp_message_collection_shard_get(const dns_simple_message_s *simple_message)
+{
+    u32 h = dns_udp_host_address_hash(simple_message->name_server);
+    h = dns_udp_hash_bytes(h, simple_message->fqdn, dnsname_len(simple_message->fqdn));
+    h = dns_udp_hash_bytes(h, (const u8*)&simple_message->qtype, sizeof(simple_message->qtype));
+    h = dns_udp_hash_bytes(h, (const u8*)&simple_message->qclass, sizeof(simple_message->qclass));
+    h ^= h >> 16;
+    
+    return &message_collection[h & (DNS_UDP_MESSAGE_COLLECTION_SHARDS - 1)];
+}
+
 static const dns_udp_settings_s default_dns_udp_settings =
 {
     DNS_UDP_TIMEOUT_US,
@@ -196,9 +275,23 @@ static mutex_t limiter_recv_wait_mtx = MUTEX_INITIALIZER;
 /**
  * @note edf 20170905 -- this is for limiting the global packets sent per second
  * 
+ * The queries are paced by the limiters of their host, so this one is only a safety limit:
+ * it follows the sum of the rates of the hosts, and never goes below the configured send rate.
  */
 
 static limiter_t dns_udp_send_rate;
+static mutex_t dns_udp_send_rate_mtx = MUTEX_INITIALIZER;
+static u64 dns_udp_host_rate_total = 0;
+
+static void
+dns_udp_send_rate_update(s64 host_rate_delta)
+{
+    mutex_lock(&dns_udp_send_rate_mtx);
+    dns_udp_host_rate_total += host_rate_delta;
+    u64 rate = BOUND((u64)dns_udp_settings->send_rate, dns_udp_host_rate_total, (u64)DNS_UDP_SEND_RATE_MAX);
+    __atomic_store_n(&dns_udp_send_rate.rate_max, (limiter_count_t)rate, __ATOMIC_RELAXED); // read by the senders
+    mutex_unlock(&dns_udp_send_rate_mtx);
+}
 
 /**
  * @note edf 20170905 -- this is for limiting the global recv bandwidth
@@ -208,13 +301,56 @@ static limiter_t dns_udp_send_rate;
 
 static limiter_t dns_udp_recv_bandwidth;
 
-static struct ptr_set host_state_set = PTR_SET_EMPTY_WITH_COMPARATOR(dns_udp_host_state_node_compare);
-static mutex_t host_state_set_mtx = MUTEX_INITIALIZER;
+/**
+ * The per-host limiters are sharded the same way as the pending queries.
+ */
+
+#define DNS_UDP_HOST_STATE_SHARDS 64 // must be a power of 2
+
+struct dns_udp_host_state_shard_s
+{
+    mutex_t mtx;
+    ptr_set set;
+} __attribute__((aligned(64)));
+
+typedef struct dns_udp_host_state_shard_s dns_udp_host_state_shard_s;
+
+static dns_udp_host_state_shard_s host_state_set[DNS_UDP_HOST_STATE_SHARDS];
+
+static pthread_once_t dns_udp_shards_once = PTHREAD_ONCE_INIT;
+
+static void
+dns_udp_shards_init()
+{
+    for(int i = 0; i < DNS_UDP_MESSAGE_COLLECTION_SHARDS; ++i)
+    {
+        mutex_init(&message_collection[i].mtx);
+        message_collection[i].set.root = NULL;
+        message_collection[i].set.compare = dns_udp_send_simple_message_node_compare;
+    }
+    
+    for(int i = 0; i < DNS_UDP_HOST_STATE_SHARDS; ++i)
+    {
+        mutex_init(&host_state_set[i].mtx);
+        host_state_set[i].set.root = NULL;
+        host_state_set[i].set.compare = dns_udp_host_state_node_compare;
+    }
+}
+
+static inline dns_udp_host_state_shard_s*
+dns_udp_host_state_shard_get(const host_address* host)
+{
+    (void) pthread_once(&dns_udp_shards_once, dns_udp_shards_init);
+    
+    u32 h = dns_udp_host_address_hash(host);
+    h ^= h >> 16;
+    return &host_state_set[h & (DNS_UDP_HOST_STATE_SHARDS - 1)];
+}
 
 static dns_udp_host_state_s*
-dns_udp_host_state_get_nolock(const host_address* host)
+dns_udp_host_state_get_nolock(dns_udp_host_state_shard_s *shard, const host_address* host)
 {
-    ptr_node* node = ptr_set_avl_insert(&host_state_set, (host_address*)host);
+    ptr_node* node = ptr_set_avl_insert(&shard->set, (host_address*)host);
     dns_udp_host_state_s* state;
     
     if(node->value == NULL)
@@ -226,6 +362,8 @@ dns_udp_host_state_get_nolock(const host_address* host)
         limiter_init(&state->send_rate, dns_udp_settings->per_dns_rate);
         limiter_set_wait_time(&state->send_rate, dns_udp_settings->per_dns_freq_min);
         node->value = state;
+        
+        dns_udp_send_rate_update(dns_udp_settings->per_dns_rate);
     }
     
     state = (dns_udp_host_state_s*)node->value;
@@ -236,9 +374,11 @@ dns_udp_host_state_get_nolock(const host_address* host)
 u64
 dns_udp_host_state_packet_try(host_address* host, u32 size)
 {
-    mutex_lock(&host_state_set_mtx);
+    dns_udp_host_state_shard_s *shard = dns_udp_host_state_shard_get(host);
     
-    dns_udp_host_state_s* state = dns_udp_host_state_get_nolock(host);
+    mutex_lock(&shard->mtx);
+    
+    dns_udp_host_state_s* state = dns_udp_host_state_get_nolock(shard, host);
     limiter_count_t available_now;
     u64 rate_wait_time;
     u64 bandwidth_wait_time = 0;
@@ -261,7 +401,7 @@ dns_udp_host_state_packet_try(host_address* host, u32 size)
                         
             // can be sent now
             
-            mutex_unlock(&host_state_set_mtx);
+            mutex_unlock(&shard->mtx);
             return 0;
         }
     }
@@ -272,7 +412,7 @@ dns_udp_host_state_packet_try(host_address* host, u32 size)
     
     u64 delay_epoch_us = (now + MAX(rate_wait_time, bandwidth_wait_time) + (LIMIT_DELAYED_SET_GRANULARITY_WINDOW - 1)) & ~LIMIT_DELAYED_SET_GRANULARITY_WINDOW;
     
-    mutex_unlock(&host_state_set_mtx);
+    mutex_unlock(&shard->mtx);
     return delay_epoch_us;
 }
 
@@ -461,15 +601,19 @@ void dns_udp_handler_host_limit_set(const host_address* name_server,
         u32 bandwidth,
         u32 freq_min)
 {
-    mutex_lock(&host_state_set_mtx);
+    dns_udp_host_state_shard_s *shard = dns_udp_host_state_shard_get(name_server);
+    
+    mutex_lock(&shard->mtx);
     
-    dns_udp_host_state_s* state = dns_udp_host_state_get_nolock(name_server);
+    dns_udp_host_state_s* state = dns_udp_host_state_get_nolock(shard, name_server);
+    
+    dns_udp_send_rate_update((s64)rate - (s64)state->send_rate.rate_max);
     
     limiter_init(&state->send_bandwidth, bandwidth);
     limiter_init(&state->send_rate, rate);
     limiter_set_wait_time(&state->send_rate, freq_min);
     
-    mutex_unlock(&host_state_set_mtx);
+    mutex_unlock(&shard->mtx);
 }
 
 int 
@@ -1257,7 +1401,7 @@ dns_udp_simple_message_release(dns_simple_message_s *simple_message)
             if(node->async != NULL)
             {
                 async_message_release(node->async);
-                --message_collection_size;
+                __sync_fetch_and_sub(&message_collection_size, 1);
                 node->async = NULL;
             }
             
@@ -1477,12 +1621,13 @@ dns_udp_send_simple_message_process(async_message_s *domain_message, random_ctx
     /// @note: at this point, in a normal usage, the RC of simple_message should be 2
     
     // lock the collection
-    mutex_lock(&message_collection_mtx); // lock A
+    dns_udp_message_collection_shard_s *shard = dns_udp_message_collection_shard_get(simple_message);
+    mutex_lock(&shard->mtx); // lock A
 
     // lock the simple message
     dns_udp_simple_message_lock(simple_message); // lock B
     
-    ptr_node *node = ptr_set_avl_insert(&message_collection, simple_message);
+    ptr_node *node = ptr_set_avl_insert(&shard->set, simple_message);
         
     simple_message->status |= DNS_SIMPLE_MESSAGE_STATUS_COLLECTED;
     simple_message->status &= ~DNS_SIMPLE_MESSAGE_STATUS_QUEUED;
@@ -1493,7 +1638,7 @@ dns_udp_send_simple_message_process(async_message_s *domain_message, random_ctx
     
     if(node->value == NULL)
     {
-        ++message_collection_keys;
+        __sync_fetch_and_add(&message_collection_keys, 1);
         
         // newly inserted
         // put in pending collection
@@ -1501,7 +1646,7 @@ dns_udp_send_simple_message_process(async_message_s *domain_message, random_ctx
         
         node->value = domain_message;
         
-        mutex_unlock(&message_collection_mtx); // unlock A
+        mutex_unlock(&shard->mtx); // unlock A
         
         dns_udp_simple_message_lock(simple_message);
         log_debug5("set message@%p: %{dnsname} %{dnstype} %{dnsclass} to %{hostaddr} %s (%x)",
@@ -1633,13 +1778,13 @@ dns_udp_send_simple_message_process(async_message_s *domain_message, random_ctx
 
         dns_udp_simple_message_unlock(simple_message);
         
-        mutex_lock(&message_collection_mtx);
+        mutex_lock(&shard->mtx);
         // ensure that the node still exists
-        ptr_node *node = ptr_set_avl_find(&message_collection, simple_message);
+        ptr_node *node = ptr_set_avl_find(&shard->set, simple_message);
         if(node != NULL)
         {
-            ptr_set_avl_delete(&message_collection, simple_message);
-            --message_collection_keys;
+            ptr_set_avl_delete(&shard->set, simple_message);
+            __sync_fetch_and_sub(&message_collection_keys, 1);
             // one RC can be released for the collection
             dns_udp_simple_message_lock(simple_message);
             simple_message->status &= ~DNS_SIMPLE_MESSAGE_STATUS_COLLECTED;
@@ -1651,7 +1796,7 @@ dns_udp_send_simple_message_process(async_message_s *domain_message, random_ctx
             // even if this is possible, this should NEVER happen
             log_debug6("message @%p had been removed from the collection already", simple_message);
         }
-        mutex_unlock(&message_collection_mtx);
+        mutex_unlock(&shard->mtx);
 
         /// @note RC = 1
         // the handler NEEDS to do the final release
@@ -1671,9 +1816,9 @@ dns_udp_send_simple_message_process(async_message_s *domain_message, random_ctx
         // aggregate /append simple_message to first_message
         
         dns_udp_aggregate_simple_messages(old_message, simple_message);
-        ++message_collection_size;
+        __sync_fetch_and_add(&message_collection_size, 1);
         
-        mutex_unlock(&message_collection_mtx);
+        mutex_unlock(&shard->mtx);
         
         // one RC can be released from the collection
         dns_udp_simple_message_release(simple_message);
@@ -1884,6 +2029,8 @@ dns_udp_receive_ctx_available(dns_udp_receive_ctx *ctx)
     return avail;
 }
 
+#if !DNS_UDP_HAS_RECVMMSG
+
 static ssize_t
 dns_udp_receive_ctx_wait_to_read(dns_udp_receive_ctx *ctx)
 {
@@ -1917,6 +2064,56 @@ dns_udp_receive_ctx_notify_read(dns_udp_receive_ctx *ctx)
     mutex_unlock(&ctx->mtx);
 }
 
+#else
+
+/**
+ * Waits for free slots to read into.
+ * 
+ * @param ctx the receive context
+ * @param countp will receive the number of free slots, contiguous from the returned index
+ * 
+ * @return the index of the first free slot, or -1 if none got available in time
+ */
+
+static ssize_t
+dns_udp_receive_ctx_wait_to_read_batch(dns_udp_receive_ctx *ctx, size_t *countp)
+{
+    mutex_lock(&ctx->mtx);
+    size_t avail;
+    for(;;)
+    {
+        avail = ctx->count - (ctx->read_index - ctx->proc_index);
+        
+        if(avail != 0)
+        {
+            break;
+        }
+        
+        if(cond_timedwait(&ctx->cond, &ctx->mtx, 1000000ULL) != 0)
+        {
+            mutex_unlock(&ctx->mtx);
+            return -1;
+        }
+    }
+    mutex_unlock(&ctx->mtx);
+    
+    size_t index = ctx->read_index % ctx->count;
+    *countp = MIN(avail, ctx->count - index);
+    
+    return index;
+}
+
+static void
+dns_udp_receive_ctx_notify_read_batch(dns_udp_receive_ctx *ctx, size_t count)
+{
+    mutex_lock(&ctx->mtx);
+    ctx->read_index += count;
+    cond_notify(&ctx->cond);
+    mutex_unlock(&ctx->mtx);
+}
+
+#endif
+
 static ssize_t
 dns_udp_receive_ctx_wait_to_process(dns_udp_receive_ctx *ctx)
 {
@@ -1969,10 +2166,65 @@ dns_udp_receive_read_service(struct service_worker_s *worker)
     
     tcp_set_recvtimeout(my_socket, dns_udp_settings->timeout / 1000000LL, dns_udp_settings->timeout % 1000000LL);
     
+#if DNS_UDP_HAS_RECVMMSG
+    struct mmsghdr msgs[DNS_UDP_RECV_BATCH];
+    struct iovec iovs[DNS_UDP_RECV_BATCH];
+    ZEROMEMORY(msgs, sizeof(msgs));
+#endif
+    
     while(service_shouldrun(worker))
     {
         int n;
         
+#if DNS_UDP_HAS_RECVMMSG
+        // read as many datagrams as there are contiguous free slots (up to the batch size) in one call
+        
+        size_t batch;
+        
+        ssize_t index = dns_udp_receive_ctx_wait_to_read_batch(ctx, &batch);
+        
+        if(index < 0)
+        {
+            continue;
+        }
+        
+        batch = MIN(batch, DNS_UDP_RECV_BATCH);
+        
+        for(size_t i = 0; i < batch; ++i)
+        {
+            iovs[i].iov_base = &ctx->messages[index + i];
+            iovs[i].iov_len = sizeof(ctx->messages[index + i]);
+            msgs[i].msg_hdr.msg_name = &ctx->addresses[index + i].sa.sa;
+            msgs[i].msg_hdr.msg_namelen = sizeof(socketaddress);
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        
+        log_debug6("receive: recvmmsg(%i, ..., %llu) in %lli", my_socket, batch, index);
+        
+        if((n = recvmmsg(my_socket, msgs, batch, MSG_WAITFORONE, NULL)) >= 0)
+        {
+            if(n > 0)
+            {
+                log_debug6("receive: recvmmsg(%i, ..., %llu) = %i", my_socket, batch, n);
+                
+                time_t now = time(NULL);
+                
+                // empty datagrams keep their slot, the processing service ignores them
+                
+                for(int i = 0; i < n; ++i)
+                {
+                    ctx->addresses[index + i].sa_len = msgs[i].msg_hdr.msg_namelen;
+                    ctx->addresses[index + i].epoch = now;
+                    ctx->addresses[index + i].msg_len = msgs[i].msg_len;
+                }
+                
+                dns_udp_receive_ctx_notify_read_batch(ctx, n);
+            }
+            
+            continue;
+        }
+#else
         ssize_t index = dns_udp_receive_ctx_wait_to_read(ctx);
         
         if(index < 0)
@@ -1998,28 +2250,29 @@ dns_udp_receive_read_service(struct service_worker_s *worker)
             {
                 log_debug6("receive: recvfrom(%i, ... , %{sockaddr}) = 0 = empty packet (ignoring)", my_socket, &ctx->addresses[index].sa.sa);
             }
+            
+            continue;
         }
-        else
-        {
-            int err = errno;
+#endif
+        
+        int err = errno;
 
-            if(err == EINTR)
-            {
+        if(err == EINTR)
+        {
 #ifdef DEBUG
-                log_debug7("receive: recvfrom EINTR");
+            log_debug7("receive: recvfrom EINTR");
 #endif
-                continue;
-            }
-            if(err == EAGAIN)
-            {
+            continue;
+        }
+        if(err == EAGAIN)
+        {
 #ifdef DEBUG
-                log_debug7("receive: recvfrom EAGAIN");
+            log_debug7("receive: recvfrom EAGAIN");
 #endif
-                continue;
-            }
-                
-            log_err("receive: recvfrom error: %r", MAKE_ERRNO_ERROR(err));
+            continue;
         }
+
+        log_err("receive: recvfrom error: %r", MAKE_ERRNO_ERROR(err));
     }
     
     service_set_stopping(worker);
@@ -2077,6 +2330,14 @@ dns_udp_receive_process_service(struct service_worker_s *worker)
         size_t n = ctx->addresses[index].msg_len;
         time_t now = ctx->addresses[index].epoch;
         
+        if(n == 0)
+        {
+            // empty datagram (only kept by batched reads)
+            
+            dns_udp_receive_ctx_notify_process(ctx);
+            continue;
+        }
+        
         mutex_lock(&limiter_recv_wait_mtx);
         // force add the received bytes to the limit (this feels insufficient)
         limiter_add_anyway(&dns_udp_recv_bandwidth, n, NULL, NULL);
@@ -2144,9 +2405,11 @@ dns_udp_receive_process_service(struct service_worker_s *worker)
 
                 // remove it from the collection
 
-                mutex_lock(&message_collection_mtx);
+                dns_udp_message_collection_shard_s *shard = dns_udp_message_collection_shard_get(&message);
+
+                mutex_lock(&shard->mtx);
 
-                ptr_node *node = ptr_set_avl_find(&message_collection, &message);
+                ptr_node *node = ptr_set_avl_find(&shard->set, &message);
 
                 if(node != NULL)
                 {
@@ -2158,8 +2421,8 @@ dns_udp_receive_process_service(struct service_worker_s *worker)
 
                     dns_udp_simple_message_lock(simple_message);
 
-                    ptr_set_avl_delete(&message_collection, simple_message);
-                    --message_collection_keys;
+                    ptr_set_avl_delete(&shard->set, simple_message);
+                    __sync_fetch_and_sub(&message_collection_keys, 1);
 
                     // the message is not in the timeout collection anymore
                     // it should contain an answer, or an error, ... or a message with the TC bit on
@@ -2172,7 +2435,7 @@ dns_udp_receive_process_service(struct service_worker_s *worker)
 
                     dns_udp_simple_message_unlock(simple_message);
 
-                    mutex_unlock(&message_collection_mtx);
+                    mutex_unlock(&shard->mtx);
 
                     // RC is supposed to be 1
 #ifdef DEBUG
@@ -2215,7 +2478,7 @@ dns_udp_receive_process_service(struct service_worker_s *worker)
                 }
                 else
                 {
-                    mutex_unlock(&message_collection_mtx);
+                    mutex_unlock(&shard->mtx);
 
                     // unknown
 
@@ -2252,15 +2515,16 @@ dns_udp_receive_process_service(struct service_worker_s *worker)
 }
 
 static void
-dns_udp_timeout_service_cull(ptr_vector *todeletep)
+dns_udp_timeout_service_cull_shard(dns_udp_message_collection_shard_s *shard, ptr_vector *todeletep, int *messages_countp, int *failed_triesp)
 {
     int messages_count = 0;
     int failed_tries = 0;
+    int first_index = ptr_vector_size(todeletep);
 
-    mutex_lock(&message_collection_mtx);
+    mutex_lock(&shard->mtx);
 
     ptr_set_avl_iterator iter;
-    ptr_set_avl_iterator_init(&message_collection, &iter);
+    ptr_set_avl_iterator_init(&shard->set, &iter);
     while(ptr_set_avl_iterator_hasnext(&iter))
     {
         ptr_node *node = ptr_set_avl_iterator_next_node(&iter);
@@ -2302,24 +2566,41 @@ dns_udp_timeout_service_cull(ptr_vector *todeletep)
         }
     }
 
-    if(failed_tries > 0)
-    {
-        log_warn("timeout: failed to lock %i messages (on a total of %i)", failed_tries, messages_count);
-    }
-
-    for(int i = 0; i <= ptr_vector_last_index(todeletep); i++)
+    for(int i = first_index; i <= ptr_vector_last_index(todeletep); i++)
     {
         dns_simple_message_s *simple_message = (dns_simple_message_s *)ptr_vector_get(todeletep, i);
 
-        ptr_set_avl_delete(&message_collection, simple_message);
+        ptr_set_avl_delete(&shard->set, simple_message);
         // release because it has been removed from one collection
-        --message_collection_keys;
+        __sync_fetch_and_sub(&message_collection_keys, 1);
         dns_udp_simple_message_release(simple_message);
 
         simple_message->status &= ~DNS_SIMPLE_MESSAGE_STATUS_COLLECTED;
     }
 
-    mutex_unlock(&message_collection_mtx);
+    mutex_unlock(&shard->mtx);
+    
+    *messages_countp += messages_count;
+    *failed_triesp += failed_tries;
+}
+
+static void
+dns_udp_timeout_service_cull(ptr_vector *todeletep)
+{
+    int messages_count = 0;
+    int failed_tries = 0;
+    
+    // one shard at a time so the senders and the receivers are only blocked on a fraction of the collection
+    
+    for(int i = 0; i < DNS_UDP_MESSAGE_COLLECTION_SHARDS; ++i)
+    {
+        dns_udp_timeout_service_cull_shard(&message_collection[i], todeletep, &messages_count, &failed_tries);
+    }
+
+    if(failed_tries > 0)
+    {
+        log_warn("timeout: failed to lock %i messages (on a total of %i)", failed_tries, messages_count);
+    }
 }
 
 static int
@@ -2421,77 +2702,83 @@ dns_udp_cancel_all_queries()
 
     u64 now = timeus();
     
-    mutex_lock(&message_collection_mtx);
-
-    ptr_set_avl_iterator iter;
-    ptr_set_avl_iterator_init(&message_collection, &iter);
-    while(ptr_set_avl_iterator_hasnext(&iter))
+    for(int shard_index = 0; shard_index < DNS_UDP_MESSAGE_COLLECTION_SHARDS; ++shard_index)
     {
-        ptr_node *node = ptr_set_avl_iterator_next_node(&iter);
-        dns_simple_message_s *simple_message = (dns_simple_message_s *)node->key;
-
-        messages_count++;
+        dns_udp_message_collection_shard_s *shard = &message_collection[shard_index];
+        int first_index = ptr_vector_size(&todelete);
+        
+        mutex_lock(&shard->mtx);
 
-        if(dns_udp_simple_message_trylock(simple_message))
+        ptr_set_avl_iterator iter;
+        ptr_set_avl_iterator_init(&shard->set, &iter);
+        while(ptr_set_avl_iterator_hasnext(&iter))
         {
-            now = timeus();
+            ptr_node *node = ptr_set_avl_iterator_next_node(&iter);
+            dns_simple_message_s *simple_message = (dns_simple_message_s *)node->key;
 
-            if(simple_message->sent_time_us != MAX_S64)
+            messages_count++;
+
+            if(dns_udp_simple_message_trylock(simple_message))
             {
-#ifdef DEBUG
-                if(now <  simple_message->sent_time_us)
+                now = timeus();
+
+                if(simple_message->sent_time_us != MAX_S64)
                 {
-                    log_debug("message was sent %llu in the future! (sent at %llu, now is %llu, really %llu)", simple_message->sent_time_us - now, simple_message->sent_time_us, now, timeus());
-                }
+#ifdef DEBUG
+                    if(now <  simple_message->sent_time_us)
+                    {
+                        log_debug("message was sent %llu in the future! (sent at %llu, now is %llu, really %llu)", simple_message->sent_time_us - now, simple_message->sent_time_us, now, timeus());
+                    }
 #endif
 
-                if(now - simple_message->sent_time_us > dns_udp_settings->timeout) // older than 3s ? => remove
-                {
-                    // timed out
+                    if(now - simple_message->sent_time_us > dns_udp_settings->timeout) // older than 3s ? => remove
+                    {
+                        // timed out
 
-                    // retain because the reference is now in two collection
-                    dns_udp_simple_message_retain(simple_message);
+                        // retain because the reference is now in two collection
+                        dns_udp_simple_message_retain(simple_message);
 
-                    simple_message->status |= DNS_SIMPLE_MESSAGE_STATUS_TIMEDOUT|DNS_SIMPLE_MESSAGE_STATUS_INVALID;
-                    ptr_vector_append(&todelete, simple_message);
+                        simple_message->status |= DNS_SIMPLE_MESSAGE_STATUS_TIMEDOUT|DNS_SIMPLE_MESSAGE_STATUS_INVALID;
+                        ptr_vector_append(&todelete, simple_message);
+                    }
                 }
-            }
 #ifdef DEBUG
-            else
-            {
-                if(now - simple_message->sent_time_us > dns_udp_settings->timeout)
+                else
                 {
-                    log_warn("timeout: message would have wrongly been timed-out");
+                    if(now - simple_message->sent_time_us > dns_udp_settings->timeout)
+                    {
+                        log_warn("timeout: message would have wrongly been timed-out");
+                    }
                 }
-            }
 #endif
 
-            dns_udp_simple_message_unlock(simple_message);
+                dns_udp_simple_message_unlock(simple_message);
+            }
+            else
+            {
+                failed_tries++;
+            }
         }
-        else
+
+        for(int i = first_index; i <= ptr_vector_last_index(&todelete); i++)
         {
-            failed_tries++;
+            dns_simple_message_s *simple_message = (dns_simple_message_s *)ptr_vector_get(&todelete, i);
+
+            ptr_set_avl_delete(&shard->set, simple_message);
+            __sync_fetch_and_sub(&message_collection_keys, 1);
+            // release because it has been removed from one collection
+            dns_udp_simple_message_release(simple_message);
+
+            simple_message->status &= ~DNS_SIMPLE_MESSAGE_STATUS_COLLECTED;
         }
-    }
 
+        mutex_unlock(&shard->mtx);
+    }
+    
     if(failed_tries > 0)
     {
         log_warn("timeout: failed to lock %i messages (on a total of %i)", failed_tries, messages_count);
     }
-
-    for(int i = 0; i <= ptr_vector_last_index(&todelete); i++)
-    {
-        dns_simple_message_s *simple_message = (dns_simple_message_s *)ptr_vector_get(&todelete, i);
-
-        ptr_set_avl_delete(&message_collection, simple_message);
-        --message_collection_keys;
-        // release because it has been removed from one collection
-        dns_udp_simple_message_release(simple_message);
-
-        simple_message->status &= ~DNS_SIMPLE_MESSAGE_STATUS_COLLECTED;
-    }
-
-    mutex_unlock(&message_collection_mtx);
     
     for(int i = 0; i <= ptr_vector_last_index(&todelete); i++)
     {
@@ -2643,9 +2930,11 @@ dns_udp_receive_service_hook(dns_simple_message_s *simple_message, message_data
 
             // remove it from the collection
 
-            mutex_lock(&message_collection_mtx);
+            dns_udp_message_collection_shard_s *shard = dns_udp_message_collection_shard_get(&message);
+
+            mutex_lock(&shard->mtx);
 
-            ptr_node *node = ptr_set_avl_find(&message_collection, &message);
+            ptr_node *node = ptr_set_avl_find(&shard->set, &message);
 
             if(node != NULL)
             {
@@ -2657,8 +2946,8 @@ dns_udp_receive_service_hook(dns_simple_message_s *simple_message, message_data
 
                 dns_udp_simple_message_lock(simple_message);
 
-                ptr_set_avl_delete(&message_collection, simple_message);
-                --message_collection_keys;
+                ptr_set_avl_delete(&shard->set, simple_message);
+                __sync_fetch_and_sub(&message_collection_keys, 1);
 
                 // the message is not in the timeout collection anymore
                 // it should contain an answer, or an error, ... or a message with the TC bit on
@@ -2671,7 +2960,7 @@ dns_udp_receive_service_hook(dns_simple_message_s *simple_message, message_data
 
                 dns_udp_simple_message_unlock(simple_message);
 
-                mutex_unlock(&message_collection_mtx);
+                mutex_unlock(&shard->mtx);
 
                 // RC is supposed to be 1
 
@@ -2717,7 +3006,7 @@ dns_udp_receive_service_hook(dns_simple_message_s *simple_message, message_data
             }
             else
             {
-                mutex_unlock(&message_collection_mtx);
+                mutex_unlock(&shard->mtx);
 
                 // unknown
 
@@ -2764,12 +3053,15 @@ dns_udp_handler_init()
             return INVALID_ARGUMENT_ERROR; // invalid value
         }
 
+        (void) pthread_once(&dns_udp_shards_once, dns_udp_shards_init);
+        
         error_register(DNS_UDP_TIMEOUT, "query timed out");
         error_register(DNS_UDP_INTERNAL, "internal error");
         message_edns0_setmaxsize(4096);
 
         limiter_init(&dns_udp_send_bandwidth, dns_udp_settings->send_bandwidth); // bytes-per-second
-        limiter_init(&dns_udp_send_rate, dns_udp_settings->send_rate); // bytes-per-second
+        limiter_init(&dns_udp_send_rate, dns_udp_settings->send_rate); // queries-per-second
+        dns_udp_send_rate_update(0); // the hosts known before
         limiter_init(&dns_udp_recv_bandwidth, dns_udp_settings->recv_bandwidth); // bytes-per-second
         //dns_udp_settings->port_count != 0
         u32 worker_count = dns_udp_settings->port_count;
@@ -2987,7 +3279,10 @@ dns_udp_handler_finalize()
     
     async_queue_finalize(&dns_udp_send_handler_queue);
     
-    ptr_set_avl_callback_and_destroy(&message_collection, dns_udp_handler_message_collection_free_node_callback);
+    for(int i = 0; i < DNS_UDP_MESSAGE_COLLECTION_SHARDS; ++i)
+    {
+        ptr_set_avl_callback_and_destroy(&message_collection[i].set, dns_udp_handler_message_collection_free_node_callback);
+    }
 
     message_collection_keys = 0;
     message_collection_size = 0;
@@ -66,6 +66,7 @@
 #include "dnscore/random.h"
 
 #include "dnscore/sys_error.h"
+#include "dnscore/sys_numa.h"
 #include "dnscore/thread_pool.h"
 #include "dnscore/tsig.h"
 #include "dnscore/mutex.h"
@@ -473,6 +474,8 @@ dnscore_init_ex(u32 features)
         dnscore_tty_init = TRUE;
     }
     
+    sys_numa_init(); // before zalloc: it keeps its lines by node
+    
 #if DNSCORE_HAS_ZALLOC_SUPPORT
     if((features & DNSCORE_ZALLOC) && !(dnscore_features & DNSCORE_ZALLOC))
     {
@@ -732,6 +735,7 @@ dnscore_finalize()
     config_finalise();
         
     async_message_pool_finalize();
+    message_handoff_pool_finalize();
 
     stdstream_flush_both_terms();
     
@@ -748,6 +748,14 @@ dnstype_format_handler_method(const void *val, output_stream *stream, s32 paddin
                  len = 4;
                  txt = TYPE_CTRL_ZONESYNC_NAME;
                  break;
+            case TYPE_CTRL_SRVSTATS:
+                len = 5;
+                txt = TYPE_CTRL_SRVSTATS_NAME;
+                break;
+            case TYPE_CTRL_SRVLOCKS:
+                len = 5;
+                txt = TYPE_CTRL_SRVLOCKS_NAME;
+                break;
 
 
 
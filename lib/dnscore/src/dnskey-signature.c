@@ -43,6 +43,8 @@
 
 #include "dnscore/dnskey-signature.h"
 #include "dnscore/dnskey.h"
+#include "dnscore/timems.h"
+#include "dnscore/format.h"
 
 #define MODULE_MSG_HANDLE g_system_logger
 extern logger_handle *g_system_logger;
@@ -76,6 +78,36 @@ struct dnskey_signature_tctr
     u16 rdata_size;
 };
 
+/*
+ * Number of RRsets hashed before their digests are signed in a batch
+ */
+
+#define DNSKEY_SIGNER_BATCH_CHUNK 16
+
+/*
+ * Signature counters, indexed by algorithm
+ */
+
+#define DNSKEY_SIGNATURE_STATS_ALGORITHM_COUNT 32
+
+struct dnskey_signature_stats
+{
+    u64 count;
+    u64 duration_ns;
+};
+
+static struct dnskey_signature_stats dnskey_signature_stats[DNSKEY_SIGNATURE_STATS_ALGORITHM_COUNT];
+
+static inline void
+dnskey_signature_stats_add(u8 algorithm, u64 count, u64 duration_ns)
+{
+    if(algorithm < DNSKEY_SIGNATURE_STATS_ALGORITHM_COUNT)
+    {
+        __sync_fetch_and_add(&dnskey_signature_stats[algorithm].count, count);
+        __sync_fetch_and_add(&dnskey_signature_stats[algorithm].duration_ns, duration_ns);
+    }
+}
+
 static int
 dnskey_signature_canonize_sort_record_view_rdata_compare(const void *a, const void *b, void *c)
 {
@@ -312,8 +344,17 @@ dnskey_signature_sign(dnskey_signature *ds, const dnssec_key *key, void **out_rr
         fqdn = view_vtbl->get_fqdn(data, rr0);
     }
 
+    u64 sign_start = timens_monotonic();
+    
     s32 signature_size = key->vtbl->dnssec_key_sign_digest(key, ds->digest_buffer, ds->digest_size, signature);
     
+    if(FAIL(signature_size))
+    {
+        return signature_size;
+    }
+    
+    dnskey_signature_stats_add(key_algorithm, 1, timens_monotonic() - sign_start);
+    
 #ifdef DEBUG
     log_debug("dnskey_signature_sign: signature value");
     log_memdump(MODULE_MSG_HANDLE, MSG_DEBUG, signature, signature_size, 32);
@@ -333,25 +374,264 @@ dnskey_signature_finalise(dnskey_signature *ds)
 {
 }
 
+void
+dnskey_signature_canonize(ptr_vector *rrset, resource_record_view *view)
+{
+    ptr_vector_qsort_r(rrset, dnskey_signature_canonize_sort_record_view_rdata_compare, view);
+}
+
+ya_result
+dnskey_signer_init(dnskey_signer *signer, const dnssec_key *key, time_t from, time_t to)
+{
+    ya_result ret;
+    
+    if(key == NULL)
+    {
+        return ERROR;   // no key
+    }
+    
+    if(!dnssec_key_is_private(key))
+    {
+        return ERROR; // not private
+    }
+    
+    signer->key = key;
+    signer->inception = (u32)from;
+    signer->expiration = (u32)to;
+    signer->algorithm = dnssec_key_get_algorithm(key);
+    
+    if(FAIL(ret = dnskey_digest_init(&signer->digest_template, signer->algorithm)))
+    {
+        return ret;
+    }
+    
+    // the type covered, the labels and the original TTL are set for each RRset
+    
+    struct dnskey_signature_header *hdr = (struct dnskey_signature_header*)signer->header;
+    
+    const u8 *owner_fqdn = dnssec_key_get_domain(key);
+    size_t owner_fqdn_len = dnsname_len(owner_fqdn);
+
+    hdr->algorithm = signer->algorithm;
+    hdr->expiration = htonl(signer->expiration);
+    hdr->inception = htonl(signer->inception);
+    hdr->tag = htons(dnssec_key_get_tag_const(key));
+    memcpy(&hdr->fqdn_signature[0], owner_fqdn, owner_fqdn_len);
+    
+    signer->header_size = RRSIG_RDATA_HEADER_LEN + owner_fqdn_len;
+    
+    return SUCCESS;
+}
+
+struct dnskey_signer_batch_digest
+{
+    u8 digest[DIGEST_BUFFER_SIZE];
+    u8 fqdn[MAX_DOMAIN_LENGTH];
+    s32 ttl;
+    u16 rclass;
+    u8 digest_size;
+    u8 labels;
+};
+
+/**
+ * Computes the digest of a canonised RRset for the signer.
+ */
+
+static void
+dnskey_signer_digest(dnskey_signer *signer, dnskey_signature_batch_item *item, struct dnskey_signer_batch_digest *bd)
+{
+    struct dnskey_signature_tctr tctr;
+    
+    ptr_vector *rrset = item->rrset;
+    const resource_record_view_vtbl *view_vtbl = item->view.vtbl;
+    void *data = item->view.data;
+    const void *rr0 = ptr_vector_get(rrset, 0);
+    
+    size_t fqdn_len = dnsname_canonize(view_vtbl->get_fqdn(data, rr0), bd->fqdn);
+    const u8 *fqdn = bd->fqdn;
+    
+    bd->labels = 0;
+    
+    if((fqdn[0] == 1) && (fqdn[1] == (u8)'*'))
+    {
+        fqdn += *fqdn + 1;
+    }
+
+    while(fqdn[0] != 0)
+    {
+        ++bd->labels;
+        fqdn += *fqdn + 1;
+    }
+    
+    bd->ttl = view_vtbl->get_ttl(data, rr0);
+    bd->rclass = view_vtbl->get_class(data, rr0);
+    
+    // the first 8 bytes of the header depend on the RRset, the rest has been prepared with the signer
+    
+    struct dnskey_signature_header prefix;
+    prefix.type_covered = view_vtbl->get_type(data, rr0);
+    prefix.algorithm = signer->algorithm;
+    prefix.labels = bd->labels;
+    prefix.original_ttl = htonl(bd->ttl);
+    
+    digest_s ctx = signer->digest_template;
+    
+    digest_update(&ctx, &prefix, 8);
+    digest_update(&ctx, &signer->header[8], signer->header_size - 8);
+
+    tctr.rtype = prefix.type_covered;
+    tctr.rclass = bd->rclass;
+    tctr.ttl = prefix.original_ttl;
+    
+    for(int i = 0; i <= ptr_vector_last_index(rrset); ++i)
+    {
+        const void *rr = ptr_vector_get(rrset, i);
+        digest_update(&ctx, bd->fqdn, fqdn_len);
+
+        u16 rdata_size = view_vtbl->get_rdata_size(data, rr);
+        tctr.rdata_size = htons(rdata_size);
+
+        digest_update(&ctx, &tctr, 2 + 2 + 4 + 2);
+        digest_update(&ctx, view_vtbl->get_rdata(data, rr), rdata_size);
+    }
+
+    bd->digest_size = digest_get_size(&ctx);
+    digest_final(&ctx, bd->digest, sizeof(bd->digest));
+}
+
+s32
+dnskey_signer_sign_batch(dnskey_signer *signer, dnskey_signature_batch_item *items, s32 count)
+{
+    struct dnskey_signer_batch_digest digests[DNSKEY_SIGNER_BATCH_CHUNK];
+    union dnskey_signature_header_storage hdr;
+    
+    const dnssec_key *key = signer->key;
+    s32 signed_count = 0;
+    u64 duration_ns = 0;
+    
+    memcpy(hdr.rdata, signer->header, signer->header_size);
+    u8 *signature = &hdr.rdata[signer->header_size];
+    
+    for(s32 base = 0; base < count; base += DNSKEY_SIGNER_BATCH_CHUNK)
+    {
+        s32 chunk_count = MIN(count - base, DNSKEY_SIGNER_BATCH_CHUNK);
+        
+        // hash all the sets of the chunk
+        
+        for(s32 i = 0; i < chunk_count; ++i)
+        {
+            dnskey_signature_batch_item *item = &items[base + i];
+            
+            item->rrsig_rr = NULL;
+            
+            if((item->rrset == NULL) || (ptr_vector_size(item->rrset) == 0))
+            {
+                item->ret = ERROR;  // empty set
+                continue;
+            }
+            
+            dnskey_signer_digest(signer, item, &digests[i]);
+            
+            item->ret = SUCCESS;
+        }
+        
+        // then sign the digests
+        
+        for(s32 i = 0; i < chunk_count; ++i)
+        {
+            dnskey_signature_batch_item *item = &items[base + i];
+            
+            if(FAIL(item->ret))
+            {
+                continue;
+            }
+            
+            struct dnskey_signer_batch_digest *bd = &digests[i];
+            
+            u64 sign_start = timens_monotonic();
+            
+            s32 signature_size = key->vtbl->dnssec_key_sign_digest(key, bd->digest, bd->digest_size, signature);
+            
+            duration_ns += timens_monotonic() - sign_start;
+            
+            if(FAIL(signature_size))
+            {
+                item->ret = signature_size;
+                continue;
+            }
+            
+            const void *rr0 = ptr_vector_get(item->rrset, 0);
+            
+            hdr.header.type_covered = item->view.vtbl->get_type(item->view.data, rr0);
+            hdr.header.labels = bd->labels;
+            hdr.header.original_ttl = htonl(bd->ttl);
+            
+            u16 rrsig_rdata_size = signer->header_size + signature_size;
+            
+            item->rrsig_rr = item->view.vtbl->new_instance(item->view.data, bd->fqdn, TYPE_RRSIG, bd->rclass, bd->ttl, rrsig_rdata_size, hdr.rdata);
+            item->ret = rrsig_rdata_size;
+            
+            ++signed_count;
+        }
+    }
+    
+    dnskey_signature_stats_add(signer->algorithm, signed_count, duration_ns);
+    
+    return signed_count;
+}
+
+void
+dnskey_signer_finalise(dnskey_signer *signer)
+{
+    (void)signer;
+}
+
 ya_result
 dnskey_signature_rrset_sign_with_key(const dnssec_key *key, ptr_vector *rrset, bool canonize, resource_record_view *view, void **out_rrsig_rr)
 {
-    if(dnssec_key_is_private(key))
+    dnskey_signer signer;
+    ya_result ret;
+    
+    if(FAIL(ret = dnskey_signer_init(&signer, key, time(NULL) - 3600, dnskey_get_inactive_epoch(key))))
     {
-        dnskey_signature ds;
-        dnskey_signature_init(&ds);
-        dnskey_signature_set_validity(&ds, time(NULL) - 3600, dnskey_get_inactive_epoch(key));
-        dnskey_signature_set_view(&ds, view);
-        dnskey_signature_set_rrset_reference(&ds, rrset);
-        dnskey_signature_set_canonised(&ds, !canonize);
-        ya_result ret = dnskey_signature_sign(&ds, key, out_rrsig_rr);
-        dnskey_signature_finalise(&ds);
         return ret;
     }
-    else
+    
+    if(canonize && (rrset != NULL))
     {
-        return ERROR;
+        dnskey_signature_canonize(rrset, view);
     }
+    
+    dnskey_signature_batch_item item = {rrset, *view, NULL, ERROR};
+    dnskey_signer_sign_batch(&signer, &item, 1);
+    dnskey_signer_finalise(&signer);
+    
+    *out_rrsig_rr = item.rrsig_rr;
+    
+    return item.ret;
+}
+
+ya_result
+dnskey_signature_stats_write_json(output_stream *os)
+{
+    const char *separator = "";
+    
+    osprint(os, "{\"unit\":\"ns\",\"algorithms\":{");
+    
+    for(int i = 0; i < DNSKEY_SIGNATURE_STATS_ALGORITHM_COUNT; ++i)
+    {
+        u64 count = dnskey_signature_stats[i].count;
+        u64 duration_ns = dnskey_signature_stats[i].duration_ns;
+        
+        if(count > 0)
+        {
+            u64 rate = (duration_ns > 0)?(count * 1000000000ULL) / duration_ns:0;
+            osformat(os, "%s\"%i\":{\"count\":%llu,\"time\":%llu,\"per_second\":%llu}", separator, i, count, duration_ns, rate);
+            separator = ",";
+        }
+    }
+    
+    return osprint(os, "}}");
 }
 
 /*
@@ -106,8 +106,6 @@ static value_name_table dnssec_key_load_private_keywords_common_names[] =
     {0, NULL}
 };
 
-static group_mutex_t dnskey_rc_mtx = GROUP_MUTEX_INITIALIZER;
-
 static const char *
 dnskey_get_algorithm_name_from_value(int alg)
 {
@@ -526,9 +524,7 @@ dnskey_acquire(dnssec_key *key)
 #if DUMP_ACQUIRE_RELEASE_STACK_TRACE
     debug_log_stacktrace(MODULE_MSG_HANDLE,LOG_DEBUG,"dnskey_acquire");
 #endif
-    group_mutex_lock(&dnskey_rc_mtx, GROUP_MUTEX_WRITE);
-    ++key->rc;
-    group_mutex_unlock(&dnskey_rc_mtx, GROUP_MUTEX_WRITE);
+    __sync_add_and_fetch(&key->rc, 1);
 }
 
 /**
@@ -547,11 +543,8 @@ dnskey_release(dnssec_key *key)
 #if DUMP_ACQUIRE_RELEASE_STACK_TRACE
     debug_log_stacktrace(MODULE_MSG_HANDLE,LOG_DEBUG,"dnskey_release");
 #endif
-    group_mutex_lock(&dnskey_rc_mtx, GROUP_MUTEX_WRITE);
-    if(--key->rc == 0)
+    if(__sync_sub_and_fetch(&key->rc, 1) == 0)
     {
-        group_mutex_unlock(&dnskey_rc_mtx, GROUP_MUTEX_WRITE);
-        
 #ifdef DEBUG
         if(key->next != NULL)
         {
@@ -572,10 +565,6 @@ dnskey_release(dnssec_key *key)
 #endif
         ZFREE(key, dnssec_key);
     }
-    else
-    {
-        group_mutex_unlock(&dnskey_rc_mtx, GROUP_MUTEX_WRITE);
-    }
 }
 
 /**
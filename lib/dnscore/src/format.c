@@ -80,6 +80,10 @@
 #include <arpa/inet.h>
 #include <time.h>
 
+#if defined(__linux__) || defined(__FreeBSD__)
+#include <link.h> // dl_iterate_phdr
+#endif
+
 #include "dnscore/format.h"
 #include "dnscore/bytearray_output_stream.h"
 #include "dnscore/counter_output_stream.h"
@@ -204,6 +208,8 @@ static format_handler_descriptor dummy_format_handler_descriptor ={
 
 /* <- Example of custom format handler */
 
+static void format_plan_rodata_init();
+
 void
 format_class_init()
 {
@@ -213,11 +219,16 @@ format_class_init()
     }
 
     ptr_vector_init(&format_handler_descriptor_table);
+
+    format_plan_rodata_init();
 }
 
+static void format_plan_cache_finalize();
+
 void
 format_class_finalize()
 {
+    format_plan_cache_finalize();
     ptr_vector_destroy(&format_handler_descriptor_table);
 }
 
@@ -484,565 +495,829 @@ format_asciiz(const char* val, output_stream* stream, s32 padding, char pad_char
     }
 }
 
-ya_result
-vosformat(output_stream* os_, const char* fmt, va_list args)
+/**
+ * Compiled formats
+ *
+ * A format string is parsed once into a plan: a sequence of literal copies and conversions with their
+ * flags, padding, type size and, for "%{...}", the resolved handler.
+ *
+ * Plans are cached by format pointer alone (ie: per call site), so a hit costs no more than a load.
+ * This is only sound for formats that cannot change, so only formats in the read-only segments of the
+ * loaded objects (the string literals) get a plan.  The segments are listed by format_class_init.
+ * The cache is direct-mapped: a slot is set once and never replaced, so plans can be used without locks.
+ * Formats without a plan (colliding with a taken slot, built in a buffer, or on a system where the
+ * segments cannot be listed) are interpreted as they are read, without allocation.
+ */
+
+#define FMTPLAN_TAG 0x4e414c50544d46
+
+#define FORMAT_PLAN_CACHE_SIZE 4096 // power of two
+#define FORMAT_PLAN_RODATA_MAX 64   // read-only segments tracked
+
+#define FORMAT_PLAN_OP_LITERAL    0
+#define FORMAT_PLAN_OP_CONVERSION 1
+
+struct format_plan_op
 {
-    counter_output_stream_data cosd;
-    output_stream os;
+    const char *text;                   // literal, or handler name for "%{...}"
+    format_handler_descriptor *desc;    // "%{...}" handler, NULL if it was not registered at compile time
+    u32 text_len;
+    s32 padding;
+    s32 float_padding;
+    u8 kind;
+    u8 type_size;
+    char conversion;
+    char pad_char;
+    bool left_justified;
+};
 
-    counter_output_stream_init(os_, &os, &cosd);
+typedef struct format_plan_op format_plan_op;
 
-    const char* next = fmt;
+struct format_plan
+{
+    struct format_plan *next;   // all cached plans, for the finalisation
+    const char *format;         // the format (read-only) the plan is cached for, the ops point into it
+    u32 op_count;
+    format_plan_op ops[1];
+};
 
-    s32 padding = -1;
-    s32 float_padding = -1;
-    u8 type_size = sizeof(int);
-    char pad_char = ' ';
-    bool left_justified = TRUE;
+typedef struct format_plan format_plan;
 
-    char c;
+struct format_plan_rodata
+{
+    intptr start;
+    intptr end;
+};
 
-    for(;;)
+static format_plan *format_plan_cache[FORMAT_PLAN_CACHE_SIZE];
+static format_plan *format_plan_list = NULL;
+static struct format_plan_rodata format_plan_rodata[FORMAT_PLAN_RODATA_MAX];
+static u32 format_plan_rodata_count = 0;
+
+#if defined(__linux__) || defined(__FreeBSD__)
+
+static int
+format_plan_rodata_callback(struct dl_phdr_info *info, size_t size, void *data)
+{
+    (void)size;
+    (void)data;
+
+    for(int i = 0; i < info->dlpi_phnum; ++i)
     {
-        c = *next;
+        const ElfW(Phdr) *phdr = &info->dlpi_phdr[i];
 
-        if(c == 0)
+        if((phdr->p_type == PT_LOAD) && ((phdr->p_flags & PF_W) == 0) && (format_plan_rodata_count < FORMAT_PLAN_RODATA_MAX))
         {
-            /* copy the rest, return */
-            size_t size = next - fmt;
+            struct format_plan_rodata *rodata = &format_plan_rodata[format_plan_rodata_count++];
+            rodata->start = (intptr)(info->dlpi_addr + phdr->p_vaddr);
+            rodata->end = rodata->start + phdr->p_memsz;
+        }
+    }
 
-            output_stream_write(&os, (const u8*)fmt, size);
+    return 0;
+}
 
-            ya_result ret;
+#endif
 
-            if(ISOK(cosd.result))
-            {
-                ret = cosd.write_count;
-            }
-            else
-            {
-                ret = cosd.result;
-            }
+/**
+ * Lists the read-only segments of the loaded objects.
+ * Objects loaded later will have their formats interpreted.
+ */
 
-            /**
-             *	NOTE: counter_output_stream has changed a bit since its first version.
-             *
-             *
-             *	      It does not closes the fitlered stream on "close"
-             *        It does not flushes the filtered stream on "close" either.
-             *        It only flushes the filtered stream when explicitly asked with "flush"
-             *
-             *        It is thus useless to call close here (we just loose the time for the call)
-             *
-             */
+static void
+format_plan_rodata_init()
+{
+#if defined(__linux__) || defined(__FreeBSD__)
+    if(format_plan_rodata_count == 0)
+    {
+        dl_iterate_phdr(format_plan_rodata_callback, NULL);
+    }
+#endif
+}
 
-            /* output_stream_close(&os); */
+static bool
+format_plan_rodata_contains(const char *fmt)
+{
+    intptr address = (intptr)fmt;
 
-            return ret;
+    for(u32 i = 0; i < format_plan_rodata_count; ++i)
+    {
+        if((address >= format_plan_rodata[i].start) && (address < format_plan_rodata[i].end))
+        {
+            return TRUE;
         }
+    }
 
-        if(c == SENTINEL)
-        {
-            /* copy the rest, format */
+    return FALSE;
+}
 
-            size_t size = next - fmt;
+/**
+ * Parses the conversion starting after the '%' into the op.
+ * Returns a pointer after the conversion, or NULL if the format ends in the middle of it.
+ */
+
+static const char*
+format_conversion_parse(const char *format, const char *next, format_plan_op *op)
+{
+    char c = *next++;
 
-            output_stream_write(&os, (const u8*)fmt, size);
+    op->kind = FORMAT_PLAN_OP_CONVERSION;
+    op->padding = -1;
+    op->float_padding = -1;
+    op->type_size = sizeof(int);
+    op->pad_char = ' ';
+    op->left_justified = TRUE;
+    op->desc = NULL;
+    op->text = NULL;
+    op->text_len = 0;
 
-            next++;
+    /* Justify */
+
+    if(c == '-')
+    {
+        op->left_justified = FALSE;
+        c = *next++;
+    }
+
+    /* Padding */
+
+    if(c == '0')
+    {
+        op->pad_char = c;
+
+        op->left_justified = FALSE;
+
+        c = *next++;
+    }
 
-            fmt += size;
+    /* Padding */
 
-            /* format */
+    if(isdigit(c))
+    {
+        char padding_string[10];
+
+        char* p = padding_string;
+        int n = 9;
 
+        do
+        {
+            *p++ = c;
             c = *next++;
+        }
+        while(isdigit(c) && (n > 0));
 
-            if(c == '%')
-            {
-                /*
-                 * warning: ‘char’ is promoted to ‘int’ when passed through ‘...’
-                 *	    (so you should pass ‘int’ not ‘char’ to ‘va_arg’)
-                 *	    if this code is reached, the program will abort
-                 *
-                 * => int
-                 */
+        *p = CHR0;
 
-                format_asciiz("%", &os, padding, pad_char, left_justified);
+        op->padding = atoi(padding_string);
+    }
 
-                fmt = next;
+    if(c == '.')
+    {
+        char padding_string[10];
 
-                padding = 0;
-                type_size = sizeof(int);
-                pad_char = ' ';
-                left_justified = TRUE;
+        char* p = padding_string;
+        int n = 9;
+        c = *next++;
+        do
+        {
+            *p++ = c;
+            c = *next++;
+        }
+        while(isdigit(c) && (n > 0));
 
-                continue;
-            }
+        *p = CHR0;
 
-            /* Justify */
+        op->float_padding = atoi(padding_string);
+    }
 
-            if(c == '-')
-            {
-                left_justified = FALSE;
-                c = *next++;
-            }
+    /* Type size */
 
-            /* Padding */
+    if(c == 'h')
+    {
+        c = *next++;
 
-            if(c == '0')
-            {
-                pad_char = c;
+        op->type_size = sizeof(u16);
 
-                left_justified = FALSE;
+        if(c == 'h')
+        {
+            c = *next++;
 
-                c = *next++;
-            }
+            op->type_size = sizeof(u8);
+        }
+    }
+    else if(c == 'l')
+    {
+        c = *next++;
 
-            /* Padding */
+        op->type_size = sizeof(u32);
 
-            if(isdigit(c))
-            {
-                char padding_string[10];
+        if(c == 'l')
+        {
+            c = *next++;
 
-                char* p = padding_string;
-                int n = 9;
+            op->type_size = sizeof(u64);
+        }
+    }
+    else if(c == 'L')
+    {
+        c = *next++;
 
-                do
-                {
-                    *p++ = c;
-                    c = *next++;
-                }
-                while(isdigit(c) && (n > 0));
+        op->type_size = sizeof(long double);
+    }
 
-                *p = CHR0;
+    /* Type */
 
-                padding = atoi(padding_string);
-            }
+    op->conversion = c;
+
+    if(c == '{')
+    {
+        const char* type_name = next;
+        do
+        {
+            c = *next++;
 
-            if(c == '.')
+            if(c == 0)
             {
-                char padding_string[10];
+                flushout();
+                flusherr();
 
-                char* p = padding_string;
-                int n = 9;
-                c = *next++;
-                do
-                {
-                    *p++ = c;
-                    c = *next++;
-                }
-                while(isdigit(c) && (n > 0));
+                fprintf(stderr, "PANIC: Invalid format type in string '%s' : '}' expected.", format); /* Keep native */
+                fflush(stderr);
+                abort();
+            }
+        }
+        while(c != '}');
 
-                *p = CHR0;
+        /* type_name -> next contains the type name and arguments
+         * arguments can be integers
+         */
 
-                float_padding = atoi(padding_string);
-            }
+        op->text = type_name;
+        op->text_len = next - 1 - type_name;
+        op->desc = format_get_format_handler(op->text, op->text_len);
+    }
+    else if(c == 0)
+    {
+        return NULL; // truncated conversion: nothing to print
+    }
 
-            /* Type size */
+    return next;
+}
 
-            if(c == 'h')
-            {
-                c = *next++;
+static format_plan*
+format_plan_compile(const char* fmt)
+{
+    u32 op_max = 1;
 
-                type_size = sizeof(u16);
+    for(const char *p = fmt; *p != CHR0; ++p)
+    {
+        if(*p == SENTINEL)
+        {
+            op_max += 2;
+        }
+    }
 
-                if(c == 'h')
-                {
-                    c = *next++;
+    format_plan *plan;
 
-                    type_size = sizeof(u8);
-                }
-            }
-            else if(c == 'l')
-            {
-                c = *next++;
+    MALLOC_OR_DIE(format_plan*, plan, sizeof(format_plan) + sizeof(format_plan_op) * (op_max - 1), FMTPLAN_TAG);
 
-                type_size = sizeof(u32);
+    plan->next = NULL;
+    plan->format = fmt;
 
-                if(c == 'l')
-                {
-                    c = *next++;
+    format_plan_op *op = plan->ops;
+    const char* next = fmt;
 
-                    type_size = sizeof(u64);
-                }
-            }
-            else if(c == 'L')
+    for(;;)
+    {
+        char c = *next;
+
+        if((c == 0) || (c == SENTINEL))
+        {
+            size_t size = next - fmt;
+
+            if(size > 0)
             {
-                c = *next++;
+                op->kind = FORMAT_PLAN_OP_LITERAL;
+                op->text = fmt;
+                op->text_len = size;
+                ++op;
+            }
 
-                type_size = sizeof(long double);
+            if(c == 0)
+            {
+                break;
             }
 
-            /* Type */
+            next++;
 
-            switch(c)
+            if(*next == '%')
             {
-                case 'i':
-                {
-                    s64 val;
+                op->kind = FORMAT_PLAN_OP_LITERAL;
+                op->text = next++;
+                op->text_len = 1;
+                ++op;
 
-                    switch(type_size)
-                    {
-                        case sizeof(s8):
-                        {
-                            /*
-                             * warning: ‘u8’ is promoted to ‘int’ when passed through ‘...’
-                             *	    (so you should pass ‘int’ not ‘u8’ to ‘va_arg’)
-                             *	    if this code is reached, the program will abort
-                             *
-                             * => int
-                             */
-                            val = (s8)va_arg(args, int);
-                            break;
-                        }
+                fmt = next;
 
-                        case sizeof(s16):
-                        {
-                            /*
-                             * warning: ‘u16’ is promoted to ‘int’ when passed through ‘...’
-                             *	    (so you should pass ‘int’ not ‘u16’ to ‘va_arg’)
-                             *	    if this code is reached, the program will abort
-                             *
-                             * => int
-                             */
-
-                            val = (s16)va_arg(args, int);
-                            break;
-                        }
+                continue;
+            }
 
-                        case sizeof(s32):
-                        {
-                            val = (s32)va_arg(args, s32);
-                            break;
-                        }
+            if((next = format_conversion_parse(plan->format, next, op)) == NULL)
+            {
+                break;
+            }
 
-                        case sizeof(s64):
-                        {
-                            val = va_arg(args, s64);
-                            break;
-                        }
-                        default:
-                        {
-                            /* Invalid formatting : FULL STOP */
+            ++op;
 
-                            flushout();
-                            flusherr();
+            fmt = next;
 
-                            fprintf(stderr, "Invalid type size '%i' in string '%s'", type_size, fmt); /* Keep native */
-                            fflush(stderr);
+            continue;
+        }
 
-                            abort();
-                        }
-                    }
+        next++;
 
-                    format_dec_s64(val, &os, padding, pad_char, left_justified);
+        /* look for the sentinel */
+    }
 
-                    break;
-                }
+    plan->op_count = op - plan->ops;
 
-                case 'r':
-                {
-                    ya_result val = va_arg(args, ya_result);
+    return plan;
+}
 
-                    error_writetext(&os, val);
-                    
-                    break;
-                }
+static inline u32
+format_plan_cache_slot(const char *fmt)
+{
+    intptr key = (intptr)fmt;
+    key ^= key >> 12;
+    key *= 0x9e3779b1;
+    return (u32)(key >> 8) & (FORMAT_PLAN_CACHE_SIZE - 1);
+}
 
-                case 'x':
-                case 'X':
-                case 'u':
-                case 'd':
-                case 'o':
-                {
-                    u64_formatter_function* formatter;
+/**
+ * Returns the cached plan for the format, compiling and caching it if possible.
+ * Returns NULL if the format has no plan and has to be interpreted.
+ */
 
-                    u64 val;
+static format_plan*
+format_plan_get(const char *fmt)
+{
+    format_plan **slotp = &format_plan_cache[format_plan_cache_slot(fmt)];
+    format_plan *plan = *slotp;
 
-                    if(c == 'u' || c == 'd')
-                    {
-                        formatter = format_dec_u64;
-                    }
-                    else if(c == 'X')
-                    {
-                        formatter = format_hex_u64_hi;
-                    }
-                    else if(c == 'x')
-                    {
-                        formatter = format_hex_u64_lo;
-                    }
-                    else
-                    {
-                        formatter = format_oct_u64;
-                    }
+    if(plan != NULL)
+    {
+        return (plan->format == fmt)?plan:NULL;
+    }
 
-                    switch(type_size)
-                    {
+    if(!format_plan_rodata_contains(fmt))
+    {
+        return NULL;
+    }
 
-                        case sizeof(u8):
-                        {
-                            /*
-                             * warning: ‘u8’ is promoted to ‘int’ when passed through ‘...’
-                             *	    (so you should pass ‘int’ not ‘u8’ to ‘va_arg’)
-                             *	    if this code is reached, the program will abort
-                             *
-                             * => int
-                             */
-                            val = va_arg(args, int);
-                            break;
-                        }
+    plan = format_plan_compile(fmt);
 
-                        case sizeof(u16):
-                        {
-                            /*
-                             * warning: ‘u16’ is promoted to ‘int’ when passed through ‘...’
-                             *	    (so you should pass ‘int’ not ‘u16’ to ‘va_arg’)
-                             *	    if this code is reached, the program will abort
-                             *
-                             * => int
-                             */
-
-                            val = va_arg(args, int);
-                            break;
-                        }
+    if(!__sync_bool_compare_and_swap(slotp, NULL, plan))
+    {
+        // another thread took the slot
 
-                        case sizeof(u32):
-                        {
-                            val = va_arg(args, u32);
-                            break;
-                        }
+        free(plan);
+        plan = *slotp;
+        return (plan->format == fmt)?plan:NULL;
+    }
 
-                        case sizeof(u64):
-                        {
-                            val = va_arg(args, u64);
-                            break;
-                        }
-                        default:
-                        {
-                            /* Invalid formatting : FULL STOP */
+    format_plan *head;
 
-                            flushout();
-                            flusherr();
+    do
+    {
+        head = format_plan_list;
+        plan->next = head;
+    }
+    while(!__sync_bool_compare_and_swap(&format_plan_list, head, plan));
 
-                            fprintf(stderr, "Invalid type size '%i' in string '%s'", type_size, fmt); /* Keep native */
-                            fflush(stderr);
+    return plan;
+}
 
-                            abort();
-                        }
-                    }
+static void
+format_plan_cache_finalize()
+{
+    format_plan *plan = format_plan_list;
+    format_plan_list = NULL;
+
+    while(plan != NULL)
+    {
+        format_plan *next = plan->next;
+        free(plan);
+        plan = next;
+    }
+
+    memset(format_plan_cache, 0, sizeof(format_plan_cache));
+}
+
+static void
+format_plan_op_emit(output_stream *os, const format_plan_op *op, const char *fmt, va_list *args)
+{
+    char c = op->conversion;
+    s32 padding = op->padding;
+    s32 float_padding = op->float_padding;
+    u8 type_size = op->type_size;
+    char pad_char = op->pad_char;
+    bool left_justified = op->left_justified;
+
+    switch(c)
+    {
+        case 'i':
+        {
+            s64 val;
 
-                    formatter(val, &os, padding, pad_char, left_justified);
+            switch(type_size)
+            {
+                case sizeof(s8):
+                {
+                    /*
+                     * warning: ‘u8’ is promoted to ‘int’ when passed through ‘...’
+                     *	    (so you should pass ‘int’ not ‘u8’ to ‘va_arg’)
+                     *	    if this code is reached, the program will abort
+                     *
+                     * => int
+                     */
+                    val = (s8)va_arg(*args, int);
                     break;
                 }
-                case 'P':
-                {
-
-                    intptr val = va_arg(args, intptr);
 
-#if HAS_DLADDR_SUPPORT != 0
-                    Dl_info info;
+                case sizeof(s16):
+                {
+                    /*
+                     * warning: ‘u16’ is promoted to ‘int’ when passed through ‘...’
+                     *	    (so you should pass ‘int’ not ‘u16’ to ‘va_arg’)
+                     *	    if this code is reached, the program will abort
+                     *
+                     * => int
+                     */
 
-                    if(val != 0)
-                    {
-                        if(dladdr((void*)val, &info) != 0)
-                        {
-                            if(info.dli_sname != NULL)
-                            {
-                                format_asciiz(info.dli_sname, &os, padding, pad_char, left_justified);
-                                break;
-                            }
-                            else if(info.dli_fname != NULL)
-                            {
-                                format_asciiz(info.dli_fname, &os, padding, pad_char, left_justified);
-                                val -= (intptr)info.dli_fbase;
-                                output_stream_write_u8(&os, (u8)':');
-                            }
-                        }
-                    }
-#endif
-                    
-                    format_hex_u64_hi(val, &os, __SIZEOF_POINTER__ * 2, '0', FALSE);
+                    val = (s16)va_arg(*args, int);
                     break;
                 }
-                case 'p':
+
+                case sizeof(s32):
                 {
-                    intptr val = va_arg(args, intptr);
+                    val = (s32)va_arg(*args, s32);
+                    break;
+                }
 
-                    format_hex_u64_hi(val, &os, __SIZEOF_POINTER__ * 2, '0', FALSE);
+                case sizeof(s64):
+                {
+                    val = va_arg(*args, s64);
                     break;
                 }
-                case 'f':
+                default:
                 {
-                    if(type_size == sizeof(long double))
-                    {
-                        long double val = va_arg(args, long double);
+                    /* Invalid formatting : FULL STOP */
 
-                        format_longdouble(val, &os, padding, float_padding, pad_char, left_justified);
-                    }
-                    else
-                    {
-                        double val = va_arg(args, double);
+                    flushout();
+                    flusherr();
 
-                        format_double(val, &os, padding, float_padding, pad_char, left_justified);
-                    }
+                    fprintf(stderr, "Invalid type size '%i' in string '%s'", type_size, fmt); /* Keep native */
+                    fflush(stderr);
 
-                    break;
+                    abort();
                 }
-                case 's':
-                {
-                    const char* val;
+            }
 
-                    val = va_arg(args, const char*);
+            format_dec_s64(val, os, padding, pad_char, left_justified);
 
-                    format_asciiz(val, &os, padding, pad_char, left_justified);
+            break;
+        }
+
+        case 'r':
+        {
+            ya_result val = va_arg(*args, ya_result);
 
+            error_writetext(os, val);
+            
+            break;
+        }
+
+        case 'x':
+        case 'X':
+        case 'u':
+        case 'd':
+        case 'o':
+        {
+            u64_formatter_function* formatter;
+
+            u64 val;
+
+            if(c == 'u' || c == 'd')
+            {
+                formatter = format_dec_u64;
+            }
+            else if(c == 'X')
+            {
+                formatter = format_hex_u64_hi;
+            }
+            else if(c == 'x')
+            {
+                formatter = format_hex_u64_lo;
+            }
+            else
+            {
+                formatter = format_oct_u64;
+            }
+
+            switch(type_size)
+            {
+
+                case sizeof(u8):
+                {
+                    /*
+                     * warning: ‘u8’ is promoted to ‘int’ when passed through ‘...’
+                     *	    (so you should pass ‘int’ not ‘u8’ to ‘va_arg’)
+                     *	    if this code is reached, the program will abort
+                     *
+                     * => int
+                     */
+                    val = va_arg(*args, int);
                     break;
                 }
-                case 'c':
-                {
-                    /* I'm using the string formatter.  It's slower than it could but ... */
-                    char tmp[2];
-                    tmp[1] = CHR0;
 
+                case sizeof(u16):
+                {
                     /*
-                     * warning: ‘char’ is promoted to ‘int’ when passed through ‘...’
-                     *	    (so you should pass ‘int’ not ‘char’ to ‘va_arg’)
+                     * warning: ‘u16’ is promoted to ‘int’ when passed through ‘...’
+                     *	    (so you should pass ‘int’ not ‘u16’ to ‘va_arg’)
                      *	    if this code is reached, the program will abort
                      *
                      * => int
                      */
 
-                    tmp[0] = va_arg(args, int);
+                    val = va_arg(*args, int);
+                    break;
+                }
 
-                    format_asciiz(tmp, &os, padding, pad_char, left_justified);
+                case sizeof(u32):
+                {
+                    val = va_arg(*args, u32);
+                    break;
+                }
 
+                case sizeof(u64):
+                {
+                    val = va_arg(*args, u64);
                     break;
                 }
+                default:
+                {
+                    /* Invalid formatting : FULL STOP */
+
+                    flushout();
+                    flusherr();
+
+                    fprintf(stderr, "Invalid type size '%i' in string '%s'", type_size, fmt); /* Keep native */
+                    fflush(stderr);
+
+                    abort();
+                }
+            }
 
-                case '{':
+            formatter(val, os, padding, pad_char, left_justified);
+            break;
+        }
+        case 'P':
+        {
+
+            intptr val = va_arg(*args, intptr);
+
+#if HAS_DLADDR_SUPPORT != 0
+            Dl_info info;
+
+            if(val != 0)
+            {
+                if(dladdr((void*)val, &info) != 0)
                 {
-                    const char* type_name = next;
-                    do
+                    if(info.dli_sname != NULL)
+                    {
+                        format_asciiz(info.dli_sname, os, padding, pad_char, left_justified);
+                        break;
+                    }
+                    else if(info.dli_fname != NULL)
                     {
-                        c = *next++;
+                        format_asciiz(info.dli_fname, os, padding, pad_char, left_justified);
+                        val -= (intptr)info.dli_fbase;
+                        output_stream_write_u8(os, (u8)':');
+                    }
+                }
+            }
+#endif
+            
+            format_hex_u64_hi(val, os, __SIZEOF_POINTER__ * 2, '0', FALSE);
+            break;
+        }
+        case 'p':
+        {
+            intptr val = va_arg(*args, intptr);
 
-                        if(c == 0)
-                        {
-                            flushout();
-                            flusherr();
+            format_hex_u64_hi(val, os, __SIZEOF_POINTER__ * 2, '0', FALSE);
+            break;
+        }
+        case 'f':
+        {
+            if(type_size == sizeof(long double))
+            {
+                long double val = va_arg(*args, long double);
 
-                            fprintf(stderr, "PANIC: Invalid format type in string '%s' : '}' expected.", fmt); /* Keep native */
-                            fflush(stderr);
-                            abort();
-                        }
-                    }
-                    while(c != '}');
+                format_longdouble(val, os, padding, float_padding, pad_char, left_justified);
+            }
+            else
+            {
+                double val = va_arg(*args, double);
 
-                    /* type_name -> next contains the type name and arguments
-                     * arguments can be integers
-                     */
+                format_double(val, os, padding, float_padding, pad_char, left_justified);
+            }
 
-                    size_t type_name_len = next - 1 - type_name;
+            break;
+        }
+        case 's':
+        {
+            const char* val;
 
-                    format_handler_descriptor* desc = format_get_format_handler(type_name, type_name_len);
+            val = va_arg(*args, const char*);
 
-                    if(desc == NULL)
-                    {
-                        /* Uses the "dummy" handler */
+            format_asciiz(val, os, padding, pad_char, left_justified);
 
-                        desc = &dummy_format_handler_descriptor;
-                    }
+            break;
+        }
+        case 'c':
+        {
+            /* I'm using the string formatter.  It's slower than it could but ... */
+            char tmp[2];
+            tmp[1] = CHR0;
 
-                    void* ptr = va_arg(args, void*);
-                    desc->format_handler(ptr, &os, padding, pad_char, left_justified, NULL);
+            /*
+             * warning: ‘char’ is promoted to ‘int’ when passed through ‘...’
+             *	    (so you should pass ‘int’ not ‘char’ to ‘va_arg’)
+             *	    if this code is reached, the program will abort
+             *
+             * => int
+             */
 
-                    break;
+            tmp[0] = va_arg(*args, int);
+
+            format_asciiz(tmp, os, padding, pad_char, left_justified);
+
+            break;
+        }
+
+        case '{':
+        {
+            format_handler_descriptor* desc = op->desc;
+
+            if(desc == NULL)
+            {
+                /* was not registered when the format was compiled */
+
+                desc = format_get_format_handler(op->text, op->text_len);
+
+                if(desc == NULL)
+                {
+                    /* Uses the "dummy" handler */
+
+                    desc = &dummy_format_handler_descriptor;
                 }
-                
-                case 'w':
+            }
+
+            void* ptr = va_arg(*args, void*);
+            desc->format_handler(ptr, os, padding, pad_char, left_justified, NULL);
+
+            break;
+        }
+        
+        case 'w':
+        {
+            void* ptr = va_arg(*args, void*);
+            format_writer *fw = (format_writer*)ptr;
+            fw->callback(fw->value, os, padding, pad_char, left_justified, NULL);
+            break;
+        }
+        
+        case 't':
+        {
+            int val = (int)va_arg(*args, int);
+            do_padding(os, val, '\t');
+            break;
+        }
+        
+        case 'S':
+        {
+            int val = (int)va_arg(*args, int);
+            do_padding(os, val, ' ');
+            break;
+        }
+        
+        case 'T':
+        {
+            switch(type_size)
+            {
+                case sizeof(s32):
                 {
-                    void* ptr = va_arg(args, void*);
-                    format_writer *fw = (format_writer*)ptr;
-                    fw->callback(fw->value, &os, padding, pad_char, left_justified, NULL);
+                    u32 val = (u32)va_arg(*args, u32);
+                    localepoch_format_handler_method((void*)(intptr)val, os, 0, 0, FALSE, NULL);
                     break;
                 }
-                
-                case 't':
+
+                case sizeof(s64):
                 {
-                    int val = (int)va_arg(args, int);
-                    do_padding(&os, val, '\t');
+
+                    s64 val = (s64)va_arg(*args, s64);
+                    localdatetimeus_format_handler_method((void*)(intptr)val, os, 0, 0, FALSE, NULL);
                     break;
                 }
-                
-                case 'S':
+                default:
                 {
-                    int val = (int)va_arg(args, int);
-                    do_padding(&os, val, ' ');
-                    break;
+                    abort();
                 }
-                
-                case 'T':
+            }
+            
+            break;
+        }
+        
+        case 'U':
+        {
+            switch(type_size)
+            {
+                case sizeof(s32):
                 {
-                    switch(type_size)
-                    {
-                        case sizeof(s32):
-                        {
-                            u32 val = (u32)va_arg(args, u32);
-                            localepoch_format_handler_method((void*)(intptr)val, &os, 0, 0, FALSE, NULL);
-                            break;
-                        }
+                    u32 val = (u32)va_arg(*args, u32);
+                    epoch_format_handler_method((void*)(intptr)val, os, 0, 0, FALSE, NULL);
+                    break;
+                }
 
-                        case sizeof(s64):
-                        {
+                case sizeof(s64):
+                {
 
-                            s64 val = (s64)va_arg(args, s64);
-                            localdatetimeus_format_handler_method((void*)(intptr)val, &os, 0, 0, FALSE, NULL);
-                            break;
-                        }
-                        default:
-                        {
-                            abort();
-                        }
-                    }
-                    
+                    s64 val = (s64)va_arg(*args, s64);
+                    datetimeus_format_handler_method((void*)(intptr)val, os, 0, 0, FALSE, NULL);
                     break;
                 }
-                
-                case 'U':
+                default:
                 {
-                    switch(type_size)
-                    {
-                        case sizeof(s32):
-                        {
-                            u32 val = (u32)va_arg(args, u32);
-                            epoch_format_handler_method((void*)(intptr)val, &os, 0, 0, FALSE, NULL);
-                            break;
-                        }
+                    abort();
+                }
+            }
+            
+            break;
+        }
+    }
+}
 
-                        case sizeof(s64):
-                        {
+/**
+ * Formats without a plan: the conversions are parsed and emitted as they are read.
+ */
 
-                            s64 val = (s64)va_arg(args, s64);
-                            datetimeus_format_handler_method((void*)(intptr)val, &os, 0, 0, FALSE, NULL);
-                            break;
-                        }
-                        default:
-                        {
-                            abort();
-                        }
-                    }
-                    
-                    break;
-                }
+static void
+format_interpret(output_stream *os, const char *format, va_list *args)
+{
+    const char *fmt = format;
+    const char *next = fmt;
+
+    for(;;)
+    {
+        char c = *next;
+
+        if((c == 0) || (c == SENTINEL))
+        {
+            size_t size = next - fmt;
+
+            if(size > 0)
+            {
+                output_stream_write(os, (const u8*)fmt, size);
             }
 
-            fmt = next;
+            if(c == 0)
+            {
+                break;
+            }
+
+            next++;
+
+            if(*next == '%')
+            {
+                output_stream_write(os, (const u8*)next++, 1);
+
+                fmt = next;
+
+                continue;
+            }
 
-            padding = -1;
-            float_padding = -1;
-            type_size = sizeof(int);
-            pad_char = ' ';
-            left_justified = TRUE;
+            format_plan_op op;
+
+            if((next = format_conversion_parse(format, next, &op)) == NULL)
+            {
+                break;
+            }
+
+            format_plan_op_emit(os, &op, format, args);
+
+            fmt = next;
 
             continue;
         }
@@ -1053,6 +1328,70 @@ vosformat(output_stream* os_, const char* fmt, va_list args)
     }
 }
 
+ya_result
+vosformat(output_stream* os_, const char* fmt, va_list args)
+{
+    counter_output_stream_data cosd;
+    output_stream os;
+
+    counter_output_stream_init(os_, &os, &cosd);
+
+    format_plan *plan = format_plan_get(fmt);
+
+    va_list plan_args;
+    va_copy(plan_args, args);
+
+    if(plan != NULL)
+    {
+        for(u32 i = 0; i < plan->op_count; ++i)
+        {
+            const format_plan_op *op = &plan->ops[i];
+
+            if(op->kind == FORMAT_PLAN_OP_LITERAL)
+            {
+                output_stream_write(&os, (const u8*)op->text, op->text_len);
+            }
+            else
+            {
+                format_plan_op_emit(&os, op, plan->format, &plan_args);
+            }
+        }
+    }
+    else
+    {
+        format_interpret(&os, fmt, &plan_args);
+    }
+
+    va_end(plan_args);
+
+    ya_result ret;
+
+    if(ISOK(cosd.result))
+    {
+        ret = cosd.write_count;
+    }
+    else
+    {
+        ret = cosd.result;
+    }
+
+    /**
+     *	NOTE: counter_output_stream has changed a bit since its first version.
+     *
+     *
+     *	      It does not closes the fitlered stream on "close"
+     *        It does not flushes the filtered stream on "close" either.
+     *        It only flushes the filtered stream when explicitly asked with "flush"
+     *
+     *        It is thus useless to call close here (we just loose the time for the call)
+     *
+     */
+
+    /* output_stream_close(&os); */
+
+    return ret;
+}
+
 ya_result
 osprint(output_stream* stream, const char* text)
 {
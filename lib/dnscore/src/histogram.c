@@ -0,0 +1,141 @@
+/*------------------------------------------------------------------------------
+*
+* Copyright (c) 2011-2019, EURid vzw. All rights reserved.
+* The YADIFA TM software product is provided under the BSD 3-clause license:
+* 
+* Redistribution and use in source and binary forms, with or without 
+* modification, are permitted provided that the following conditions
+* are met:
+*
+*        * Redistributions of source code must retain the above copyright 
+*          notice, this list of conditions and the following disclaimer.
+*        * Redistributions in binary form must reproduce the above copyright 
+*          notice, this list of conditions and the following disclaimer in the 
+*          documentation and/or other materials provided with the distribution.
+*        * Neither the name of EURid nor the names of its contributors may be 
+*          used to endorse or promote products derived from this software 
+*          without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*------------------------------------------------------------------------------
+*
+*/
+
+/** @defgroup dnscore
+ *  @ingroup dnscore
+ *  @brief Log-linear latency histogram
+ *
+ * @{
+ */
+
+#include "dnscore/dnscore-config.h"
+#include <string.h>
+
+#include "dnscore/histogram.h"
+
+u64
+histogram_bucket_highest_value(u32 index)
+{
+    if(index < 2 * HISTOGRAM_SUB_BUCKET_COUNT)
+    {
+        return index;
+    }
+
+    u32 shift = (index >> HISTOGRAM_SUB_BUCKET_BITS) - 1;
+    u64 sub = (index & (HISTOGRAM_SUB_BUCKET_COUNT - 1)) + HISTOGRAM_SUB_BUCKET_COUNT;
+
+    // wraps to the highest u64 for the last bucket
+
+    return ((sub + 1) << shift) - 1;
+}
+
+void
+histogram_init(histogram_s *h)
+{
+    memset(h, 0, sizeof(histogram_s));
+}
+
+void
+histogram_merge(histogram_s *dst, const histogram_s *src)
+{
+    if(src->count == 0)
+    {
+        return;
+    }
+
+    if(dst->count == 0)
+    {
+        dst->min = src->min;
+        dst->max = src->max;
+    }
+    else
+    {
+        if(src->min < dst->min)
+        {
+            dst->min = src->min;
+        }
+
+        if(src->max > dst->max)
+        {
+            dst->max = src->max;
+        }
+    }
+
+    dst->count += src->count;
+    dst->sum += src->sum;
+
+    for(u32 i = 0; i < HISTOGRAM_BUCKET_COUNT; ++i)
+    {
+        dst->buckets[i] += src->buckets[i];
+    }
+}
+
+u64
+histogram_value_at_percentile(const histogram_s *h, double percentile)
+{
+    if(h->count == 0)
+    {
+        return 0;
+    }
+
+    if(percentile >= 100.0)
+    {
+        return h->max;
+    }
+
+    u64 target = (u64)((h->count * percentile) / 100.0 + 0.5);
+
+    if(target == 0)
+    {
+        target = 1;
+    }
+
+    u64 total = 0;
+
+    for(u32 i = 0; i < HISTOGRAM_BUCKET_COUNT; ++i)
+    {
+        total += h->buckets[i];
+
+        if(total >= target)
+        {
+            u64 value = histogram_bucket_highest_value(i);
+
+            return MIN(value, h->max);
+        }
+    }
+
+    return h->max;
+}
+
+/** @} */
@@ -60,6 +60,8 @@
 #include "dnscore/network.h"
 
 #include "dnscore/thread_pool.h"
+#include "dnscore/pool.h"
+#include "dnscore/sys_numa.h"
 
 #if HAS_CTRL
 #include "dnscore/ctrl-rfc.h"
@@ -2278,6 +2280,152 @@ message_query_serial(const u8 *origin, const host_address *server, u32 *serial_o
     return return_value;
 }
 
+/*
+ * Messages handed from a service to another (updates, notifications, transfers)
+ * 
+ * A message_data is about 200KB, most of it being the buffer and the lookup pool, so instead of copying it into a
+ * new allocation, the owner gives it away and takes a fresh one from this pool.
+ * 
+ * On a NUMA system there is one pool by node, mapped on the memory of the node.  A message is taken from the pool of
+ * the node of the caller and goes back to the pool it has been taken from.
+ */
+
+static pool_s message_handoff_pool[SYS_NUMA_NODE_COUNT_MAX];
+static bool message_handoff_pool_initialized = FALSE;
+
+static void *
+message_handoff_pool_alloc(void *node_)
+{
+    message_data *mesg;
+    int node = (int)(intptr)node_;
+    
+    if(sys_numa_node_count() == 1)
+    {
+        MALLOC_OR_DIE(message_data*, mesg, sizeof(message_data), MESGDATA_TAG); // POOL
+    }
+    else
+    {
+        if((mesg = (message_data*)sys_numa_alloc(sizeof(message_data), node)) == NULL)
+        {
+            perror(__FILE__);
+            exit(EXIT_CODE_OUTOFMEMORY_ERROR);
+        }
+    }
+    
+    mesg->pool_node = node;
+    
+    return mesg;
+}
+
+static void
+message_handoff_pool_free(void *mesg, void *_ignored_)
+{
+    (void)_ignored_;
+    
+#ifdef DEBUG
+    memset(mesg, 0xd7, sizeof(message_data));
+#endif
+    if(sys_numa_node_count() == 1)
+    {
+        free(mesg); // POOL
+    }
+    else
+    {
+        sys_numa_free(mesg, sizeof(message_data));
+    }
+}
+
+void
+message_handoff_pool_init()
+{
+    if(!message_handoff_pool_initialized)
+    {
+        for(int node = 0; node < sys_numa_node_count(); ++node)
+        {
+            pool_init(&message_handoff_pool[node], message_handoff_pool_alloc, message_handoff_pool_free, (void*)(intptr)node, "message handoff");
+#ifndef VALGRIND_FRIENDLY
+            pool_set_size(&message_handoff_pool[node], 0x100);
+#else
+            pool_set_size(&message_handoff_pool[node], 0);
+#endif
+        }
+        message_handoff_pool_initialized = TRUE;
+    }
+}
+
+void
+message_handoff_pool_finalize()
+{
+    if(message_handoff_pool_initialized)
+    {
+        message_handoff_pool_initialized = FALSE;
+        
+        for(int node = 0; node < sys_numa_node_count(); ++node)
+        {
+            pool_finalize(&message_handoff_pool[node]);
+        }
+    }
+}
+
+message_data*
+message_new_instance()
+{
+    message_data *mesg;
+    int node = sys_numa_current_node();
+    
+    if(message_handoff_pool_initialized)
+    {
+        mesg = (message_data*)pool_alloc(&message_handoff_pool[node]);
+    }
+    else
+    {
+        mesg = (message_data*)message_handoff_pool_alloc((void*)(intptr)node);
+    }
+    
+    return mesg;
+}
+
+void
+message_free(message_data *mesg)
+{
+    if(mesg == NULL)
+    {
+        return;
+    }
+    
+    if(message_handoff_pool_initialized)
+    {
+        pool_release(&message_handoff_pool[mesg->pool_node], mesg);
+    }
+    else
+    {
+        message_handoff_pool_free(mesg, NULL);
+    }
+}
+
+message_data*
+message_handoff(message_data **mesgp)
+{
+    message_data *mesg = *mesgp;
+    message_data *next = message_new_instance();
+    
+    // the header only: everything else is written by the next reception
+    
+    memcpy(next, mesg, offsetof(message_data,qname));
+    
+    // the same state the message was left in when it was copied instead
+    
+#if DNSCORE_HAS_TSIG_SUPPORT
+    next->tsig.tsig = NULL;
+#endif
+    next->received = 0;
+    next->send_length = 0;
+    
+    *mesgp = next;
+    
+    return mesg;
+}
+
 /*
  * Does not clone the pool.
  */
@@ -2285,11 +2433,15 @@ message_query_serial(const u8 *origin, const host_address *server, u32 *serial_o
 message_data*
 message_dup(message_data *mesg)
 {
-    message_data *clone = mesg;
-    MALLOC_OR_DIE(message_data*, clone, sizeof(message_data), MESGDATA_TAG);
+    message_data *clone = message_new_instance();
     memcpy(clone, mesg, offsetof(message_data,qname));
     dnsname_copy(clone->qname, mesg->qname);
+    memcpy(clone->control_buffer, mesg->control_buffer, MIN(mesg->control_buffer_size, sizeof(clone->control_buffer)));
     memcpy(clone->buffer_tcp_len, mesg->buffer_tcp_len, 2 + MAX(mesg->received, mesg->send_length));
+    clone->recv_us = mesg->recv_us;
+    clone->pushed_us = mesg->pushed_us;
+    clone->popped_us = mesg->popped_us;
+    clone->recv_ns = mesg->recv_ns;
     
     return clone;
 }
@@ -56,20 +56,204 @@ extern logger_handle *g_system_logger;
  *
  */
 
-ya_result
-packet_writer_init(packet_writer* pc, u8* packet, u32 packet_offset, u32 size_limit)
+#define PACKET_WRITER_POOL_SIZE (sizeof(((packet_writer*)NULL)->pool) / sizeof(packet_dictionary_node))
+
+#define PACKET_WRITER_FNV_OFFSET 0x811c9dc5
+#define PACKET_WRITER_FNV_PRIME  0x01000193
+
+/*
+ * Hashed dictionary
+ * 
+ * Every suffix of a name written in the first 16KB of the packet has a node keyed by the hash of the suffix.
+ * The node of a suffix points to the node of the suffix one label shorter, so a name is matched from its last
+ * label to its first, each step comparing one label and checking the node extends the previous match.
+ */
+
+/**
+ * Adds a label to a hash, ignoring the case the way LOCASEEQUALS does
+ */
+
+static inline u32
+packet_writer_hash_label(u32 hash, const u8 *label)
 {
-    pc->pool_head = pc->pool;
-    pc->head = NULL;
+    u32 len = label[0];
+    
+    hash = (hash ^ len) * PACKET_WRITER_FNV_PRIME;
+    
+    for(u32 i = 1; i <= len; ++i)
+    {
+        hash = (hash ^ (u8)LOCASE(label[i])) * PACKET_WRITER_FNV_PRIME;
+    }
 
-#ifdef DEBUG
-    memset(&packet[packet_offset], 0xff, size_limit - packet_offset);
-#endif
+    return hash;
+}
 
-    packet_dictionary_node* child_node = NULL;
+/**
+ * Computes the hashes of every suffix of the name, ie: hashes[i] is the hash of name[i] ... name[top]
+ */
 
+static inline void
+packet_writer_hash_suffixes(dnslabel_vector_reference name, s32 top, u32 *hashes)
+{
+    u32 hash = PACKET_WRITER_FNV_OFFSET;
+    
+    for(s32 i = top; i >= 0; --i)
+    {
+        hash = packet_writer_hash_label(hash, name[i]);
+        hashes[i] = hash;
+    }
+}
+
+/**
+ * Adds the nodes of the labels name[0] ... name[count - 1], written in the packet from offset, followed by the
+ * suffix of the parent node (NULL if there is none).
+ */
+
+static void
+packet_writer_hashed_link(packet_writer* pc, dnslabel_vector_reference name, const u32 *hashes, s32 count, u32 offset, packet_dictionary_node *parent)
+{
+    u32 offsets[DNSNAME_MAX_SECTIONS];
+    
+    for(s32 i = 0; i < count; ++i)
+    {
+        offsets[i] = offset;
+        offset += name[i][0] + 1;
+    }
+    
+    // a suffix cannot be pointed to beyond the first 16KB, and a node cannot be linked without the ones after it
+    
+    if((count == 0) || (offsets[count - 1] > 0x3fff) || ((u32)(&pc->pool[PACKET_WRITER_POOL_SIZE] - pc->pool_head) < (u32)count))
+    {
+        return;
+    }
+    
+    for(s32 i = count - 1; i >= 0; --i)
+    {
+        packet_dictionary_node* node = pc->pool_head++;
+        packet_dictionary_node** bucket = &pc->buckets[hashes[i] & (PACKET_WRITER_HASH_BUCKETS - 1)];
+        node->next = *bucket;
+        node->child = parent;
+        node->label = &pc->packet[offsets[i]];
+        node->offset = offsets[i];
+        node->hash = hashes[i];
+        *bucket = node;
+        
+        parent = node;
+    }
+}
+
+static ya_result
+packet_writer_add_fqdn_hashed(packet_writer* pc, const u8* fqdn)
+{
+    dnslabel_vector name;
+    u32 hashes[DNSNAME_MAX_SECTIONS];
+    s32 top = dnsname_to_dnslabel_vector(fqdn, name);
+    
+    packet_writer_hash_suffixes(name, top, hashes);
+    
+    /* Look for the longest suffix already in the packet */
+    
+    packet_dictionary_node* best = NULL;
+    s32 best_top = top + 1;
+    
+    while(best_top > 0)
+    {
+        s32 i = best_top - 1;
+        u32 hash = hashes[i];
+        packet_dictionary_node* node = pc->buckets[hash & (PACKET_WRITER_HASH_BUCKETS - 1)];
+        
+        while(node != NULL)
+        {
+            if((node->hash == hash) && (node->child == best) && dnslabel_equals_ignorecase_left(name[i], node->label))
+            {
+                break;
+            }
+            
+            node = node->next;
+        }
+        
+        if(node == NULL)
+        {
+            break;
+        }
+        
+        best = node;
+        best_top = i;
+    }
+    
+    /* Every label in the interval [0;best_top[ is new */
+    
+    u32 offset = pc->packet_offset;
+    u8* packet = &pc->packet[offset];
+    
+    for(s32 i = 0; i < best_top; ++i)
+    {
+        u8 len = name[i][0] + 1;
+        MEMCOPY(packet, name[i], len);
+        packet += len;
+    }
+    
+    if(best_top > 0)
+    {
+        packet_writer_hashed_link(pc, name, hashes, best_top, offset, best);
+    }
+    
+    offset = packet - pc->packet;
+    
+    if(best != NULL)
+    {
+        *packet++ = (best->offset >> 8) | 0xc0;
+        *packet = (best->offset & 0xff);
+
+        offset += 2;
+    }
+    else
+    {
+        *packet = 0;
+
+        offset++;
+    }
+    
+    pc->packet_offset = offset;
+
+    return offset;
+}
+
+/**
+ * Adds the name of the question, already in the packet, to the dictionary
+ */
+
+static void
+packet_writer_seed(packet_writer* pc)
+{
+    pc->pool_head = pc->pool;
+    pc->head = NULL;
+    
+    if(pc->buckets != NULL)
+    {
+        ZEROMEMORY(pc->buckets, sizeof(pc->bucket_table));
+    }
+    
+    if(pc->packet_offset <= DNS_HEADER_LENGTH)
+    {
+        return;
+    }
+    
     u32 offset = DNS_HEADER_LENGTH;
-    u8* fqdn = &packet[offset];
+    u8* fqdn = &pc->packet[offset];
+    
+    if(pc->buckets != NULL)
+    {
+        dnslabel_vector name;
+        u32 hashes[DNSNAME_MAX_SECTIONS];
+        s32 top = dnsname_to_dnslabel_vector(fqdn, name);
+        packet_writer_hash_suffixes(name, top, hashes);
+        packet_writer_hashed_link(pc, name, hashes, top + 1, offset, NULL);
+        
+        return;
+    }
+
+    packet_dictionary_node* child_node = NULL;
 
     while(*fqdn != 0)
     {
@@ -88,19 +272,29 @@ packet_writer_init(packet_writer* pc, u8* packet, u32 packet_offset, u32 size_li
         child_node = node;
     }
     
+    pc->head = child_node;
+}
+
+ya_result
+packet_writer_init(packet_writer* pc, u8* packet, u32 packet_offset, u32 size_limit)
+{
 #ifdef DEBUG
-    fqdn += 1 + 2 + 2;
+    memset(&packet[packet_offset], 0xff, size_limit - packet_offset);
+    
+    u32 expected_offset = DNS_HEADER_LENGTH + dnsname_len(&packet[DNS_HEADER_LENGTH]) + 2 + 2;
     
-    if(packet_offset != fqdn - packet)
+    if(packet_offset != expected_offset)
     {
-        log_err("packet_writer_init expected %u = %u", packet_offset, fqdn - packet);
+        log_err("packet_writer_init expected %u = %u", packet_offset, expected_offset);
     }
 #endif
 
-    pc->head = child_node;
     pc->packet = packet;
     pc->packet_offset = packet_offset;
     pc->packet_limit = size_limit;
+    pc->buckets = (size_limit > PACKET_WRITER_HASHED_COMPRESSION_THRESHOLD)?pc->bucket_table:NULL;
+    
+    packet_writer_seed(pc);
 
     return SUCCESS;
 }
@@ -108,12 +302,20 @@ packet_writer_init(packet_writer* pc, u8* packet, u32 packet_offset, u32 size_li
 void
 packet_writer_create(packet_writer* pc, u8* packet, u32 limit)
 {
-    pc->pool_head = pc->pool;
-    
-    pc->head = NULL;
     pc->packet = packet;
     pc->packet_offset = DNS_HEADER_LENGTH;
     pc->packet_limit = limit;
+    pc->buckets = (limit > PACKET_WRITER_HASHED_COMPRESSION_THRESHOLD)?pc->bucket_table:NULL;
+    
+    packet_writer_seed(pc);
+}
+
+void
+packet_writer_set_hashed_compression(packet_writer *pw, bool hashed)
+{
+    pw->buckets = (hashed)?pw->bucket_table:NULL;
+    
+    packet_writer_seed(pw);
 }
 
 ya_result
@@ -127,6 +329,11 @@ packet_writer_add_fqdn_uncompressed(packet_writer* pc, const u8* fqdn)
 ya_result
 packet_writer_add_fqdn(packet_writer* pc, const u8* fqdn)
 {
+    if(pc->buckets != NULL)
+    {
+        return packet_writer_add_fqdn_hashed(pc, fqdn);
+    }
+    
     dnslabel_vector name;
     s32 top = dnsname_to_dnslabel_vector(fqdn, name);
     s32 best_top = top + 1;
@@ -60,7 +60,7 @@
 #define DO_PRINT 0
 #define DO_BUFFERIZE 1
 
-#define PARSER_STREAM_BUFFER_SIZE 4096
+#define PARSER_STREAM_BUFFER_SIZE 65536
 
 static const char eol_park_needle[2] = {' ', '\0'};
 static bool parser_init_error_codes_done = FALSE;
@@ -245,6 +245,43 @@ parser_clear_escape_codes(char **startp, int *lenp, char escape_char, char *new_
     return len;
 }
 
+/**
+ * Returns the first character in [needle;limit[ that is not of the NORMAL type,
+ * or limit if there is none.
+ *
+ * The type table is looked up eight bytes per iteration and the result of the block is
+ * or-ed, so runs of plain characters do not go through the state machine one by one.
+ *
+ * @param parser
+ * @param needle
+ * @param limit
+ * @return a pointer to the first special character or limit
+ */
+
+static inline char *
+parser_skip_normal(const parser_s *parser, char *needle, const char *limit)
+{
+    const char *char_type = parser->char_type;
+
+    while(limit - needle >= 8)
+    {
+        if((char_type[(u8)needle[0]] | char_type[(u8)needle[1]] | char_type[(u8)needle[2]] | char_type[(u8)needle[3]] |
+            char_type[(u8)needle[4]] | char_type[(u8)needle[5]] | char_type[(u8)needle[6]] | char_type[(u8)needle[7]]) != 0)
+        {
+            break;
+        }
+
+        needle += 8;
+    }
+
+    while((needle < limit) && (char_type[(u8)*needle] == PARSER_CHAR_TYPE_NORMAL))
+    {
+        ++needle;
+    }
+
+    return needle;
+}
+
 /**
  * 
  * returns the token type
@@ -293,6 +330,7 @@ parser_read_line(parser_s *parser)
                 // one line has been read (maybe)
 
                 buffer += return_code;
+                parser->bytes_read += return_code;
 
                 if(return_code > 1)
                 {
@@ -380,6 +418,15 @@ parser_next_token(parser_s *parser)
 
                     for(; needle < parser->limit; needle++)
                     {
+                        // jump over the run of NORMAL characters
+
+                        needle = parser_skip_normal(parser, needle, parser->limit);
+
+                        if(needle == parser->limit)
+                        {
+                            break;
+                        }
+
                         b = (u8)*needle;
 
                         switch(parser->char_type[b])
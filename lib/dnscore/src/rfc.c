@@ -190,6 +190,8 @@ const type_table qtype[] = {
     { TYPE_CTRL_ZONEUNFREEZE,     TYPE_CTRL_ZONEUNFREEZE_NAME     },
     { TYPE_CTRL_ZONEUNFREEZEALL,  TYPE_CTRL_ZONEUNFREEZEALL_NAME  },
     { TYPE_CTRL_ZONESYNC,         TYPE_CTRL_ZONESYNC_NAME         },
+    { TYPE_CTRL_SRVSTATS,         TYPE_CTRL_SRVSTATS_NAME         },
+    { TYPE_CTRL_SRVLOCKS,         TYPE_CTRL_SRVLOCKS_NAME         },
 
 #endif  
     { 0,               NULL                 }
@@ -0,0 +1,367 @@
+/*------------------------------------------------------------------------------
+*
+* Copyright (c) 2011-2019, EURid vzw. All rights reserved.
+* The YADIFA TM software product is provided under the BSD 3-clause license:
+* 
+* Redistribution and use in source and binary forms, with or without 
+* modification, are permitted provided that the following conditions
+* are met:
+*
+*        * Redistributions of source code must retain the above copyright 
+*          notice, this list of conditions and the following disclaimer.
+*        * Redistributions in binary form must reproduce the above copyright 
+*          notice, this list of conditions and the following disclaimer in the 
+*          documentation and/or other materials provided with the distribution.
+*        * Neither the name of EURid nor the names of its contributors may be 
+*          used to endorse or promote products derived from this software 
+*          without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*------------------------------------------------------------------------------
+*
+*/
+/** @defgroup cpu CPU
+ *  @ingroup dnscore
+ *  @brief NUMA topology
+ *
+ *
+ *
+ * @{
+ *
+ *----------------------------------------------------------------------------*/
+#define _GNU_SOURCE 1
+
+#include "dnscore/dnscore-config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <netinet/in.h>
+#include <ifaddrs.h>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+#include "dnscore/sys_types.h"
+#include "dnscore/sys_get_cpu_count.h"
+#include "dnscore/sys_numa.h"
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#define SYS_NUMA_CPU_MAX 1024
+#define SYS_NUMA_NODE_SCAN_MAX 64
+
+#define SYS_NUMA_MPOL_PREFERRED 1 // from linux/mempolicy.h
+
+static int sys_numa_nodes = 1;
+static s8 sys_numa_node_by_cpu[SYS_NUMA_CPU_MAX];
+static u16 sys_numa_cpu_count_by_node[SYS_NUMA_NODE_COUNT_MAX];
+static u16 *sys_numa_cpus_by_node[SYS_NUMA_NODE_COUNT_MAX];
+static bool sys_numa_init_done = FALSE;
+
+/**
+ * Reads the first line of a file in /sys
+ */
+
+static ssize_t
+sys_numa_read_line(const char *path, char *buffer, size_t buffer_size)
+{
+    int fd = open(path, O_RDONLY);
+    
+    if(fd < 0)
+    {
+        return -1;
+    }
+    
+    ssize_t n = read(fd, buffer, buffer_size - 1);
+    
+    close(fd);
+    
+    if(n < 0)
+    {
+        return -1;
+    }
+    
+    buffer[n] = '\0';
+    
+    return n;
+}
+
+/**
+ * Assigns the CPUs of a list (e.g. "0-7,16-23") to a node
+ */
+
+static void
+sys_numa_parse_cpulist(const char *text, int node)
+{
+    const char *p = text;
+    
+    while(*p != '\0')
+    {
+        char *end;
+        long from = strtol(p, &end, 10);
+        
+        if(end == p)
+        {
+            break;
+        }
+        
+        long to = from;
+        
+        p = end;
+        
+        if(*p == '-')
+        {
+            ++p;
+            to = strtol(p, &end, 10);
+            
+            if(end == p)
+            {
+                break;
+            }
+            
+            p = end;
+        }
+        
+        for(long cpu = from; (cpu <= to) && (cpu < SYS_NUMA_CPU_MAX); ++cpu)
+        {
+            sys_numa_node_by_cpu[cpu] = node;
+        }
+        
+        if(*p != ',')
+        {
+            break;
+        }
+        
+        ++p;
+    }
+}
+
+void
+sys_numa_init()
+{
+    if(sys_numa_init_done)
+    {
+        return;
+    }
+    
+    sys_numa_init_done = TRUE;
+    
+    memset(sys_numa_node_by_cpu, 0, sizeof(sys_numa_node_by_cpu));
+    
+    int nodes = 1;
+    
+#if defined(__linux__)
+    char path[64];
+    char cpulist[4096];
+    
+    for(int node = 0; node < SYS_NUMA_NODE_SCAN_MAX; ++node)
+    {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%i/cpulist", node);
+        
+        if(sys_numa_read_line(path, cpulist, sizeof(cpulist)) <= 0)
+        {
+            continue;
+        }
+        
+        sys_numa_parse_cpulist(cpulist, node % SYS_NUMA_NODE_COUNT_MAX);
+        
+        nodes = MAX(nodes, MIN(node + 1, SYS_NUMA_NODE_COUNT_MAX));
+    }
+#endif
+    
+    int cpu_count = MIN(sys_get_cpu_count(), SYS_NUMA_CPU_MAX);
+    
+    for(int node = 0; node < nodes; ++node)
+    {
+        MALLOC_OR_DIE(u16*, sys_numa_cpus_by_node[node], sizeof(u16) * cpu_count, GENERIC_TAG);
+        sys_numa_cpu_count_by_node[node] = 0;
+    }
+    
+    for(int cpu = 0; cpu < cpu_count; ++cpu)
+    {
+        int node = sys_numa_node_by_cpu[cpu];
+        sys_numa_cpus_by_node[node][sys_numa_cpu_count_by_node[node]++] = cpu;
+    }
+    
+    // a node without CPU (memory only) is of no use for placement: only keep the nodes up to the last one with CPUs
+    
+    while((nodes > 1) && (sys_numa_cpu_count_by_node[nodes - 1] == 0))
+    {
+        --nodes;
+    }
+    
+    sys_numa_nodes = nodes;
+}
+
+int
+sys_numa_node_count()
+{
+    return sys_numa_nodes;
+}
+
+int
+sys_numa_cpu_node(int cpu)
+{
+    if((cpu < 0) || (cpu >= SYS_NUMA_CPU_MAX))
+    {
+        return 0;
+    }
+    
+    return sys_numa_node_by_cpu[cpu];
+}
+
+int
+sys_numa_node_cpu(int node, int index)
+{
+    if((node < 0) || (node >= sys_numa_nodes) || (sys_numa_nodes == 1) || (sys_numa_cpu_count_by_node[node] == 0))
+    {
+        return index;
+    }
+    
+    return sys_numa_cpus_by_node[node][index % sys_numa_cpu_count_by_node[node]];
+}
+
+int
+sys_numa_current_node()
+{
+    if(sys_numa_nodes == 1)
+    {
+        return 0;
+    }
+    
+#if defined(__linux__)
+    return sys_numa_cpu_node(sched_getcpu());
+#else
+    return 0;
+#endif
+}
+
+int
+sys_numa_interface_node(const char *ifname)
+{
+#if defined(__linux__)
+    char path[128];
+    char text[16];
+    
+    snprintf(path, sizeof(path), "/sys/class/net/%s/device/numa_node", ifname);
+    
+    if(sys_numa_read_line(path, text, sizeof(text)) > 0)
+    {
+        int node = atoi(text);
+        
+        if(node >= 0)
+        {
+            return (node % SYS_NUMA_NODE_COUNT_MAX) % sys_numa_nodes;
+        }
+    }
+#else
+    (void)ifname;
+#endif
+    return -1;
+}
+
+int
+sys_numa_address_node(const struct sockaddr *sa)
+{
+    struct ifaddrs *ifa_list;
+    int node = -1;
+    
+    if(sys_numa_nodes == 1)
+    {
+        return -1;
+    }
+    
+    if(getifaddrs(&ifa_list) < 0)
+    {
+        return -1;
+    }
+    
+    for(struct ifaddrs *ifa = ifa_list; ifa != NULL; ifa = ifa->ifa_next)
+    {
+        if((ifa->ifa_addr == NULL) || (ifa->ifa_addr->sa_family != sa->sa_family))
+        {
+            continue;
+        }
+        
+        bool match;
+        
+        if(sa->sa_family == AF_INET)
+        {
+            match = memcmp(&((const struct sockaddr_in*)sa)->sin_addr, &((const struct sockaddr_in*)ifa->ifa_addr)->sin_addr, sizeof(struct in_addr)) == 0;
+        }
+        else if(sa->sa_family == AF_INET6)
+        {
+            match = memcmp(&((const struct sockaddr_in6*)sa)->sin6_addr, &((const struct sockaddr_in6*)ifa->ifa_addr)->sin6_addr, sizeof(struct in6_addr)) == 0;
+        }
+        else
+        {
+            match = FALSE;
+        }
+        
+        if(match)
+        {
+            node = sys_numa_interface_node(ifa->ifa_name);
+            break;
+        }
+    }
+    
+    freeifaddrs(ifa_list);
+    
+    return node;
+}
+
+void*
+sys_numa_alloc(size_t size, int node)
+{
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    
+    if(ptr == MAP_FAILED)
+    {
+        return NULL;
+    }
+    
+#if defined(__linux__) && defined(SYS_mbind)
+    if((node >= 0) && (sys_numa_nodes > 1))
+    {
+        // the pages are taken from the node as long as it has some, then from the closest ones
+        
+        unsigned long mask = 1UL << node;
+        syscall(SYS_mbind, ptr, size, SYS_NUMA_MPOL_PREFERRED, &mask, sizeof(mask) * 8 + 1, 0);
+    }
+#else
+    (void)node;
+#endif
+    
+    return ptr;
+}
+
+void
+sys_numa_free(void *ptr, size_t size)
+{
+    if(ptr != NULL)
+    {
+        munmap(ptr, size);
+    }
+}
+
+/** @} */
+
+/*----------------------------------------------------------------------------*/
@@ -81,6 +81,10 @@ extern logger_handle *g_system_logger;
 #define THREADPOOL_QUEUE_SIZE_FACTOR	4096 /* 2 */
 
 #define THREADPOOL_FLAG_PAUSED          1
+#define THREADPOOL_FLAG_WORK_STEALING   2
+
+#define THREADPOOL_WS_DEQUE_SIZE_MIN    16              /* initial size of a worker queue, grows as needed */
+#define THREADPOOL_WS_DEQUE_COUNT       256             /* thread_pool_size is an u8 */
 
 typedef struct threaded_queue_task threaded_queue_task;
 
@@ -91,6 +95,7 @@ struct threaded_queue_task
     thread_pool_task_counter *counter;
 
     const char* categoryname;           /* so it's easy to know what thread is running*/
+    u64 enqueued_us;                    /* for the queue latency statistics */
 };
 
 typedef struct thread_descriptor_s thread_descriptor_s;
@@ -101,7 +106,35 @@ struct thread_descriptor_s
     pthread_t id;
     volatile u8 status;
     u8 index;
+    volatile bool stop;                 /* work-stealing mode: drain the own queue then exit */
     char info[46];
+    
+    /* statistics, only written by the thread itself */
+    
+    u64 executed;
+    u64 wait_us_total;
+    u64 wait_us_max;
+    u64 busy_us_total;
+    u64 steals;
+};
+
+/*
+ * Work-stealing mode: each worker owns a queue of tasks (stored by value, so enqueuing
+ * does not allocate).  Producers spread the tasks round-robin, a worker that runs out of
+ * work takes from the queues of the others before going to sleep.
+ * The only shared lock is used for sleeping/waking up threads.
+ */
+
+typedef struct thread_pool_deque_s thread_pool_deque_s;
+
+struct thread_pool_deque_s
+{
+    mutex_t mtx;
+    threaded_queue_task *tasks;         /* ring */
+    u32 head;
+    u32 count;
+    u32 mask;
+    bool active;
 };
 
 /* The array of thread descriptors*/
@@ -125,11 +158,28 @@ struct thread_pool_s
     mutex_t mtx;
     struct thread_descriptor_s **descriptors;
     threaded_queue queue;
-    u8 thread_pool_size;
+    volatile u8 thread_pool_size;
     u8 flags;
 
     char *pool_name;
     u32 id;
+    
+    /* work-stealing mode */
+    
+    thread_pool_deque_s *deques;        /* THREADPOOL_WS_DEQUE_COUNT of them */
+    mutex_t ws_mtx;
+    cond_t ws_work_cond;                /* idle workers */
+    cond_t ws_room_cond;                /* producers waiting for the pending count to go down */
+    volatile s32 ws_pending;
+    volatile s32 ws_sleepers;
+    volatile s32 ws_producers;
+    volatile u32 ws_next;
+    s32 ws_queue_size;
+    
+    /* statistics */
+    
+    u64 created_us;
+    thread_pool_stats retired;          /* what the threads that have been removed did */
 };
 
 typedef struct thread_pool_s thread_pool_s;
@@ -213,10 +263,343 @@ pthread_pool_random_key_init()
 int
 thread_pool_queue_size(thread_pool_s *tp)
 {
-    int size = threaded_queue_size(&tp->queue);
+    int size;
+    
+    if((tp->flags & THREADPOOL_FLAG_WORK_STEALING) == 0)
+    {
+        size = threaded_queue_size(&tp->queue);
+    }
+    else
+    {
+        size = tp->ws_pending;
+    }
+    
     return size;
 }
 
+/**
+ * Work-stealing: puts a task at the end of a worker queue, growing it if needed.
+ * The deque must be locked.
+ */
+
+static void
+thread_pool_deque_push(thread_pool_deque_s *d, const threaded_queue_task *task)
+{
+    if(d->count > d->mask)
+    {
+        u32 size = (d->mask + 1) << 1;
+        threaded_queue_task *tasks;
+        MALLOC_OR_DIE(threaded_queue_task*, tasks, sizeof(threaded_queue_task) * size, THREADPOOL_TAG);
+        
+        for(u32 i = 0; i < d->count; ++i)
+        {
+            tasks[i] = d->tasks[(d->head + i) & d->mask];
+        }
+        
+        free(d->tasks);
+        d->tasks = tasks;
+        d->head = 0;
+        d->mask = size - 1;
+    }
+    
+    d->tasks[(d->head + d->count) & d->mask] = *task;
+    ++d->count;
+}
+
+/**
+ * Work-stealing: takes the task at the head of a worker queue.
+ * The deque must be locked and not empty.
+ */
+
+static void
+thread_pool_deque_pop(thread_pool_deque_s *d, threaded_queue_task *out_task)
+{
+    *out_task = d->tasks[d->head];
+    d->head = (d->head + 1) & d->mask;
+    --d->count;
+}
+
+static void
+thread_pool_deque_activate(thread_pool_deque_s *d)
+{
+    mutex_lock(&d->mtx);
+    if(d->tasks == NULL)
+    {
+        MALLOC_OR_DIE(threaded_queue_task*, d->tasks, sizeof(threaded_queue_task) * THREADPOOL_WS_DEQUE_SIZE_MIN, THREADPOOL_TAG);
+        d->mask = THREADPOOL_WS_DEQUE_SIZE_MIN - 1;
+        d->head = 0;
+        d->count = 0;
+    }
+    d->active = TRUE;
+    mutex_unlock(&d->mtx);
+}
+
+/**
+ * Work-stealing: a task has been taken from a queue.
+ * Wakes up the producers waiting for room, if any.
+ */
+
+static void
+thread_pool_ws_taken(thread_pool_s *tp)
+{
+    __sync_fetch_and_sub(&tp->ws_pending, 1);
+    
+    if(tp->ws_producers > 0)
+    {
+        mutex_lock(&tp->ws_mtx);
+        cond_notify(&tp->ws_room_cond);
+        mutex_unlock(&tp->ws_mtx);
+    }
+}
+
+/**
+ * Work-stealing: wakes up idle workers for count new tasks.
+ */
+
+static void
+thread_pool_ws_wake(thread_pool_s *tp, int count)
+{
+    if(tp->ws_sleepers > 0)
+    {
+        mutex_lock(&tp->ws_mtx);
+        if(count == 1)
+        {
+            cond_notify_one(&tp->ws_work_cond);
+        }
+        else
+        {
+            cond_notify(&tp->ws_work_cond);
+        }
+        mutex_unlock(&tp->ws_mtx);
+    }
+}
+
+/**
+ * Work-stealing: waits until the pool can accept count more tasks.
+ * The bound is soft: concurrent producers can go slightly above it.
+ * 
+ * @return TRUE if there is room, FALSE if there is none and wait was not allowed
+ */
+
+static bool
+thread_pool_ws_wait_for_room(thread_pool_s *tp, int count, bool wait)
+{
+    s32 pending = tp->ws_pending;
+    
+    if((pending == 0) || (pending + count <= tp->ws_queue_size))
+    {
+        return TRUE;
+    }
+    
+    if(!wait)
+    {
+        return FALSE;
+    }
+    
+    mutex_lock(&tp->ws_mtx);
+    __sync_fetch_and_add(&tp->ws_producers, 1);
+    for(;;)
+    {
+        pending = tp->ws_pending;
+        
+        if((pending == 0) || (pending + count <= tp->ws_queue_size))
+        {
+            break;
+        }
+        
+        cond_wait(&tp->ws_room_cond, &tp->ws_mtx);
+    }
+    __sync_fetch_and_sub(&tp->ws_producers, 1);
+    mutex_unlock(&tp->ws_mtx);
+    
+    return TRUE;
+}
+
+/**
+ * Work-stealing: pushes one task in the queue of the next worker.
+ */
+
+static void
+thread_pool_ws_enqueue(thread_pool_s *tp, const threaded_queue_task *task)
+{
+    for(;;)
+    {
+        u32 n = tp->thread_pool_size;
+        thread_pool_deque_s *d = &tp->deques[__sync_fetch_and_add(&tp->ws_next, 1) % n];
+        
+        mutex_lock(&d->mtx);
+        if(d->active)
+        {
+            thread_pool_deque_push(d, task);
+            __sync_fetch_and_add(&tp->ws_pending, 1);
+            mutex_unlock(&d->mtx);
+            break;
+        }
+        mutex_unlock(&d->mtx);
+        
+        // the pool is being shrunk, try the next one
+    }
+    
+    thread_pool_ws_wake(tp, 1);
+}
+
+/**
+ * Work-stealing: gets the next task for a worker.
+ * 
+ * Takes from its own queue first, then from the others.
+ * A worker told to stop only empties its own queue.
+ * 
+ * @return TRUE if a task has been taken, FALSE if the thread has to stop
+ */
+
+static bool
+thread_pool_ws_next_task(thread_descriptor_s *desc, threaded_queue_task *out_task)
+{
+    thread_pool_s *tp = desc->pool;
+    thread_pool_deque_s *own = &tp->deques[desc->index];
+    
+    for(;;)
+    {
+        if(own->count > 0)
+        {
+            mutex_lock(&own->mtx);
+            if(own->count > 0)
+            {
+                thread_pool_deque_pop(own, out_task);
+                mutex_unlock(&own->mtx);
+                thread_pool_ws_taken(tp);
+                return TRUE;
+            }
+            mutex_unlock(&own->mtx);
+        }
+        
+        if(desc->stop)
+        {
+            return FALSE;
+        }
+        
+        // steal: first pass only looks at the queues that are not being used,
+        //        second pass (only if the first one failed while work is pending) waits for them
+        
+        for(int pass = 0; (pass < 2) && (tp->ws_pending > 0); ++pass)
+        {
+            u32 n = tp->thread_pool_size;
+            
+            for(u32 i = 1; i < n; ++i)
+            {
+                thread_pool_deque_s *victim = &tp->deques[(desc->index + i) % n];
+                
+                if(victim->count == 0)
+                {
+                    continue;
+                }
+                
+                if(pass == 0)
+                {
+                    if(!mutex_trylock(&victim->mtx))
+                    {
+                        continue;
+                    }
+                }
+                else
+                {
+                    mutex_lock(&victim->mtx);
+                }
+                
+                if(victim->count > 0)
+                {
+                    thread_pool_deque_pop(victim, out_task);
+                    mutex_unlock(&victim->mtx);
+                    thread_pool_ws_taken(tp);
+                    ++desc->steals;
+                    return TRUE;
+                }
+                
+                mutex_unlock(&victim->mtx);
+            }
+        }
+        
+        // nothing to do: sleep until something is pushed (or the thread is told to stop)
+        // the sleepers/pending pair ensures no wake-up is lost
+        
+        mutex_lock(&tp->ws_mtx);
+        __sync_fetch_and_add(&tp->ws_sleepers, 1);
+        while((tp->ws_pending == 0) && (own->count == 0) && !desc->stop)
+        {
+            cond_wait(&tp->ws_work_cond, &tp->ws_mtx);
+        }
+        __sync_fetch_and_sub(&tp->ws_sleepers, 1);
+        mutex_unlock(&tp->ws_mtx);
+    }
+}
+
+/**
+ * Gets the next task for a worker.
+ * 
+ * @return TRUE if a task has been taken, FALSE if the thread has to stop
+ */
+
+static bool
+thread_pool_next_task(thread_descriptor_s *desc, threaded_queue_task *out_task)
+{
+    if((desc->pool->flags & THREADPOOL_FLAG_WORK_STEALING) == 0)
+    {
+        threaded_queue_task *task = (threaded_queue_task*)threaded_queue_dequeue(&desc->pool->queue);
+        
+        if(task == NULL)
+        {
+            return FALSE;
+        }
+        
+        *out_task = *task;
+        ZFREE(task, threaded_queue_task);
+        
+        return TRUE;
+    }
+    else
+    {
+        return thread_pool_ws_next_task(desc, out_task);
+    }
+}
+
+/**
+ * Tells one thread to stop once it has finished the work queued for it.
+ */
+
+static void
+thread_pool_send_stop(thread_pool_s *tp, thread_descriptor_s *td)
+{
+    if((tp->flags & THREADPOOL_FLAG_WORK_STEALING) == 0)
+    {
+        threaded_queue_enqueue(&tp->queue, NULL);
+    }
+    else
+    {
+        td->stop = TRUE;
+        mutex_lock(&tp->ws_mtx);
+        cond_notify(&tp->ws_work_cond);
+        mutex_unlock(&tp->ws_mtx);
+    }
+}
+
+/**
+ * Adds the statistics of a thread to the retired statistics of the pool.
+ * Used when a thread is removed from a pool.
+ */
+
+static void
+thread_pool_retire_stats(thread_pool_s *tp, thread_descriptor_s *td)
+{
+    tp->retired.executed += td->executed;
+    tp->retired.wait_us_total += td->wait_us_total;
+    if(tp->retired.wait_us_max < td->wait_us_max)
+    {
+        tp->retired.wait_us_max = td->wait_us_max;
+    }
+    tp->retired.busy_us_total += td->busy_us_total;
+    tp->retired.steals += td->steals;
+}
+
 static void*
 thread_pool_thread(void *args)
 {
@@ -228,8 +611,6 @@ thread_pool_thread(void *args)
 
     thread_descriptor_s* desc = (thread_descriptor_s*)args;
 
-    threaded_queue *queue = &desc->pool->queue;
-
 #if VERBOSE_THREAD_LOG > 1
     pthread_t id = desc->id;
 #endif
@@ -279,13 +660,15 @@ thread_pool_thread(void *args)
                 
         desc->status = THREAD_STATUS_WAITING;
 
-        void* data = threaded_queue_dequeue(queue);
+        threaded_queue_task task;
+        
+        bool got_task = thread_pool_next_task(desc, &task);
 
 #ifdef DEBUG
         smp_int_dec(&thread_pool_waiting);
 #endif
         
-        if(data == NULL)
+        if(!got_task)
         {        
 #if VERBOSE_THREAD_LOG > 1
             log_debug("thread: %x got terminate", id);
@@ -297,14 +680,18 @@ thread_pool_thread(void *args)
 
         desc->status = THREAD_STATUS_WORKING;
 
-        threaded_queue_task* task = (threaded_queue_task*)data;
-
-        thread_pool_task_counter *counter = task->counter;
-        thread_pool_function* function = task->function;
-        void* parm = task->parm;
-        const char* categoryname = task->categoryname;
-
-        ZFREE(task, threaded_queue_task);
+        thread_pool_task_counter *counter = task.counter;
+        thread_pool_function* function = task.function;
+        void* parm = task.parm;
+        const char* categoryname = task.categoryname;
+        
+        u64 start = timeus();
+        u64 wait = (start > task.enqueued_us)?start - task.enqueued_us:0;
+        desc->wait_us_total += wait;
+        if(desc->wait_us_max < wait)
+        {
+            desc->wait_us_max = wait;
+        }
 
         strncpy(desc->info, categoryname, sizeof(desc->info));
 
@@ -336,6 +723,9 @@ thread_pool_thread(void *args)
         smp_int_dec(&thread_pool_running);
 #endif
         
+        desc->busy_us_total += timeus() - start;
+        ++desc->executed;
+        
 #if VERBOSE_THREAD_LOG > 3
         log_debug("thread: %x %s::%p(%p) end", id, categoryname, function, parm);
 #endif
@@ -461,11 +851,11 @@ thread_pool_create_thread(thread_pool_s *tp, int index)
     return td;
 }
 
-struct thread_pool_s*
-thread_pool_init_ex(u8 thread_count, u32 queue_size, const char *pool_name)
+static struct thread_pool_s*
+thread_pool_init_with_flags(u8 thread_count, u32 queue_size, const char *pool_name, u8 flags)
 {
 #if VERBOSE_THREAD_LOG > 1
-    log_debug("thread_pool_init(%d, %d, %s)", thread_count, queue_size, STRNULL(pool_name));
+    log_debug("thread_pool_init(%d, %d, %s, %x)", thread_count, queue_size, STRNULL(pool_name), flags);
 #endif
     
     if(thread_count == 0)
@@ -489,11 +879,7 @@ thread_pool_init_ex(u8 thread_count, u32 queue_size, const char *pool_name)
     MALLOC_OR_DIE(thread_pool_s*, tp, sizeof(thread_pool_s), THRDPOOL_TAG);
     ZEROMEMORY(tp, sizeof(thread_pool_s));
     
-#if HAS_PTHREAD_SETNAME_NP
-#ifdef DEBUG
     tp->pool_name = strdup(pool_name);
-#endif
-#endif
 
     log_debug("thread-pool: '%s' init", pool_name);
  
@@ -502,10 +888,35 @@ thread_pool_init_ex(u8 thread_count, u32 queue_size, const char *pool_name)
     mutex_init(&tp->mtx);
 
     tp->thread_pool_size = thread_count;
+    tp->flags = flags;
+    tp->created_us = timeus();
 
     u8 i; /* thread creation loop counter */
 
-    threaded_queue_init(&tp->queue, queue_size);
+    if((flags & THREADPOOL_FLAG_WORK_STEALING) == 0)
+    {
+        threaded_queue_init(&tp->queue, queue_size);
+    }
+    else
+    {
+        MALLOC_OR_DIE(thread_pool_deque_s*, tp->deques, sizeof(thread_pool_deque_s) * THREADPOOL_WS_DEQUE_COUNT, THREADPOOL_TAG);
+        ZEROMEMORY(tp->deques, sizeof(thread_pool_deque_s) * THREADPOOL_WS_DEQUE_COUNT);
+        
+        for(int j = 0; j < THREADPOOL_WS_DEQUE_COUNT; ++j)
+        {
+            mutex_init(&tp->deques[j].mtx);
+        }
+        
+        for(i = 0; i < thread_count; i++)
+        {
+            thread_pool_deque_activate(&tp->deques[i]);
+        }
+        
+        mutex_init(&tp->ws_mtx);
+        cond_init(&tp->ws_work_cond);
+        cond_init(&tp->ws_room_cond);
+        tp->ws_queue_size = (s32)MIN(queue_size, (u32)MAX_S32);
+    }
 
     MALLOC_OR_DIE(thread_descriptor_s**, thread_descriptors, thread_count * sizeof(thread_descriptor_s*), THREADPOOL_TAG);
 
@@ -518,7 +929,10 @@ thread_pool_init_ex(u8 thread_count, u32 queue_size, const char *pool_name)
             log_err("thread-pool: '%s' failed to create thread #%i/%i", pool_name, i, thread_count);
 
             free(thread_descriptors);
-            threaded_queue_finalize(&tp->queue);
+            if((flags & THREADPOOL_FLAG_WORK_STEALING) == 0)
+            {
+                threaded_queue_finalize(&tp->queue);
+            }
             return NULL;
         }
         
@@ -547,6 +961,22 @@ thread_pool_init_ex(u8 thread_count, u32 queue_size, const char *pool_name)
     return tp;
 }
 
+struct thread_pool_s*
+thread_pool_init_ex(u8 thread_count, u32 queue_size, const char *pool_name)
+{
+    struct thread_pool_s* tp = thread_pool_init_with_flags(thread_count, queue_size, pool_name, 0);
+    
+    return tp;
+}
+
+struct thread_pool_s*
+thread_pool_init_work_stealing(u8 thread_count, u32 queue_size, const char *pool_name)
+{
+    struct thread_pool_s* tp = thread_pool_init_with_flags(thread_count, queue_size, pool_name, THREADPOOL_FLAG_WORK_STEALING);
+    
+    return tp;
+}
+
 struct thread_pool_s*
 thread_pool_init(u8 thread_count, u32 queue_size)
 {
@@ -611,19 +1041,29 @@ thread_pool_enqueue_call(struct thread_pool_s* tp, thread_pool_function func, vo
     
 #endif
     
+    if(categoryname == NULL)
+    {
+        categoryname = "anonymous";
+    }
+    
+    if((tp->flags & THREADPOOL_FLAG_WORK_STEALING) != 0)
+    {
+        threaded_queue_task task = {func, parm, counter, categoryname, timeus()};
+        
+        thread_pool_ws_wait_for_room(tp, 1, TRUE);
+        thread_pool_ws_enqueue(tp, &task);
+        
+        return SUCCESS;
+    }
+    
     threaded_queue_task* task;
     ZALLOC_OR_DIE(threaded_queue_task*, task, threaded_queue_task, THREADPOOL_TAG);
 
     task->function = func;
     task->parm = parm;
     task->counter = counter;
-
-    if(categoryname == NULL)
-    {
-        categoryname = "anonymous";
-    }
-    
     task->categoryname = categoryname;
+    task->enqueued_us = timeus();
 
     threaded_queue_enqueue(&tp->queue, task);
 
@@ -646,19 +1086,32 @@ thread_pool_enqueue_call(struct thread_pool_s* tp, thread_pool_function func, vo
 ya_result
 thread_pool_try_enqueue_call(struct thread_pool_s* tp, thread_pool_function func, void* parm, thread_pool_task_counter *counter, const char* categoryname)
 {
+    if(categoryname == NULL)
+    {
+        categoryname = "anonymous";
+    }
+    
+    if((tp->flags & THREADPOOL_FLAG_WORK_STEALING) != 0)
+    {
+        if(!thread_pool_ws_wait_for_room(tp, 1, FALSE))
+        {
+            return LOCK_TIMEOUT;   // full
+        }
+        
+        threaded_queue_task task = {func, parm, counter, categoryname, timeus()};
+        thread_pool_ws_enqueue(tp, &task);
+        
+        return SUCCESS;
+    }
+    
     threaded_queue_task* task;
     ZALLOC_OR_DIE(threaded_queue_task*, task, threaded_queue_task, THREADPOOL_TAG);
 
     task->function = func;
     task->parm = parm;
     task->counter = counter;
-
-    if(categoryname == NULL)
-    {
-        categoryname = "anonymous";
-    }
-    
     task->categoryname = categoryname;
+    task->enqueued_us = timeus();
     
     if(threaded_queue_try_enqueue(&tp->queue, task))
     {
@@ -671,6 +1124,16 @@ thread_pool_try_enqueue_call(struct thread_pool_s* tp, thread_pool_function func
     }
 }
 
+static void
+thread_pool_task_from_item(threaded_queue_task *task, const thread_pool_enqueue_call_item *item, u64 now)
+{
+    task->function = item->func;
+    task->parm = item->parm;
+    task->counter = item->counter;
+    task->categoryname = (item->categoryname != NULL)?item->categoryname:"anonymous";
+    task->enqueued_us = now;
+}
+
 /**
  * Enqueues a fixed amount of tasks in one go.
  * This new feature helps fixing a starvation issue when allocating consumers
@@ -699,25 +1162,74 @@ thread_pool_enqueue_calls(struct thread_pool_s *tp, thread_pool_enqueue_call_ite
     
     //threaded_ringbuffer_cw_enqueue_set(&tp->queue, void **constant_pointer_array, int count)
     
+    if(tasks_count <= 0)
+    {
+        return SUCCESS;
+    }
+    
+    u64 now = timeus();
+    
+    if((tp->flags & THREADPOOL_FLAG_WORK_STEALING) != 0)
+    {
+        // the tasks are spread over the worker queues, each queue being locked only once
+        
+        thread_pool_ws_wait_for_room(tp, tasks_count, TRUE);
+        
+        bool pushed[tasks_count];
+        u32 n = tp->thread_pool_size;
+        u32 first = __sync_fetch_and_add(&tp->ws_next, (u32)tasks_count);
+        
+        for(u32 j = 0; (j < n) && (j < (u32)tasks_count); ++j)
+        {
+            thread_pool_deque_s *d = &tp->deques[(first + j) % n];
+            int taken = 0;
+            
+            mutex_lock(&d->mtx);
+            
+            // this queue takes the tasks j, j + n, j + 2n, ...
+            
+            for(int i = j; i < tasks_count; i += n)
+            {
+                pushed[i] = d->active;
+                
+                if(d->active)
+                {
+                    threaded_queue_task task;
+                    thread_pool_task_from_item(&task, &tasks_parameter[i], now);
+                    thread_pool_deque_push(d, &task);
+                    ++taken;
+                }
+            }
+            
+            __sync_fetch_and_add(&tp->ws_pending, taken);
+            
+            mutex_unlock(&d->mtx);
+        }
+        
+        // the queues that were not active (the pool is being shrunk)
+        
+        for(int i = 0; i < tasks_count; ++i)
+        {
+            if(!pushed[i])
+            {
+                threaded_queue_task task;
+                thread_pool_task_from_item(&task, &tasks_parameter[i], now);
+                thread_pool_ws_enqueue(tp, &task);
+            }
+        }
+        
+        thread_pool_ws_wake(tp, tasks_count);
+        
+        return SUCCESS;
+    }
+    
     threaded_queue_task *tasks[tasks_count];
     for(int i = 0 ; i < tasks_count; ++i)
     {
         threaded_queue_task *task;
         ZALLOC_OR_DIE(threaded_queue_task*, task, threaded_queue_task, THREADPOOL_TAG);
         tasks[i] = task;
-
-        task->function = tasks_parameter[i].func;
-        task->parm = tasks_parameter[i].parm;
-        task->counter = tasks_parameter[i].counter;
-
-        if(tasks_parameter[i].categoryname == NULL)
-        {
-            task->categoryname = "anonymous";
-        }
-        else
-        {
-            task->categoryname = tasks_parameter[i].categoryname;
-        }
+        thread_pool_task_from_item(task, &tasks_parameter[i], now);
     }
 
     threaded_ringbuffer_cw_enqueue_set(&tp->queue, (void**)tasks, tasks_count);
@@ -771,31 +1283,31 @@ thread_pool_stop(struct thread_pool_s* tp)
 #if VERBOSE_THREAD_LOG > 1
                 log_debug("thread: #%i [%x]: already terminating", i, td[i]->id);
 #endif
-                threaded_queue_enqueue(&tp->queue, NULL);
+                thread_pool_send_stop(tp, td[i]);
                 break;
             case THREAD_STATUS_TERMINATED:
 #if VERBOSE_THREAD_LOG > 1
                 log_debug("thread: #%i [%x]: already terminated", i, td[i]->id);
 #endif
-                threaded_queue_enqueue(&tp->queue, NULL);
+                thread_pool_send_stop(tp, td[i]);
                 break;
             case THREAD_STATUS_WORKING:
 #if VERBOSE_THREAD_LOG > 2
                 log_debug("thread: #%i [%x]: working: sending stop", i, td[i]->id);
 #endif
-                threaded_queue_enqueue(&tp->queue, NULL);
+                thread_pool_send_stop(tp, td[i]);
                 break;
             case THREAD_STATUS_WAITING:
 #if VERBOSE_THREAD_LOG > 2
                 log_debug("thread: #%i [%x]: waiting: sending stop", i, td[i]->id);
 #endif
-                threaded_queue_enqueue(&tp->queue, NULL);
+                thread_pool_send_stop(tp, td[i]);
                 break;
             default:
 #if VERBOSE_THREAD_LOG > 2
                 log_debug("thread: #%i [%x]: sending stop on %i status", i, td[i]->id, td[i]->status);
 #endif
-                threaded_queue_enqueue(&tp->queue, NULL);
+                thread_pool_send_stop(tp, td[i]);
                 break;
         }
     }
@@ -897,7 +1409,8 @@ thread_pool_start(struct thread_pool_s* tp)
         int ret;
         
         thread_descriptors[i]->status = THREAD_STATUS_STARTING;
-        thread_descriptors[i]->index = (u8)tps;
+        thread_descriptors[i]->index = i;
+        thread_descriptors[i]->stop = FALSE;
         if((ret = pthread_create(&thread_descriptors[i]->id, NULL, thread_pool_thread, thread_descriptors[i])) != 0)
         {
             return ret;
@@ -957,6 +1470,11 @@ thread_pool_resize(struct thread_pool_s* tp, u8 new_size)
         for(i = tps; i < new_size; i++)
         {
             thread_descriptor_s *td;
+            
+            if((tp->flags & THREADPOOL_FLAG_WORK_STEALING) != 0)
+            {
+                thread_pool_deque_activate(&tp->deques[i]);
+            }
 
             if((td = thread_pool_create_thread(tp, i)) == NULL)
             {
@@ -995,6 +1513,10 @@ thread_pool_resize(struct thread_pool_s* tp, u8 new_size)
         
         memcpy(thread_descriptors, tds, sizeof(thread_descriptor_s*) * new_size);
         
+        // producers should not target the threads being removed anymore
+        
+        tp->thread_pool_size = new_size;
+        
         // stop threads [new_size;tps[
         
         for(i = new_size; i < tps; i++)
@@ -1005,31 +1527,31 @@ thread_pool_resize(struct thread_pool_s* tp, u8 new_size)
 #if VERBOSE_THREAD_LOG > 1
                     log_debug("thread: #%i [%x]: already terminating", i, tds[i]->id);
 #endif
-                    threaded_queue_enqueue(&tp->queue, NULL);
+                    thread_pool_send_stop(tp, tds[i]);
                     break;
                 case THREAD_STATUS_TERMINATED:
 #if VERBOSE_THREAD_LOG > 1
                     log_debug("thread: #%i [%x]: already terminated", i, tds[i]->id);
 #endif
-                    threaded_queue_enqueue(&tp->queue, NULL);
+                    thread_pool_send_stop(tp, tds[i]);
                     break;
                 case THREAD_STATUS_WORKING:
 #if VERBOSE_THREAD_LOG > 2
                     log_debug("thread: #%i [%x]: working: sending stop", i, tds[i]->id);
 #endif
-                    threaded_queue_enqueue(&tp->queue, NULL);
+                    thread_pool_send_stop(tp, tds[i]);
                     break;
                 case THREAD_STATUS_WAITING:
 #if VERBOSE_THREAD_LOG > 2
                     log_debug("thread: #%i [%x]: waiting: sending stop", i, tds[i]->id);
 #endif
-                    threaded_queue_enqueue(&tp->queue, NULL);
+                    thread_pool_send_stop(tp, tds[i]);
                     break;
                 default:
 #if VERBOSE_THREAD_LOG > 2
                     log_debug("thread: #%i [%x]: sending stop on %i status", i, tds[i]->id, tds[i]->status);
 #endif
-                    threaded_queue_enqueue(&tp->queue, NULL);
+                    thread_pool_send_stop(tp, tds[i]);
                     break;
             }
         }
@@ -1069,6 +1591,38 @@ thread_pool_resize(struct thread_pool_s* tp, u8 new_size)
    #if VERBOSE_THREAD_LOG > 2
            log_debug("thread: #%i: terminated", i);
    #endif
+           
+           if((tp->flags & THREADPOOL_FLAG_WORK_STEALING) != 0)
+           {
+               // give what has been pushed in the queue since the thread stopped to the first one
+               
+               thread_pool_deque_s *d = &tp->deques[i];
+               thread_pool_deque_s *d0 = &tp->deques[0];
+               int moved = 0;
+               
+               mutex_lock(&d->mtx);
+               d->active = FALSE;
+               if(d->count > 0)
+               {
+                   mutex_lock(&d0->mtx);
+                   while(d->count > 0)
+                   {
+                       threaded_queue_task task;
+                       thread_pool_deque_pop(d, &task);
+                       thread_pool_deque_push(d0, &task);
+                       ++moved;
+                   }
+                   mutex_unlock(&d0->mtx);
+               }
+               mutex_unlock(&d->mtx);
+               
+               if(moved > 0)
+               {
+                   thread_pool_ws_wake(tp, moved);
+               }
+           }
+           
+           thread_pool_retire_stats(tp, tds[i]);
 
            free(tds[i]);
 
@@ -1130,31 +1684,31 @@ thread_pool_destroy(struct thread_pool_s* tp)
 #if VERBOSE_THREAD_LOG > 1
                 log_debug("thread: #%i [%x]: already terminating", i, td[i]->id);
 #endif
-                threaded_queue_enqueue(&tp->queue, NULL);
+                thread_pool_send_stop(tp, td[i]);
                 break;
             case THREAD_STATUS_TERMINATED:
 #if VERBOSE_THREAD_LOG > 1
                 log_debug("thread: #%i [%x]: already terminated", i, td[i]->id);
 #endif
-                threaded_queue_enqueue(&tp->queue, NULL);
+                thread_pool_send_stop(tp, td[i]);
                 break;
             case THREAD_STATUS_WORKING:
 #if VERBOSE_THREAD_LOG > 2
                 log_debug("thread: #%i [%x]: working: sending stop", i, td[i]->id);
 #endif
-                threaded_queue_enqueue(&tp->queue, NULL);
+                thread_pool_send_stop(tp, td[i]);
                 break;
             case THREAD_STATUS_WAITING:
 #if VERBOSE_THREAD_LOG > 2
                 log_debug("thread: #%i [%x]: waiting: sending stop", i, td[i]->id);
 #endif
-                threaded_queue_enqueue(&tp->queue, NULL);
+                thread_pool_send_stop(tp, td[i]);
                 break;
             default:
 #if VERBOSE_THREAD_LOG > 2
                 log_debug("thread: #%i [%x]: sending stop on %i status", i, td[i]->id, td[i]->status);
 #endif
-                threaded_queue_enqueue(&tp->queue, NULL);
+                thread_pool_send_stop(tp, td[i]);
                 break;
         }
     }
@@ -1206,7 +1760,24 @@ thread_pool_destroy(struct thread_pool_s* tp)
     log_debug("thread: thread_pool_destroy: finalize");
 #endif
 
-    threaded_queue_finalize(&tp->queue);
+    if((tp->flags & THREADPOOL_FLAG_WORK_STEALING) == 0)
+    {
+        threaded_queue_finalize(&tp->queue);
+    }
+    else
+    {
+        for(int j = 0; j < THREADPOOL_WS_DEQUE_COUNT; ++j)
+        {
+            free(tp->deques[j].tasks);
+            mutex_destroy(&tp->deques[j].mtx);
+        }
+        
+        free(tp->deques);
+        
+        cond_finalize(&tp->ws_room_cond);
+        cond_finalize(&tp->ws_work_cond);
+        mutex_destroy(&tp->ws_mtx);
+    }
     
     if(tp->pool_name != NULL)
     {
@@ -1219,6 +1790,67 @@ thread_pool_destroy(struct thread_pool_s* tp)
 }
 
 
+void
+thread_pool_get_stats(struct thread_pool_s *tp, thread_pool_stats *out_stats)
+{
+    mutex_lock(&tp->mtx);
+    
+    *out_stats = tp->retired;
+    
+    thread_descriptor_s **td = tp->descriptors;
+    
+    if(td != NULL)
+    {
+        for(int i = 0; i < tp->thread_pool_size; ++i)
+        {
+            out_stats->executed += td[i]->executed;
+            out_stats->wait_us_total += td[i]->wait_us_total;
+            if(out_stats->wait_us_max < td[i]->wait_us_max)
+            {
+                out_stats->wait_us_max = td[i]->wait_us_max;
+            }
+            out_stats->busy_us_total += td[i]->busy_us_total;
+            out_stats->steals += td[i]->steals;
+        }
+    }
+    
+    out_stats->uptime_us = timeus() - tp->created_us;
+    out_stats->queued = thread_pool_queue_size(tp);
+    out_stats->thread_count = tp->thread_pool_size;
+    
+    mutex_unlock(&tp->mtx);
+}
+
+void
+thread_pool_log_stats_all(logger_handle *handle)
+{
+    mutex_lock(&thread_pool_set_mutex);
+    
+    u32_set_avl_iterator iter;
+    u32_set_avl_iterator_init(&thread_pool_set, &iter);
+    while(u32_set_avl_iterator_hasnext(&iter))
+    {
+        u32_node *node = u32_set_avl_iterator_next_node(&iter);
+        if(node->value != NULL)
+        {
+            thread_pool_s *tp = (thread_pool_s*)node->value;
+            thread_pool_stats stats;
+            
+            thread_pool_get_stats(tp, &stats);
+            
+            u64 wait_avg = (stats.executed > 0)?stats.wait_us_total / stats.executed:0;
+            u64 capacity = stats.uptime_us * stats.thread_count;
+            u64 utilisation = (capacity > 0)?(stats.busy_us_total * 1000) / capacity:0;
+            
+            logger_handle_msg(handle, MSG_INFO, "thread-pool: '%s' threads=%hhu queued=%i executed=%llu wait-avg=%lluus wait-max=%lluus utilisation=%llu.%llu%% steals=%llu",
+                    STRNULL(tp->pool_name), stats.thread_count, stats.queued, stats.executed,
+                    wait_avg, stats.wait_us_max, utilisation / 10, utilisation % 10, stats.steals);
+        }
+    }
+    
+    mutex_unlock(&thread_pool_set_mutex);
+}
+
 ya_result
 thread_pool_stop_all()
 {
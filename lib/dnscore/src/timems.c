@@ -137,6 +137,23 @@ timeus()
     return r;
 }
 
+u64
+timens_monotonic()
+{
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    u64 r = ts.tv_sec;
+    r *= 1000000000LL;
+    r += ts.tv_nsec;
+
+    return r;
+#else
+    return timeus() * 1000LL;
+#endif
+}
+
 u64
 timems()
 {
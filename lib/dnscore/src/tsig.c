@@ -65,6 +65,11 @@
 
 #define TSIG_TCP_PERIOD 99
 
+/* times the signature of the messages of a TCP stream (ie: AXFR/IXFR answers), see debug_bench_logdump_all */
+#ifndef DEBUG_BENCH_TSIG
+#define DEBUG_BENCH_TSIG 0
+#endif
+
 /* overrites the detected TSIG with 0xff */
 #define TSIG_DESTROY_DEBUG 1
 
@@ -166,7 +171,7 @@
  * A macro to initialize a node and setting the reference
  */
 
-#define AVL_INIT_NODE(node,reference) ZEROMEMORY((node),sizeof(tsig_node));(node)->item.name = dnsname_dup(reference)
+#define AVL_INIT_NODE(node,reference) ZEROMEMORY((node),sizeof(tsig_node));mutex_init(&(node)->item.hmac_template_mtx);(node)->item.name = dnsname_dup(reference)
 
 /*
  * A macro to allocate a new node
@@ -178,7 +183,7 @@
  * A macro to free a node allocated by ALLOC_NODE
  */
 
-#define AVL_FREE_NODE(node) free((u8*)(node)->item.name);free((u8*)(node)->item.mac);free(node)
+#define AVL_FREE_NODE(node) tsig_item_template_clear(&(node)->item);mutex_destroy(&(node)->item.hmac_template_mtx);free((u8*)(node)->item.name);free((u8*)(node)->item.mac);free(node)
 /*
  * A macro to print the node
  */
@@ -206,7 +211,9 @@
 					    MALLOC_OR_DIE(const u8*,(node_trg)->item.mac,(node_src)->item.mac_size, TSIGPAYL_TAG); \
 					    MEMCOPY((u8*)(node_trg)->item.mac, (node_src)->item.mac, (node_src)->item.mac_size);  \
 					    (node_trg)->item.mac_size = (node_src)->item.mac_size; \
-					    (node_trg)->item.mac_algorithm = (node_src)->item.mac_algorithm;
+					    (node_trg)->item.mac_algorithm = (node_src)->item.mac_algorithm; \
+					    (node_trg)->item.evp_md = (node_src)->item.evp_md; \
+					    tsig_item_template_update(&(node_trg)->item);
 /*
  * A macro to preprocess a node before it is preprocessed for a delete (detach)
  * If there was anything to do BEFORE deleting a node, we would do it here
@@ -217,6 +224,9 @@
  */
 #define AVL_NODE_DELETE_CALLBACK(node)
 
+static void tsig_item_template_update(tsig_item *tsig);
+static void tsig_item_template_clear(tsig_item *tsig);
+
 #include "dnscore/avl.c.inc"
 #include "dnscore/message.h" // DO NOT REMOVE ME
 
@@ -316,6 +326,228 @@ tsig_hmac_final(tsig_hmac_t hmac, void *out_data, unsigned int *out_len)
 #endif
 }
 
+/**
+ * Keyed HMAC contexts
+ *
+ * Keying an HMAC context hashes the key and both pads, which is most of the cost for small messages.
+ * Each registered tsig_item keeps a keyed template and every message gets a clone of it.
+ * The cloned contexts are kept in a small per-thread pool so they are not re-allocated either.
+ */
+
+#define TSIGPOOL_TAG 0x4c4f4f5047495354
+
+#define TSIG_HMAC_POOL_SIZE 8
+
+struct tsig_hmac_pool_s
+{
+    tsig_hmac_t ctx[TSIG_HMAC_POOL_SIZE];
+    u32 count;
+};
+
+typedef struct tsig_hmac_pool_s tsig_hmac_pool_s;
+
+static pthread_key_t tsig_hmac_pool_key;
+static pthread_once_t tsig_hmac_pool_key_once = PTHREAD_ONCE_INIT;
+
+static void
+tsig_hmac_pool_finalize(void *pool_)
+{
+    tsig_hmac_pool_s *pool = (tsig_hmac_pool_s*)pool_;
+
+    for(u32 i = 0; i < pool->count; ++i)
+    {
+        tsig_hmac_free(pool->ctx[i]);
+    }
+
+    free(pool);
+}
+
+static void
+tsig_hmac_pool_key_init()
+{
+    if(pthread_key_create(&tsig_hmac_pool_key, tsig_hmac_pool_finalize) != 0)
+    {
+        log_quit("tsig: pthread_key_create = %r", ERRNO_ERROR);
+    }
+}
+
+static tsig_hmac_pool_s*
+tsig_hmac_pool_get()
+{
+    pthread_once(&tsig_hmac_pool_key_once, tsig_hmac_pool_key_init);
+
+    tsig_hmac_pool_s *pool = (tsig_hmac_pool_s*)pthread_getspecific(tsig_hmac_pool_key);
+
+    if(pool == NULL)
+    {
+        MALLOC_OR_DIE(tsig_hmac_pool_s*, pool, sizeof(tsig_hmac_pool_s), TSIGPOOL_TAG);
+        pool->count = 0;
+        pthread_setspecific(tsig_hmac_pool_key, pool);
+    }
+
+    return pool;
+}
+
+/**
+ * A keyed template is never modified once published: a new key publishes a new template.
+ * Cloning it only needs a reference, the last one frees it.
+ */
+
+#define TSIGTMPL_TAG 0x4c504d5447495354
+
+struct tsig_hmac_template_s
+{
+    HMAC_CTX *hmac;
+    volatile s32 rc;
+};
+
+typedef struct tsig_hmac_template_s tsig_hmac_template_s;
+
+#if !SSL_API_LT_100
+static tsig_hmac_template_s*
+tsig_hmac_template_acquire(const tsig_item *tsig)
+{
+    mutex_t *mtx = (mutex_t*)&tsig->hmac_template_mtx;
+
+    mutex_lock(mtx);
+    tsig_hmac_template_s *hmac_template = tsig->hmac_template;
+    if(hmac_template != NULL)
+    {
+        __sync_add_and_fetch(&hmac_template->rc, 1);
+    }
+    mutex_unlock(mtx);
+
+    return hmac_template;
+}
+#endif
+
+static void
+tsig_hmac_template_release(tsig_hmac_template_s *hmac_template)
+{
+    if(__sync_sub_and_fetch(&hmac_template->rc, 1) == 0)
+    {
+        tsig_hmac_free(hmac_template->hmac);
+        free(hmac_template);
+    }
+}
+
+/**
+ * Sets the HMAC context to the keyed state of the tsig item.
+ * Clones the template if the item has one, else keys the context the slow way.
+ */
+
+static void
+tsig_hmac_rekey(tsig_hmac_t hmac, const tsig_item *tsig)
+{
+#if !SSL_API_LT_100
+    tsig_hmac_template_s *hmac_template = tsig_hmac_template_acquire(tsig);
+
+    if(hmac_template != NULL)
+    {
+#if SSL_API_LT_110
+        // 1.0.x does not release the digests of the destination before the copy
+
+        tsig_hmac_reset(hmac);
+#endif
+        bool copied = (HMAC_CTX_copy(hmac, hmac_template->hmac) == 1);
+
+        tsig_hmac_template_release(hmac_template);
+
+        if(copied)
+        {
+            return;
+        }
+
+        tsig_hmac_reset(hmac);
+    }
+#endif
+
+    tsig_hmac_init(hmac, tsig->mac, tsig->mac_size, tsig->evp_md);
+}
+
+tsig_hmac_t
+tsig_hmac_acquire(const tsig_item *tsig)
+{
+    tsig_hmac_pool_s *pool = tsig_hmac_pool_get();
+    tsig_hmac_t hmac;
+
+    if(pool->count > 0)
+    {
+        hmac = pool->ctx[--pool->count];
+    }
+    else
+    {
+        hmac = tsig_hmac_allocate();
+    }
+
+    tsig_hmac_rekey(hmac, tsig);
+
+    return hmac;
+}
+
+void
+tsig_hmac_release(tsig_hmac_t hmac)
+{
+    tsig_hmac_pool_s *pool = tsig_hmac_pool_get();
+
+    if(pool->count < TSIG_HMAC_POOL_SIZE)
+    {
+        pool->ctx[pool->count++] = hmac;
+    }
+    else
+    {
+        tsig_hmac_free(hmac);
+    }
+}
+
+/**
+ * Replaces the keyed template of the tsig item, under its lock, and drops the reference to the previous one.
+ * Other threads may still be cloning the previous template, the last of them frees it.
+ */
+
+static void
+tsig_item_template_set(tsig_item *tsig, tsig_hmac_template_s *hmac_template)
+{
+    mutex_lock(&tsig->hmac_template_mtx);
+    tsig_hmac_template_s *old_template = tsig->hmac_template;
+    tsig->hmac_template = hmac_template;
+    mutex_unlock(&tsig->hmac_template_mtx);
+
+    if(old_template != NULL)
+    {
+        tsig_hmac_template_release(old_template);
+    }
+}
+
+static void
+tsig_item_template_clear(tsig_item *tsig)
+{
+    tsig_item_template_set(tsig, NULL);
+}
+
+/**
+ * (Re)builds the keyed template of the tsig item from its current key.
+ * The new template is keyed aside then published.
+ */
+
+static void
+tsig_item_template_update(tsig_item *tsig)
+{
+    tsig_hmac_template_s *hmac_template = NULL;
+
+#if !SSL_API_LT_100
+    if((tsig->mac != NULL) && (tsig->evp_md != NULL))
+    {
+        MALLOC_OR_DIE(tsig_hmac_template_s*, hmac_template, sizeof(tsig_hmac_template_s), TSIGTMPL_TAG);
+        hmac_template->hmac = tsig_hmac_allocate();
+        hmac_template->rc = 1;
+        tsig_hmac_init(hmac_template->hmac, tsig->mac, tsig->mac_size, tsig->evp_md);
+    }
+#endif
+
+    tsig_item_template_set(tsig, hmac_template);
+}
+
 /*
  *
  */
@@ -388,6 +620,8 @@ tsig_register(const u8 *name, const u8 *mac, u16 mac_size, u8 mac_algorithm)
         node->item.mac_algorithm = mac_algorithm;
         node->item.load_serial = tsig_serial;
 
+        tsig_item_template_update(&node->item);
+
         tsig_tree_count++;
     }
     else
@@ -482,9 +716,7 @@ tsig_verify_query(message_data *mesg)
     log_debug("tsig_verify: stop");
 #endif
 
-    tsig_hmac_t hmac = tsig_hmac_allocate();
-
-    tsig_hmac_init(hmac, mesg->tsig.tsig->mac, mesg->tsig.tsig->mac_size, mesg->tsig.tsig->evp_md);
+    tsig_hmac_t hmac = tsig_hmac_acquire(mesg->tsig.tsig);
 
     /* DNS message */
 
@@ -508,7 +740,7 @@ tsig_verify_query(message_data *mesg)
 
     tsig_hmac_final(hmac, md, &md_len);
 
-    tsig_hmac_free(hmac);
+    tsig_hmac_release(hmac);
 
     if((md_len != mesg->tsig.mac_size) || (memcmp(mesg->tsig.mac, md, md_len) != 0))
     {
@@ -546,9 +778,7 @@ tsig_verify_answer(message_data *mesg, const u8 *mac, u16 mac_size)
     log_debug("tsig_verify_answer: stop");
 #endif
 
-    tsig_hmac_t hmac = tsig_hmac_allocate();
-
-    tsig_hmac_init(hmac, mesg->tsig.tsig->mac, mesg->tsig.tsig->mac_size, mesg->tsig.tsig->evp_md);
+    tsig_hmac_t hmac = tsig_hmac_acquire(mesg->tsig.tsig);
     
     tsig_hmac_update(hmac, (u8*) &mac_size_network, 2);
     tsig_hmac_update(hmac, mac, mac_size);
@@ -575,7 +805,7 @@ tsig_verify_answer(message_data *mesg, const u8 *mac, u16 mac_size)
 
     tsig_hmac_final(hmac, md, &md_len);
 
-    tsig_hmac_free(hmac);
+    tsig_hmac_release(hmac);
 
     //if(md_len != ntohs(mesg->tsig.mac_size))
     if(md_len != mac_size)
@@ -597,9 +827,7 @@ tsig_verify_answer(message_data *mesg, const u8 *mac, u16 mac_size)
 static ya_result
 tsig_digest_query(message_data *mesg)
 {
-    tsig_hmac_t hmac = tsig_hmac_allocate();
-
-    tsig_hmac_init(hmac, mesg->tsig.tsig->mac, mesg->tsig.tsig->mac_size, mesg->tsig.tsig->evp_md);
+    tsig_hmac_t hmac = tsig_hmac_acquire(mesg->tsig.tsig);
 
     /* Request MAC */
 
@@ -643,7 +871,7 @@ tsig_digest_query(message_data *mesg)
     tsig_hmac_final(hmac, mesg->tsig.mac, &tmp_mac_size);
     mesg->tsig.mac_size = tmp_mac_size;
 
-    tsig_hmac_free(hmac);
+    tsig_hmac_release(hmac);
 
     return SUCCESS;
 }
@@ -651,9 +879,7 @@ tsig_digest_query(message_data *mesg)
 static ya_result
 tsig_digest_answer(message_data *mesg)
 {
-    tsig_hmac_t hmac = tsig_hmac_allocate();
-
-    tsig_hmac_init(hmac, mesg->tsig.tsig->mac, mesg->tsig.tsig->mac_size, mesg->tsig.tsig->evp_md);
+    tsig_hmac_t hmac = tsig_hmac_acquire(mesg->tsig.tsig);
 
     /* Request MAC */
 
@@ -707,7 +933,7 @@ tsig_digest_answer(message_data *mesg)
     tsig_hmac_final(hmac, mesg->tsig.mac, &tmp_mac_size);
     mesg->tsig.mac_size = tmp_mac_size;
 
-    tsig_hmac_free(hmac);
+    tsig_hmac_release(hmac);
 
     return SUCCESS;
 }
@@ -1273,8 +1499,7 @@ tsig_sign_tcp_first_message(struct message_data *mesg)
      * Digest the digest (mesg->tsig.mac, mesg->tsig.mac_size (NETWORK ORDERED!))
      */
 
-    mesg->tsig.hmac = tsig_hmac_allocate();
-    tsig_hmac_init(mesg->tsig.hmac, mesg->tsig.tsig->mac, mesg->tsig.tsig->mac_size, mesg->tsig.tsig->evp_md);
+    mesg->tsig.hmac = tsig_hmac_acquire(mesg->tsig.tsig);
 
     u16 mac_size_network = htons(mesg->tsig.mac_size);
 
@@ -1344,9 +1569,7 @@ tsig_sign_tcp_next_message(struct message_data *mesg)
          * Digest the digest
          */
 
-        tsig_hmac_reset(mesg->tsig.hmac);
-        
-        tsig_hmac_init(mesg->tsig.hmac, mesg->tsig.tsig->mac, mesg->tsig.tsig->mac_size, mesg->tsig.tsig->evp_md);
+        tsig_hmac_rekey(mesg->tsig.hmac, mesg->tsig.tsig);
 
         u16 mac_size_network = htons(mesg->tsig.mac_size);
 
@@ -1407,7 +1630,7 @@ tsig_sign_tcp_last_message(struct message_data *mesg)
 
     tsig_add_tsig(mesg);
 
-    tsig_hmac_free(mesg->tsig.hmac);
+    tsig_hmac_release(mesg->tsig.hmac);
 
     return SUCCESS;
 }
@@ -1416,6 +1639,20 @@ tsig_sign_tcp_last_message(struct message_data *mesg)
  * If the message has no TSIG to do, it is considered to be successful.
  */
 
+#if DEBUG_BENCH_TSIG
+static debug_bench_s debug_tsig_sign_tcp;
+static bool tsig_debug_bench_register_done = FALSE;
+
+static inline void tsig_debug_bench_register()
+{
+    if(!tsig_debug_bench_register_done)
+    {
+        tsig_debug_bench_register_done = TRUE;
+        debug_bench_register(&debug_tsig_sign_tcp, "tsig_sign_tcp");
+    }
+}
+#endif
+
 ya_result
 tsig_sign_tcp_message(struct message_data *mesg, tsig_tcp_message_position pos)
 {
@@ -1423,6 +1660,10 @@ tsig_sign_tcp_message(struct message_data *mesg, tsig_tcp_message_position pos)
 
     if(MESSAGE_HAS_TSIG(*mesg))
     {
+#if DEBUG_BENCH_TSIG
+        tsig_debug_bench_register();
+        u64 bench = debug_bench_start(&debug_tsig_sign_tcp);
+#endif
         switch(pos)
         {
             case TSIG_START:
@@ -1450,6 +1691,9 @@ tsig_sign_tcp_message(struct message_data *mesg, tsig_tcp_message_position pos)
                 break;
             }
         }
+#if DEBUG_BENCH_TSIG
+        debug_bench_stop(&debug_tsig_sign_tcp, bench);
+#endif
     }
 
     return return_code;
@@ -1477,8 +1721,7 @@ tsig_verify_tcp_first_message(struct message_data *mesg, const u8 *mac, u16 mac_
      * Digest the digest (mesg->tsig.mac, mesg->tsig.mac_size (NETWORK ORDERED!))
      */
 
-    mesg->tsig.hmac = tsig_hmac_allocate();
-    tsig_hmac_init(mesg->tsig.hmac, mesg->tsig.tsig->mac, mesg->tsig.tsig->mac_size, mesg->tsig.tsig->evp_md);
+    mesg->tsig.hmac = tsig_hmac_acquire(mesg->tsig.tsig);
 
     u16 mac_size_network = htons(mesg->tsig.mac_size);
 
@@ -1545,7 +1788,7 @@ tsig_verify_tcp_next_message(struct message_data *mesg)
 
         if(memcmp(mesg->tsig.mac, mac, tmp_mac_size) != 0)
         {
-            tsig_hmac_free(mesg->tsig.hmac);
+            tsig_hmac_release(mesg->tsig.hmac);
             return TSIG_BADSIG;
         }
 
@@ -1555,9 +1798,7 @@ tsig_verify_tcp_next_message(struct message_data *mesg)
          * Digest the digest
          */
 
-        tsig_hmac_reset(mesg->tsig.hmac);
-        
-        tsig_hmac_init(mesg->tsig.hmac, mesg->tsig.tsig->mac, mesg->tsig.tsig->mac_size, mesg->tsig.tsig->evp_md);
+        tsig_hmac_rekey(mesg->tsig.hmac, mesg->tsig.tsig);
 
         u16 mac_size_network = htons(mesg->tsig.mac_size);
 
@@ -1594,7 +1835,7 @@ tsig_verify_tcp_last_message(struct message_data *mesg)
     if(mesg->tsig.tsig != NULL)
     {
         //tsig_hmac_reset(mesg->tsig.hmac);
-        tsig_hmac_free(mesg->tsig.hmac);
+        tsig_hmac_release(mesg->tsig.hmac);
     }
 }
 
@@ -69,6 +69,7 @@
 #include "dnscore/format.h"
 #include "dnscore/zalloc.h"
 #include "dnscore/mutex.h"
+#include "dnscore/sys_numa.h"
 
 extern logger_handle* g_system_logger;
 #define MODULE_MSG_HANDLE g_system_logger
@@ -167,17 +168,35 @@ static u32 lcm(u32 a, u32 b)
 #define ADJUSTED_ALLOC_PG_SIZE_COUNT (ZALLOC_PG_SIZE_COUNT + 1)
 #endif
 
+/**
+ * On a NUMA system, each node has its own lines, mapped on its memory, and the memory of a node is given back to it
+ * whoever frees it.  The allocations are taken from the lines of the node of the CPU of the caller.
+ * 
+ * The node of a slot is found from its address: the blocs are aligned on ZALLOC_MMAP_BLOC_SIZE and registered in a
+ * table by bloc number.
+ * 
+ * With one node, nothing of this is used.
+ */
+
+#define ZALLOC_NODE_COUNT_MAX SYS_NUMA_NODE_COUNT_MAX
+#define ZALLOC_NODE_MAP_SIZE  0x10000           // blocs, so it covers 1TB of memory with the default bloc size
+#define ZALLOC_NODE_MAP_MASK  (ZALLOC_NODE_MAP_SIZE - 1)
+
 static u32 page_size[ADJUSTED_ALLOC_PG_SIZE_COUNT];
-static void* line_sll[ADJUSTED_ALLOC_PG_SIZE_COUNT];
-static s32 line_count[ADJUSTED_ALLOC_PG_SIZE_COUNT];
-static s32 heap_total[ADJUSTED_ALLOC_PG_SIZE_COUNT];
+static void* line_sll[ZALLOC_NODE_COUNT_MAX][ADJUSTED_ALLOC_PG_SIZE_COUNT];
+static s32 line_count[ZALLOC_NODE_COUNT_MAX][ADJUSTED_ALLOC_PG_SIZE_COUNT];
+static s32 heap_total[ZALLOC_NODE_COUNT_MAX][ADJUSTED_ALLOC_PG_SIZE_COUNT];
 #if ZALLOC_LAZY
-static u8* lazy_next[ADJUSTED_ALLOC_PG_SIZE_COUNT];
-static u32 lazy_count[ADJUSTED_ALLOC_PG_SIZE_COUNT];
+static u8* lazy_next[ZALLOC_NODE_COUNT_MAX][ADJUSTED_ALLOC_PG_SIZE_COUNT];
+static u32 lazy_count[ZALLOC_NODE_COUNT_MAX][ADJUSTED_ALLOC_PG_SIZE_COUNT];
 static u32 smallest_size[ADJUSTED_ALLOC_PG_SIZE_COUNT];
 #endif
 
-static pthread_mutex_t line_mutex[ADJUSTED_ALLOC_PG_SIZE_COUNT];
+static pthread_mutex_t line_mutex[ZALLOC_NODE_COUNT_MAX][ADJUSTED_ALLOC_PG_SIZE_COUNT];
+
+static int zalloc_node_count = 1;
+static u64 *zalloc_node_map = NULL;     // (bloc number << 8) | (node + 1), 0 for an empty entry
+static pthread_mutex_t zalloc_node_map_mtx = PTHREAD_MUTEX_INITIALIZER;
 
 #if ZALLOC_STATISTICS
 static volatile u64 zalloc_memory_allocated = 0;
@@ -188,6 +207,124 @@ static mutex_t zalloc_statistics_mtx = MUTEX_INITIALIZER;
 static int system_page_size = 0;
 static volatile bool zalloc_init_done = FALSE;
 
+static inline u32
+zalloc_node_map_hash(u64 bloc)
+{
+    return (u32)((bloc * 0x9e3779b97f4a7c15ULL) >> 48) & ZALLOC_NODE_MAP_MASK;
+}
+
+static void
+zalloc_node_map_set(u8 *map_pointer, u32 size, int node)
+{
+    u64 first = (u64)(intptr)map_pointer / ZALLOC_MMAP_BLOC_SIZE;
+    u64 last = ((u64)(intptr)map_pointer + size - 1) / ZALLOC_MMAP_BLOC_SIZE;
+    
+    pthread_mutex_lock(&zalloc_node_map_mtx);
+    
+    for(u64 bloc = first; bloc <= last; ++bloc)
+    {
+        u32 h = zalloc_node_map_hash(bloc);
+        u32 probes = ZALLOC_NODE_MAP_SIZE;
+        
+        while(zalloc_node_map[h] != 0)
+        {
+            if(--probes == 0)
+            {
+                osformatln(termerr, "zalloc: the node map is full");
+                DIE(ZALLOC_ERROR_OUTOFMEMORY);
+            }
+            
+            h = (h + 1) & ZALLOC_NODE_MAP_MASK;
+        }
+        
+        zalloc_node_map[h] = (bloc << 8) | (node + 1);
+    }
+    
+    pthread_mutex_unlock(&zalloc_node_map_mtx);
+}
+
+/**
+ * Returns the node owning the slot.
+ * The entry has been written before the slot could have been allocated, so no lock is needed.
+ */
+
+static inline int
+zalloc_node_of(const void *ptr)
+{
+    if(zalloc_node_count == 1)
+    {
+        return 0;
+    }
+    
+    u64 bloc = (u64)(intptr)ptr / ZALLOC_MMAP_BLOC_SIZE;
+    u32 h = zalloc_node_map_hash(bloc);
+    
+    for(u32 probes = ZALLOC_NODE_MAP_SIZE; probes > 0; --probes)
+    {
+        u64 entry = zalloc_node_map[h];
+        
+        if((entry >> 8) == bloc)
+        {
+            return (int)(entry & 0xff) - 1;
+        }
+        
+        if(entry == 0)
+        {
+            break;
+        }
+        
+        h = (h + 1) & ZALLOC_NODE_MAP_MASK;
+    }
+    
+    return 0;
+}
+
+static inline int
+zalloc_node_current()
+{
+    if(zalloc_node_count == 1)
+    {
+        return 0;
+    }
+    
+    return sys_numa_current_node();
+}
+
+/**
+ * Maps a bloc of a node, aligned on ZALLOC_MMAP_BLOC_SIZE so that it does not share a bloc number with another one.
+ */
+
+static page
+zalloc_node_mmap(u32 size, int node)
+{
+    u32 aligned_size = size + ZALLOC_MMAP_BLOC_SIZE;
+    u8 *map_pointer = (u8*)sys_numa_alloc(aligned_size, node);
+    
+    if(map_pointer == NULL)
+    {
+        return MAP_FAILED;
+    }
+    
+    u8 *aligned = (u8*)((((intptr)map_pointer + ZALLOC_MMAP_BLOC_SIZE - 1) / ZALLOC_MMAP_BLOC_SIZE) * ZALLOC_MMAP_BLOC_SIZE);
+    
+    if(aligned > map_pointer)
+    {
+        munmap(map_pointer, aligned - map_pointer);
+    }
+    
+    u8 *aligned_end = aligned + size;
+    u8 *map_end = map_pointer + aligned_size;
+    
+    if(map_end > aligned_end)
+    {
+        munmap(aligned_end, map_end - aligned_end);
+    }
+    
+    zalloc_node_map_set(aligned, size, node);
+    
+    return aligned;
+}
+
 #if HAS_ZALLOC_DEBUG_SUPPORT
 
 struct zalloc_range_s
@@ -231,6 +368,18 @@ zalloc_init()
     
     system_page_size = getpagesize();
     
+    zalloc_node_count = sys_numa_node_count();
+    
+    if(zalloc_node_count > 1)
+    {
+        zalloc_node_map = (u64*)sys_numa_alloc(sizeof(u64) * ZALLOC_NODE_MAP_SIZE, -1);
+        
+        if(zalloc_node_map == NULL)
+        {
+            zalloc_node_count = 1;
+        }
+    }
+    
     if(system_page_size > ZALLOC_MMAP_BLOC_SIZE)
     {
         fprintf(stderr, "System page size bigger than the internal allocation size (%d > %d)\n", system_page_size, ZALLOC_MMAP_BLOC_SIZE);
@@ -247,16 +396,20 @@ zalloc_init()
         u32 chosen_size = ((ZALLOC_MMAP_BLOC_SIZE + lcm_page_chunk - 1) / lcm_page_chunk) * lcm_page_chunk;
         
         page_size[i] = chosen_size;
-        line_sll[i] = NULL;
-        line_count[i] = 0;
-        heap_total[i] = 0;
-        
 #if ZALLOC_LAZY
-        lazy_next[i] = NULL;
-        lazy_count[i] = 0;
         smallest_size[i] = lcm_page_chunk;
 #endif
-        pthread_mutex_init(&line_mutex[i], NULL);
+        for(int node = 0; node < zalloc_node_count; ++node)
+        {
+            line_sll[node][i] = NULL;
+            line_count[node][i] = 0;
+            heap_total[node][i] = 0;
+#if ZALLOC_LAZY
+            lazy_next[node][i] = NULL;
+            lazy_count[node][i] = 0;
+#endif
+            pthread_mutex_init(&line_mutex[node][i], NULL);
+        }
     }
     
     return SUCCESS;
@@ -279,19 +432,26 @@ zalloc_finalise()
  */
 
 static void
-zalloc_lines(u32 page_index)
+zalloc_lines(int node, u32 page_index)
 {
     page map_pointer;
     
     u32 chunk_size = (page_index + 1) << 3; // size of one bloc
     
 #if ZALLOC_LAZY
-    if(lazy_next[page_index] == NULL)
+    if(lazy_next[node][page_index] == NULL)
     {
 #endif
         u32 size = page_size[page_index];
 
-        map_pointer = (page)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+        if(zalloc_node_count == 1)
+        {
+            map_pointer = (page)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+        }
+        else
+        {
+            map_pointer = zalloc_node_mmap(size, node);
+        }
         
 #if HAS_ZALLOC_DEBUG_SUPPORT
         zalloc_range_s *range = malloc(sizeof(zalloc_range_s));
@@ -340,23 +500,23 @@ zalloc_lines(u32 page_index)
 #if ZALLOC_LAZY
         // give the page to the (supposedly empty) lazy handling
     
-        lazy_count[page_index] = size / smallest_size[page_index];
-        lazy_next[page_index] = map_pointer;
+        lazy_count[node][page_index] = size / smallest_size[page_index];
+        lazy_next[node][page_index] = map_pointer;
     }
     else
     {
-        map_pointer = lazy_next[page_index];
+        map_pointer = lazy_next[node][page_index];
     }
     
     // lazy_next[i] is set, only prepare it
     
-    if(--lazy_count[page_index] > 0)
+    if(--lazy_count[node][page_index] > 0)
     {
-        lazy_next[page_index] += smallest_size[page_index];
+        lazy_next[node][page_index] += smallest_size[page_index];
     }
     else
     {
-        lazy_next[page_index] = NULL;
+        lazy_next[node][page_index] = NULL;
     }
     
     u32 count = (smallest_size[page_index] / chunk_size);
@@ -368,8 +528,8 @@ zalloc_lines(u32 page_index)
     u32 count = (size / chunk_size);
 #endif
     
-    line_count[page_index] += count;
-    heap_total[page_index] += count;
+    line_count[node][page_index] += count;
+    heap_total[node][page_index] += count;
 
     /* Builds the block chain for the new page set */
 
@@ -385,7 +545,7 @@ zalloc_lines(u32 page_index)
 
     *header = (void*)(~0); // the last header points to an impossible address    
 
-    line_sll[page_index] = map_pointer;
+    line_sll[node][page_index] = map_pointer;
 }
 
 /**
@@ -409,19 +569,21 @@ zalloc_line(u32 page_index)
     page_index++;               // debug requires 8 more bytes
 #endif
     
-    pthread_mutex_lock(&line_mutex[page_index]);
+    int node = zalloc_node_current();
+    
+    pthread_mutex_lock(&line_mutex[node][page_index]);
 
-    if(line_count[page_index] == 0)
+    if(line_count[node][page_index] == 0)
     {
-        zalloc_lines(page_index);
+        zalloc_lines(node, page_index);
     }
 
-    line_count[page_index]--;
+    line_count[node][page_index]--;
 
-    yassert(line_count[page_index] >= 0);
+    yassert(line_count[node][page_index] >= 0);
     
-    void **ret = line_sll[page_index];
-    line_sll[page_index] = *ret;
+    void **ret = line_sll[node][page_index];
+    line_sll[node][page_index] = *ret;
 
     *ret = NULL; /* erases ZALLOC pointer */
 
@@ -442,7 +604,7 @@ zalloc_line(u32 page_index)
     pthread_mutex_unlock(&zalloc_statistics_mtx);
 #endif
     
-    pthread_mutex_unlock(&line_mutex[page_index]);
+    pthread_mutex_unlock(&line_mutex[node][page_index]);
 
     return ret;
 }
@@ -460,14 +622,14 @@ zalloc_line(u32 page_index)
  */
 
 static void
-zfree_line_report(int page_index)
+zfree_line_report(int node, int page_index)
 {
-    log_err("zfree_line: page #%d count (%d) > total (%d)", page_index, line_count[page_index], heap_total[page_index]);
+    log_err("zfree_line: node %d page #%d count (%d) > total (%d)", node, page_index, line_count[node][page_index], heap_total[node][page_index]);
     logger_flush();
-    s32 count = line_count[page_index];
+    s32 count = line_count[node][page_index];
     if(count > 0)
     {
-        void** ret = line_sll[page_index];
+        void** ret = line_sll[node][page_index];
         
         for(s32 i = 0; i < count; i++)
         {
@@ -505,7 +667,9 @@ zfree_line(void* ptr, u32 page_index)
         page_index++;
 #endif
         
-        pthread_mutex_lock(&line_mutex[page_index]);
+        int node = zalloc_node_of(ptr);
+        
+        pthread_mutex_lock(&line_mutex[node][page_index]);
         
 #if ZALLOC_DEBUG
         u64* hdr = (u64*)ptr;
@@ -570,17 +734,17 @@ zfree_line(void* ptr, u32 page_index)
 #endif
 
         void** ret = (void**)ptr;
-        *ret = line_sll[page_index];
-        line_sll[page_index] = ret;
+        *ret = line_sll[node][page_index];
+        line_sll[node][page_index] = ret;
 
-        line_count[page_index]++;
+        line_count[node][page_index]++;
 
-        if(line_count[page_index] > heap_total[page_index])
+        if(line_count[node][page_index] > heap_total[node][page_index])
         {
-            zfree_line_report(page_index);
+            zfree_line_report(node, page_index);
         }
         
-        pthread_mutex_unlock(&line_mutex[page_index]);
+        pthread_mutex_unlock(&line_mutex[node][page_index]);
     }
 }
 
@@ -593,11 +757,16 @@ zheap_line_total(u32 page_index)
 {
     if(page_index < ADJUSTED_ALLOC_PG_SIZE_COUNT)
     {
-        pthread_mutex_lock(&line_mutex[page_index]);
-
-        u64 return_value = heap_total[page_index];
+        u64 return_value = 0;
         
-        pthread_mutex_unlock(&line_mutex[page_index]);
+        for(int node = 0; node < zalloc_node_count; ++node)
+        {
+            pthread_mutex_lock(&line_mutex[node][page_index]);
+
+            return_value += heap_total[node][page_index];
+
+            pthread_mutex_unlock(&line_mutex[node][page_index]);
+        }
         
         return return_value;
         
@@ -611,11 +780,16 @@ zheap_line_avail(u32 page_index)
 {
     if(page_index < ADJUSTED_ALLOC_PG_SIZE_COUNT)
     {
-        pthread_mutex_lock(&line_mutex[page_index]);
-        
-        u64 return_value = line_count[page_index];
+        u64 return_value = 0;
         
-        pthread_mutex_unlock(&line_mutex[page_index]);
+        for(int node = 0; node < zalloc_node_count; ++node)
+        {
+            pthread_mutex_lock(&line_mutex[node][page_index]);
+
+            return_value += line_count[node][page_index];
+
+            pthread_mutex_unlock(&line_mutex[node][page_index]);
+        }
         
         return return_value;
 
@@ -728,7 +902,16 @@ zalloc_print_stats(output_stream *os)
         
         for(int i = 0; i < ADJUSTED_ALLOC_PG_SIZE_COUNT; i++)
         {
-            osformatln(os, "[%6i] %-8u %-8u %-8u %-8u %-9u", (i + 1) << 3, page_size[i], line_count[i], heap_total[i], heap_total[i] - line_count[i], (heap_total[i] - line_count[i]) * (i + 1) << 3);
+            s32 remain = 0;
+            s32 total = 0;
+            
+            for(int node = 0; node < zalloc_node_count; ++node)
+            {
+                remain += line_count[node][i];
+                total += heap_total[node][i];
+            }
+            
+            osformatln(os, "[%6i] %-8u %-8u %-8u %-8u %-9u", (i + 1) << 3, page_size[i], remain, total, total - remain, (total - remain) * (i + 1) << 3);
         }
     }
 #else
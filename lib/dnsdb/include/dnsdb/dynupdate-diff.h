@@ -48,6 +48,7 @@
 #include <dnscore/packet_writer.h>
 
 #include <dnsdb/zdb_types.h>
+#include <dnsdb/zdb_zone_load_interface.h>
 
 #define DNSSEC_CHAIN_SUPPORTED_MAX 16
 
@@ -547,6 +548,26 @@ ya_result dynupdate_diff_write_to_journal_and_replay(zdb_zone *zone, u8 secondar
  */
 
 ya_result dynupdate_diff(zdb_zone *zone, packet_unpack_reader_data *reader, u16 count, u8 secondary_lock, bool dryrun);
+
+/**
+ * Applies the content of a zone reader to a zone, as an incremental update.
+ * 
+ * The records are read without locking the zone, then the zone is locked and
+ * the difference with its records is stored in the journal and replayed like a
+ * dynamic update.
+ * 
+ * The SOA of the reader must have a serial higher than the one of the zone.
+ * Changes that cannot be expressed as a diff (TTL, DNSSEC chains) are refused
+ * with FEATURE_NOT_SUPPORTED and the zone is left untouched.
+ * 
+ * @param zone the zone, acquired but not locked
+ * @param zr the zone reader, positioned on the SOA
+ * @param secondary_lock the secondary owner of the lock of the zone
+ * 
+ * @return the number of records changed or an error code
+ */
+
+ya_result dynupdate_diff_from_zone_reader(zdb_zone *zone, zone_reader *zr, u8 secondary_lock);
 /*
 ya_result dynupdate_diff_chain(zdb_zone *zone, u8 secondary_lock)
 {
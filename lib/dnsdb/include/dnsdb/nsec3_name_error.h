@@ -43,6 +43,7 @@
 
 #pragma once
 
+#include <dnscore/histogram.h>
 #include <dnsdb/zdb_types.h>
 
 #ifdef	__cplusplus
@@ -50,6 +51,21 @@ extern "C"
 {
 #endif
 
+/**
+ * Sets the histogram the current thread records the duration (ns) of the NSEC3 proofs it builds into.
+ * NULL (the default) disables the measure.
+ *
+ * @param h the histogram, owned by the caller
+ */
+
+void nsec3_proof_histogram_set(histogram_s *h);
+
+/**
+ * Returns the histogram set for the current thread, or NULL
+ */
+
+histogram_s *nsec3_proof_histogram_get();
+
 /**
  * @note Name Error Responses
  * 
@@ -213,7 +213,7 @@ static inline bool zdb_rr_label_nsec3any_linked(const zdb_rr_label *label)
 static inline nsec3_label_extension *nsec3_label_extension_alloc()
 {
     nsec3_label_extension *n3le;
-    ZALLOC_OR_DIE(nsec3_label_extension*, n3le, nsec3_label_extension, NSEC3_LABELEXT_TAG); // in nsec3_label_link
+    ZDB_ZONE_ALLOC_OR_DIE(nsec3_label_extension*, n3le, nsec3_label_extension, NSEC3_LABELEXT_TAG); // in nsec3_label_link
 #ifdef DEBUG
     memset(n3le, 0xac, sizeof(nsec3_label_extension));
 #endif
@@ -225,7 +225,7 @@ static inline void nsec3_label_extension_free(nsec3_label_extension *n3le)
 #ifdef DEBUG
     memset(n3le, 0xfe, sizeof(nsec3_label_extension));
 #endif
-    ZFREE(n3le, nsec3_label_extension);
+    ZDB_ZONE_FREE(n3le, nsec3_label_extension);
 }
 
 static inline u8 nsec3param_get_flags(void *rdata_)
@@ -0,0 +1,272 @@
+/*------------------------------------------------------------------------------
+*
+* Copyright (c) 2011-2019, EURid vzw. All rights reserved.
+* The YADIFA TM software product is provided under the BSD 3-clause license:
+* 
+* Redistribution and use in source and binary forms, with or without 
+* modification, are permitted provided that the following conditions
+* are met:
+*
+*        * Redistributions of source code must retain the above copyright 
+*          notice, this list of conditions and the following disclaimer.
+*        * Redistributions in binary form must reproduce the above copyright 
+*          notice, this list of conditions and the following disclaimer in the 
+*          documentation and/or other materials provided with the distribution.
+*        * Neither the name of EURid nor the names of its contributors may be 
+*          used to endorse or promote products derived from this software 
+*          without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*------------------------------------------------------------------------------
+*
+*/
+/** @defgroup records Internal functions for the database: resource records.
+ *  @ingroup dnsdb
+ *  @brief The collection of the RRsets of a label
+ *
+ *  A label keeps its RRsets in a collection keyed by type.
+ *
+ *  With ZDB_RR_COLLECTION_BLOCK, the collection is one contiguous block holding
+ *  the (type, RRset) pairs sorted by type.  The capacity of a block is a power
+ *  of two.  A block is never grown in place: a larger one is allocated, filled
+ *  and replaces the old one, which is then freed.
+ *
+ *  Without it, the collection is the btree (AVL) it has always been.
+ *
+ *  Any insert or delete invalidates the slots and nodes previously returned.
+ *
+ * @{
+ */
+
+#pragma once
+
+#include <dnsdb/zdb_config.h>
+#include <dnsdb/hash.h>
+#include <dnsdb/btree.h>
+
+#ifdef	__cplusplus
+extern "C"
+{
+#endif
+
+#define ZDB_RR_BLOCK_TAG 0x4b434c4252524244 /* "DBRRBLCK" */
+
+struct zdb_rr_block_node
+{
+    void *data;
+    hashcode hash;
+};
+
+typedef struct zdb_rr_block_node zdb_rr_block_node;
+
+struct zdb_rr_block
+{
+    u16 count;
+    u16 capacity;
+    zdb_rr_block_node node[];
+};
+
+typedef struct zdb_rr_block zdb_rr_block;
+
+struct zdb_rr_block_iterator
+{
+    zdb_rr_block *block;
+    s32 index;
+};
+
+typedef struct zdb_rr_block_iterator zdb_rr_block_iterator;
+
+#define ZDB_RR_BLOCK_SIZE(capacity_) (sizeof(zdb_rr_block) + (capacity_) * sizeof(zdb_rr_block_node))
+
+/*
+ * Kept small, a binary search is only worth it past a few types.
+ */
+
+#define ZDB_RR_BLOCK_LINEAR_SEARCH_MAX 8
+
+static inline s32
+zdb_rr_block_index(const zdb_rr_block *block, hashcode hash)
+{
+    s32 lo = 0;
+    s32 hi = block->count;
+    
+    while(hi - lo > ZDB_RR_BLOCK_LINEAR_SEARCH_MAX)
+    {
+        s32 mid = (lo + hi) >> 1;
+        
+        if(block->node[mid].hash <= hash)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    
+    for(; lo < hi; ++lo)
+    {
+        hashcode node_hash = block->node[lo].hash;
+        
+        if(node_hash >= hash)
+        {
+            return (node_hash == hash)?lo:-1;
+        }
+    }
+    
+    return -1;
+}
+
+static inline void
+zdb_rr_block_init(zdb_rr_block **blockp)
+{
+    *blockp = NULL;
+}
+
+static inline void*
+zdb_rr_block_find(zdb_rr_block * const *blockp, hashcode hash)
+{
+    const zdb_rr_block *block = *blockp;
+    
+    if(block != NULL)
+    {
+        s32 index = zdb_rr_block_index(block, hash);
+        
+        if(index >= 0)
+        {
+            return block->node[index].data;
+        }
+    }
+    
+    return NULL;
+}
+
+static inline void**
+zdb_rr_block_findp(zdb_rr_block * const *blockp, hashcode hash)
+{
+    zdb_rr_block *block = *blockp;
+    
+    if(block != NULL)
+    {
+        s32 index = zdb_rr_block_index(block, hash);
+        
+        if(index >= 0)
+        {
+            return &block->node[index].data;
+        }
+    }
+    
+    return NULL;
+}
+
+/**
+ * Returns the slot of the hash, creating it (with a NULL value) if needed.
+ */
+
+void **zdb_rr_block_insert(zdb_rr_block **blockp, hashcode hash);
+
+/**
+ * Removes the hash from the collection and returns the value it had.
+ */
+
+void *zdb_rr_block_delete(zdb_rr_block **blockp, hashcode hash);
+
+void zdb_rr_block_destroy(zdb_rr_block **blockp);
+
+/**
+ * Calls the callback on each value then destroys the collection.
+ * As for the btree, the collection itself is not set to NULL.
+ */
+
+void zdb_rr_block_callback_and_destroy(zdb_rr_block *block, void (*callback)(void*));
+
+/**
+ * Returns the number of bytes allocated for the collection.
+ */
+
+static inline size_t
+zdb_rr_block_memory(const zdb_rr_block *block)
+{
+    return (block != NULL)?ZDB_RR_BLOCK_SIZE(block->capacity):0;
+}
+
+static inline void
+zdb_rr_block_iterator_init(zdb_rr_block *block, zdb_rr_block_iterator *iter)
+{
+    iter->block = block;
+    iter->index = 0;
+}
+
+static inline bool
+zdb_rr_block_iterator_hasnext(zdb_rr_block_iterator *iter)
+{
+    return (iter->block != NULL) && (iter->index < iter->block->count);
+}
+
+static inline zdb_rr_block_node*
+zdb_rr_block_iterator_next_node(zdb_rr_block_iterator *iter)
+{
+    return &iter->block->node[iter->index++];
+}
+
+#if ZDB_RR_COLLECTION_BLOCK
+
+typedef zdb_rr_block *zdb_rr_collection;
+typedef zdb_rr_block_node zdb_rr_collection_node;
+typedef zdb_rr_block_iterator zdb_rr_collection_iterator;
+
+#define zdb_rr_collection_init zdb_rr_block_init
+#define zdb_rr_collection_find zdb_rr_block_find
+#define zdb_rr_collection_findp zdb_rr_block_findp
+#define zdb_rr_collection_insert zdb_rr_block_insert
+#define zdb_rr_collection_delete zdb_rr_block_delete
+#define zdb_rr_collection_destroy zdb_rr_block_destroy
+#define zdb_rr_collection_callback_and_destroy zdb_rr_block_callback_and_destroy
+
+#define zdb_rr_collection_iterator_init zdb_rr_block_iterator_init
+#define zdb_rr_collection_iterator_hasnext zdb_rr_block_iterator_hasnext
+#define zdb_rr_collection_iterator_next_node zdb_rr_block_iterator_next_node
+
+#define zdb_rr_collection_memory zdb_rr_block_memory
+
+#else
+
+typedef btree zdb_rr_collection;
+typedef btree_node zdb_rr_collection_node;
+typedef btree_iterator zdb_rr_collection_iterator;
+
+#define zdb_rr_collection_init btree_init
+#define zdb_rr_collection_find btree_find
+#define zdb_rr_collection_findp btree_findp
+#define zdb_rr_collection_insert btree_insert
+#define zdb_rr_collection_delete btree_delete
+#define zdb_rr_collection_destroy btree_destroy
+#define zdb_rr_collection_callback_and_destroy btree_callback_and_destroy
+
+#define zdb_rr_collection_iterator_init btree_iterator_init
+#define zdb_rr_collection_iterator_hasnext btree_iterator_hasnext
+#define zdb_rr_collection_iterator_next_node btree_iterator_next_node
+
+size_t zdb_rr_collection_memory(const zdb_rr_collection collection);
+
+#endif
+
+#define zdb_rr_collection_notempty(collection_) ((collection_)!=NULL)
+#define zdb_rr_collection_isempty(collection_) ((collection_)==NULL)
+
+#ifdef	__cplusplus
+}
+#endif
+
+/** @} */
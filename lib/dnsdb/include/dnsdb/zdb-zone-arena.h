@@ -0,0 +1,338 @@
+/*------------------------------------------------------------------------------
+*
+* Copyright (c) 2011-2019, EURid vzw. All rights reserved.
+* The YADIFA TM software product is provided under the BSD 3-clause license:
+* 
+* Redistribution and use in source and binary forms, with or without 
+* modification, are permitted provided that the following conditions
+* are met:
+*
+*        * Redistributions of source code must retain the above copyright 
+*          notice, this list of conditions and the following disclaimer.
+*        * Redistributions in binary form must reproduce the above copyright 
+*          notice, this list of conditions and the following disclaimer in the 
+*          documentation and/or other materials provided with the distribution.
+*        * Neither the name of EURid nor the names of its contributors may be 
+*          used to endorse or promote products derived from this software 
+*          without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*------------------------------------------------------------------------------
+*
+*/
+/** @defgroup dnsdbzone Zone related functions
+ *  @ingroup dnsdb
+ *  @brief The memory arena of a zone
+ *
+ *  The labels, records, RRset collections and btree nodes of a zone built by
+ *  the loader are taken from an arena owned by the zone: large mmap'd chunks
+ *  filled linearly.  They are never freed one by one.  When the zone is
+ *  destroyed, the chunks are unmapped at once and, unless the zone has been
+ *  modified since it was loaded, the labels are not even visited.
+ *
+ *  The arena is only used by the thread it is bound to, the loader.  Any other
+ *  allocation (updates, maintenance, ...) uses the regular allocator and is
+ *  counted.  A sealed arena whose zone has been held by a writer while the
+ *  count moved is marked dirty: the zone may own regular memory.
+ *
+ *  Freeing an object of an arena does nothing.  The chunks are aligned on
+ *  their size so the ownership of a pointer is a look-up in a map of the
+ *  chunks of all the arenas.
+ *
+ * @{
+ */
+
+#pragma once
+
+#include <dnscore/sys_types.h>
+#include <dnscore/zalloc.h>
+#include <dnsdb/zdb_config.h>
+
+#ifdef	__cplusplus
+extern "C"
+{
+#endif
+
+#define ZDB_ZONE_ARENA_TAG 0x414e45524142445a /* "ZDBARENA" */
+
+#define ZDB_ZONE_ARENA_CHUNK_SHIFT      22  // 4MB
+#define ZDB_ZONE_ARENA_CHUNK_SIZE       (1ULL << ZDB_ZONE_ARENA_CHUNK_SHIFT)
+#define ZDB_ZONE_ARENA_ADDRESS_BITS     47  // the user space of a 64 bits architecture
+#define ZDB_ZONE_ARENA_CHUNK_MAP_SIZE   (1ULL << (ZDB_ZONE_ARENA_ADDRESS_BITS - ZDB_ZONE_ARENA_CHUNK_SHIFT - 6))
+
+struct zdb_zone;
+
+struct zdb_zone_arena_chunk
+{
+    struct zdb_zone_arena_chunk *next;
+};
+
+typedef struct zdb_zone_arena_chunk zdb_zone_arena_chunk;
+
+struct zdb_zone_arena
+{
+    u8 *top;                        // the next free byte of the current chunk
+    u8 *limit;                      // the end of the current chunk
+    zdb_zone_arena_chunk *chunks;   // the chunks, the current one first
+    u64 used;                       // the bytes given by the arena
+    u64 heap_mark;                  // the heap fallback count when a writer took the zone
+    u32 chunk_count;
+    bool sealed;                    // the loader is done with the arena
+    bool writing;                   // a writer holds the zone, heap_mark is set
+    bool dirty;                     // the zone may hold memory of the regular allocator
+};
+
+typedef struct zdb_zone_arena zdb_zone_arena;
+
+struct zdb_zone_arena_teardown_stats
+{
+    u64 count;                      // zones destroyed
+    u64 released;                   // zones destroyed by releasing their arena
+    u64 total_us;
+    u64 max_us;
+};
+
+typedef struct zdb_zone_arena_teardown_stats zdb_zone_arena_teardown_stats;
+
+#if ZDB_ZONE_ARENA_SUPPORT
+
+extern u64 zdb_zone_arena_chunk_map[ZDB_ZONE_ARENA_CHUNK_MAP_SIZE];
+extern volatile s32 zdb_zone_arena_bound_count;
+extern volatile u64 zdb_zone_arena_heap_count;
+
+/**
+ * Tells if the memory pointed by ptr belongs to an arena.
+ */
+
+static inline bool
+zdb_zone_arena_owns(const void *ptr)
+{
+    intptr chunk = ((intptr)ptr) >> ZDB_ZONE_ARENA_CHUNK_SHIFT;
+    
+    if(chunk >= (ZDB_ZONE_ARENA_CHUNK_MAP_SIZE << 6))
+    {
+        return FALSE;
+    }
+    
+    return (zdb_zone_arena_chunk_map[chunk >> 6] & (1ULL << (chunk & 63))) != 0;
+}
+
+void *zdb_zone_arena_alloc_bound(size_t size);
+
+/**
+ * Allocates from the arena bound to the current thread.
+ * A NULL return, the caller falling back to the heap, is counted.
+ * 
+ * @return the memory, or NULL if no arena is bound to the thread
+ */
+
+static inline void*
+zdb_zone_arena_alloc(size_t size)
+{
+    if(zdb_zone_arena_bound_count == 0)
+    {
+        __sync_fetch_and_add(&zdb_zone_arena_heap_count, 1);
+        return NULL;
+    }
+    
+    return zdb_zone_arena_alloc_bound(size);
+}
+
+#else
+
+#define zdb_zone_arena_owns(ptr_) FALSE
+#define zdb_zone_arena_alloc(size_) NULL
+
+#endif
+
+/**
+ * The allocation macros for the content of a zone.
+ * They try the arena bound to the thread before the regular allocator, and do
+ * not free the memory of an arena.
+ */
+
+#define ZDB_ZONE_ALLOC_ARRAY_OR_DIE(cast_,label_,size_,tag_)                \
+    if(((label_) = (cast_)zdb_zone_arena_alloc(size_)) == NULL)             \
+    {                                                                       \
+        ZALLOC_ARRAY_OR_DIE(cast_,label_,size_,tag_);                       \
+    }
+
+#define ZDB_ZONE_FREE_ARRAY(ptr_,size_)                                     \
+    if(!zdb_zone_arena_owns(ptr_))                                          \
+    {                                                                       \
+        ZFREE_ARRAY(ptr_,size_);                                            \
+    }
+
+#define ZDB_ZONE_ALLOC_OR_DIE(cast_,label_,object_,tag_)                    \
+    if(((label_) = (cast_)zdb_zone_arena_alloc(sizeof(object_))) == NULL)   \
+    {                                                                       \
+        ZALLOC_OR_DIE(cast_,label_,object_,tag_);                           \
+    }
+
+#define ZDB_ZONE_FREE(ptr_,object_)                                         \
+    if(!zdb_zone_arena_owns(ptr_))                                          \
+    {                                                                       \
+        ZFREE(ptr_,object_);                                                \
+    }
+
+#define ZDB_ZONE_MALLOC_OR_DIE(cast_,label_,size_,tag_)                     \
+    if(((label_) = (cast_)zdb_zone_arena_alloc(size_)) == NULL)             \
+    {                                                                       \
+        MALLOC_OR_DIE(cast_,label_,size_,tag_);                             \
+    }
+
+#define ZDB_ZONE_MFREE(ptr_)                                                \
+    if(!zdb_zone_arena_owns(ptr_))                                          \
+    {                                                                       \
+        free(ptr_);                                                         \
+    }
+
+/**
+ * ZALLOC_ARRAY_RESIZE counterpart that does not give arena memory back to zalloc.
+ */
+
+#define ZDB_ZONE_ALLOC_ARRAY_RESIZE(type_,array_,count_,newcount_)          \
+{                                                                           \
+    u32 zdb_zone_new_count = (u32)(newcount_);                              \
+    if(((u32)(count_)) != zdb_zone_new_count)                               \
+    {                                                                       \
+        type_* __tmp__;                                                     \
+                                                                            \
+        if(zdb_zone_new_count > 0)                                          \
+        {                                                                   \
+            ZDB_ZONE_ALLOC_ARRAY_OR_DIE(type_*,__tmp__,sizeof(type_)*zdb_zone_new_count, ZALLOC_ARRAY_RESIZE_TAG); \
+            MEMCOPY(__tmp__,(array_),sizeof(type_)*MIN((u32)(count_),zdb_zone_new_count)); \
+        }                                                                   \
+        else                                                                \
+        {                                                                   \
+            __tmp__ = NULL;                                                 \
+        }                                                                   \
+                                                                            \
+        ZDB_ZONE_FREE_ARRAY((array_),sizeof(type_)*((u32)(count_)));       \
+        array_ = __tmp__;                                                   \
+        count_ = newcount_;                                                 \
+    }                                                                       \
+    assert(array_ != NULL);                                                 \
+}
+
+#if ZDB_ZONE_ARENA_SUPPORT
+
+/**
+ * Creates an arena.
+ * 
+ * @return the arena
+ */
+
+zdb_zone_arena *zdb_zone_arena_new_instance();
+
+/**
+ * Unmaps all the chunks of an arena and destroys it.
+ * Everything allocated from the arena is gone.
+ */
+
+void zdb_zone_arena_delete(zdb_zone_arena *arena);
+
+/**
+ * Binds the arena to the current thread: the content of a zone allocated by the
+ * thread will be taken from it.  Structures that do not belong to the zone
+ * (e.g. the database) must not be modified while an arena is bound.
+ */
+
+void zdb_zone_arena_bind(zdb_zone_arena *arena);
+
+/**
+ * Unbinds the arena of the current thread, if any.
+ */
+
+void zdb_zone_arena_unbind();
+
+/**
+ * The loader is done with the arena of the zone: unbinds it.
+ * From now on, the writers of the zone are watched.
+ */
+
+void zdb_zone_arena_seal(struct zdb_zone *zone);
+
+/**
+ * A writer took the lock of the zone of a sealed arena.
+ * The zone mutex must be held.
+ */
+
+static inline void
+zdb_zone_arena_writer_enters(zdb_zone_arena *arena)
+{
+    if(arena->sealed && !arena->writing)
+    {
+        arena->heap_mark = zdb_zone_arena_heap_count;
+        arena->writing = TRUE;
+    }
+}
+
+/**
+ * The last owner released the lock of the zone of the arena.
+ * If anything fell back to the heap while a writer held the zone, the zone may
+ * hold some of it and the arena is marked dirty.
+ * The zone mutex must be held.
+ */
+
+static inline void
+zdb_zone_arena_writer_leaves(zdb_zone_arena *arena)
+{
+    if(arena->writing)
+    {
+        if(zdb_zone_arena_heap_count != arena->heap_mark)
+        {
+            arena->dirty = TRUE;
+        }
+        
+        arena->writing = FALSE;
+    }
+}
+
+/**
+ * Tells if everything in the zone still comes from its arena, so it can be
+ * destroyed by deleting the arena.
+ * 
+ * The zone is expected not to be held by a writer.
+ */
+
+bool zdb_zone_arena_pristine(const struct zdb_zone *zone);
+
+/**
+ * The memory of the arena that is actually resident.
+ */
+
+u64 zdb_zone_arena_resident(const zdb_zone_arena *arena);
+
+static inline u64
+zdb_zone_arena_mapped(const zdb_zone_arena *arena)
+{
+    return arena->chunk_count * ZDB_ZONE_ARENA_CHUNK_SIZE;
+}
+
+#endif
+
+/**
+ * Accounts the destruction of a zone.
+ */
+
+void zdb_zone_arena_teardown_stats_add(u64 elapsed_us, bool released);
+
+void zdb_zone_arena_teardown_stats_get(zdb_zone_arena_teardown_stats *stats);
+
+#ifdef	__cplusplus
+}
+#endif
+
+/** @} */
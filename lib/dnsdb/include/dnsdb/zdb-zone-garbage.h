@@ -55,6 +55,27 @@ zdb_zone *zdb_zone_garbage_get();
 
 void zdb_zone_garbage_run();
 
+/**
+ * Gives the reference of a database on an instance it does not point to anymore
+ * (see zdb_replace_zone) to the collector.
+ * The instance is flagged invalid and released by the next zdb_zone_garbage_run,
+ * once the readers of the database that could have seen it are gone.
+ * 
+ * @param db the database the zone was replaced in
+ * @param zone the replaced instance
+ */
+
+void zdb_zone_garbage_retire(zdb *db, zdb_zone *zone);
+
+/**
+ * Releases the retired instances.
+ * 
+ * @param db if not NULL, only the instances of this database, locked for writing by the caller,
+ *           are released, else the readers of each database are waited for first.
+ */
+
+void zdb_zone_garbage_release_retired(zdb *db);
+
 bool zdb_zone_garbage_empty();
 
 typedef void zdb_zone_garbage_run_cb(zdb_zone *);
@@ -0,0 +1,126 @@
+/*------------------------------------------------------------------------------
+*
+* Copyright (c) 2011-2019, EURid vzw. All rights reserved.
+* The YADIFA TM software product is provided under the BSD 3-clause license:
+* 
+* Redistribution and use in source and binary forms, with or without 
+* modification, are permitted provided that the following conditions
+* are met:
+*
+*        * Redistributions of source code must retain the above copyright 
+*          notice, this list of conditions and the following disclaimer.
+*        * Redistributions in binary form must reproduce the above copyright 
+*          notice, this list of conditions and the following disclaimer in the 
+*          documentation and/or other materials provided with the distribution.
+*        * Neither the name of EURid nor the names of its contributors may be 
+*          used to endorse or promote products derived from this software 
+*          without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*------------------------------------------------------------------------------
+*
+*/
+/** @defgroup dnsdbzone Zone related functions
+ *  @ingroup dnsdb
+ *  @brief The glue links of a zone
+ *
+ *  Maps the in-zone target names of the NS and MX records of a zone to the
+ *  label holding their addresses (A/AAAA), so the additional section of a
+ *  referral or of an NS/MX answer does not have to walk the zone again for
+ *  each target.
+ *
+ *  The links are built once the zone is loaded.  The changes made by the
+ *  journal replay mark the names they touch, and the links of those names
+ *  are resolved again once the changes have been committed.
+ *
+ *  A name that is not in the map is looked for in the zone as before.
+ *
+ * @{
+ */
+
+#pragma once
+
+#include <dnscore/sys_types.h>
+#include <dnsdb/zdb_config.h>
+#include <dnsdb/zdb_types.h>
+
+#ifdef	__cplusplus
+extern "C"
+{
+#endif
+
+#if ZDB_ZONE_GLUE_SUPPORT
+
+#define ZDB_ZONE_GLUE_TAG 0x5445554c4742445a /* "ZDBGLUET" */
+
+/**
+ * Builds the glue links of the zone, replacing the previous ones if any.
+ * 
+ * The zone is expected to be locked for writing.
+ */
+
+void zdb_zone_glue_build(zdb_zone *zone);
+
+/**
+ * Destroys the glue links of the zone.
+ * 
+ * The zone is expected to be locked for writing or unreachable.
+ */
+
+void zdb_zone_glue_destroy(zdb_zone *zone);
+
+/**
+ * Marks the links that may be affected by the addition or the removal of a record.
+ * The record itself does not have to be in the zone yet (or anymore).
+ * 
+ * The zone is expected to be locked for writing.
+ * 
+ * @param zone the zone
+ * @param fqdn the owner of the record
+ * @param rtype the type of the record
+ * @param rdata the rdata of the record
+ * @param rdata_size the size of the rdata
+ */
+
+void zdb_zone_glue_touch(zdb_zone *zone, const u8 *fqdn, u16 rtype, const u8 *rdata, u16 rdata_size);
+
+/**
+ * Resolves again the links marked by zdb_zone_glue_touch.
+ * 
+ * The zone is expected to be locked for writing.
+ */
+
+void zdb_zone_glue_update(zdb_zone *zone);
+
+/**
+ * Gets the label holding the addresses of a target name.
+ * 
+ * The zone is expected to be locked for reading.
+ * 
+ * @param zone the zone
+ * @param fqdn the target name
+ * @param labelp receives the label, NULL if the name has no address in the zone
+ * 
+ * @return TRUE if the name is linked, FALSE if the zone has to be looked at
+ */
+
+bool zdb_zone_glue_find(const zdb_zone *zone, const u8 *fqdn, zdb_rr_label **labelp);
+
+#endif
+
+#ifdef	__cplusplus
+}
+#endif
+
+/** @} */
@@ -0,0 +1,140 @@
+/*------------------------------------------------------------------------------
+*
+* Copyright (c) 2011-2019, EURid vzw. All rights reserved.
+* The YADIFA TM software product is provided under the BSD 3-clause license:
+* 
+* Redistribution and use in source and binary forms, with or without 
+* modification, are permitted provided that the following conditions
+* are met:
+*
+*        * Redistributions of source code must retain the above copyright 
+*          notice, this list of conditions and the following disclaimer.
+*        * Redistributions in binary form must reproduce the above copyright 
+*          notice, this list of conditions and the following disclaimer in the 
+*          documentation and/or other materials provided with the distribution.
+*        * Neither the name of EURid nor the names of its contributors may be 
+*          used to endorse or promote products derived from this software 
+*          without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*------------------------------------------------------------------------------
+*
+*/
+/** @defgroup dnsdbzone Zone related functions
+ *  @ingroup dnsdb
+ *  @brief Zone lock contention profiler
+ *
+ *  Samples how long the zone locks are waited for and held, per zone and per owner.
+ *
+ *  Unlike the lock monitor, it is always compiled in: an uncontended lock only costs
+ *  a clock read when the first owner takes it and when the last one releases it.
+ *  Only the waits and holds lasting at least the threshold are kept, in a fixed-size
+ *  ring owned by the thread that measured them.
+ *
+ * @{
+ */
+
+#pragma once
+
+#include <dnscore/timems.h>
+#include <dnscore/output_stream.h>
+
+#include <dnsdb/zdb_types.h>
+
+#ifdef	__cplusplus
+extern "C"
+{
+#endif
+
+#define ZDB_ZONE_LOCK_PROFILE_WAIT              0
+#define ZDB_ZONE_LOCK_PROFILE_HOLD              1
+
+#define ZDB_ZONE_LOCK_PROFILE_THRESHOLD_DEFAULT 1000000     // 1ms
+#define ZDB_ZONE_LOCK_PROFILE_DISABLED          MAX_U64
+
+extern volatile u64 zdb_zone_lock_profile_threshold_ns;
+
+/**
+ * Sets the minimum duration of a wait or a hold for it to be sampled.
+ * 
+ * @param threshold_ns the duration in nanoseconds, ZDB_ZONE_LOCK_PROFILE_DISABLED to stop sampling
+ */
+
+void zdb_zone_lock_profile_set_threshold(u64 threshold_ns);
+
+/**
+ * Stores a sample in the buffer of the current thread.
+ * 
+ * @param origin the origin of the zone
+ * @param owner the owner that waited or held the lock
+ * @param other for a wait, the owner that was holding the lock
+ * @param kind ZDB_ZONE_LOCK_PROFILE_WAIT or ZDB_ZONE_LOCK_PROFILE_HOLD
+ * @param duration_ns the duration of the wait or the hold
+ */
+
+void zdb_zone_lock_profile_record(const u8 *origin, u8 owner, u8 other, u8 kind, u64 duration_ns);
+
+/**
+ * Samples a wait or a hold that started at start_ns if it lasted long enough.
+ * 
+ * @param origin the origin of the zone
+ * @param owner the owner that waited or held the lock
+ * @param other for a wait, the owner that was holding the lock
+ * @param kind ZDB_ZONE_LOCK_PROFILE_WAIT or ZDB_ZONE_LOCK_PROFILE_HOLD
+ * @param start_ns the timens_monotonic() value at the start of the wait or hold
+ */
+
+static inline void
+zdb_zone_lock_profile_sample(const u8 *origin, u8 owner, u8 other, u8 kind, u64 start_ns)
+{
+    u64 duration_ns = timens_monotonic() - start_ns;
+    
+    if(duration_ns >= zdb_zone_lock_profile_threshold_ns)
+    {
+        zdb_zone_lock_profile_record(origin, owner, other, kind, duration_ns);
+    }
+}
+
+/**
+ * Returns the name of a lock owner.
+ * 
+ * @param owner the owner
+ * @return the name or NULL if the owner is not known
+ */
+
+const char *zdb_zone_lock_profile_owner_name(u8 owner);
+
+/**
+ * Writes the worst waits and holds of all the thread buffers as a JSON object,
+ * then a summary of the samples per zone and owner.
+ * 
+ * @param os the output stream
+ * @param max_count the maximum number of entries in each list
+ * 
+ * @return an error code
+ */
+
+ya_result zdb_zone_lock_profile_write_json(output_stream *os, u32 max_count);
+
+/**
+ * Releases the buffers of all the threads.
+ */
+
+void zdb_zone_lock_profile_finalize();
+
+#ifdef	__cplusplus
+}
+#endif
+
+/** @} */
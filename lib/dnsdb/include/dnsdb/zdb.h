@@ -178,6 +178,27 @@ void zdb_create(zdb *db);
 
 zdb_zone *zdb_set_zone(zdb *db, zdb_zone* zone);
 
+/**
+ * 
+ * Replaces the instance of a zone in the DB.
+ * 
+ * The new instance is published in the zone label with an atomic exchange,
+ * only holding the DB for reading, so the queries are never blocked.
+ * Queries running at that time may still be using the old instance: if it
+ * differs from the new one, the caller gives it to zdb_zone_garbage_retire
+ * instead of releasing it.
+ * 
+ * If the zone was not in the DB, this is zdb_set_zone.
+ * The zone added gets its RC increased.
+ * 
+ * @param db
+ * @param zone
+ * 
+ * @return the old instance, or NULL
+ */
+
+zdb_zone *zdb_replace_zone(zdb *db, zdb_zone* zone);
+
 zdb_zone *zdb_remove_zone(zdb *db, dnsname_vector *name);
 
 zdb_zone *zdb_remove_zone_from_dnsname(zdb *db, const u8 *dnsname);
@@ -72,6 +72,28 @@ extern "C"
 
 #define ZDB_INLINES_HTBT_FIND 1
 
+/**
+ * Stores the RRsets of a label in one contiguous block sorted by type instead
+ * of a btree.
+ */
+
+#define ZDB_RR_COLLECTION_BLOCK 1
+
+/**
+ * The labels, records and collections of a zone built by the loader are
+ * taken from a zone-owned arena of large mmap'd chunks, released at once when
+ * the zone is destroyed.
+ */
+
+#define ZDB_ZONE_ARENA_SUPPORT 1
+
+/**
+ * Links the in-zone targets of the NS and MX records of a zone to the label
+ * of their addresses, for the additional section.
+ */
+
+#define ZDB_ZONE_GLUE_SUPPORT 1
+
 /**
  *
  * Enables or disables the use of openssl for digital signatures.
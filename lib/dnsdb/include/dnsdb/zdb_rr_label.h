@@ -260,10 +260,10 @@ static inline bool zdb_rr_label_is_glue(zdb_rr_label* label)
 
 #if ZDB_HAS_DNSSEC_SUPPORT != 0
 /* 2 USES */
-#define RR_LABEL_RELEVANT(rr_label_)   ((dictionary_notempty(&(rr_label_)->sub))||(btree_notempty((rr_label_)->resource_record_set))||(rr_label_->nsec.dnssec != NULL))
+#define RR_LABEL_RELEVANT(rr_label_)   ((dictionary_notempty(&(rr_label_)->sub))||(zdb_rr_collection_notempty((rr_label_)->resource_record_set))||(rr_label_->nsec.dnssec != NULL))
 
 static inline bool zdb_rr_label_has_children(zdb_rr_label *label) {return dictionary_notempty(&label->sub);}
-static inline bool zdb_rr_label_has_records(zdb_rr_label *label) {return btree_notempty(label->resource_record_set);}
+static inline bool zdb_rr_label_has_records(zdb_rr_label *label) {return zdb_rr_collection_notempty(label->resource_record_set);}
 static inline bool zdb_rr_label_has_dnssec_extension(zdb_rr_label *label) {return label->nsec.dnssec != NULL;}
 static inline bool zdb_rr_label_is_empty_terminal(zdb_rr_label *label)
 {
@@ -272,18 +272,18 @@ static inline bool zdb_rr_label_is_empty_terminal(zdb_rr_label *label)
 
 /* label is only alive because of NSEC3 */
 #define RR_LABEL_HASSUB(rr_label_)      (dictionary_notempty(&(rr_label_)->sub))
-#define RR_LABEL_HASSUBORREC(rr_label_)((dictionary_notempty(&(rr_label_)->sub))||(btree_notempty((rr_label_)->resource_record_set)))
-#define RR_LABEL_NOSUBNORREC(rr_label_)((dictionary_notempty(&(rr_label_)->sub))&&(btree_notempty((rr_label_)->resource_record_set)))
+#define RR_LABEL_HASSUBORREC(rr_label_)((dictionary_notempty(&(rr_label_)->sub))||(zdb_rr_collection_notempty((rr_label_)->resource_record_set)))
+#define RR_LABEL_NOSUBNORREC(rr_label_)((dictionary_notempty(&(rr_label_)->sub))&&(zdb_rr_collection_notempty((rr_label_)->resource_record_set)))
 
 /* 9 USES */
-#define RR_LABEL_IRRELEVANT(rr_label_) ((dictionary_isempty(&(rr_label_)->sub))&&(btree_isempty((rr_label_)->resource_record_set))&&(rr_label_->nsec.dnssec == NULL))
+#define RR_LABEL_IRRELEVANT(rr_label_) ((dictionary_isempty(&(rr_label_)->sub))&&(zdb_rr_collection_isempty((rr_label_)->resource_record_set))&&(rr_label_->nsec.dnssec == NULL))
 
 #else
 /* 2 USES */
-#define RR_LABEL_RELEVANT(rr_label_)   (dictionary_notempty(&(rr_label_)->sub)||(btree_notempty((rr_label_)->resource_record_set)))
+#define RR_LABEL_RELEVANT(rr_label_)   (dictionary_notempty(&(rr_label_)->sub)||(zdb_rr_collection_notempty((rr_label_)->resource_record_set)))
 
 /* 9 USES */
-#define RR_LABEL_IRRELEVANT(rr_label_) (dictionary_isempty(&(rr_label_)->sub)&&(btree_isempty((rr_label_)->resource_record_set)))
+#define RR_LABEL_IRRELEVANT(rr_label_) (dictionary_isempty(&(rr_label_)->sub)&&(zdb_rr_collection_isempty((rr_label_)->resource_record_set)))
 
 #endif
 
@@ -53,6 +53,8 @@
 
 #include <dnsdb/zdb_config.h>
 #include <dnsdb/dictionary.h>
+#include <dnsdb/zdb-rr-collection.h>
+#include <dnsdb/zdb-zone-arena.h>
 //#include <dnsdb/journal.h>
 
 #include <dnsdb/zdb_error.h>
@@ -96,7 +98,10 @@ struct zdb_packed_ttlrdata_soa
 
 #define ZDB_RECORD_ZALLOC(record,ttl_,len_,rdata_)                   \
     {                                                                \
-        MALLOC_OR_DIE(zdb_packed_ttlrdata*,(record),sizeof(zdb_packed_ttlrdata)-1+len_,ZDB_RECORD_TAG); /* ZALLOC IMPOSSIBLE */ \
+        if(((record)=(zdb_packed_ttlrdata*)zdb_zone_arena_alloc(sizeof(zdb_packed_ttlrdata)-1+len_)) == NULL) \
+        {                                                            \
+            MALLOC_OR_DIE(zdb_packed_ttlrdata*,(record),sizeof(zdb_packed_ttlrdata)-1+len_,ZDB_RECORD_TAG); /* ZALLOC IMPOSSIBLE */ \
+        }                                                            \
         (record)->ttl=ttl_;                                          \
         (record)->rdata_size=len_;                                   \
         MEMCOPY(&(record)->rdata_start[0],rdata_,len_);               \
@@ -104,7 +109,10 @@ struct zdb_packed_ttlrdata_soa
 
 #define ZDB_RECORD_ZALLOC_EMPTY(record,ttl_,len_)                    \
     {                                                                \
-        MALLOC_OR_DIE(zdb_packed_ttlrdata*,(record),sizeof(zdb_packed_ttlrdata)-1+len_,ZDB_RECORD_TAG); /* ZALLOC IMPOSSIBLE */ \
+        if(((record)=(zdb_packed_ttlrdata*)zdb_zone_arena_alloc(sizeof(zdb_packed_ttlrdata)-1+len_)) == NULL) \
+        {                                                            \
+            MALLOC_OR_DIE(zdb_packed_ttlrdata*,(record),sizeof(zdb_packed_ttlrdata)-1+len_,ZDB_RECORD_TAG); /* ZALLOC IMPOSSIBLE */ \
+        }                                                            \
         (record)->ttl=ttl_;                                          \
         (record)->rdata_size=len_;                                   \
     }
@@ -112,28 +120,39 @@ struct zdb_packed_ttlrdata_soa
 #define ZDB_RECORD_CLONE(record_s_,record_d_)                           \
     {                                                                   \
         u32 size=sizeof(zdb_packed_ttlrdata)-1+(record_s_)->rdata_size; \
-        MALLOC_OR_DIE(zdb_packed_ttlrdata*,(record_d_),size,ZDB_RECORD_TAG); /* ZALLOC IMPOSSIBLE */ \
+        if(((record_d_)=(zdb_packed_ttlrdata*)zdb_zone_arena_alloc(size)) == NULL) \
+        {                                                               \
+            MALLOC_OR_DIE(zdb_packed_ttlrdata*,(record_d_),size,ZDB_RECORD_TAG); /* ZALLOC IMPOSSIBLE */ \
+        }                                                               \
         record_d_->ttl=record_s_->ttl;                                  \
         record_d_->rdata_size=record_s_->rdata_size;                    \
         MEMCOPY(&(record_d_)->rdata_start[0],&(record_s_)->rdata_start[0],record_s_->rdata_size); \
     }
 
-#define ZDB_RECORD_ZFREE(record) free(record)
+#define ZDB_RECORD_ZFREE(record) if(!zdb_zone_arena_owns(record)) { free(record); }
 
-#define ZDB_RECORD_SAFE_ZFREE(record) free(record)
+#define ZDB_RECORD_SAFE_ZFREE(record) if(!zdb_zone_arena_owns(record)) { free(record); }
 
 #else
 
+/*
+ * The records of a zone being loaded are taken from its arena (zdb-zone-arena.h)
+ * and are not freed one by one.
+ */
+
 #define ZDB_RECORD_ZALLOC(record_,ttl_,len_,rdata_)                     \
     {                                                                   \
         u32 size=ZDB_RECORD_SIZE_FROM_RDATASIZE(len_);                  \
-        if(size<=ZALLOC_PG_PAGEABLE_MAXSIZE)                         \
+        if(((record_)=(zdb_packed_ttlrdata*)zdb_zone_arena_alloc(size)) == NULL) \
         {                                                               \
-            record_=(zdb_packed_ttlrdata*)zalloc_line((size-1)>>3);      \
-        }                                                               \
-        else                                                            \
-        {                                                               \
-            MALLOC_OR_DIE(zdb_packed_ttlrdata*,(record_),sizeof(zdb_packed_ttlrdata)-1+len_,ZDB_RECORD_TAG); /* ZALLOC IMPOSSIBLE */ \
+            if(size<=ZALLOC_PG_PAGEABLE_MAXSIZE)                        \
+            {                                                           \
+                record_=(zdb_packed_ttlrdata*)zalloc_line((size-1)>>3); \
+            }                                                           \
+            else                                                        \
+            {                                                           \
+                MALLOC_OR_DIE(zdb_packed_ttlrdata*,(record_),sizeof(zdb_packed_ttlrdata)-1+len_,ZDB_RECORD_TAG); /* ZALLOC IMPOSSIBLE */ \
+            }                                                           \
         }                                                               \
                                                                         \
         (record_)->ttl=ttl_;                                            \
@@ -144,13 +163,16 @@ struct zdb_packed_ttlrdata_soa
 #define ZDB_RECORD_ZALLOC_EMPTY(record_,ttl_,len_)                      \
     {                                                                   \
         u32 size=ZDB_RECORD_SIZE_FROM_RDATASIZE(len_);                  \
-        if(size<=ZALLOC_PG_PAGEABLE_MAXSIZE)                         \
+        if(((record_)=(zdb_packed_ttlrdata*)zdb_zone_arena_alloc(size)) == NULL) \
         {                                                               \
-            record_=(zdb_packed_ttlrdata*)zalloc_line((size-1)>>3);      \
-        }                                                               \
-        else                                                            \
-        {                                                               \
-            MALLOC_OR_DIE(zdb_packed_ttlrdata*,(record_),sizeof(zdb_packed_ttlrdata)-1+len_,ZDB_RECORD_TAG); /* ZALLOC IMPOSSIBLE */ \
+            if(size<=ZALLOC_PG_PAGEABLE_MAXSIZE)                        \
+            {                                                           \
+                record_=(zdb_packed_ttlrdata*)zalloc_line((size-1)>>3); \
+            }                                                           \
+            else                                                        \
+            {                                                           \
+                MALLOC_OR_DIE(zdb_packed_ttlrdata*,(record_),sizeof(zdb_packed_ttlrdata)-1+len_,ZDB_RECORD_TAG); /* ZALLOC IMPOSSIBLE */ \
+            }                                                           \
         }                                                               \
                                                                         \
         (record_)->ttl=ttl_;                                            \
@@ -160,13 +182,16 @@ struct zdb_packed_ttlrdata_soa
 #define ZDB_RECORD_CLONE(record_s_,record_d_)                           \
     {                                                                   \
         u32 size=ZDB_RECORD_SIZE_FROM_RDATASIZE((record_s_)->rdata_size);\
-        if(size<=ZALLOC_PG_PAGEABLE_MAXSIZE)                         \
-        {                                                               \
-            record_d_=(zdb_packed_ttlrdata*)zalloc_line((size-1)>>3); \
-        }                                                               \
-        else                                                            \
+        if(((record_d_)=(zdb_packed_ttlrdata*)zdb_zone_arena_alloc(size)) == NULL) \
         {                                                               \
-            MALLOC_OR_DIE(zdb_packed_ttlrdata*,(record_d_),size,ZDB_RECORD_TAG); /* ZALLOC IMPOSSIBLE */ \
+            if(size<=ZALLOC_PG_PAGEABLE_MAXSIZE)                        \
+            {                                                           \
+                record_d_=(zdb_packed_ttlrdata*)zalloc_line((size-1)>>3); \
+            }                                                           \
+            else                                                        \
+            {                                                           \
+                MALLOC_OR_DIE(zdb_packed_ttlrdata*,(record_d_),size,ZDB_RECORD_TAG); /* ZALLOC IMPOSSIBLE */ \
+            }                                                           \
         }                                                               \
         record_d_->ttl=record_s_->ttl;                                  \
         record_d_->rdata_size=record_s_->rdata_size;                    \
@@ -175,6 +200,7 @@ struct zdb_packed_ttlrdata_soa
 
 /* DOES NOT CHECKS FOR NULL */
 #define ZDB_RECORD_ZFREE(record_)                                       \
+    if(!zdb_zone_arena_owns(record_))                                   \
     {                                                                   \
         u32 size=ZDB_RECORD_SIZE_FROM_RDATASIZE((record_)->rdata_size); \
         if(size<=ZALLOC_PG_PAGEABLE_MAXSIZE)                         \
@@ -189,7 +215,7 @@ struct zdb_packed_ttlrdata_soa
 
 /* DOES CHECKS FOR NULL */
 #define ZDB_RECORD_SAFE_ZFREE(record_)                                  \
-    if(record_ != NULL)                                                 \
+    if((record_ != NULL) && !zdb_zone_arena_owns(record_))              \
     {                                                                   \
         u32 size=ZDB_RECORD_SIZE_FROM_RDATASIZE((record_)->rdata_size); \
         if(size<=ZALLOC_PG_PAGEABLE_MAXSIZE)                         \
@@ -249,7 +275,6 @@ struct zdb_ttlrdata
         (record).rdata_pointer=rdata_;                              \
     }
 
-typedef btree zdb_rr_collection;
 
 
 #define ZDB_RESOURCERECORD_TAG 0x444345524c4c5546   /** "FULLRECD" */
@@ -438,7 +463,7 @@ struct zdb_rr_label
     zdb_rr_label* next; /* dictionnary_node* next */ /*  4  8 */
     zdb_rr_label_set sub; /* dictionnary of N children labels */ /* 16 24 */
 
-    zdb_rr_collection resource_record_set; /* resource records for the label (a btree)*/ /*  4  4 */
+    zdb_rr_collection resource_record_set; /* resource records for the label (a block or a btree)*/ /*  4  4 */
 
 #if ZDB_HAS_DNSSEC_SUPPORT != 0
     nsec_label_union nsec;
@@ -582,6 +607,9 @@ struct zdb_zone
     u16 zclass;
 #endif
     
+    u32 query_count_slot;               // the slot of the origin in the per-thread query counters, for statistics
+    u64 lock_profile_since;             // when the current owner took the lock (monotonic ns), for the contention profiler
+    
     mutex_t lock_mutex;
     cond_t  lock_cond;
     
@@ -600,6 +628,14 @@ struct zdb_zone
     /** journal is only to be accessed trough the journal_* functions */
     struct journal *_journal;
 #endif
+
+#if ZDB_ZONE_ARENA_SUPPORT
+    zdb_zone_arena *arena;              // the memory of the content built by the loader, NULL if it was not loaded
+#endif
+
+#if ZDB_ZONE_GLUE_SUPPORT
+    struct zdb_zone_glue *glue;         // NS/MX target -> label of its addresses, NULL if not built
+#endif
         
     dnsname_vector origin_vector;       // note: the origin vector is truncated to it's used length (sparing quite a lot of memory)
 
@@ -631,9 +667,12 @@ typedef struct zdb zdb;
 
 #define ZDBCLASS_TAG 0x5353414c4342445a
 
+struct zdb_zone_apex_index;
+
 struct zdb
 {
     zdb_zone_label* root;
+    struct zdb_zone_apex_index *apex_index; /* origin -> zone label, for zdb_zone_label_match */
     alarm_t alarm_handle;
     group_mutex_t mutex;
     u16 zclass;
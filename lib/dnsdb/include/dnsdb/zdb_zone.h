@@ -518,6 +518,58 @@ void zdb_zone_update_keystore_keys_from_zone(zdb_zone *zone, u8 secondary_lock);
 
 #endif
 
+/**
+ * Per-thread query counters of the zones.
+ *
+ * Each zone origin is given a slot the first time a zone instance is created for it, so the counts
+ * survive a reload.  A thread registers its counters with zdb_zone_query_counters_set and is then
+ * the only one writing them, without atomics.  The counters are read by adding up the ones of all
+ * the threads.  The pages are allocated on the first query for one of their slots and are kept
+ * until the counters are finalised.
+ */
+
+#define ZDB_ZONE_QUERY_COUNTERS_PAGE_SIZE   512     // slots per page
+#define ZDB_ZONE_QUERY_COUNTERS_PAGE_COUNT  4096    // origins beyond 2M slots are not counted
+
+struct zdb_zone_query_counters
+{
+    u64 *page[ZDB_ZONE_QUERY_COUNTERS_PAGE_COUNT];
+};
+
+typedef struct zdb_zone_query_counters zdb_zone_query_counters;
+
+/**
+ * Sets the counters the current thread counts the queries answered by the zones into.
+ *
+ * @param counters the counters, owned by the caller, or NULL to stop counting
+ */
+
+void zdb_zone_query_counters_set(zdb_zone_query_counters *counters);
+
+/**
+ * Counts a query answered by the zone in the counters of the current thread, if any.
+ */
+
+void zdb_zone_query_count(const zdb_zone *zone);
+
+/**
+ * Returns the number of queries of the zone origin in the counters of one thread.
+ */
+
+u64 zdb_zone_query_counters_get(const zdb_zone_query_counters *counters, const zdb_zone *zone);
+
+/**
+ * Releases the pages of the counters.  Only to be called once the thread is not using them anymore.
+ */
+
+void zdb_zone_query_counters_finalize(zdb_zone_query_counters *counters);
+
+/**
+ * Releases the slots of the zone origins.
+ */
+
+void zdb_zone_query_count_finalize();
+
 #ifdef DEBUG
 
 /**
@@ -127,6 +127,48 @@ void zdb_zone_label_destroy(zdb_zone_label **zone_labelp);
 /* 1 USE */
 s32 zdb_zone_label_match(zdb* db, const dnsname_vector *name, zdb_zone_label_pointer_array zone_label_vector);
 
+/**
+ * @brief Initialises the zone apex index of the database.
+ *
+ * The index maps the origin of every mounted zone to its zone label.
+ * It is what zdb_zone_label_match probes, longest suffix first, instead of walking the label tree.
+ *
+ * @param[in] db a pointer to the database
+ */
+
+void zdb_zone_apex_index_init(zdb *db);
+
+/**
+ * @brief Releases the zone apex index of the database.
+ *
+ * @param[in] db a pointer to the database
+ */
+
+void zdb_zone_apex_index_finalize(zdb *db);
+
+/**
+ * @brief Maps the origin to the zone label in the apex index.
+ *
+ * The database writer lock must be held.
+ *
+ * @param[in] db a pointer to the database
+ * @param[in] origin the origin of the zone
+ * @param[in] zone_label the label holding the zone
+ */
+
+void zdb_zone_apex_index_set(zdb *db, const dnsname_vector *origin, zdb_zone_label *zone_label);
+
+/**
+ * @brief Removes the origin from the apex index.
+ *
+ * The database writer lock must be held.
+ *
+ * @param[in] db a pointer to the database
+ * @param[in] origin the origin of the zone
+ */
+
+void zdb_zone_apex_index_remove(zdb *db, const dnsname_vector *origin);
+
 
 
 /**
@@ -57,6 +57,33 @@ ya_result zdb_zone_write_text(const zdb_zone* zone, output_stream *fos, bool for
 #define ZDB_ZONE_WRITE_TEXT_FILE_IGNORE_SHUTDOWN 2
 
 ya_result zdb_zone_write_text_file(const zdb_zone* zone, const char* output_file, u8 flags);
+
+/**
+ * Called once the whole zone has been read by the text writer, before the end of the text is written.
+ * After this call the writer does not access the zone anymore, so its lock can be released.
+ */
+
+typedef void zdb_zone_write_text_formatted_callback(const zdb_zone *zone, void *args);
+
+/**
+ * As zdb_zone_write_text_file, with a callback telling when the zone is not needed anymore.
+ * 
+ * @param zone the zone, locked
+ * @param output_file the file name
+ * @param flags ZDB_ZONE_WRITE_TEXT_FILE_* flags
+ * @param formatted the callback, can be NULL
+ * @param formatted_args the argument given to the callback
+ * 
+ * @return an error code
+ */
+
+ya_result zdb_zone_write_text_file_ex(const zdb_zone* zone, const char* output_file, u8 flags, zdb_zone_write_text_formatted_callback *formatted, void *formatted_args);
+
+/**
+ * Stops the threads used to format the zones in text
+ */
+
+void zdb_zone_write_text_finalize();
 ya_result zdb_zone_write_unbound(const zdb_zone* zone, const char* output_file);
 
 #ifdef	__cplusplus
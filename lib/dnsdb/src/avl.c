@@ -53,6 +53,7 @@
 #include <dnscore/sys_types.h>
 #include <dnscore/zalloc.h>
 #include "dnsdb/zdb_error.h"
+#include "dnsdb/zdb-zone-arena.h"
 
 #include <dnscore/format.h>
 
@@ -213,7 +214,7 @@ avl_create_node(hashcode hash)
 {
     avl_node* node;
 
-    ZALLOC_OR_DIE(avl_node*, node, avl_node, AVL_NODE_TAG);
+    ZDB_ZONE_ALLOC_OR_DIE(avl_node*, node, avl_node, AVL_NODE_TAG);
 
     LEFT_CHILD(node) = NULL;
     RIGHT_CHILD(node) = NULL;
@@ -231,7 +232,7 @@ avl_create_node(hashcode hash)
    }
  */
 
-#define avl_destroy_node(node) LDEBUG(9, "avl_destroy_node(%p)\n",node);ZFREE(node,avl_node);
+#define avl_destroy_node(node) LDEBUG(9, "avl_destroy_node(%p)\n",node);ZDB_ZONE_FREE(node,avl_node);
 
 /** @brief Initializes the tree
  *
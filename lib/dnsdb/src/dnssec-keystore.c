@@ -60,6 +60,10 @@
 
 #include <dnscore/ptr_set.h>
 #include <dnscore/u32_set.h>
+#include <dnscore/ptr_vector.h>
+#include <dnscore/mutex.h>
+#include <dnscore/thread_pool.h>
+#include <dnscore/sys_get_cpu_count.h>
 
 #include <dnscore/fdtools.h>
 #include <sys/stat.h>
@@ -85,7 +89,7 @@ extern logger_handle *g_dnssec_logger;
 
 static int dnssec_keystore_keys_node_compare(const void *, const void *);
 
-#define DNSSEC_KEYSTORE_EMPTY {PTR_SET_CUSTOM(ptr_set_nullable_asciizp_node_compare), PTR_SET_CUSTOM(dnssec_keystore_keys_node_compare), PTR_SET_CUSTOM(ptr_set_nullable_dnsname_node_compare)/*, NULL*/, MUTEX_INITIALIZER}
+#define DNSSEC_KEYSTORE_EMPTY {PTR_SET_CUSTOM(ptr_set_nullable_asciizp_node_compare), PTR_SET_CUSTOM(dnssec_keystore_keys_node_compare), PTR_SET_CUSTOM(ptr_set_nullable_dnsname_node_compare)/*, NULL*/, GROUP_MUTEX_INITIALIZER}
 
 
 //typedef btree dnssec_keystore;
@@ -123,7 +127,7 @@ struct dnssec_keystore
     ptr_set keys;       // name+alg+tag -> key
     ptr_set domains;    // name -> dnssec_keystore_domain_s
     //const char *default_path;
-    mutex_t lock;       // mutex
+    group_mutex_t lock; // shared by the lookups, exclusive for the changes
 };
 
 typedef struct dnssec_keystore dnssec_keystore;
@@ -190,9 +194,9 @@ dnssec_keystore_get_domain_nolock(dnssec_keystore *ks, const u8 *domain)
 static dnssec_keystore_domain_s*
 dnssec_keystore_get_domain(dnssec_keystore *ks, const u8 *domain)
 {
-    mutex_lock(&ks->lock);
+    group_mutex_read_lock(&ks->lock);
     dnssec_keystore_domain_s *ret = dnssec_keystore_get_domain_nolock(ks, domain);
-    mutex_unlock(&ks->lock);
+    group_mutex_read_unlock(&ks->lock);
     return ret;
 }
 
@@ -282,9 +286,9 @@ void
 dnssec_keystore_add_domain(/*dnssec_keystore *ks, */const u8 *domain, const char *path)
 {
     dnssec_keystore *ks = &g_keystore;
-    mutex_lock(&ks->lock);
+    group_mutex_write_lock(&ks->lock);
     dnssec_keystore_add_domain_nolock(ks, domain, path);
-    mutex_unlock(&ks->lock);
+    group_mutex_write_unlock(&ks->lock);
 }
 
 /**
@@ -299,7 +303,7 @@ void
 dnssec_keystore_remove_domain(/*dnssec_keystore *ks, */const u8 *domain, const char *path)
 {
     dnssec_keystore *ks = &g_keystore;
-    mutex_lock(&ks->lock);
+    group_mutex_write_lock(&ks->lock);
     ptr_node *node = ptr_set_avl_find(&ks->paths, path);
     if(node != NULL)
     {
@@ -312,7 +316,7 @@ dnssec_keystore_remove_domain(/*dnssec_keystore *ks, */const u8 *domain, const c
             free(key);
         }
     }
-    mutex_unlock(&ks->lock);
+    group_mutex_write_unlock(&ks->lock);
 }
 
 /**
@@ -432,9 +436,9 @@ bool
 dnssec_keystore_add_key(dnssec_key *key)
 {
     dnssec_keystore *ks = &g_keystore;
-    mutex_lock(&ks->lock);
+    group_mutex_write_lock(&ks->lock);
     bool ret = dnssec_keystore_add_key_nolock(ks, key); // RC
-    mutex_unlock(&ks->lock);
+    group_mutex_write_unlock(&ks->lock);
     return ret;
 }
 
@@ -454,9 +458,9 @@ bool
 dnssec_keystore_replace_key(dnssec_key *key)
 {
     dnssec_keystore *ks = &g_keystore;
-    mutex_lock(&ks->lock);
+    group_mutex_write_lock(&ks->lock);
     bool ret = dnssec_keystore_replace_key_nolock(ks, key); // RC
-    mutex_unlock(&ks->lock);
+    group_mutex_write_unlock(&ks->lock);
     return ret;
 }
 
@@ -518,9 +522,9 @@ dnssec_key*
 dnssec_keystore_remove_key(dnssec_key *key)
 {
     dnssec_keystore *ks = &g_keystore;
-    mutex_lock(&ks->lock);
+    group_mutex_write_lock(&ks->lock);
     dnssec_key *ret_key = dnssec_keystore_remove_key_nolock(ks, key); // RC
-    mutex_unlock(&ks->lock);
+    group_mutex_write_unlock(&ks->lock);
     return ret_key;
 }
 
@@ -753,9 +757,9 @@ dnssec_key*
 dnssec_keystore_acquire_key_from_fqdn(const u8 *domain, u16 tag)
 {
     dnssec_keystore *ks = &g_keystore;
-    mutex_lock(&ks->lock);
+    group_mutex_read_lock(&ks->lock);
     dnssec_key *key = dnssec_keystore_acquire_key_from_fqdn_nolock(ks, domain, tag); // RC
-    mutex_unlock(&ks->lock);
+    group_mutex_read_unlock(&ks->lock);
     
     return key;
 }
@@ -777,9 +781,9 @@ dnssec_keystore_acquire_key_from_rdata(const u8 *domain, const u8 *rdata, u16 rd
 {
     dnssec_keystore *ks = &g_keystore;
     u16 tag = dnskey_get_key_tag_from_rdata(rdata, rdata_size);
-    mutex_lock(&ks->lock);
+    group_mutex_read_lock(&ks->lock);
     dnssec_key *key = dnssec_keystore_acquire_key_from_fqdn_nolock(ks, domain, tag); // RC
-    mutex_unlock(&ks->lock);
+    group_mutex_read_unlock(&ks->lock);
     
     return key;
 }
@@ -797,7 +801,7 @@ dnssec_keystore_acquire_key_from_fqdn_by_index(const u8 *domain, int idx)
 {
     dnssec_keystore *ks = &g_keystore;
     dnssec_key *key = NULL;
-    mutex_lock(&ks->lock);
+    group_mutex_read_lock(&ks->lock);
     dnssec_keystore_domain_s* kd = dnssec_keystore_get_domain_nolock(ks, domain);
     if(kd != NULL)
     {    
@@ -813,7 +817,7 @@ dnssec_keystore_acquire_key_from_fqdn_by_index(const u8 *domain, int idx)
             dnskey_acquire(key);
         }
     }
-    mutex_unlock(&ks->lock);
+    group_mutex_read_unlock(&ks->lock);
     
     return key;
 }
@@ -834,7 +838,7 @@ dnssec_keystore_is_key_active(const u8 *domain, u8 algorithm, u16 tag, time_t no
 {
     dnssec_keystore *ks = &g_keystore;
     dnssec_key *key = NULL;
-    mutex_lock(&ks->lock);
+    group_mutex_read_lock(&ks->lock);
     dnssec_keystore_domain_s* kd = dnssec_keystore_get_domain_nolock(ks, domain);
     
     bool ret = FALSE;
@@ -859,7 +863,7 @@ dnssec_keystore_is_key_active(const u8 *domain, u8 algorithm, u16 tag, time_t no
             key = key->next;
         }
     }
-    mutex_unlock(&ks->lock);
+    group_mutex_read_unlock(&ks->lock);
     
     return ret;
 }
@@ -877,20 +881,20 @@ dnssec_keystore_is_key_active(const u8 *domain, u8 algorithm, u16 tag, time_t no
 int
 dnssec_keystore_acquire_activated_keys_from_fqdn_to_vectors(const u8 *domain, ptr_vector *ksks, ptr_vector *zsks)
 {
+    dnssec_keystore *ks = &g_keystore;
     time_t now = time(NULL);
     
-    for(int i = 0; ;++i)
+    // one pass on the chain of the domain, instead of one lookup per index
+    
+    group_mutex_read_lock(&ks->lock);
+    
+    dnssec_keystore_domain_s* kd = dnssec_keystore_get_domain_nolock(ks, domain);
+    
+    if(kd != NULL)
     {
-        dnssec_key *key = dnssec_keystore_acquire_key_from_fqdn_by_index(domain, i);
-        
-        if(key == NULL)
+        for(dnssec_key *key = kd->key_chain; key != NULL; key = key->next)
         {
-            break;
-        }
-        
-        if(dnskey_is_activated(key, now))
-        {
-            if(!dnssec_key_is_private(key))
+            if(!dnskey_is_activated(key, now) || !dnssec_key_is_private(key))
             {
                 continue;
             }
@@ -899,23 +903,23 @@ dnssec_keystore_acquire_activated_keys_from_fqdn_to_vectors(const u8 *domain, pt
             {
                 if(ksks != NULL)
                 {
+                    dnskey_acquire(key);
                     ptr_vector_append(ksks, key);
-                    continue;
                 }
             }
             else if(key->flags == DNSKEY_FLAG_ZONEKEY)
             {
                 if(zsks != NULL)
                 {
+                    dnskey_acquire(key);
                     ptr_vector_append(zsks, key);
-                    continue;
                 }
             }
         }
-        
-        dnskey_release(key);
     }
     
+    group_mutex_read_unlock(&ks->lock);
+    
     int ret = 0;
     
     if(ksks != NULL)
@@ -1021,14 +1025,94 @@ dnssec_keystore_acquire_key_from_name_by_index(const char *domain, int idx)
     return key;
 }
 
+/**
+ * Reload
+ *
+ * The key directories are scanned with the keystore shared: the private key files
+ * that are unknown or more recent than the loaded key are collected.
+ * The collected files are then parsed in parallel by the workers of the "keyload" pool,
+ * without holding the keystore.
+ * Finally the keystore is taken exclusively to merge the parsed keys.
+ */
+
+#define DNSSEC_KEYSTORE_RELOAD_THREADS_MAX  16
+#define DNSSEC_KEYSTORE_RELOAD_QUEUE_SIZE   (DNSSEC_KEYSTORE_RELOAD_THREADS_MAX * 2)
+
+#define KSRLDFIL_TAG 0x4c4946444c52534b
+
+struct dnssec_keystore_reload_file_s
+{
+    char *file;             // path of the private key file
+    dnssec_key *key;        // the key read from the file
+    ya_result ret;
+};
+
+typedef struct dnssec_keystore_reload_file_s dnssec_keystore_reload_file_s;
+
 struct dnssec_keystore_reload_readdir_callback_s
 {
     dnssec_keystore *ks;
     const char *domain;
+    ptr_vector files;       // dnssec_keystore_reload_file_s
 };
 
 typedef struct dnssec_keystore_reload_readdir_callback_s dnssec_keystore_reload_readdir_callback_s;
 
+struct dnssec_keystore_reload_job_s
+{
+    mutex_t mtx;
+    cond_t cond;
+    ptr_vector *files;
+    volatile s32 next;      // index of the next file to read
+    s32 running;            // workers not done yet
+};
+
+typedef struct dnssec_keystore_reload_job_s dnssec_keystore_reload_job_s;
+
+static struct thread_pool_s *dnssec_keystore_reload_thread_pool = NULL;
+static u32 dnssec_keystore_reload_thread_count = 0;
+static mutex_t dnssec_keystore_reload_thread_pool_mtx = MUTEX_INITIALIZER;
+
+static struct thread_pool_s *
+dnssec_keystore_reload_thread_pool_get()
+{
+    mutex_lock(&dnssec_keystore_reload_thread_pool_mtx);
+
+    if(dnssec_keystore_reload_thread_pool == NULL)
+    {
+        u32 thread_count = MAX(sys_get_cpu_count(), 1);
+
+        if(thread_count > DNSSEC_KEYSTORE_RELOAD_THREADS_MAX)
+        {
+            thread_count = DNSSEC_KEYSTORE_RELOAD_THREADS_MAX;
+        }
+
+        if((dnssec_keystore_reload_thread_pool = thread_pool_init_ex(thread_count, DNSSEC_KEYSTORE_RELOAD_QUEUE_SIZE, "keyload")) != NULL)
+        {
+            dnssec_keystore_reload_thread_count = thread_count;
+        }
+    }
+
+    mutex_unlock(&dnssec_keystore_reload_thread_pool_mtx);
+
+    return dnssec_keystore_reload_thread_pool;
+}
+
+static void
+dnssec_keystore_reload_thread_pool_finalize()
+{
+    mutex_lock(&dnssec_keystore_reload_thread_pool_mtx);
+
+    if(dnssec_keystore_reload_thread_pool != NULL)
+    {
+        thread_pool_destroy(dnssec_keystore_reload_thread_pool);
+        dnssec_keystore_reload_thread_pool = NULL;
+        dnssec_keystore_reload_thread_count = 0;
+    }
+
+    mutex_unlock(&dnssec_keystore_reload_thread_pool_mtx);
+}
+
 static ya_result
 dnssec_keystore_reload_readdir_callback(const char *basedir, const char* filename, u8 filetype, void *args_)
 {
@@ -1077,121 +1161,266 @@ dnssec_keystore_reload_readdir_callback(const char *basedir, const char* filenam
                 if(ISOK(file_mtime(file, &ts)))
                 {
                     // get the key with that domain/tag
-                    // @note 20150907 edf -- work in progress
 
                     dnssec_key *current_key = dnssec_keystore_get_key_from_name_nolock(ks, domain, tag); // RC
                     if(current_key != NULL)
                     {
                         // check if it has to be reloaded
-                        if(current_key->timestamp >= ts)
+                        
+                        bool up_to_date = (current_key->timestamp >= ts);
+                        
+                        dnskey_release(current_key);
+                        
+                        if(up_to_date)
                         {
                             // ignore this file
 
-                            dnskey_release(current_key);
-
                             return SUCCESS;
                         }
                     }
 
-                    dnssec_key *key;
+                    // the file will be read with the others
+
+                    dnssec_keystore_reload_file_s *item;
+                    MALLOC_OR_DIE(dnssec_keystore_reload_file_s*, item, sizeof(dnssec_keystore_reload_file_s), KSRLDFIL_TAG);
+                    item->file = strdup(file);
+                    item->key = NULL;
+                    item->ret = SUCCESS;
+                    ptr_vector_append(&args->files, item);
+                }
+                else
+                {
+                    log_err("could not access '%s': %r", file, ERRNO_ERROR);
+                }
+            } // else this is not a private key file
+        }
+        else
+        {
+            log_debug("ignoring key file %s (%s != %s)", filename, domain, args->domain);
+        }            
+    }
+    else
+    {
+        log_debug("ignoring file %s", filename);
+    }
+    
+    return SUCCESS; // invalid file name, but it's irrelevant for this
+}
 
-                    // remove the key from the keystore, load the key from disk
+static void
+dnssec_keystore_reload_read_file(dnssec_keystore_reload_file_s *item)
+{
+    log_debug("dnssec_keystore_reload_read_file: opening file '%s'", item->file);
+    
+    item->ret = dnskey_new_private_key_from_file(item->file, &item->key);
+}
 
-                    log_debug("dnssec_keystore_reload_readdir_callback: opening file '%s'", file);
+static void*
+dnssec_keystore_reload_read_thread(void *args_)
+{
+    dnssec_keystore_reload_job_s *job = (dnssec_keystore_reload_job_s*)args_;
+    
+    for(;;)
+    {
+        s32 index = __sync_fetch_and_add(&job->next, 1);
+        
+        if(index > ptr_vector_last_index(job->files))
+        {
+            break;
+        }
+        
+        dnssec_keystore_reload_read_file((dnssec_keystore_reload_file_s*)ptr_vector_get(job->files, index));
+    }
+    
+    mutex_lock(&job->mtx);
+    if(--job->running == 0)
+    {
+        cond_notify(&job->cond);
+    }
+    mutex_unlock(&job->mtx);
+    
+    return NULL;
+}
 
-                    ya_result ret;
+/**
+ * Reads all the collected files, in parallel if there is more than one.
+ */
 
-                    if(ISOK(ret = dnskey_new_private_key_from_file(file, &key)))
-                    {
-                        if((key->epoch_publish == 0) || (key->epoch_activate == 0) || (key->epoch_inactive == 0) || (key->epoch_delete == 0))
-                        {
-                            log_warn("key from '%s' is missing smart fields", file);
-                        }
+static void
+dnssec_keystore_reload_read_files(ptr_vector *files)
+{
+    s32 count = ptr_vector_size(files);
+    struct thread_pool_s *tp = NULL;
+    
+    if(count > 1)
+    {
+        tp = dnssec_keystore_reload_thread_pool_get();
+    }
+    
+    if(tp == NULL)
+    {
+        for(s32 i = 0; i < count; ++i)
+        {
+            dnssec_keystore_reload_read_file((dnssec_keystore_reload_file_s*)ptr_vector_get(files, i));
+        }
+        
+        return;
+    }
+    
+    s32 workers = MIN(count, (s32)dnssec_keystore_reload_thread_count);
+    
+    dnssec_keystore_reload_job_s job;
+    mutex_init(&job.mtx);
+    cond_init(&job.cond);
+    job.files = files;
+    job.next = 0;
+    job.running = workers;
+    
+    for(s32 i = 0; i < workers; ++i)
+    {
+        if(FAIL(thread_pool_enqueue_call(tp, dnssec_keystore_reload_read_thread, &job, NULL, "keyload")))
+        {
+            dnssec_keystore_reload_read_thread(&job);
+        }
+    }
+    
+    mutex_lock(&job.mtx);
+    while(job.running > 0)
+    {
+        cond_wait(&job.cond, &job.mtx);
+    }
+    mutex_unlock(&job.mtx);
+    
+    cond_finalize(&job.cond);
+    mutex_destroy(&job.mtx);
+}
+
+/**
+ * Merges a key read from a file into the keystore.
+ * The keystore must be locked exclusively.
+ */
+
+static void
+dnssec_keystore_reload_merge_nolock(dnssec_keystore *ks, dnssec_keystore_reload_file_s *item)
+{
+    const char *file = item->file;
+    dnssec_key *key = item->key;
+    
+    if(FAIL(item->ret))
+    {
+        log_err("could not read '%s': %r (missing public .key file ?)", file, item->ret);
+        return;
+    }
+    
+    if((key->epoch_publish == 0) || (key->epoch_activate == 0) || (key->epoch_inactive == 0) || (key->epoch_delete == 0))
+    {
+        log_warn("key from '%s' is missing smart fields", file);
+    }
 #ifdef DEBUG
-                        log_debug1("dnssec_keystore_reload_readdir_callback: private key generated from file '%s'", file);
-#endif               
-                        // compare the cryptographic parts of the key (the public key is enough) and
-                        // overwrite the timestamps iff they are the same, else ... refuse to break security
+    log_debug1("dnssec_keystore_reload_readdir_callback: private key generated from file '%s'", file);
+#endif
+    
+    // the key may have been added since the scan
+    
+    dnssec_key *current_key = dnssec_keystore_acquire_key_from_fqdn_nolock(ks, dnssec_key_get_domain(key), dnssec_key_get_tag(key)); // RC
+    
+    // compare the cryptographic parts of the key (the public key is enough) and
+    // overwrite the timestamps iff they are the same, else ... refuse to break security
 
-                        if(current_key != NULL)
-                        {
-                            if(dnssec_key_equals(current_key, key))
-                            {
+    if(current_key != NULL)
+    {
+        if(dnssec_key_equals(current_key, key))
+        {
 #ifdef DEBUG
-                                log_debug1("dnssec_keystore_reload_readdir_callback: file '%s' has already been loaded", file);
+            log_debug1("dnssec_keystore_reload_readdir_callback: file '%s' has already been loaded", file);
 #endif
 
-                                current_key->epoch_created = key->epoch_created;
-                                current_key->epoch_publish = key->epoch_publish;
-                                current_key->epoch_activate = key->epoch_activate;
-
-                                current_key->epoch_inactive = key->epoch_inactive;
-                                current_key->epoch_delete = key->epoch_delete;
-                                current_key->timestamp = key->timestamp;
-                            }
-                            else
-                            {
-                                // update
-                                
+            current_key->epoch_created = key->epoch_created;
+            current_key->epoch_publish = key->epoch_publish;
+            current_key->epoch_activate = key->epoch_activate;
+
+            current_key->epoch_inactive = key->epoch_inactive;
+            current_key->epoch_delete = key->epoch_delete;
+            current_key->timestamp = key->timestamp;
+        }
+        else
+        {
+            // update
+
 #ifdef DEBUG
-                                log_debug1("dnssec_keystore_reload_readdir_callback: file '%s' updated a key", file);
+            log_debug1("dnssec_keystore_reload_readdir_callback: file '%s' updated a key", file);
 #endif
 
-                                current_key->epoch_created = key->epoch_created;
-                                current_key->epoch_publish = key->epoch_publish;
-                                current_key->epoch_activate = key->epoch_activate;
+            current_key->epoch_created = key->epoch_created;
+            current_key->epoch_publish = key->epoch_publish;
+            current_key->epoch_activate = key->epoch_activate;
 
-                                current_key->epoch_inactive = key->epoch_inactive;
-                                current_key->epoch_delete = key->epoch_delete;
-                                current_key->timestamp = key->timestamp;
+            current_key->epoch_inactive = key->epoch_inactive;
+            current_key->epoch_delete = key->epoch_delete;
+            current_key->timestamp = key->timestamp;
 
-                                // update key re-signature scheduling
+            // update key re-signature scheduling
 
-                            }
+        }
+
+        dnskey_release(current_key);
+    }
+    else
+    {
+        // add the new key
 
-                            dnskey_release(current_key);
-                        }
-                        else
-                        {
-                            // add the new key
-                            
 #ifdef DEBUG
-                            log_debug1("dnssec_keystore_reload_readdir_callback: file '%s' generated a new key", file);
+        log_debug1("dnssec_keystore_reload_readdir_callback: file '%s' generated a new key", file);
 #endif
 
-                            dnssec_keystore_add_key_nolock(ks, key); // RC
+        dnssec_keystore_add_key_nolock(ks, key); // RC
 
-                            // also : the key should be put in the zone and signature should be scheduled
-                            /// @todo 20160209 edf -- this has to be done when policies are in
-                        }
-                        
-                        dnskey_release(key);
+        // also : the key should be put in the zone and signature should be scheduled
+        /// @todo 20160209 edf -- this has to be done when policies are in
+    }
 #ifdef DEBUG
-                        log_debug1("dnssec_keystore_reload_readdir_callback: file '%s' successfully read", file);
+    log_debug1("dnssec_keystore_reload_readdir_callback: file '%s' successfully read", file);
 #endif
-                    }
-                    else
-                    {
-                        log_err("could not read '%s': %r (missing public .key file ?)", file, ret);
-                    }
-                }
-                else
-                {
-                    log_err("could not access '%s': %r", file, ERRNO_ERROR);
-                }
-            } // else this is not a private key file
-        }
-        else
-        {
-            log_debug("ignoring key file %s (%s != %s)", filename, domain, args->domain);
-        }            
+}
+
+/**
+ * Reads the collected files then merges them in the keystore.
+ * The keystore must not be locked.
+ */
+
+static void
+dnssec_keystore_reload_files(dnssec_keystore *ks, ptr_vector *files)
+{
+    if(ptr_vector_size(files) == 0)
+    {
+        return;
     }
-    else
+    
+    dnssec_keystore_reload_read_files(files);
+    
+    group_mutex_write_lock(&ks->lock);
+    
+    for(s32 i = 0; i <= ptr_vector_last_index(files); ++i)
     {
-        log_debug("ignoring file %s", filename);
+        dnssec_keystore_reload_merge_nolock(ks, (dnssec_keystore_reload_file_s*)ptr_vector_get(files, i));
     }
     
-    return SUCCESS; // invalid file name, but it's irrelevant for this
+    group_mutex_write_unlock(&ks->lock);
+    
+    for(s32 i = 0; i <= ptr_vector_last_index(files); ++i)
+    {
+        dnssec_keystore_reload_file_s *item = (dnssec_keystore_reload_file_s*)ptr_vector_get(files, i);
+        
+        if(item->key != NULL)
+        {
+            dnskey_release(item->key);
+        }
+        
+        free(item->file);
+        free(item);
+    }
+    
+    ptr_vector_clear(files);
 }
 
 /**
@@ -1215,9 +1444,9 @@ dnssec_keystore_reload()
     dnssec_keystore *ks = &g_keystore;
     ya_result ret = SUCCESS;
     
-    dnssec_keystore_reload_readdir_callback_s args = {ks, NULL};
+    dnssec_keystore_reload_readdir_callback_s args = {ks, NULL, EMPTY_PTR_VECTOR};
     
-    mutex_lock(&ks->lock);
+    group_mutex_read_lock(&ks->lock);
     
     ptr_set_avl_iterator iter;
     ptr_set_avl_iterator_init(&ks->paths, &iter);
@@ -1236,7 +1465,13 @@ dnssec_keystore_reload()
         log_err("dnssec keystore reload: an error occurred reading key directory '%s': %r", g_keystore_path, ret);
     }
     
-    mutex_unlock(&ks->lock);
+    group_mutex_read_unlock(&ks->lock);
+    
+    log_debug("dnssec keystore reload: %i key files to read", ptr_vector_size(&args.files));
+    
+    dnssec_keystore_reload_files(ks, &args.files);
+    
+    ptr_vector_destroy(&args.files);
 
     return ret;
 }
@@ -1262,8 +1497,13 @@ dnssec_keystore_reload_domain(const u8 *fqdn)
     
     dnssec_keystore *ks = &g_keystore;
     ya_result ret = SUCCESS;
+    char domain[MAX_DOMAIN_LENGTH];
+    
+    dnsname_to_cstr(domain, fqdn);
+    
+    dnssec_keystore_reload_readdir_callback_s args = {ks, domain, EMPTY_PTR_VECTOR};
     
-    mutex_lock(&ks->lock);
+    group_mutex_read_lock(&ks->lock);
     
     dnssec_keystore_domain_s *keystore_domain = dnssec_keystore_get_domain_nolock(ks, fqdn);
     
@@ -1271,12 +1511,6 @@ dnssec_keystore_reload_domain(const u8 *fqdn)
             
     if(keystore_domain != NULL)
     {
-        char domain[MAX_DOMAIN_LENGTH];
-        
-        dnsname_to_cstr(domain, fqdn);
-        
-        dnssec_keystore_reload_readdir_callback_s args = {ks, domain};
-        
         const char *path = keystore_domain->keys_path;
         if(path == NULL)
         {
@@ -1289,7 +1523,11 @@ dnssec_keystore_reload_domain(const u8 *fqdn)
         }
     }
     
-    mutex_unlock(&ks->lock);
+    group_mutex_read_unlock(&ks->lock);
+    
+    dnssec_keystore_reload_files(ks, &args.files);
+    
+    ptr_vector_destroy(&args.files);
 
     return ret;
 }
@@ -1364,6 +1602,8 @@ dnssec_keystore_setpath(const char* path)
 void
 dnssec_keystore_destroy()
 {
+    dnssec_keystore_reload_thread_pool_finalize();
+    
     /*
     pthread_mutex_lock(&keystore_mutex);
 
@@ -1766,7 +2006,7 @@ dnssec_keystore_acquire_key(const u8 *domain, int index)
 {
     dnssec_key *ret = NULL;
     dnssec_keystore *ks = &g_keystore;
-    mutex_lock(&ks->lock);
+    group_mutex_read_lock(&ks->lock);
     dnssec_keystore_domain_s *ks_domain = dnssec_keystore_get_domain_nolock(ks, domain);
     if(ks_domain != NULL)
     {
@@ -1781,7 +2021,7 @@ dnssec_keystore_acquire_key(const u8 *domain, int index)
             dnskey_acquire(ret);
         }
     }
-    mutex_unlock(&ks->lock);
+    group_mutex_read_unlock(&ks->lock);
     return ret;
 }
 
@@ -1798,7 +2038,7 @@ dnssec_keystore_add_valid_keys_from_fqdn(const u8 *fqdn, time_t at_time, struct
 {
     dnssec_keystore *ks = &g_keystore;
     u32 count = 0;
-    mutex_lock(&ks->lock);
+    group_mutex_read_lock(&ks->lock);
     dnssec_keystore_domain_s *ks_domain = dnssec_keystore_get_domain_nolock(ks, fqdn);
     if(ks_domain != NULL)
     {
@@ -1819,7 +2059,7 @@ dnssec_keystore_add_valid_keys_from_fqdn(const u8 *fqdn, time_t at_time, struct
             key = key->next;
         }
     }
-    mutex_unlock(&ks->lock);
+    group_mutex_read_unlock(&ks->lock);
     return count;
 }
 
@@ -57,6 +57,7 @@
 
 #include <dnscore/base32hex.h>
 #include <dnscore/format.h>
+#include <dnscore/timems.h>
 #include <dnscore/bytearray_output_stream.h>
 #include <dnscore/bytearray_input_stream.h>
 
@@ -64,6 +65,7 @@
 #include "dnsdb/zdb_zone.h"
 #include "dnsdb/dnssec-keystore.h"
 #include "dnsdb/zdb_utils.h"
+#include "dnsdb/zdb_zone_label_iterator.h"
 
 #include "dnsdb/dynupdate-diff.h"
 
@@ -80,6 +82,8 @@ extern logger_handle *g_database_logger;
 #define ZDFFFQDN_TAG 0x4e4451464646445a
 #define ZDFFRRST_TAG 0x545352524646445a
 #define DMSGPCKT_TAG 0x544b435047534d44
+#define ZDFFSIGN_TAG 0x4e4749534646445a
+#define ZDFFRLRR_TAG 0x52524c524646445a
 
 #define DYNUPDATE_DIFF_DETAILLED_LOG 1
 
@@ -1510,17 +1514,17 @@ zone_diff_add_fqdn(zone_diff *diff, const u8 *fqdn, zdb_rr_label *label)
             diff_fqdn->was_at_delegation = diff_fqdn->at_delegation;
             diff_fqdn->was_under_delegation = diff_fqdn->under_delegation;
             diff_fqdn->had_ds = diff_fqdn->will_have_ds;
-            diff_fqdn->was_non_empty = btree_notempty(label->resource_record_set);
+            diff_fqdn->was_non_empty = zdb_rr_collection_notempty(label->resource_record_set);
             diff_fqdn->had_children = dictionary_notempty(&label->sub);
             //diff_fqdn->will_be_non_empty = diff_fqdn->was_non_empty;
             diff_fqdn->will_have_children = diff_fqdn->is_apex;
             
-            btree_iterator iter;
-            btree_iterator_init(label->resource_record_set, &iter);
+            zdb_rr_collection_iterator iter;
+            zdb_rr_collection_iterator_init(label->resource_record_set, &iter);
 
-            while(btree_iterator_hasnext(&iter))
+            while(zdb_rr_collection_iterator_hasnext(&iter))
             {
-                btree_node *rr_node = btree_iterator_next_node(&iter);
+                zdb_rr_collection_node *rr_node = zdb_rr_collection_iterator_next_node(&iter);
                 u16 type = (u16)rr_node->hash;
                 
 #ifdef DEBUG
@@ -2948,6 +2952,18 @@ zone_diff_log(const zone_diff *diff)
     }
 }
 
+/**
+ * An RRset to sign, its records in canonical order and the state to give to its signatures.
+ */
+
+struct zone_diff_sign_rrset
+{
+    ptr_vector rrset;
+    resource_record_view view;
+    zone_diff_fqdn_rr_set *rr_set;
+    u8 rrsig_state_mask;
+};
+
 /**
  * Appends RRSIGs to remove/add vector, following the the need-to-be-signed RR set, using keys from KSK and ZSK vectors.
  * 
@@ -2968,10 +2984,10 @@ zone_diff_sign(zone_diff *diff, zdb_zone *zone, ptr_vector* rrset_to_sign_vector
     
     /*
      * for each rrset in rrset_to_sign
-     *   for each valid zsk in the keyring
-     *     start new signature
-     *     add each record
-     *     generate signature
+     *   gather the records and put them in canonical order
+     * for each valid key in the keyring
+     *   prepare a signer
+     *   sign all the rrsets the key covers in one batch
      */
     
     log_debug("update: %{dnsname}: signing differences", diff->origin);
@@ -2980,23 +2996,31 @@ zone_diff_sign(zone_diff *diff, zdb_zone *zone, ptr_vector* rrset_to_sign_vector
     logger_flush();
 #endif
     
-    // if there is a chain, proceed with the changes
+    s32 rrset_count = ptr_vector_size(rrset_to_sign_vector);
     
-    ptr_vector rrset = EMPTY_PTR_VECTOR;
-    dnskey_signature ds;
-    dnskey_signature_init(&ds);
+    if(rrset_count == 0)
+    {
+        return;
+    }
     
-    struct resource_record_view rrv = {NULL, &zone_diff_label_rr_rrv_vtbl};
+    struct zone_diff_sign_rrset *rrsets;
+    dnskey_signature_batch_item *items;
+    s32 *item_rrset_index;
+    MALLOC_OR_DIE(struct zone_diff_sign_rrset*, rrsets, sizeof(struct zone_diff_sign_rrset) * rrset_count, ZDFFSIGN_TAG);
+    MALLOC_OR_DIE(dnskey_signature_batch_item*, items, sizeof(dnskey_signature_batch_item) * rrset_count, ZDFFSIGN_TAG);
+    MALLOC_OR_DIE(s32*, item_rrset_index, sizeof(s32) * rrset_count, ZDFFSIGN_TAG);
     
-    for(int i = 0; i <= ptr_vector_last_index(rrset_to_sign_vector); ++i)
+    for(int i = 0; i < rrset_count; ++i)
     {
         zone_diff_fqdn_rr_set *rr_set = (zone_diff_fqdn_rr_set*)ptr_vector_get(rrset_to_sign_vector, i);
+        struct zone_diff_sign_rrset *sign_rrset = &rrsets[i];
         
         log_debug("update: %{dnsname}: signing (trying) %{dnstype} rrset @%p", diff->origin, &rr_set->rtype, rr_set);
 
-        rrv.data = rr_set;
-        
-        ptr_vector_clear(&rrset);
+        sign_rrset->rr_set = rr_set;
+        sign_rrset->view.data = rr_set;
+        sign_rrset->view.vtbl = &zone_diff_label_rr_rrv_vtbl;
+        ptr_vector_init_empty(&sign_rrset->rrset);
         
         u8 rrsig_state_mask = ZONE_DIFF_AUTOMATED;
         
@@ -3018,7 +3042,7 @@ zone_diff_sign(zone_diff *diff, zdb_zone *zone, ptr_vector* rrset_to_sign_vector
 #endif                
                 rrsig_state_mask &= rr->state;
                 
-                ptr_vector_append(&rrset, value);
+                ptr_vector_append(&sign_rrset->rrset, value);
             }
             else
             {
@@ -3030,85 +3054,134 @@ zone_diff_sign(zone_diff *diff, zdb_zone *zone, ptr_vector* rrset_to_sign_vector
             }
         }
         
-        rrsig_state_mask |= ZONE_DIFF_ADD;
-                
-        // for all keys
+        sign_rrset->rrsig_state_mask = rrsig_state_mask | ZONE_DIFF_ADD;
         
-        bool canonize = TRUE;
-
-        ptr_vector *keys;
+        // the canonical order does not depend on the key
+        
+        dnskey_signature_canonize(&sign_rrset->rrset, &sign_rrset->view);
+    }
+    
+    // for all keys, ZSKs sign everything but the DNSKEY rrset, KSKs only sign the DNSKEY rrset
+    
+    time_t now = time(NULL);
+    u64 start = timeus();
+    s32 signature_count = 0;
+    
+    for(int k = 0; k < 2; ++k)
+    {
+        ptr_vector *keys = (k == 0)?zsks:ksks;
         
-        if(rr_set->rtype != TYPE_DNSKEY)
-        {
-            keys = zsks;
-        }
-        else
-        {
-            keys = ksks;
-        }
         for(int j = 0; j <= ptr_vector_last_index(keys); ++j)
         {
             const dnssec_key *key = (dnssec_key*)ptr_vector_get(keys, j);
-            
+
             if(!dnssec_key_is_private(key))
             {
                 log_debug("update: %{dnsname}: key %03i %05i is not private", diff->origin,
-                        dnssec_key_get_domain(key), dnssec_key_get_algorithm(key), dnssec_key_get_tag_const(key));
+                        dnssec_key_get_algorithm(key), dnssec_key_get_tag_const(key));
                 continue;
             }
             
-            zone_diff_label_rr *rrsig_rr = NULL;
-            
-            ya_result ret;
+            s32 item_count = 0;
             
-            // rrset_to_sign;
-            if(ISOK(ret = dnskey_signature_rrset_sign_with_key(key, &rrset, canonize, &rrv, (void**)&rrsig_rr)))
+            for(int i = 0; i < rrset_count; ++i)
             {
-                canonize = FALSE;
-
-                // add the key to the add set
+                struct zone_diff_sign_rrset *sign_rrset = &rrsets[i];
                 
-                log_debug("update: %{dnsname}: signed %{dnsname} %{dnstype} rrset with key %03i %05i",diff->origin,
-                        rrsig_rr->fqdn, &rr_set->rtype,
-                        dnssec_key_get_algorithm(key), dnssec_key_get_tag_const(key));
-                
-                u32 valid_until = rrsig_get_valid_until_from_rdata(rrsig_rr->rdata, rrsig_rr->rdata_size);
-                
-                if(zone->progressive_signature_update.earliest_signature_expiration > valid_until)
+                if((sign_rrset->rr_set->rtype == TYPE_DNSKEY) == (k == 0))
                 {
-                    zone->progressive_signature_update.earliest_signature_expiration = valid_until;
+                    continue;
                 }
                 
-                rrsig_rr->state |= rrsig_state_mask;
-                
-                zone_diff_fqdn *rrsig_label = zone_diff_add_fqdn(diff, rrsig_rr->fqdn, NULL);
-                
-                yassert(rrsig_label != NULL);
-                
-                zone_diff_fqdn_rr_set *rrsig_label_rrset = zone_diff_fqdn_rr_set_get(rrsig_label, TYPE_RRSIG);
-                
-                yassert(rrsig_label_rrset != NULL);
-                
-                rrsig_rr = zone_diff_fqdn_rr_set_add(rrsig_label_rrset, rrsig_rr); /// @note not VOLATILE
-                
-                ptr_vector_append(add, rrsig_rr);
-                //(void)rrsig_rr_set;
+                item_rrset_index[item_count] = i;
+                dnskey_signature_batch_item *item = &items[item_count++];
+                item->rrset = &sign_rrset->rrset;
+                item->view = sign_rrset->view;
             }
-            else
+            
+            if(item_count == 0)
             {
-                log_warn("update: %{dnsname}: failed to sign with key %03i %05i",
+                continue;
+            }
+            
+            dnskey_signer signer;
+            ya_result ret;
+            
+            if(FAIL(ret = dnskey_signer_init(&signer, key, now - 3600, dnskey_get_inactive_epoch(key))))
+            {
+                log_warn("update: %{dnsname}: failed to sign with key %03i %05i: %r",
                         diff->origin,
-                        dnssec_key_get_algorithm(key), dnssec_key_get_tag_const(key));
-                // ...
+                        dnssec_key_get_algorithm(key), dnssec_key_get_tag_const(key), ret);
+                continue;
+            }
+            
+            signature_count += dnskey_signer_sign_batch(&signer, items, item_count);
+            
+            dnskey_signer_finalise(&signer);
+            
+            for(int i = 0; i < item_count; ++i)
+            {
+                dnskey_signature_batch_item *item = &items[i];
+                struct zone_diff_sign_rrset *sign_rrset = &rrsets[item_rrset_index[i]];
+                zone_diff_fqdn_rr_set *rr_set = sign_rrset->rr_set;
+                zone_diff_label_rr *rrsig_rr = (zone_diff_label_rr*)item->rrsig_rr;
+                
+                if(rrsig_rr != NULL)
+                {
+                    // add the key to the add set
+
+                    log_debug("update: %{dnsname}: signed %{dnsname} %{dnstype} rrset with key %03i %05i",diff->origin,
+                            rrsig_rr->fqdn, &rr_set->rtype,
+                            dnssec_key_get_algorithm(key), dnssec_key_get_tag_const(key));
+
+                    u32 valid_until = rrsig_get_valid_until_from_rdata(rrsig_rr->rdata, rrsig_rr->rdata_size);
+
+                    if(zone->progressive_signature_update.earliest_signature_expiration > valid_until)
+                    {
+                        zone->progressive_signature_update.earliest_signature_expiration = valid_until;
+                    }
+
+                    rrsig_rr->state |= sign_rrset->rrsig_state_mask;
+
+                    zone_diff_fqdn *rrsig_label = zone_diff_add_fqdn(diff, rrsig_rr->fqdn, NULL);
+
+                    yassert(rrsig_label != NULL);
+
+                    zone_diff_fqdn_rr_set *rrsig_label_rrset = zone_diff_fqdn_rr_set_get(rrsig_label, TYPE_RRSIG);
+
+                    yassert(rrsig_label_rrset != NULL);
+
+                    rrsig_rr = zone_diff_fqdn_rr_set_add(rrsig_label_rrset, rrsig_rr); /// @note not VOLATILE
+
+                    ptr_vector_append(add, rrsig_rr);
+                }
+                else
+                {
+                    log_warn("update: %{dnsname}: failed to sign %{dnstype} rrset with key %03i %05i: %r",
+                            diff->origin, &rr_set->rtype,
+                            dnssec_key_get_algorithm(key), dnssec_key_get_tag_const(key), item->ret);
+                }
             }
         }
     }
     
-    dnskey_signature_finalise(&ds);
-    ptr_vector_destroy(&rrset);
+    if(signature_count > 0)
+    {
+        u64 elapsed = MAX(timeus() - start, 1);
+        log_debug("update: %{dnsname}: %i signatures generated in %lluus (%llu/s)", diff->origin,
+                signature_count, elapsed, (1000000ULL * signature_count) / elapsed);
+    }
+    
+    for(int i = 0; i < rrset_count; ++i)
+    {
+        ptr_vector_destroy(&rrsets[i].rrset);
+    }
+    
+    free(item_rrset_index);
+    free(items);
+    free(rrsets);
 }
 
-
 static ya_result
 zone_diff_store_diff(zone_diff *diff, zdb_zone *zone, ptr_vector *remove, ptr_vector *add)
 {
@@ -4131,6 +4204,478 @@ dynupdate_diff(zdb_zone *zone, packet_unpack_reader_data *reader, u16 count, u8
     return ret;
 }
 
+/**
+ * A record of the zone file or of the zone for the reload diff.
+ * The records of the zone share the name of their label and point to the
+ * rdata in the zone.  The records of the file hold their name and rdata.
+ */
+
+struct dynupdate_diff_reload_rr
+{
+    const u8 *fqdn;
+    const u8 *rdata;
+    s32 ttl;
+    u16 rtype;
+    u16 rdata_size;
+    u8 data[];
+};
+
+typedef struct dynupdate_diff_reload_rr dynupdate_diff_reload_rr;
+
+static int
+dynupdate_diff_reload_rr_compare(const void *a_, const void *b_)
+{
+    const dynupdate_diff_reload_rr *a = *(const dynupdate_diff_reload_rr**)a_;
+    const dynupdate_diff_reload_rr *b = *(const dynupdate_diff_reload_rr**)b_;
+    int d;
+    
+    if(a->fqdn != b->fqdn)
+    {
+        if((d = dnsname_compare(a->fqdn, b->fqdn)) != 0)
+        {
+            return d;
+        }
+    }
+    
+    d = ntohs(a->rtype);
+    d -= ntohs(b->rtype);
+    
+    if(d == 0)
+    {
+        d = memcmp(a->rdata, b->rdata, MIN(a->rdata_size, b->rdata_size));
+        
+        if(d == 0)
+        {
+            d = a->rdata_size;
+            d -= b->rdata_size;
+        }
+    }
+    
+    return d;
+}
+
+/**
+ * The types generated by the maintenance of a DNSSEC zone.
+ */
+
+static inline bool
+dynupdate_diff_reload_type_is_maintained(u16 rtype)
+{
+    return (rtype == TYPE_RRSIG) || (rtype == TYPE_NSEC) || (rtype == TYPE_NSEC3);
+}
+
+/**
+ * The types a reload does not compare.  On a maintained zone, the signatures
+ * and chains are generated and the DNSKEY and CDS records are published from
+ * the key store by the policies: the file does not have the last word on them.
+ */
+
+static inline bool
+dynupdate_diff_reload_type_is_ignored(u16 rtype, bool maintained)
+{
+    return maintained && (dynupdate_diff_reload_type_is_maintained(rtype) || (rtype == TYPE_DNSKEY) || (rtype == TYPE_CDS));
+}
+
+/**
+ * Reads all the records of a zone reader.  The SOA is returned apart.
+ * The ignored types are skipped.
+ */
+
+static ya_result
+dynupdate_diff_reload_read(const zdb_zone *zone, zone_reader *zr, bool maintained, ptr_vector *records, dynupdate_diff_reload_rr **soap)
+{
+    resource_record entry;
+    ya_result ret;
+    
+    resource_record_init(&entry);
+    
+    while((ret = zone_reader_read_record(zr, &entry)) == OK)
+    {
+        if(entry.class != CLASS_IN)
+        {
+            ret = ZDB_ERROR_NOSUCHCLASS;
+            break;
+        }
+        
+        dnsname_locase_verify_charspace(entry.name);
+        
+        if(!dnsname_is_subdomain(entry.name, zone->origin))
+        {
+            ret = ZDB_READER_WRONGNAMEFORZONE;
+            break;
+        }
+        
+        if(!dynupdate_diff_reload_type_is_ignored(entry.type, maintained))
+        {
+            u32 fqdn_len = dnsname_len(entry.name);
+            dynupdate_diff_reload_rr *rr;
+            MALLOC_OR_DIE(dynupdate_diff_reload_rr*, rr, sizeof(dynupdate_diff_reload_rr) + fqdn_len + entry.rdata_size, ZDFFRLRR_TAG);
+            memcpy(rr->data, entry.name, fqdn_len);
+            memcpy(&rr->data[fqdn_len], entry.rdata, entry.rdata_size);
+            rr->fqdn = rr->data;
+            rr->rdata = &rr->data[fqdn_len];
+            rr->ttl = entry.ttl;
+            rr->rtype = entry.type;
+            rr->rdata_size = entry.rdata_size;
+            
+            if(entry.type != TYPE_SOA)
+            {
+                ptr_vector_append(records, rr);
+            }
+            else if((*soap == NULL) && dnsname_equals(entry.name, zone->origin))
+            {
+                *soap = rr;
+            }
+            else
+            {
+                free(rr);
+                ret = ZDB_READER_ANOTHER_DOMAIN_WAS_EXPECTED;
+                break;
+            }
+        }
+        
+        resource_record_resetcontent(&entry);
+    }
+    
+    resource_record_freecontent(&entry);
+    
+    if(ISOK(ret) && (*soap == NULL))
+    {
+        ret = ZDB_READER_FIRST_RECORD_NOT_SOA;
+    }
+    
+    return ret;
+}
+
+/**
+ * Gathers all the records of the zone but the SOA.
+ * The ignored types are skipped.
+ * 
+ * The zone must be locked.
+ */
+
+static void
+dynupdate_diff_reload_collect(const zdb_zone *zone, bool maintained, ptr_vector *records, ptr_vector *names)
+{
+    zdb_zone_label_iterator iter;
+    u8 fqdn[MAX_DOMAIN_LENGTH];
+    
+    zdb_zone_label_iterator_init(&iter, zone);
+    
+    while(zdb_zone_label_iterator_hasnext(&iter))
+    {
+        zdb_zone_label_iterator_nextname(&iter, fqdn);
+        zdb_rr_label *label = zdb_zone_label_iterator_next(&iter);
+        u8 *label_fqdn = NULL;
+        
+        zdb_rr_collection_iterator rr_iter;
+        zdb_rr_collection_iterator_init(label->resource_record_set, &rr_iter);
+        
+        while(zdb_rr_collection_iterator_hasnext(&rr_iter))
+        {
+            zdb_rr_collection_node *rr_node = zdb_rr_collection_iterator_next_node(&rr_iter);
+            u16 rtype = (u16)rr_node->hash;
+            
+            if((rtype == TYPE_SOA) || dynupdate_diff_reload_type_is_ignored(rtype, maintained))
+            {
+                continue;
+            }
+            
+            if(label_fqdn == NULL)
+            {
+                u32 fqdn_len = dnsname_len(fqdn);
+                MALLOC_OR_DIE(u8*, label_fqdn, fqdn_len, ZDFFRLRR_TAG);
+                memcpy(label_fqdn, fqdn, fqdn_len);
+                ptr_vector_append(names, label_fqdn);
+            }
+            
+            for(zdb_packed_ttlrdata *rr_sll = (zdb_packed_ttlrdata*)rr_node->data; rr_sll != NULL; rr_sll = rr_sll->next)
+            {
+                dynupdate_diff_reload_rr *rr;
+                MALLOC_OR_DIE(dynupdate_diff_reload_rr*, rr, sizeof(dynupdate_diff_reload_rr), ZDFFRLRR_TAG);
+                rr->fqdn = label_fqdn;
+                rr->rdata = ZDB_PACKEDRECORD_PTR_RDATAPTR(rr_sll);
+                rr->ttl = rr_sll->ttl;
+                rr->rtype = rtype;
+                rr->rdata_size = ZDB_PACKEDRECORD_PTR_RDATASIZE(rr_sll);
+                ptr_vector_append(records, rr);
+            }
+        }
+    }
+}
+
+/**
+ * Merges the sorted records of the file with the sorted records of the zone
+ * into the diff: what is only in the zone is removed, what is only in the file
+ * is added.
+ * 
+ * The zone must be locked.
+ * 
+ * @return the number of records changed or an error code
+ */
+
+static ya_result
+dynupdate_diff_reload_merge(zone_diff *diff, zdb_zone *zone, ptr_vector *file_records, ptr_vector *zone_records)
+{
+    dnsname_vector origin_path;
+    dnsname_vector name_path;
+    const u8 *label_fqdn = NULL;
+    zdb_rr_label *rr_label = NULL;
+    s32 file_index = 0;
+    s32 zone_index = 0;
+    s32 file_count = ptr_vector_size(file_records);
+    s32 zone_count = ptr_vector_size(zone_records);
+    s32 changes = 0;
+    
+    dnsname_to_dnsname_vector(zone->origin, &origin_path);
+    
+    while((file_index < file_count) || (zone_index < zone_count))
+    {
+        dynupdate_diff_reload_rr **file_rrp = NULL;
+        dynupdate_diff_reload_rr **zone_rrp = NULL;
+        dynupdate_diff_reload_rr *rr;
+        int d;
+        
+        if(file_index < file_count)
+        {
+            file_rrp = (dynupdate_diff_reload_rr**)&file_records->data[file_index];
+            
+            // the file may repeat a record
+            
+            if((file_index + 1 < file_count) && (dynupdate_diff_reload_rr_compare(file_rrp, file_rrp + 1) == 0))
+            {
+                ++file_index;
+                continue;
+            }
+        }
+        
+        if(zone_index < zone_count)
+        {
+            zone_rrp = (dynupdate_diff_reload_rr**)&zone_records->data[zone_index];
+        }
+        
+        if(file_rrp == NULL)
+        {
+            d = 1;
+        }
+        else if(zone_rrp == NULL)
+        {
+            d = -1;
+        }
+        else
+        {
+            d = dynupdate_diff_reload_rr_compare(file_rrp, zone_rrp);
+        }
+        
+        if(d == 0)
+        {
+            ++file_index;
+            ++zone_index;
+            
+            if((*file_rrp)->ttl != (*zone_rrp)->ttl)
+            {
+                // the diff sees a record with the same rdata as the same record
+                
+                log_info("reload: %{dnsname}: %{dnsname} %{dnstype}: TTL changed", zone->origin, (*file_rrp)->fqdn, &(*file_rrp)->rtype);
+                
+                return FEATURE_NOT_SUPPORTED;
+            }
+            
+            continue;
+        }
+        
+        if(d < 0)
+        {
+            rr = *file_rrp;
+            ++file_index;
+        }
+        else
+        {
+            rr = *zone_rrp;
+            ++zone_index;
+        }
+        
+        if(dynupdate_diff_reload_type_is_maintained(rr->rtype) || (rr->rtype == TYPE_NSEC3PARAM))
+        {
+            // the chains are not edited through a reload
+            
+            log_info("reload: %{dnsname}: %{dnsname} %{dnstype}: DNSSEC chain changed", zone->origin, rr->fqdn, &rr->rtype);
+            
+            return FEATURE_NOT_SUPPORTED;
+        }
+        
+        if((label_fqdn == NULL) || ((rr->fqdn != label_fqdn) && !dnsname_equals(rr->fqdn, label_fqdn)))
+        {
+            label_fqdn = rr->fqdn;
+            dnsname_to_dnsname_vector(label_fqdn, &name_path);
+            rr_label = zdb_rr_label_find_exact(zone->apex, name_path.labels, (name_path.size - origin_path.size) - 1);
+        }
+        
+        if((rr->rtype == TYPE_NS) && (rr_label != NULL) && (rr_label != zone->apex))
+        {
+            // some records below may become glues (or stop being glues)
+            
+            if(dictionary_notempty(&rr_label->sub))
+            {
+                zone_diff_add_fqdn_children(diff, label_fqdn, rr_label);
+            }
+        }
+        
+        if(d < 0)
+        {
+            zone_diff_record_add(diff, rr_label, rr->fqdn, rr->rtype, rr->ttl, rr->rdata_size, (void*)rr->rdata);
+        }
+        else
+        {
+            zone_diff_record_remove(diff, rr_label, rr->fqdn, rr->rtype, rr->ttl, rr->rdata_size, (void*)rr->rdata);
+        }
+        
+        ++changes;
+    }
+    
+    return changes;
+}
+
+/**
+ * Applies the content of a zone reader to a zone, as an incremental update.
+ * 
+ * The records are read first, without locking the zone.  The zone is then
+ * double-locked, its records are compared with the ones read, and the
+ * difference is stored in the journal and replayed like a dynamic update,
+ * signatures and chains included.
+ * 
+ * The SOA of the reader must have a serial higher than the one of the zone.
+ * On a maintained zone, RRSIG, NSEC, NSEC3, DNSKEY and CDS records are ignored.
+ * Changes that cannot be expressed as a diff (TTL changes, DNSSEC chain
+ * changes) are refused with FEATURE_NOT_SUPPORTED: the zone is then left as it
+ * was and has to be loaded the usual way.
+ * 
+ * @param zone the zone, acquired but not locked
+ * @param zr the zone reader, positioned on the SOA
+ * @param secondary_lock the secondary owner of the lock of the zone
+ * 
+ * @return the number of records changed or an error code
+ */
+
+ya_result
+dynupdate_diff_from_zone_reader(zdb_zone *zone, zone_reader *zr, u8 secondary_lock)
+{
+    ptr_vector file_records = EMPTY_PTR_VECTOR;
+    ptr_vector zone_records = EMPTY_PTR_VECTOR;
+    ptr_vector names = EMPTY_PTR_VECTOR;
+    dynupdate_diff_reload_rr *file_soa = NULL;
+    ya_result ret;
+    
+    u64 read_begin = timeus();
+    
+    bool maintained = zdb_zone_is_maintained(zone);
+    
+    if(FAIL(ret = dynupdate_diff_reload_read(zone, zr, maintained, &file_records, &file_soa)))
+    {
+        log_err("reload: %{dnsname}: could not read the records: %r", zone->origin, ret);
+        
+        ptr_vector_free_empties(&file_records, free);
+        ptr_vector_destroy(&file_records);
+        free(file_soa);
+        
+        return ret;
+    }
+    
+    ptr_vector_qsort(&file_records, dynupdate_diff_reload_rr_compare);
+    
+    u64 diff_begin = timeus();
+    
+    zdb_zone_double_lock(zone, ZDB_ZONE_MUTEX_SIMPLEREADER, secondary_lock);
+    
+    zdb_packed_ttlrdata *soa = NULL;
+    
+    if(ZDB_ZONE_INVALID(zone))
+    {
+        ret = ZDB_ERROR_ZONE_INVALID;
+    }
+    else if((soa = zdb_record_find(&zone->apex->resource_record_set, TYPE_SOA)) == NULL)
+    {
+        ret = ZDB_ERROR_NOSOAATAPEX;
+    }
+    else
+    {
+        ret = SUCCESS;
+    }
+    
+    if(ISOK(ret))
+    {
+        dynupdate_diff_reload_collect(zone, maintained, &zone_records, &names);
+        
+        ptr_vector_qsort(&zone_records, dynupdate_diff_reload_rr_compare);
+        
+#if ZDB_HAS_DNSSEC_SUPPORT
+        if(maintained)
+        {
+            dynupdate_diff_load_private_keys(zone);
+        }
+#endif
+        
+        zone_diff diff;
+        zone_diff_init(&diff, zone->origin, zone->min_ttl, zdb_zone_get_rrsig_push_allowed(zone));
+        
+        zone_diff_record_remove_automated(&diff, zone->apex, zone->origin, TYPE_SOA, soa->ttl, ZDB_PACKEDRECORD_PTR_RDATASIZE(soa), ZDB_PACKEDRECORD_PTR_RDATAPTR(soa));
+        zone_diff_record_add(&diff, zone->apex, zone->origin, TYPE_SOA, file_soa->ttl, file_soa->rdata_size, (void*)file_soa->rdata);
+        
+        s32 records_changed = 0;
+        
+        if(ISOK(ret = dynupdate_diff_reload_merge(&diff, zone, &file_records, &zone_records)))
+        {
+            ptr_vector add = EMPTY_PTR_VECTOR;
+            ptr_vector del = EMPTY_PTR_VECTOR;
+            
+            records_changed = ret;
+            
+            if(ISOK(ret = zone_diff_store_diff(&diff, zone, &del, &add)))
+            {
+                if(FAIL(ret = dynupdate_diff_write_to_journal_and_replay(zone, secondary_lock, &del, &add)))
+                {
+                    log_err("reload: %{dnsname}: could not apply the changes: %r", zone->origin, ret);
+                }
+            }
+            else
+            {
+                log_err("reload: %{dnsname}: could not compute the changes: %r", zone->origin, ret);
+                
+                zone_diff_label_rr_vector_clear(&del);
+                zone_diff_label_rr_vector_clear(&add);
+            }
+            
+            ptr_vector_destroy(&add);
+            ptr_vector_destroy(&del);
+        }
+        
+        zone_diff_finalise(&diff);
+        
+        if(ISOK(ret))
+        {
+            u64 end = timeus();
+            
+            log_info("reload: %{dnsname}: %i records read, %i in the zone, %i changed (read: %.3fs, diff and update: %.3fs)",
+                    zone->origin, ptr_vector_size(&file_records) + 1, ptr_vector_size(&zone_records) + 1, records_changed,
+                    (diff_begin - read_begin) / 1000000.0, (end - diff_begin) / 1000000.0);
+            
+            ret = records_changed;
+        }
+    }
+    
+    zdb_zone_double_unlock(zone, ZDB_ZONE_MUTEX_SIMPLEREADER, secondary_lock);
+    
+    ptr_vector_free_empties(&zone_records, free);
+    ptr_vector_destroy(&zone_records);
+    ptr_vector_free_empties(&names, free);
+    ptr_vector_destroy(&names);
+    ptr_vector_free_empties(&file_records, free);
+    ptr_vector_destroy(&file_records);
+    free(file_soa);
+    
+    return ret;
+}
+
 /**
  * Initialises a simple update buffer
  * 
@@ -50,6 +50,7 @@
 #include <stdio.h>
 #include <dnscore/sys_types.h>
 #include "dnsdb/htable.h"
+#include "dnsdb/zdb-zone-arena.h"
 
 /** @brief Allocates an hash table of the pre-defined size
  *
@@ -63,7 +64,7 @@ htable_alloc()
 {
     htable_entry *table;
 
-    MALLOC_OR_DIE(htable_entry*, table, sizeof(htable_entry) * DEFAULT_HTABLE_SIZE, HTABLE_TAG);
+    ZDB_ZONE_MALLOC_OR_DIE(htable_entry*, table, sizeof(htable_entry) * DEFAULT_HTABLE_SIZE, HTABLE_TAG);
 
     u32 i;
 
@@ -88,7 +89,7 @@ htable_free(htable_entry* table)
 {
     yassert(table != NULL);
 
-    free(table);
+    ZDB_ZONE_MFREE(table);
 }
 
 /** @} */
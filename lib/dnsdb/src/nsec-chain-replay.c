@@ -290,6 +290,15 @@ nsec_chain_replay_execute(chain_replay *cr)
 #ifdef DEBUG
             log_debug("nsec-chain: ~ %{dnsname}", nsec_chain_replay_record_fqdn(record));
 #endif
+            // the label may have been emptied then re-created by the update, detaching it from its node : link them again
+
+            s32 labels_top = dnsname_to_dnslabel_vector(record->fqdn, labels);
+
+            zdb_rr_label* label = zdb_rr_label_find_exact(crd->zone->apex, labels, labels_top - crd->zone->origin_vector.size - 1);
+            if((label != NULL) && (label->nsec.nsec.node == NULL))
+            {
+                nsec_update_label_node(crd->zone, label, labels, labels_top);
+            }
         }
     }
         
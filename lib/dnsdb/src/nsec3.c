@@ -1635,14 +1635,14 @@ nsec3_superdump(zdb_zone *zone)
                         zone->origin, serial, label_name, label,
                         label->flags, dictionary_size(&label->sub));
 
-                btree_iterator iter;
-                btree_iterator_init(label->resource_record_set, &iter);
+                zdb_rr_collection_iterator iter;
+                zdb_rr_collection_iterator_init(label->resource_record_set, &iter);
 
                 /* Sign only APEX and DS and NSEC records at delegation */
 
-                while(btree_iterator_hasnext(&iter))
+                while(zdb_rr_collection_iterator_hasnext(&iter))
                 {
-                    btree_node *rr_node = btree_iterator_next_node(&iter);
+                    zdb_rr_collection_node *rr_node = zdb_rr_collection_iterator_next_node(&iter);
                     u16 type = (u16)rr_node->hash;
                     zdb_packed_ttlrdata *record = (zdb_packed_ttlrdata*)rr_node->data;
 
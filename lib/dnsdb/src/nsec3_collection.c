@@ -60,6 +60,7 @@ extern logger_handle *g_dnssec_logger;
 
 #include <dnscore/dnscore.h>
 #include "dnsdb/nsec3_collection.h"
+#include "dnsdb/zdb-zone-arena.h"
 
 /*
  * The following macros are defining relevant fields in the node
@@ -113,7 +114,7 @@ extern logger_handle *g_dnssec_logger;
  */
 #define AVL_ALLOC_NODE(node,reference)				\
 	yassert((reference)[0]!=0);					    \
-	ZALLOC_ARRAY_OR_DIE(AVL_NODE_TYPE*, node, (sizeof(AVL_NODE_TYPE)+(reference)[0]), AVL_NODE_TAG); \
+	ZDB_ZONE_ALLOC_ARRAY_OR_DIE(AVL_NODE_TYPE*, node, (sizeof(AVL_NODE_TYPE)+(reference)[0]), AVL_NODE_TAG); \
 	ZEROMEMORY(node,sizeof(AVL_NODE_TYPE)+(reference)[0])
 
 /*
@@ -131,7 +132,7 @@ nsec3_free_node(nsec3_zone_item* node)
     yassert((node->rc == 0) && (node->sc == 0));
 #endif
     u32 node_size = NSEC3_NODE_SIZE(node);
-    ZFREE_ARRAY(node, node_size);
+    ZDB_ZONE_FREE_ARRAY(node, node_size);
 }
 
 #define AVL_FREE_NODE(node) nsec3_free_node(node)
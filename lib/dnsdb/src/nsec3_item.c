@@ -652,7 +652,7 @@ nsec3_zone_item_empties(nsec3_zone_item *item)
 
     yassert(item->rc == 0 && item->sc == 0);
 
-    ZFREE_ARRAY(item->type_bit_maps, item->type_bit_maps_size);
+    ZDB_ZONE_FREE_ARRAY(item->type_bit_maps, item->type_bit_maps_size);
 
     item->type_bit_maps = NULL;
     item->type_bit_maps_size = 0;
@@ -726,8 +726,8 @@ nsec3_zone_item_update_bitmap(nsec3_zone_item* nsec3_item, const u8 *rdata, u16
         if(nsec3_item->type_bit_maps_size != type_bit_maps_size)
         {
             /* @todo 20140214 edf -- : take the memory granularity in account in case of ZALLOC enabled */
-            ZFREE_ARRAY(nsec3_item->type_bit_maps, nsec3_item->type_bit_maps_size);
-            ZALLOC_ARRAY_OR_DIE(u8*, nsec3_item->type_bit_maps, type_bit_maps_size, NSEC3_TYPEBITMAPS_TAG);
+            ZDB_ZONE_FREE_ARRAY(nsec3_item->type_bit_maps, nsec3_item->type_bit_maps_size);
+            ZDB_ZONE_ALLOC_ARRAY_OR_DIE(u8*, nsec3_item->type_bit_maps, type_bit_maps_size, NSEC3_TYPEBITMAPS_TAG);
             nsec3_item->type_bit_maps_size = type_bit_maps_size;
         }
 
@@ -45,6 +45,9 @@
 #include "dnsdb/dnsdb-config.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <pthread.h>
+
+#include <dnscore/timems.h>
 
 #include "dnsdb/nsec3_types.h"
 #include "dnsdb/nsec3_item.h"
@@ -57,6 +60,32 @@
 
 extern logger_handle *g_dnssec_logger;
 
+static pthread_key_t nsec3_proof_histogram_key;
+static pthread_once_t nsec3_proof_histogram_key_once = PTHREAD_ONCE_INIT;
+
+static void
+nsec3_proof_histogram_key_init()
+{
+    if(pthread_key_create(&nsec3_proof_histogram_key, NULL) != 0)
+    {
+        log_quit("nsec3: pthread_key_create = %r", ERRNO_ERROR);
+    }
+}
+
+void
+nsec3_proof_histogram_set(histogram_s *h)
+{
+    pthread_once(&nsec3_proof_histogram_key_once, nsec3_proof_histogram_key_init);
+    pthread_setspecific(nsec3_proof_histogram_key, h);
+}
+
+histogram_s*
+nsec3_proof_histogram_get()
+{
+    pthread_once(&nsec3_proof_histogram_key_once, nsec3_proof_histogram_key_init);
+    return (histogram_s*)pthread_getspecific(nsec3_proof_histogram_key);
+}
+
 /**
  * @note Name Error Responses
  * 
@@ -119,6 +148,9 @@ nsec3_name_error(const zdb_zone* zone, const dnsname_vector *qname, u32 apex_ind
     const nsec3_zone_item *closest_provable_encloser_nsec3;
     const nsec3_zone_item *wild_closest_provable_encloser_nsec3;
     
+    histogram_s *proof_histogram = nsec3_proof_histogram_get();
+    u64 proof_start = (proof_histogram != NULL)?timens_monotonic():0;
+    
     yassert(out_next_closer_nsec3_owner_p != NULL && out_encloser_nsec3 != NULL && out_encloser_nsec3_rrsig != NULL);
     yassert(out_closest_encloser_nsec3_owner_p != NULL && out_closest_encloser_nsec3 != NULL && out_closest_encloser_nsec3_rrsig != NULL);
     yassert(out_wild_closest_encloser_nsec3_owner_p != NULL && out_wild_closest_encloser_nsec3 != NULL && out_wild_closest_encloser_nsec3_rrsig != NULL);
@@ -191,6 +223,11 @@ nsec3_name_error(const zdb_zone* zone, const dnsname_vector *qname, u32 apex_ind
                 out_wild_closest_encloser_nsec3,
                 out_wild_closest_encloser_nsec3_rrsig);
     }
+    
+    if(proof_histogram != NULL)
+    {
+        histogram_record(proof_histogram, timens_monotonic() - proof_start);
+    }
 }
 
 /** @} */
@@ -46,6 +46,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <dnscore/timems.h>
+
 #include "dnsdb/zdb_zone.h"
 #include "dnsdb/nsec3_types.h"
 #include "dnsdb/nsec3_item.h"
@@ -86,6 +88,9 @@ nsec3_nodata_error(const zdb_zone *zone, const zdb_rr_label* owner,
     yassert(out_closest_encloser_nsec3_owner != NULL && out_closest_encloser_nsec3 != NULL && out_closest_encloser_nsec3_rrsig != NULL);
     
     const nsec3_zone_item *owner_nsec3;
+    
+    histogram_s *proof_histogram = nsec3_proof_histogram_get();
+    u64 proof_start = (proof_histogram != NULL)?timens_monotonic():0;
 
     nsec3_zone* n3 = zone->nsec.nsec3;
     
@@ -152,6 +157,11 @@ nsec3_nodata_error(const zdb_zone *zone, const zdb_rr_label* owner,
     {
         log_err("%{dnsnamevector} owner_nsec3 is null", qname);
     }
+    
+    if(proof_histogram != NULL)
+    {
+        histogram_record(proof_histogram, timens_monotonic() - proof_start);
+    }
 }
 
 /**
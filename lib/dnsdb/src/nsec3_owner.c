@@ -263,7 +263,7 @@ nsec3_label_add(nsec3_label_pointer_array* ownersp, s32* countp, const zdb_rr_la
 
             nsec3_label_pointer_array owners;
 
-            ZALLOC_ARRAY_OR_DIE(zdb_rr_label**, owners.owners, sizeof(zdb_rr_label*) * 2, NSEC3_LABELPTRARRAY_TAG);
+            ZDB_ZONE_ALLOC_ARRAY_OR_DIE(zdb_rr_label**, owners.owners, sizeof(zdb_rr_label*) * 2, NSEC3_LABELPTRARRAY_TAG);
 
             owners.owners[0] = (*ownersp).owner;
             owners.owners[1] = (zdb_rr_label*)owner;
@@ -300,9 +300,9 @@ nsec3_label_add(nsec3_label_pointer_array* ownersp, s32* countp, const zdb_rr_la
             }
         }
         
-        /** @note ZALLOC_ARRAY_RESIZE does change the value of "count" to "count+1" */
+        /** @note ZDB_ZONE_ALLOC_ARRAY_RESIZE does change the value of "count" to "count+1" */
         
-        ZALLOC_ARRAY_RESIZE(zdb_rr_label*, (*ownersp).owners, count, count + 1);
+        ZDB_ZONE_ALLOC_ARRAY_RESIZE(zdb_rr_label*, (*ownersp).owners, count, count + 1);
         (*ownersp).owners[count-1] = (zdb_rr_label*)owner; /** @note count is already set to count + 1 */
         *countp = count;
 
@@ -371,7 +371,7 @@ nsec3_label_remove(nsec3_label_pointer_array* ownersp, s32* countp, const zdb_rr
             last_owner = (*ownersp).owners[0];
         }
 
-        ZFREE_ARRAY((*ownersp).owners, sizeof(zdb_rr_label*) * 2);
+        ZDB_ZONE_FREE_ARRAY((*ownersp).owners, sizeof(zdb_rr_label*) * 2);
 
         (*ownersp).owner = last_owner;
         *countp = 1;
@@ -418,7 +418,7 @@ nsec3_label_remove(nsec3_label_pointer_array* ownersp, s32* countp, const zdb_rr
          * Note : this macro will also set *countp to *countp - 1
          */
 
-        ZALLOC_ARRAY_RESIZE(zdb_rr_label*, (*ownersp).owners, *countp, *countp - 1);
+        ZDB_ZONE_ALLOC_ARRAY_RESIZE(zdb_rr_label*, (*ownersp).owners, *countp, *countp - 1);
     }
 }
 
@@ -666,7 +666,7 @@ nsec3_remove_all_owners(nsec3_zone_item *item)
                 }
             }
 
-            ZFREE_ARRAY(item->label.owners, sizeof(zdb_rr_label*) * n);
+            ZDB_ZONE_FREE_ARRAY(item->label.owners, sizeof(zdb_rr_label*) * n);
 
             item->label.owners = NULL;
         }
@@ -855,7 +855,7 @@ nsec3_remove_all_star(nsec3_zone_item *item)
                 }
             }
 
-            ZFREE_ARRAY(item->star_label.owners, sizeof(zdb_rr_label*) * n);
+            ZDB_ZONE_FREE_ARRAY(item->star_label.owners, sizeof(zdb_rr_label*) * n);
 
             item->star_label.owners = NULL;
         }
@@ -927,7 +927,7 @@ nsec3_move_all_star(nsec3_zone_item* src, nsec3_zone_item* dst)
          * rc > 0 and sc > 0, so total of 2 means rc = 1 and sc = 1
          */
 
-        ZALLOC_ARRAY_OR_DIE(zdb_rr_label**, owners.owners, sizeof(zdb_rr_label*) * total, NSEC3_LABELPTRARRAY_TAG);
+        ZDB_ZONE_ALLOC_ARRAY_OR_DIE(zdb_rr_label**, owners.owners, sizeof(zdb_rr_label*) * total, NSEC3_LABELPTRARRAY_TAG);
 
         for(s32 i = 0; i < dst->sc; i++)
         {
@@ -941,7 +941,7 @@ nsec3_move_all_star(nsec3_zone_item* src, nsec3_zone_item* dst)
         if(dst->sc > 1) // if it's a real array, free it
         {
             s32 len = dst->sc * sizeof(zdb_rr_label*);
-            ZFREE_ARRAY(dst->star_label.owners, len);
+            ZDB_ZONE_FREE_ARRAY(dst->star_label.owners, len);
         }
 
         /* change the star link of each label from src to dst */
@@ -958,7 +958,7 @@ nsec3_move_all_star(nsec3_zone_item* src, nsec3_zone_item* dst)
         if(src->sc > 1) // if it's a real array, free it
         {
             s32 len = src->sc * sizeof(zdb_rr_label*);
-            ZFREE_ARRAY(src->star_label.owners, len);
+            ZDB_ZONE_FREE_ARRAY(src->star_label.owners, len);
         }
 
         dst->star_label.owners = owners.owners; // owner when 1 item, owners when multiple. False positives from static analysers.
@@ -391,7 +391,7 @@ nsec3_zone_new(const u8 *nsec3param_rdata, u16 nsec3param_rdata_size)
     nsec3_zone *n3;
     u32 nsec3param_rdata_realsize = NSEC3PARAM_RDATA_SIZE_FROM_RDATA(nsec3param_rdata);
     yassert(nsec3param_rdata_size >= nsec3param_rdata_realsize);
-    ZALLOC_ARRAY_OR_DIE(nsec3_zone*, n3, sizeof(nsec3_zone) + nsec3param_rdata_realsize, NSEC3_ZONE_TAG);
+    ZDB_ZONE_ALLOC_ARRAY_OR_DIE(nsec3_zone*, n3, sizeof(nsec3_zone) + nsec3param_rdata_realsize, NSEC3_ZONE_TAG);
     n3->next = NULL;
     n3->items = NULL;
     memcpy(n3->rdata, nsec3param_rdata, nsec3param_rdata_realsize);
@@ -403,7 +403,7 @@ void nsec3_zone_free(nsec3_zone *n3)
 {
     yassert(nsec3_avl_isempty(&n3->items));
     yassert(n3->next == NULL);
-    ZFREE_ARRAY(n3, sizeof(nsec3_zone) + NSEC3PARAM_MINIMUM_LENGTH + n3->rdata[4]);
+    ZDB_ZONE_FREE_ARRAY(n3, sizeof(nsec3_zone) + NSEC3PARAM_MINIMUM_LENGTH + n3->rdata[4]);
 }
 
 ya_result
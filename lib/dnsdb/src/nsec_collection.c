@@ -52,6 +52,7 @@
 
 #include <dnscore/dnscore.h>
 #include "dnsdb/nsec_collection.h"
+#include "dnsdb/zdb-zone-arena.h"
 
 /*
  * The following macros are defining relevant fields in the node
@@ -90,15 +91,35 @@
 #define AVL_REFERENCE_FORMAT_STRING "%{dnsname}"
 #define AVL_REFERENCE_FORMAT(reference) reference
 
+/*
+ * dnsname_zdup/dnsname_zfree, taking the name from the zone arena when it is bound
+ */
+
+static u8*
+nsec_inverse_name_dup(const u8 *name)
+{
+    u32 len = dnsname_len(name);
+    u8 *dup;
+    ZDB_ZONE_ALLOC_ARRAY_OR_DIE(u8*, dup, len, ZDB_NAME_TAG);
+    MEMCOPY(dup, name, len);
+    return dup;
+}
+
+static void
+nsec_inverse_name_free(u8 *name)
+{
+    ZDB_ZONE_FREE_ARRAY(name, dnsname_len(name));
+}
+
 /*
  * A macro to initialize a node and setting the reference
  */
-#define AVL_INIT_NODE(node,reference) (node)->inverse_relative_name=dnsname_zdup(reference)
+#define AVL_INIT_NODE(node,reference) (node)->inverse_relative_name=nsec_inverse_name_dup(reference)
 /*
  * A macro to allocate a new node
  */
 #define AVL_ALLOC_NODE(node,reference)                                                      \
-	ZALLOC_ARRAY_OR_DIE(AVL_NODE_TYPE*, node, (sizeof(AVL_NODE_TYPE)), AVL_NODE_TAG);   \
+	ZDB_ZONE_ALLOC_ARRAY_OR_DIE(AVL_NODE_TYPE*, node, (sizeof(AVL_NODE_TYPE)), AVL_NODE_TAG);   \
 	ZEROMEMORY(node,sizeof(AVL_NODE_TYPE))
 
 /*
@@ -108,7 +129,7 @@
 static void
 nsec_free_node(AVL_NODE_TYPE* node)
 {
-    ZFREE_ARRAY(node, sizeof(AVL_NODE_TYPE));
+    ZDB_ZONE_FREE_ARRAY(node, sizeof(AVL_NODE_TYPE));
 }
 
 #define AVL_FREE_NODE(node) nsec_free_node(node)
@@ -145,7 +166,7 @@ nsec_free_node(AVL_NODE_TYPE* node)
  * _ has got its content overwritten by the one of another node, then the other
  *   node is deleted with FREE_NODE
  */
-#define AVL_NODE_DELETE_CALLBACK(node) dnsname_zfree((node)->inverse_relative_name);
+#define AVL_NODE_DELETE_CALLBACK(node) nsec_inverse_name_free((node)->inverse_relative_name);
 
 #include <dnscore/avl.c.inc>
 
@@ -81,11 +81,11 @@ type_bit_maps_initialise_from_label(type_bit_maps_context *context, zdb_rr_label
 
     ZEROMEMORY(type_bitmap_field, sizeof(context->type_bitmap_field));
 
-    btree_iterator types_iter;
-    btree_iterator_init(label->resource_record_set, &types_iter);
-    while(btree_iterator_hasnext(&types_iter))
+    zdb_rr_collection_iterator types_iter;
+    zdb_rr_collection_iterator_init(label->resource_record_set, &types_iter);
+    while(zdb_rr_collection_iterator_hasnext(&types_iter))
     {
-        btree_node *node = btree_iterator_next_node(&types_iter);
+        zdb_rr_collection_node *node = zdb_rr_collection_iterator_next_node(&types_iter);
 
         u16 type = node->hash; /** @note : NATIVETYPE */
         
@@ -158,7 +158,7 @@ rrsig_delete(const zdb_zone *zone, const u8 *dname, zdb_rr_label* label, u16 typ
      *
      */
 
-    zdb_packed_ttlrdata** first = (zdb_packed_ttlrdata**)btree_findp(&label->resource_record_set, TYPE_RRSIG);
+    zdb_packed_ttlrdata** first = (zdb_packed_ttlrdata**)zdb_rr_collection_findp(&label->resource_record_set, TYPE_RRSIG);
 
     if(first == NULL)
     {
@@ -221,7 +221,7 @@ rrsig_delete_by_tag(const zdb_zone *zone, u16 tag)
      *
      */
 
-    zdb_packed_ttlrdata** first = (zdb_packed_ttlrdata**)btree_findp(&zone->apex->resource_record_set, TYPE_RRSIG);
+    zdb_packed_ttlrdata** first = (zdb_packed_ttlrdata**)zdb_rr_collection_findp(&zone->apex->resource_record_set, TYPE_RRSIG);
 
     if(first == NULL)
     {
@@ -0,0 +1,209 @@
+/*------------------------------------------------------------------------------
+*
+* Copyright (c) 2011-2019, EURid vzw. All rights reserved.
+* The YADIFA TM software product is provided under the BSD 3-clause license:
+* 
+* Redistribution and use in source and binary forms, with or without 
+* modification, are permitted provided that the following conditions
+* are met:
+*
+*        * Redistributions of source code must retain the above copyright 
+*          notice, this list of conditions and the following disclaimer.
+*        * Redistributions in binary form must reproduce the above copyright 
+*          notice, this list of conditions and the following disclaimer in the 
+*          documentation and/or other materials provided with the distribution.
+*        * Neither the name of EURid nor the names of its contributors may be 
+*          used to endorse or promote products derived from this software 
+*          without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*------------------------------------------------------------------------------
+*
+*/
+/** @defgroup records Internal functions for the database: resource records.
+ *  @ingroup dnsdb
+ *  @brief The collection of the RRsets of a label
+ *
+ * @{
+ */
+
+#include "dnsdb/dnsdb-config.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include <dnscore/zalloc.h>
+
+#include "dnsdb/zdb-rr-collection.h"
+#include "dnsdb/zdb-zone-arena.h"
+
+static zdb_rr_block*
+zdb_rr_block_new_instance(u16 capacity)
+{
+    zdb_rr_block *block;
+    ZDB_ZONE_ALLOC_ARRAY_OR_DIE(zdb_rr_block*, block, ZDB_RR_BLOCK_SIZE(capacity), ZDB_RR_BLOCK_TAG);
+    block->count = 0;
+    block->capacity = capacity;
+    return block;
+}
+
+static void
+zdb_rr_block_free(zdb_rr_block *block)
+{
+    ZDB_ZONE_FREE_ARRAY(block, ZDB_RR_BLOCK_SIZE(block->capacity));
+}
+
+void**
+zdb_rr_block_insert(zdb_rr_block **blockp, hashcode hash)
+{
+    zdb_rr_block *block = *blockp;
+    
+    if(block == NULL)
+    {
+        block = zdb_rr_block_new_instance(1);
+        block->count = 1;
+        block->node[0].data = NULL;
+        block->node[0].hash = hash;
+        *blockp = block;
+        return &block->node[0].data;
+    }
+    
+    s32 index = 0;
+    
+    while((index < block->count) && (block->node[index].hash < hash))
+    {
+        ++index;
+    }
+    
+    if((index < block->count) && (block->node[index].hash == hash))
+    {
+        return &block->node[index].data;
+    }
+    
+    if(block->count < block->capacity)
+    {
+        memmove(&block->node[index + 1], &block->node[index], (block->count - index) * sizeof(zdb_rr_block_node));
+    }
+    else
+    {
+        // copy into a block twice as big, the old one is left untouched until it is replaced
+        
+        zdb_rr_block *bigger = zdb_rr_block_new_instance(block->capacity << 1);
+        bigger->count = block->count;
+        memcpy(&bigger->node[0], &block->node[0], index * sizeof(zdb_rr_block_node));
+        memcpy(&bigger->node[index + 1], &block->node[index], (block->count - index) * sizeof(zdb_rr_block_node));
+        *blockp = bigger;
+        zdb_rr_block_free(block);
+        block = bigger;
+    }
+    
+    ++block->count;
+    block->node[index].data = NULL;
+    block->node[index].hash = hash;
+    
+    return &block->node[index].data;
+}
+
+void*
+zdb_rr_block_delete(zdb_rr_block **blockp, hashcode hash)
+{
+    zdb_rr_block *block = *blockp;
+    
+    if(block == NULL)
+    {
+        return NULL;
+    }
+    
+    s32 index = zdb_rr_block_index(block, hash);
+    
+    if(index < 0)
+    {
+        return NULL;
+    }
+    
+    void *data = block->node[index].data;
+    
+    if(block->count == 1)
+    {
+        *blockp = NULL;
+        zdb_rr_block_free(block);
+        return data;
+    }
+    
+    u16 count = block->count - 1;
+    
+    if(count <= (block->capacity >> 2))
+    {
+        // a quarter full: move to a block half as big
+        
+        zdb_rr_block *smaller = zdb_rr_block_new_instance(block->capacity >> 1);
+        smaller->count = count;
+        memcpy(&smaller->node[0], &block->node[0], index * sizeof(zdb_rr_block_node));
+        memcpy(&smaller->node[index], &block->node[index + 1], (count - index) * sizeof(zdb_rr_block_node));
+        *blockp = smaller;
+        zdb_rr_block_free(block);
+    }
+    else
+    {
+        memmove(&block->node[index], &block->node[index + 1], (count - index) * sizeof(zdb_rr_block_node));
+        block->count = count;
+    }
+    
+    return data;
+}
+
+void
+zdb_rr_block_destroy(zdb_rr_block **blockp)
+{
+    if(*blockp != NULL)
+    {
+        zdb_rr_block_free(*blockp);
+        *blockp = NULL;
+    }
+}
+
+void
+zdb_rr_block_callback_and_destroy(zdb_rr_block *block, void (*callback)(void*))
+{
+    if(block != NULL)
+    {
+        for(s32 i = 0; i < block->count; ++i)
+        {
+            callback(block->node[i].data);
+        }
+        
+        zdb_rr_block_free(block);
+    }
+}
+
+#if !ZDB_RR_COLLECTION_BLOCK
+
+size_t
+zdb_rr_collection_memory(const zdb_rr_collection collection)
+{
+    size_t size = 0;
+    btree_iterator iter;
+    btree_iterator_init(collection, &iter);
+    
+    while(btree_iterator_hasnext(&iter))
+    {
+        btree_iterator_next_node(&iter);
+        size += sizeof(btree_node);
+    }
+    
+    return size;
+}
+
+#endif
+
+/** @} */
@@ -304,7 +304,7 @@ zdb_zone_answer_axfr_thread(void* data_)
         data->return_code = ERROR;
         log_err("zone write axfr: %{dnsname}: invalid socket", data->zone->origin);
         zdb_zone_answer_axfr_thread_exit(data);
-        free(mesg);
+        message_free(mesg);
         return NULL;
     }
     
@@ -323,7 +323,7 @@ zdb_zone_answer_axfr_thread(void* data_)
         zdb_zone_answer_axfr_thread_exit(data);
         tcp_set_abortive_close(tcpfd);
         close_ex(tcpfd);
-        free(mesg);        
+        message_free(mesg);        
         return NULL;
     }
     
@@ -342,7 +342,7 @@ zdb_zone_answer_axfr_thread(void* data_)
         zdb_zone_answer_axfr_thread_exit(data);
         tcp_set_abortive_close(tcpfd);
         close_ex(tcpfd);
-        free(mesg);
+        message_free(mesg);
         return NULL;
     }
     
@@ -410,7 +410,7 @@ zdb_zone_answer_axfr_thread(void* data_)
             tcp_set_abortive_close(tcpfd);
             close_ex(tcpfd);
             
-            free(mesg);
+            message_free(mesg);
 
             return NULL;
         }
@@ -431,7 +431,7 @@ zdb_zone_answer_axfr_thread(void* data_)
             zdb_zone_answer_axfr_thread_exit(data);
             tcp_set_abortive_close(tcpfd);
             close_ex(tcpfd);
-            free(mesg);
+            message_free(mesg);
             return NULL;
         }
                 
@@ -451,7 +451,7 @@ zdb_zone_answer_axfr_thread(void* data_)
             zdb_zone_answer_axfr_thread_exit(data); // releases
             tcp_set_abortive_close(tcpfd);
             close_ex(tcpfd);
-            free(mesg);
+            message_free(mesg);
             return NULL;
         }
         
@@ -540,7 +540,7 @@ zdb_zone_answer_axfr_thread(void* data_)
                 zdb_zone_answer_axfr_thread_exit(data);
                 tcp_set_abortive_close(tcpfd);
                 close_ex(tcpfd);
-                free(mesg);
+                message_free(mesg);
                 return NULL;
             }
 
@@ -714,7 +714,7 @@ zdb_zone_answer_axfr_thread(void* data_)
 
                 zdb_zone_answer_axfr_thread_exit(data);
                 close_ex(tcpfd);
-                free(mesg);
+                message_free(mesg);
                 return NULL;
             }
             
@@ -1230,7 +1230,7 @@ scheduler_queue_zone_write_axfr_thread_exit:
     output_stream_close(&tcpos);
     input_stream_close(&fis);
 
-    free(mesg);
+    message_free(mesg);
 
     return NULL;
 }
@@ -1265,9 +1265,7 @@ zdb_zone_answer_axfr(zdb_zone *zone, message_data *mesg, struct thread_pool_s *n
     
     args->disk_tp = disk_tp;
     
-    message_data *mesg_clone;
-    MALLOC_OR_DIE(message_data*, mesg_clone, sizeof(message_data), MESGDATA_TAG);
-    memcpy(mesg_clone, mesg, sizeof(message_data));
+    message_data *mesg_clone = message_dup(mesg);
 
     args->mesg = mesg_clone;
     args->packet_size_limit = max_packet_size;
@@ -130,7 +130,7 @@ zdb_zone_answer_ixfr_thread_exit(zdb_zone_answer_ixfr_args* data)
 
     if(data->mesg != NULL)
     {
-        free(data->mesg);
+        message_free(data->mesg);
     }
     //free(data->directory);
     free(data);
@@ -664,7 +664,7 @@ zdb_zone_answer_ixfr_thread(void* data_)
     }
 
     free(rdata_buffer);
-    free(mesg);
+    message_free(mesg);
 
     return NULL;
 }
@@ -694,10 +694,7 @@ zdb_zone_answer_ixfr(zdb_zone* zone, message_data *mesg, struct thread_pool_s *n
     args->zone = zone;
     //args->directory = "/tmp"; // strdup(journal_get_xfr_path());
 
-    message_data *mesg_clone;
-
-    MALLOC_OR_DIE(message_data*, mesg_clone, sizeof(message_data), MESGDATA_TAG);
-    memcpy(mesg_clone, mesg, sizeof(message_data));
+    message_data *mesg_clone = message_dup(mesg);
 
     args->mesg = mesg_clone;
     args->disk_tp = disk_tp;
@@ -0,0 +1,317 @@
+/*------------------------------------------------------------------------------
+*
+* Copyright (c) 2011-2019, EURid vzw. All rights reserved.
+* The YADIFA TM software product is provided under the BSD 3-clause license:
+* 
+* Redistribution and use in source and binary forms, with or without 
+* modification, are permitted provided that the following conditions
+* are met:
+*
+*        * Redistributions of source code must retain the above copyright 
+*          notice, this list of conditions and the following disclaimer.
+*        * Redistributions in binary form must reproduce the above copyright 
+*          notice, this list of conditions and the following disclaimer in the 
+*          documentation and/or other materials provided with the distribution.
+*        * Neither the name of EURid nor the names of its contributors may be 
+*          used to endorse or promote products derived from this software 
+*          without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*------------------------------------------------------------------------------
+*
+*/
+/** @defgroup dnsdbzone Zone related functions
+ *  @ingroup dnsdb
+ *  @brief The memory arena of a zone
+ *
+ * @{
+ */
+
+#include "dnsdb/dnsdb-config.h"
+#include <unistd.h>
+#include <sys/mman.h>
+#include <pthread.h>
+
+#include <dnscore/logger.h>
+#include <dnscore/mutex.h>
+
+#include "dnsdb/zdb_types.h"
+#include "dnsdb/zdb_utils.h"
+#include "dnsdb/zdb-zone-arena.h"
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+extern logger_handle* g_database_logger;
+#define MODULE_MSG_HANDLE g_database_logger
+
+static mutex_t zdb_zone_arena_teardown_stats_mtx = MUTEX_INITIALIZER;
+static zdb_zone_arena_teardown_stats zdb_zone_arena_teardown_stats_current = {0, 0, 0, 0};
+
+#if ZDB_ZONE_ARENA_SUPPORT
+
+u64 zdb_zone_arena_chunk_map[ZDB_ZONE_ARENA_CHUNK_MAP_SIZE];
+volatile s32 zdb_zone_arena_bound_count = 0;
+volatile u64 zdb_zone_arena_heap_count = 0;
+
+static pthread_key_t zdb_zone_arena_key;
+static pthread_once_t zdb_zone_arena_key_once = PTHREAD_ONCE_INIT;
+
+static void
+zdb_zone_arena_key_init()
+{
+    if(pthread_key_create(&zdb_zone_arena_key, NULL) != 0)
+    {
+        log_quit("zone-arena: pthread_key_create = %r", ERRNO_ERROR);
+    }
+}
+
+static void
+zdb_zone_arena_chunk_map_set(void *chunk)
+{
+    intptr index = ((intptr)chunk) >> ZDB_ZONE_ARENA_CHUNK_SHIFT;
+    __sync_fetch_and_or(&zdb_zone_arena_chunk_map[index >> 6], 1ULL << (index & 63));
+}
+
+static void
+zdb_zone_arena_chunk_map_clear(void *chunk)
+{
+    intptr index = ((intptr)chunk) >> ZDB_ZONE_ARENA_CHUNK_SHIFT;
+    __sync_fetch_and_and(&zdb_zone_arena_chunk_map[index >> 6], ~(1ULL << (index & 63)));
+}
+
+/**
+ * Maps a chunk aligned on its size, by mapping twice the size and unmapping
+ * what is around the aligned part.
+ * 
+ * @return the chunk, or NULL if it could not be mapped in the address space covered by the map
+ */
+
+static zdb_zone_arena_chunk*
+zdb_zone_arena_chunk_new_instance()
+{
+    u8 *map = (u8*)mmap(NULL, ZDB_ZONE_ARENA_CHUNK_SIZE * 2, PROT_READ|PROT_WRITE, MAP_ANONYMOUS|MAP_PRIVATE, -1, 0);
+    
+    if(map == (u8*)MAP_FAILED)
+    {
+        log_warn("zone-arena: cannot map a chunk: %r", ERRNO_ERROR);
+        return NULL;
+    }
+    
+    u8 *chunk = (u8*)((((intptr)map) + ZDB_ZONE_ARENA_CHUNK_SIZE - 1) & ~(ZDB_ZONE_ARENA_CHUNK_SIZE - 1));
+    
+    if(chunk > map)
+    {
+        munmap(map, chunk - map);
+    }
+    
+    munmap(chunk + ZDB_ZONE_ARENA_CHUNK_SIZE, (map + ZDB_ZONE_ARENA_CHUNK_SIZE * 2) - (chunk + ZDB_ZONE_ARENA_CHUNK_SIZE));
+    
+    if((((intptr)chunk) >> ZDB_ZONE_ARENA_CHUNK_SHIFT) >= (ZDB_ZONE_ARENA_CHUNK_MAP_SIZE << 6))
+    {
+        munmap(chunk, ZDB_ZONE_ARENA_CHUNK_SIZE);
+        return NULL;
+    }
+    
+    zdb_zone_arena_chunk_map_set(chunk);
+    
+    return (zdb_zone_arena_chunk*)chunk;
+}
+
+zdb_zone_arena*
+zdb_zone_arena_new_instance()
+{
+    zdb_zone_arena *arena;
+    
+    ZALLOC_OR_DIE(zdb_zone_arena*, arena, zdb_zone_arena, ZDB_ZONE_ARENA_TAG);
+    arena->top = NULL;
+    arena->limit = NULL;
+    arena->chunks = NULL;
+    arena->used = 0;
+    arena->heap_mark = 0;
+    arena->chunk_count = 0;
+    arena->sealed = FALSE;
+    arena->writing = FALSE;
+    arena->dirty = FALSE;
+    
+    return arena;
+}
+
+void
+zdb_zone_arena_bind(zdb_zone_arena *arena)
+{
+    pthread_once(&zdb_zone_arena_key_once, zdb_zone_arena_key_init);
+    
+    yassert(pthread_getspecific(zdb_zone_arena_key) == NULL);
+    
+    pthread_setspecific(zdb_zone_arena_key, arena);
+    __sync_fetch_and_add(&zdb_zone_arena_bound_count, 1);
+}
+
+void
+zdb_zone_arena_unbind()
+{
+    pthread_once(&zdb_zone_arena_key_once, zdb_zone_arena_key_init);
+    
+    if(pthread_getspecific(zdb_zone_arena_key) != NULL)
+    {
+        pthread_setspecific(zdb_zone_arena_key, NULL);
+        __sync_fetch_and_sub(&zdb_zone_arena_bound_count, 1);
+    }
+}
+
+void
+zdb_zone_arena_delete(zdb_zone_arena *arena)
+{
+    zdb_zone_arena_chunk *chunk = arena->chunks;
+    
+    while(chunk != NULL)
+    {
+        zdb_zone_arena_chunk *next = chunk->next;
+        zdb_zone_arena_chunk_map_clear(chunk);
+        munmap(chunk, ZDB_ZONE_ARENA_CHUNK_SIZE);
+        chunk = next;
+    }
+    
+    ZFREE(arena, zdb_zone_arena);
+}
+
+void*
+zdb_zone_arena_alloc_bound(size_t size)
+{
+    zdb_zone_arena *arena = (zdb_zone_arena*)pthread_getspecific(zdb_zone_arena_key);
+    
+    if(arena == NULL)
+    {
+        __sync_fetch_and_add(&zdb_zone_arena_heap_count, 1);
+        return NULL;
+    }
+    
+    size = (size + 7) & ~7;
+    
+    if(arena->top + size > arena->limit)
+    {
+        if(size > ZDB_ZONE_ARENA_CHUNK_SIZE - sizeof(zdb_zone_arena_chunk))
+        {
+            arena->dirty = TRUE; // the loader puts it on the heap
+            return NULL;
+        }
+        
+        zdb_zone_arena_chunk *chunk = zdb_zone_arena_chunk_new_instance();
+        
+        if(chunk == NULL)
+        {
+            arena->dirty = TRUE;
+            return NULL;
+        }
+        
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+        ++arena->chunk_count;
+        arena->top = (u8*)&chunk[1];
+        arena->limit = ((u8*)chunk) + ZDB_ZONE_ARENA_CHUNK_SIZE;
+    }
+    
+    void *ret = arena->top;
+    arena->top += size;
+    arena->used += size;
+    
+    return ret;
+}
+
+void
+zdb_zone_arena_seal(zdb_zone *zone)
+{
+    zdb_zone_arena *arena = zone->arena;
+    
+    zdb_zone_arena_unbind();
+    
+    if(arena == NULL)
+    {
+        return;
+    }
+    
+    arena->sealed = TRUE;
+    
+    log_info("zone load: zone %{dnsname}: %llu bytes in %u chunk(s) of %llu bytes", zone->origin, arena->used, arena->chunk_count, ZDB_ZONE_ARENA_CHUNK_SIZE);
+}
+
+bool
+zdb_zone_arena_pristine(const zdb_zone *zone)
+{
+    const zdb_zone_arena *arena = zone->arena;
+    
+    if((arena == NULL) || (zone->apex == NULL))
+    {
+        return FALSE;
+    }
+    
+    return arena->sealed && !arena->writing && !arena->dirty;
+}
+
+u64
+zdb_zone_arena_resident(const zdb_zone_arena *arena)
+{
+    long page_size = sysconf(_SC_PAGESIZE);
+    u32 page_count = ZDB_ZONE_ARENA_CHUNK_SIZE / page_size;
+    u64 resident = 0;
+    unsigned char *vec;
+    
+    MALLOC_OR_DIE(unsigned char*, vec, page_count, ZDB_ZONE_ARENA_TAG);
+    
+    for(const zdb_zone_arena_chunk *chunk = arena->chunks; chunk != NULL; chunk = chunk->next)
+    {
+        if(mincore((void*)chunk, ZDB_ZONE_ARENA_CHUNK_SIZE, vec) == 0)
+        {
+            for(u32 i = 0; i < page_count; ++i)
+            {
+                resident += vec[i] & 1;
+            }
+        }
+    }
+    
+    free(vec);
+    
+    return resident * page_size;
+}
+
+#endif
+
+void
+zdb_zone_arena_teardown_stats_add(u64 elapsed_us, bool released)
+{
+    mutex_lock(&zdb_zone_arena_teardown_stats_mtx);
+    ++zdb_zone_arena_teardown_stats_current.count;
+    if(released)
+    {
+        ++zdb_zone_arena_teardown_stats_current.released;
+    }
+    zdb_zone_arena_teardown_stats_current.total_us += elapsed_us;
+    if(zdb_zone_arena_teardown_stats_current.max_us < elapsed_us)
+    {
+        zdb_zone_arena_teardown_stats_current.max_us = elapsed_us;
+    }
+    mutex_unlock(&zdb_zone_arena_teardown_stats_mtx);
+}
+
+void
+zdb_zone_arena_teardown_stats_get(zdb_zone_arena_teardown_stats *stats)
+{
+    mutex_lock(&zdb_zone_arena_teardown_stats_mtx);
+    *stats = zdb_zone_arena_teardown_stats_current;
+    mutex_unlock(&zdb_zone_arena_teardown_stats_mtx);
+}
+
+/** @} */
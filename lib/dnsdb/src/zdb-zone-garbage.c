@@ -43,10 +43,12 @@
 #include "dnsdb/dnsdb-config.h"
 #include <dnscore/logger.h>
 #include <dnscore/threaded_dll_cw.h>
+#include <dnscore/ptr_vector.h>
 
 #include "dnsdb/dnsdb-config.h"
 #include "dnsdb/zdb_zone.h"
 #include "dnsdb/zdb-zone-garbage.h"
+#include "dnsdb/zdb.h"
 #define ZDB_JOURNAL_CODE 1 // to be allowed to close it
 #include "dnsdb/journal.h"
 
@@ -57,8 +59,25 @@
 extern logger_handle* g_database_logger;
 #define MODULE_MSG_HANDLE g_database_logger
 
+#define ZDBZRTRD_TAG 0x445254525a42445a /* "ZDBZRTRD" */
+
 static threaded_dll_cw zone_garbage_queue;
 
+/**
+ * Instances replaced in the database by zdb_replace_zone, with the database
+ * whose readers may still be using them.
+ */
+
+struct zdb_zone_garbage_retired
+{
+    zdb *db;
+    zdb_zone *zone;
+};
+
+typedef struct zdb_zone_garbage_retired zdb_zone_garbage_retired;
+
+static threaded_dll_cw zone_retired_queue;
+
 #if HAS_TRACK_ZONES_DEBUG_SUPPORT
 extern smp_int g_zone_instanciated_count;
 extern ptr_set g_zone_instanciated_set;
@@ -75,6 +94,7 @@ zdb_zone_garbage_init()
     if(!zdb_zone_garbage_initialised)
     {
         threaded_dll_cw_init(&zone_garbage_queue, 0x100000);    // 1M zones
+        threaded_dll_cw_init(&zone_retired_queue, 0x100000);
         zdb_zone_garbage_initialised = TRUE;
     }
 }
@@ -86,6 +106,8 @@ zdb_zone_garbage_finalize()
     {
         log_debug("zdb_zone_garbage_finalize: releasing zones ");
         
+        zdb_zone_garbage_release_retired(NULL);
+        
         zdb_zone_garbage_run();
         
 #if HAS_TRACK_ZONES_DEBUG_SUPPORT
@@ -108,6 +130,7 @@ zdb_zone_garbage_finalize()
 #endif
     
         threaded_dll_cw_finalize(&zone_garbage_queue);
+        threaded_dll_cw_finalize(&zone_retired_queue);
         
         zdb_zone_garbage_initialised = FALSE;
     }
@@ -141,6 +164,112 @@ zdb_zone_garbage_collect(zdb_zone *zone)
     }
 }
 
+/**
+ * Flags a retired instance as invalid for those still holding a reference
+ * to it, and drops the reference the database had on it.
+ */
+
+static void
+zdb_zone_garbage_retired_release(zdb_zone *zone)
+{
+    zdb_zone_lock(zone, ZDB_ZONE_MUTEX_REPLACE);
+    zone->apex->flags |= ZDB_RR_LABEL_INVALID_ZONE;
+    zdb_zone_unlock(zone, ZDB_ZONE_MUTEX_REPLACE);
+
+#ifdef DEBUG
+    log_debug("zdb_zone_garbage_retired_release: releasing retired zone %{dnsname}@%p", zone->origin, zone);
+#endif
+
+    zdb_zone_release(zone);
+}
+
+void
+zdb_zone_garbage_retire(zdb *db, zdb_zone *zone)
+{
+    if(zdb_zone_garbage_initialised)
+    {
+        zdb_zone_garbage_retired *retired;
+        ZALLOC_OR_DIE(zdb_zone_garbage_retired*, retired, zdb_zone_garbage_retired, ZDBZRTRD_TAG);
+        retired->db = db;
+        retired->zone = zone;
+        
+#ifdef DEBUG
+        log_debug("zdb_zone_garbage_retire: queuing zone %{dnsname}@%p for the collector", zone->origin, zone);
+#endif
+        threaded_dll_cw_enqueue(&zone_retired_queue, retired);
+    }
+    else
+    {
+        zdb_lock(db, ZDB_MUTEX_WRITER);
+        zdb_unlock(db, ZDB_MUTEX_WRITER);
+        
+        zdb_zone_garbage_retired_release(zone);
+    }
+}
+
+void
+zdb_zone_garbage_release_retired(zdb *db)
+{
+    // only the instances queued so far are covered by the wait below
+
+    int n = threaded_dll_cw_size(&zone_retired_queue);
+    
+    if(n == 0)
+    {
+        return;
+    }
+    
+    ptr_vector retired_list;
+    ptr_vector_init_ex(&retired_list, n);
+    
+    while(n-- > 0)
+    {
+        zdb_zone_garbage_retired *retired = (zdb_zone_garbage_retired*)threaded_dll_cw_try_dequeue(&zone_retired_queue);
+        
+        if(retired == NULL)
+        {
+            break;
+        }
+        
+        if((db != NULL) && (retired->db != db))
+        {
+            threaded_dll_cw_enqueue(&zone_retired_queue, retired);
+            continue;
+        }
+        
+        ptr_vector_append(&retired_list, retired);
+    }
+    
+    if(db == NULL)
+    {
+        // waits for the readers that may have seen the retired instances, by database
+        // the readers do not wait on this, they only block for the time the lock is held
+        
+        zdb *last_db = NULL;
+        
+        for(int i = 0; i <= ptr_vector_last_index(&retired_list); ++i)
+        {
+            zdb_zone_garbage_retired *retired = (zdb_zone_garbage_retired*)ptr_vector_get(&retired_list, i);
+            
+            if(retired->db != last_db)
+            {
+                last_db = retired->db;
+                zdb_lock(last_db, ZDB_MUTEX_WRITER);
+                zdb_unlock(last_db, ZDB_MUTEX_WRITER);
+            }
+        }
+    }
+    
+    for(int i = 0; i <= ptr_vector_last_index(&retired_list); ++i)
+    {
+        zdb_zone_garbage_retired *retired = (zdb_zone_garbage_retired*)ptr_vector_get(&retired_list, i);
+        zdb_zone_garbage_retired_release(retired->zone);
+        ZFREE(retired, zdb_zone_garbage_retired);
+    }
+    
+    ptr_vector_destroy(&retired_list);
+}
+
 zdb_zone *
 zdb_zone_garbage_get()
 {
@@ -159,7 +288,7 @@ zdb_zone_garbage_get()
 bool
 zdb_zone_garbage_empty()
 {
-    return threaded_dll_cw_size(&zone_garbage_queue) == 0;
+    return (threaded_dll_cw_size(&zone_garbage_queue) == 0) && (threaded_dll_cw_size(&zone_retired_queue) == 0);
 }
 
 void
@@ -167,6 +296,8 @@ zdb_zone_garbage_run()
 {
     if(zdb_zone_garbage_initialised)
     {
+        zdb_zone_garbage_release_retired(NULL);
+        
         while(threaded_dll_cw_size(&zone_garbage_queue) > 0)
         {
             zdb_zone *zone = (zdb_zone*)threaded_dll_cw_try_dequeue(&zone_garbage_queue);
@@ -197,6 +328,8 @@ zdb_zone_garbage_run_ex(zdb_zone_garbage_run_cb *destroyer)
             destroyer = zdb_zone_destroy;
         }
         
+        zdb_zone_garbage_release_retired(NULL);
+        
         while(threaded_dll_cw_size(&zone_garbage_queue) > 0)
         {
             zdb_zone *zone = (zdb_zone*)threaded_dll_cw_try_dequeue(&zone_garbage_queue);
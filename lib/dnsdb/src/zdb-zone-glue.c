@@ -0,0 +1,548 @@
+/*------------------------------------------------------------------------------
+*
+* Copyright (c) 2011-2019, EURid vzw. All rights reserved.
+* The YADIFA TM software product is provided under the BSD 3-clause license:
+* 
+* Redistribution and use in source and binary forms, with or without 
+* modification, are permitted provided that the following conditions
+* are met:
+*
+*        * Redistributions of source code must retain the above copyright 
+*          notice, this list of conditions and the following disclaimer.
+*        * Redistributions in binary form must reproduce the above copyright 
+*          notice, this list of conditions and the following disclaimer in the 
+*          documentation and/or other materials provided with the distribution.
+*        * Neither the name of EURid nor the names of its contributors may be 
+*          used to endorse or promote products derived from this software 
+*          without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*------------------------------------------------------------------------------
+*
+*/
+/** @defgroup dnsdbzone Zone related functions
+ *  @ingroup dnsdb
+ *  @brief The glue links of a zone
+ *
+ * @{
+ */
+
+#include "dnsdb/dnsdb-config.h"
+
+#include <dnscore/logger.h>
+#include <dnscore/ptr_vector.h>
+#include <dnscore/timems.h>
+
+#include "dnsdb/zdb_types.h"
+#include "dnsdb/zdb_record.h"
+#include "dnsdb/zdb_rr_label.h"
+#include "dnsdb/zdb_zone_label_iterator.h"
+#include "dnsdb/hash.h"
+#include "dnsdb/zdb-zone-glue.h"
+
+#if ZDB_ZONE_GLUE_SUPPORT
+
+extern logger_handle* g_database_logger;
+#define MODULE_MSG_HANDLE g_database_logger
+
+#define ZDBGLUEN_TAG 0x4e45554c4742445a
+#define ZDBGLUEB_TAG 0x4245554c4742445a
+
+#define ZDB_ZONE_GLUE_BUCKETS_MIN 64 // power of two
+#define ZDB_ZONE_GLUE_WILD_SCANS_MAX 16 // scans of the links below a wildcard before resolving them all again
+
+typedef struct zdb_zone_glue_node zdb_zone_glue_node;
+
+struct zdb_zone_glue_node
+{
+    zdb_zone_glue_node *next;
+    zdb_rr_label *label;    // the label holding the addresses of the name, NULL if there are none
+    hashcode hash;
+    bool dirty;             // the label has to be resolved again
+    u8 fqdn[1];             // the node is allocated for the whole name
+};
+
+struct zdb_zone_glue
+{
+    zdb_zone_glue_node **buckets;
+    ptr_vector dirty;       // the nodes to resolve again
+    u32 mask;
+    u32 count;
+    u32 wild_scans;         // the links below a wildcard have been marked this many times since the last update
+    bool all_dirty;         // a wildcard has changed, every node has to be resolved again
+    u8 wild_scope[MAX_DOMAIN_LENGTH]; // the last name the links have been marked below
+};
+
+typedef struct zdb_zone_glue zdb_zone_glue;
+
+static hashcode
+zdb_zone_glue_hash(const u8 *fqdn)
+{
+    hashcode hash = 0;
+
+    while(fqdn[0] != 0)
+    {
+        hash = (hash * 0x9e3779b1U) ^ hash_dnslabel(fqdn);
+        fqdn += fqdn[0] + 1;
+    }
+
+    return hash;
+}
+
+/**
+ * Returns the target name of an NS or MX rdata, NULL for any other type.
+ */
+
+static const u8*
+zdb_zone_glue_target(u16 rtype, const u8 *rdata, u16 rdata_size)
+{
+    switch(rtype)
+    {
+        case TYPE_NS:
+            return rdata;
+        case TYPE_MX:
+            return (rdata_size > 2)?&rdata[2]:NULL;
+        default:
+            return NULL;
+    }
+}
+
+/**
+ * Finds the label of a name the way the additional section is built: from the apex, the wildcard
+ * standing for a missing label.
+ * 
+ * @return FALSE if the name is not in the zone
+ */
+
+static bool
+zdb_zone_glue_resolve(const zdb_zone *zone, const u8 *fqdn, zdb_rr_label **labelp)
+{
+    const dnslabel_vector_reference origin = (const dnslabel_vector_reference)zone->origin_vector.labels;
+    s32 origin_top = zone->origin_vector.size;
+
+    dnslabel_vector name;
+    s32 name_top = dnsname_to_dnslabel_vector(fqdn, name);
+
+    if(name_top < origin_top)
+    {
+        return FALSE;
+    }
+
+    for(s32 i = 0; i <= origin_top; i++)
+    {
+        if(!dnslabel_equals(origin[origin_top - i], name[name_top - i]))
+        {
+            return FALSE;
+        }
+    }
+
+    if(labelp != NULL)
+    {
+        zdb_rr_label *rr_label = zdb_rr_label_find(zone->apex, name, (name_top - origin_top) - 1);
+
+        if((rr_label != NULL) &&
+           (zdb_record_find(&rr_label->resource_record_set, TYPE_A) == NULL) &&
+           (zdb_record_find(&rr_label->resource_record_set, TYPE_AAAA) == NULL))
+        {
+            rr_label = NULL;
+        }
+
+        *labelp = rr_label;
+    }
+
+    return TRUE;
+}
+
+static zdb_zone_glue_node*
+zdb_zone_glue_node_find(const zdb_zone_glue *glue, const u8 *fqdn, hashcode hash)
+{
+    zdb_zone_glue_node *node = glue->buckets[hash & glue->mask];
+
+    while(node != NULL)
+    {
+        if((node->hash == hash) && dnsname_equals_ignorecase(node->fqdn, fqdn))
+        {
+            return node;
+        }
+
+        node = node->next;
+    }
+
+    return NULL;
+}
+
+static void
+zdb_zone_glue_grow(zdb_zone_glue *glue)
+{
+    u32 size = (glue->mask + 1) << 1;
+    zdb_zone_glue_node **buckets;
+
+    MALLOC_OR_DIE(zdb_zone_glue_node**, buckets, sizeof(zdb_zone_glue_node*) * size, ZDBGLUEB_TAG);
+    ZEROMEMORY(buckets, sizeof(zdb_zone_glue_node*) * size);
+
+    for(u32 i = 0; i <= glue->mask; ++i)
+    {
+        zdb_zone_glue_node *node = glue->buckets[i];
+
+        while(node != NULL)
+        {
+            zdb_zone_glue_node *next = node->next;
+            zdb_zone_glue_node **bucket = &buckets[node->hash & (size - 1)];
+            node->next = *bucket;
+            *bucket = node;
+            node = next;
+        }
+    }
+
+    free(glue->buckets);
+    glue->buckets = buckets;
+    glue->mask = size - 1;
+}
+
+static zdb_zone_glue_node*
+zdb_zone_glue_node_add(zdb_zone_glue *glue, const u8 *fqdn, hashcode hash, zdb_rr_label *label)
+{
+    if(glue->count > glue->mask)
+    {
+        zdb_zone_glue_grow(glue);
+    }
+
+    u32 fqdn_len = dnsname_len(fqdn);
+    zdb_zone_glue_node *node;
+    MALLOC_OR_DIE(zdb_zone_glue_node*, node, sizeof(zdb_zone_glue_node) - 1 + fqdn_len, ZDBGLUEN_TAG);
+    node->label = label;
+    node->hash = hash;
+    node->dirty = FALSE;
+    dnsname_copy(node->fqdn, fqdn);
+
+    zdb_zone_glue_node **bucket = &glue->buckets[hash & glue->mask];
+    node->next = *bucket;
+    *bucket = node;
+    ++glue->count;
+
+    return node;
+}
+
+static void
+zdb_zone_glue_node_mark(zdb_zone_glue *glue, zdb_zone_glue_node *node)
+{
+    if(!node->dirty)
+    {
+        node->dirty = TRUE;
+        ptr_vector_append(&glue->dirty, node);
+    }
+}
+
+void
+zdb_zone_glue_destroy(zdb_zone *zone)
+{
+    zdb_zone_glue *glue = zone->glue;
+
+    if(glue == NULL)
+    {
+        return;
+    }
+
+    for(u32 i = 0; i <= glue->mask; ++i)
+    {
+        zdb_zone_glue_node *node = glue->buckets[i];
+
+        while(node != NULL)
+        {
+            zdb_zone_glue_node *next = node->next;
+            free(node);
+            node = next;
+        }
+    }
+
+    free(glue->buckets);
+    ptr_vector_destroy(&glue->dirty);
+    free(glue);
+
+    zone->glue = NULL;
+}
+
+void
+zdb_zone_glue_build(zdb_zone *zone)
+{
+    u64 start = timeus();
+
+    zdb_zone_glue_destroy(zone);
+
+    zdb_zone_glue *glue;
+    MALLOC_OR_DIE(zdb_zone_glue*, glue, sizeof(zdb_zone_glue), ZDB_ZONE_GLUE_TAG);
+    MALLOC_OR_DIE(zdb_zone_glue_node**, glue->buckets, sizeof(zdb_zone_glue_node*) * ZDB_ZONE_GLUE_BUCKETS_MIN, ZDBGLUEB_TAG);
+    ZEROMEMORY(glue->buckets, sizeof(zdb_zone_glue_node*) * ZDB_ZONE_GLUE_BUCKETS_MIN);
+    ptr_vector_init(&glue->dirty);
+    glue->mask = ZDB_ZONE_GLUE_BUCKETS_MIN - 1;
+    glue->count = 0;
+    glue->wild_scans = 0;
+    glue->all_dirty = FALSE;
+    glue->wild_scope[0] = 0;
+
+    u32 linked = 0;
+
+    zdb_zone_label_iterator iter;
+    zdb_zone_label_iterator_init(&iter, zone);
+
+    while(zdb_zone_label_iterator_hasnext(&iter))
+    {
+        zdb_rr_label *rr_label = zdb_zone_label_iterator_next(&iter);
+
+        static const u16 target_types[2] = {TYPE_NS, TYPE_MX};
+
+        for(int t = 0; t < 2; ++t)
+        {
+            const zdb_packed_ttlrdata *rr = zdb_record_find(&rr_label->resource_record_set, target_types[t]);
+
+            while(rr != NULL)
+            {
+                const u8 *target = zdb_zone_glue_target(target_types[t], ZDB_PACKEDRECORD_PTR_RDATAPTR(rr), ZDB_PACKEDRECORD_PTR_RDATASIZE(rr));
+
+                if(target != NULL)
+                {
+                    hashcode hash = zdb_zone_glue_hash(target);
+
+                    if(zdb_zone_glue_node_find(glue, target, hash) == NULL)
+                    {
+                        zdb_rr_label *target_label;
+
+                        if(zdb_zone_glue_resolve(zone, target, &target_label))
+                        {
+                            zdb_zone_glue_node_add(glue, target, hash, target_label);
+
+                            if(target_label != NULL)
+                            {
+                                ++linked;
+                            }
+                        }
+                    }
+                }
+
+                rr = rr->next;
+            }
+        }
+    }
+
+    zone->glue = glue;
+
+    u64 stop = timeus();
+
+    log_info("glue: %{dnsname}: %u in-zone targets, %u with addresses, linked in %lluus", zone->origin, glue->count, linked, stop - start);
+}
+
+/**
+ * Returns the highest name above the owner (or the owner itself) that is the child of a label with a wildcard.
+ * Creating or removing labels there changes the closest encloser of the names below it, so the wildcard may
+ * start or stop standing for them.
+ * 
+ * @return a pointer in fqdn, or NULL if no label above the owner has a wildcard
+ */
+
+static const u8*
+zdb_zone_glue_wild_scope(const zdb_zone *zone, const u8 *fqdn)
+{
+    dnslabel_vector name;
+    s32 name_top = dnsname_to_dnslabel_vector(fqdn, name);
+    s32 depth = name_top - zone->origin_vector.size; // labels of the owner below the apex
+    zdb_rr_label *rr_label = zone->apex;
+
+    for(s32 i = 0; (i < depth) && (rr_label != NULL); ++i)
+    {
+        if((rr_label->flags & ZDB_RR_LABEL_GOT_WILD) != 0)
+        {
+            const u8 *scope = fqdn;
+
+            for(s32 j = depth - i - 1; j > 0; --j)
+            {
+                scope += scope[0] + 1;
+            }
+
+            return scope;
+        }
+
+        rr_label = zdb_rr_label_find_child(rr_label, name[depth - i - 1]);
+    }
+
+    return NULL;
+}
+
+/**
+ * Marks the links of the names at or below fqdn.
+ */
+
+static void
+zdb_zone_glue_mark_below(zdb_zone_glue *glue, const u8 *fqdn)
+{
+    for(u32 i = 0; i <= glue->mask; ++i)
+    {
+        for(zdb_zone_glue_node *node = glue->buckets[i]; node != NULL; node = node->next)
+        {
+            for(const u8 *name = node->fqdn; name[0] != 0; name += name[0] + 1)
+            {
+                if(dnsname_equals_ignorecase(name, fqdn))
+                {
+                    zdb_zone_glue_node_mark(glue, node);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void
+zdb_zone_glue_touch(zdb_zone *zone, const u8 *fqdn, u16 rtype, const u8 *rdata, u16 rdata_size)
+{
+    zdb_zone_glue *glue = zone->glue;
+
+    if(glue == NULL)
+    {
+        return;
+    }
+
+    // a new target gets a node, resolved with the others
+
+    const u8 *target = zdb_zone_glue_target(rtype, rdata, rdata_size);
+
+    if(target != NULL)
+    {
+        hashcode hash = zdb_zone_glue_hash(target);
+
+        if((zdb_zone_glue_node_find(glue, target, hash) == NULL) && zdb_zone_glue_resolve(zone, target, NULL))
+        {
+            zdb_zone_glue_node_mark(glue, zdb_zone_glue_node_add(glue, target, hash, NULL));
+        }
+    }
+
+    if(glue->all_dirty)
+    {
+        return;
+    }
+
+    if((fqdn[0] == 1) && (fqdn[1] == '*'))
+    {
+        // a wildcard can stand for any name under its parent
+
+        glue->all_dirty = TRUE;
+        return;
+    }
+
+    // below a wildcard, the names under the created or removed labels may resolve to it or stop doing so
+
+    const u8 *wild_scope = zdb_zone_glue_wild_scope(zone, fqdn);
+
+    if((wild_scope != NULL) && !dnsname_equals_ignorecase(wild_scope, glue->wild_scope))
+    {
+        if(++glue->wild_scans > ZDB_ZONE_GLUE_WILD_SCANS_MAX)
+        {
+            glue->all_dirty = TRUE;
+            return;
+        }
+
+        zdb_zone_glue_mark_below(glue, wild_scope);
+        dnsname_copy(glue->wild_scope, wild_scope);
+    }
+
+    // the owner, and the names above it as empty non-terminals come and go with their children
+
+    u32 origin_len = dnsname_len(zone->origin);
+
+    while(dnsname_len(fqdn) >= origin_len)
+    {
+        zdb_zone_glue_node *node = zdb_zone_glue_node_find(glue, fqdn, zdb_zone_glue_hash(fqdn));
+
+        if(node != NULL)
+        {
+            zdb_zone_glue_node_mark(glue, node);
+        }
+
+        fqdn += fqdn[0] + 1;
+    }
+}
+
+void
+zdb_zone_glue_update(zdb_zone *zone)
+{
+    zdb_zone_glue *glue = zone->glue;
+
+    if(glue == NULL)
+    {
+        return;
+    }
+
+    u64 start = timeus();
+    u32 resolved;
+
+    if(glue->all_dirty)
+    {
+        for(u32 i = 0; i <= glue->mask; ++i)
+        {
+            for(zdb_zone_glue_node *node = glue->buckets[i]; node != NULL; node = node->next)
+            {
+                zdb_zone_glue_resolve(zone, node->fqdn, &node->label);
+                node->dirty = FALSE;
+            }
+        }
+
+        resolved = glue->count;
+        glue->all_dirty = FALSE;
+    }
+    else
+    {
+        for(s32 i = 0; i <= ptr_vector_last_index(&glue->dirty); ++i)
+        {
+            zdb_zone_glue_node *node = (zdb_zone_glue_node*)ptr_vector_get(&glue->dirty, i);
+            zdb_zone_glue_resolve(zone, node->fqdn, &node->label);
+            node->dirty = FALSE;
+        }
+
+        resolved = ptr_vector_size(&glue->dirty);
+    }
+
+    ptr_vector_clear(&glue->dirty);
+    glue->wild_scans = 0;
+    glue->wild_scope[0] = 0;
+
+    if(resolved > 0)
+    {
+        u64 stop = timeus();
+        log_debug("glue: %{dnsname}: %u of %u links resolved again in %lluus", zone->origin, resolved, glue->count, stop - start);
+    }
+}
+
+bool
+zdb_zone_glue_find(const zdb_zone *zone, const u8 *fqdn, zdb_rr_label **labelp)
+{
+    const zdb_zone_glue *glue = zone->glue;
+
+    if(glue == NULL)
+    {
+        return FALSE;
+    }
+
+    const zdb_zone_glue_node *node = zdb_zone_glue_node_find(glue, fqdn, zdb_zone_glue_hash(fqdn));
+
+    if(node == NULL)
+    {
+        return FALSE;
+    }
+
+    *labelp = node->label;
+
+    return TRUE;
+}
+
+#endif
+
+/** @} */
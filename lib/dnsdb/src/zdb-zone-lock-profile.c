@@ -0,0 +1,400 @@
+/*------------------------------------------------------------------------------
+*
+* Copyright (c) 2011-2019, EURid vzw. All rights reserved.
+* The YADIFA TM software product is provided under the BSD 3-clause license:
+* 
+* Redistribution and use in source and binary forms, with or without 
+* modification, are permitted provided that the following conditions
+* are met:
+*
+*        * Redistributions of source code must retain the above copyright 
+*          notice, this list of conditions and the following disclaimer.
+*        * Redistributions in binary form must reproduce the above copyright 
+*          notice, this list of conditions and the following disclaimer in the 
+*          documentation and/or other materials provided with the distribution.
+*        * Neither the name of EURid nor the names of its contributors may be 
+*          used to endorse or promote products derived from this software 
+*          without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*------------------------------------------------------------------------------
+*
+*/
+/** @defgroup dnsdbzone Zone related functions
+ *  @ingroup dnsdb
+ *  @brief Zone lock contention profiler
+ *
+ *  Every thread that measures a wait or a hold above the threshold gets its own
+ *  ring of samples.  The rings are registered in a list and are only read when
+ *  the profile is dumped.
+ *
+ * @{
+ */
+
+#include "dnsdb/dnsdb-config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <dnscore/dnsname.h>
+#include <dnscore/format.h>
+#include <dnscore/logger.h>
+#include <dnscore/mutex.h>
+
+#include "dnsdb/zdb-zone-lock-profile.h"
+
+extern logger_handle* g_database_logger;
+#define MODULE_MSG_HANDLE g_database_logger
+
+#define ZLOCKPRF_TAG 0x4652504b434f4c5a
+
+#define ZDB_ZONE_LOCK_PROFILE_SAMPLE_COUNT 256
+
+struct zdb_zone_lock_profile_sample_s
+{
+    u64 duration_ns;
+    u64 epoch_us;               // when the sample has been taken
+    u8 owner;
+    u8 other;
+    u8 kind;
+    u8 origin[MAX_DOMAIN_LENGTH];
+};
+
+typedef struct zdb_zone_lock_profile_sample_s zdb_zone_lock_profile_sample_s;
+
+struct zdb_zone_lock_profile_buffer_s
+{
+    struct zdb_zone_lock_profile_buffer_s *next;
+    mutex_t mtx;                // only contended while the profile is being dumped
+    u32 count;                  // number of samples in the ring
+    u32 index;                  // where the next sample goes
+    zdb_zone_lock_profile_sample_s sample[ZDB_ZONE_LOCK_PROFILE_SAMPLE_COUNT];
+};
+
+typedef struct zdb_zone_lock_profile_buffer_s zdb_zone_lock_profile_buffer_s;
+
+struct zdb_zone_lock_profile_group_s
+{
+    const zdb_zone_lock_profile_sample_s *sample;   // the first sample of the group
+    u64 count;
+    u64 total_ns;
+    u64 max_ns;
+};
+
+typedef struct zdb_zone_lock_profile_group_s zdb_zone_lock_profile_group_s;
+
+volatile u64 zdb_zone_lock_profile_threshold_ns = ZDB_ZONE_LOCK_PROFILE_THRESHOLD_DEFAULT;
+
+static pthread_key_t zdb_zone_lock_profile_key;
+static pthread_once_t zdb_zone_lock_profile_key_once = PTHREAD_ONCE_INIT;
+static mutex_t zdb_zone_lock_profile_mtx = MUTEX_INITIALIZER;
+static zdb_zone_lock_profile_buffer_s *zdb_zone_lock_profile_list = NULL;
+
+static const char* zdb_zone_lock_profile_owner_names[11]=
+{
+    "NOBODY",       // 0x00
+    "SIMPLEREADER", // 0x01
+    "RRSIG_UPDATER",// 0x82
+    NULL,
+    "XFR",          // 0x84
+    "REFRESH",      // 0x85
+    "DYNUPDATE",    // 0x86
+    "UNFREEZE",     // 0x87
+    "INVALIDATE",   // 0x88
+    "REPLACE",      // 0x89
+    "LOAD"          // 0x8a
+};
+
+static const char* zdb_zone_lock_profile_kind_names[2] =
+{
+    "wait",
+    "hold"
+};
+
+static void
+zdb_zone_lock_profile_key_init()
+{
+    if(pthread_key_create(&zdb_zone_lock_profile_key, NULL) != 0)
+    {
+        log_quit("zone-lock-profile: pthread_key_create = %r", ERRNO_ERROR);
+    }
+}
+
+void
+zdb_zone_lock_profile_set_threshold(u64 threshold_ns)
+{
+    zdb_zone_lock_profile_threshold_ns = threshold_ns;
+}
+
+const char *
+zdb_zone_lock_profile_owner_name(u8 owner)
+{
+    owner &= ZDB_ZONE_MUTEX_LOCKMASK_FLAG;
+    
+    if(owner < sizeof(zdb_zone_lock_profile_owner_names) / sizeof(char*))
+    {
+        return zdb_zone_lock_profile_owner_names[owner];
+    }
+    
+    if(owner == (ZDB_ZONE_MUTEX_DESTROY & ZDB_ZONE_MUTEX_LOCKMASK_FLAG))
+    {
+        return "DESTROY";
+    }
+    
+    return NULL;
+}
+
+static zdb_zone_lock_profile_buffer_s *
+zdb_zone_lock_profile_buffer_get()
+{
+    pthread_once(&zdb_zone_lock_profile_key_once, zdb_zone_lock_profile_key_init);
+    
+    zdb_zone_lock_profile_buffer_s *buffer = (zdb_zone_lock_profile_buffer_s*)pthread_getspecific(zdb_zone_lock_profile_key);
+    
+    if(buffer == NULL)
+    {
+        MALLOC_OR_DIE(zdb_zone_lock_profile_buffer_s*, buffer, sizeof(zdb_zone_lock_profile_buffer_s), ZLOCKPRF_TAG);
+        mutex_init(&buffer->mtx);
+        buffer->count = 0;
+        buffer->index = 0;
+        
+        // the buffer outlives the thread so its samples can still be dumped
+        
+        mutex_lock(&zdb_zone_lock_profile_mtx);
+        buffer->next = zdb_zone_lock_profile_list;
+        zdb_zone_lock_profile_list = buffer;
+        mutex_unlock(&zdb_zone_lock_profile_mtx);
+        
+        pthread_setspecific(zdb_zone_lock_profile_key, buffer);
+    }
+    
+    return buffer;
+}
+
+void
+zdb_zone_lock_profile_record(const u8 *origin, u8 owner, u8 other, u8 kind, u64 duration_ns)
+{
+    zdb_zone_lock_profile_buffer_s *buffer = zdb_zone_lock_profile_buffer_get();
+    
+    mutex_lock(&buffer->mtx);
+    
+    zdb_zone_lock_profile_sample_s *sample = &buffer->sample[buffer->index];
+    sample->duration_ns = duration_ns;
+    sample->epoch_us = timeus();
+    sample->owner = owner;
+    sample->other = other;
+    sample->kind = kind;
+    dnsname_copy(sample->origin, origin);
+    
+    buffer->index = (buffer->index + 1) % ZDB_ZONE_LOCK_PROFILE_SAMPLE_COUNT;
+    
+    if(buffer->count < ZDB_ZONE_LOCK_PROFILE_SAMPLE_COUNT)
+    {
+        ++buffer->count;
+    }
+    
+    mutex_unlock(&buffer->mtx);
+}
+
+static int
+zdb_zone_lock_profile_sample_duration_compare(const void *a_, const void *b_)
+{
+    const zdb_zone_lock_profile_sample_s *a = (const zdb_zone_lock_profile_sample_s*)a_;
+    const zdb_zone_lock_profile_sample_s *b = (const zdb_zone_lock_profile_sample_s*)b_;
+    
+    if(a->duration_ns != b->duration_ns)
+    {
+        return (a->duration_ns > b->duration_ns)?-1:1;
+    }
+    
+    return 0;
+}
+
+static int
+zdb_zone_lock_profile_sample_group_compare(const void *a_, const void *b_)
+{
+    const zdb_zone_lock_profile_sample_s *a = (const zdb_zone_lock_profile_sample_s*)a_;
+    const zdb_zone_lock_profile_sample_s *b = (const zdb_zone_lock_profile_sample_s*)b_;
+    
+    int d = dnsname_compare(a->origin, b->origin);
+    
+    if(d == 0)
+    {
+        d = (int)a->owner - (int)b->owner;
+        
+        if(d == 0)
+        {
+            d = (int)a->kind - (int)b->kind;
+        }
+    }
+    
+    return d;
+}
+
+static int
+zdb_zone_lock_profile_group_total_compare(const void *a_, const void *b_)
+{
+    const zdb_zone_lock_profile_group_s *a = (const zdb_zone_lock_profile_group_s*)a_;
+    const zdb_zone_lock_profile_group_s *b = (const zdb_zone_lock_profile_group_s*)b_;
+    
+    if(a->total_ns != b->total_ns)
+    {
+        return (a->total_ns > b->total_ns)?-1:1;
+    }
+    
+    return 0;
+}
+
+static void
+zdb_zone_lock_profile_write_owner_json(output_stream *os, const char *field, u8 owner)
+{
+    const char *name = zdb_zone_lock_profile_owner_name(owner);
+    
+    if(name != NULL)
+    {
+        osformat(os, ",\"%s\":\"%s\"", field, name);
+    }
+    else
+    {
+        osformat(os, ",\"%s\":\"%02x\"", field, owner);
+    }
+}
+
+ya_result
+zdb_zone_lock_profile_write_json(output_stream *os, u32 max_count)
+{
+    zdb_zone_lock_profile_sample_s *samples = NULL;
+    u32 sample_count = 0;
+    
+    // copy the samples of all the threads
+    
+    mutex_lock(&zdb_zone_lock_profile_mtx);
+    
+    u32 sample_capacity = 0;
+    
+    for(zdb_zone_lock_profile_buffer_s *buffer = zdb_zone_lock_profile_list; buffer != NULL; buffer = buffer->next)
+    {
+        sample_capacity += ZDB_ZONE_LOCK_PROFILE_SAMPLE_COUNT;
+    }
+    
+    if(sample_capacity > 0)
+    {
+        MALLOC_OR_DIE(zdb_zone_lock_profile_sample_s*, samples, sizeof(zdb_zone_lock_profile_sample_s) * sample_capacity, ZLOCKPRF_TAG);
+        
+        for(zdb_zone_lock_profile_buffer_s *buffer = zdb_zone_lock_profile_list; buffer != NULL; buffer = buffer->next)
+        {
+            mutex_lock(&buffer->mtx);
+            memcpy(&samples[sample_count], buffer->sample, sizeof(zdb_zone_lock_profile_sample_s) * buffer->count);
+            sample_count += buffer->count;
+            mutex_unlock(&buffer->mtx);
+        }
+    }
+    
+    mutex_unlock(&zdb_zone_lock_profile_mtx);
+    
+    u64 now = timeus();
+    
+    osformat(os, "{\"unit\":\"ns\",\"threshold\":%llu,\"samples\":%u,\"worst\":[", zdb_zone_lock_profile_threshold_ns, sample_count);
+    
+    if(sample_count > 0)
+    {
+        qsort(samples, sample_count, sizeof(zdb_zone_lock_profile_sample_s), zdb_zone_lock_profile_sample_duration_compare);
+    }
+    
+    for(u32 i = 0; i < MIN(sample_count, max_count); ++i)
+    {
+        const zdb_zone_lock_profile_sample_s *sample = &samples[i];
+        
+        osformat(os, "%s{\"zone\":\"%{dnsname}\",\"kind\":\"%s\"", (i > 0)?",":"", sample->origin, zdb_zone_lock_profile_kind_names[sample->kind]);
+        zdb_zone_lock_profile_write_owner_json(os, "owner", sample->owner);
+        if(sample->kind == ZDB_ZONE_LOCK_PROFILE_WAIT)
+        {
+            zdb_zone_lock_profile_write_owner_json(os, "holder", sample->other);
+        }
+        osformat(os, ",\"duration\":%llu,\"age_ms\":%llu}", sample->duration_ns, (now - sample->epoch_us) / 1000);
+    }
+    
+    osprint(os, "],\"owners\":[");
+    
+    // group the samples by zone, owner and kind, the heaviest groups first
+    
+    if(sample_count > 0)
+    {
+        qsort(samples, sample_count, sizeof(zdb_zone_lock_profile_sample_s), zdb_zone_lock_profile_sample_group_compare);
+        
+        zdb_zone_lock_profile_group_s *groups;
+        u32 group_count = 0;
+        
+        MALLOC_OR_DIE(zdb_zone_lock_profile_group_s*, groups, sizeof(zdb_zone_lock_profile_group_s) * sample_count, ZLOCKPRF_TAG);
+        
+        for(u32 i = 0; i < sample_count; ++i)
+        {
+            const zdb_zone_lock_profile_sample_s *sample = &samples[i];
+            
+            if((group_count == 0) || (zdb_zone_lock_profile_sample_group_compare(groups[group_count - 1].sample, sample) != 0))
+            {
+                zdb_zone_lock_profile_group_s *group = &groups[group_count++];
+                group->sample = sample;
+                group->count = 0;
+                group->total_ns = 0;
+                group->max_ns = 0;
+            }
+            
+            zdb_zone_lock_profile_group_s *group = &groups[group_count - 1];
+            ++group->count;
+            group->total_ns += sample->duration_ns;
+            group->max_ns = MAX(group->max_ns, sample->duration_ns);
+        }
+        
+        qsort(groups, group_count, sizeof(zdb_zone_lock_profile_group_s), zdb_zone_lock_profile_group_total_compare);
+        
+        for(u32 i = 0; i < MIN(group_count, max_count); ++i)
+        {
+            const zdb_zone_lock_profile_group_s *group = &groups[i];
+            
+            osformat(os, "%s{\"zone\":\"%{dnsname}\",\"kind\":\"%s\"", (i > 0)?",":"", group->sample->origin, zdb_zone_lock_profile_kind_names[group->sample->kind]);
+            zdb_zone_lock_profile_write_owner_json(os, "owner", group->sample->owner);
+            osformat(os, ",\"count\":%llu,\"total\":%llu,\"max\":%llu}", group->count, group->total_ns, group->max_ns);
+        }
+        
+        free(groups);
+    }
+    
+    free(samples);
+    
+    return osprint(os, "]}");
+}
+
+void
+zdb_zone_lock_profile_finalize()
+{
+    zdb_zone_lock_profile_threshold_ns = ZDB_ZONE_LOCK_PROFILE_DISABLED;
+    
+    mutex_lock(&zdb_zone_lock_profile_mtx);
+    
+    zdb_zone_lock_profile_buffer_s *buffer = zdb_zone_lock_profile_list;
+    zdb_zone_lock_profile_list = NULL;
+    
+    mutex_unlock(&zdb_zone_lock_profile_mtx);
+    
+    while(buffer != NULL)
+    {
+        zdb_zone_lock_profile_buffer_s *next = buffer->next;
+        mutex_destroy(&buffer->mtx);
+        free(buffer);
+        buffer = next;
+    }
+}
+
+/** @} */
@@ -69,6 +69,8 @@
 #include "dnsdb/nsec3.h"
 #endif
 
+#include "dnsdb/zdb-zone-lock-profile.h"
+
 #if DNSCORE_HAS_MUTEX_DEBUG_SUPPORT
 #include <dnscore/ptr_set.h>
 #include <dnsdb/zdb-zone-lock-monitor.h>
@@ -191,6 +193,72 @@ zdb_zone_lock_set_monitor()
 }
 #endif
 
+/**
+ * Starts the hold time of the profiler if the owner is the first one to take the lock.
+ * The zone mutex must be held.
+ */
+
+static inline void
+zdb_zone_lock_profile_acquired(zdb_zone *zone)
+{
+    if(zone->lock_count == 1)
+    {
+        zone->lock_profile_since = timens_monotonic();
+    }
+}
+
+/**
+ * Starts the wait time of the profiler the first time an owner has to wait for the lock.
+ * The zone mutex must be held.
+ */
+
+static inline void
+zdb_zone_lock_profile_waits(zdb_zone *zone, u64 *wait_start, u8 *wait_holder)
+{
+    if(*wait_start == 0)
+    {
+        *wait_start = timens_monotonic();
+        *wait_holder = zone->lock_owner;
+    }
+}
+
+/**
+ * Once a writer, or an owner that reserved the zone for a writer, holds the
+ * lock, the heap fallbacks are watched for the arena of the zone.
+ * The zone mutex must be held.
+ */
+
+static inline void
+zdb_zone_lock_arena_acquired(zdb_zone *zone)
+{
+#if ZDB_ZONE_ARENA_SUPPORT
+    if((zone->arena != NULL) && ((zone->lock_owner > ZDB_ZONE_MUTEX_SIMPLEREADER) || (zone->lock_reserved_owner != ZDB_ZONE_MUTEX_NOBODY)))
+    {
+        zdb_zone_arena_writer_enters(zone->arena);
+    }
+#else
+    (void)zone;
+#endif
+}
+
+/**
+ * The last owner released the lock.
+ * The zone mutex must be held.
+ */
+
+static inline void
+zdb_zone_lock_arena_released(zdb_zone *zone)
+{
+#if ZDB_ZONE_ARENA_SUPPORT
+    if(zone->arena != NULL)
+    {
+        zdb_zone_arena_writer_leaves(zone->arena);
+    }
+#else
+    (void)zone;
+#endif
+}
+
 bool
 zdb_zone_islocked(zdb_zone *zone)
 {
@@ -242,6 +310,8 @@ zdb_zone_lock(zdb_zone *zone, u8 owner)
     u64 start = timeus();
 #endif
 
+    u64 wait_start = 0;
+    u8 wait_holder = ZDB_ZONE_MUTEX_NOBODY;
     mutex_t *mutex = &zone->lock_mutex;
     
     mutex_lock(mutex);
@@ -266,10 +336,14 @@ zdb_zone_lock(zdb_zone *zone, u8 owner)
 
             zone->lock_owner = owner & ZDB_ZONE_MUTEX_LOCKMASK_FLAG;
             zone->lock_count++;
+            zdb_zone_lock_profile_acquired(zone);
+            zdb_zone_lock_arena_acquired(zone);
 
             break;
         }
         
+        zdb_zone_lock_profile_waits(zone, &wait_start, &wait_holder);
+        
 #if ZDB_HAS_MUTEX_DEBUG_SUPPORT
         zdb_zone_lock_monitor_waits(holder);
 #endif
@@ -297,6 +371,11 @@ zdb_zone_lock(zdb_zone *zone, u8 owner)
     
     mutex_unlock(mutex);
     
+    if(wait_start != 0)
+    {
+        zdb_zone_lock_profile_sample(zone->origin, owner, wait_holder, ZDB_ZONE_LOCK_PROFILE_WAIT, wait_start);
+    }
+    
 #if ZDB_HAS_OLD_MUTEX_DEBUG_SUPPORT
     zone->lock_trace = debug_stacktrace_get();
     zone->lock_id = pthread_self();
@@ -327,6 +406,8 @@ zdb_zone_trylock(zdb_zone *zone, u8 owner)
 
         zone->lock_owner = owner & ZDB_ZONE_MUTEX_LOCKMASK_FLAG;
         zone->lock_count++;
+        zdb_zone_lock_profile_acquired(zone);
+        zdb_zone_lock_arena_acquired(zone);
 
 #if ZONE_MUTEX_LOG
         log_debug7("acquired lock for zone %{dnsname}@%p for %x (#%i)", zone->origin, zone, owner, zone->lock_count);
@@ -371,6 +452,8 @@ zdb_zone_trylock_wait(zdb_zone *zone, u64 usec, u8 owner)
     
     u64 start = timeus();
     bool ret = FALSE;
+    u64 wait_start = 0;
+    u8 wait_holder = ZDB_ZONE_MUTEX_NOBODY;
 
     mutex_t *mutex = &zone->lock_mutex;
     
@@ -392,11 +475,15 @@ zdb_zone_trylock_wait(zdb_zone *zone, u64 usec, u8 owner)
 
             zone->lock_owner = owner & ZDB_ZONE_MUTEX_LOCKMASK_FLAG;
             zone->lock_count++;
+            zdb_zone_lock_profile_acquired(zone);
+            zdb_zone_lock_arena_acquired(zone);
 
             ret = TRUE;
             break;
         }
         
+        zdb_zone_lock_profile_waits(zone, &wait_start, &wait_holder);
+        
 #if DNSCORE_HAS_MUTEX_DEBUG_SUPPORT
         s64 d = timeus() - start;
         if(d > MUTEX_WAITED_TOO_MUCH_TIME_US)
@@ -418,6 +505,11 @@ zdb_zone_trylock_wait(zdb_zone *zone, u64 usec, u8 owner)
     
     mutex_unlock(mutex);
     
+    if(wait_start != 0)
+    {
+        zdb_zone_lock_profile_sample(zone->origin, owner, wait_holder, ZDB_ZONE_LOCK_PROFILE_WAIT, wait_start);
+    }
+    
 #if DNSCORE_HAS_MUTEX_DEBUG_SUPPORT
     zone->lock_trace = debug_stacktrace_get();
     zone->lock_id = pthread_self();
@@ -436,6 +528,9 @@ zdb_zone_unlock(zdb_zone *zone, u8 owner)
     log_debug7("releasing lock for zone %{dnsname}@%p by %x (owned by %x)", zone->origin, zone, owner, zone->lock_owner);
 #endif
 
+    u64 hold_start = 0;
+    u8 hold_owner = ZDB_ZONE_MUTEX_NOBODY;
+    
     mutex_lock(&zone->lock_mutex);
     
 #if ZDB_HAS_MUTEX_DEBUG_SUPPORT
@@ -459,6 +554,9 @@ zdb_zone_unlock(zdb_zone *zone, u8 owner)
     
     if(zone->lock_count == 0)
     {
+        zdb_zone_lock_arena_released(zone);
+        hold_start = zone->lock_profile_since;
+        hold_owner = zone->lock_owner;
         zone->lock_owner = ZDB_ZONE_MUTEX_NOBODY;
         cond_notify(&zone->lock_cond);
     }
@@ -476,6 +574,11 @@ zdb_zone_unlock(zdb_zone *zone, u8 owner)
 #endif
     
     mutex_unlock(&zone->lock_mutex);
+    
+    if(hold_start != 0)
+    {
+        zdb_zone_lock_profile_sample(zone->origin, hold_owner, ZDB_ZONE_MUTEX_NOBODY, ZDB_ZONE_LOCK_PROFILE_HOLD, hold_start);
+    }
 }
 
 void
@@ -489,6 +592,9 @@ zdb_zone_double_lock(zdb_zone *zone, u8 owner, u8 secondary_owner)
     u64 start = timeus();
 #endif
     
+    u64 wait_start = 0;
+    u8 wait_holder = ZDB_ZONE_MUTEX_NOBODY;
+    
     mutex_lock(&zone->lock_mutex);
     
 #if ZDB_HAS_MUTEX_DEBUG_SUPPORT
@@ -515,7 +621,9 @@ zdb_zone_double_lock(zdb_zone *zone, u8 owner, u8 secondary_owner)
 
                 zone->lock_owner = owner & ZDB_ZONE_MUTEX_LOCKMASK_FLAG;
                 zone->lock_count++;
+                zdb_zone_lock_profile_acquired(zone);
                 zone->lock_reserved_owner = secondary_owner & ZDB_ZONE_MUTEX_LOCKMASK_FLAG;
+                zdb_zone_lock_arena_acquired(zone);
             
 #if ZONE_MUTEX_LOG
                 log_debug7("acquired lock for zone %{dnsname}@%p for %x (#%i)", zone->origin, zone, owner, zone->lock_count);
@@ -529,6 +637,8 @@ zdb_zone_double_lock(zdb_zone *zone, u8 owner, u8 secondary_owner)
             // the secondary owner is already taken
         }
 
+        zdb_zone_lock_profile_waits(zone, &wait_start, &wait_holder);
+        
 #if ZDB_HAS_MUTEX_DEBUG_SUPPORT
         zdb_zone_lock_monitor_waits(holder);
 #endif
@@ -552,6 +662,11 @@ zdb_zone_double_lock(zdb_zone *zone, u8 owner, u8 secondary_owner)
     
     mutex_unlock(&zone->lock_mutex);
     
+    if(wait_start != 0)
+    {
+        zdb_zone_lock_profile_sample(zone->origin, owner, wait_holder, ZDB_ZONE_LOCK_PROFILE_WAIT, wait_start);
+    }
+    
 #if DNSCORE_HAS_MUTEX_DEBUG_SUPPORT
     zone->lock_trace = debug_stacktrace_get();
     zone->lock_id = pthread_self();
@@ -586,7 +701,9 @@ zdb_zone_try_double_lock(zdb_zone *zone, u8 owner, u8 secondary_owner)
 
             zone->lock_owner = owner & ZDB_ZONE_MUTEX_LOCKMASK_FLAG;
             zone->lock_count++;
+            zdb_zone_lock_profile_acquired(zone);
             zone->lock_reserved_owner = secondary_owner & ZDB_ZONE_MUTEX_LOCKMASK_FLAG;
+            zdb_zone_lock_arena_acquired(zone);
 
 #if ZONE_MUTEX_LOG
             log_debug7("acquired lock for zone %{dnsname}@%p for %x (#%i)", zone->origin, zone, owner, zone->lock_count);
@@ -636,6 +753,9 @@ zdb_zone_double_unlock(zdb_zone *zone, u8 owner, u8 secondary_owner)
     log_debug7("releasing lock for zone %{dnsname}@%p by %x (owned by %x)", zone->origin, zone, owner, zone->lock_owner);
 #endif
 
+    u64 hold_start = 0;
+    u8 hold_owner = ZDB_ZONE_MUTEX_NOBODY;
+    
     mutex_lock(&zone->lock_mutex);
 
 #if ZDB_HAS_MUTEX_DEBUG_SUPPORT
@@ -657,6 +777,9 @@ zdb_zone_double_unlock(zdb_zone *zone, u8 owner, u8 secondary_owner)
     
     if(zone->lock_count == 0)
     {
+        zdb_zone_lock_arena_released(zone);
+        hold_start = zone->lock_profile_since;
+        hold_owner = zone->lock_owner;
         zone->lock_owner = ZDB_ZONE_MUTEX_NOBODY;
         cond_notify(&zone->lock_cond);
     }
@@ -674,6 +797,11 @@ zdb_zone_double_unlock(zdb_zone *zone, u8 owner, u8 secondary_owner)
 #endif
     
     mutex_unlock(&zone->lock_mutex);
+    
+    if(hold_start != 0)
+    {
+        zdb_zone_lock_profile_sample(zone->origin, hold_owner, ZDB_ZONE_MUTEX_NOBODY, ZDB_ZONE_LOCK_PROFILE_HOLD, hold_start);
+    }
 }
 
 /**
@@ -695,6 +823,11 @@ zdb_zone_transfer_lock(zdb_zone *zone, u8 owner, u8 secondary_owner)
     u64 start = timeus();
 #endif
 
+    u64 hold_start;
+    u8 hold_owner;
+    u64 wait_start = 0;
+    u8 wait_holder = ZDB_ZONE_MUTEX_NOBODY;
+    
     mutex_lock(&zone->lock_mutex);
     
 #if ZDB_HAS_MUTEX_DEBUG_SUPPORT
@@ -705,6 +838,8 @@ zdb_zone_transfer_lock(zdb_zone *zone, u8 owner, u8 secondary_owner)
     
     while(zone->lock_count != 1)
     {
+        zdb_zone_lock_profile_waits(zone, &wait_start, &wait_holder);
+        
 #if ZDB_HAS_MUTEX_DEBUG_SUPPORT
         zdb_zone_lock_monitor_waits(holder);
 #endif
@@ -725,8 +860,12 @@ zdb_zone_transfer_lock(zdb_zone *zone, u8 owner, u8 secondary_owner)
 #endif
     }
     
+    hold_start = zone->lock_profile_since;
+    hold_owner = zone->lock_owner;
+    zone->lock_profile_since = timens_monotonic();
     zone->lock_owner = secondary_owner & ZDB_ZONE_MUTEX_LOCKMASK_FLAG;
     zone->lock_reserved_owner = ZDB_ZONE_MUTEX_NOBODY;
+    zdb_zone_lock_arena_acquired(zone);
     
 
 #if ZONE_MUTEX_LOG
@@ -745,6 +884,13 @@ zdb_zone_transfer_lock(zdb_zone *zone, u8 owner, u8 secondary_owner)
 
     mutex_unlock(&zone->lock_mutex);
     
+    zdb_zone_lock_profile_sample(zone->origin, hold_owner, ZDB_ZONE_MUTEX_NOBODY, ZDB_ZONE_LOCK_PROFILE_HOLD, hold_start);
+    
+    if(wait_start != 0)
+    {
+        zdb_zone_lock_profile_sample(zone->origin, secondary_owner, wait_holder, ZDB_ZONE_LOCK_PROFILE_WAIT, wait_start);
+    }
+    
 #if ZDB_HAS_OLD_MUTEX_DEBUG_SUPPORT
     zone->lock_trace = debug_stacktrace_get();
     zone->lock_id = pthread_self();
@@ -770,6 +916,9 @@ zdb_zone_try_transfer_lock(zdb_zone *zone, u8 owner, u8 secondary_owner)
     log_debug7("transferring lock for zone %{dnsname}@%p from %x to %x (owned by %x:%x)", zone->origin, zone, owner, secondary_owner, zone->lock_owner, zone->lock_reserved_owner);
 #endif
     
+    u64 hold_start;
+    u8 hold_owner;
+    
     mutex_lock(&zone->lock_mutex);
     
 #if ZDB_HAS_MUTEX_DEBUG_SUPPORT
@@ -780,8 +929,12 @@ zdb_zone_try_transfer_lock(zdb_zone *zone, u8 owner, u8 secondary_owner)
     
     if(zone->lock_count == 1)
     {
+        hold_start = zone->lock_profile_since;
+        hold_owner = zone->lock_owner;
+        zone->lock_profile_since = timens_monotonic();
         zone->lock_owner = secondary_owner & ZDB_ZONE_MUTEX_LOCKMASK_FLAG;
         zone->lock_reserved_owner = ZDB_ZONE_MUTEX_NOBODY;
+        zdb_zone_lock_arena_acquired(zone);
         
         if((secondary_owner & ZDB_ZONE_MUTEX_EXCLUSIVE_FLAG) == 0)
         {
@@ -795,6 +948,8 @@ zdb_zone_try_transfer_lock(zdb_zone *zone, u8 owner, u8 secondary_owner)
         
         mutex_unlock(&zone->lock_mutex);
         
+        zdb_zone_lock_profile_sample(zone->origin, hold_owner, ZDB_ZONE_MUTEX_NOBODY, ZDB_ZONE_LOCK_PROFILE_HOLD, hold_start);
+        
 #if DNSCORE_HAS_MUTEX_DEBUG_SUPPORT
         zone->lock_trace = debug_stacktrace_get();
         zone->lock_id = pthread_self();
@@ -827,6 +982,11 @@ zdb_zone_exchange_locks(zdb_zone *zone, u8 owner, u8 secondary_owner)
     struct zdb_zone_lock_monitor *holder = zdb_zone_lock_monitor_new(zone, owner, secondary_owner);
 #endif
 
+    u64 hold_start;
+    u8 hold_owner;
+    u64 wait_start = 0;
+    u8 wait_holder = ZDB_ZONE_MUTEX_NOBODY;
+    
     mutex_lock(&zone->lock_mutex);
 
 #ifdef DEBUG
@@ -848,6 +1008,8 @@ zdb_zone_exchange_locks(zdb_zone *zone, u8 owner, u8 secondary_owner)
     
     while(zone->lock_count != 1)
     {
+        zdb_zone_lock_profile_waits(zone, &wait_start, &wait_holder);
+        
 #if ZDB_HAS_MUTEX_DEBUG_SUPPORT
         zdb_zone_lock_monitor_waits(holder);
 #endif
@@ -868,8 +1030,12 @@ zdb_zone_exchange_locks(zdb_zone *zone, u8 owner, u8 secondary_owner)
 #endif
     }
     
+    hold_start = zone->lock_profile_since;
+    hold_owner = zone->lock_owner;
+    zone->lock_profile_since = timens_monotonic();
     zone->lock_owner = secondary_owner & ZDB_ZONE_MUTEX_LOCKMASK_FLAG;
     zone->lock_reserved_owner = owner & ZDB_ZONE_MUTEX_LOCKMASK_FLAG;
+    zdb_zone_lock_arena_acquired(zone);
 
 #if ZONE_MUTEX_LOG
     log_debug7("exchanged locks for zone %{dnsname}@%p from %x to %x (#%i)", zone->origin, zone, owner, secondary_owner, zone->lock_count);
@@ -887,6 +1053,13 @@ zdb_zone_exchange_locks(zdb_zone *zone, u8 owner, u8 secondary_owner)
 
     mutex_unlock(&zone->lock_mutex);
     
+    zdb_zone_lock_profile_sample(zone->origin, hold_owner, ZDB_ZONE_MUTEX_NOBODY, ZDB_ZONE_LOCK_PROFILE_HOLD, hold_start);
+    
+    if(wait_start != 0)
+    {
+        zdb_zone_lock_profile_sample(zone->origin, secondary_owner, wait_holder, ZDB_ZONE_LOCK_PROFILE_WAIT, wait_start);
+    }
+    
 #if DNSCORE_HAS_MUTEX_DEBUG_SUPPORT
     zone->lock_trace = debug_stacktrace_get();
     zone->lock_id = pthread_self();
@@ -62,12 +62,12 @@ extern logger_handle* g_database_logger;
 static void
 zdb_zone_maintenance_rrsig_coverage_init(zdb_zone_maintenance_ctx* mctx, u32_set *type_coverage)
 {
-    btree_iterator iter;
-    btree_iterator_init(mctx->label->resource_record_set, &iter);
+    zdb_rr_collection_iterator iter;
+    zdb_rr_collection_iterator_init(mctx->label->resource_record_set, &iter);
 
-    while(btree_iterator_hasnext(&iter))
+    while(zdb_rr_collection_iterator_hasnext(&iter))
     {
-        btree_node *rr_node = btree_iterator_next_node(&iter);
+        zdb_rr_collection_node *rr_node = zdb_rr_collection_iterator_next_node(&iter);
         u16 type = (u16)rr_node->hash;
         if((type != TYPE_NSEC) && (type != TYPE_RRSIG))
         {
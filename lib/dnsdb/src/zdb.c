@@ -67,12 +67,14 @@ extern logger_handle* g_database_logger;
 
 #include "dnsdb/zdb_zone.h"
 #include "dnsdb/zdb_zone_label.h"
+#include "dnsdb/zdb_zone_write.h"
 #include "dnsdb/zdb_rr_label.h"
 #include "dnsdb/zdb_record.h"
 #include "dnsdb/zdb_utils.h"
 #include "dnsdb/dictionary.h"
 #include "dnsdb/journal.h"
 #include "dnsdb/zdb-zone-garbage.h"
+#include "dnsdb/zdb-zone-lock-profile.h"
 
 #if ZDB_OPENSSL_SUPPORT
 #include <openssl/ssl.h>
@@ -268,6 +270,12 @@ zdb_finalize()
     journal_finalise();
     
     zdb_zone_garbage_finalize();
+
+    zdb_zone_write_text_finalize();
+    
+    zdb_zone_lock_profile_finalize();
+
+    zdb_zone_query_count_finalize();
         
 #if ZDB_HAS_DNSSEC_SUPPORT
     dnssec_keystore_destroy();
@@ -321,6 +329,8 @@ zdb_create(zdb* db)
 
 
     db->root = zone_label; /* native order */
+
+    zdb_zone_apex_index_init(db);
         
     db->alarm_handle = alarm_open((const u8*)"\010d@tabase"); // a name that is not likely to be used for a domain as it has invalid chars
     
@@ -337,6 +347,7 @@ zdb_set_zone(zdb *db, zdb_zone* zone)
     zdb_zone *old_zone = label->zone;
     zdb_zone_acquire(zone);
     label->zone = zone;
+    zdb_zone_apex_index_set(db, &zone->origin_vector, label);
 #ifdef DEBUG
     log_debug("zdb: added zone %{dnsname}@%p", zone->origin, zone);
 #endif
@@ -344,6 +355,34 @@ zdb_set_zone(zdb *db, zdb_zone* zone)
     return old_zone;
 }
 
+zdb_zone *
+zdb_replace_zone(zdb *db, zdb_zone* zone)
+{
+    yassert(zone != NULL);
+    
+    // the reader lock only prevents the label from being removed while the pointer is exchanged
+    
+    zdb_lock(db, ZDB_MUTEX_READER);
+    zdb_zone_label *label = zdb_zone_label_find(db, &zone->origin_vector); // zdb_replace_zone
+    
+    if((label == NULL) || (label->zone == NULL))
+    {
+        zdb_unlock(db, ZDB_MUTEX_READER);
+        
+        // first instance: the label needs to be created
+        
+        return zdb_set_zone(db, zone);
+    }
+    
+    zdb_zone_acquire(zone);
+    zdb_zone *old_zone = (zdb_zone*)__sync_lock_test_and_set(&label->zone, zone);
+#ifdef DEBUG
+    log_debug("zdb: replaced zone %{dnsname}@%p by %p", zone->origin, old_zone, zone);
+#endif
+    zdb_unlock(db, ZDB_MUTEX_READER);
+    return old_zone;
+}
+
 zdb_zone *
 zdb_remove_zone(zdb *db, dnsname_vector *name)
 {
@@ -354,6 +393,7 @@ zdb_remove_zone(zdb *db, dnsname_vector *name)
     zdb_zone *old_zone = NULL;
     if(label != NULL)
     {
+        zdb_zone_apex_index_remove(db, name);
         old_zone = label->zone;        
         label->zone = NULL;
 #ifdef DEBUG
@@ -504,11 +544,13 @@ zdb_append_ip_records(zdb* db, const u8* name_, host_address *target_list)
     {
         zdb_zone_label* zone_label = zone_label_stack[sp];
 
-        if(zone_label->zone != NULL)
+        zdb_zone *zone = zone_label->zone; // the instance may be replaced while it is being read
+        
+        if(zone != NULL)
         {
-            zdb_zone_lock(zone_label->zone, ZDB_ZONE_MUTEX_SIMPLEREADER);
+            zdb_zone_lock(zone, ZDB_ZONE_MUTEX_SIMPLEREADER);
             /* Get the label, instead of the type in the label */
-            zdb_rr_label* rr_label = zdb_rr_label_find_exact(zone_label->zone->apex, name.labels, name.size - sp); // zone is locked
+            zdb_rr_label* rr_label = zdb_rr_label_find_exact(zone->apex, name.labels, name.size - sp); // zone is locked
 
             if(rr_label != NULL)
             {
@@ -532,14 +574,14 @@ zdb_append_ip_records(zdb* db, const u8* name_, host_address *target_list)
                     rrset = rrset->next;
                 }
                 
-                zdb_zone_unlock(zone_label->zone, ZDB_ZONE_MUTEX_SIMPLEREADER);
+                zdb_zone_unlock(zone, ZDB_ZONE_MUTEX_SIMPLEREADER);
 
                 zdb_unlock(db, ZDB_MUTEX_READER); // zdb_query_ip_records (success)
                 
                 return ret;
             }
             
-            zdb_zone_unlock(zone_label->zone, ZDB_ZONE_MUTEX_SIMPLEREADER);
+            zdb_zone_unlock(zone, ZDB_ZONE_MUTEX_SIMPLEREADER);
         }
 
         sp--;
@@ -567,10 +609,14 @@ zdb_destroy(zdb* db) // mutex checked
 {
     zdb_lock(db, ZDB_MUTEX_WRITER); // zdb_destroy
 
+    zdb_zone_garbage_release_retired(db);
+    
     alarm_close(db->alarm_handle);
     db->alarm_handle = ALARM_HANDLE_INVALID;
     
     zdb_zone_label_destroy(&db->root);  /* native order */
+
+    zdb_zone_apex_index_finalize(db);
     
     zdb_unlock(db, ZDB_MUTEX_WRITER); // zdb_destroy
     
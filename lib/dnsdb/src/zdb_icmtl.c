@@ -79,6 +79,7 @@
 
 #include "dnsdb/nsec-chain-replay.h"
 #include "dnsdb/nsec3-chain-replay.h"
+#include "dnsdb/zdb-zone-glue.h"
 
 #ifndef HAS_DYNUPDATE_DIFF_ENABLED
 #error "HAS_DYNUPDATE_DIFF_ENABLED not defined"
@@ -246,6 +247,9 @@ zdb_icmtl_replay_commit(zdb_zone *zone, input_stream *is, u32 *current_serialp)
 #if ZDB_HAS_NSEC_SUPPORT
                         nsecreplay.vtbl->finalise(&nsecreplay);
 #endif // ZDB_HAS_NSEC_SUPPORT
+#if ZDB_ZONE_GLUE_SUPPORT
+                        zdb_zone_glue_update(zone);
+#endif
                         return ret;
                     }
                 }
@@ -282,6 +286,10 @@ zdb_icmtl_replay_commit(zdb_zone *zone, input_stream *is, u32 *current_serialp)
 
         s32 top = dnsname_to_dnslabel_vector(fqdn, labels);
 
+#if ZDB_ZONE_GLUE_SUPPORT
+        zdb_zone_glue_touch(zone, fqdn, rr.tctr.qtype, rr.rdata, rr.rdata_size);
+#endif
+
         if(mode == 0)
         {
             /*
@@ -328,7 +336,7 @@ zdb_icmtl_replay_commit(zdb_zone *zone, input_stream *is, u32 *current_serialp)
                         zdb_rr_label *above = zdb_rr_label_find_exact(zone->apex, &labels[i], top - zone->origin_vector.size - 1 - i);
                         if(above != NULL)
                         {
-                            if(btree_notempty(above->resource_record_set))
+                            if(zdb_rr_collection_notempty(above->resource_record_set))
                             {
                                 break;
                             }
@@ -465,7 +473,7 @@ zdb_icmtl_replay_commit(zdb_zone *zone, input_stream *is, u32 *current_serialp)
                         zdb_rr_label *above = zdb_rr_label_find_exact(zone->apex, &labels[i], top - zone->origin_vector.size - 1 - i);
                         if(above != NULL)
                         {
-                            if(btree_notempty(above->resource_record_set))
+                            if(zdb_rr_collection_notempty(above->resource_record_set))
                             {
                                 break;
                             }
@@ -573,6 +581,10 @@ zdb_icmtl_replay_commit(zdb_zone *zone, input_stream *is, u32 *current_serialp)
 #endif
     }
     
+#if ZDB_ZONE_GLUE_SUPPORT
+    zdb_zone_glue_update(zone);
+#endif
+    
 #if ZDB_HAS_NSEC3_SUPPORT
     // has_nsec3 = zdb_zone_is_nsec3(zone);
     nsec3replay.vtbl->finalise(&nsec3replay);
@@ -56,6 +56,7 @@
 #include "dnsdb/zdb_rr_label.h"
 #include "dnsdb/zdb_record.h"
 #include "dnsdb/dictionary.h"
+#include "dnsdb/zdb-zone-glue.h"
 #if ZDB_HAS_NSEC_SUPPORT
 #include "dnsdb/nsec.h"
 #endif
@@ -726,7 +727,16 @@ zdb_query_ex_answer_append_ips(const zdb_zone* zone, const u8* dns_name,
     /* Find relatively from the zone */
     yassert(dns_name != NULL);
 
-    zdb_rr_label* rr_label = zdb_query_rr_label_find_relative(zone, dns_name);
+    zdb_rr_label* rr_label;
+    
+#if ZDB_ZONE_GLUE_SUPPORT
+    /* The targets of the zone are linked to the label of their addresses */
+    
+    if(!zdb_zone_glue_find(zone, dns_name, &rr_label))
+#endif
+    {
+        rr_label = zdb_query_rr_label_find_relative(zone, dns_name);
+    }
 
     if(rr_label != NULL)
     {
@@ -1714,6 +1724,8 @@ zdb_query_ex(zdb *db, message_data *mesg, zdb_query_ex_answer *ans_auth_add, u8
             
             LOCK(zone);
             
+            zdb_zone_query_count(zone);
+            
 #ifdef DEBUG
             log_debug("zdb_query_ex: zone %{dnsname}, flags=%x", zone->origin, zone->apex->flags);
 #endif
@@ -2243,12 +2255,12 @@ zdb_query_ex(zdb *db, message_data *mesg, zdb_query_ex_answer *ans_auth_add, u8
 
                         /* We do iterate on ALL the types of the label */
 
-                        btree_iterator iter;
-                        btree_iterator_init(rr_label->resource_record_set, &iter);
+                        zdb_rr_collection_iterator iter;
+                        zdb_rr_collection_iterator_init(rr_label->resource_record_set, &iter);
 
-                        while(btree_iterator_hasnext(&iter))
+                        while(zdb_rr_collection_iterator_hasnext(&iter))
                         {
-                            btree_node* nodep = btree_iterator_next_node(&iter);
+                            zdb_rr_collection_node* nodep = zdb_rr_collection_iterator_next_node(&iter);
 
                             u16 type = nodep->hash;
                             
@@ -2993,6 +3005,8 @@ zdb_query_and_update(zdb *db, message_data *mesg, u8 * restrict pool_buffer)
             
             LOCK(zone);
             
+            zdb_zone_query_count(zone);
+            
 #ifdef DEBUG
             log_debug("zdb_query_and_update: zone %{dnsname}, flags=%x", zone->origin, zone->apex->flags);
 #endif
@@ -3562,12 +3576,12 @@ zdb_query_and_update(zdb *db, message_data *mesg, u8 * restrict pool_buffer)
 
                         /* We do iterate on ALL the types of the label */
 
-                        btree_iterator iter;
-                        btree_iterator_init(rr_label->resource_record_set, &iter);
+                        zdb_rr_collection_iterator iter;
+                        zdb_rr_collection_iterator_init(rr_label->resource_record_set, &iter);
 
-                        while(btree_iterator_hasnext(&iter))
+                        while(zdb_rr_collection_iterator_hasnext(&iter))
                         {
-                            btree_node* nodep = btree_iterator_next_node(&iter);
+                            zdb_rr_collection_node* nodep = zdb_rr_collection_iterator_next_node(&iter);
 
                             u16 type = nodep->hash;
                             
@@ -4358,6 +4372,8 @@ zdb_query_and_update_with_rrl(zdb *db, message_data *mesg, u8 * restrict pool_bu
             
             LOCK(zone);
             
+            zdb_zone_query_count(zone);
+            
 #ifdef DEBUG
             log_debug("zdb_query_and_update_with_rrl: zone %{dnsname}, flags=%x", zone->origin, zone->apex->flags);
 #endif
@@ -4926,12 +4942,12 @@ zdb_query_and_update_with_rrl(zdb *db, message_data *mesg, u8 * restrict pool_bu
 
                         /* We do iterate on ALL the types of the label */
 
-                        btree_iterator iter;
-                        btree_iterator_init(rr_label->resource_record_set, &iter);
+                        zdb_rr_collection_iterator iter;
+                        zdb_rr_collection_iterator_init(rr_label->resource_record_set, &iter);
 
-                        while(btree_iterator_hasnext(&iter))
+                        while(zdb_rr_collection_iterator_hasnext(&iter))
                         {
-                            btree_node* nodep = btree_iterator_next_node(&iter);
+                            zdb_rr_collection_node* nodep = zdb_rr_collection_iterator_next_node(&iter);
 
                             u16 type = nodep->hash;
                             
@@ -108,7 +108,7 @@ zdb_record_free(zdb_packed_ttlrdata* record)
 void
 zdb_record_insert(zdb_rr_collection* collection, u16 type, zdb_packed_ttlrdata* record)
 {
-    zdb_packed_ttlrdata** record_sll = (zdb_packed_ttlrdata**)btree_insert(collection, type);
+    zdb_packed_ttlrdata** record_sll = (zdb_packed_ttlrdata**)zdb_rr_collection_insert(collection, type);
 
 #ifdef DEBUG
     switch(type)
@@ -153,7 +153,7 @@ zdb_record_insert(zdb_rr_collection* collection, u16 type, zdb_packed_ttlrdata*
 bool
 zdb_record_insert_checked(zdb_rr_collection* collection, u16 type, zdb_packed_ttlrdata* record)
 {
-    zdb_packed_ttlrdata** record_sll = (zdb_packed_ttlrdata**)btree_insert(collection, type);
+    zdb_packed_ttlrdata** record_sll = (zdb_packed_ttlrdata**)zdb_rr_collection_insert(collection, type);
     
     if(type != TYPE_CNAME)
     {
@@ -238,7 +238,7 @@ zdb_record_insert_checked(zdb_rr_collection* collection, u16 type, zdb_packed_tt
 bool
 zdb_record_insert_checked_keep_ttl(zdb_rr_collection* collection, u16 type, zdb_packed_ttlrdata* record)
 {
-    zdb_packed_ttlrdata** record_sll = (zdb_packed_ttlrdata**)btree_insert(collection, type);
+    zdb_packed_ttlrdata** record_sll = (zdb_packed_ttlrdata**)zdb_rr_collection_insert(collection, type);
     
     if(type != TYPE_CNAME)
     {
@@ -306,7 +306,7 @@ zdb_record_insert_checked_keep_ttl(zdb_rr_collection* collection, u16 type, zdb_
 zdb_packed_ttlrdata*
 zdb_record_find(const zdb_rr_collection* collection, u16 type)
 {
-    zdb_packed_ttlrdata* record_list = (zdb_packed_ttlrdata*)btree_find(collection, type);
+    zdb_packed_ttlrdata* record_list = (zdb_packed_ttlrdata*)zdb_rr_collection_find(collection, type);
 
     return record_list;
 }
@@ -325,7 +325,7 @@ zdb_record_find(const zdb_rr_collection* collection, u16 type)
 zdb_packed_ttlrdata**
 zdb_record_findp(const zdb_rr_collection* collection, u16 type)
 {
-    zdb_packed_ttlrdata** record_list = (zdb_packed_ttlrdata**)btree_findp(collection, type);
+    zdb_packed_ttlrdata** record_list = (zdb_packed_ttlrdata**)zdb_rr_collection_findp(collection, type);
 
     return record_list;
 }
@@ -348,7 +348,7 @@ zdb_record_find_insert(zdb_rr_collection* collection, u16 type)
 {
     yassert(collection != NULL);
 
-    zdb_packed_ttlrdata** record_list = (zdb_packed_ttlrdata**)btree_insert(collection, type);
+    zdb_packed_ttlrdata** record_list = (zdb_packed_ttlrdata**)zdb_rr_collection_insert(collection, type);
 
     return record_list;
 }
@@ -371,7 +371,7 @@ zdb_record_delete(zdb_rr_collection* collection, u16 type)
 
     if(type != TYPE_ANY)
     {
-        zdb_packed_ttlrdata* record_list = (zdb_packed_ttlrdata*)btree_delete(collection, type);
+        zdb_packed_ttlrdata* record_list = (zdb_packed_ttlrdata*)zdb_rr_collection_delete(collection, type);
 
         if(record_list != NULL)
         {
@@ -470,7 +470,7 @@ zdb_record_delete_exact(zdb_rr_collection* collection, u16 type, const zdb_ttlrd
 {
     yassert((collection != NULL) && (type != TYPE_ANY));
 
-    zdb_packed_ttlrdata** record_listp = (zdb_packed_ttlrdata**)btree_findp(collection, type);
+    zdb_packed_ttlrdata** record_listp = (zdb_packed_ttlrdata**)zdb_rr_collection_findp(collection, type);
 
     if(record_listp != NULL)
     {
@@ -497,7 +497,7 @@ zdb_record_delete_exact(zdb_rr_collection* collection, u16 type, const zdb_ttlrd
                     {
                         /* delete the tree entry */
 
-                        btree_delete(collection, type);
+                        zdb_rr_collection_delete(collection, type);
 
                         ret = SUCCESS_LAST_RECORD;                  /* There is still at least one record of this type available */
                     }
@@ -584,7 +584,7 @@ zdb_record_destroy(zdb_rr_collection* collection)
 {
     yassert(collection != NULL);
     
-    btree_callback_and_destroy(*collection, zdb_record_destroy_callback);
+    zdb_rr_collection_callback_and_destroy(*collection, zdb_record_destroy_callback);
     *collection = NULL;
 }
 
@@ -713,12 +713,12 @@ void zdb_ttlrdata_delete(zdb_ttlrdata* record)
 void
 zdb_record_print_indented(zdb_rr_collection collection, output_stream *os, int indent)
 {
-    btree_iterator iter;
-    btree_iterator_init(collection, &iter);
+    zdb_rr_collection_iterator iter;
+    zdb_rr_collection_iterator_init(collection, &iter);
 
-    while(btree_iterator_hasnext(&iter))
+    while(zdb_rr_collection_iterator_hasnext(&iter))
     {
-        btree_node* node = btree_iterator_next_node(&iter);
+        zdb_rr_collection_node* node = zdb_rr_collection_iterator_next_node(&iter);
         u16 type = node->hash;
 
         zdb_packed_ttlrdata* ttlrdata_sll = (zdb_packed_ttlrdata*)node->data;
@@ -199,7 +199,7 @@ zdb_rr_label_free(zdb_zone* zone, zdb_rr_label* label)
     len++;
     u32 pad = (len > 2)?0:2-len;
 
-    ZFREE_ARRAY(label, sizeof(zdb_rr_label) - 1 + len + pad);
+    ZDB_ZONE_FREE_ARRAY(label, sizeof(zdb_rr_label) - 1 + len + pad);
 }
 
 /**
@@ -247,7 +247,7 @@ zdb_rr_label_new_instance(const u8* label_name)
     u32 len = label_name[0]; /* get the memory required to store the label name */
     len++;
     u32 pad = (len > 2)?0:2-len;
-    ZALLOC_ARRAY_OR_DIE(zdb_rr_label*, rr_label, sizeof(zdb_rr_label) - 1 + len + pad, ZDB_RRLABEL_TAG);
+    ZDB_ZONE_ALLOC_ARRAY_OR_DIE(zdb_rr_label*, rr_label, sizeof(zdb_rr_label) - 1 + len + pad, ZDB_RRLABEL_TAG);
     
 #ifdef DEBUG
     memset(rr_label, 0xac, sizeof(zdb_rr_label) - 1 + len);
@@ -258,7 +258,7 @@ zdb_rr_label_new_instance(const u8* label_name)
     MEMCOPY(rr_label->name, label_name, len);
 
     rr_label->next = NULL;
-    btree_init(&rr_label->resource_record_set);
+    zdb_rr_collection_init(&rr_label->resource_record_set);
     dictionary_init(&rr_label->sub);
 
     rr_label->flags = 0;
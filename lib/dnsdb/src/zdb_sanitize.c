@@ -290,12 +290,12 @@ zdb_sanitize_rr_set_ext(zdb_sanitize_parms *parms, zdb_rr_label *label, dnsname_
     }
 #endif
 
-    btree_iterator iter;
-    btree_iterator_init(label->resource_record_set, &iter);
+    zdb_rr_collection_iterator iter;
+    zdb_rr_collection_iterator_init(label->resource_record_set, &iter);
 
-    while(btree_iterator_hasnext(&iter))
+    while(zdb_rr_collection_iterator_hasnext(&iter))
     {
-        btree_node* node = btree_iterator_next_node(&iter);
+        zdb_rr_collection_node* node = zdb_rr_collection_iterator_next_node(&iter);
         u16 type = node->hash;
 
         zdb_packed_ttlrdata* record_list = (zdb_packed_ttlrdata*)node->data;
@@ -222,12 +222,12 @@ zdb_zone_update_signatures_from(zdb_zone* zone, u8 *from_fqdn, size_t from_fqdn_
 
                 // for all types of the rrset ...
 
-                btree_iterator iter;
-                btree_iterator_init(rr_label->resource_record_set, &iter);
+                zdb_rr_collection_iterator iter;
+                zdb_rr_collection_iterator_init(rr_label->resource_record_set, &iter);
 
-                while(btree_iterator_hasnext(&iter))
+                while(zdb_rr_collection_iterator_hasnext(&iter))
                 {
-                    btree_node *node = btree_iterator_next_node(&iter);
+                    zdb_rr_collection_node *node = zdb_rr_collection_iterator_next_node(&iter);
                     u16 rtype = (u16)node->hash;
 
                     if(rtype == TYPE_RRSIG)
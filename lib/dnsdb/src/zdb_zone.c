@@ -53,6 +53,8 @@
 #include <dnscore/dnscore.h>
 #include <dnscore/logger.h>
 #include <dnscore/threaded_dll_cw.h>
+#include <dnscore/timems.h>
+#include <dnscore/ptr_set.h>
 
 #include "dnsdb/dnsdb-config.h"
 #include "dnsdb/dnssec-keystore.h"
@@ -71,6 +73,7 @@
 
 #include "dnsdb/journal.h"
 #include "dnsdb/dynupdate-diff.h"
+#include "dnsdb/zdb-zone-glue.h"
 
 #if HAS_DNSSEC_SUPPORT
 #include "dnsdb/rrsig.h"
@@ -322,6 +325,127 @@ zdb_zone_record_delete_self(zdb_zone *zone, dnslabel_vector_reference labels, s3
     return ret;
 }
 
+
+#define ZDBQCPAG_TAG 0x474150435142445a
+
+static pthread_key_t zdb_zone_query_counters_key;
+static pthread_once_t zdb_zone_query_counters_key_once = PTHREAD_ONCE_INIT;
+static mutex_t zdb_zone_query_count_slot_mtx = MUTEX_INITIALIZER;
+static ptr_set zdb_zone_query_count_slot_set = PTR_SET_DNSNAME_EMPTY;
+static u32 zdb_zone_query_count_slot_next = 0;
+
+static void
+zdb_zone_query_counters_key_init()
+{
+    if(pthread_key_create(&zdb_zone_query_counters_key, NULL) != 0)
+    {
+        log_quit("zone: pthread_key_create = %r", ERRNO_ERROR);
+    }
+}
+
+void
+zdb_zone_query_counters_set(zdb_zone_query_counters *counters)
+{
+    pthread_once(&zdb_zone_query_counters_key_once, zdb_zone_query_counters_key_init);
+    pthread_setspecific(zdb_zone_query_counters_key, counters);
+}
+
+void
+zdb_zone_query_count(const zdb_zone *zone)
+{
+    pthread_once(&zdb_zone_query_counters_key_once, zdb_zone_query_counters_key_init);
+
+    zdb_zone_query_counters *counters = (zdb_zone_query_counters*)pthread_getspecific(zdb_zone_query_counters_key);
+
+    if(counters == NULL)
+    {
+        return;
+    }
+
+    u32 page_index = zone->query_count_slot / ZDB_ZONE_QUERY_COUNTERS_PAGE_SIZE;
+
+    if(page_index >= ZDB_ZONE_QUERY_COUNTERS_PAGE_COUNT)
+    {
+        return;
+    }
+
+    u64 *page = counters->page[page_index];
+
+    if(page == NULL)
+    {
+        MALLOC_OR_DIE(u64*, page, sizeof(u64) * ZDB_ZONE_QUERY_COUNTERS_PAGE_SIZE, ZDBQCPAG_TAG);
+        ZEROMEMORY(page, sizeof(u64) * ZDB_ZONE_QUERY_COUNTERS_PAGE_SIZE);
+        __sync_synchronize(); // the page is cleared before readers can see it
+        counters->page[page_index] = page;
+    }
+
+    ++page[zone->query_count_slot % ZDB_ZONE_QUERY_COUNTERS_PAGE_SIZE];
+}
+
+u64
+zdb_zone_query_counters_get(const zdb_zone_query_counters *counters, const zdb_zone *zone)
+{
+    u32 page_index = zone->query_count_slot / ZDB_ZONE_QUERY_COUNTERS_PAGE_SIZE;
+
+    if(page_index >= ZDB_ZONE_QUERY_COUNTERS_PAGE_COUNT)
+    {
+        return 0;
+    }
+
+    const u64 *page = counters->page[page_index];
+
+    return (page != NULL)?page[zone->query_count_slot % ZDB_ZONE_QUERY_COUNTERS_PAGE_SIZE]:0;
+}
+
+void
+zdb_zone_query_counters_finalize(zdb_zone_query_counters *counters)
+{
+    for(int i = 0; i < ZDB_ZONE_QUERY_COUNTERS_PAGE_COUNT; ++i)
+    {
+        free(counters->page[i]);
+        counters->page[i] = NULL;
+    }
+}
+
+/**
+ * Returns the query counters slot of the origin, giving it one the first time.
+ */
+
+static u32
+zdb_zone_query_count_slot_get(const u8 *origin)
+{
+    mutex_lock(&zdb_zone_query_count_slot_mtx);
+
+    ptr_node *node = ptr_set_avl_insert(&zdb_zone_query_count_slot_set, (u8*)origin);
+
+    if(node->value == NULL)
+    {
+        node->key = dnsname_zdup(origin);
+        node->value = (void*)(intptr)(zdb_zone_query_count_slot_next++ + 1); // 0 is "no slot"
+    }
+
+    u32 slot = (u32)(intptr)node->value - 1;
+
+    mutex_unlock(&zdb_zone_query_count_slot_mtx);
+
+    return slot;
+}
+
+static void
+zdb_zone_query_count_slot_free(ptr_node *node)
+{
+    dnsname_zfree(node->key);
+}
+
+void
+zdb_zone_query_count_finalize()
+{
+    mutex_lock(&zdb_zone_query_count_slot_mtx);
+    ptr_set_avl_callback_and_destroy(&zdb_zone_query_count_slot_set, zdb_zone_query_count_slot_free);
+    zdb_zone_query_count_slot_next = 0;
+    mutex_unlock(&zdb_zone_query_count_slot_mtx);
+}
+
 /**
  * @brief Search for a record in a zone
  *
@@ -419,6 +543,8 @@ zdb_zone_create(const u8* origin)
     zone->lock_reserved_owner = ZDB_ZONE_MUTEX_NOBODY;
     zone->_status = 0;
     zone->_flags = 0;
+    zone->query_count_slot = zdb_zone_query_count_slot_get(origin);
+    zone->lock_profile_since = 0;
 #if ZDB_HAS_OLD_MUTEX_DEBUG_SUPPORT
     zone->lock_trace = NULL;
     zone->lock_id = 0;
@@ -427,6 +553,12 @@ zdb_zone_create(const u8* origin)
 #if ZDB_ZONE_HAS_JNL_REFERENCE
     zone->journal = NULL;
 #endif
+#if ZDB_ZONE_ARENA_SUPPORT
+    zone->arena = NULL;
+#endif
+#if ZDB_ZONE_GLUE_SUPPORT
+    zone->glue = NULL;
+#endif
     
     return zone;
 }
@@ -505,6 +637,9 @@ zdb_zone_destroy(zdb_zone *zone)
         
         log_debug5("zdb_zone_destroy zone@%p", zone);
         
+        u64 destroy_start = timeus();
+        bool arena_released = FALSE;
+        
 #if HAS_TRACK_ZONES_DEBUG_SUPPORT
         pthread_mutex_lock(&g_zone_instanciated_count.mutex);
         bool known_zone = (ptr_set_avl_find(&g_zone_instanciated_set, zone) != NULL);
@@ -535,6 +670,9 @@ zdb_zone_destroy(zdb_zone *zone)
             zdb_zone_unlock(zone, ZDB_ZONE_MUTEX_DESTROY);
         }
         
+#if ZDB_ZONE_GLUE_SUPPORT
+        zdb_zone_glue_destroy(zone);
+#endif
                 
 #ifndef DEBUG
         // do not bother clearing the memory if it's for a shutdown (faster)
@@ -543,19 +681,54 @@ zdb_zone_destroy(zdb_zone *zone)
         {
             if(zone->apex != NULL)
             {
-
+#if ZDB_ZONE_ARENA_SUPPORT
+                // if nothing has been allocated outside the arena, the labels and chains will go with it
+                
+                arena_released = zdb_zone_arena_pristine(zone);
+#endif
+                if(!arena_released)
+                {
 #if ZDB_HAS_NSEC_SUPPORT
-                nsec_destroy_zone(zone);
+                    nsec_destroy_zone(zone);
 #endif
 
 #if ZDB_HAS_NSEC3_SUPPORT
-                nsec3_destroy_zone(zone);
+                    nsec3_destroy_zone(zone);
 #endif
-                zdb_rr_label_destroy(zone, &zone->apex);
+                    zdb_rr_label_destroy(zone, &zone->apex);
+                }
+                
                 zone->apex = NULL;
             }
         }
         
+#if ZDB_ZONE_ARENA_SUPPORT
+        u64 arena_mapped = 0;
+        
+        if(zone->arena != NULL)
+        {
+            arena_mapped = zdb_zone_arena_mapped(zone->arena);
+            zdb_zone_arena_delete(zone->arena);
+            zone->arena = NULL;
+        }
+#endif
+        
+        u64 destroy_stop = timeus();
+        
+        zdb_zone_arena_teardown_stats_add(destroy_stop - destroy_start, arena_released);
+        
+#if ZDB_ZONE_ARENA_SUPPORT
+        if(arena_mapped > 0)
+        {
+            log_info("zone %{dnsname}: destroyed in %lluus, %llu bytes of arena unmapped%s", zone->origin, destroy_stop - destroy_start, arena_mapped,
+                    (arena_released)?"":" after freeing the labels");
+        }
+        else
+#endif
+        {
+            log_debug("zone %{dnsname}: destroyed in %lluus", zone->origin, destroy_stop - destroy_start);
+        }
+        
         u32 zone_footprint = zdb_zone_get_struct_size(zone->origin);
         
         dnsname_zfree(zone->origin);
@@ -288,55 +288,352 @@ zdb_zone_label_destroy(zdb_zone_label **zone_labelp)
     }
 }
 
+/**
+ * Zone apex index
+ *
+ * Maps the origin of every mounted zone to the label holding it.
+ * Finding the zones enclosing a name is then a few hash probes, from the longest suffix of the name to
+ * the shortest, instead of a dictionary lookup for every label from the root down.
+ * Only depths at which at least one zone is mounted are probed.
+ *
+ * The index is only changed with the database writer lock held and probed with the reader lock held, so it
+ * needs no lock of its own. The table is split in shards so growing it only rehashes one shard at a time.
+ */
+
+#define ZDBAPXIX_TAG 0x584958504142445a
+#define ZDBAPXND_TAG 0x444e58504142445a
+#define ZDBAPXBK_TAG 0x4b4258504142445a
+
+#define ZDB_ZONE_APEX_INDEX_SHARDS      256 // power of two
+#define ZDB_ZONE_APEX_INDEX_BUCKETS_MIN 16  // power of two
+
+typedef struct zdb_zone_apex_node zdb_zone_apex_node;
+
+struct zdb_zone_apex_node
+{
+    zdb_zone_apex_node *next;
+    zdb_zone_label *zone_label;
+    hashcode hash;
+    u8 origin[1];   // the node is allocated for the whole name
+};
+
+typedef struct zdb_zone_apex_shard zdb_zone_apex_shard;
+
+struct zdb_zone_apex_shard
+{
+    zdb_zone_apex_node **buckets;
+    u32 mask;
+    u32 count;
+};
+
+struct zdb_zone_apex_index
+{
+    zdb_zone_apex_shard shard[ZDB_ZONE_APEX_INDEX_SHARDS];
+    u32 depth_count[DNSNAME_MAX_SECTIONS + 1]; // number of zones with an origin of that many labels (root excluded)
+};
+
+/*
+ * Placeholder for the levels of the stack that have no zone.
+ */
+
+static zdb_zone_label zdb_zone_label_no_zone; // all zeroes
+
+/**
+ * Computes the hashes of every suffix of the name, ie: hashes[i] is the hash of labels[i] ... labels[size]
+ */
+
+static void
+zdb_zone_apex_hash_suffixes(const dnsname_vector *name, hashcode *hashes)
+{
+    hashcode hash = 0;
+
+    for(s32 i = name->size; i >= 0; --i)
+    {
+        hash = (hash * 0x9e3779b1U) ^ hash_dnslabel(name->labels[i]);
+        hashes[i] = hash;
+    }
+}
+
+static inline zdb_zone_apex_shard*
+zdb_zone_apex_shard_get(struct zdb_zone_apex_index *index, hashcode hash)
+{
+    return &index->shard[(hash >> 16) & (ZDB_ZONE_APEX_INDEX_SHARDS - 1)];
+}
+
+static inline zdb_zone_apex_node**
+zdb_zone_apex_bucket_get(zdb_zone_apex_shard *shard, hashcode hash)
+{
+    return &shard->buckets[hash & shard->mask];
+}
+
+/**
+ * Compares the origin of a node with the labels[from] ... labels[size] of a name
+ */
+
+static bool
+zdb_zone_apex_node_matches(const zdb_zone_apex_node *node, const dnsname_vector *name, s32 from)
+{
+    const u8 *origin = node->origin;
+
+    for(s32 i = from; i <= name->size; ++i)
+    {
+        if(!dnslabel_equals(origin, name->labels[i]))
+        {
+            return FALSE;
+        }
+
+        origin += origin[0] + 1;
+    }
+
+    return origin[0] == 0;
+}
+
+static zdb_zone_label*
+zdb_zone_apex_index_find(zdb_zone_apex_shard *shard, const dnsname_vector *name, s32 from, hashcode hash)
+{
+    zdb_zone_apex_node *node = *zdb_zone_apex_bucket_get(shard, hash);
+
+    while(node != NULL)
+    {
+        if((node->hash == hash) && zdb_zone_apex_node_matches(node, name, from))
+        {
+            return node->zone_label;
+        }
+
+        node = node->next;
+    }
+
+    return NULL;
+}
+
+static void
+zdb_zone_apex_shard_grow(zdb_zone_apex_shard *shard)
+{
+    u32 size = (shard->mask + 1) << 1;
+    zdb_zone_apex_node **buckets;
+
+    MALLOC_OR_DIE(zdb_zone_apex_node**, buckets, sizeof(zdb_zone_apex_node*) * size, ZDBAPXBK_TAG);
+    ZEROMEMORY(buckets, sizeof(zdb_zone_apex_node*) * size);
+
+    for(u32 i = 0; i <= shard->mask; ++i)
+    {
+        zdb_zone_apex_node *node = shard->buckets[i];
+
+        while(node != NULL)
+        {
+            zdb_zone_apex_node *next = node->next;
+            zdb_zone_apex_node **bucket = &buckets[node->hash & (size - 1)];
+            node->next = *bucket;
+            *bucket = node;
+            node = next;
+        }
+    }
+
+    free(shard->buckets);
+    shard->buckets = buckets;
+    shard->mask = size - 1;
+}
+
+void
+zdb_zone_apex_index_init(zdb *db)
+{
+    struct zdb_zone_apex_index *index;
+
+    MALLOC_OR_DIE(struct zdb_zone_apex_index*, index, sizeof(struct zdb_zone_apex_index), ZDBAPXIX_TAG);
+    ZEROMEMORY(index->depth_count, sizeof(index->depth_count));
+
+    for(u32 i = 0; i < ZDB_ZONE_APEX_INDEX_SHARDS; ++i)
+    {
+        zdb_zone_apex_shard *shard = &index->shard[i];
+        MALLOC_OR_DIE(zdb_zone_apex_node**, shard->buckets, sizeof(zdb_zone_apex_node*) * ZDB_ZONE_APEX_INDEX_BUCKETS_MIN, ZDBAPXBK_TAG);
+        ZEROMEMORY(shard->buckets, sizeof(zdb_zone_apex_node*) * ZDB_ZONE_APEX_INDEX_BUCKETS_MIN);
+        shard->mask = ZDB_ZONE_APEX_INDEX_BUCKETS_MIN - 1;
+        shard->count = 0;
+    }
+
+    db->apex_index = index;
+}
+
+void
+zdb_zone_apex_index_finalize(zdb *db)
+{
+    struct zdb_zone_apex_index *index = db->apex_index;
+
+    if(index == NULL)
+    {
+        return;
+    }
+
+    for(u32 i = 0; i < ZDB_ZONE_APEX_INDEX_SHARDS; ++i)
+    {
+        zdb_zone_apex_shard *shard = &index->shard[i];
+
+        for(u32 j = 0; j <= shard->mask; ++j)
+        {
+            zdb_zone_apex_node *node = shard->buckets[j];
+
+            while(node != NULL)
+            {
+                zdb_zone_apex_node *next = node->next;
+                free(node);
+                node = next;
+            }
+        }
+
+        free(shard->buckets);
+    }
+
+    free(index);
+    db->apex_index = NULL;
+}
+
+void
+zdb_zone_apex_index_set(zdb *db, const dnsname_vector *origin, zdb_zone_label *zone_label)
+{
+    hashcode hashes[DNSNAME_MAX_SECTIONS];
+
+    yassert(zdb_islocked_by(db, ZDB_MUTEX_WRITER));
+
+    if(origin->size < 0)
+    {
+        return; // the root is always db->root
+    }
+
+    zdb_zone_apex_hash_suffixes(origin, hashes);
+
+    hashcode hash = hashes[0];
+    zdb_zone_apex_shard *shard = zdb_zone_apex_shard_get(db->apex_index, hash);
+
+    zdb_zone_apex_node **bucket = zdb_zone_apex_bucket_get(shard, hash);
+    zdb_zone_apex_node *node = *bucket;
+
+    while(node != NULL)
+    {
+        if((node->hash == hash) && zdb_zone_apex_node_matches(node, origin, 0))
+        {
+            node->zone_label = zone_label;
+            return;
+        }
+
+        node = node->next;
+    }
+
+    u32 origin_len = dnsname_vector_len((dnsname_vector*)origin);
+
+    MALLOC_OR_DIE(zdb_zone_apex_node*, node, sizeof(zdb_zone_apex_node) - 1 + origin_len, ZDBAPXND_TAG);
+    dnsname_vector_sub_to_dnsname(origin, 0, node->origin);
+    node->zone_label = zone_label;
+    node->hash = hash;
+    node->next = *bucket;
+    *bucket = node;
+
+    if(++shard->count > ((shard->mask + 1) << 1))
+    {
+        zdb_zone_apex_shard_grow(shard);
+    }
+
+    ++db->apex_index->depth_count[origin->size];
+}
+
+void
+zdb_zone_apex_index_remove(zdb *db, const dnsname_vector *origin)
+{
+    hashcode hashes[DNSNAME_MAX_SECTIONS];
+
+    yassert(zdb_islocked_by(db, ZDB_MUTEX_WRITER));
+
+    if(origin->size < 0)
+    {
+        return;
+    }
+
+    zdb_zone_apex_hash_suffixes(origin, hashes);
+
+    hashcode hash = hashes[0];
+    zdb_zone_apex_shard *shard = zdb_zone_apex_shard_get(db->apex_index, hash);
+
+    zdb_zone_apex_node **nodep = zdb_zone_apex_bucket_get(shard, hash);
+
+    while(*nodep != NULL)
+    {
+        zdb_zone_apex_node *node = *nodep;
+
+        if((node->hash == hash) && zdb_zone_apex_node_matches(node, origin, 0))
+        {
+            *nodep = node->next;
+            --shard->count;
+
+            free(node);
+
+            --db->apex_index->depth_count[origin->size];
+
+            return;
+        }
+
+        nodep = &node->next;
+    }
+}
+
 /**
  * @brief Gets pointers to all the zone labels along the path of a name.
  *
  * Gets pointers to all the zone labels along the path of a name.
+ * The levels of the path that have no zone are set to a label without zone.
  *
  * @param[in] db a pointer to the database
  * @param[in] name a pointer to the dns name
  * @param[in] zone_label_stack a pointer to the stack that will hold the labels pointers
  *
- * @return the top of the stack (-1 = empty)
+ * @return the top of the stack, ie: the level of the closest enclosing zone (0 = the root)
  */
 
 s32
 zdb_zone_label_match(zdb * db, const dnsname_vector* origin,  // mutex checked
                      zdb_zone_label_pointer_array zone_label_stack)
 {
-    zdb_zone_label* zone_label;
+    hashcode hashes[DNSNAME_MAX_SECTIONS];
+    struct zdb_zone_apex_index *index = db->apex_index;
     
     yassert(zdb_islocked_by(db, ZDB_MUTEX_READER));
-    
-    zone_label = db->root; /* the "." zone */
 
-    const_dnslabel_stack_reference sections = origin->labels;
-    s32 index = origin->size;
+    zone_label_stack[0] = db->root; /* the "." zone */
 
-    s32 sp = 0;
+    s32 top = 0;
 
-    zone_label_stack[0] = zone_label;
+    zdb_zone_apex_hash_suffixes(origin, hashes);
 
-    /* look into the sub level */
+    /*
+     * level sp holds the name made of the last sp labels, ie: starting at labels[origin->size - sp + 1]
+     * probe from the longest one
+     */
 
-    while(index >= 0)
+    for(s32 sp = origin->size + 1; sp > 0; --sp)
     {
-        const u8* label = sections[index];
-        hashcode hash = hash_dnslabel(label);
+        s32 from = origin->size - sp + 1;
+        zdb_zone_label *zone_label = NULL;
 
-        zone_label = (zdb_zone_label*)dictionary_find(&zone_label->sub, hash, label, zdb_zone_label_zlabel_match);
-
-        if(zone_label == NULL)
+        if(index->depth_count[sp - 1] > 0)
         {
-            break;
+            hashcode hash = hashes[from];
+            zone_label = zdb_zone_apex_index_find(zdb_zone_apex_shard_get(index, hash), origin, from, hash);
         }
 
-        zone_label_stack[++sp] = zone_label;
+        if(zone_label != NULL)
+        {
+            if(top == 0)
+            {
+                top = sp;
+            }
+        }
+        else
+        {
+            zone_label = &zdb_zone_label_no_zone;
+        }
 
-        index--;
+        zone_label_stack[sp] = zone_label;
     }
-    
-    return sp;
+
+    return top;
 }
 
 zdb_zone_label*
@@ -56,6 +56,7 @@
 #include "dnsdb/zdb_record.h"
 #include "dnsdb/zdb_icmtl.h"
 #include "dnsdb/zdb_sanitize.h"
+#include "dnsdb/zdb-zone-glue.h"
 #include "dnsdb/zdb_utils.h"
 #include "dnsdb/zdb_zone_write.h"
 #include "dnsdb/zdb_zone_label_iterator.h"
@@ -258,16 +259,31 @@ zdb_zone_load(zdb *db, zone_reader *zr, zdb_zone **zone_pointer_out, const u8 *e
     /* B */
 
     zdb_zone* zone;
+    
+#if ZDB_ZONE_ARENA_SUPPORT
+    // the content of the zone is taken from its arena until the load is done
+    
+    zdb_zone_arena *arena = zdb_zone_arena_new_instance();
+    zdb_zone_arena_bind(arena);
+#endif
 
     zone = zdb_zone_create(entry.name); // comes with an RC = 1, not locked
     
     if(zone == NULL)
     {
+#if ZDB_ZONE_ARENA_SUPPORT
+        zdb_zone_arena_unbind();
+        zdb_zone_arena_delete(arena);
+#endif
         log_err("zone load: unable to load zone %{dnsname} %{dnsclass}", entry.name, &zclass);
         
         return ZDB_ERROR_NOSUCHCLASS;
     }
     
+#if ZDB_ZONE_ARENA_SUPPORT
+    zone->arena = arena;
+#endif
+    
     zdb_zone_lock(zone, ZDB_ZONE_MUTEX_LOAD);
     
     zone->min_ttl = soa_min_ttl;
@@ -814,7 +830,13 @@ zdb_zone_load_loop:
         {
             log_info("zone load: zone %{dnsname} has been mounted", zone->origin);
             
+#if ZDB_ZONE_ARENA_SUPPORT
+            zdb_zone_arena_unbind(); // the database is not part of the zone
+#endif
             zdb_zone *old_zone = zdb_set_zone(db, zone);
+#if ZDB_ZONE_ARENA_SUPPORT
+            zdb_zone_arena_bind(zone->arena);
+#endif
             yassert(old_zone == NULL);
             (void)old_zone; 
         }
@@ -1021,6 +1043,15 @@ zdb_zone_load_loop:
     
     if(zone != NULL)
     {
+#if ZDB_ZONE_GLUE_SUPPORT
+        if(ISOK(return_code))
+        {
+            zdb_zone_glue_build(zone);
+        }
+#endif
+#if ZDB_ZONE_ARENA_SUPPORT
+        zdb_zone_arena_seal(zone);
+#endif
         zdb_zone_unlock(zone, ZDB_ZONE_MUTEX_LOAD);
         
         if(FAIL(return_code))
@@ -109,7 +109,7 @@ zdb_zone_store_axfr(zdb_zone* zone, output_stream* os)
     u8 fqdn[MAX_DOMAIN_LENGTH];
 
     zdb_zone_label_iterator iter;
-    btree_iterator type_iter;
+    zdb_rr_collection_iterator type_iter;
 
     struct type_class_ttl_size rec;
 
@@ -154,11 +154,11 @@ zdb_zone_store_axfr(zdb_zone* zone, output_stream* os)
 
         label = zdb_zone_label_iterator_next(&iter);
         
-        btree_iterator_init(label->resource_record_set, &type_iter);
+        zdb_rr_collection_iterator_init(label->resource_record_set, &type_iter);
 
-        while(btree_iterator_hasnext(&type_iter))
+        while(zdb_rr_collection_iterator_hasnext(&type_iter))
         {
-            btree_node* type_node = btree_iterator_next_node(&type_iter);
+            zdb_rr_collection_node* type_node = zdb_rr_collection_iterator_next_node(&type_iter);
 
             if(type_node->hash == TYPE_SOA)
             {
@@ -56,6 +56,9 @@
 #include <dnscore/fdtools.h>
 #include <dnscore/random.h>
 #include <dnscore/thread_pool.h>
+#include <dnscore/bytearray_output_stream.h>
+#include <dnscore/ptr_vector.h>
+#include <dnscore/sys_get_cpu_count.h>
 
 #include "dnsdb/zdb_zone_write.h"
 
@@ -187,22 +190,645 @@ zdb_zone_rr_label_flags_format(const void *value, output_stream *os, s32 padding
 }
 #endif
 
-ya_result
-zdb_zone_write_text_ex(const zdb_zone *zone, output_stream *fos, bool force_label, bool allow_shutdown)
+/**
+ * Writes the records of one label.
+ */
+
+static void
+zdb_zone_write_text_label(output_stream *os, const zdb_zone *zone, zdb_rr_label *label, char *label_cstr, u32 label_len, bool force_label)
+{
+    zdb_rr_collection_iterator records_iter;
+    ya_result ret;
+    s32 current_ttl;
+#ifdef DEBUG
+    format_writer status_flags_fw = {zdb_zone_rr_label_flags_format, NULL};
+#endif
+    bool print_label = TRUE;
+
+    zdb_packed_ttlrdata* soa_ttlrdata = zdb_record_find(&label->resource_record_set, TYPE_SOA);
+
+    if(soa_ttlrdata != NULL)
+    {
+        osprint_tab_padded(os, label_cstr, label_len, INDENT_TABS);
+
+        u16 zclass = zdb_zone_getclass(zone);
+
+        osformat(os, "\t%{dnsclass}%tSOA%t", &zclass, (TTL_SIZE/TAB_SIZE) + 1, TTL_SIZE/TAB_SIZE);
+
+        ret = osprint_rdata(os, TYPE_SOA, ZDB_PACKEDRECORD_PTR_RDATAPTR(soa_ttlrdata), ZDB_PACKEDRECORD_PTR_RDATASIZE(soa_ttlrdata));
+
+#ifdef DEBUG
+        status_flags_fw.value = &label->flags;
+        osformatln(os, " ; flags=%w", &status_flags_fw);
+#else
+        output_stream_write(os, (const u8*)__LF__, 1);
+#endif
+
+        if(FAIL(ret))
+        {
+            osprintln(os, ";; ABOVE RECORD IS CORRUPTED");
+        }
+
+        print_label = force_label;
+    }
+
+    zdb_rr_collection_iterator_init(label->resource_record_set, &records_iter);
+    while(zdb_rr_collection_iterator_hasnext(&records_iter))
+    {
+        zdb_rr_collection_node* node = zdb_rr_collection_iterator_next_node(&records_iter);
+
+        u16 type = (u16)node->hash;
+
+        if(type == TYPE_SOA)
+        {
+            continue;
+        }
+
+        zdb_packed_ttlrdata* ttlrdata_sll = (zdb_packed_ttlrdata*)node->data;
+
+        current_ttl = DEFAULT_TTL;
+
+        s32 rrset_ttl = ttlrdata_sll->ttl;
+
+        while(ttlrdata_sll != NULL)
+        {
+            if(print_label)
+            {
+                osprint_tab_padded(os, label_cstr, label_len, INDENT_TABS);
+            }
+            else
+            {
+                osprint_tab_padded(os, NULL, 0, INDENT_TABS);
+            }
+
+            if(current_ttl != rrset_ttl)
+            {
+                current_ttl = rrset_ttl;
+                osformat(os, "\t%-" TOSTRING(TTL_SIZE) "u\t", current_ttl);
+            }
+            else
+            {
+                osformat(os, "%t", 1 + (TTL_SIZE/TAB_SIZE) + 1);
+            }
+
+            osformat(os, "%{dnstype}%t", &type, (TTL_SIZE/TAB_SIZE));
+
+            ret = osprint_rdata(os, type, ZDB_PACKEDRECORD_PTR_RDATAPTR(ttlrdata_sll), ZDB_PACKEDRECORD_PTR_RDATASIZE(ttlrdata_sll));
+
+#ifdef DEBUG
+            status_flags_fw.value = &label->flags;
+            osformatln(os, " ; flags=%w", &status_flags_fw);
+#else
+            output_stream_write(os, (const u8*)__LF__, 1);
+#endif
+            if(FAIL(ret))
+            {
+                osprintln(os, ";; ABOVE RECORD IS CORRUPTED");
+            }
+
+            print_label = force_label;
+
+            ttlrdata_sll = ttlrdata_sll->next;
+        }
+    }
+
+#ifdef DEBUG
+    if(zdb_rr_collection_isempty(label->resource_record_set))
+    {
+        osprint(os, ";; ");
+        output_stream_write(os, label_cstr, label_len);
+
+        status_flags_fw.value = &label->flags;
+
+        if(label->sub.count == 0)
+        {
+            osformatln(os, " is empty terminal ; flags=%w", &status_flags_fw);
+        }
+        else
+        {
+            osformatln(os, " is empty non-terminal ; flags=%w", &status_flags_fw);
+        }
+    }
+#endif
+}
+
+#if ZDB_HAS_NSEC3_SUPPORT
+
+/**
+ * Writes the NSEC3 record of an item of a chain, and its signatures.
+ */
+
+static ya_result
+zdb_zone_write_text_nsec3_item(output_stream *os, const zdb_zone *zone, const nsec3_zone *n3, const nsec3_zone_item *item, const nsec3_zone_item *next_item, const char *dot_origin, u32 dot_origin_len, u32 soa_nttl)
+{
+    u8 rdata[TYPE_BIT_MAPS_MAX_RDATA_SIZE];
+
+    u32 rdata_size = NSEC3_ZONE_RDATA_SIZE(n3);
+    u8 digest_len = NSEC3_NODE_DIGEST_SIZE(item);
+
+    MEMCOPY(rdata, &n3->rdata[0], rdata_size);
+
+    rdata[1] = item->flags;
+#ifdef DEBUG
+    if(item->rc == 1)
+    {
+        if(item->rc != 0)
+        {
+            if(item->label.owner != NSEC3_ZONE_FAKE_OWNER)
+            {
+                if(item->label.owner->name[0] != 0)
+                {
+                    osformatln(os, ";; Owner: %{dnslabel}", item->label.owner->name);
+                }
+                else
+                {
+                    osformatln(os, ";; Owner: %{dnslabel} (the apex)", zone->origin);
+                }
+            }
+            else
+            {
+                osprintln(os, ";; Owner: FAKE (Owned by the parents of the zone)");
+            }
+        }
+        else
+        {
+            osprintln(os, ";; Owner: ERROR : RC=0");
+        }
+    }
+    else
+    {
+        if(item->rc > 0)
+        {
+            s32 i = item->rc - 1;
+            do
+            {
+                if(item->label.owners[i] != NSEC3_ZONE_FAKE_OWNER)
+                {
+                    if(item->label.owners[i]->name[0] != 0)
+                    {
+                        osformatln(os, ";; Owner: %{dnslabel}", item->label.owners[i]->name);
+                    }
+                    else
+                    {
+                        osformatln(os, ";; Owner: %{dnslabel} (the apex)", zone->origin);
+                    }
+                }
+                else
+                {
+                    osprintln(os, ";; Owner: FAKE (Owned by the parents of the zone)");
+                }
+            }
+            while(i-- > 0);
+        }
+        else
+        {
+            osprintln(os, ";; NO OWNER");
+        }
+    }
+
+    if(item->sc <= 1)
+    {
+        if(item->sc != 0)
+        {
+            if(item->star_label.owner->name[0] != 0)
+            {
+                osformatln(os, ";; Star: %{dnslabel}", item->star_label.owner->name);
+            }
+            else
+            {
+                osformatln(os, ";; Star: %{dnslabel} (the apex)", zone->origin);
+            }
+        }
+    }
+    else
+    {
+        s32 i = item->sc - 1;
+        do
+        {
+            if(item->star_label.owners[i]->name[0] != 0)
+            {
+                osformatln(os, ";; Star: %{dnslabel}", item->star_label.owners[i]->name);
+            }
+            else
+            {
+                osformatln(os, ";; Star: %{dnslabel} (the apex)", zone->origin);
+            }
+        }
+        while(i-- > 0);
+    }
+#else
+    (void)zone;
+#endif
+
+    MEMCOPY(&rdata[rdata_size], next_item->digest, digest_len + 1);
+    rdata_size += digest_len + 1;
+
+    MEMCOPY(&rdata[rdata_size], item->type_bit_maps, item->type_bit_maps_size);
+    rdata_size += item->type_bit_maps_size;
+
+    ya_result hex32_len;
+
+    if(FAIL(hex32_len = output_stream_write_base32hex(os, NSEC3_NODE_DIGEST_PTR(item), digest_len)))
+    {
+        return hex32_len;
+    }
+
+    output_stream_write(os, (const u8*)dot_origin, dot_origin_len);
+    output_stream_write_u8(os, (u8)'\t');
+
+    osformat(os, "%-" TOSTRING(TTL_SIZE) "u\tNSEC3\t", soa_nttl);
+    osprint_rdata(os, TYPE_NSEC3, rdata, rdata_size);
+    osprintln(os, "");
+
+    zdb_packed_ttlrdata* rrsig = item->rrsig;
+
+    while(rrsig != NULL)
+    {
+        u32 tabs = ((hex32_len+ dot_origin_len) / TAB_SIZE) + 1 + (TTL_SIZE/TAB_SIZE) + 1;
+
+        osformat(os, "%tRRSIG\t", tabs); /* ${} requires a pointer to the data */
+
+        osprint_rdata(os, TYPE_RRSIG, ZDB_PACKEDRECORD_PTR_RDATAPTR(rrsig), ZDB_PACKEDRECORD_PTR_RDATASIZE(rrsig));
+
+        osprintln(os, "");
+
+        rrsig = rrsig->next;
+    }
+
+    return SUCCESS;
+}
+
+#endif
+
+/**
+ * Parallel writer
+ *
+ * The labels (then the NSEC3 items) are taken in order and grouped in chunks.
+ * Each chunk is formatted by a worker of the zone text thread pool into its own memory buffer.
+ * At most ZDB_ZONE_WRITE_TEXT_WINDOW chunks are being formatted at once.
+ *
+ * The formatted buffers are kept in memory until every chunk has been formatted: the zone is then not read
+ * anymore and the "formatted" callback is called so the caller can release the zone lock before the buffers are
+ * written, in order, to the output. Only a zone whose text exceeds ZDB_ZONE_WRITE_TEXT_HELD_MAX has its first
+ * buffers written while it is still being read.
+ *
+ * A zone that fits in one chunk is formatted by the caller.
+ */
+
+#define ZDB_ZONE_WRITE_TEXT_CHUNK_SIZE      1024    // labels or NSEC3 items per chunk
+#define ZDB_ZONE_WRITE_TEXT_WINDOW          64      // chunks being formatted at once
+#define ZDB_ZONE_WRITE_TEXT_HELD_MAX        0x10000000 // bytes of formatted text kept while the zone is read (256MB)
+#define ZDB_ZONE_WRITE_TEXT_CHUNK_BUFFER    65536   // initial size of the chunk text buffer
+#define ZDB_ZONE_WRITE_TEXT_QUEUE_SIZE      (ZDB_ZONE_WRITE_TEXT_WINDOW * 2)
+#define ZDB_ZONE_WRITE_TEXT_THREADS_MAX     16
+
+#define ZWTCHUNK_TAG 0x4b4e484354575a
+#define ZWTNAMES_TAG 0x53454d414e54575a
+
+#define ZDB_ZONE_WRITE_TEXT_CHUNK_LABELS 0
+#define ZDB_ZONE_WRITE_TEXT_CHUNK_NSEC3  1
+
+struct zdb_zone_write_text_job
+{
+    mutex_t mtx;
+    cond_t cond;
+    const zdb_zone *zone;
+    const char *dot_origin;
+    u32 dot_origin_len;
+    u32 soa_nttl;
+    bool force_label;
+    bool allow_shutdown;
+};
+
+typedef struct zdb_zone_write_text_job zdb_zone_write_text_job;
+
+struct zdb_zone_write_text_chunk_label
+{
+    zdb_rr_label *label;
+    u32 name_offset;
+    u32 name_len;
+};
+
+struct zdb_zone_write_text_chunk
+{
+    zdb_zone_write_text_job *job;
+    output_stream os;
+    union
+    {
+        struct zdb_zone_write_text_chunk_label *labels;
+#if ZDB_HAS_NSEC3_SUPPORT
+        nsec3_zone_item **items;    // count + 1 items, the last one is the next of the one before
+#endif
+    } u;
+#if ZDB_HAS_NSEC3_SUPPORT
+    const nsec3_zone *n3;
+#endif
+    char *names;
+    u32 names_size;
+    u32 names_capacity;
+    u32 count;
+    ya_result ret;
+    u8 kind;
+    volatile bool done;
+};
+
+typedef struct zdb_zone_write_text_chunk zdb_zone_write_text_chunk;
+
+static struct thread_pool_s *zdb_zone_write_text_thread_pool = NULL;
+static mutex_t zdb_zone_write_text_thread_pool_mtx = MUTEX_INITIALIZER;
+
+static struct thread_pool_s *
+zdb_zone_write_text_thread_pool_get()
+{
+    mutex_lock(&zdb_zone_write_text_thread_pool_mtx);
+
+    if(zdb_zone_write_text_thread_pool == NULL)
+    {
+        u32 thread_count = MAX(sys_get_cpu_count(), 1);
+
+        if(thread_count > ZDB_ZONE_WRITE_TEXT_THREADS_MAX)
+        {
+            thread_count = ZDB_ZONE_WRITE_TEXT_THREADS_MAX;
+        }
+
+        zdb_zone_write_text_thread_pool = thread_pool_init_ex(thread_count, ZDB_ZONE_WRITE_TEXT_QUEUE_SIZE, "zonetxt");
+    }
+
+    mutex_unlock(&zdb_zone_write_text_thread_pool_mtx);
+
+    return zdb_zone_write_text_thread_pool;
+}
+
+void
+zdb_zone_write_text_finalize()
+{
+    mutex_lock(&zdb_zone_write_text_thread_pool_mtx);
+
+    if(zdb_zone_write_text_thread_pool != NULL)
+    {
+        thread_pool_destroy(zdb_zone_write_text_thread_pool);
+        zdb_zone_write_text_thread_pool = NULL;
+    }
+
+    mutex_unlock(&zdb_zone_write_text_thread_pool_mtx);
+}
+
+static zdb_zone_write_text_chunk *
+zdb_zone_write_text_chunk_new(zdb_zone_write_text_job *job, u8 kind)
+{
+    zdb_zone_write_text_chunk *chunk;
+
+    ZALLOC_OR_DIE(zdb_zone_write_text_chunk*, chunk, zdb_zone_write_text_chunk, ZWTCHUNK_TAG);
+    chunk->job = job;
+    chunk->names = NULL;
+    chunk->names_size = 0;
+    chunk->names_capacity = 0;
+    chunk->count = 0;
+    chunk->ret = SUCCESS;
+    chunk->kind = kind;
+    chunk->done = FALSE;
+#if ZDB_HAS_NSEC3_SUPPORT
+    chunk->n3 = NULL;
+
+    if(kind == ZDB_ZONE_WRITE_TEXT_CHUNK_NSEC3)
+    {
+        MALLOC_OR_DIE(nsec3_zone_item**, chunk->u.items, sizeof(nsec3_zone_item*) * (ZDB_ZONE_WRITE_TEXT_CHUNK_SIZE + 1), ZWTCHUNK_TAG);
+    }
+    else
+#endif
+    {
+        MALLOC_OR_DIE(struct zdb_zone_write_text_chunk_label*, chunk->u.labels, sizeof(struct zdb_zone_write_text_chunk_label) * ZDB_ZONE_WRITE_TEXT_CHUNK_SIZE, ZWTCHUNK_TAG);
+    }
+
+    bytearray_output_stream_init_ex(&chunk->os, NULL, ZDB_ZONE_WRITE_TEXT_CHUNK_BUFFER, BYTEARRAY_DYNAMIC);
+
+    return chunk;
+}
+
+static void
+zdb_zone_write_text_chunk_delete(zdb_zone_write_text_chunk *chunk)
+{
+    output_stream_close(&chunk->os);
+#if ZDB_HAS_NSEC3_SUPPORT
+    if(chunk->kind == ZDB_ZONE_WRITE_TEXT_CHUNK_NSEC3)
+    {
+        free(chunk->u.items);
+    }
+    else
+#endif
+    {
+        free(chunk->u.labels);
+    }
+    free(chunk->names);
+    ZFREE(chunk, zdb_zone_write_text_chunk);
+}
+
+static void
+zdb_zone_write_text_chunk_add_label(zdb_zone_write_text_chunk *chunk, zdb_rr_label *label, const char *label_cstr, u32 label_len)
+{
+    if(chunk->names_size + label_len + 1 > chunk->names_capacity)
+    {
+        chunk->names_capacity = MAX(chunk->names_capacity * 2, chunk->names_size + label_len + 1);
+        chunk->names_capacity = MAX(chunk->names_capacity, ZDB_ZONE_WRITE_TEXT_CHUNK_SIZE * 16);
+        REALLOC_OR_DIE(char*, chunk->names, chunk->names_capacity, ZWTNAMES_TAG);
+    }
+
+    struct zdb_zone_write_text_chunk_label *entry = &chunk->u.labels[chunk->count++];
+    entry->label = label;
+    entry->name_offset = chunk->names_size;
+    entry->name_len = label_len;
+    memcpy(&chunk->names[chunk->names_size], label_cstr, label_len + 1);
+    chunk->names_size += label_len + 1;
+}
+
+/**
+ * Formats a chunk into its buffer.
+ */
+
+static void
+zdb_zone_write_text_chunk_format(zdb_zone_write_text_chunk *chunk)
+{
+    zdb_zone_write_text_job *job = chunk->job;
+
+#if ZDB_HAS_NSEC3_SUPPORT
+    if(chunk->kind == ZDB_ZONE_WRITE_TEXT_CHUNK_NSEC3)
+    {
+        for(u32 i = 0; i < chunk->count; ++i)
+        {
+            if(job->allow_shutdown && dnscore_shuttingdown())
+            {
+                chunk->ret = STOPPED_BY_APPLICATION_SHUTDOWN;
+                return;
+            }
+
+            ya_result ret = zdb_zone_write_text_nsec3_item(&chunk->os, job->zone, chunk->n3, chunk->u.items[i], chunk->u.items[i + 1], job->dot_origin, job->dot_origin_len, job->soa_nttl);
+
+            if(FAIL(ret))
+            {
+                chunk->ret = ret;
+                return;
+            }
+        }
+
+        return;
+    }
+#endif
+
+    for(u32 i = 0; i < chunk->count; ++i)
+    {
+        if(job->allow_shutdown && dnscore_shuttingdown())
+        {
+            chunk->ret = STOPPED_BY_APPLICATION_SHUTDOWN;
+            return;
+        }
+
+        struct zdb_zone_write_text_chunk_label *entry = &chunk->u.labels[i];
+
+        zdb_zone_write_text_label(&chunk->os, job->zone, entry->label, &chunk->names[entry->name_offset], entry->name_len, job->force_label);
+    }
+}
+
+static void*
+zdb_zone_write_text_chunk_thread(void *args)
+{
+    zdb_zone_write_text_chunk *chunk = (zdb_zone_write_text_chunk*)args;
+    zdb_zone_write_text_job *job = chunk->job;
+
+    zdb_zone_write_text_chunk_format(chunk);
+
+    mutex_lock(&job->mtx);
+    chunk->done = TRUE;
+    cond_notify(&job->cond);
+    mutex_unlock(&job->mtx);
+
+    return NULL;
+}
+
+/**
+ * The chunks not written yet, in order
+ */
+
+struct zdb_zone_write_text_window
+{
+    zdb_zone_write_text_job *job;
+    struct thread_pool_s *tp;
+    output_stream *os;
+    ptr_vector chunks;  // the ones before head have been written
+    s32 head;           // the next chunk to write
+    s32 formatted;      // the next chunk to wait for
+    u64 held;           // bytes of the formatted chunks not written yet
+    ya_result ret;
+};
+
+typedef struct zdb_zone_write_text_window zdb_zone_write_text_window;
+
+static void
+zdb_zone_write_text_chunk_wait(zdb_zone_write_text_job *job, zdb_zone_write_text_chunk *chunk)
+{
+    mutex_lock(&job->mtx);
+    while(!chunk->done)
+    {
+        cond_wait(&job->cond, &job->mtx);
+    }
+    mutex_unlock(&job->mtx);
+}
+
+/**
+ * Waits for the oldest chunk being formatted.
+ */
+
+static void
+zdb_zone_write_text_window_wait_one(zdb_zone_write_text_window *window)
+{
+    zdb_zone_write_text_chunk *chunk = (zdb_zone_write_text_chunk*)ptr_vector_get(&window->chunks, window->formatted);
+
+    zdb_zone_write_text_chunk_wait(window->job, chunk);
+
+    window->held += bytearray_output_stream_size(&chunk->os);
+    ++window->formatted;
+}
+
+/**
+ * Writes the oldest formatted chunk and removes it from the window.
+ */
+
+static void
+zdb_zone_write_text_window_flush_one(zdb_zone_write_text_window *window)
+{
+    zdb_zone_write_text_chunk *chunk = (zdb_zone_write_text_chunk*)ptr_vector_get(&window->chunks, window->head);
+
+    yassert(window->head < window->formatted);
+
+    if(ISOK(window->ret))
+    {
+        if(ISOK(chunk->ret))
+        {
+            ya_result ret = output_stream_write(window->os, bytearray_output_stream_buffer(&chunk->os), bytearray_output_stream_size(&chunk->os));
+
+            if(FAIL(ret))
+            {
+                window->ret = ret;
+            }
+        }
+        else
+        {
+            window->ret = chunk->ret;
+        }
+    }
+
+    window->held -= bytearray_output_stream_size(&chunk->os);
+
+    zdb_zone_write_text_chunk_delete(chunk);
+
+    ptr_vector_set(&window->chunks, window->head, NULL);
+    ++window->head;
+}
+
+static void
+zdb_zone_write_text_window_push(zdb_zone_write_text_window *window, zdb_zone_write_text_chunk *chunk)
+{
+    while(ptr_vector_size(&window->chunks) - window->formatted >= ZDB_ZONE_WRITE_TEXT_WINDOW)
+    {
+        zdb_zone_write_text_window_wait_one(window);
+    }
+
+    while((window->held > ZDB_ZONE_WRITE_TEXT_HELD_MAX) && (window->head < window->formatted))
+    {
+        zdb_zone_write_text_window_flush_one(window);
+    }
+
+    ptr_vector_append(&window->chunks, chunk);
+
+    if(FAIL(thread_pool_enqueue_call(window->tp, zdb_zone_write_text_chunk_thread, chunk, NULL, "zonetxt")))
+    {
+        zdb_zone_write_text_chunk_thread(chunk);
+    }
+}
+
+/**
+ * Waits for all the chunks to be formatted.
+ * After this the zone is not accessed anymore.
+ */
+
+static void
+zdb_zone_write_text_window_wait_formatted(zdb_zone_write_text_window *window)
+{
+    while(window->formatted < ptr_vector_size(&window->chunks))
+    {
+        zdb_zone_write_text_window_wait_one(window);
+    }
+}
+
+static ya_result
+zdb_zone_write_text_ex_with_callback(const zdb_zone *zone, output_stream *fos, bool force_label, bool allow_shutdown, zdb_zone_write_text_formatted_callback *formatted, void *formatted_args)
 {
     output_stream bos;
 
     ya_result ret;
     
     s32 current_ttl = DEFAULT_TTL;
-#if ZDB_HAS_NSEC3_SUPPORT
-    u32 soa_nttl = zone->min_ttl;
-#endif
     u32 label_len;
     u32 origin_len;
-#if ZDB_HAS_NSEC3_SUPPORT
-    u32 dot_origin_len;
-#endif
     
     yassert(zdb_zone_islocked_weak(zone));
         
@@ -212,7 +838,6 @@ zdb_zone_write_text_ex(const zdb_zone *zone, output_stream *fos, bool force_labe
     }
     
 #ifdef DEBUG
-    format_writer status_flags_fw = {zdb_zone_rr_label_flags_format, NULL};
     osprintln(&bos, "; A=apex 1=NSEC 3=NSEC3 O=NSEC3-OPTOUT F=frozen/loading *=wildcard present D=at-delegation d=under-delegation C=has-CNAME c=no-CNAME-allowed I=invalid-zone S=NSEC3-covered s=NSEC3-optout-covered");
 #endif
 
@@ -228,17 +853,40 @@ zdb_zone_write_text_ex(const zdb_zone *zone, output_stream *fos, bool force_labe
         }
     }
     
+    zdb_zone_write_text_job job;
+    mutex_init(&job.mtx);
+    cond_init(&job.cond);
+    job.zone = zone;
+    job.force_label = force_label;
+    job.allow_shutdown = allow_shutdown;
+    job.dot_origin = NULL;
+    job.dot_origin_len = 0;
+    job.soa_nttl = 0;
+
 #if ZDB_HAS_NSEC3_SUPPORT
     char dot_origin[1 + MAX_DOMAIN_LENGTH + 1];
     
     dot_origin[0] = '.';
-    dot_origin_len = dnsname_to_cstr(&dot_origin[1], zone->origin) + 1;
+    job.dot_origin = dot_origin;
+    job.dot_origin_len = dnsname_to_cstr(&dot_origin[1], zone->origin) + 1;
+    job.soa_nttl = zone->min_ttl;
 #endif
     
     osformat(&bos, "$ORIGIN %{dnsname}\n$TTL %u\n", zone->origin, current_ttl);
 
+    zdb_zone_write_text_window window;
+    window.job = &job;
+    window.tp = NULL;
+    window.os = &bos;
+    ptr_vector_init_ex(&window.chunks, ZDB_ZONE_WRITE_TEXT_WINDOW);
+    window.head = 0;
+    window.formatted = 0;
+    window.held = 0;
+    window.ret = SUCCESS;
+
+    zdb_zone_write_text_chunk *chunk = zdb_zone_write_text_chunk_new(&job, ZDB_ZONE_WRITE_TEXT_CHUNK_LABELS);
+
     zdb_zone_label_iterator iter;
-    btree_iterator records_iter;
 
     zdb_zone_label_iterator_init(&iter, zone);
 
@@ -268,129 +916,25 @@ zdb_zone_write_text_ex(const zdb_zone *zone, output_stream *fos, bool force_labe
         }
 
         zdb_rr_label* label = zdb_zone_label_iterator_next(&iter);
-        
-        bool print_label = TRUE;
 
-        zdb_packed_ttlrdata* soa_ttlrdata = zdb_record_find(&label->resource_record_set, TYPE_SOA);
-
-        if(soa_ttlrdata != NULL)
+        if(chunk->count == ZDB_ZONE_WRITE_TEXT_CHUNK_SIZE)
         {
-            if(print_label)
-            {
-                osprint_tab_padded(&bos, label_cstr, label_len, INDENT_TABS);
-
-                u16 zclass = zdb_zone_getclass(zone);
-
-                osformat(&bos, "\t%{dnsclass}%tSOA%t", &zclass, (TTL_SIZE/TAB_SIZE) + 1, TTL_SIZE/TAB_SIZE);
-            }
-            else
+            if(allow_shutdown && dnscore_shuttingdown())
             {
-                osprint_tab_padded(&bos, NULL, 0, INDENT_TABS);
+                window.ret = STOPPED_BY_APPLICATION_SHUTDOWN;
+                break;
             }
-            
-            ret = osprint_rdata(&bos, TYPE_SOA, ZDB_PACKEDRECORD_PTR_RDATAPTR(soa_ttlrdata), ZDB_PACKEDRECORD_PTR_RDATASIZE(soa_ttlrdata));
-
-#ifdef DEBUG
-            status_flags_fw.value = &label->flags;
-            osformatln(&bos, " ; flags=%w", &status_flags_fw);
-#else
-            output_stream_write(&bos, (const u8*)__LF__, 1);
-#endif
 
-            if(FAIL(ret))
+            if(window.tp == NULL)
             {
-                osprintln(&bos, ";; ABOVE RECORD IS CORRUPTED");
+                window.tp = zdb_zone_write_text_thread_pool_get();
             }
-            
-
-            print_label = force_label;
-        }
-        
-        if(allow_shutdown && dnscore_shuttingdown())
-        {
-            output_stream_close(&bos);
 
-            return STOPPED_BY_APPLICATION_SHUTDOWN;
+            zdb_zone_write_text_window_push(&window, chunk);
+            chunk = zdb_zone_write_text_chunk_new(&job, ZDB_ZONE_WRITE_TEXT_CHUNK_LABELS);
         }
 
-        btree_iterator_init(label->resource_record_set, &records_iter);
-        while(btree_iterator_hasnext(&records_iter))
-        {
-            btree_node* node = btree_iterator_next_node(&records_iter);
-
-            u16 type = (u16)node->hash;
-
-            if(type == TYPE_SOA)
-            {
-                continue;
-            }
-
-            zdb_packed_ttlrdata* ttlrdata_sll = (zdb_packed_ttlrdata*)node->data;
-            
-            current_ttl = DEFAULT_TTL;
-            
-            s32 rrset_ttl = ttlrdata_sll->ttl;
-
-            while(ttlrdata_sll != NULL)
-            {
-                if(print_label)
-                {
-                    osprint_tab_padded(&bos, label_cstr, label_len, INDENT_TABS);
-                }
-                else
-                {
-                    osprint_tab_padded(&bos, NULL, 0, INDENT_TABS);
-                }
-                
-                if(current_ttl != rrset_ttl)
-                {
-                    current_ttl = rrset_ttl;
-                    osformat(&bos, "\t%-" TOSTRING(TTL_SIZE) "u\t", current_ttl);
-                }
-                else
-                {
-                    osformat(&bos, "%t", 1 + (TTL_SIZE/TAB_SIZE) + 1);
-                }
-
-                osformat(&bos, "%{dnstype}%t", &type, (TTL_SIZE/TAB_SIZE));
-
-                ret = osprint_rdata(&bos, type, ZDB_PACKEDRECORD_PTR_RDATAPTR(ttlrdata_sll), ZDB_PACKEDRECORD_PTR_RDATASIZE(ttlrdata_sll));
-                
-#ifdef DEBUG
-                status_flags_fw.value = &label->flags;
-                osformatln(&bos, " ; flags=%w", &status_flags_fw);
-#else
-                output_stream_write(&bos, (const u8*)__LF__, 1);
-#endif
-                if(FAIL(ret))
-                {
-                    osprintln(&bos, ";; ABOVE RECORD IS CORRUPTED");
-                }
-
-                print_label = force_label;
-
-                ttlrdata_sll = ttlrdata_sll->next;
-            }
-        }
-        
-#ifdef DEBUG
-        if(btree_isempty(label->resource_record_set))
-        {
-            osprint(&bos, ";; ");
-            output_stream_write(&bos, label_cstr, label_len);
-            
-            status_flags_fw.value = &label->flags;
-            
-            if(label->sub.count == 0)
-            {
-                osformatln(&bos, " is empty terminal ; flags=%w", &status_flags_fw);
-            }
-            else
-            {
-                osformatln(&bos, " is empty non-terminal ; flags=%w", &status_flags_fw);
-            }
-        }
-#endif
+        zdb_zone_write_text_chunk_add_label(chunk, label, label_cstr, label_len);
     }
 
 #if ZDB_HAS_NSEC3_SUPPORT
@@ -401,14 +945,8 @@ zdb_zone_write_text_ex(const zdb_zone *zone, output_stream *fos, bool force_labe
 
     const nsec3_zone* n3 = zone->nsec.nsec3;
 
-    while(n3 != NULL)
+    while((n3 != NULL) && ISOK(window.ret))
     {
-        u8 rdata[TYPE_BIT_MAPS_MAX_RDATA_SIZE];
-
-        u32 rdata_hash_offset = NSEC3_ZONE_RDATA_SIZE(n3);
-
-        MEMCOPY(rdata, &n3->rdata[0], NSEC3_ZONE_RDATA_SIZE(n3));
-
         nsec3_avl_iterator nsec3_items_iter;
         nsec3_avl_iterator_init(&n3->items, &nsec3_items_iter);
 
@@ -418,17 +956,8 @@ zdb_zone_write_text_ex(const zdb_zone *zone, output_stream *fos, bool force_labe
             nsec3_zone_item* item = first;
             nsec3_zone_item* next_item;
 
-            u8 digest_len = NSEC3_NODE_DIGEST_SIZE(first);
-
             do
             {
-                if(allow_shutdown && dnscore_shuttingdown())
-                {
-                    output_stream_close(&bos);
-
-                    return STOPPED_BY_APPLICATION_SHUTDOWN;
-                }
-
                 if(nsec3_avl_iterator_hasnext(&nsec3_items_iter))
                 {
                     next_item = nsec3_avl_iterator_next_node(&nsec3_items_iter);
@@ -438,151 +967,110 @@ zdb_zone_write_text_ex(const zdb_zone *zone, output_stream *fos, bool force_labe
                     next_item = first;
                 }
 
-                rdata[1] = item->flags;
-#ifdef DEBUG
-                if(item->rc == 1)
+                if((chunk->count == ZDB_ZONE_WRITE_TEXT_CHUNK_SIZE) || (chunk->kind != ZDB_ZONE_WRITE_TEXT_CHUNK_NSEC3) || (chunk->n3 != n3))
                 {
-                    if(item->rc != 0)
-                    {
-                        if(item->label.owner != NSEC3_ZONE_FAKE_OWNER)
-                        {
-                            if(item->label.owner->name[0] != 0)
-                            {
-                                osformatln(&bos, ";; Owner: %{dnslabel}", item->label.owner->name);
-                            }
-                            else
-                            {
-                                osformatln(&bos, ";; Owner: %{dnslabel} (the apex)", zone->origin);
-                            }
-                        }
-                        else
-                        {
-                            osprintln(&bos, ";; Owner: FAKE (Owned by the parents of the zone)");
-                        }
-                    }
-                    else
+                    if(allow_shutdown && dnscore_shuttingdown())
                     {
-                        osprintln(&bos, ";; Owner: ERROR : RC=0");
+                        window.ret = STOPPED_BY_APPLICATION_SHUTDOWN;
+                        break;
                     }
-                }
-                else
-                {
-                    if(item->rc > 0)
+
+                    if(chunk->count > 0)
                     {
-                        s32 i = item->rc - 1;
-                        do
+                        if(window.tp == NULL)
                         {
-                            if(item->label.owners[i] != NSEC3_ZONE_FAKE_OWNER)
-                            {
-                                if(item->label.owners[i]->name[0] != 0)
-                                {
-                                    osformatln(&bos, ";; Owner: %{dnslabel}", item->label.owners[i]->name);
-                                }
-                                else
-                                {
-                                    osformatln(&bos, ";; Owner: %{dnslabel} (the apex)", zone->origin);
-                                }
-                            }
-                            else
-                            {
-                                osprintln(&bos, ";; Owner: FAKE (Owned by the parents of the zone)");
-                            }
+                            window.tp = zdb_zone_write_text_thread_pool_get();
                         }
-                        while(i-- > 0);
+
+                        zdb_zone_write_text_window_push(&window, chunk);
                     }
                     else
                     {
-                        osprintln(&bos, ";; NO OWNER");
+                        zdb_zone_write_text_chunk_delete(chunk);
                     }
-                }
 
-                if(item->sc <= 1)
-                {
-                    if(item->sc != 0)
-                    {
-                        if(item->star_label.owner->name[0] != 0)
-                        {
-                            osformatln(&bos, ";; Star: %{dnslabel}", item->star_label.owner->name);
-                        }
-                        else
-                        {
-                            osformatln(&bos, ";; Star: %{dnslabel} (the apex)", zone->origin);
-                        }
-                    }
-                }
-                else
-                {
-                    s32 i = item->sc - 1;
-                    do
-                    {
-                        if(item->star_label.owners[i]->name[0] != 0)
-                        {
-                            osformatln(&bos, ";; Star: %{dnslabel}", item->star_label.owners[i]->name);
-                        }
-                        else
-                        {
-                            osformatln(&bos, ";; Star: %{dnslabel} (the apex)", zone->origin);
-                        }
-                    }
-                    while(i-- > 0);
+                    chunk = zdb_zone_write_text_chunk_new(&job, ZDB_ZONE_WRITE_TEXT_CHUNK_NSEC3);
+                    chunk->n3 = n3;
                 }
-#endif
-                u32 rdata_size = rdata_hash_offset;
 
-                MEMCOPY(&rdata[rdata_size], next_item->digest, digest_len + 1);
-                rdata_size += digest_len + 1;
+                chunk->u.items[chunk->count++] = item;
+                chunk->u.items[chunk->count] = next_item;
 
-                MEMCOPY(&rdata[rdata_size], item->type_bit_maps, item->type_bit_maps_size);
-                rdata_size += item->type_bit_maps_size;
-
-                ya_result hex32_len;
+                item = next_item;
+            }
+            while(next_item != first);
 
-                if(FAIL(hex32_len = output_stream_write_base32hex(&bos, NSEC3_NODE_DIGEST_PTR(item), digest_len)))
-                {
-                    return hex32_len;
-                }
+        } /* If there is a first item*/
 
-                output_stream_write(&bos, (const u8*)dot_origin, dot_origin_len);
-                output_stream_write_u8(&bos, (u8)'\t');
+        n3 = n3->next;
 
-                osformat(&bos, "%-" TOSTRING(TTL_SIZE) "u\tNSEC3\t", soa_nttl);
-                osprint_rdata(&bos, TYPE_NSEC3, rdata, rdata_size);
-                osprintln(&bos, "");
+    } /* while n3 != NULL */
 
-                zdb_packed_ttlrdata* rrsig = item->rrsig;
+#endif
 
-                while(rrsig != NULL)
-                {
-                    u32 tabs = ((hex32_len+ dot_origin_len) / TAB_SIZE) + 1 + (TTL_SIZE/TAB_SIZE) + 1;
+    /*
+     * The last chunk is formatted here, the previous ones (if any) are being formatted by the pool.
+     */
 
-                    osformat(&bos, "%tRRSIG\t", tabs); /* ${} requires a pointer to the data */
+    if(ISOK(window.ret))
+    {
+        zdb_zone_write_text_chunk_format(chunk);
+    }
 
-                    osprint_rdata(&bos, TYPE_RRSIG, ZDB_PACKEDRECORD_PTR_RDATAPTR(rrsig), ZDB_PACKEDRECORD_PTR_RDATASIZE(rrsig));
+    zdb_zone_write_text_window_wait_formatted(&window);
 
-                    osprintln(&bos, "");
+    if(formatted != NULL)
+    {
+        formatted(zone, formatted_args);
+    }
 
-                    rrsig = rrsig->next;
-                }
+    while(window.head < ptr_vector_size(&window.chunks))
+    {
+        zdb_zone_write_text_window_flush_one(&window);
+    }
 
-                item = next_item;
-            }
-            while(next_item != first);
+    ptr_vector_destroy(&window.chunks);
 
-        } /* If there is a first item*/
+    if(ISOK(window.ret))
+    {
+        if(ISOK(chunk->ret))
+        {
+            ya_result ret = output_stream_write(&bos, bytearray_output_stream_buffer(&chunk->os), bytearray_output_stream_size(&chunk->os));
 
-        n3 = n3->next;
+            if(FAIL(ret))
+            {
+                window.ret = ret;
+            }
+        }
+        else
+        {
+            window.ret = chunk->ret;
+        }
+    }
 
-    } /* while n3 != NULL */
+    zdb_zone_write_text_chunk_delete(chunk);
 
-#endif
+    cond_finalize(&job.cond);
+    mutex_destroy(&job.mtx);
 
     /* The filter closes the filtered */
 
     output_stream_close(&bos);
 
+    if(FAIL(window.ret))
+    {
+        return window.ret;
+    }
+
     return SUCCESS;
 }
 
+ya_result
+zdb_zone_write_text_ex(const zdb_zone *zone, output_stream *fos, bool force_label, bool allow_shutdown)
+{
+    ya_result ret = zdb_zone_write_text_ex_with_callback(zone, fos, force_label, allow_shutdown, NULL, NULL);
+    return ret;
+}
 
 /*
  * Without buffering:
@@ -607,7 +1095,7 @@ zdb_zone_write_text_ex(const zdb_zone *zone, output_stream *fos, bool force_labe
  */
 
 ya_result
-zdb_zone_write_text_file(const zdb_zone* zone, const char* output_file, u8 flags)
+zdb_zone_write_text_file_ex(const zdb_zone* zone, const char* output_file, u8 flags, zdb_zone_write_text_formatted_callback *formatted, void *formatted_args)
 {
     output_stream fos;
     ya_result ret;
@@ -655,7 +1143,7 @@ zdb_zone_write_text_file(const zdb_zone* zone, const char* output_file, u8 flags
     
     if(ISOK(ret = file_output_stream_create(&fos, tmp, FILE_RIGHTS)))
     {
-        if(ISOK(ret = zdb_zone_write_text_ex(zone, &fos, force_label, allow_shutdown))) // zone is locked
+        if(ISOK(ret = zdb_zone_write_text_ex_with_callback(zone, &fos, force_label, allow_shutdown, formatted, formatted_args))) // zone is locked
         {
             if(file_is_link(output_file) > 0)
             {
@@ -691,4 +1179,11 @@ zdb_zone_write_text_file(const zdb_zone* zone, const char* output_file, u8 flags
     return ret;
 }
 
+ya_result
+zdb_zone_write_text_file(const zdb_zone* zone, const char* output_file, u8 flags)
+{
+    ya_result ret = zdb_zone_write_text_file_ex(zone, output_file, flags, NULL, NULL);
+    return ret;
+}
+
 /** @} */
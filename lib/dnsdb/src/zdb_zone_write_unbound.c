@@ -101,7 +101,7 @@ zdb_zone_write_unbound(const zdb_zone* zone, const char* output_file)
     zdb_packed_ttlrdata* soa_ttlrdata = NULL;
 
     zdb_zone_label_iterator iter;
-    btree_iterator records_iter;
+    zdb_rr_collection_iterator records_iter;
 
     zdb_zone_label_iterator_init(&iter, zone);
 
@@ -131,10 +131,10 @@ zdb_zone_write_unbound(const zdb_zone* zone, const char* output_file)
             }
         }
 
-        btree_iterator_init(label->resource_record_set, &records_iter);
-        while(btree_iterator_hasnext(&records_iter))
+        zdb_rr_collection_iterator_init(label->resource_record_set, &records_iter);
+        while(zdb_rr_collection_iterator_hasnext(&records_iter))
         {
-            btree_node* node = btree_iterator_next_node(&records_iter);
+            zdb_rr_collection_node* node = zdb_rr_collection_iterator_next_node(&records_iter);
 
             u16 type = (u16)node->hash;
 
@@ -49,6 +49,7 @@
 #include <dnscore/base16.h>
 #include <dnscore/base32hex.h>
 #include <dnscore/base64.h>
+#include <dnscore/timems.h>
 
 #include "dnszone/dnszone.h"
 #include "dnszone/zone_file_reader.h"
@@ -82,6 +83,7 @@ struct zone_file_reader
 {
     parser_s parser;
     resource_record* unread_next;
+    u64 parse_start;    // the epoch in us when the reader was initialised, for the throughput
     s32 zttl;
     s32 rttl;
     u32 dot_origin_size; // with the CHR0 sentinel
@@ -1670,6 +1672,17 @@ zone_file_reader_close(zone_reader *zr)
 
     zone_file_reader *zfr = (zone_file_reader*)zr->data;
 
+    u64 bytes_read = parser_bytes_read(&zfr->parser);
+
+    if(bytes_read > 0)
+    {
+        u64 elapsed = MAX(timeus() - zfr->parse_start, 1);
+
+        // bytes per microsecond are MB per second
+
+        log_debug("zone file: parsed %llu bytes in %llu us (%llu MB/s)", bytes_read, elapsed, bytes_read / elapsed);
+    }
+
     parser_finalize(&zfr->parser);
 /*
 #if (DNSDB_USE_POSIX_ADVISE != 0) && (_XOPEN_SOURCE >= 600 || _POSIX_C_SOURCE >= 200112L)
@@ -1781,6 +1794,7 @@ zone_file_reader_init(zone_reader *zr)
         zfr->domain[0] = (u8)'\0';
         zfr->dot_origin[0] = '.';
         zfr->dot_origin[1] = '\0';
+        zfr->parse_start = timeus();
     }
 
     zr->data = zfr;
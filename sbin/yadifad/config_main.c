@@ -70,6 +70,8 @@
 #include "config_acl.h"
 #include "server_error.h"
 #include "process_class_ch.h"
+#include "server-uring.h"
+#include "server-xdp.h"
 
 /*
  *
@@ -137,6 +139,8 @@ CONFIG_ACL(      allow_update_forwarding     , S_ALLOW_UPDATE_FORWARDING  ) // d
 #endif
 /* Listening to interfaces                     */
 CONFIG_HOST_LIST(listen                      , S_LISTEN                   ) // doc
+/* Listened addresses answering the UDP queries through AF_XDP */
+CONFIG_HOST_LIST(xdp_listen                  , NULL                       )
 /* size of an EDNS0 packet */
 CONFIG_U32_RANGE(edns0_max_size              , S_EDNS0_MAX_SIZE          ,EDNS0_MIN_LENGTH, EDNS0_MAX_LENGTH ) // doc
 // overrides the cpu detection
@@ -151,7 +155,7 @@ CONFIG_U32_RANGE(thread_affinity_multiplier  , "0", 0, 4  )                 // d
 CONFIG_U32(      dnssec_thread_count         , S_DNSSEC_THREAD_COUNT      ) // doc
 CONFIG_U32(      zone_load_thread_count      , S_ZONE_LOAD_THREAD_COUNT   ) // doc
 CONFIG_U32(      zone_download_thread_count  , S_ZONE_DOWNLOAD_THREAD_COUNT  ) // doc
-CONFIG_U32_RANGE(network_model               , S_NETWORK_MODEL, 0, 1      )
+CONFIG_U32_RANGE(network_model               , S_NETWORK_MODEL, 0, 2      )
 /* Max number of TCP queries  */
 CONFIG_U32_RANGE(max_tcp_queries             , S_MAX_TCP_QUERIES          ,TCP_QUERIES_MIN, TCP_QUERIES_MAX) // doc
 CONFIG_U32(      tcp_query_min_rate          , S_TCP_QUERY_MIN_RATE       ) // doc
@@ -402,6 +406,7 @@ config_main_section_postprocess(struct config_section_descriptor_s *csd)
     class_ch_set_version(g_config->version_chaos);
     
     host_set_default_port_value(g_config->listen, ntohs(port));
+    host_set_default_port_value(g_config->xdp_listen, ntohs(port));
 
     if(g_config->server_flags & SERVER_FL_CHROOT)
     {
@@ -440,6 +445,18 @@ config_main_section_postprocess(struct config_section_descriptor_s *csd)
         return FEATURE_NOT_SUPPORTED;
     }
 #endif
+
+    if((g_config->network_model == SERVER_NETWORK_MODEL_URING) && !server_uring_supported())
+    {
+        ttylog_err("error: network-model 2 requires features not available on this system (io_uring, Linux 6.0)");
+        return FEATURE_NOT_SUPPORTED;
+    }
+
+    if((g_config->xdp_listen != NULL) && !server_xdp_supported())
+    {
+        ttylog_err("error: xdp-listen requires features not available on this system (AF_XDP)");
+        return FEATURE_NOT_SUPPORTED;
+    }
     
     g_config->axfr_retry_jitter = BOUND(AXFR_RETRY_JITTER_MIN, g_config->axfr_retry_jitter, g_config->axfr_retry_delay);
     
@@ -118,6 +118,7 @@ CONFIG_ACL(allow_update_forwarding, NULL) // doc
 // master
 
 CONFIG_FLAG32(drop_before_load, S_ZONE_FLAG_DROP_BEFORE_LOAD, flags, ZONE_FLAG_DROP_BEFORE_LOAD) // doc
+CONFIG_FLAG32(incremental_reload, S_ZONE_FLAG_INCREMENTAL_RELOAD, flags, ZONE_FLAG_INCREMENTAL_RELOAD) // doc
 CONFIG_FLAG32(maintain_dnssec, S_ZONE_FLAG_MAINTAIN_DNSSEC, flags, ZONE_FLAG_MAINTAIN_DNSSEC) // doc
 CONFIG_FLAG32(no_master_updates , S_ZONE_NO_MASTER_UPDATES, flags, ZONE_FLAG_NO_MASTER_UPDATES) // doc
 CONFIG_FLAG32(notify_auto , S_ZONE_NOTIFY_AUTO, flags, ZONE_FLAG_NOTIFY_AUTO) // doc
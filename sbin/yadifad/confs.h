@@ -199,6 +199,7 @@ extern "C" {
 #define     S_ZONE_FLAG_MAINTAIN_DNSSEC  "1"
 #define     S_ZONE_FLAG_TRUE_MULTIMASTER "0"
 #define     S_ZONE_FLAG_RRSIG_NSUPDATE_ALLOWED "0"
+#define     S_ZONE_FLAG_INCREMENTAL_RELOAD "1"
 #define     S_MULTIMASTER_RETRIES       "0"             // in a multimaster setup, how many retries before changing master
                                                         // 0 is perfectly fine except in true-multimaster mode where the resource cost
                                                         // asks for some caution.  In that case 60 would be a good choice. Maximum is 255
@@ -327,6 +328,8 @@ struct config_data
 {
     /* Which are the interfaces to listen at */
     host_address                                                *listen;
+    /* The listened addresses answered through AF_XDP */
+    host_address                                            *xdp_listen;
 
     /* General variables */
     char                                                     *data_path; /* zones */
@@ -368,7 +371,7 @@ struct config_data
     int                                             xfr_connect_timeout;
     int                                           statistics_max_period;
     int                                                  edns0_max_size;
-    int                                                   network_model; // 0: default MT, 1: experimental RqW 
+    int                                                   network_model; // 0: default MT, 1: experimental RqW, 2: io_uring 
     bool                                          axfr_compress_packets;
 
     /**/
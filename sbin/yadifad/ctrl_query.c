@@ -45,12 +45,14 @@
 #include "config.h"
 
 #include <dnscore/file_output_stream.h>
+#include <dnscore/bytearray_output_stream.h>
 #include <dnscore/logger.h>
 #include <dnscore/rfc.h>
 #include <dnscore/ctrl-rfc.h>
 #include <dnscore/threaded_queue.h>
 
 #include <dnsdb/zdb_zone.h>
+#include <dnsdb/zdb-zone-lock-profile.h>
 #include <dnscore/format.h>
 #include <dnscore/packet_reader.h>
 #include <dnscore/packet_writer.h>
@@ -72,6 +74,8 @@ extern logger_handle *g_server_logger;
 
 #include "notify.h"
 
+#include "query_statistics.h"
+
 #ifdef HAS_CTRL
 
 extern zone_data_set database_zone_desc;
@@ -367,6 +371,236 @@ ctrl_query_logger_reopen(message_data *mesg)
     }
 }
 
+/**
+ * Room kept at the end of the answer for the TSIG record
+ */
+
+#define CTRL_QUERY_JSON_TSIG_ROOM 512
+
+/**
+ * Bytes of JSON in a TXT record (64 character-strings, a 16KB RDATA), and in an answer.
+ * A page of TXT records, the paging record and the TSIG fit in a TCP message.
+ */
+
+#define CTRL_QUERY_JSON_TXT_SIZE    (255 * 64)
+#define CTRL_QUERY_JSON_PAGE_SIZE   (CTRL_QUERY_JSON_TXT_SIZE * 3)
+
+/**
+ * The number of waits and holds listed in the lock profile
+ */
+
+#define CTRL_QUERY_SERVER_LOCKS_MAX 32
+
+typedef ya_result ctrl_query_json_writer(output_stream *os);
+
+/**
+ * The last JSON objects that needed more than one page, kept for the queries of the next pages.
+ * A few are kept so clients reading at the same time do not replace each other's.
+ */
+
+#define CTRL_QUERY_JSON_SNAPSHOT_COUNT 4
+
+struct ctrl_query_json_snapshot_s
+{
+    u8 *json;
+    u32 size;
+    u32 id;
+    u16 type;
+};
+
+static mutex_t ctrl_query_json_snapshot_mtx = MUTEX_INITIALIZER;
+static struct ctrl_query_json_snapshot_s ctrl_query_json_snapshot[CTRL_QUERY_JSON_SNAPSHOT_COUNT];
+static u32 ctrl_query_json_snapshot_id = 0;
+
+/**
+ * Writes a page of JSON as TXT records of at most CTRL_QUERY_JSON_TXT_SIZE bytes, each split in character-strings.
+ * Returns the number of records.
+ */
+
+static u16
+ctrl_query_json_write_page(packet_writer *pw, const u8 *json, u32 json_size)
+{
+    u16 count = 0;
+
+    for(u32 record_offset = 0; record_offset < json_size; record_offset += CTRL_QUERY_JSON_TXT_SIZE)
+    {
+        u32 record_size = MIN(json_size - record_offset, CTRL_QUERY_JSON_TXT_SIZE);
+        u32 rdata_size = record_size + (record_size + 254) / 255; // one length byte per character-string
+
+        packet_writer_add_u8(pw, 0);           // .
+        packet_writer_add_u16(pw, TYPE_TXT);
+        packet_writer_add_u16(pw, CLASS_CTRL);
+        packet_writer_add_u32(pw, 0);
+        packet_writer_add_u16(pw, htons(rdata_size));
+
+        for(u32 offset = record_offset; offset < record_offset + record_size; offset += 255)
+        {
+            u32 chunk_size = MIN(record_offset + record_size - offset, 255);
+            packet_writer_add_u8(pw, chunk_size);
+            packet_writer_add_bytes(pw, &json[offset], chunk_size);
+        }
+
+        ++count;
+    }
+
+    return count;
+}
+
+/**
+ * Answers a JSON object produced by the writer.
+ *
+ * The answer section starts with a paging record of the command type (snapshot id, page, page count, all u32)
+ * followed by the TXT records holding the JSON of the page.
+ * The query of the first page has no record.  The queries of the next pages have a record of the command type with
+ * the snapshot id and the page (u32).  The object of the first page is kept for them if it needs several pages.
+ * A query for a snapshot that has been dropped is answered with SERVFAIL, the client then restarts.
+ */
+
+static void
+ctrl_query_json_answer(message_data *mesg, u16 expected_type, const char *name, ctrl_query_json_writer *writer)
+{
+    packet_unpack_reader_data pr;
+    u16 cmd_type;
+    u16 cmd_class;
+    
+    packet_reader_init(&pr, mesg->buffer, mesg->received);
+    packet_reader_skip(&pr, DNS_HEADER_LENGTH);
+    packet_reader_skip_fqdn(&pr);
+    packet_reader_read_u16(&pr, &cmd_type);
+    
+    ya_result return_code = packet_reader_read_u16(&pr, &cmd_class);
+    
+    u16 qc = ntohs(MESSAGE_QD(mesg->buffer));
+    u16 pc = ntohs(MESSAGE_AN(mesg->buffer));
+    u16 an = ntohs(MESSAGE_NS(mesg->buffer));
+    
+    if(!(ISOK(return_code) && (qc == 1) && (pc <= 1) && (an == 0) && (cmd_type == expected_type) && (cmd_class == CLASS_CTRL)))
+    {
+        message_make_error(mesg, RCODE_FORMERR);
+        return;
+    }
+    
+    u32 question_end = pr.offset;
+    u32 snapshot_id = 0;
+    u32 page = 0;
+    
+    if(pc == 1)
+    {
+        struct type_class_ttl_rdlen tctr;
+        u32 paging[2];
+        
+        packet_reader_skip_fqdn(&pr);
+        
+        if(FAIL(packet_reader_read(&pr, &tctr, 10)) || (tctr.qtype != expected_type) || (tctr.qclass != CLASS_CTRL) ||
+           (tctr.rdlen != NU16(sizeof(paging))) || FAIL(packet_reader_read(&pr, paging, sizeof(paging))))
+        {
+            message_make_error(mesg, RCODE_FORMERR);
+            return;
+        }
+        
+        snapshot_id = ntohl(paging[0]);
+        page = ntohl(paging[1]);
+    }
+    
+    if(ACL_REJECTED(acl_check_access_filter(mesg, &g_config->ac.allow_control)))
+    {
+        log_err("ctrl: %s: rejected by ACL", name);
+
+        message_make_error(mesg, RCODE_REFUSED);
+        return;
+    }
+    
+    mesg->size_limit = DNSPACKET_MAX_LENGTH; // control is done over TCP
+    
+    packet_writer pw;
+    packet_writer_init(&pw, mesg->buffer, question_end, mesg->size_limit - CTRL_QUERY_JSON_TSIG_ROOM);
+    
+    output_stream os;
+    const u8 *json;
+    u32 json_size;
+    u32 page_count;
+    
+    bytearray_output_stream_init(&os, NULL, 0);
+    
+    if(page == 0)
+    {
+        writer(&os);
+    
+        json = bytearray_output_stream_buffer(&os);
+        json_size = bytearray_output_stream_size(&os);
+        page_count = MAX((json_size + CTRL_QUERY_JSON_PAGE_SIZE - 1) / CTRL_QUERY_JSON_PAGE_SIZE, 1);
+        
+        mutex_lock(&ctrl_query_json_snapshot_mtx);
+        
+        if(page_count > 1)
+        {
+            // keep the object for the next pages, in place of the oldest one
+            
+            snapshot_id = ++ctrl_query_json_snapshot_id;
+            
+            struct ctrl_query_json_snapshot_s *snapshot = &ctrl_query_json_snapshot[snapshot_id % CTRL_QUERY_JSON_SNAPSHOT_COUNT];
+            free(snapshot->json);
+            snapshot->json = bytearray_output_stream_detach(&os);
+            snapshot->size = json_size;
+            snapshot->id = snapshot_id;
+            snapshot->type = expected_type;
+        }
+    }
+    else
+    {
+        mutex_lock(&ctrl_query_json_snapshot_mtx);
+        
+        struct ctrl_query_json_snapshot_s *snapshot = &ctrl_query_json_snapshot[snapshot_id % CTRL_QUERY_JSON_SNAPSHOT_COUNT];
+        
+        page_count = (snapshot->size + CTRL_QUERY_JSON_PAGE_SIZE - 1) / CTRL_QUERY_JSON_PAGE_SIZE;
+        
+        if((snapshot->json == NULL) || (snapshot->type != expected_type) || (snapshot->id != snapshot_id) || (page >= page_count))
+        {
+            mutex_unlock(&ctrl_query_json_snapshot_mtx);
+            
+            log_info("ctrl: %s: page %u of snapshot %u is not available anymore", name, page, snapshot_id);
+            
+            output_stream_close(&os);
+            message_make_error(mesg, RCODE_SERVFAIL);
+            return;
+        }
+        
+        json = snapshot->json;
+        json_size = snapshot->size;
+    }
+    
+    // the snapshot mutex is held
+    
+    u32 page_offset = page * CTRL_QUERY_JSON_PAGE_SIZE;
+    u32 page_size = MIN(json_size - page_offset, CTRL_QUERY_JSON_PAGE_SIZE);
+    u32 paging[3] = {htonl(snapshot_id), htonl(page), htonl(page_count)};
+    
+    packet_writer_add_u8(&pw, 0);           // .
+    packet_writer_add_u16(&pw, expected_type);
+    packet_writer_add_u16(&pw, CLASS_CTRL);
+    packet_writer_add_u32(&pw, 0);
+    packet_writer_add_u16(&pw, htons(sizeof(paging)));
+    packet_writer_add_bytes(&pw, (const u8*)paging, sizeof(paging));
+    
+    u16 txt_count = ctrl_query_json_write_page(&pw, &json[page_offset], page_size);
+    
+    mutex_unlock(&ctrl_query_json_snapshot_mtx);
+    
+    MESSAGE_SET_AN(mesg->buffer, htons(1 + txt_count));
+    MESSAGE_SET_NS(mesg->buffer, 0);
+    MESSAGE_SET_AR(mesg->buffer, 0);
+    
+    mesg->send_length = packet_writer_get_offset(&pw);
+    
+    output_stream_close(&os);
+}
+
+static ya_result
+ctrl_query_server_locks_write_json(output_stream *os)
+{
+    return zdb_zone_lock_profile_write_json(os, CTRL_QUERY_SERVER_LOCKS_MAX);
+}
+
 static void
 ctrl_query_config_reload(message_data *mesg)
 {
@@ -1174,6 +1408,16 @@ ctrl_query_process(message_data *mesg)
             ctrl_query_log_level(mesg);
             break;
         }
+        case TYPE_CTRL_SRVSTATS:
+        {
+            ctrl_query_json_answer(mesg, TYPE_CTRL_SRVSTATS, "stats", query_statistics_write_json);
+            break;
+        }
+        case TYPE_CTRL_SRVLOCKS:
+        {
+            ctrl_query_json_answer(mesg, TYPE_CTRL_SRVLOCKS, "locks", ctrl_query_server_locks_write_json);
+            break;
+        }
         case TYPE_CTRL_ZONEFREEZE:   /* freeze */
         {
             ctrl_query_zone_freeze(mesg);
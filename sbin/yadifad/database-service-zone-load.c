@@ -69,6 +69,7 @@
 #include <dnsdb/journal.h>
 #include <dnsdb/xfr_copy.h>
 #include <dnsdb/zdb_icmtl.h>
+#include <dnsdb/dynupdate-diff.h>
 
 #include <dnsdb/zdb-zone-maintenance.h>
 
@@ -198,6 +199,7 @@ database_load_zone_master(zdb *db, zone_desc_s *zone_desc, zdb_zone **zone) // r
     u32 zone_desc_dnssec_mode;
 #endif
     bool is_drop_before_load;
+    bool is_incremental_reload;
     bool zr_opened = FALSE;
     bool zone_file_soa_serial_set = FALSE;
     bool rrsig_push_allowed = FALSE;
@@ -209,6 +211,7 @@ database_load_zone_master(zdb *db, zone_desc_s *zone_desc, zdb_zone **zone) // r
     zone_desc_dnssec_mode = zone_desc->dnssec_mode << ZDB_ZONE_DNSSEC_SHIFT;
 #endif
     is_drop_before_load = zone_is_drop_before_load(zone_desc);
+    is_incremental_reload = zone_is_incremental_reload(zone_desc);
     
     rrsig_push_allowed = zone_rrsig_nsupdate_allowed(zone_desc);
     
@@ -328,6 +331,50 @@ database_load_zone_master(zdb *db, zone_desc_s *zone_desc, zdb_zone **zone) // r
 
                         return SUCCESS;
                     }
+
+                    if(is_incremental_reload)
+                    {
+                        // apply the changes of the file to the zone instead of loading it again
+                        
+                        log_info("zone load: %{dnsname}: applying the changes of '%s' (%u -> %u)", zone_desc_origin, file_name, zone_serial, zone_file_soa_serial);
+                        
+                        return_value = dynupdate_diff_from_zone_reader(*zone, &zr, ZDB_ZONE_MUTEX_DYNUPDATE);
+                        
+                        zone_reader_close(&zr);
+                        
+                        s64 zone_load_end = (s64)timeus();
+                        double load_time = zone_load_end - zone_load_begin;
+                        load_time /= 1000000.;
+                        
+                        if(ISOK(return_value))
+                        {
+                            zone_lock(zone_desc, ZONE_LOCK_LOAD);
+                            zone_desc->stored_serial = zone_file_soa_serial;
+                            zone_unlock(zone_desc, ZONE_LOCK_LOAD);
+                            
+                            log_info("zone load: %{dnsname}: '%s' applied incrementally, %i records changed (%9.6fs)", zone_desc_origin, file_name, return_value, load_time);
+                            
+                            notify_slaves(zone_desc_origin);
+                            
+                            return SUCCESS;
+                        }
+                        
+                        log_info("zone load: %{dnsname}: '%s' cannot be applied incrementally: %r (%9.6fs)", zone_desc_origin, file_name, return_value, load_time);
+                        
+                        // the zone is unchanged, load the file the usual way
+                        
+                        if(FAIL(return_value = zone_file_reader_open(file_name, &zr)))
+                        {
+                            zdb_zone_release(*zone);
+                            *zone = NULL;
+                            
+                            log_err("zone load: '%s' could not open file '%s': %r", zone_desc->domain, file_name, return_value);
+                            
+                            return return_value;
+                        }
+                        
+                        zone_file_reader_set_origin(&zr, zone_desc_origin);
+                    }
                 }
                 else
                 {
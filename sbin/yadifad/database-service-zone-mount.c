@@ -57,6 +57,7 @@
 #include <dnsdb/zdb_zone.h>
 #include <dnsdb/zdb_zone_label.h>
 #include <dnsdb/zdb.h>
+#include <dnsdb/zdb-zone-garbage.h>
 
 #include "database-service.h"
 
@@ -133,7 +134,9 @@ database_service_zone_mount(zone_desc_s *zone_desc)
     
     //
     
-    zdb_zone *old_zone = zdb_set_zone(db, zone); // RC++, because the zone is put into the database
+    // the new instance is swapped in while the queries keep running on the old one
+    
+    zdb_zone *old_zone = zdb_replace_zone(db, zone); // RC++, because the zone is put into the database
     
     bool send_notify_to_slaves = TRUE;
     
@@ -141,12 +144,12 @@ database_service_zone_mount(zone_desc_s *zone_desc)
     {
         if(zone != old_zone)
         {
-            // there is already a different zone mounted
+            // there was a different zone mounted: the collector will set it as invalid and release it
+            // when no query can be reading it anymore
 
-            zdb_zone_lock(old_zone, ZDB_ZONE_MUTEX_REPLACE);
-            // set old zone as invalid                
-            old_zone->apex->flags |= ZDB_RR_LABEL_INVALID_ZONE;
-            zdb_zone_unlock(old_zone, ZDB_ZONE_MUTEX_REPLACE);
+            log_debug("%{dnsname}: retiring zone@%p replaced by zone@%p (database_service_zone_mount)", zone->origin, old_zone, zone);
+            
+            zdb_zone_garbage_retire(db, old_zone);
         }
         else
         {
@@ -154,9 +157,9 @@ database_service_zone_mount(zone_desc_s *zone_desc)
                     zone->origin, old_zone, zone);
             
             send_notify_to_slaves = FALSE;
+            
+            zdb_zone_release(old_zone);
         }
-        
-        zdb_zone_release(old_zone);
     }
        
     //
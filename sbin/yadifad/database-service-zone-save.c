@@ -66,6 +66,38 @@
 
 #define MODULE_MSG_HANDLE g_server_logger
 
+struct database_service_zone_save_formatted_args
+{
+    zone_desc_s *zone_desc;
+    u32 serial;
+    u8 zonelockowner;   // 0 to keep the zone locked until the file is written
+    bool unlocked;
+};
+
+/**
+ * Called by the text writer once it has read the whole zone: keeps the serial and releases the zone lock
+ * so the file is written without blocking the updates of the zone.
+ *
+ * The zone is not marked as modified anymore from this point: an update made while the file is being
+ * written marks it again.
+ */
+
+static void
+database_service_zone_save_formatted(const zdb_zone *zone, void *args_)
+{
+    struct database_service_zone_save_formatted_args *args = (struct database_service_zone_save_formatted_args*)args_;
+    
+    zdb_zone_getserial(zone, &args->serial); // zone is locked
+    
+    zone_clear_status(args->zone_desc, ZONE_STATUS_MODIFIED);
+    
+    if(args->zonelockowner != 0)
+    {
+        zdb_zone_unlock((zdb_zone*)zone, args->zonelockowner);
+        args->unlocked = TRUE;
+    }
+}
+
 /**
  * Saves a zone in the current thread using the provided locks (0 meaning: do not try to lock)
  * Not locking puts the responsibility of the lock to the caller as having this code running
@@ -189,6 +221,13 @@ database_service_zone_save_ex(zone_desc_s *zone_desc, u8 desclockowner, u8 zonel
     
     ya_result ret = ERROR;
     
+    // the journal can only be cleared if no update has been journaled since the zone has been read,
+    // so the zone stays locked until the file is written
+    
+    bool clear_journal = zone_get_status(zone_desc) & ZONE_STATUS_MUST_CLEAR_JOURNAL;
+    
+    struct database_service_zone_save_formatted_args formatted_args = {zone_desc, 0, (clear_journal)?0:zonelockowner, FALSE};
+    
     if(zone != NULL)
     {
         if(zdb_zone_isvalid(zone))
@@ -198,18 +237,15 @@ database_service_zone_save_ex(zone_desc_s *zone_desc, u8 desclockowner, u8 zonel
     
             log_info("zone save: %{dnsname} saving zone to file '%s'", zone_desc->origin, file_name);
             
-            ret = zdb_zone_write_text_file(zone, file_name, flags); // zone is locked
+            ret = zdb_zone_write_text_file_ex(zone, file_name, flags, database_service_zone_save_formatted, &formatted_args); // zone is locked, unlocked by the callback
             
             if(ISOK(ret))
             {
-                zdb_zone_getserial(zone, &zone_desc->stored_serial); // zone is locked
-                zone_clear_status(zone_desc, ZONE_STATUS_MODIFIED);
-                
-                bool clear_journal = zone_get_status(zone_desc) & ZONE_STATUS_MUST_CLEAR_JOURNAL;
+                zone_desc->stored_serial = formatted_args.serial;
                 
                 if(clear_journal)
                 {
-                    journal_truncate(zone_desc->origin);
+                    journal_truncate(zone_desc->origin); // zone is still locked
                     zone_clear_status(zone_desc, ZONE_STATUS_MUST_CLEAR_JOURNAL);
                 }
                 
@@ -217,6 +253,8 @@ database_service_zone_save_ex(zone_desc_s *zone_desc, u8 desclockowner, u8 zonel
             }
             else
             {
+                zone_set_status(zone_desc, ZONE_STATUS_MODIFIED); // still to be saved
+                
                 if(ret != STOPPED_BY_APPLICATION_SHUTDOWN)
                 {
                     log_err("zone save: %{dnsname} failed to save as '%s': %r", zone_desc->origin, file_name, ret);
@@ -232,7 +270,7 @@ database_service_zone_save_ex(zone_desc_s *zone_desc, u8 desclockowner, u8 zonel
             log_err("zone save: %{dnsname} cannot be saved because its current instance in the database is marked as invalid", zone_desc->origin);
         }
         
-        if(zonelockowner != 0)
+        if((zonelockowner != 0) && !formatted_args.unlocked)
         {
             zdb_zone_release_unlock(zone, zonelockowner);
         }
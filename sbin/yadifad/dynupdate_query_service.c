@@ -211,7 +211,7 @@ dynupdate_query_service_thread_main_loop:
                     //log_err("sendto: %r", MAKE_ERRNO_ERROR(error_code));
 
                     free(parms);
-                    free(mesg);
+                    message_free(mesg);
 
                     return NULL/*ERROR*/;
                 }
@@ -251,7 +251,7 @@ dynupdate_query_service_thread_main_loop:
 
 
                     free(parms);
-                    free(mesg);
+                    message_free(mesg);
 
                     /**********************************************************
                      * GOTO !
@@ -283,7 +283,7 @@ dynupdate_query_service_thread_main_loop:
         }
 
         free(parms);
-        free(mesg);
+        message_free(mesg);
     }
     
     log_debug("dynupdate_query_service_thread: service stopped");
@@ -354,7 +354,7 @@ dynupdate_query_service_stop()
         
         if(parms != NULL)
         {
-            free(parms->mesg);
+            message_free(parms->mesg);
             free(parms);
         }
     }
@@ -369,28 +369,19 @@ dynupdate_query_service_stop()
 }
 
 ya_result
-dynupdate_query_service_enqueue(zdb *db, message_data *msg)
+dynupdate_query_service_enqueue_handoff(zdb *db, message_data *msg)
 {
     if(dynupdate_query_service_thread_id == 0)
     {
+        message_free(msg);
+        
         return SERVICE_NOT_RUNNING;
     }
     
-    message_data *mesg_clone;
-    MALLOC_OR_DIE(message_data*, mesg_clone, sizeof(message_data), MESGDATA_TAG);
-    memcpy(mesg_clone, msg, sizeof(message_data));
-    // ensure the original message cannot be used anymore
-    
-#if HAS_TSIG_SUPPORT
-    msg->tsig.tsig = NULL;
-#endif
-    msg->received = 0;
-    msg->send_length = 0;
-    
     struct dynupdate_query_service_args *parms;
     MALLOC_OR_DIE(struct dynupdate_query_service_args *, parms, sizeof(dynupdate_query_service_args), DYNUPQSA_TAG);
     parms->db = db;
-    parms->mesg = mesg_clone;
+    parms->mesg = msg;
         
     parms->timestamp = time(NULL);
     
@@ -399,6 +390,29 @@ dynupdate_query_service_enqueue(zdb *db, message_data *msg)
     return SUCCESS;
 }
 
+ya_result
+dynupdate_query_service_enqueue(zdb *db, message_data *msg)
+{
+    if(dynupdate_query_service_thread_id == 0)
+    {
+        return SERVICE_NOT_RUNNING;
+    }
+    
+    // only the header and the bytes of the update are copied
+    
+    message_data *mesg_clone = message_dup(msg);
+    
+    // ensure the original message cannot be used anymore
+    
+#if HAS_TSIG_SUPPORT
+    msg->tsig.tsig = NULL;
+#endif
+    msg->received = 0;
+    msg->send_length = 0;
+    
+    return dynupdate_query_service_enqueue_handoff(db, mesg_clone);
+}
+
 /*    ------------------------------------------------------------    */
 
 /** @} */
@@ -55,7 +55,21 @@
 
 ya_result dynupdate_query_service_start();
 ya_result dynupdate_query_service_stop();
+
+/**
+ * Queues a copy of the update.  The message of the caller is left with
+ * nothing to send.
+ */
+
 ya_result dynupdate_query_service_enqueue(zdb *db, message_data *msg);
 
+/**
+ * Queues the update itself.  The service becomes the owner of the message,
+ * which must come from message_new_instance (e.g. message_handoff).
+ * It is given back with message_free even if the service is not running.
+ */
+
+ya_result dynupdate_query_service_enqueue_handoff(zdb *db, message_data *msg);
+
 
 /** @} */
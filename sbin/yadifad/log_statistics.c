@@ -44,6 +44,10 @@
 #include "server-config.h"
 #include "config.h"
 
+#include <dnscore/format.h>
+#include <dnscore/thread_pool.h>
+#include <dnscore/sys_numa.h>
+
 #define LOG_STATISTICS_C_
 
 #include "log_statistics.h"
@@ -103,6 +107,11 @@ log_statistics_legend()
             "\tsl : truncated answer count\n"
             "\tdr : dropped answer count\n"
 #endif            
+            "\n"
+            "numa (with more than one node):\n"
+            "\n"
+            "\tnN : udp input count of the workers running on node N\n"
+            "\trm : udp input count of the workers not on the node of their network interface\n"
             );
 }
 
@@ -219,6 +228,21 @@ log_statistics(server_statistics_t *server_statistics)
             server_statistics->rrl_drop
 #endif           
             );
+    
+    if(sys_numa_node_count() > 1)
+    {
+        char numa_text[32 * SYS_NUMA_NODE_COUNT_MAX];
+        int numa_text_len = 0;
+        
+        for(int node = 0; node < sys_numa_node_count(); ++node)
+        {
+            numa_text_len += snformat(&numa_text[numa_text_len], sizeof(numa_text) - numa_text_len, "n%i=%llu ", node, server_statistics->udp_node_input_count[node]);
+        }
+        
+        logger_handle_msg(g_statistics_logger, MSG_INFO, "numa (%srm=%llu)", numa_text, server_statistics->udp_remote_input_count);
+    }
+    
+    thread_pool_log_stats_all(g_statistics_logger);
 }
 
 /*    ------------------------------------------------------------    */
@@ -62,6 +62,7 @@
 #include <dnscore/dnscore.h>
 #include <dnscore/chroot.h>
 #include <dnscore/async.h>
+#include <dnscore/message.h>
 #include <dnscore/service.h>
 #include <dnscore/logger-output-stream.h>
 
@@ -83,6 +84,7 @@
 #include "signals.h"
 #include "server.h"
 #include "notify.h"
+#include "query_statistics.h"
 
 
 #include "database-service.h"
@@ -440,6 +442,8 @@ main_exit()
         
         database_finalize();
         
+        query_statistics_finalize();
+        
         if(own_pid)
         {
             log_info("releasing pid file lock");
@@ -568,6 +572,7 @@ main(int argc, char *argv[])
     main_check_lock_from_start(argc, (const char**)argv);
         
     async_message_pool_init();
+    message_handoff_pool_init();
 
     // registers yadifad error codes
 
@@ -95,10 +95,16 @@ extern logger_handle *g_server_logger;
 #define NOTIFY_MESSAGE_TYPE_CLEAR   4
 
 #define MESSAGE_QUERY_TIMEOUT 5
-#define MESSAGE_QUERY_TRIES   1
+#define MESSAGE_QUERY_TRIES   3
 
 #define MESSAGE_QUERY_TIMEOUT_US (MESSAGE_QUERY_TIMEOUT * 1000000)
 
+#define NOTIFY_SECONDARY_IN_FLIGHT_MAX  16          // unanswered notifications to one slave
+#define NOTIFY_RTO_INITIAL_US           1000000     // until an RTT has been measured
+#define NOTIFY_RTO_MIN_US               500000
+#define NOTIFY_RTO_MAX_US               MESSAGE_QUERY_TIMEOUT_US
+#define NOTIFY_SERVICE_TICK_US          100000      // service period while notifications are pending
+
 static struct thread_pool_s *notify_thread_pool = NULL;
 
 static int send_socket4 = -1;
@@ -108,6 +114,206 @@ static struct service_s notify_handler = UNINITIALIZED_SERVICE;
 static async_queue_s notify_handler_queue;
 static volatile bool notify_service_initialised = FALSE;
 
+#define NTFYSCND_TAG 0x444e43535946544e
+#define NTFYSQEN_TAG 0x4e4551535946544e
+
+/**
+ * The state kept for each slave by the notification service.
+ * 
+ * The zones waiting to be notified to the slave are queued here, once.
+ * A zone that is queued again before being sent is only notified once.
+ * At most NOTIFY_SECONDARY_IN_FLIGHT_MAX notifications are waiting for an answer from the slave,
+ * the others stay queued until answers come or queries expire.
+ * The round-trip time to the slave is measured (RFC 6298) and gives the retry timeout.
+ */
+
+typedef struct notify_secondary notify_secondary;
+
+struct notify_secondary
+{
+    host_address *host;             // key
+    ptr_set queue;                  // notify_secondary_entry, by origin
+    u32 in_flight;
+    u32 srtt_us;                    // 0 until the first measure
+    u32 rttvar_us;
+};
+
+typedef struct notify_secondary_entry notify_secondary_entry;
+
+struct notify_secondary_entry
+{
+    u8 *origin;                     // key
+    host_address *host;             // the slave with the TSIG key to use for this zone
+    u16 ztype;
+    u16 zclass;
+};
+
+static void
+notify_secondary_entry_delete(notify_secondary_entry *entry)
+{
+    dnsname_zfree(entry->origin);
+    host_address_delete(entry->host);
+    ZFREE(entry, notify_secondary_entry);
+}
+
+static int
+notify_secondary_entry_compare(const void *node_a, const void *node_b)
+{
+    const u8 *m_a = (const u8*)node_a;
+    const u8 *m_b = (const u8*)node_b;
+
+    return dnsname_compare(m_a, m_b);
+}
+
+static notify_secondary*
+notify_secondary_get(ptr_set *secondaries, const host_address *ha)
+{
+    ptr_node *node = ptr_set_avl_insert(secondaries, (host_address*)ha);
+    
+    if(node->value == NULL)
+    {
+        notify_secondary *secondary;
+        ZALLOC_OR_DIE(notify_secondary*, secondary, notify_secondary, NTFYSCND_TAG);
+        secondary->host = host_address_copy(ha);
+        secondary->queue.root = NULL;
+        secondary->queue.compare = notify_secondary_entry_compare;
+        secondary->in_flight = 0;
+        secondary->srtt_us = 0;
+        secondary->rttvar_us = 0;
+        node->key = secondary->host;
+        node->value = secondary;
+    }
+    
+    return (notify_secondary*)node->value;
+}
+
+static void
+notify_secondary_delete(notify_secondary *secondary)
+{
+    ptr_set_avl_iterator iter;
+    ptr_set_avl_iterator_init(&secondary->queue, &iter);
+    while(ptr_set_avl_iterator_hasnext(&iter))
+    {
+        ptr_node *node = ptr_set_avl_iterator_next_node(&iter);
+        notify_secondary_entry_delete((notify_secondary_entry*)node->value);
+    }
+    ptr_set_avl_destroy(&secondary->queue);
+    host_address_delete(secondary->host);
+    ZFREE(secondary, notify_secondary);
+}
+
+/**
+ * Queues a zone to be notified to the slave.
+ * If the zone is already queued, it is not queued again but will be sent with the latest parameters.
+ * 
+ * @return TRUE if the zone has been queued, FALSE if it was already
+ */
+
+static bool
+notify_secondary_enqueue(notify_secondary *secondary, const host_address *ha, const u8 *origin, u16 ztype, u16 zclass)
+{
+    ptr_node *node = ptr_set_avl_insert(&secondary->queue, (u8*)origin);
+    notify_secondary_entry *entry = (notify_secondary_entry*)node->value;
+    
+    if(entry == NULL)
+    {
+        ZALLOC_OR_DIE(notify_secondary_entry*, entry, notify_secondary_entry, NTFYSQEN_TAG);
+        entry->origin = dnsname_zdup(origin);
+        entry->host = host_address_copy(ha);
+        entry->ztype = ztype;
+        entry->zclass = zclass;
+        node->key = entry->origin;
+        node->value = entry;
+        
+        return TRUE;
+    }
+    else
+    {
+#if HAS_TSIG_SUPPORT
+        entry->host->tsig = ha->tsig;
+#endif
+        entry->ztype = ztype;
+        entry->zclass = zclass;
+        
+        return FALSE;
+    }
+}
+
+/**
+ * Removes a zone from the queues of all the slaves.
+ */
+
+static void
+notify_secondaries_dequeue(ptr_set *secondaries, const u8 *origin)
+{
+    ptr_set_avl_iterator iter;
+    ptr_set_avl_iterator_init(secondaries, &iter);
+    while(ptr_set_avl_iterator_hasnext(&iter))
+    {
+        ptr_node *node = ptr_set_avl_iterator_next_node(&iter);
+        notify_secondary *secondary = (notify_secondary*)node->value;
+        ptr_node *entry_node = ptr_set_avl_find(&secondary->queue, origin);
+        
+        if(entry_node != NULL)
+        {
+            notify_secondary_entry *entry = (notify_secondary_entry*)entry_node->value;
+            ptr_set_avl_delete(&secondary->queue, origin);
+            notify_secondary_entry_delete(entry);
+        }
+    }
+}
+
+/**
+ * Retransmission timeout for the slave (RFC 6298)
+ */
+
+static u64
+notify_secondary_rto_us(const notify_secondary *secondary)
+{
+    if(secondary->srtt_us == 0)
+    {
+        return NOTIFY_RTO_INITIAL_US;
+    }
+    
+    u64 rto = (u64)secondary->srtt_us + 4 * (u64)secondary->rttvar_us;
+    
+    if(rto < NOTIFY_RTO_MIN_US)
+    {
+        rto = NOTIFY_RTO_MIN_US;
+    }
+    else if(rto > NOTIFY_RTO_MAX_US)
+    {
+        rto = NOTIFY_RTO_MAX_US;
+    }
+    
+    return rto;
+}
+
+static void
+notify_secondary_rtt_sample(notify_secondary *secondary, u64 rtt_us)
+{
+    if(rtt_us > NOTIFY_RTO_MAX_US)
+    {
+        rtt_us = NOTIFY_RTO_MAX_US;
+    }
+    
+    if(secondary->srtt_us == 0)
+    {
+        secondary->srtt_us = MAX(rtt_us, 1);
+        secondary->rttvar_us = rtt_us / 2;
+    }
+    else
+    {
+        u64 delta = (secondary->srtt_us > rtt_us)?secondary->srtt_us - rtt_us:rtt_us - secondary->srtt_us;
+        secondary->rttvar_us = (3 * (u64)secondary->rttvar_us + delta) / 4;
+        secondary->srtt_us = MAX((7 * (u64)secondary->srtt_us + rtt_us) / 8, 1);
+    }
+    
+#ifdef DEBUG
+    log_debug("notify: %{hostaddr}: rtt=%lluus srtt=%uus rttvar=%uus", secondary->host, rtt_us, secondary->srtt_us, secondary->rttvar_us);
+#endif
+}
+
 typedef struct message_query_summary message_query_summary;
 
 #define MSGQSUMR_TAG 0x524d55535147534d
@@ -116,8 +322,10 @@ struct message_query_summary
 {
     host_address *host;
     message_query_summary *next;    /* this pointer is used to list the items, ie: for deletion */
+    notify_secondary *secondary;    /* the in-flight slot taken by this query, or NULL */
     // to discard
     u64 expire_epoch_us;
+    u64 sent_epoch_us;
     // for answers, id has to be kept
     u16 id;
     // for answers, ip/port should be kept but they are already in the host list (sa.sa4,sa.sa6,addrlen)
@@ -143,7 +351,9 @@ message_query_summary_init(message_query_summary *mqs, u16 id, const u8 *fqdn, h
     // key
     mqs->host = host_address_copy(host);
     mqs->next = NULL;
-    mqs->expire_epoch_us = timeus() + MESSAGE_QUERY_TIMEOUT_US;
+    mqs->secondary = NULL;
+    mqs->sent_epoch_us = timeus();
+    mqs->expire_epoch_us = mqs->sent_epoch_us + MESSAGE_QUERY_TIMEOUT_US;
     mqs->id = id;
     // payload
     mqs->tries = MESSAGE_QUERY_TRIES;
@@ -178,6 +388,11 @@ message_query_summary_delete(message_query_summary *mqs)
 #ifdef DEBUG
     log_debug("notify: deleting query for %{hostaddr}", mqs->host);
 #endif
+    if(mqs->secondary != NULL)
+    {
+        --mqs->secondary->in_flight;
+    }
+    
     message_query_summary_clear(mqs);
     ZFREE(mqs, message_query_summary);
 }
@@ -238,6 +453,8 @@ struct notify_message_answer
     u8   rcode;
     bool aa;
     u8   r2;
+    u16  id;
+    u64  epoch_us;      // reception time
     host_address *host;
     message_data *message;  /* only used if the message is signed */
 };
@@ -291,6 +508,8 @@ notify_slaveanswer(message_data *mesg)
         message->payload.type = NOTIFY_MESSAGE_TYPE_ANSWER;
         message->payload.answer.rcode = rcode;
         message->payload.answer.aa = aa;
+        message->payload.answer.id = MESSAGE_ID(mesg->buffer);
+        message->payload.answer.epoch_us = timeus();
         ZALLOC_OR_DIE(host_address*, message->payload.answer.host, host_address, HOSTADDR_TAG);
         host_address_set_with_sockaddr(message->payload.answer.host, sa);
         
@@ -878,7 +1097,7 @@ notify_message_free(notify_message *msg)
             host_address_delete(msg->payload.answer.host);
             if(msg->payload.answer.message != NULL)
             {
-                free(msg->payload.answer.message); // message_data (free, not ZFREE)
+                message_free(msg->payload.answer.message);
             }
             break;
         }
@@ -906,6 +1125,115 @@ notify_process_dnsname_compare(const void *node_a, const void *node_b)
     return dnsname_compare(m_a, m_b);
 }
 
+/**
+ * Sends the queued notifications to each slave, keeping at most NOTIFY_SECONDARY_IN_FLIGHT_MAX of them unanswered.
+ * 
+ * @return the number of notifications still queued
+ */
+
+static u32
+notify_secondaries_dispatch(ptr_set *secondaries, ptr_set *notify_zones, ptr_set *current_queries, message_data *msgdata, random_ctx rnd)
+{
+    u32 queued = 0;
+    
+    ptr_set_avl_iterator iter;
+    ptr_set_avl_iterator_init(secondaries, &iter);
+    while(ptr_set_avl_iterator_hasnext(&iter))
+    {
+        ptr_node *secondary_node = ptr_set_avl_iterator_next_node(&iter);
+        notify_secondary *secondary = (notify_secondary*)secondary_node->value;
+        
+        while(secondary->in_flight < NOTIFY_SECONDARY_IN_FLIGHT_MAX)
+        {
+            ptr_node *entry_node = ptr_set_avl_get_first(&secondary->queue);
+            
+            if(entry_node == NULL)
+            {
+                break;
+            }
+            
+            notify_secondary_entry *entry = (notify_secondary_entry*)entry_node->value;
+            ptr_set_avl_delete(&secondary->queue, entry->origin);
+            
+            // the zone is not in notify_zones anymore after its last repeat: it still has to be sent
+            
+            ptr_node *zone_node = ptr_set_avl_find(notify_zones, entry->origin);
+            notify_message *message = (zone_node != NULL)?(notify_message*)zone_node->value:NULL;
+            
+            if((message != NULL) && !host_address_list_contains_host(message->payload.notify.hosts_list, entry->host))
+            {
+                // the slave answered in the mean time
+                
+                notify_secondary_entry_delete(entry);
+                continue;
+            }
+            
+            u16 id = random_next(rnd);
+
+            ya_result err = notify_send(entry->host, msgdata, id, entry->origin, entry->ztype, entry->zclass);
+
+            if(ISOK(err))
+            {
+                message_query_summary* mqs;
+                ZALLOC_OR_DIE(message_query_summary*, mqs, message_query_summary, MSGQSUMR_TAG);
+
+#if HAS_TSIG_SUPPORT
+                message_query_summary_init(mqs, id, &msgdata->buffer[12], entry->host, msgdata->tsig.mac, msgdata->tsig.mac_size);
+#else
+                message_query_summary_init(mqs, id, &msgdata->buffer[12], entry->host, NULL, 0);
+#endif
+                mqs->expire_epoch_us = mqs->sent_epoch_us + notify_secondary_rto_us(secondary);
+                
+                ptr_node *node = ptr_set_avl_insert(current_queries, mqs);
+
+                if(node->value != NULL)
+                {
+                    // destroy this mqs
+#ifdef DEBUG
+                    log_debug("notify: node %{hostaddr}[%04x] already exists, replacing", mqs->host, mqs->id);
+#endif
+                    message_query_summary_delete(node->value);
+                    node->key = mqs;
+                }
+
+                node->value = mqs;
+                mqs->secondary = secondary;
+                ++secondary->in_flight;
+            }
+            else if(message != NULL) // remove it
+            {
+                host_address *rem_ha = host_address_remove_host_address(&message->payload.notify.hosts_list, entry->host);
+
+                if(rem_ha != NULL)
+                {
+                    host_address_delete(rem_ha);
+                }
+            }
+            
+            notify_secondary_entry_delete(entry);
+        }
+        
+        if(secondary->queue.root != NULL)
+        {
+            u32 secondary_queued = 0;
+            
+            ptr_set_avl_iterator queue_iter;
+            ptr_set_avl_iterator_init(&secondary->queue, &queue_iter);
+            while(ptr_set_avl_iterator_hasnext(&queue_iter))
+            {
+                ptr_set_avl_iterator_next_node(&queue_iter);
+                ++secondary_queued;
+            }
+            
+            log_debug("notify: %{hostaddr}: %u notifications in flight, %u queued", secondary->host, secondary->in_flight, secondary_queued);
+            
+            queued += secondary_queued;
+        }
+    }
+    
+    return queued;
+}
+
 static int
 notify_service(struct service_worker_s *worker)
 {
@@ -937,6 +1265,10 @@ notify_service(struct service_worker_s *worker)
     ptr_set current_queries = PTR_SET_EMPTY;
     current_queries.compare = message_query_summary_compare;
     u64 last_current_queries_cleanup_epoch_us = 0;
+    
+    ptr_set secondaries = PTR_SET_EMPTY;
+    secondaries.compare = ptr_set_host_address_node_compare;
+    u32 queued = 0;
 
     const addressv6 localhost6 = {.bytes = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1}};
     socketaddress *sa4 = NULL;
@@ -1031,78 +1363,6 @@ notify_service(struct service_worker_s *worker)
 
     while(service_shouldrun(worker) || !async_queue_empty(&notify_handler_queue))
     {
-        {   /* what happens in here should not interfere with the rest of the function */
-                
-            u64 tus = timeus();
-
-            if(!ptr_set_avl_isempty(&current_queries) && (tus > last_current_queries_cleanup_epoch_us))
-            {
-                /* create a list of expired message_query_summary */
-                
-                log_debug("notify: cleaning up expired notifications");
-
-                message_query_summary head;
-                head.next = NULL;
-                message_query_summary *current = &head;
-                last_current_queries_cleanup_epoch_us = tus;
-
-                /* find them using an iterator */
-
-                ptr_set_avl_iterator current_queries_iter;
-                ptr_set_avl_iterator_init(&current_queries, &current_queries_iter);
-                while(ptr_set_avl_iterator_hasnext(&current_queries_iter))
-                {
-                    ptr_node *node = ptr_set_avl_iterator_next_node(&current_queries_iter);
-                    message_query_summary* mqs = (message_query_summary*)node->value;
-                    if(last_current_queries_cleanup_epoch_us > mqs->expire_epoch_us)
-                    {
-#ifdef DEBUG
-                        double expired_since = last_current_queries_cleanup_epoch_us - mqs->expire_epoch_us;
-                        expired_since /= 1000000.0;
-                        log_debug("notify: query (%hx) %{dnsname} to %{hostaddr} expired %f seconds ago",
-                                mqs->id, mqs->fqdn, mqs->host, expired_since);
-#endif                  
-                        if(--mqs->tries <= 0)
-                        {
-                            current->next = mqs;
-                            current = mqs;
-                        }
-                        else
-                        {
-#ifdef DEBUG
-                            log_debug("notify: query (%hx) %{dnsname} to %{hostaddr} expired %f seconds ago retrying (%i times remaining)",
-                                    mqs->id, mqs->fqdn, mqs->host, expired_since, mqs->tries);
-#endif                  
-                            mqs->expire_epoch_us = tus + MESSAGE_QUERY_TIMEOUT_US;
-                            
-                            // send the message again
-                            
-                            notify_send(mqs->host, msgdata, mqs->id, mqs->fqdn, TYPE_SOA, CLASS_IN);
-                        }
-                    }
-                }
-
-                /* once the tree has been scanned, destroy every node listed */
-
-                current = head.next;
-                while(current != NULL)
-                {
-                    message_query_summary* mqs = current;
-                    current = current->next;
-                    ptr_set_avl_delete(&current_queries, mqs);
-                    
-                    zdb_zone *zone = zdb_acquire_zone_read_from_fqdn(g_config->database, mqs->fqdn); // RC++
-                    if(zone != NULL)
-                    {
-                        zdb_zone_clear_status(zone, ZDB_ZONE_STATUS_WILL_NOTIFY);
-                        zdb_zone_release(zone);
-                    }
-                    
-                    message_query_summary_delete(mqs);
-                }
-            }
-        }
-        
         for(;;)
         {
             /* current_queries tree cleanup */
@@ -1142,6 +1402,8 @@ notify_service(struct service_worker_s *worker)
                         ptr_set_avl_delete(&notify_zones, message->origin);
                         notify_message_free(zone_message);
                     }
+                    
+                    notify_secondaries_dequeue(&secondaries, message->origin);
                     break;
                 }
                 case NOTIFY_MESSAGE_TYPE_DOMAIN:
@@ -1238,6 +1500,68 @@ notify_service(struct service_worker_s *worker)
                 {
                     log_info("notify: %{dnsname}: answer from slave at %{hostaddr}", message->origin, message->payload.answer.host);
                     
+                    /*
+                     * Find the query this is answering, this frees its in-flight slot
+                     */
+                    
+                    host_address *ha = message->payload.answer.host;
+                    
+                    message_query_summary tmp;
+                    message_query_summary_init(&tmp, message->payload.answer.id, message->origin, ha, NULL, 0);
+                    ptr_node *query_node = ptr_set_avl_find(&current_queries, &tmp);
+                    message_query_summary_clear(&tmp);
+                    
+                    message_query_summary *mqs = (query_node != NULL)?(message_query_summary*)query_node->value:NULL;
+                    
+#if HAS_TSIG_SUPPORT
+                    if(ha->tsig != NULL)
+                    {
+                        if(mqs == NULL)
+                        {
+                            /* most likely a timeout */
+
+                            log_err("notify: %{dnsname}: %{hostaddr}: unexpected answer: could not find a matching query for notification answer with id %04hx",
+                                    message->origin, message->payload.answer.host, message->payload.answer.id);
+                            // delete message
+                            notify_message_free(message);
+
+                            break;
+                        }
+
+                        // verify the signature
+
+                        message_data *mesg = message->payload.answer.message;
+                        ya_result return_value;
+
+                        if(FAIL(return_value = tsig_verify_answer(mesg, mqs->mac, mqs->mac_size)))
+                        {
+                            // if everything is good, then proceed
+
+                            log_err("notify: %{dnsname}: %{hostaddr}: TSIG signature verification failed: %r",
+                                    message->origin, message->payload.answer.host, return_value);
+                            // delete message
+                            notify_message_free(message);
+
+                            break;
+                        }
+
+                        message_free(message->payload.answer.message);
+                        message->payload.answer.message = NULL;
+                    } /* end of TSIG verification, with success*/
+#endif
+                    if(mqs != NULL)
+                    {
+                        // only measure the RTT of queries that have not been sent again (Karn)
+                        
+                        if((mqs->secondary != NULL) && (mqs->tries == MESSAGE_QUERY_TRIES))
+                        {
+                            notify_secondary_rtt_sample(mqs->secondary, (message->payload.answer.epoch_us > mqs->sent_epoch_us)?message->payload.answer.epoch_us - mqs->sent_epoch_us:0);
+                        }
+                        
+                        ptr_set_avl_delete(&current_queries, mqs);
+                        message_query_summary_delete(mqs);
+                    }
+                    
                     ptr_node *node = ptr_set_avl_find(&notify_zones, message->origin);
                     
                     if(node != NULL)
@@ -1246,68 +1570,10 @@ notify_service(struct service_worker_s *worker)
 
                         if(msg != NULL)
                         {
-                            /*
-                             * Look for the entry and remove it
-                             */
-                            
-                            /* message->payload.answer.tsig ... */
-                            
                             /* all's good so remove the notify query from the list */
                             
                             if(host_address_list_contains_host(msg->payload.notify.hosts_list, message->payload.answer.host))
                             {
-                                host_address *ha;
-#if HAS_TSIG_SUPPORT
-                                ha = message->payload.answer.host;
-                                
-                                message_query_summary tmp;
-                                
-                                if(ha->tsig != NULL)
-                                {
-                                    u16 id = MESSAGE_ID(message->payload.answer.message->buffer);
-                                    message_query_summary_init(&tmp, id, &message->payload.answer.message->buffer[12], ha, NULL, 0);
-                                    // try to find the exact match
-                                    ptr_node *node = ptr_set_avl_find(&current_queries, &tmp);
-                                    message_query_summary_clear(&tmp);
-                                    if(node == NULL)
-                                    {
-                                        /* most likely a timeout */
-                                        
-                                        log_err("notify: %{dnsname}: %{hostaddr}: unexpected answer: could not find a matching query for notification answer with id %04hx",
-                                                message->origin, message->payload.answer.host, id);
-                                        // delete message
-                                        notify_message_free(message);
-
-                                        break;
-                                    }
-                                    
-                                    message_query_summary *mqs = (message_query_summary*)node->value;
-                                    
-                                    yassert(mqs != NULL);
-                                    
-                                    // verify the signature
-                                    
-                                    message_data *mesg = message->payload.answer.message;
-                                    ya_result return_value;
-                                    
-                                    if(FAIL(return_value = tsig_verify_answer(mesg, mqs->mac, mqs->mac_size)))
-                                    {
-                                        // if everything is good, then proceed
-                                        
-                                        log_err("notify: %{dnsname}: %{hostaddr}: TSIG signature verification failed: %r",
-                                                message->origin, message->payload.answer.host, return_value);
-                                        // delete message
-                                        notify_message_free(message);
-                                        
-                                        break;
-                                    }
-                                    
-                                    free(message->payload.answer.message); // message_data, free, not ZFREE
-                                    message->payload.answer.message = NULL;
-                                    ptr_set_avl_delete(&current_queries, mqs);
-                                    message_query_summary_delete(mqs);
-                                } /* end of TSIG verification, with success*/
-#endif
                                 ha = host_address_remove_host_address(&msg->payload.notify.hosts_list, message->payload.answer.host);
                                 host_address_delete(ha);
 
@@ -1342,7 +1608,7 @@ notify_service(struct service_worker_s *worker)
                             ptr_set_avl_delete(&notify_zones, message->origin); /// @todo 20150616 edf -- there was a clear NULL reference. test the fix
                         }
                     }
-                    else
+                    else if(mqs == NULL)
                     {
                         log_err("notify: %{dnsname}: %{hostaddr}: unexpected answer: no pending notifications for the zone", message->origin, message->payload.answer.host);
                     }
@@ -1364,6 +1630,93 @@ notify_service(struct service_worker_s *worker)
             async_message_release(async);
         } // for(;;)
 
+        // the expired queries are looked for once the answers that arrived have been processed
+
+        {   /* what happens in here should not interfere with the rest of the function */
+                
+            u64 tus = timeus();
+
+            if(!ptr_set_avl_isempty(&current_queries) && (tus > last_current_queries_cleanup_epoch_us))
+            {
+                /* create a list of expired message_query_summary */
+                
+                log_debug("notify: cleaning up expired notifications");
+
+                message_query_summary head;
+                head.next = NULL;
+                message_query_summary *current = &head;
+                last_current_queries_cleanup_epoch_us = tus;
+
+                /* find them using an iterator */
+
+                ptr_set_avl_iterator current_queries_iter;
+                ptr_set_avl_iterator_init(&current_queries, &current_queries_iter);
+                while(ptr_set_avl_iterator_hasnext(&current_queries_iter))
+                {
+                    ptr_node *node = ptr_set_avl_iterator_next_node(&current_queries_iter);
+                    message_query_summary* mqs = (message_query_summary*)node->value;
+                    if(last_current_queries_cleanup_epoch_us > mqs->expire_epoch_us)
+                    {
+#ifdef DEBUG
+                        double expired_since = last_current_queries_cleanup_epoch_us - mqs->expire_epoch_us;
+                        expired_since /= 1000000.0;
+                        log_debug("notify: query (%hx) %{dnsname} to %{hostaddr} expired %f seconds ago",
+                                mqs->id, mqs->fqdn, mqs->host, expired_since);
+#endif                  
+                        if(--mqs->tries <= 0)
+                        {
+                            current->next = mqs;
+                            current = mqs;
+                        }
+                        else
+                        {
+#ifdef DEBUG
+                            log_debug("notify: query (%hx) %{dnsname} to %{hostaddr} expired %f seconds ago retrying (%i times remaining)",
+                                    mqs->id, mqs->fqdn, mqs->host, expired_since, mqs->tries);
+#endif                  
+                            // exponential backoff from the retransmission timeout of the slave
+                            
+                            u64 rto = (mqs->secondary != NULL)?notify_secondary_rto_us(mqs->secondary):MESSAGE_QUERY_TIMEOUT_US;
+                            rto <<= MESSAGE_QUERY_TRIES - mqs->tries;
+                            
+                            mqs->expire_epoch_us = tus + MIN(rto, MESSAGE_QUERY_TIMEOUT_US);
+                            
+                            // send the message again
+                            
+                            if(ISOK(notify_send(mqs->host, msgdata, mqs->id, mqs->fqdn, TYPE_SOA, CLASS_IN)))
+                            {
+#if HAS_TSIG_SUPPORT
+                                // the MAC of the new signature is the one the answer will be verified with
+                                
+                                mqs->mac_size = msgdata->tsig.mac_size;
+                                memcpy(mqs->mac, msgdata->tsig.mac, mqs->mac_size);
+#endif
+                            }
+                        }
+                    }
+                }
+
+                /* once the tree has been scanned, destroy every node listed */
+
+                current = head.next;
+                while(current != NULL)
+                {
+                    message_query_summary* mqs = current;
+                    current = current->next;
+                    ptr_set_avl_delete(&current_queries, mqs);
+                    
+                    zdb_zone *zone = zdb_acquire_zone_read_from_fqdn(g_config->database, mqs->fqdn); // RC++
+                    if(zone != NULL)
+                    {
+                        zdb_zone_clear_status(zone, ZDB_ZONE_STATUS_WILL_NOTIFY);
+                        zdb_zone_release(zone);
+                    }
+                    
+                    message_query_summary_delete(mqs);
+                }
+            }
+        }
+
         /*
          * For all entries in the queue, send a notify to the ones that need to be repeated
          */
@@ -1395,50 +1748,17 @@ notify_service(struct service_worker_s *worker)
             while(ha != NULL)
             {
                 /*
-                 * Send an UDP packet to the ha
+                 * Queue the zone to the slave, notify_secondaries_dispatch sends it
                  */
-
-                u16 id = random_next(rnd);
-                
-                ya_result err = notify_send(ha, msgdata, id, message->origin, message->payload.notify.ztype, message->payload.notify.zclass);
                 
-                host_address *ha_next = ha->next;
+                notify_secondary *secondary = notify_secondary_get(&secondaries, ha);
                 
-                if(ISOK(err))
+                if(!notify_secondary_enqueue(secondary, ha, message->origin, message->payload.notify.ztype, message->payload.notify.zclass))
                 {
-                    message_query_summary* mqs;
-                    ZALLOC_OR_DIE(message_query_summary*, mqs, message_query_summary, MSGQSUMR_TAG);
-
-#if HAS_TSIG_SUPPORT
-                    message_query_summary_init(mqs, id, &msgdata->buffer[12], ha, msgdata->tsig.mac, msgdata->tsig.mac_size);
-#else
-                    message_query_summary_init(mqs, id, &msgdata->buffer[12], ha, NULL, 0);
-#endif
-                    ptr_node *node = ptr_set_avl_insert(&current_queries, mqs);
-
-                    if(node->value != NULL)
-                    {
-                        // destroy this mqs
-#ifdef DEBUG
-                        log_debug("notify: node %{hostaddr}[%04x] already exists, replacing", mqs->host, mqs->id);
-#endif
-                        message_query_summary_delete(node->value);
-                        node->key = mqs;
-                    }
-
-                    node->value = mqs;
-                }
-                else // remove it
-                {
-                    host_address *rem_ha = host_address_remove_host_address(&message->payload.notify.hosts_list, ha);
-                    
-                    if(rem_ha != NULL)
-                    {
-                        host_address_delete(rem_ha);
-                    }
+                    log_debug("notify: %{dnsname}: %{hostaddr}: already queued", message->origin, ha);
                 }
                 
-                ha = ha_next;
+                ha = ha->next;
             }
 
             /* decrease the countdown or remove it from the collection */
@@ -1474,8 +1794,24 @@ notify_service(struct service_worker_s *worker)
             ptr_set_avl_delete(&notify_zones, msg->origin);
             notify_message_free(msg);
         }
-
-        sleep(1);
+        
+        ptr_vector_destroy(&todelete);
+        
+        if(!dnscore_shuttingdown())
+        {
+            queued = notify_secondaries_dispatch(&secondaries, &notify_zones, &current_queries, msgdata, rnd);
+        }
+        
+        // answers and timeouts need to be handled quickly while notifications are pending
+        
+        if((queued > 0) || !ptr_set_avl_isempty(&current_queries))
+        {
+            usleep(NOTIFY_SERVICE_TICK_US);
+        }
+        else
+        {
+            sleep(1);
+        }
     }
     
     service_set_stopping(worker);
@@ -1531,6 +1867,14 @@ notify_service(struct service_worker_s *worker)
     }
     ptr_set_avl_destroy(&current_queries);
     
+    ptr_set_avl_iterator_init(&secondaries, &iter);
+    while(ptr_set_avl_iterator_hasnext(&iter))
+    {
+        ptr_node *node = ptr_set_avl_iterator_next_node(&iter);
+        notify_secondary_delete((notify_secondary*)node->value);
+    }
+    ptr_set_avl_destroy(&secondaries);
+    
     if(msgdata != NULL)
     {
         free(msgdata); // message_data
@@ -1900,7 +2244,7 @@ notify_service_init()
     {
         if(notify_thread_pool == NULL)
         {
-            if((notify_thread_pool = thread_pool_init_ex(10, 4096, "notify")) == NULL)
+            if((notify_thread_pool = thread_pool_init_work_stealing(10, 4096, "notify")) == NULL)
             {
                 return THREAD_CREATION_ERROR;
             }
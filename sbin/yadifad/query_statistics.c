@@ -0,0 +1,322 @@
+/*------------------------------------------------------------------------------
+*
+* Copyright (c) 2011-2019, EURid vzw. All rights reserved.
+* The YADIFA TM software product is provided under the BSD 3-clause license:
+* 
+* Redistribution and use in source and binary forms, with or without 
+* modification, are permitted provided that the following conditions
+* are met:
+*
+*        * Redistributions of source code must retain the above copyright 
+*          notice, this list of conditions and the following disclaimer.
+*        * Redistributions in binary form must reproduce the above copyright 
+*          notice, this list of conditions and the following disclaimer in the 
+*          documentation and/or other materials provided with the distribution.
+*        * Neither the name of EURid nor the names of its contributors may be 
+*          used to endorse or promote products derived from this software 
+*          without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*------------------------------------------------------------------------------
+*
+*/
+/** @defgroup server Server
+ *  @ingroup yadifad
+ *  @brief Per-thread query timing and counters
+ *
+ * @{
+ *
+ *----------------------------------------------------------------------------*/
+
+#include "server-config.h"
+#include "config.h"
+
+#include <pthread.h>
+
+#include <dnscore/logger.h>
+#include <dnscore/format.h>
+#include <dnscore/mutex.h>
+#include <dnscore/dnskey-signature.h>
+
+#include <dnsdb/zdb_zone.h>
+#include <dnsdb/zdb-zone-arc.h>
+#if ZDB_HAS_NSEC3_SUPPORT
+#include <dnsdb/nsec3_name_error.h>
+#endif
+
+#include "confs.h"
+#include "zone.h"
+#include "query_statistics.h"
+
+extern logger_handle *g_server_logger;
+#define MODULE_MSG_HANDLE g_server_logger
+
+#define QRYSTATS_TAG 0x5354415453595251
+
+extern zone_data_set database_zone_desc;
+
+static pthread_key_t query_statistics_key;
+static pthread_once_t query_statistics_key_once = PTHREAD_ONCE_INIT;
+static mutex_t query_statistics_mtx = MUTEX_INITIALIZER;
+static query_statistics_s *query_statistics_list = NULL;
+
+static const char *query_statistics_stage_name[QUERY_STATISTICS_STAGE_COUNT] =
+{
+    "latency",
+    "lookup",
+    "nsec3",
+    "rrl",
+    "send"
+};
+
+static void
+query_statistics_key_init()
+{
+    if(pthread_key_create(&query_statistics_key, NULL) != 0)
+    {
+        log_quit("query-statistics: pthread_key_create = %r", ERRNO_ERROR);
+    }
+}
+
+static query_statistics_s*
+query_statistics_new_instance()
+{
+    query_statistics_s *qs;
+    
+    MALLOC_OR_DIE(query_statistics_s*, qs, sizeof(query_statistics_s), QRYSTATS_TAG);
+    ZEROMEMORY(qs, sizeof(query_statistics_s));
+    
+    for(int i = 0; i < QUERY_STATISTICS_STAGE_COUNT; ++i)
+    {
+        histogram_init(&qs->stage[i]);
+    }
+    
+    return qs;
+}
+
+query_statistics_s*
+query_statistics_get()
+{
+    pthread_once(&query_statistics_key_once, query_statistics_key_init);
+    
+    query_statistics_s *qs = (query_statistics_s*)pthread_getspecific(query_statistics_key);
+    
+    if(qs == NULL)
+    {
+        qs = query_statistics_new_instance();
+        
+        // the instance outlives the thread so what it has measured is not lost
+        
+        mutex_lock(&query_statistics_mtx);
+        qs->next = query_statistics_list;
+        query_statistics_list = qs;
+        mutex_unlock(&query_statistics_mtx);
+        
+        pthread_setspecific(query_statistics_key, qs);
+        
+#if ZDB_HAS_NSEC3_SUPPORT
+        nsec3_proof_histogram_set(&qs->stage[QUERY_STATISTICS_NSEC3]);
+#endif
+        zdb_zone_query_counters_set(&qs->zone_queries);
+    }
+    
+    return qs;
+}
+
+void
+query_statistics_merge(query_statistics_s *qs)
+{
+    mutex_lock(&query_statistics_mtx);
+    
+    for(query_statistics_s *src = query_statistics_list; src != NULL; src = src->next)
+    {
+        for(int i = 0; i < QUERY_STATISTICS_STAGE_COUNT; ++i)
+        {
+            histogram_merge(&qs->stage[i], &src->stage[i]);
+        }
+        
+        for(int i = 0; i < QUERY_STATISTICS_QTYPE_COUNT; ++i)
+        {
+            qs->qtype[i] += src->qtype[i];
+        }
+    }
+    
+    mutex_unlock(&query_statistics_mtx);
+}
+
+/**
+ * Adds up the queries answered by the zone in all the threads.
+ */
+
+static u64
+query_statistics_zone_query_count(const zdb_zone *zone)
+{
+    u64 count = 0;
+
+    mutex_lock(&query_statistics_mtx);
+
+    for(const query_statistics_s *src = query_statistics_list; src != NULL; src = src->next)
+    {
+        count += zdb_zone_query_counters_get(&src->zone_queries, zone);
+    }
+
+    mutex_unlock(&query_statistics_mtx);
+
+    return count;
+}
+
+static void
+query_statistics_write_histogram_json(output_stream *os, const histogram_s *h)
+{
+    osformat(os, "{\"count\":%llu,\"min\":%llu,\"mean\":%llu,\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"p999\":%llu,\"max\":%llu}",
+            h->count,
+            (h->count > 0)?h->min:0,
+            histogram_mean(h),
+            histogram_value_at_percentile(h, 50.0),
+            histogram_value_at_percentile(h, 90.0),
+            histogram_value_at_percentile(h, 99.0),
+            histogram_value_at_percentile(h, 99.9),
+            h->max);
+}
+
+ya_result
+query_statistics_write_json(output_stream *os)
+{
+    query_statistics_s *qs = query_statistics_new_instance();
+    
+    query_statistics_merge(qs);
+    
+    osprint(os, "{\"unit\":\"ns\",\"stages\":{");
+    
+    for(int i = 0; i < QUERY_STATISTICS_STAGE_COUNT; ++i)
+    {
+        osformat(os, "%s\"%s\":", (i > 0)?",":"", query_statistics_stage_name[i]);
+        query_statistics_write_histogram_json(os, &qs->stage[i]);
+    }
+    
+    osprint(os, "},\"qtypes\":{");
+    
+    const char *separator = "";
+    
+    for(int i = 0; i < QUERY_STATISTICS_QTYPE_OTHER; ++i)
+    {
+        if(qs->qtype[i] > 0)
+        {
+            u16 qtype = htons(i);
+            osformat(os, "%s\"%{dnstype}\":%llu", separator, &qtype, qs->qtype[i]);
+            separator = ",";
+        }
+    }
+    
+    if(qs->qtype[QUERY_STATISTICS_QTYPE_OTHER] > 0)
+    {
+        osformat(os, "%s\"OTHER\":%llu", separator, qs->qtype[QUERY_STATISTICS_QTYPE_OTHER]);
+    }
+    
+    free(qs);
+    
+    osprint(os, "},\"zones\":{");
+    
+    separator = "";
+    
+    zone_set_lock(&database_zone_desc);
+    
+    ptr_set_avl_iterator iter;
+    ptr_set_avl_iterator_init(&database_zone_desc.set, &iter);
+
+    while(ptr_set_avl_iterator_hasnext(&iter))
+    {
+        ptr_node *zone_node = ptr_set_avl_iterator_next_node(&iter);
+        zone_desc_s *zone_desc = (zone_desc_s *)zone_node->value;
+        
+        zdb_zone *zone = zdb_acquire_zone_read_from_fqdn(g_config->database, zone_desc->origin);
+        
+        if(zone != NULL)
+        {
+            osformat(os, "%s\"%{dnsname}\":%llu", separator, zone_desc->origin, query_statistics_zone_query_count(zone));
+            separator = ",";
+            
+            zdb_zone_release(zone);
+        }
+    }
+    
+    zone_set_unlock(&database_zone_desc);
+    
+    // the memory of the zones taken from their arena, and the time spent destroying zones
+    
+    osprint(os, "},\"memory\":{");
+    
+#if ZDB_ZONE_ARENA_SUPPORT
+    separator = "";
+    
+    zone_set_lock(&database_zone_desc);
+    
+    ptr_set_avl_iterator_init(&database_zone_desc.set, &iter);
+
+    while(ptr_set_avl_iterator_hasnext(&iter))
+    {
+        ptr_node *zone_node = ptr_set_avl_iterator_next_node(&iter);
+        zone_desc_s *zone_desc = (zone_desc_s *)zone_node->value;
+        
+        zdb_zone *zone = zdb_acquire_zone_read_lock_from_fqdn(g_config->database, zone_desc->origin, ZDB_ZONE_MUTEX_SIMPLEREADER);
+        
+        if(zone != NULL)
+        {
+            if((zone->arena != NULL) && zone->arena->sealed)
+            {
+                osformat(os, "%s\"%{dnsname}\":{\"arena_used\":%llu,\"arena_mapped\":%llu,\"arena_resident\":%llu,\"pristine\":%s}",
+                        separator, zone_desc->origin,
+                        zone->arena->used, zdb_zone_arena_mapped(zone->arena), zdb_zone_arena_resident(zone->arena),
+                        (zdb_zone_arena_pristine(zone))?"true":"false");
+                separator = ",";
+            }
+            
+            zdb_zone_release_unlock(zone, ZDB_ZONE_MUTEX_SIMPLEREADER);
+        }
+    }
+    
+    zone_set_unlock(&database_zone_desc);
+#endif
+    
+    zdb_zone_arena_teardown_stats teardown;
+    zdb_zone_arena_teardown_stats_get(&teardown);
+    
+    osformat(os, "},\"teardown\":{\"count\":%llu,\"released\":%llu,\"total_us\":%llu,\"max_us\":%llu},\"signatures\":",
+            teardown.count, teardown.released, teardown.total_us, teardown.max_us);
+    
+    dnskey_signature_stats_write_json(os);
+    
+    return osprint(os, "}");
+}
+
+void
+query_statistics_finalize()
+{
+    mutex_lock(&query_statistics_mtx);
+    
+    query_statistics_s *qs = query_statistics_list;
+    query_statistics_list = NULL;
+    
+    mutex_unlock(&query_statistics_mtx);
+    
+    while(qs != NULL)
+    {
+        query_statistics_s *next = qs->next;
+        zdb_zone_query_counters_finalize(&qs->zone_queries);
+        free(qs);
+        qs = next;
+    }
+}
+
+/** @} */
@@ -0,0 +1,121 @@
+/*------------------------------------------------------------------------------
+*
+* Copyright (c) 2011-2019, EURid vzw. All rights reserved.
+* The YADIFA TM software product is provided under the BSD 3-clause license:
+* 
+* Redistribution and use in source and binary forms, with or without 
+* modification, are permitted provided that the following conditions
+* are met:
+*
+*        * Redistributions of source code must retain the above copyright 
+*          notice, this list of conditions and the following disclaimer.
+*        * Redistributions in binary form must reproduce the above copyright 
+*          notice, this list of conditions and the following disclaimer in the 
+*          documentation and/or other materials provided with the distribution.
+*        * Neither the name of EURid nor the names of its contributors may be 
+*          used to endorse or promote products derived from this software 
+*          without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*------------------------------------------------------------------------------
+*
+*/
+/** @defgroup server Server
+ *  @ingroup yadifad
+ *  @brief Per-thread query timing and counters
+ *
+ *  Each thread answering queries owns a query_statistics_s it updates without any lock.
+ *  The structures are registered in a list and merged when the statistics are requested.
+ *
+ *  The queries answered by each zone are counted in the same way, see zdb_zone_query_counters.
+ *
+ *  The stages are timed in nanoseconds.  They are nested: the lookup includes the NSEC3
+ *  proofs and the RRL, the latency covers everything from the reception to the send.
+ *
+ * @{
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef _QUERY_STATISTICS_H
+#define _QUERY_STATISTICS_H
+
+#include <arpa/inet.h>
+
+#include <dnscore/histogram.h>
+#include <dnscore/output_stream.h>
+
+#include <dnsdb/zdb_zone.h>
+
+#define QUERY_STATISTICS_LATENCY        0   // reception to the end of the send
+#define QUERY_STATISTICS_LOOKUP         1   // database query
+#define QUERY_STATISTICS_NSEC3          2   // NSEC3 proofs
+#define QUERY_STATISTICS_RRL            3   // response rate limiting
+#define QUERY_STATISTICS_SEND           4   // send call
+#define QUERY_STATISTICS_STAGE_COUNT    5
+
+#define QUERY_STATISTICS_QTYPE_OTHER    256 // types above 255 are all counted in this slot
+#define QUERY_STATISTICS_QTYPE_COUNT    (QUERY_STATISTICS_QTYPE_OTHER + 1)
+
+struct query_statistics_s
+{
+    struct query_statistics_s *next;
+    histogram_s stage[QUERY_STATISTICS_STAGE_COUNT];
+    u64 qtype[QUERY_STATISTICS_QTYPE_COUNT];
+    zdb_zone_query_counters zone_queries;
+};
+
+typedef struct query_statistics_s query_statistics_s;
+
+/**
+ * Returns the statistics of the current thread, allocating and registering them on the first call.
+ * The NSEC3 proofs built by the thread are timed and the queries it answers are counted per zone from then on.
+ */
+
+query_statistics_s *query_statistics_get();
+
+/**
+ * Counts a query type.
+ *
+ * @param qs the statistics of the current thread
+ * @param qtype the type, in network order
+ */
+
+static inline void
+query_statistics_qtype_count(query_statistics_s *qs, u16 qtype)
+{
+    u16 t = ntohs(qtype);
+    ++qs->qtype[(t < QUERY_STATISTICS_QTYPE_OTHER)?t:QUERY_STATISTICS_QTYPE_OTHER];
+}
+
+/**
+ * Merges the statistics of all the threads into qs.
+ * The threads are not stopped so the result is a close approximation.
+ */
+
+void query_statistics_merge(query_statistics_s *qs);
+
+/**
+ * Writes the merged statistics and the per-zone query counters as a JSON object.
+ */
+
+ya_result query_statistics_write_json(output_stream *os);
+
+/**
+ * Releases all the statistics.  Only to be called once the threads using them are gone.
+ */
+
+void query_statistics_finalize();
+
+#endif /* _QUERY_STATISTICS_H */
+
+/** @} */
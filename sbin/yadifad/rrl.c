@@ -56,10 +56,12 @@
 #include <dnscore/mutex.h>
 #include <dnscore/ptr_vector.h>
 #include <dnscore/config_settings.h>
+#include <dnscore/timems.h>
 
 #include "rrl.h"
 #include "acl.h"
 #include "config_acl.h"
+#include "query_statistics.h"
 
 u32 zdb_query_message_update(message_data* message, zdb_query_ex_answer* answer_set);
 
@@ -749,6 +751,17 @@ rrl_slip(message_data *mesg)
     return return_code;
 }
 
+/**
+ * Records the time spent rating the message in the statistics of the thread.
+ * The writing of the answer is not part of it.
+ */
+
+static inline void
+rrl_process_time_record(u64 start)
+{
+    histogram_record(&query_statistics_get()->stage[QUERY_STATISTICS_RRL], timens_monotonic() - start);
+}
+
 /**
  * Look at the message for RRL processing.
  * Returns an RRL code.
@@ -778,6 +791,7 @@ rrl_process(message_data *mesg, zdb_query_ex_answer *ans_auth_add)
         return return_code;
     }
     
+    u64 rrl_start = timens_monotonic();
     u64 now = timeus();
     u8 key[RRL_KEY_SIZE_MAX];
     rrl_make_key(mesg, ans_auth_add, key);
@@ -866,6 +880,8 @@ rrl_process(message_data *mesg, zdb_query_ex_answer *ans_auth_add)
         
         mutex_unlock(&rrl_mtx);
         
+        rrl_process_time_record(rrl_start);
+        
         // test if we are in the allowed rate
         
         if(hits <= limit)
@@ -944,6 +960,8 @@ rrl_process(message_data *mesg, zdb_query_ex_answer *ans_auth_add)
         }
         
         mutex_unlock(&rrl_mtx);
+        
+        rrl_process_time_record(rrl_start);
                 
         mesg->send_length = zdb_query_message_update(mesg, ans_auth_add);
     }
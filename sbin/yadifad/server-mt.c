@@ -107,6 +107,7 @@ extern logger_handle *g_server_logger;
 #define DUMP_UDP_MT_OUTPUT_WIRE 0
 
 #include "server-mt.h"
+#include "server-xdp.h"
 
 #include "server_context.h"
 #include "server_error.h"
@@ -123,6 +124,7 @@ extern logger_handle *g_server_logger;
 //#include "database-service.h"
 
 #include "log_statistics.h"
+#include "query_statistics.h"
 #include "log_query.h"
 #include "poll-util.h"
 
@@ -176,6 +178,8 @@ struct synced_thread_t
 #endif
     
     server_statistics_t statistics;
+    
+    query_statistics_s *query_statistics;
 };
 
 typedef struct synced_thread_t synced_thread_t;
@@ -208,8 +212,7 @@ synced_init(u32 count)
 
         synced_threads.threads[t].idx = t;
         ZEROMEMORY(&synced_threads.threads[t].statistics, sizeof(server_statistics_t));
-        MALLOC_OR_DIE(message_data*, synced_threads.threads[t].udp_mesg, sizeof(message_data), MESGDATA_TAG);
-        ZEROMEMORY(synced_threads.threads[t].udp_mesg, sizeof(message_data));
+        synced_threads.threads[t].udp_mesg = NULL; // taken by the thread, from the pool of its node
     }
     
     synced_threads.thread_count = count;
@@ -220,7 +223,7 @@ synced_finalize()
 {
     for(u32 t = 0; t < synced_threads.thread_count; t++)
     {
-        free(synced_threads.threads[t].udp_mesg);
+        message_free(synced_threads.threads[t].udp_mesg);
     }
     
     free(synced_threads.threads);
@@ -311,6 +314,23 @@ synced_stop()
  *
  ******************************************************************************************************************/
 
+/**
+ * Points the reception of the thread to the buffers of its current message.
+ */
+
+static void
+server_mt_udp_bind_message(synced_thread_t *st)
+{
+#if UDP_USE_MESSAGES
+    st->udp_iovec.iov_base = st->udp_mesg->buffer;
+    st->udp_iovec.iov_len = sizeof(st->udp_mesg->buffer);
+    st->udp_msghdr.msg_name = &st->udp_mesg->other.sa;
+    st->udp_msghdr.msg_control = st->udp_mesg->control_buffer;
+#else
+    (void)st;
+#endif
+}
+
 #if HAS_DYNUPDATE_SUPPORT
 /**
  * 
@@ -320,15 +340,18 @@ synced_stop()
  * So a thread must be started to handle the remainder of the processing
  * Said thread will delegate and send answer back to the client
  * 
- * This implies I have to copy the message so the original structure can be used
- * for the next query.
+ * The message is handed to the service as it is, and the thread continues with
+ * a new one.
  */
 
-
 static void
-server_mt_process_udp_update(zdb *database, message_data *mesg)
+server_mt_process_udp_update(zdb *database, synced_thread_t *st)
 {
-    dynupdate_query_service_enqueue(database, mesg);
+    message_data *mesg = message_handoff(&st->udp_mesg);
+    
+    server_mt_udp_bind_message(st);
+    
+    dynupdate_query_service_enqueue_handoff(database, mesg);
 }
 
 #endif
@@ -350,6 +373,7 @@ server_mt_process_udp(zdb *database, synced_thread_t *st)
     int return_code;
     
     server_statistics_t *local_statistics = &st->statistics;
+    query_statistics_s *local_query_statistics = st->query_statistics;
     
     message_data *mesg = st->udp_mesg;
     /*
@@ -444,6 +468,8 @@ server_mt_process_udp(zdb *database, synced_thread_t *st)
     }
 
     mesg->received = n;
+    
+    u64 recv_ns = timens_monotonic();
 
     /**
      * In case of processing error, message_process will return UNPROCESSABLE_MESSAGE
@@ -472,13 +498,18 @@ server_mt_process_udp(zdb *database, synced_thread_t *st)
                         local_statistics->udp_queries_count++;
 
                         log_query(st->fdsock, mesg);
+                        
+                        query_statistics_qtype_count(local_query_statistics, mesg->qtype);
 
                         switch(mesg->qtype)
                         {
                             default:
                             {
+                                u64 lookup_ns = timens_monotonic();
 #if HAS_RRL_SUPPORT
                                 ya_result rrl = database_query_with_rrl(database, mesg);
+                                
+                                histogram_record(&local_query_statistics->stage[QUERY_STATISTICS_LOOKUP], timens_monotonic() - lookup_ns);
 
                                 local_statistics->udp_referrals_count += mesg->referral;
                                 local_statistics->udp_fp[mesg->status]++;                                
@@ -503,6 +534,8 @@ server_mt_process_udp(zdb *database, synced_thread_t *st)
                                 }
 #else
                                 database_query(database, mesg);
+                                
+                                histogram_record(&local_query_statistics->stage[QUERY_STATISTICS_LOOKUP], timens_monotonic() - lookup_ns);
 
                                 local_statistics->udp_referrals_count += mesg->referral;
                                 local_statistics->udp_fp[mesg->status]++;
@@ -724,7 +757,7 @@ server_mt_process_udp(zdb *database, synced_thread_t *st)
 
                         local_statistics->udp_updates_count++;
 
-                        server_mt_process_udp_update(database, mesg);
+                        server_mt_process_udp_update(database, st);
                         
                         return; // NOT break;
 #else
@@ -821,6 +854,8 @@ server_mt_process_udp(zdb *database, synced_thread_t *st)
 
     ssize_t sent;
     
+    u64 send_ns = timens_monotonic();
+    
 #if !UDP_USE_MESSAGES
     
 #ifdef DEBUG
@@ -874,6 +909,11 @@ server_mt_process_udp(zdb *database, synced_thread_t *st)
 
 #endif
 
+    u64 sent_ns = timens_monotonic();
+    
+    histogram_record(&local_query_statistics->stage[QUERY_STATISTICS_SEND], sent_ns - send_ns);
+    histogram_record(&local_query_statistics->stage[QUERY_STATISTICS_LATENCY], sent_ns - recv_ns);
+
     local_statistics->udp_output_size_total += sent;
 
     if(sent != mesg->send_length)
@@ -913,22 +953,28 @@ server_mt_udp_messages_thread(void* parm)
     synced_thread_t *st = (synced_thread_t*)parm;
     
     st->id = pthread_self();
+    st->query_statistics = query_statistics_get();
 
     /*    ------------------------------------------------------------    */
 
+    int nic_node = server_context_socket_node(st->fdsock);
+
 #if HAS_PTHREAD_SETAFFINITY_NP
     cpu_set_t mycpu;
     CPU_ZERO(&mycpu);
     
-    int affinity_with = g_config->thread_affinity_base + st->idx * g_config->thread_affinity_multiplier;
+    int affinity_with = server_worker_cpu(st->idx, nic_node);
     log_info("server-mt: setting affinity with virtual cpu %i", affinity_with);
     CPU_SET(affinity_with, &mycpu);
     
     pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &mycpu);
 #endif
 
+    server_statistics_set_node(&st->statistics, nic_node);
+
     /* Clear and initialize mesg */
-    ZEROMEMORY(st->udp_mesg, sizeof(message_data));
+    st->udp_mesg = message_new_instance();
+    ZEROMEMORY(st->udp_mesg, offsetof(message_data, qname));
     
     st->udp_mesg->addr_len      = sizeof(st->udp_mesg->other);
     st->udp_mesg->protocol      = IPPROTO_UDP;
@@ -946,10 +992,8 @@ server_mt_udp_messages_thread(void* parm)
 
     /* UDP messages handling requires more setup */
 
-    st->udp_iovec.iov_base = st->udp_mesg->buffer;
-    st->udp_iovec.iov_len = sizeof(st->udp_mesg->buffer);
-
-    st->udp_msghdr.msg_name = &st->udp_mesg->other.sa;
+    server_mt_udp_bind_message(st);
+    
     st->udp_msghdr.msg_namelen = st->udp_mesg->addr_len;
     st->udp_msghdr.msg_iov = &st->udp_iovec;
     st->udp_msghdr.msg_iovlen = 1;
@@ -1277,8 +1321,12 @@ server_mt_query_loop()
                         {
                             server_statistics_sum.udp_fp[j] += stats->udp_fp[j];
                         }
+                        
+                        server_statistics_node_add(&server_statistics_sum, stats);
                     }
                     
+                    server_xdp_statistics_add(&server_statistics_sum);
+
                     log_statistics(&server_statistics_sum);
 
                     server_run_loop_rate_tick = now;
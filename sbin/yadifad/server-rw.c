@@ -96,11 +96,13 @@ typedef cpuset_t cpu_set_t;
 #endif
 
 #include "server.h"
+#include "server-xdp.h"
 #include "log_query.h"
 #include "rrl.h"
 #include "process_class_ch.h"
 #include "notify.h"
 #include "log_statistics.h"
+#include "query_statistics.h"
 #include "signals.h"
 #include "dynupdate_query_service.h"
 
@@ -144,6 +146,7 @@ struct msg_hdr_s
     int msg_size;
     int sa_len;
     int ctrl_len;
+    u64 recv_ns;
 };
 
 struct msg_data_s
@@ -192,6 +195,8 @@ struct network_thread_context_s
     
     server_statistics_t statistics __attribute__ ((aligned (L1_DATA_LINE_SIZE)));
     
+    query_statistics_s *query_statistics;   // owned by the writer
+    
     // should be aligned with 64
     
     message_data in_message[3] __attribute__ ((aligned (L1_DATA_LINE_SIZE))); // used by the reader
@@ -216,7 +221,7 @@ server_rw_udp_receiver_thread(void *parms)
     cpu_set_t mycpu;
     CPU_ZERO(&mycpu);
     
-    int affinity_with = g_config->thread_affinity_base + (ctx->idx * 2 + 0) * g_config->thread_affinity_multiplier;
+    int affinity_with = server_worker_cpu(ctx->idx * 2 + 0, server_context_socket_node(fd));
     log_info("server-rw: receiver setting affinity with virtual cpu %i", affinity_with);
     CPU_SET(affinity_with, &mycpu);
     
@@ -264,6 +269,8 @@ server_rw_udp_receiver_thread(void *parms)
         {
             local_statistics_udp_input_count++;
             
+            mesg->recv_ns = timens_monotonic();
+            
 #ifdef DEBUG
             mesg->recv_us = timeus();
 #endif
@@ -342,6 +349,7 @@ server_rw_udp_receiver_thread(void *parms)
                         memcpy(cell->data.hdr.ctrl, receiver_msghdr.msg_control, receiver_msghdr.msg_controllen);
 #endif
                         cell->data.hdr.msg_size = mesg->received;
+                        cell->data.hdr.recv_ns = mesg->recv_ns;
                         cell->data.hdr.blk_count = blk_count;
                         cell->data.hdr.sa_len = mesg->addr_len;
 #if UDP_USE_MESSAGES
@@ -374,6 +382,7 @@ server_rw_udp_receiver_thread(void *parms)
                         memcpy(cell->data.hdr.ctrl, receiver_msghdr.msg_control, receiver_msghdr.msg_controllen);
 #endif
                         cell->data.hdr.msg_size = mesg->received;
+                        cell->data.hdr.recv_ns = mesg->recv_ns;
                         cell->data.hdr.blk_count = blk_count;
                         cell->data.hdr.sa_len = mesg->addr_len;
 #if UDP_USE_MESSAGES
@@ -402,6 +411,7 @@ server_rw_udp_receiver_thread(void *parms)
                         memcpy(cell->data.hdr.ctrl, receiver_msghdr.msg_control, receiver_msghdr.msg_controllen);
 #endif
                         cell->data.hdr.msg_size = mesg->received;
+                        cell->data.hdr.recv_ns = mesg->recv_ns;
                         cell->data.hdr.blk_count = blk_count;
                         cell->data.hdr.sa_len = mesg->addr_len;
 #if UDP_USE_MESSAGES
@@ -495,6 +505,7 @@ static ya_result
 server_rw_udp_sender_process_message(struct network_thread_context_s *ctx, message_data *mesg)
 {
     server_statistics_t * const local_statistics = &ctx->statistics;
+    query_statistics_s * const local_query_statistics = ctx->query_statistics;
     local_statistics->udp_input_count++;
     ya_result return_code;
     int fd = ctx->sockfd;
@@ -518,13 +529,18 @@ server_rw_udp_sender_process_message(struct network_thread_context_s *ctx, messa
                         local_statistics->udp_queries_count++;
 
                         log_query(ctx->sockfd, mesg);
+                        
+                        query_statistics_qtype_count(local_query_statistics, mesg->qtype);
 
                         switch(mesg->qtype)
                         {
                             default:
                             {
+                                u64 lookup_ns = timens_monotonic();
 #if HAS_RRL_SUPPORT
                                 ya_result rrl = database_query_with_rrl(database, mesg);
+                                
+                                histogram_record(&local_query_statistics->stage[QUERY_STATISTICS_LOOKUP], timens_monotonic() - lookup_ns);
 
                                 local_statistics->udp_referrals_count += mesg->referral;
                                 local_statistics->udp_fp[mesg->status]++;                                
@@ -549,6 +565,8 @@ server_rw_udp_sender_process_message(struct network_thread_context_s *ctx, messa
                                 }
 #else
                                 database_query(database, mesg);
+                                
+                                histogram_record(&local_query_statistics->stage[QUERY_STATISTICS_LOOKUP], timens_monotonic() - lookup_ns);
 
                                 local_statistics->udp_referrals_count += mesg->referral;
                                 local_statistics->udp_fp[mesg->status]++;
@@ -842,6 +860,8 @@ server_rw_udp_sender_process_message(struct network_thread_context_s *ctx, messa
 
 #endif
     
+    u64 send_ns = timens_monotonic();
+    
 #if !UDP_USE_MESSAGES
     
     while(sendto(fd, mesg->buffer, mesg->send_length, 0, (struct sockaddr*)&mesg->other.sa, mesg->addr_len) < 0)
@@ -875,6 +895,11 @@ server_rw_udp_sender_process_message(struct network_thread_context_s *ctx, messa
 
     local_statistics->udp_output_size_total += sent;
 #endif
+    
+    u64 sent_ns = timens_monotonic();
+    
+    histogram_record(&local_query_statistics->stage[QUERY_STATISTICS_SEND], sent_ns - send_ns);
+    histogram_record(&local_query_statistics->stage[QUERY_STATISTICS_LATENCY], sent_ns - mesg->recv_ns);
         
     return SUCCESS;
 }
@@ -884,21 +909,26 @@ server_rw_udp_sender_thread(void *parms)
 {
     struct network_thread_context_s *ctx = (struct network_thread_context_s*)parms;
     ctx->idw = pthread_self();
+    ctx->query_statistics = query_statistics_get();
     int fd = ctx->sockfd;
     
     log_debug("server_rw_udp_sender_thread(%i, %i): started", ctx->idx, fd);
     
+    int nic_node = server_context_socket_node(fd);
+    
 #if HAS_PTHREAD_SETAFFINITY_NP
     cpu_set_t mycpu;
     CPU_ZERO(&mycpu);
     
-    int affinity_with = g_config->thread_affinity_base + (ctx->idx * 2 + 1) * g_config->thread_affinity_multiplier;
+    int affinity_with = server_worker_cpu(ctx->idx * 2 + 1, nic_node);
     log_info("sender setting affinity with virtual cpu %i", affinity_with);
     CPU_SET(affinity_with, &mycpu);
     
     pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &mycpu);
 #endif
     
+    server_statistics_set_node(&ctx->statistics, nic_node);
+    
 #if UDP_USE_MESSAGES
     ctx->sender_msghdr.msg_iov = &ctx->sender_iovec;
     ctx->sender_msghdr.msg_iovlen = 1;
@@ -1003,6 +1033,7 @@ server_rw_udp_sender_thread(void *parms)
                     memcpy(ctx->sender_msghdr.msg_control, cell->data.hdr.ctrl, cell->data.hdr.ctrl_len);
 #endif
                     mesg->received = cell->data.hdr.msg_size;
+                    mesg->recv_ns = cell->data.hdr.recv_ns;
                     mesg->addr_len = cell->data.hdr.sa_len;
 #if UDP_USE_MESSAGES
                     ctx->sender_msghdr.msg_controllen = cell->data.hdr.ctrl_len;
@@ -1048,6 +1079,7 @@ server_rw_udp_sender_thread(void *parms)
                 memcpy(ctx->sender_msghdr.msg_control, cell->data.hdr.ctrl, cell->data.hdr.ctrl_len);
 #endif
                 mesg->received = cell->data.hdr.msg_size;
+                mesg->recv_ns = cell->data.hdr.recv_ns;
                 mesg->addr_len = cell->data.hdr.sa_len;
 #if UDP_USE_MESSAGES
                 ctx->sender_msghdr.msg_controllen = cell->data.hdr.ctrl_len;
@@ -1083,6 +1115,44 @@ server_rw_udp_sender_thread(void *parms)
     return NULL;
 }
 
+/**
+ * The context holds the messages of both threads: on a NUMA system it is mapped on the node of the network interface.
+ */
+
+static network_thread_context_s*
+server_rw_context_new(int node)
+{
+    network_thread_context_s *ctx;
+    
+    if(sys_numa_node_count() == 1)
+    {
+        MALLOC_OR_DIE(network_thread_context_s*, ctx, sizeof(network_thread_context_s), RWNTCTX_TAG);
+    }
+    else
+    {
+        if((ctx = (network_thread_context_s*)sys_numa_alloc(sizeof(network_thread_context_s), node)) == NULL)
+        {
+            perror(__FILE__);
+            exit(EXIT_CODE_OUTOFMEMORY_ERROR);
+        }
+    }
+    
+    return ctx;
+}
+
+static void
+server_rw_context_free(network_thread_context_s *ctx)
+{
+    if(sys_numa_node_count() == 1)
+    {
+        free(ctx);
+    }
+    else
+    {
+        sys_numa_free(ctx, sizeof(network_thread_context_s));
+    }
+}
+
 static server_statistics_t server_statistics_sum;
 
 ya_result
@@ -1181,8 +1251,7 @@ server_rw_query_loop()
     {
         for(u32 r = 0; r < reader_by_fd; r++)
         {
-            network_thread_context_s *ctx;
-            MALLOC_OR_DIE(network_thread_context_s*, ctx, sizeof(network_thread_context_s), RWNTCTX_TAG);
+            network_thread_context_s *ctx = server_rw_context_new(server_context.udp_socket_node[sockfd_idx]);
             memset(ctx, 0, sizeof(network_thread_context_s));
             contextes[sockfd_idx] = ctx;
             ctx->idx = sockfd_idx;
@@ -1371,10 +1440,15 @@ server_rw_query_loop()
                             {
                                 server_statistics_sum.udp_fp[j] += stats->udp_fp[j];
                             }
+                            
+                            server_statistics_node_add(&server_statistics_sum, stats);
+                            
                             ++sockfd_idx;
                         }
                     }
                     
+                    server_xdp_statistics_add(&server_statistics_sum);
+
                     log_statistics(&server_statistics_sum);
 
                     server_run_loop_rate_tick = now;
@@ -1485,7 +1559,7 @@ server_rw_query_loop()
     {
         for(u32 r = 0; r < reader_by_fd; r++)
         {
-            free(contextes[sockfd_idx]);
+            server_rw_context_free(contextes[sockfd_idx]);
             ++sockfd_idx;
         }
     }
@@ -0,0 +1,1593 @@
+/*------------------------------------------------------------------------------
+*
+* Copyright (c) 2011-2019, EURid vzw. All rights reserved.
+* The YADIFA TM software product is provided under the BSD 3-clause license:
+* 
+* Redistribution and use in source and binary forms, with or without 
+* modification, are permitted provided that the following conditions
+* are met:
+*
+*        * Redistributions of source code must retain the above copyright 
+*          notice, this list of conditions and the following disclaimer.
+*        * Redistributions in binary form must reproduce the above copyright 
+*          notice, this list of conditions and the following disclaimer in the 
+*          documentation and/or other materials provided with the distribution.
+*        * Neither the name of EURid nor the names of its contributors may be 
+*          used to endorse or promote products derived from this software 
+*          without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*------------------------------------------------------------------------------
+*
+*/
+
+/**
+ *  @defgroup server Server
+ *  @ingroup yadifad
+ *  @brief io_uring server
+ *
+ *  One thread per UDP socket (SO_REUSEPORT gives each worker its own socket) with its own io_uring.
+ *
+ *  The reception is a single multishot recvmsg taking its buffers from a ring registered to the kernel, so the
+ *  kernel fills the buffers without a system call per message.  The answers are queued as sendmsg and every
+ *  answer of a batch of completions is submitted with the wait for the next batch, in one io_uring_enter.
+ *
+ *  TCP listeners are served by multishot accepts on a ring of the main thread, the connections are then
+ *  processed by the TCP thread pool as in the other models.
+ *
+ *  The ring is used through the system calls directly: the model does not depend on liburing.
+ *  It requires Linux 6.0 (multishot recvmsg).
+ *
+ * @{
+ */
+
+// keep this order -->
+
+#include "server-config.h"
+
+#ifndef __USE_GNU
+#define __USE_GNU 1
+#endif
+#define _GNU_SOURCE 1
+#include <sched.h>
+
+// <-- keep this order
+
+#include "config.h"
+#include "server_context.h"
+
+#include <dnscore/logger.h>
+#include <dnscore/fdtools.h>
+#include <dnscore/message.h>
+#include <dnscore/timems.h>
+#include <dnscore/thread_pool.h>
+#include <dnscore/sys_get_cpu_count.h>
+
+#include <dnsdb/zdb_types.h>
+#include <dnsdb/zdb-zone-lock.h>
+
+#ifdef DEBUG
+#define ZDB_JOURNAL_CODE 1
+#include <dnsdb/journal.h>
+#endif
+
+#if ZDB_HAS_MUTEX_DEBUG_SUPPORT
+#include "dnsdb/zdb-zone-lock-monitor.h"
+#endif
+
+#include "server.h"
+#include "server-uring.h"
+#include "server-xdp.h"
+#include "log_query.h"
+#include "process_class_ch.h"
+#include "notify.h"
+#include "log_statistics.h"
+#include "query_statistics.h"
+#include "signals.h"
+
+#if HAS_DYNUPDATE_SUPPORT
+#include "dynupdate_query_service.h"
+#endif
+
+#if HAS_RRL_SUPPORT
+#include "rrl.h"
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <signal.h>
+#include <linux/io_uring.h>
+#endif
+#endif
+
+#if defined(IORING_RECV_MULTISHOT) && defined(SO_REUSEPORT)
+#define SERVER_URING_SUPPORT 1
+#else
+#define SERVER_URING_SUPPORT 0
+#endif
+
+extern logger_handle *g_server_logger;
+#define MODULE_MSG_HANDLE g_server_logger
+
+extern logger_handle* g_statistics_logger;
+
+#if HAS_MESSAGES_SUPPORT
+#define UDP_USE_MESSAGES 1
+#else
+#define UDP_USE_MESSAGES 0
+#endif
+
+#if SERVER_URING_SUPPORT
+
+#define URINGWRK_TAG 0x4b5257474e495255
+#define URINGBUF_TAG 0x465542474e495255
+#define URINGSLT_TAG 0x544c53474e495255
+
+#define SERVER_URING_ENTRIES        1024    // submission queue of a ring
+#define SERVER_URING_BUFFER_COUNT   512     // reception buffers of a worker, power of two
+#define SERVER_URING_BUFFER_SIZE    0x2000  // larger messages are dropped
+#define SERVER_URING_SLOT_COUNT     256     // answers being sent by a worker
+#define SERVER_URING_WAIT_NS        1000000000LL
+#define SERVER_URING_RECV_RETRY_US  1000    // back-off before re-arming a failed reception, doubled each time
+#define SERVER_URING_RECV_RETRY_MAX 10      // consecutive failures before giving up on the socket
+
+#define SERVER_URING_RECV           0       // user_data of the reception, the ones of the answers are their slot
+
+struct server_uring_timespec
+{
+    s64 tv_sec;
+    s64 tv_nsec;
+};
+
+struct server_uring_s
+{
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    u32 *sq_head;
+    u32 *sq_tail;
+    u32 *sq_array;
+    u32 *cq_head;
+    u32 *cq_tail;
+    void *ring_ptr;
+    size_t ring_size;
+    size_t sqes_size;
+    u32 sq_mask;
+    u32 sq_entries;
+    u32 cq_mask;
+    u32 sq_local_tail;      // the next sqe to fill, published at the next io_uring_enter
+    int fd;
+};
+
+typedef struct server_uring_s server_uring_s;
+
+struct server_uring_slot_s
+{
+    struct server_uring_slot_s *next;
+    message_data *mesg;
+    struct iovec iovec;
+    struct msghdr msghdr;
+    u64 recv_ns;
+    u64 send_ns;
+};
+
+typedef struct server_uring_slot_s server_uring_slot_s;
+
+struct server_uring_worker_s
+{
+    server_uring_s ring;
+    struct io_uring_buf_ring *buf_ring;
+    u8 *buffers;
+    server_uring_slot_s *slots;
+    server_uring_slot_s *free_slots;
+    server_uring_slot_s spare;              // answers synchronously when all the slots are being sent
+    struct msghdr recv_msghdr;
+    pthread_t id;
+    int sockfd;
+    u32 in_flight;
+    u16 idx;
+    u16 buf_ring_tail;
+    volatile bool ready;                    // the ring is set up and the reception armed
+    volatile bool terminated;
+
+    server_statistics_t statistics __attribute__ ((aligned (64)));
+
+    query_statistics_s *query_statistics;
+};
+
+typedef struct server_uring_worker_s server_uring_worker_s;
+
+/*
+ * The ring
+ */
+
+static ya_result
+server_uring_init(server_uring_s *ring, u32 entries)
+{
+    struct io_uring_params params;
+
+    ZEROMEMORY(ring, sizeof(server_uring_s));
+    ZEROMEMORY(&params, sizeof(params));
+
+    int fd = syscall(__NR_io_uring_setup, entries, &params);
+
+    if(fd < 0)
+    {
+        return ERRNO_ERROR;
+    }
+
+    if((params.features & (IORING_FEAT_SINGLE_MMAP|IORING_FEAT_EXT_ARG)) != (IORING_FEAT_SINGLE_MMAP|IORING_FEAT_EXT_ARG))
+    {
+        close_ex(fd);
+        return FEATURE_NOT_SUPPORTED;
+    }
+
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(u32);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    ring->ring_size = MAX(sq_size, cq_size);
+    ring->ring_ptr = mmap(NULL, ring->ring_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+
+    if(ring->ring_ptr == MAP_FAILED)
+    {
+        ya_result ret = ERRNO_ERROR;
+        close_ex(fd);
+        return ret;
+    }
+
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe*)mmap(NULL, ring->sqes_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQES);
+
+    if(ring->sqes == MAP_FAILED)
+    {
+        ya_result ret = ERRNO_ERROR;
+        munmap(ring->ring_ptr, ring->ring_size);
+        close_ex(fd);
+        return ret;
+    }
+
+    u8 *base = (u8*)ring->ring_ptr;
+
+    ring->sq_head = (u32*)&base[params.sq_off.head];
+    ring->sq_tail = (u32*)&base[params.sq_off.tail];
+    ring->sq_array = (u32*)&base[params.sq_off.array];
+    ring->sq_mask = *(u32*)&base[params.sq_off.ring_mask];
+    ring->sq_entries = params.sq_entries;
+    ring->cq_head = (u32*)&base[params.cq_off.head];
+    ring->cq_tail = (u32*)&base[params.cq_off.tail];
+    ring->cq_mask = *(u32*)&base[params.cq_off.ring_mask];
+    ring->cqes = (struct io_uring_cqe*)&base[params.cq_off.cqes];
+    ring->sq_local_tail = *ring->sq_tail;
+    ring->fd = fd;
+
+    return SUCCESS;
+}
+
+static void
+server_uring_finalize(server_uring_s *ring)
+{
+    if(ring->fd >= 0)
+    {
+        munmap(ring->sqes, ring->sqes_size);
+        munmap(ring->ring_ptr, ring->ring_size);
+        close_ex(ring->fd);
+        ring->fd = -1;
+    }
+}
+
+/**
+ * Submits the queued entries and waits for at least wait_nr completions, or the timeout.
+ *
+ * @return the number of entries submitted or an error code
+ */
+
+static int
+server_uring_enter(server_uring_s *ring, u32 wait_nr, s64 timeout_ns)
+{
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+
+    u32 to_submit = ring->sq_local_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+
+    struct server_uring_timespec ts = {timeout_ns / 1000000000LL, timeout_ns % 1000000000LL};
+    struct io_uring_getevents_arg arg;
+    ZEROMEMORY(&arg, sizeof(arg));
+    arg.sigmask_sz = _NSIG / 8;
+    arg.ts = (u64)(intptr)&ts;
+
+    u32 flags = IORING_ENTER_EXT_ARG;
+
+    if(wait_nr > 0)
+    {
+        flags |= IORING_ENTER_GETEVENTS;
+    }
+
+    int ret = syscall(__NR_io_uring_enter, ring->fd, to_submit, wait_nr, flags, &arg, sizeof(arg));
+
+    if(ret < 0)
+    {
+        int err = errno;
+
+        if((err == ETIME) || (err == EINTR))
+        {
+            return 0;
+        }
+
+        return MAKE_ERRNO_ERROR(err);
+    }
+
+    return ret;
+}
+
+/**
+ * Gets the next submission entry, submitting the queued ones if the queue is full.
+ */
+
+static struct io_uring_sqe*
+server_uring_get_sqe(server_uring_s *ring)
+{
+    while((ring->sq_local_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE)) >= ring->sq_entries)
+    {
+        server_uring_enter(ring, 0, 0);
+    }
+
+    u32 idx = ring->sq_local_tail & ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[idx];
+    ZEROMEMORY(sqe, sizeof(struct io_uring_sqe));
+    ring->sq_array[idx] = idx;
+    ++ring->sq_local_tail;
+
+    return sqe;
+}
+
+/*
+ * UDP
+ */
+
+static void
+server_uring_buffer_recycle(server_uring_worker_s *w, u16 bid)
+{
+    struct io_uring_buf *buf = &w->buf_ring->bufs[w->buf_ring_tail & (SERVER_URING_BUFFER_COUNT - 1)];
+    buf->addr = (u64)(intptr)&w->buffers[bid * SERVER_URING_BUFFER_SIZE];
+    buf->len = SERVER_URING_BUFFER_SIZE;
+    buf->bid = bid;
+    ++w->buf_ring_tail;
+}
+
+static void
+server_uring_buffers_publish(server_uring_worker_s *w)
+{
+    __atomic_store_n(&w->buf_ring->tail, w->buf_ring_tail, __ATOMIC_RELEASE);
+}
+
+static void
+server_uring_arm_recv(server_uring_worker_s *w)
+{
+    struct io_uring_sqe *sqe = server_uring_get_sqe(&w->ring);
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = w->sockfd;
+    sqe->addr = (u64)(intptr)&w->recv_msghdr;
+    sqe->len = 1;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = 0;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->user_data = SERVER_URING_RECV;
+}
+
+static ya_result
+server_uring_worker_init(server_uring_worker_s *w)
+{
+    ya_result ret;
+
+    if(FAIL(ret = server_uring_init(&w->ring, SERVER_URING_ENTRIES)))
+    {
+        return ret;
+    }
+
+    size_t buf_ring_size = SERVER_URING_BUFFER_COUNT * sizeof(struct io_uring_buf);
+
+    w->buf_ring = (struct io_uring_buf_ring*)mmap(NULL, buf_ring_size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+
+    if(w->buf_ring == MAP_FAILED)
+    {
+        ret = ERRNO_ERROR;
+        w->buf_ring = NULL;
+        server_uring_finalize(&w->ring);
+        return ret;
+    }
+
+    struct io_uring_buf_reg reg;
+    ZEROMEMORY(&reg, sizeof(reg));
+    reg.ring_addr = (u64)(intptr)w->buf_ring;
+    reg.ring_entries = SERVER_URING_BUFFER_COUNT;
+    reg.bgid = 0;
+
+    if(syscall(__NR_io_uring_register, w->ring.fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    {
+        ret = ERRNO_ERROR;
+        munmap(w->buf_ring, buf_ring_size);
+        w->buf_ring = NULL;
+        server_uring_finalize(&w->ring);
+        return ret;
+    }
+
+    MALLOC_OR_DIE(u8*, w->buffers, SERVER_URING_BUFFER_COUNT * SERVER_URING_BUFFER_SIZE, URINGBUF_TAG);
+
+    w->buf_ring_tail = 0;
+
+    for(u32 i = 0; i < SERVER_URING_BUFFER_COUNT; ++i)
+    {
+        server_uring_buffer_recycle(w, i);
+    }
+
+    server_uring_buffers_publish(w);
+
+    MALLOC_OR_DIE(server_uring_slot_s*, w->slots, SERVER_URING_SLOT_COUNT * sizeof(server_uring_slot_s), URINGSLT_TAG);
+
+    w->free_slots = NULL;
+
+    for(u32 i = 0; i <= SERVER_URING_SLOT_COUNT; ++i)
+    {
+        server_uring_slot_s *slot = (i < SERVER_URING_SLOT_COUNT)?&w->slots[i]:&w->spare;
+
+        slot->mesg = message_new_instance();
+        ZEROMEMORY(slot->mesg, offsetof(message_data, qname));
+        slot->mesg->addr_len = sizeof(slot->mesg->other);
+        slot->mesg->protocol = IPPROTO_UDP;
+        slot->mesg->size_limit = UDPPACKET_MAX_LENGTH;
+        slot->mesg->process_flags = ~0;
+        slot->mesg->sockfd = w->sockfd;
+
+        if(i < SERVER_URING_SLOT_COUNT)
+        {
+            slot->next = w->free_slots;
+            w->free_slots = slot;
+        }
+    }
+
+    ZEROMEMORY(&w->recv_msghdr, sizeof(w->recv_msghdr));
+    w->recv_msghdr.msg_namelen = sizeof(socketaddress);
+#if UDP_USE_MESSAGES
+    w->recv_msghdr.msg_controllen = MESSAGE_DATA_CONTROL_BUFFER_SIZE;
+#endif
+    w->in_flight = 0;
+
+    return SUCCESS;
+}
+
+static void
+server_uring_worker_finalize(server_uring_worker_s *w)
+{
+    server_uring_finalize(&w->ring);
+
+    if(w->buf_ring != NULL)
+    {
+        munmap(w->buf_ring, SERVER_URING_BUFFER_COUNT * sizeof(struct io_uring_buf));
+        w->buf_ring = NULL;
+    }
+
+    if(w->slots != NULL)
+    {
+        for(u32 i = 0; i < SERVER_URING_SLOT_COUNT; ++i)
+        {
+            message_free(w->slots[i].mesg);
+        }
+
+        message_free(w->spare.mesg);
+
+        free(w->slots);
+        w->slots = NULL;
+    }
+
+    free(w->buffers);
+    w->buffers = NULL;
+}
+
+/**
+ * Processes a message.
+ *
+ * @return TRUE iff an answer has to be sent back
+ */
+
+static bool
+server_uring_process_message(zdb *database, server_uring_worker_s *w, server_uring_slot_s *slot)
+{
+    server_statistics_t * const local_statistics = &w->statistics;
+    query_statistics_s * const local_query_statistics = w->query_statistics;
+    message_data *mesg = slot->mesg;
+    ya_result return_code;
+
+    local_statistics->udp_input_count++;
+    
+    switch(MESSAGE_OP(mesg->buffer))
+    {
+        case OPCODE_QUERY:
+        {
+            if(ISOK(return_code = message_process_query(mesg)))
+            {
+                message_edns0_clear_undefined_flags(mesg);
+                
+                switch(mesg->qclass)
+                {
+                    case CLASS_IN:
+                    {
+                        local_statistics->udp_queries_count++;
+
+                        log_query(w->sockfd, mesg);
+                        
+                        query_statistics_qtype_count(local_query_statistics, mesg->qtype);
+
+                        switch(mesg->qtype)
+                        {
+                            default:
+                            {
+                                u64 lookup_ns = timens_monotonic();
+#if HAS_RRL_SUPPORT
+                                ya_result rrl = database_query_with_rrl(database, mesg);
+                                
+                                histogram_record(&local_query_statistics->stage[QUERY_STATISTICS_LOOKUP], timens_monotonic() - lookup_ns);
+
+                                local_statistics->udp_referrals_count += mesg->referral;
+                                local_statistics->udp_fp[mesg->status]++;                                
+
+                                switch(rrl)
+                                {
+                                    case RRL_SLIP:
+                                    {
+                                        local_statistics->rrl_slip++;
+                                        break;
+                                    }
+                                    case RRL_DROP:
+                                    {
+                                        local_statistics->rrl_drop++;
+                                        return FALSE;
+                                    }
+                                    case RRL_PROCEED_DROP:
+                                    {
+                                        local_statistics->rrl_drop++;
+                                        break;
+                                    }
+                                }
+#else
+                                database_query(database, mesg);
+                                
+                                histogram_record(&local_query_statistics->stage[QUERY_STATISTICS_LOOKUP], timens_monotonic() - lookup_ns);
+
+                                local_statistics->udp_referrals_count += mesg->referral;
+                                local_statistics->udp_fp[mesg->status]++;
+#endif
+                                break;
+                            }
+                            case TYPE_IXFR:
+                            {
+                                MESSAGE_FLAGS_OR(mesg->buffer, QR_BITS|TC_BITS, 0); /** @todo 20120619 edf -- IXFR UDP */
+                                SET_U32_AT(mesg->buffer[4], 0);
+                                SET_U32_AT(mesg->buffer[8], 0);
+                                mesg->send_length = DNS_HEADER_LENGTH;
+                                local_statistics->udp_fp[FP_IXFR_UDP]++;
+                                break;
+                            }
+                            case TYPE_AXFR:
+                            case TYPE_OPT:
+                            {
+                                message_make_error(mesg, FP_INCORR_PROTO);
+                                local_statistics->udp_fp[FP_INCORR_PROTO]++;
+                                break;
+                            }
+                        } // switch query type
+                        
+                        break;
+                    } // query class IN
+                    case CLASS_CH:
+                    {
+                        class_ch_process(mesg); // thread-safe
+                        local_statistics->udp_fp[mesg->status]++;
+                        break;
+                    } // query class CH
+                    default:
+                    {
+                        /// @todo 20140521 edf -- verify unsupported class error handling
+                        /*
+                        FP_CLASS_NOTFOUND
+                        log_warn("query [%04hx] %{dnsname} %{dnstype} %{dnsclass} (%{sockaddrip}) : unsupported class",
+                                ntohs(MESSAGE_ID(mesg->buffer)),
+                                mesg->qname, &mesg->qtype, &mesg->qclass,
+                                &mesg->other.sa);
+                        */
+                        /*
+                        log_warn("query [%04hx] %{dnsname} %{dnstype} %{dnsclass} (%{sockaddrip}) : unsupported operation",
+                                ntohs(MESSAGE_ID(mesg->buffer)),
+                                mesg->qname, &mesg->qtype, &mesg->qclass,
+                                &mesg->other.sa);
+                        */
+                        message_make_error(mesg, FP_NOT_SUPP_CLASS);
+                        local_statistics->udp_fp[FP_NOT_SUPP_CLASS]++;
+                        break;
+                    }
+                } // query class
+            } // if message process succeeded
+            else // an error occurred : no query to be done at all
+            {
+#ifdef DEBUG
+                return_code = message_process_query(mesg);
+#endif
+                
+                log_warn("query (%04hx) [%02x|%02x] error %i (%r) (%{sockaddrip})",
+                         ntohs(MESSAGE_ID(mesg->buffer)),
+                         MESSAGE_HIFLAGS(mesg->buffer),MESSAGE_LOFLAGS(mesg->buffer),
+                         mesg->status,
+                         return_code,
+                         &mesg->other.sa);
+                
+                local_statistics->udp_fp[mesg->status]++;
+                
+#ifdef DEBUG
+                if(return_code == UNPROCESSABLE_MESSAGE && (g_config->server_flags & SERVER_FL_LOG_UNPROCESSABLE))
+                {
+                    log_memdump_ex(MODULE_MSG_HANDLE, MSG_DEBUG, mesg->buffer, mesg->received, 16, OSPRINT_DUMP_ALL);
+                }
+#endif
+                /*
+                 * If not FE, or if we answer FE
+                 * 
+                 * ... && (MESSAGE_QR(mesg->buffer) == 0 ??? and if there the query number is > 0 ???
+                 */
+                if( (return_code != INVALID_MESSAGE) && ((mesg->status != RCODE_FORMERR) || ((g_config->server_flags & SERVER_FL_ANSWER_FORMERR) != 0)))
+                {
+                    message_edns0_clear_undefined_flags(mesg);
+                    
+                    if(!MESSAGEP_HAS_TSIG(mesg))
+                    {
+                        message_transform_to_error(mesg);
+                    }
+                }
+                else
+                {
+                    local_statistics->udp_dropped_count++;
+                    return FALSE;
+                }
+            }
+            
+            break;
+        } // case query
+        
+        case OPCODE_NOTIFY:
+        {
+            if(ISOK(return_code = message_process(mesg)))
+            {
+                message_edns0_clear_undefined_flags(mesg);
+                
+                switch(mesg->qclass)
+                {
+                    case CLASS_IN:
+                    {
+                        ya_result return_value;
+
+                        local_statistics->udp_notify_input_count++;
+
+                        log_info("notify (%04hx) %{dnsname} (%{sockaddr})",
+                                ntohs(MESSAGE_ID(mesg->buffer)),
+                                mesg->qname,
+                                &mesg->other.sa);
+
+                        bool answer = MESSAGE_QR(mesg->buffer);
+                        
+                        return_value = notify_process(mesg); // thread-safe
+                        
+                        message_edns0_clear_undefined_flags(mesg);
+                        
+                        local_statistics->udp_fp[mesg->status]++;
+                        
+                        if(FAIL(return_value))
+                        {
+                            log_err("notify (%04hx) %{dnsname} failed : %r",
+                                    ntohs(MESSAGE_ID(mesg->buffer)),
+                                    mesg->qname,
+                                    return_value);
+                            
+                            if(answer)
+                            {
+                                return FALSE;
+                            }
+                            
+                            if(!MESSAGEP_HAS_TSIG(mesg))
+                            {
+                                message_transform_to_error(mesg);
+                            }
+                            break;
+                        }
+                        else
+                        {
+                            if(answer)
+                            {
+                                return FALSE;
+                            }
+                        }
+                        
+                        break;
+                    } // notify class IN
+                    default:
+                    {
+                        /// @todo 20140521 edf -- verify unsupported class error handling
+                        /*
+                        FP_CLASS_NOTFOUND
+                        */
+                        message_make_error(mesg, FP_NOT_SUPP_CLASS);
+                        local_statistics->udp_fp[FP_NOT_SUPP_CLASS]++;
+                        break;
+                    }
+                } // notify class
+            } // if message process succeeded
+            else // an error occurred : no query to be done at all
+            {
+                log_warn("notify (%04hx) [%02x|%02x] error %i (%r) (%{sockaddrip})",
+                         ntohs(MESSAGE_ID(mesg->buffer)),
+                         MESSAGE_HIFLAGS(mesg->buffer),MESSAGE_LOFLAGS(mesg->buffer),
+                         mesg->status,
+                         return_code,
+                         &mesg->other.sa);
+
+                local_statistics->udp_fp[mesg->status]++;
+#ifdef DEBUG
+                log_memdump_ex(MODULE_MSG_HANDLE, MSG_DEBUG5, mesg->buffer, mesg->received, 16, OSPRINT_DUMP_ALL);
+#endif
+                /*
+                 * If not FE, or if we answer FE
+                 * 
+                 * ... && (MESSAGE_QR(mesg->buffer) == 0 ??? and if there the query number is > 0 ???
+                 */
+                if( (return_code != INVALID_MESSAGE) && ((mesg->status != RCODE_FORMERR) || ((g_config->server_flags & SERVER_FL_ANSWER_FORMERR) != 0)))
+                {
+                    message_edns0_clear_undefined_flags(mesg);
+                    
+                    if(!MESSAGEP_HAS_TSIG(mesg))
+                    {
+                        message_transform_to_error(mesg);
+                    }
+                }
+                else
+                {
+                    local_statistics->udp_dropped_count++;
+                    return FALSE;
+                }
+            }
+            break;
+        } // case notify
+
+        case OPCODE_UPDATE:
+        {
+            if(ISOK(return_code = message_process(mesg)))
+            {
+                message_edns0_clear_undefined_flags(mesg);
+                
+                switch(mesg->qclass)
+                {
+                    case CLASS_IN:
+                    {
+#if HAS_DYNUPDATE_SUPPORT
+                        /**
+                         * @note It's the responsibility of the called function (or one of its callees) to ensure
+                         *       this does not take much time and thus to trigger a background task with the
+                         *       scheduler if needed.
+                         */
+
+                        local_statistics->udp_updates_count++;
+
+                        dynupdate_query_service_enqueue_handoff(database, message_handoff(&slot->mesg));
+                        
+                        return FALSE; // NOT break;
+#else
+                        message_make_error(mesg, FP_FEATURE_DISABLED);
+                        local_statistics->udp_fp[FP_FEATURE_DISABLED]++;
+                        break;
+#endif
+                        
+                    } // update class IN
+                    default:
+                    {
+                        /// @todo 20140521 edf -- verify unsupported class error handling
+                        /*
+                        FP_CLASS_NOTFOUND
+                        */
+                        message_make_error(mesg, FP_NOT_SUPP_CLASS);
+                        local_statistics->udp_fp[FP_NOT_SUPP_CLASS]++;
+                        break;
+                    }
+                } // update class
+            } // if message process succeeded
+            else // an error occurred : no query to be done at all
+            {
+                log_warn("update (%04hx) [%02x|%02x] error %i (%r) (%{sockaddrip})",
+                         ntohs(MESSAGE_ID(mesg->buffer)),
+                         MESSAGE_HIFLAGS(mesg->buffer),MESSAGE_LOFLAGS(mesg->buffer),
+                         mesg->status,
+                         return_code,
+                         &mesg->other.sa);
+
+                local_statistics->udp_fp[mesg->status]++;
+#ifdef DEBUG
+                log_memdump_ex(MODULE_MSG_HANDLE, MSG_DEBUG5, mesg->buffer, mesg->received, 16, OSPRINT_DUMP_ALL);
+#endif
+                /*
+                 * If not FE, or if we answer FE
+                 * 
+                 * ... && (MESSAGE_QR(mesg->buffer) == 0 ??? and if there the query number is > 0 ???
+                 */
+                if( (return_code != INVALID_MESSAGE) && ((mesg->status != RCODE_FORMERR) || ((g_config->server_flags & SERVER_FL_ANSWER_FORMERR) != 0)))
+                {
+                    message_edns0_clear_undefined_flags(mesg);
+                    
+                    if(!MESSAGEP_HAS_TSIG(mesg))
+                    {
+                        message_transform_to_error(mesg);
+                    }
+                }
+                else
+                {
+                    local_statistics->udp_dropped_count++;
+                    return FALSE;
+                }
+            }
+            break;
+        } // case update
+
+        default:
+        {
+            return_code = message_process_query(mesg);
+            mesg->status = RCODE_NOTIMP;
+
+            log_warn("unknown [%04hx] error: %r", ntohs(MESSAGE_ID(mesg->buffer)), MAKE_DNSMSG_ERROR(mesg->status));
+                
+            if( (mesg->status != RCODE_FORMERR) || ((g_config->server_flags & SERVER_FL_ANSWER_FORMERR) != 0))
+            {
+                message_edns0_clear_undefined_flags(mesg);
+                
+                if(!MESSAGEP_HAS_TSIG(mesg))
+                {
+                    message_transform_to_error(mesg);
+                }
+            }
+            else
+            {
+                local_statistics->udp_dropped_count++;
+                return FALSE;
+            }
+        }
+    } // switch operation code
+
+#ifdef DEBUG
+    if(mesg->send_length < 12)
+    {
+        log_debug("wrong output message of status %i size %i", mesg->status, mesg->send_length);
+
+        log_memdump_ex(g_server_logger, MSG_DEBUG5, mesg->buffer, mesg->send_length, 16, OSPRINT_DUMP_HEXTEXT);
+    }
+#endif
+
+#if !HAS_DROPALL_SUPPORT
+    return TRUE;
+#else
+    log_debug("server_uring_process_message: drop all");
+    return FALSE;
+#endif
+}
+
+static void
+server_uring_sent(server_uring_worker_s *w, server_uring_slot_s *slot, ssize_t sent)
+{
+    message_data *mesg = slot->mesg;
+
+    if(sent >= 0)
+    {
+        u64 sent_ns = timens_monotonic();
+
+        histogram_record(&w->query_statistics->stage[QUERY_STATISTICS_SEND], sent_ns - slot->send_ns);
+        histogram_record(&w->query_statistics->stage[QUERY_STATISTICS_LATENCY], sent_ns - slot->recv_ns);
+
+        w->statistics.udp_output_size_total += sent;
+
+        if(sent != mesg->send_length)
+        {
+            log_err("short byte count sent (%i instead of %i)", sent, mesg->send_length);
+        }
+    }
+    else
+    {
+        log_err("query (%04hx) %{dnsname} %{dnstype} send failed: %r",
+                ntohs(MESSAGE_ID(mesg->buffer)),
+                mesg->qname,
+                &mesg->qtype,
+                MAKE_ERRNO_ERROR(-sent));
+    }
+}
+
+static void
+server_uring_received(zdb *database, server_uring_worker_s *w, const u8 *buffer, u64 recv_ns)
+{
+    const struct io_uring_recvmsg_out *out = (const struct io_uring_recvmsg_out*)buffer;
+    const u8 *name = &buffer[sizeof(struct io_uring_recvmsg_out)];
+    const u8 *control = &name[w->recv_msghdr.msg_namelen];
+    const u8 *payload = &control[w->recv_msghdr.msg_controllen];
+
+    w->statistics.input_loop_count++;
+
+    if(((out->flags & MSG_TRUNC) != 0) || (out->namelen > sizeof(socketaddress)))
+    {
+        log_debug("server-uring: %{sockaddr}: message of %u bytes dropped", name, out->payloadlen);
+
+        w->statistics.udp_input_count++;
+        w->statistics.udp_dropped_count++;
+        return;
+    }
+
+    server_uring_slot_s *slot = w->free_slots;
+
+    if(slot != NULL)
+    {
+        w->free_slots = slot->next;
+    }
+    else
+    {
+        slot = &w->spare;
+    }
+
+    message_data *mesg = slot->mesg;
+
+    memcpy(&mesg->other, name, out->namelen);
+    mesg->addr_len = out->namelen;
+    mesg->control_buffer_size = MIN(out->controllen, sizeof(mesg->control_buffer));
+    memcpy(mesg->control_buffer, control, mesg->control_buffer_size);
+    memcpy(mesg->buffer, payload, out->payloadlen);
+    mesg->received = out->payloadlen;
+    slot->recv_ns = recv_ns;
+
+    if(server_uring_process_message(database, w, slot))
+    {
+        mesg = slot->mesg;
+
+        slot->iovec.iov_base = mesg->buffer;
+        slot->iovec.iov_len = mesg->send_length;
+        ZEROMEMORY(&slot->msghdr, sizeof(slot->msghdr));
+        slot->msghdr.msg_name = &mesg->other.sa;
+        slot->msghdr.msg_namelen = mesg->addr_len;
+        slot->msghdr.msg_iov = &slot->iovec;
+        slot->msghdr.msg_iovlen = 1;
+#if UDP_USE_MESSAGES
+        slot->msghdr.msg_control = (mesg->control_buffer_size > 0)?mesg->control_buffer:NULL;
+        slot->msghdr.msg_controllen = mesg->control_buffer_size;
+#endif
+        slot->send_ns = timens_monotonic();
+
+        if(slot != &w->spare)
+        {
+            struct io_uring_sqe *sqe = server_uring_get_sqe(&w->ring);
+            sqe->opcode = IORING_OP_SENDMSG;
+            sqe->fd = w->sockfd;
+            sqe->addr = (u64)(intptr)&slot->msghdr;
+            sqe->len = 1;
+            sqe->user_data = (u64)(intptr)slot;
+
+            ++w->in_flight;
+
+            return;
+        }
+
+        ssize_t sent;
+
+        while((sent = sendmsg(w->sockfd, &slot->msghdr, 0)) < 0)
+        {
+            int err = errno;
+
+            if(err != EINTR)
+            {
+                sent = -err;
+                break;
+            }
+        }
+
+        server_uring_sent(w, slot, sent);
+    }
+
+    if(slot != &w->spare)
+    {
+        slot->next = w->free_slots;
+        w->free_slots = slot;
+    }
+}
+
+static void*
+server_uring_udp_thread(void *parms)
+{
+    server_uring_worker_s *w = (server_uring_worker_s*)parms;
+    zdb *database = g_config->database;
+    ya_result ret;
+
+    w->id = pthread_self();
+    w->query_statistics = query_statistics_get();
+
+    int nic_node = server_context_socket_node(w->sockfd);
+
+#if HAS_PTHREAD_SETAFFINITY_NP
+    cpu_set_t mycpu;
+    CPU_ZERO(&mycpu);
+
+    int affinity_with = server_worker_cpu(w->idx, nic_node);
+    log_info("server-uring: setting affinity with virtual cpu %i", affinity_with);
+    CPU_SET(affinity_with, &mycpu);
+
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &mycpu);
+#endif
+
+    server_statistics_set_node(&w->statistics, nic_node);
+
+    if(FAIL(ret = server_uring_worker_init(w)))
+    {
+        log_err("server-uring: could not set up the ring of socket %i: %r", w->sockfd, ret);
+        w->terminated = TRUE;
+        return NULL;
+    }
+
+    server_uring_arm_recv(w);
+
+    w->ready = TRUE;
+
+    log_debug("server-uring: reading on %i", w->sockfd);
+
+    u32 recv_failures = 0;
+
+    while(program_mode != SA_SHUTDOWN)
+    {
+        // submits the answers of the previous batch and waits for the next one
+
+        if(FAIL(ret = server_uring_enter(&w->ring, 1, SERVER_URING_WAIT_NS)))
+        {
+            log_err("server-uring: %i: %r", w->sockfd, ret);
+            break;
+        }
+
+        u32 head = *w->ring.cq_head;
+        u32 tail = __atomic_load_n(w->ring.cq_tail, __ATOMIC_ACQUIRE);
+
+        if(head == tail)
+        {
+            continue;
+        }
+
+        u64 recv_ns = timens_monotonic();
+        bool rearm = FALSE;
+        bool failed = FALSE;
+
+        for(; head != tail; ++head)
+        {
+            const struct io_uring_cqe *cqe = &w->ring.cqes[head & w->ring.cq_mask];
+
+            if(cqe->user_data == SERVER_URING_RECV)
+            {
+                if(cqe->res >= 0)
+                {
+                    u16 bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+
+                    server_uring_received(database, w, &w->buffers[bid * SERVER_URING_BUFFER_SIZE], recv_ns);
+                    server_uring_buffer_recycle(w, bid);
+
+                    recv_failures = 0;
+                }
+                else if(cqe->res != -ENOBUFS)
+                {
+                    log_err("server-uring: %i: recvmsg: %r", w->sockfd, MAKE_ERRNO_ERROR(-cqe->res));
+                    failed = TRUE;
+                }
+
+                if((cqe->flags & IORING_CQE_F_MORE) == 0)
+                {
+                    rearm = TRUE;
+                }
+            }
+            else
+            {
+                server_uring_slot_s *slot = (server_uring_slot_s*)(intptr)cqe->user_data;
+
+                server_uring_sent(w, slot, cqe->res);
+
+                --w->in_flight;
+                slot->next = w->free_slots;
+                w->free_slots = slot;
+            }
+        }
+
+        __atomic_store_n(w->ring.cq_head, head, __ATOMIC_RELEASE);
+
+        server_uring_buffers_publish(w);
+
+        if(failed)
+        {
+            // the socket would be left unread: retry a few times, then stop the server
+
+            if(++recv_failures >= SERVER_URING_RECV_RETRY_MAX)
+            {
+                log_err("server-uring: %i: recvmsg keeps failing, shutting down", w->sockfd);
+
+                program_mode = SA_SHUTDOWN;
+
+                dnscore_shutdown();
+
+                break;
+            }
+
+            usleep(SERVER_URING_RECV_RETRY_US << (recv_failures - 1));
+        }
+
+        if(rearm)
+        {
+            server_uring_arm_recv(w);
+        }
+    }
+
+    // the answers being sent are referencing the slots
+
+    for(int countdown = 10; (w->in_flight > 0) && (countdown > 0); --countdown)
+    {
+        server_uring_enter(&w->ring, w->in_flight, SERVER_URING_WAIT_NS / 10);
+
+        u32 head = *w->ring.cq_head;
+        u32 tail = __atomic_load_n(w->ring.cq_tail, __ATOMIC_ACQUIRE);
+
+        for(; head != tail; ++head)
+        {
+            if(w->ring.cqes[head & w->ring.cq_mask].user_data != SERVER_URING_RECV)
+            {
+                --w->in_flight;
+            }
+        }
+
+        __atomic_store_n(w->ring.cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    log_debug("server-uring: stop reading on %i", w->sockfd);
+
+    server_uring_worker_finalize(w);
+
+    w->terminated = TRUE;
+
+    return NULL;
+}
+
+/*
+ * TCP
+ */
+
+static void
+server_uring_arm_accept(server_uring_s *ring, int tcp_idx)
+{
+    struct io_uring_sqe *sqe = server_uring_get_sqe(ring);
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = server_context.tcp_socket[tcp_idx];
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = tcp_idx;
+}
+
+/*
+ * Main loop
+ */
+
+static server_statistics_t server_statistics_sum;
+
+static bool
+server_uring_opcode_supported(server_uring_s *ring, u8 opcode)
+{
+    u64 buffer[(sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op)) / sizeof(u64)];
+    struct io_uring_probe *probe = (struct io_uring_probe*)buffer;
+
+    ZEROMEMORY(buffer, sizeof(buffer));
+
+    if(syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PROBE, probe, 256) < 0)
+    {
+        return FALSE;
+    }
+
+    return (opcode <= probe->last_op) && ((probe->ops[opcode].flags & IO_URING_OP_SUPPORTED) != 0);
+}
+
+/**
+ * Arms a multishot recvmsg on an unbound socket: kernels without it (< 6.0) complete it at once with an error,
+ * the others keep it pending.
+ */
+
+static bool
+server_uring_recv_multishot_supported(server_uring_s *ring, struct msghdr *msg)
+{
+    int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+
+    if(sockfd < 0)
+    {
+        return FALSE;
+    }
+
+    struct io_uring_sqe *sqe = server_uring_get_sqe(ring);
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = sockfd;
+    sqe->addr = (u64)(intptr)msg;
+    sqe->len = 1;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = 0;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->user_data = SERVER_URING_RECV;
+
+    bool supported = ISOK(server_uring_enter(ring, 1, SERVER_URING_WAIT_NS / 100));
+
+    if(supported && (*ring->cq_head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)))
+    {
+        supported = ring->cqes[*ring->cq_head & ring->cq_mask].res >= 0;
+    }
+
+    // the pending reception holds the socket until the ring is closed
+
+    close_ex(sockfd);
+
+    return supported;
+}
+
+/**
+ * Checks the kernel has what the workers use: the RECVMSG operation, the provided buffer rings (5.19)
+ * and the multishot reception (6.0).
+ */
+
+bool
+server_uring_supported()
+{
+    server_uring_s ring;
+
+    if(FAIL(server_uring_init(&ring, 4)))
+    {
+        return FALSE;
+    }
+
+    if(!server_uring_opcode_supported(&ring, IORING_OP_RECVMSG))
+    {
+        server_uring_finalize(&ring);
+        return FALSE;
+    }
+
+    // one page for the buffer ring, one for its only buffer
+
+    long page_size = sysconf(_SC_PAGESIZE);
+    u8 *pages = (u8*)mmap(NULL, page_size * 2, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+
+    if(pages == MAP_FAILED)
+    {
+        server_uring_finalize(&ring);
+        return FALSE;
+    }
+
+    struct io_uring_buf_ring *buf_ring = (struct io_uring_buf_ring*)pages;
+
+    struct io_uring_buf_reg reg;
+    ZEROMEMORY(&reg, sizeof(reg));
+    reg.ring_addr = (u64)(intptr)buf_ring;
+    reg.ring_entries = 1;
+    reg.bgid = 0;
+
+    bool supported = FALSE;
+
+    if(syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_PBUF_RING, &reg, 1) >= 0)
+    {
+        buf_ring->bufs[0].addr = (u64)(intptr)&pages[page_size];
+        buf_ring->bufs[0].len = page_size;
+        buf_ring->bufs[0].bid = 0;
+        __atomic_store_n(&buf_ring->tail, 1, __ATOMIC_RELEASE);
+
+        struct msghdr msg;
+        ZEROMEMORY(&msg, sizeof(msg));
+        msg.msg_namelen = sizeof(socketaddress);
+
+        supported = server_uring_recv_multishot_supported(&ring, &msg);
+    }
+
+    server_uring_finalize(&ring); // closing the ring cancels the reception
+
+    munmap(pages, page_size * 2);
+
+    return supported;
+}
+
+ya_result
+server_uring_query_loop()
+{
+    ya_result ret;
+
+    if(g_config->total_interfaces == 0)
+    {
+        return INVALID_STATE_ERROR;
+    }
+
+    log_query_set_mode(g_config->queries_log_type);
+
+    bool log_statistics_enabled = (g_statistics_logger != NULL) && (g_config->server_flags & SERVER_FL_STATISTICS) != 0;
+
+    log_debug("statistics are %s", (log_statistics_enabled)?"enabled":"disabled");
+
+    if(log_statistics_enabled)
+    {
+        log_statistics_legend();
+    }
+
+    server_uring_s tcp_ring;
+
+    if(FAIL(ret = server_uring_init(&tcp_ring, MAX(server_context.tcp_socket_count, 1) * 2)))
+    {
+        log_err("server-uring: could not set up the ring: %r", ret);
+        return ret;
+    }
+
+    s32 worker_count = server_context.udp_socket_count;
+
+    if(worker_count > sys_get_cpu_count())
+    {
+        log_warn("server-uring: using too many threads per address is counter-productive on highly loaded systems (%d > %d)", worker_count, sys_get_cpu_count());
+    }
+
+    struct thread_pool_s *server_udp_thread_pool = thread_pool_init_ex(MAX(worker_count, 1), 1, "svrudpur");
+
+    server_uring_worker_s **workers;
+    MALLOC_OR_DIE(server_uring_worker_s**, workers, sizeof(server_uring_worker_s*) * MAX(worker_count, 1), URINGWRK_TAG);
+
+    for(int i = 0; i < worker_count; ++i)
+    {
+        server_uring_worker_s *w;
+        MALLOC_OR_DIE(server_uring_worker_s*, w, sizeof(server_uring_worker_s), URINGWRK_TAG);
+        ZEROMEMORY(w, sizeof(server_uring_worker_s));
+        w->ring.fd = -1;
+        w->sockfd = server_context.udp_socket[i];
+        w->idx = i;
+        workers[i] = w;
+
+        log_info("thread #%i of UDP interface using socket %i", i, w->sockfd);
+
+        if(FAIL(ret = thread_pool_enqueue_call(server_udp_thread_pool, server_uring_udp_thread, w, NULL, "server-uring")))
+        {
+            log_err("unable to schedule task : %r", ret);
+
+            // the workers already started are stopped with the others
+
+            free(w);
+            worker_count = i;
+            break;
+        }
+    }
+
+    // a worker that cannot set up its ring would leave its socket unread
+
+    bool workers_ready = ISOK(ret);
+
+    for(int i = 0; i < worker_count; ++i)
+    {
+        while(!workers[i]->ready && !workers[i]->terminated)
+        {
+            usleep(1000);
+        }
+
+        workers_ready &= workers[i]->ready;
+    }
+
+    if(workers_ready)
+    {
+        for(int i = 0; i < server_context.tcp_socket_count; ++i)
+        {
+            server_uring_arm_accept(&tcp_ring, i);
+        }
+
+        log_info("ready to work");
+    }
+    else
+    {
+        log_err("server-uring: could not start the UDP workers, shutting down");
+
+        program_mode = SA_SHUTDOWN;
+
+        dnscore_shutdown();
+    }
+
+    u64 server_run_loop_rate_tick = 0;
+    u32 previous_tick = 0;
+
+    while(program_mode != SA_SHUTDOWN)
+    {
+        server_statistics.input_loop_count++;
+
+        if(FAIL(ret = server_uring_enter(&tcp_ring, 1, SERVER_URING_WAIT_NS)))
+        {
+            log_quit("server-uring: io_uring_enter returned a critical error: %r", ret);
+        }
+
+        u32 head = *tcp_ring.cq_head;
+        u32 tail = __atomic_load_n(tcp_ring.cq_tail, __ATOMIC_ACQUIRE);
+
+        if(head == tail)
+        {
+            server_statistics.input_timeout_count++;
+        }
+
+        for(; head != tail; ++head)
+        {
+            const struct io_uring_cqe *cqe = &tcp_ring.cqes[head & tcp_ring.cq_mask];
+            int tcp_idx = (int)cqe->user_data;
+
+            if(cqe->res >= 0)
+            {
+                server_process_tcp_accepted(g_config->database, server_context.tcp_socket[tcp_idx], cqe->res);
+
+                server_statistics.loop_rate_counter++;
+            }
+            else if((cqe->res != -EINTR) && (cqe->res != -ECONNABORTED))
+            {
+                log_err("tcp: accept returned %r", MAKE_ERRNO_ERROR(-cqe->res));
+            }
+
+            if((cqe->flags & IORING_CQE_F_MORE) == 0)
+            {
+                server_uring_arm_accept(&tcp_ring, tcp_idx);
+            }
+        }
+
+        __atomic_store_n(tcp_ring.cq_head, head, __ATOMIC_RELEASE);
+
+#if HAS_RRL_SUPPORT
+        rrl_cull();
+#endif
+
+#if ZDB_HAS_MUTEX_DEBUG_SUPPORT
+        zdb_zone_lock_monitor_log();
+#endif
+#if ZDB_HAS_OLD_MUTEX_DEBUG_SUPPORT
+        zdb_zone_lock_set_monitor();
+#endif
+
+        /* handles statistics logging */
+
+        if(log_statistics_enabled)
+        {
+            u32 tick = dnscore_timer_get_tick();
+
+            if((tick - previous_tick) >= g_config->statistics_max_period)
+            {
+                u64 now = timems();
+                u64 delta = now - server_run_loop_rate_tick;
+
+                if(delta > 0)
+                {
+                    /* log_info specifically targeted to the g_statistics_logger handle */
+
+                    server_statistics.loop_rate_elapsed = delta;
+
+                    memcpy(&server_statistics_sum, &server_statistics, sizeof(server_statistics_t));
+
+                    for(int i = 0; i < worker_count; ++i)
+                    {
+                        server_statistics_t *stats = &workers[i]->statistics;
+
+                        server_statistics_sum.input_loop_count += stats->input_loop_count;
+                        server_statistics_sum.udp_output_size_total += stats->udp_output_size_total;
+                        server_statistics_sum.udp_referrals_count += stats->udp_referrals_count;
+                        server_statistics_sum.udp_input_count += stats->udp_input_count;
+                        server_statistics_sum.udp_dropped_count += stats->udp_dropped_count;
+                        server_statistics_sum.udp_queries_count += stats->udp_queries_count;
+                        server_statistics_sum.udp_notify_input_count += stats->udp_notify_input_count;
+                        server_statistics_sum.udp_updates_count += stats->udp_updates_count;
+                        server_statistics_sum.udp_undefined_count += stats->udp_undefined_count;
+#if HAS_RRL_SUPPORT
+                        server_statistics_sum.rrl_slip += stats->rrl_slip;
+                        server_statistics_sum.rrl_drop += stats->rrl_drop;
+#endif
+                        for(u32 j = 0; j < SERVER_STATISTICS_ERROR_CODES_COUNT; j++)
+                        {
+                            server_statistics_sum.udp_fp[j] += stats->udp_fp[j];
+                        }
+
+                        server_statistics_node_add(&server_statistics_sum, stats);
+                    }
+
+                    server_xdp_statistics_add(&server_statistics_sum);
+
+                    log_statistics(&server_statistics_sum);
+
+                    server_run_loop_rate_tick = now;
+                    server_statistics.loop_rate_counter = 0;
+#ifdef DEBUG
+#if HAS_ZALLOC_STATISTICS_SUPPORT
+                    zalloc_print_stats(termout);
+#endif
+#if DNSCORE_HAS_MALLOC_DEBUG_SUPPORT
+                    debug_stat(DEBUG_STAT_SIZES|DEBUG_STAT_TAGS); // do NOT enable the dump
+#endif
+                    journal_log_status();
+
+                    debug_bench_logdump_all();
+#endif
+                }
+
+                previous_tick = tick;
+            }
+        }
+    }
+
+    log_info("stopping the threads");
+
+    server_uring_finalize(&tcp_ring);
+
+    // the workers are waiting for at most a second
+
+    for(int i = 0; i < worker_count; ++i)
+    {
+        while(!workers[i]->terminated)
+        {
+            usleep(1000);
+        }
+    }
+
+    log_info("shutting down");
+
+    thread_pool_destroy(server_udp_thread_pool);
+    server_udp_thread_pool = NULL;
+
+    for(int i = 0; i < worker_count; ++i)
+    {
+        free(workers[i]);
+    }
+    free(workers);
+
+    log_debug("shutting down (pid = %u)", getpid());
+
+    return (workers_ready)?SUCCESS:INVALID_STATE_ERROR;
+}
+
+ya_result
+server_uring_context_init(int workers_per_interface)
+{
+    server_context.thread_per_udp_worker_count = 1; // set in stone
+    server_context.thread_per_tcp_worker_count = 1; // set in stone
+    server_context.udp_unit_per_interface = MAX(workers_per_interface, 1);
+    server_context.tcp_unit_per_interface = 1;
+    server_context.reuse = 1;
+    server_context.ready = 1;
+    return SUCCESS;
+}
+
+#else // SERVER_URING_SUPPORT
+
+bool
+server_uring_supported()
+{
+    return FALSE;
+}
+
+ya_result
+server_uring_query_loop()
+{
+    log_err("io_uring is not supported on this system.");
+    return FEATURE_NOT_SUPPORTED;
+}
+
+ya_result
+server_uring_context_init(int workers_per_interface)
+{
+    (void)workers_per_interface;
+    log_err("io_uring is not supported on this system.");
+    return FEATURE_NOT_SUPPORTED;
+}
+
+#endif // SERVER_URING_SUPPORT
+
+/**
+ * @}
+ */
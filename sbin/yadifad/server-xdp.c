@@ -0,0 +1,1609 @@
+/*------------------------------------------------------------------------------
+*
+* Copyright (c) 2011-2019, EURid vzw. All rights reserved.
+* The YADIFA TM software product is provided under the BSD 3-clause license:
+* 
+* Redistribution and use in source and binary forms, with or without 
+* modification, are permitted provided that the following conditions
+* are met:
+*
+*        * Redistributions of source code must retain the above copyright 
+*          notice, this list of conditions and the following disclaimer.
+*        * Redistributions in binary form must reproduce the above copyright 
+*          notice, this list of conditions and the following disclaimer in the 
+*          documentation and/or other materials provided with the distribution.
+*        * Neither the name of EURid nor the names of its contributors may be 
+*          used to endorse or promote products derived from this software 
+*          without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*------------------------------------------------------------------------------
+*
+*/
+
+/**
+ *  @defgroup server Server
+ *  @ingroup yadifad
+ *  @brief AF_XDP fast path
+ *
+ *  For each interface holding an address of xdp-listen, an XDP program is generated and attached to the interface
+ *  in generic (SKB) mode, so it works with any driver, veth included.  It redirects the UDP queries (opcode QUERY)
+ *  sent to these addresses and ports to an AF_XDP socket per receive queue.  Anything else, fragments, IP options,
+ *  IPv6 extension headers, answers, notifies, updates, ..., is passed to the kernel stack, i.e. to the regular
+ *  sockets of the address.
+ *
+ *  A thread per AF_XDP socket processes the queries as the UDP threads do and writes the answer in the frame of the
+ *  query, swapping the Ethernet, IP and UDP headers in place before queuing it for transmission.
+ *
+ *  Answers that would not fit the MTU are truncated (TC): the client will retry with TCP.
+ *
+ *  No library is needed: the program is assembled here and attached with a BPF link (Linux 5.9).
+ *
+ * @{
+ */
+
+// keep this order -->
+
+#include "server-config.h"
+
+#ifndef __USE_GNU
+#define __USE_GNU 1
+#endif
+#define _GNU_SOURCE 1
+#include <sched.h>
+
+// <-- keep this order
+
+#include "config.h"
+#include "server_context.h"
+
+#include <dirent.h>
+#include <poll.h>
+
+#include <dnscore/logger.h>
+#include <dnscore/fdtools.h>
+#include <dnscore/message.h>
+#include <dnscore/timems.h>
+#include <dnscore/thread_pool.h>
+#include <dnscore/sys_get_cpu_count.h>
+
+#include <dnsdb/zdb_types.h>
+
+#include "server.h"
+#include "server-xdp.h"
+#include "log_query.h"
+#include "process_class_ch.h"
+#include "query_statistics.h"
+#include "signals.h"
+
+#if HAS_RRL_SUPPORT
+#include "rrl.h"
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/if_xdp.h>) && __has_include(<linux/bpf.h>)
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <net/if.h>
+#include <net/ethernet.h>
+#include <netinet/ip.h>
+#include <netinet/ip6.h>
+#include <netinet/udp.h>
+#include <ifaddrs.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+#include <linux/bpf.h>
+#endif
+#endif
+
+#if defined(XDP_RING_NEED_WAKEUP) && defined(XDP_FLAGS_SKB_MODE) && defined(BPF_JMP32)
+#define SERVER_XDP_SUPPORT 1
+#else
+#define SERVER_XDP_SUPPORT 0
+#endif
+
+extern logger_handle *g_server_logger;
+#define MODULE_MSG_HANDLE g_server_logger
+
+#if SERVER_XDP_SUPPORT
+
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+#define XDPINTF_TAG 0x46544e4950445853
+#define XDPWRKR_TAG 0x524b525750445853
+
+#define SERVER_XDP_FRAME_SIZE       4096
+#define SERVER_XDP_FRAME_COUNT      2048    // per socket, every ring has this size so none can overflow
+#define SERVER_XDP_BATCH            64
+#define SERVER_XDP_ADDRESS_MAX      16      // per interface
+#define SERVER_XDP_PROGRAM_SIZE     512     // instructions
+#define SERVER_XDP_LABEL_COUNT      (4 + SERVER_XDP_ADDRESS_MAX)
+#define SERVER_XDP_TTL              64
+
+#define SERVER_XDP_IPV4_HEADERS     (sizeof(struct ether_header) + sizeof(struct iphdr) + sizeof(struct udphdr))
+#define SERVER_XDP_IPV6_HEADERS     (sizeof(struct ether_header) + sizeof(struct ip6_hdr) + sizeof(struct udphdr))
+
+struct server_xdp_ring_s
+{
+    u32 *producer;
+    u32 *consumer;
+    void *descs;
+    void *map;
+    size_t map_size;
+    u32 cached;         // the local producer of the fill & tx rings, the local consumer of the rx & completion rings
+};
+
+typedef struct server_xdp_ring_s server_xdp_ring_s;
+
+struct server_xdp_address_s
+{
+    u8 ip[16];
+    u16 port;           // network order
+    u8 version;         // HOST_ADDRESS_IPV4 or HOST_ADDRESS_IPV6
+    int sockfd;         // the regular socket of the address, for the query logs
+};
+
+typedef struct server_xdp_address_s server_xdp_address_s;
+
+struct server_xdp_worker_s;
+
+struct server_xdp_interface_s
+{
+    struct server_xdp_interface_s *next;
+    struct server_xdp_worker_s **workers;
+    server_xdp_address_s address[SERVER_XDP_ADDRESS_MAX];
+    char name[IF_NAMESIZE];
+    int ifindex;
+    int queue_count;
+    int mtu;
+    int node;       // NUMA node of the device, -1 if not known
+    int map_fd;
+    int prog_fd;
+    int link_fd;
+    int address_count;
+};
+
+typedef struct server_xdp_interface_s server_xdp_interface_s;
+
+struct server_xdp_worker_s
+{
+    server_xdp_interface_s *intf;
+    u8 *umem;
+    message_data *mesg;
+    server_xdp_ring_s fill;
+    server_xdp_ring_s comp;
+    server_xdp_ring_s rx;
+    server_xdp_ring_s tx;
+    int fd;
+    u32 queue;
+    u16 idx;
+    volatile bool terminated;
+
+    server_statistics_t statistics __attribute__ ((aligned (64)));
+
+    query_statistics_s *query_statistics;
+};
+
+typedef struct server_xdp_worker_s server_xdp_worker_s;
+
+static server_xdp_interface_s *server_xdp_interfaces = NULL;
+static struct thread_pool_s *server_xdp_thread_pool = NULL;
+static int server_xdp_worker_count = 0;
+static bool server_xdp_context_done = FALSE;
+
+/*
+ * The program
+ */
+
+#define SERVER_XDP_LABEL_PASS       0
+#define SERVER_XDP_LABEL_IPV4       1
+#define SERVER_XDP_LABEL_IPV6       2
+#define SERVER_XDP_LABEL_REDIRECT   3
+#define SERVER_XDP_LABEL_NEXT       4   // + address index
+
+struct server_xdp_program_s
+{
+    struct bpf_insn insn[SERVER_XDP_PROGRAM_SIZE];
+    s32 label[SERVER_XDP_LABEL_COUNT];
+    u16 jump_at[SERVER_XDP_PROGRAM_SIZE];
+    u8 jump_label[SERVER_XDP_PROGRAM_SIZE];
+    u16 count;
+    u16 jump_count;
+};
+
+typedef struct server_xdp_program_s server_xdp_program_s;
+
+static void
+server_xdp_program_emit(server_xdp_program_s *p, u8 code, u8 dst, u8 src, s16 off, s32 imm)
+{
+    struct bpf_insn *insn = &p->insn[p->count++];
+    ZEROMEMORY(insn, sizeof(struct bpf_insn));
+    insn->code = code;
+    insn->dst_reg = dst;
+    insn->src_reg = src;
+    insn->off = off;
+    insn->imm = imm;
+}
+
+static void
+server_xdp_program_jump(server_xdp_program_s *p, u8 code, u8 dst, u8 src, s32 imm, u8 label)
+{
+    p->jump_at[p->jump_count] = p->count;
+    p->jump_label[p->jump_count] = label;
+    ++p->jump_count;
+    server_xdp_program_emit(p, code, dst, src, 0, imm);
+}
+
+static void
+server_xdp_program_label(server_xdp_program_s *p, u8 label)
+{
+    p->label[label] = p->count;
+}
+
+/**
+ * Generates the program of an interface.
+ *
+ * r1: context, r2: packet, r3: end of the packet, r4: bound check, r5: value
+ *
+ * The values are loaded from the packet as they are, so they are compared with values in network order.
+ */
+
+static void
+server_xdp_program_build(server_xdp_program_s *p, const server_xdp_interface_s *intf)
+{
+    ZEROMEMORY(p, sizeof(server_xdp_program_s));
+
+    const s16 ip = sizeof(struct ether_header);
+    const s16 udp4 = ip + sizeof(struct iphdr);
+    const s16 udp6 = ip + sizeof(struct ip6_hdr);
+    const s16 dns4 = udp4 + sizeof(struct udphdr);
+    const s16 dns6 = udp6 + sizeof(struct udphdr);
+
+    server_xdp_program_emit(p, BPF_LDX|BPF_MEM|BPF_W, BPF_REG_2, BPF_REG_1, offsetof(struct xdp_md, data), 0);
+    server_xdp_program_emit(p, BPF_LDX|BPF_MEM|BPF_W, BPF_REG_3, BPF_REG_1, offsetof(struct xdp_md, data_end), 0);
+    server_xdp_program_emit(p, BPF_ALU64|BPF_MOV|BPF_X, BPF_REG_4, BPF_REG_2, 0, 0);
+    server_xdp_program_emit(p, BPF_ALU64|BPF_ADD|BPF_K, BPF_REG_4, 0, 0, ip);
+    server_xdp_program_jump(p, BPF_JMP|BPF_JGT|BPF_X, BPF_REG_4, BPF_REG_3, 0, SERVER_XDP_LABEL_PASS);
+    server_xdp_program_emit(p, BPF_LDX|BPF_MEM|BPF_H, BPF_REG_5, BPF_REG_2, offsetof(struct ether_header, ether_type), 0);
+    server_xdp_program_jump(p, BPF_JMP32|BPF_JEQ|BPF_K, BPF_REG_5, 0, htons(ETHERTYPE_IP), SERVER_XDP_LABEL_IPV4);
+    server_xdp_program_jump(p, BPF_JMP32|BPF_JEQ|BPF_K, BPF_REG_5, 0, htons(ETHERTYPE_IPV6), SERVER_XDP_LABEL_IPV6);
+    server_xdp_program_jump(p, BPF_JMP|BPF_JA, 0, 0, 0, SERVER_XDP_LABEL_PASS);
+
+    // IPv4 without options nor fragmentation
+
+    server_xdp_program_label(p, SERVER_XDP_LABEL_IPV4);
+    server_xdp_program_emit(p, BPF_ALU64|BPF_MOV|BPF_X, BPF_REG_4, BPF_REG_2, 0, 0);
+    server_xdp_program_emit(p, BPF_ALU64|BPF_ADD|BPF_K, BPF_REG_4, 0, 0, dns4 + DNS_HEADER_LENGTH);
+    server_xdp_program_jump(p, BPF_JMP|BPF_JGT|BPF_X, BPF_REG_4, BPF_REG_3, 0, SERVER_XDP_LABEL_PASS);
+    server_xdp_program_emit(p, BPF_LDX|BPF_MEM|BPF_B, BPF_REG_5, BPF_REG_2, ip, 0);
+    server_xdp_program_jump(p, BPF_JMP32|BPF_JNE|BPF_K, BPF_REG_5, 0, 0x45, SERVER_XDP_LABEL_PASS);
+    server_xdp_program_emit(p, BPF_LDX|BPF_MEM|BPF_B, BPF_REG_5, BPF_REG_2, ip + offsetof(struct iphdr, protocol), 0);
+    server_xdp_program_jump(p, BPF_JMP32|BPF_JNE|BPF_K, BPF_REG_5, 0, IPPROTO_UDP, SERVER_XDP_LABEL_PASS);
+    server_xdp_program_emit(p, BPF_LDX|BPF_MEM|BPF_H, BPF_REG_5, BPF_REG_2, ip + offsetof(struct iphdr, frag_off), 0);
+    server_xdp_program_emit(p, BPF_ALU|BPF_AND|BPF_K, BPF_REG_5, 0, 0, htons(IP_MF|IP_OFFMASK));
+    server_xdp_program_jump(p, BPF_JMP32|BPF_JNE|BPF_K, BPF_REG_5, 0, 0, SERVER_XDP_LABEL_PASS);
+
+    for(int i = 0; i < intf->address_count; ++i)
+    {
+        const server_xdp_address_s *a = &intf->address[i];
+
+        if(a->version != HOST_ADDRESS_IPV4)
+        {
+            continue;
+        }
+
+        s32 v;
+        memcpy(&v, a->ip, 4);
+        server_xdp_program_emit(p, BPF_LDX|BPF_MEM|BPF_W, BPF_REG_5, BPF_REG_2, ip + offsetof(struct iphdr, daddr), 0);
+        server_xdp_program_jump(p, BPF_JMP32|BPF_JNE|BPF_K, BPF_REG_5, 0, v, SERVER_XDP_LABEL_NEXT + i);
+        server_xdp_program_emit(p, BPF_LDX|BPF_MEM|BPF_H, BPF_REG_5, BPF_REG_2, udp4 + offsetof(struct udphdr, dest), 0);
+        server_xdp_program_jump(p, BPF_JMP32|BPF_JNE|BPF_K, BPF_REG_5, 0, a->port, SERVER_XDP_LABEL_NEXT + i);
+        server_xdp_program_emit(p, BPF_LDX|BPF_MEM|BPF_B, BPF_REG_5, BPF_REG_2, dns4 + 2, 0);
+        server_xdp_program_jump(p, BPF_JMP|BPF_JA, 0, 0, 0, SERVER_XDP_LABEL_REDIRECT);
+        server_xdp_program_label(p, SERVER_XDP_LABEL_NEXT + i);
+    }
+
+    server_xdp_program_jump(p, BPF_JMP|BPF_JA, 0, 0, 0, SERVER_XDP_LABEL_PASS);
+
+    // IPv6 followed by UDP
+
+    server_xdp_program_label(p, SERVER_XDP_LABEL_IPV6);
+    server_xdp_program_emit(p, BPF_ALU64|BPF_MOV|BPF_X, BPF_REG_4, BPF_REG_2, 0, 0);
+    server_xdp_program_emit(p, BPF_ALU64|BPF_ADD|BPF_K, BPF_REG_4, 0, 0, dns6 + DNS_HEADER_LENGTH);
+    server_xdp_program_jump(p, BPF_JMP|BPF_JGT|BPF_X, BPF_REG_4, BPF_REG_3, 0, SERVER_XDP_LABEL_PASS);
+    server_xdp_program_emit(p, BPF_LDX|BPF_MEM|BPF_B, BPF_REG_5, BPF_REG_2, ip + offsetof(struct ip6_hdr, ip6_nxt), 0);
+    server_xdp_program_jump(p, BPF_JMP32|BPF_JNE|BPF_K, BPF_REG_5, 0, IPPROTO_UDP, SERVER_XDP_LABEL_PASS);
+
+    for(int i = 0; i < intf->address_count; ++i)
+    {
+        const server_xdp_address_s *a = &intf->address[i];
+
+        if(a->version != HOST_ADDRESS_IPV6)
+        {
+            continue;
+        }
+
+        for(int j = 0; j < 16; j += 4)
+        {
+            s32 v;
+            memcpy(&v, &a->ip[j], 4);
+            server_xdp_program_emit(p, BPF_LDX|BPF_MEM|BPF_W, BPF_REG_5, BPF_REG_2, ip + offsetof(struct ip6_hdr, ip6_dst) + j, 0);
+            server_xdp_program_jump(p, BPF_JMP32|BPF_JNE|BPF_K, BPF_REG_5, 0, v, SERVER_XDP_LABEL_NEXT + i);
+        }
+
+        server_xdp_program_emit(p, BPF_LDX|BPF_MEM|BPF_H, BPF_REG_5, BPF_REG_2, udp6 + offsetof(struct udphdr, dest), 0);
+        server_xdp_program_jump(p, BPF_JMP32|BPF_JNE|BPF_K, BPF_REG_5, 0, a->port, SERVER_XDP_LABEL_NEXT + i);
+        server_xdp_program_emit(p, BPF_LDX|BPF_MEM|BPF_B, BPF_REG_5, BPF_REG_2, dns6 + 2, 0);
+        server_xdp_program_jump(p, BPF_JMP|BPF_JA, 0, 0, 0, SERVER_XDP_LABEL_REDIRECT);
+        server_xdp_program_label(p, SERVER_XDP_LABEL_NEXT + i);
+    }
+
+    server_xdp_program_jump(p, BPF_JMP|BPF_JA, 0, 0, 0, SERVER_XDP_LABEL_PASS);
+
+    // r5 is the byte of the QR bit and of the opcode: only queries are taken
+
+    server_xdp_program_label(p, SERVER_XDP_LABEL_REDIRECT);
+    server_xdp_program_emit(p, BPF_ALU|BPF_AND|BPF_K, BPF_REG_5, 0, 0, 0xf8);
+    server_xdp_program_jump(p, BPF_JMP32|BPF_JNE|BPF_K, BPF_REG_5, 0, 0, SERVER_XDP_LABEL_PASS);
+    server_xdp_program_emit(p, BPF_LDX|BPF_MEM|BPF_W, BPF_REG_2, BPF_REG_1, offsetof(struct xdp_md, rx_queue_index), 0);
+    server_xdp_program_emit(p, BPF_LD|BPF_DW|BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, intf->map_fd);
+    server_xdp_program_emit(p, 0, 0, 0, 0, 0);
+    server_xdp_program_emit(p, BPF_ALU64|BPF_MOV|BPF_K, BPF_REG_3, 0, 0, XDP_PASS); // if there is no socket for the queue
+    server_xdp_program_emit(p, BPF_JMP|BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map);
+    server_xdp_program_emit(p, BPF_JMP|BPF_EXIT, 0, 0, 0, 0);
+
+    server_xdp_program_label(p, SERVER_XDP_LABEL_PASS);
+    server_xdp_program_emit(p, BPF_ALU64|BPF_MOV|BPF_K, BPF_REG_0, 0, 0, XDP_PASS);
+    server_xdp_program_emit(p, BPF_JMP|BPF_EXIT, 0, 0, 0, 0);
+
+    for(int i = 0; i < p->jump_count; ++i)
+    {
+        p->insn[p->jump_at[i]].off = p->label[p->jump_label[i]] - p->jump_at[i] - 1;
+    }
+}
+
+static int
+server_xdp_bpf(int cmd, union bpf_attr *attr)
+{
+    return syscall(__NR_bpf, cmd, attr, sizeof(union bpf_attr));
+}
+
+static ya_result
+server_xdp_program_load(server_xdp_interface_s *intf)
+{
+    union bpf_attr attr;
+    ZEROMEMORY(&attr, sizeof(attr));
+    attr.map_type = BPF_MAP_TYPE_XSKMAP;
+    attr.key_size = sizeof(u32);
+    attr.value_size = sizeof(u32);
+    attr.max_entries = intf->queue_count;
+    strcpy(attr.map_name, "yadifad_xsk");
+
+    if((intf->map_fd = server_xdp_bpf(BPF_MAP_CREATE, &attr)) < 0)
+    {
+        ya_result ret = ERRNO_ERROR;
+        log_err("server-xdp: %s: could not create the socket map: %r", intf->name, ret);
+        return ret;
+    }
+
+    server_xdp_program_s *p;
+    MALLOC_OR_DIE(server_xdp_program_s*, p, sizeof(server_xdp_program_s), XDPINTF_TAG);
+    server_xdp_program_build(p, intf);
+
+    ZEROMEMORY(&attr, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.expected_attach_type = BPF_XDP;
+    attr.insns = (u64)(intptr)p->insn;
+    attr.insn_cnt = p->count;
+    attr.license = (u64)(intptr)"Dual BSD/GPL";
+    strcpy(attr.prog_name, "yadifad_xdp");
+
+    if((intf->prog_fd = server_xdp_bpf(BPF_PROG_LOAD, &attr)) < 0)
+    {
+        ya_result ret = ERRNO_ERROR;
+
+        // load it again, for the verifier to tell what is wrong
+
+        char *verifier_log;
+        MALLOC_OR_DIE(char*, verifier_log, 65536, XDPINTF_TAG);
+        verifier_log[0] = '\0';
+        attr.log_buf = (u64)(intptr)verifier_log;
+        attr.log_size = 65536;
+        attr.log_level = 1;
+        server_xdp_bpf(BPF_PROG_LOAD, &attr);
+
+        log_err("server-xdp: %s: could not load the program: %r: %s", intf->name, ret, verifier_log);
+
+        free(verifier_log);
+        free(p);
+        return ret;
+    }
+
+    free(p);
+
+    return SUCCESS;
+}
+
+static ya_result
+server_xdp_program_attach(server_xdp_interface_s *intf)
+{
+    union bpf_attr attr;
+    ZEROMEMORY(&attr, sizeof(attr));
+    attr.link_create.prog_fd = intf->prog_fd;
+    attr.link_create.target_ifindex = intf->ifindex;
+    attr.link_create.attach_type = BPF_XDP;
+    attr.link_create.flags = XDP_FLAGS_SKB_MODE;
+
+    if((intf->link_fd = server_xdp_bpf(BPF_LINK_CREATE, &attr)) < 0)
+    {
+        ya_result ret = ERRNO_ERROR;
+        log_err("server-xdp: %s: could not attach the program: %r", intf->name, ret);
+        return ret;
+    }
+
+    return SUCCESS;
+}
+
+/*
+ * The sockets
+ */
+
+static ya_result
+server_xdp_ring_map(server_xdp_ring_s *ring, int fd, const struct xdp_ring_offset *off, size_t desc_size, off_t pgoff, bool producer)
+{
+    ring->map_size = off->desc + SERVER_XDP_FRAME_COUNT * desc_size;
+    ring->map = mmap(NULL, ring->map_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, pgoff);
+
+    if(ring->map == MAP_FAILED)
+    {
+        ring->map = NULL;
+        return ERRNO_ERROR;
+    }
+
+    u8 *base = (u8*)ring->map;
+    ring->producer = (u32*)&base[off->producer];
+    ring->consumer = (u32*)&base[off->consumer];
+    ring->descs = &base[off->desc];
+    ring->cached = (producer)?*ring->producer:*ring->consumer;
+
+    return SUCCESS;
+}
+
+static void
+server_xdp_ring_unmap(server_xdp_ring_s *ring)
+{
+    if(ring->map != NULL)
+    {
+        munmap(ring->map, ring->map_size);
+        ring->map = NULL;
+    }
+}
+
+/*
+ * The rings are as large as the UMEM: they cannot overflow.
+ */
+
+static inline void
+server_xdp_fill_push(server_xdp_worker_s *w, u64 addr)
+{
+    ((u64*)w->fill.descs)[w->fill.cached++ & (SERVER_XDP_FRAME_COUNT - 1)] = addr & ~(u64)(SERVER_XDP_FRAME_SIZE - 1);
+}
+
+static inline void
+server_xdp_ring_submit(server_xdp_ring_s *ring)
+{
+    __atomic_store_n(ring->producer, ring->cached, __ATOMIC_RELEASE);
+}
+
+static inline u32
+server_xdp_ring_available(server_xdp_ring_s *ring)
+{
+    return __atomic_load_n(ring->producer, __ATOMIC_ACQUIRE) - ring->cached;
+}
+
+static inline void
+server_xdp_ring_release(server_xdp_ring_s *ring)
+{
+    __atomic_store_n(ring->consumer, ring->cached, __ATOMIC_RELEASE);
+}
+
+static ya_result
+server_xdp_worker_init(server_xdp_worker_s *w)
+{
+    ya_result ret;
+    server_xdp_interface_s *intf = w->intf;
+
+    if(sys_numa_node_count() == 1)
+    {
+        w->umem = (u8*)mmap(NULL, SERVER_XDP_FRAME_COUNT * SERVER_XDP_FRAME_SIZE, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_POPULATE, -1, 0);
+
+        if(w->umem == MAP_FAILED)
+        {
+            w->umem = NULL;
+            return ERRNO_ERROR;
+        }
+    }
+    else
+    {
+        // the frames are written by the device: on its node (the registration faults the pages in)
+
+        if((w->umem = (u8*)sys_numa_alloc(SERVER_XDP_FRAME_COUNT * SERVER_XDP_FRAME_SIZE, intf->node)) == NULL)
+        {
+            return ERRNO_ERROR;
+        }
+    }
+
+    if((w->fd = socket(AF_XDP, SOCK_RAW, 0)) < 0)
+    {
+        return ERRNO_ERROR;
+    }
+
+    struct xdp_umem_reg reg;
+    ZEROMEMORY(&reg, sizeof(reg));
+    reg.addr = (u64)(intptr)w->umem;
+    reg.len = SERVER_XDP_FRAME_COUNT * SERVER_XDP_FRAME_SIZE;
+    reg.chunk_size = SERVER_XDP_FRAME_SIZE;
+
+    int ring_size = SERVER_XDP_FRAME_COUNT;
+
+    if((setsockopt(w->fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) < 0) ||
+       (setsockopt(w->fd, SOL_XDP, XDP_UMEM_FILL_RING, &ring_size, sizeof(ring_size)) < 0) ||
+       (setsockopt(w->fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &ring_size, sizeof(ring_size)) < 0) ||
+       (setsockopt(w->fd, SOL_XDP, XDP_RX_RING, &ring_size, sizeof(ring_size)) < 0) ||
+       (setsockopt(w->fd, SOL_XDP, XDP_TX_RING, &ring_size, sizeof(ring_size)) < 0))
+    {
+        return ERRNO_ERROR;
+    }
+
+    struct xdp_mmap_offsets off;
+    socklen_t off_len = sizeof(off);
+
+    if(getsockopt(w->fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &off_len) < 0)
+    {
+        return ERRNO_ERROR;
+    }
+
+    if(FAIL(ret = server_xdp_ring_map(&w->fill, w->fd, &off.fr, sizeof(u64), XDP_UMEM_PGOFF_FILL_RING, TRUE)) ||
+       FAIL(ret = server_xdp_ring_map(&w->comp, w->fd, &off.cr, sizeof(u64), XDP_UMEM_PGOFF_COMPLETION_RING, FALSE)) ||
+       FAIL(ret = server_xdp_ring_map(&w->rx, w->fd, &off.rx, sizeof(struct xdp_desc), XDP_PGOFF_RX_RING, FALSE)) ||
+       FAIL(ret = server_xdp_ring_map(&w->tx, w->fd, &off.tx, sizeof(struct xdp_desc), XDP_PGOFF_TX_RING, TRUE)))
+    {
+        return ret;
+    }
+
+    for(u32 i = 0; i < SERVER_XDP_FRAME_COUNT; ++i)
+    {
+        server_xdp_fill_push(w, i * SERVER_XDP_FRAME_SIZE);
+    }
+
+    server_xdp_ring_submit(&w->fill);
+
+    struct sockaddr_xdp sxdp;
+    ZEROMEMORY(&sxdp, sizeof(sxdp));
+    sxdp.sxdp_family = AF_XDP;
+    sxdp.sxdp_ifindex = intf->ifindex;
+    sxdp.sxdp_queue_id = w->queue;
+    sxdp.sxdp_flags = XDP_COPY;
+
+    if(bind(w->fd, (struct sockaddr*)&sxdp, sizeof(sxdp)) < 0)
+    {
+        return ERRNO_ERROR;
+    }
+
+    union bpf_attr attr;
+    ZEROMEMORY(&attr, sizeof(attr));
+    attr.map_fd = intf->map_fd;
+    attr.key = (u64)(intptr)&w->queue;
+    attr.value = (u64)(intptr)&w->fd;
+
+    if(server_xdp_bpf(BPF_MAP_UPDATE_ELEM, &attr) < 0)
+    {
+        return ERRNO_ERROR;
+    }
+
+    // the message is taken by the thread, from the pool of its node
+
+    return SUCCESS;
+}
+
+static void
+server_xdp_worker_finalize(server_xdp_worker_s *w)
+{
+    server_xdp_ring_unmap(&w->tx);
+    server_xdp_ring_unmap(&w->rx);
+    server_xdp_ring_unmap(&w->comp);
+    server_xdp_ring_unmap(&w->fill);
+
+    if(w->fd >= 0)
+    {
+        close_ex(w->fd);
+        w->fd = -1;
+    }
+
+    if(w->umem != NULL)
+    {
+        munmap(w->umem, SERVER_XDP_FRAME_COUNT * SERVER_XDP_FRAME_SIZE);
+        w->umem = NULL;
+    }
+
+    if(w->mesg != NULL)
+    {
+        message_free(w->mesg);
+        w->mesg = NULL;
+    }
+}
+
+/*
+ * The queries
+ */
+
+/**
+ * Processes a query.
+ *
+ * @return TRUE iff an answer has to be sent back
+ */
+
+static bool
+server_xdp_process_query(zdb *database, server_xdp_worker_s *w, message_data *mesg, int sockfd)
+{
+    server_statistics_t * const local_statistics = &w->statistics;
+    query_statistics_s * const local_query_statistics = w->query_statistics;
+    ya_result return_code;
+
+    local_statistics->udp_input_count++;
+
+    if(ISOK(return_code = message_process_query(mesg)))
+    {
+        message_edns0_clear_undefined_flags(mesg);
+        
+        switch(mesg->qclass)
+        {
+            case CLASS_IN:
+            {
+                local_statistics->udp_queries_count++;
+
+                log_query(sockfd, mesg);
+                
+                query_statistics_qtype_count(local_query_statistics, mesg->qtype);
+
+                switch(mesg->qtype)
+                {
+                    default:
+                    {
+                        u64 lookup_ns = timens_monotonic();
+#if HAS_RRL_SUPPORT
+                        ya_result rrl = database_query_with_rrl(database, mesg);
+                        
+                        histogram_record(&local_query_statistics->stage[QUERY_STATISTICS_LOOKUP], timens_monotonic() - lookup_ns);
+
+                        local_statistics->udp_referrals_count += mesg->referral;
+                        local_statistics->udp_fp[mesg->status]++;                                
+
+                        switch(rrl)
+                        {
+                            case RRL_SLIP:
+                            {
+                                local_statistics->rrl_slip++;
+                                break;
+                            }
+                            case RRL_DROP:
+                            {
+                                local_statistics->rrl_drop++;
+                                return FALSE;
+                            }
+                            case RRL_PROCEED_DROP:
+                            {
+                                local_statistics->rrl_drop++;
+                                break;
+                            }
+                        }
+#else
+                        database_query(database, mesg);
+                        
+                        histogram_record(&local_query_statistics->stage[QUERY_STATISTICS_LOOKUP], timens_monotonic() - lookup_ns);
+
+                        local_statistics->udp_referrals_count += mesg->referral;
+                        local_statistics->udp_fp[mesg->status]++;
+#endif
+                        break;
+                    }
+                    case TYPE_IXFR:
+                    {
+                        MESSAGE_FLAGS_OR(mesg->buffer, QR_BITS|TC_BITS, 0); /** @todo 20120619 edf -- IXFR UDP */
+                        SET_U32_AT(mesg->buffer[4], 0);
+                        SET_U32_AT(mesg->buffer[8], 0);
+                        mesg->send_length = DNS_HEADER_LENGTH;
+                        local_statistics->udp_fp[FP_IXFR_UDP]++;
+                        break;
+                    }
+                    case TYPE_AXFR:
+                    case TYPE_OPT:
+                    {
+                        message_make_error(mesg, FP_INCORR_PROTO);
+                        local_statistics->udp_fp[FP_INCORR_PROTO]++;
+                        break;
+                    }
+                } // switch query type
+                
+                break;
+            } // query class IN
+            case CLASS_CH:
+            {
+                class_ch_process(mesg); // thread-safe
+                local_statistics->udp_fp[mesg->status]++;
+                break;
+            } // query class CH
+            default:
+            {
+                /// @todo 20140521 edf -- verify unsupported class error handling
+                /*
+                FP_CLASS_NOTFOUND
+                log_warn("query [%04hx] %{dnsname} %{dnstype} %{dnsclass} (%{sockaddrip}) : unsupported class",
+                        ntohs(MESSAGE_ID(mesg->buffer)),
+                        mesg->qname, &mesg->qtype, &mesg->qclass,
+                        &mesg->other.sa);
+                */
+                /*
+                log_warn("query [%04hx] %{dnsname} %{dnstype} %{dnsclass} (%{sockaddrip}) : unsupported operation",
+                        ntohs(MESSAGE_ID(mesg->buffer)),
+                        mesg->qname, &mesg->qtype, &mesg->qclass,
+                        &mesg->other.sa);
+                */
+                message_make_error(mesg, FP_NOT_SUPP_CLASS);
+                local_statistics->udp_fp[FP_NOT_SUPP_CLASS]++;
+                break;
+            }
+        } // query class
+    } // if message process succeeded
+    else // an error occurred : no query to be done at all
+    {
+#ifdef DEBUG
+        return_code = message_process_query(mesg);
+#endif
+        
+        log_warn("query (%04hx) [%02x|%02x] error %i (%r) (%{sockaddrip})",
+                 ntohs(MESSAGE_ID(mesg->buffer)),
+                 MESSAGE_HIFLAGS(mesg->buffer),MESSAGE_LOFLAGS(mesg->buffer),
+                 mesg->status,
+                 return_code,
+                 &mesg->other.sa);
+        
+        local_statistics->udp_fp[mesg->status]++;
+        
+#ifdef DEBUG
+        if(return_code == UNPROCESSABLE_MESSAGE && (g_config->server_flags & SERVER_FL_LOG_UNPROCESSABLE))
+        {
+            log_memdump_ex(MODULE_MSG_HANDLE, MSG_DEBUG, mesg->buffer, mesg->received, 16, OSPRINT_DUMP_ALL);
+        }
+#endif
+        /*
+         * If not FE, or if we answer FE
+         * 
+         * ... && (MESSAGE_QR(mesg->buffer) == 0 ??? and if there the query number is > 0 ???
+         */
+        if( (return_code != INVALID_MESSAGE) && ((mesg->status != RCODE_FORMERR) || ((g_config->server_flags & SERVER_FL_ANSWER_FORMERR) != 0)))
+        {
+            message_edns0_clear_undefined_flags(mesg);
+            
+            if(!MESSAGEP_HAS_TSIG(mesg))
+            {
+                message_transform_to_error(mesg);
+            }
+        }
+        else
+        {
+            local_statistics->udp_dropped_count++;
+            return FALSE;
+        }
+    }
+    
+
+#if !HAS_DROPALL_SUPPORT
+    return TRUE;
+#else
+    log_debug("server_xdp_process_query: drop all");
+    return FALSE;
+#endif
+}
+
+/**
+ * Keeps the header and the question of an answer that would not fit, with the TC bit set.
+ */
+
+static void
+server_xdp_truncate(message_data *mesg)
+{
+    u32 len = DNS_HEADER_LENGTH;
+
+    if(MESSAGE_QD(mesg->buffer) != 0)
+    {
+        len += dnsname_len(&mesg->buffer[DNS_HEADER_LENGTH]) + 4;
+        SET_U16_AT(mesg->buffer[4], htons(1));
+    }
+
+    MESSAGE_FLAGS_OR(mesg->buffer, TC_BITS, 0);
+    SET_U16_AT(mesg->buffer[6], 0);
+    SET_U32_AT(mesg->buffer[8], 0);
+    mesg->send_length = len;
+}
+
+static u32
+server_xdp_checksum_add(u32 sum, const u8 *p, u32 len)
+{
+    while(len > 1)
+    {
+        sum += ((u32)p[0] << 8) | p[1];
+        p += 2;
+        len -= 2;
+    }
+
+    if(len > 0)
+    {
+        sum += (u32)p[0] << 8;
+    }
+
+    return sum;
+}
+
+static u16
+server_xdp_checksum_fold(u32 sum)
+{
+    while((sum >> 16) != 0)
+    {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+
+    return htons(~sum & 0xffff);
+}
+
+static void
+server_xdp_swap(u8 *a, u8 *b, u32 len)
+{
+    u8 tmp[16];
+    memcpy(tmp, a, len);
+    memcpy(a, b, len);
+    memcpy(b, tmp, len);
+}
+
+/**
+ * Answers the query in a frame, in place.
+ *
+ * @param room the bytes available in the frame
+ *
+ * @return the size of the answer frame, 0 if there is nothing to send
+ */
+
+static u32
+server_xdp_answer(zdb *database, server_xdp_worker_s *w, u8 *frame, u32 frame_len, u32 room)
+{
+    const server_xdp_interface_s *intf = w->intf;
+    message_data *mesg = w->mesg;
+    struct ether_header *eth = (struct ether_header*)frame;
+    struct udphdr *udp;
+    u32 headers_len;
+    const u8 *dst;
+    int version;
+
+    if(eth->ether_type == htons(ETHERTYPE_IP))
+    {
+        struct iphdr *ip4 = (struct iphdr*)&frame[sizeof(struct ether_header)];
+        udp = (struct udphdr*)&ip4[1];
+        headers_len = SERVER_XDP_IPV4_HEADERS;
+        dst = (const u8*)&ip4->daddr;
+        version = HOST_ADDRESS_IPV4;
+
+        struct sockaddr_in *sa4 = &mesg->other.sa4;
+        sa4->sin_family = AF_INET;
+        sa4->sin_port = udp->source;
+        memcpy(&sa4->sin_addr, &ip4->saddr, 4);
+        mesg->addr_len = sizeof(struct sockaddr_in);
+    }
+    else
+    {
+        struct ip6_hdr *ip6 = (struct ip6_hdr*)&frame[sizeof(struct ether_header)];
+        udp = (struct udphdr*)&ip6[1];
+        headers_len = SERVER_XDP_IPV6_HEADERS;
+        dst = (const u8*)&ip6->ip6_dst;
+        version = HOST_ADDRESS_IPV6;
+
+        struct sockaddr_in6 *sa6 = &mesg->other.sa6;
+        ZEROMEMORY(sa6, sizeof(struct sockaddr_in6));
+        sa6->sin6_family = AF_INET6;
+        sa6->sin6_port = udp->source;
+        memcpy(&sa6->sin6_addr, &ip6->ip6_src, 16);
+        mesg->addr_len = sizeof(struct sockaddr_in6);
+    }
+
+    u32 payload_len = ntohs(udp->len) - sizeof(struct udphdr);
+
+    if((ntohs(udp->len) < sizeof(struct udphdr) + DNS_HEADER_LENGTH) || (headers_len + payload_len > frame_len))
+    {
+        w->statistics.udp_input_count++;
+        w->statistics.udp_dropped_count++;
+        return 0;
+    }
+
+    int sockfd = -1;
+
+    for(int i = 0; i < intf->address_count; ++i)
+    {
+        if((intf->address[i].version == version) && (memcmp(intf->address[i].ip, dst, (version == HOST_ADDRESS_IPV4)?4:16) == 0))
+        {
+            sockfd = intf->address[i].sockfd;
+            break;
+        }
+    }
+
+    memcpy(mesg->buffer, &frame[headers_len], payload_len);
+    mesg->received = payload_len;
+    mesg->size_limit = UDPPACKET_MAX_LENGTH;
+    mesg->sockfd = sockfd;
+
+    if(!server_xdp_process_query(database, w, mesg, sockfd))
+    {
+        return 0;
+    }
+
+    u32 payload_max = MIN((u32)intf->mtu + sizeof(struct ether_header), room) - headers_len;
+
+    if(mesg->send_length > payload_max)
+    {
+        server_xdp_truncate(mesg);
+    }
+
+    u32 udp_len = sizeof(struct udphdr) + mesg->send_length;
+
+    server_xdp_swap(eth->ether_dhost, eth->ether_shost, ETH_ALEN);
+    server_xdp_swap((u8*)&udp->source, (u8*)&udp->dest, 2);
+    udp->len = htons(udp_len);
+    udp->check = 0;
+    memcpy(&frame[headers_len], mesg->buffer, mesg->send_length);
+
+    if(version == HOST_ADDRESS_IPV4)
+    {
+        struct iphdr *ip4 = (struct iphdr*)&frame[sizeof(struct ether_header)];
+        server_xdp_swap((u8*)&ip4->saddr, (u8*)&ip4->daddr, 4);
+        ip4->tot_len = htons(sizeof(struct iphdr) + udp_len);
+        ip4->id = 0;
+        ip4->frag_off = htons(IP_DF);
+        ip4->ttl = SERVER_XDP_TTL;
+        ip4->check = 0;
+        ip4->check = server_xdp_checksum_fold(server_xdp_checksum_add(0, (const u8*)ip4, sizeof(struct iphdr)));
+        // the UDP checksum is optional with IPv4
+    }
+    else
+    {
+        struct ip6_hdr *ip6 = (struct ip6_hdr*)&frame[sizeof(struct ether_header)];
+        server_xdp_swap((u8*)&ip6->ip6_src, (u8*)&ip6->ip6_dst, 16);
+        ip6->ip6_plen = htons(udp_len);
+        ip6->ip6_hlim = SERVER_XDP_TTL;
+
+        // pseudo-header then UDP
+
+        u32 sum = server_xdp_checksum_add(0, (const u8*)&ip6->ip6_src, 32);
+        sum += udp_len + IPPROTO_UDP;
+        sum = server_xdp_checksum_add(sum, (const u8*)udp, udp_len);
+        u16 check = server_xdp_checksum_fold(sum);
+        udp->check = (check != 0)?check:0xffff;
+    }
+
+    w->statistics.udp_output_size_total += mesg->send_length;
+
+    return headers_len + mesg->send_length;
+}
+
+static inline u32
+server_xdp_tx_pending(server_xdp_worker_s *w)
+{
+    return w->tx.cached - __atomic_load_n(w->tx.consumer, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * In copy mode, the transmission has to be kicked and a kick sends at most 32 descriptors,
+ * failing with EAGAIN while more are waiting: kicks until the kernel stops consuming the tx ring.
+ */
+
+static void
+server_xdp_kick(server_xdp_worker_s *w)
+{
+    u32 consumer = __atomic_load_n(w->tx.consumer, __ATOMIC_ACQUIRE);
+
+    while(consumer != w->tx.cached)
+    {
+        if(sendto(w->fd, NULL, 0, MSG_DONTWAIT, NULL, 0) < 0)
+        {
+            int err = errno;
+
+            if((err != EAGAIN) && (err != EBUSY) && (err != ENOBUFS) && (err != EINTR))
+            {
+                log_err("server-xdp: %s queue %u: send failed: %r", w->intf->name, w->queue, MAKE_ERRNO_ERROR(err));
+                break;
+            }
+        }
+
+        u32 previous = consumer;
+        consumer = __atomic_load_n(w->tx.consumer, __ATOMIC_ACQUIRE);
+
+        if(consumer == previous)
+        {
+            break; // busy, or sending asynchronously in zero-copy mode
+        }
+    }
+}
+
+static void*
+server_xdp_thread(void *parms)
+{
+    server_xdp_worker_s *w = (server_xdp_worker_s*)parms;
+    zdb *database = g_config->database;
+    u64 answer_recv_ns[SERVER_XDP_BATCH];
+
+    w->query_statistics = query_statistics_get();
+
+#if HAS_PTHREAD_SETAFFINITY_NP
+    cpu_set_t mycpu;
+    CPU_ZERO(&mycpu);
+
+    // after the CPUs of the UDP threads
+
+    int affinity_with = server_worker_cpu(server_context.udp_socket_count + w->idx, w->intf->node) % sys_get_cpu_count();
+    log_info("server-xdp: setting affinity with virtual cpu %i", affinity_with);
+    CPU_SET(affinity_with, &mycpu);
+
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &mycpu);
+#endif
+
+    server_statistics_set_node(&w->statistics, w->intf->node);
+
+    w->mesg = message_new_instance();
+    ZEROMEMORY(w->mesg, offsetof(message_data, qname));
+    w->mesg->protocol = IPPROTO_UDP;
+    w->mesg->process_flags = ~0;
+
+    struct pollfd pfd;
+    pfd.fd = w->fd;
+    pfd.events = POLLIN;
+
+    log_debug("server-xdp: reading on %s queue %u", w->intf->name, w->queue);
+
+    while(program_mode != SA_SHUTDOWN)
+    {
+        // the frames that have been sent can receive again
+
+        u32 n = server_xdp_ring_available(&w->comp);
+
+        if(n > 0)
+        {
+            for(u32 i = 0; i < n; ++i)
+            {
+                server_xdp_fill_push(w, ((u64*)w->comp.descs)[w->comp.cached++ & (SERVER_XDP_FRAME_COUNT - 1)]);
+            }
+
+            server_xdp_ring_release(&w->comp);
+            server_xdp_ring_submit(&w->fill);
+        }
+
+        if((n = server_xdp_ring_available(&w->rx)) == 0)
+        {
+            // the answers the kernel did not take yet are kicked again as soon as the tx ring has room
+
+            pfd.events = (server_xdp_tx_pending(w) > 0)?(POLLIN|POLLOUT):POLLIN;
+            pfd.revents = 0;
+            poll(&pfd, 1, 1000);
+
+            if((pfd.revents & POLLOUT) != 0)
+            {
+                server_xdp_kick(w);
+            }
+
+            continue;
+        }
+
+        if(n > SERVER_XDP_BATCH)
+        {
+            n = SERVER_XDP_BATCH;
+        }
+
+        w->statistics.input_loop_count++;
+
+        u64 recv_ns = timens_monotonic();
+        u32 answers = 0;
+
+        for(u32 i = 0; i < n; ++i)
+        {
+            const struct xdp_desc *desc = &((struct xdp_desc*)w->rx.descs)[w->rx.cached++ & (SERVER_XDP_FRAME_COUNT - 1)];
+            u64 addr = desc->addr;
+            u32 room = SERVER_XDP_FRAME_SIZE - (addr & (SERVER_XDP_FRAME_SIZE - 1));
+            u32 len = server_xdp_answer(database, w, &w->umem[addr], desc->len, room);
+
+            if(len > 0)
+            {
+                struct xdp_desc *answer = &((struct xdp_desc*)w->tx.descs)[w->tx.cached++ & (SERVER_XDP_FRAME_COUNT - 1)];
+                answer->addr = addr;
+                answer->len = len;
+                answer->options = 0;
+                answer_recv_ns[answers++] = recv_ns;
+            }
+            else
+            {
+                server_xdp_fill_push(w, addr);
+            }
+        }
+
+        server_xdp_ring_release(&w->rx);
+        server_xdp_ring_submit(&w->fill);
+
+        if(answers > 0)
+        {
+            server_xdp_ring_submit(&w->tx);
+
+            u64 send_ns = timens_monotonic();
+
+            server_xdp_kick(w);
+
+            u64 sent_ns = timens_monotonic();
+
+            histogram_record(&w->query_statistics->stage[QUERY_STATISTICS_SEND], sent_ns - send_ns);
+
+            for(u32 i = 0; i < answers; ++i)
+            {
+                histogram_record(&w->query_statistics->stage[QUERY_STATISTICS_LATENCY], sent_ns - answer_recv_ns[i]);
+            }
+        }
+        else if(server_xdp_tx_pending(w) > 0)
+        {
+            server_xdp_kick(w); // the answers of the previous batches
+        }
+    }
+
+    log_debug("server-xdp: stop reading on %s queue %u", w->intf->name, w->queue);
+
+    w->terminated = TRUE;
+
+    return NULL;
+}
+
+/*
+ * The set-up
+ */
+
+static int
+server_xdp_interface_queue_count(const char *name)
+{
+    char path[PATH_MAX];
+    snformat(path, sizeof(path), "/sys/class/net/%s/queues", name);
+
+    DIR *dir = opendir(path);
+
+    if(dir == NULL)
+    {
+        return 1;
+    }
+
+    int count = 0;
+    struct dirent *entry;
+
+    while((entry = readdir(dir)) != NULL)
+    {
+        if(memcmp(entry->d_name, "rx-", 3) == 0)
+        {
+            ++count;
+        }
+    }
+
+    closedir(dir);
+
+    return MAX(count, 1);
+}
+
+static int
+server_xdp_interface_mtu(const char *name)
+{
+    struct ifreq ifr;
+    ZEROMEMORY(&ifr, sizeof(ifr));
+    memcpy(ifr.ifr_name, name, IF_NAMESIZE);
+
+    int mtu = 1500;
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+    if(fd >= 0)
+    {
+        if(ioctl(fd, SIOCGIFMTU, &ifr) >= 0)
+        {
+            mtu = ifr.ifr_mtu;
+        }
+
+        close_ex(fd);
+    }
+
+    return mtu;
+}
+
+/**
+ * Finds the regular UDP socket of an address, bound to it or to the wildcard of its family and port.
+ */
+
+static int
+server_xdp_listen_socket(const host_address *ha)
+{
+    int per_interface = server_context.udp_socket_count / server_context.udp_interface_count;
+    int wildcard = -1;
+
+    for(int i = 0; i < server_context.listen_count; ++i)
+    {
+        const host_address *listen = server_context.listen[i];
+
+        if((listen->version != ha->version) || (listen->port != ha->port))
+        {
+            continue;
+        }
+
+        if(host_address_equals(listen, ha))
+        {
+            return server_context.udp_socket[i * per_interface];
+        }
+
+        if(((listen->version == HOST_ADDRESS_IPV4) && (listen->ip.v4.value == INADDR_ANY)) ||
+           ((listen->version == HOST_ADDRESS_IPV6) && IPV6_ADDRESS_ALL0(listen->ip.v6)))
+        {
+            wildcard = server_context.udp_socket[i * per_interface];
+        }
+    }
+
+    return wildcard;
+}
+
+/**
+ * Finds the interface holding an address.
+ */
+
+static bool
+server_xdp_address_interface(const host_address *ha, struct ifaddrs *ifas, char *name)
+{
+    for(struct ifaddrs *ifa = ifas; ifa != NULL; ifa = ifa->ifa_next)
+    {
+        if(ifa->ifa_addr == NULL)
+        {
+            continue;
+        }
+
+        if(((ha->version == HOST_ADDRESS_IPV4) && (ifa->ifa_addr->sa_family == AF_INET) &&
+            (memcmp(&((struct sockaddr_in*)ifa->ifa_addr)->sin_addr, ha->ip.v4.bytes, 4) == 0)) ||
+           ((ha->version == HOST_ADDRESS_IPV6) && (ifa->ifa_addr->sa_family == AF_INET6) &&
+            (memcmp(&((struct sockaddr_in6*)ifa->ifa_addr)->sin6_addr, ha->ip.v6.bytes, 16) == 0)))
+        {
+            size_t len = MIN(strlen(ifa->ifa_name), IF_NAMESIZE - 1);
+            memcpy(name, ifa->ifa_name, len);
+            name[len] = '\0';
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static void
+server_xdp_interfaces_finalize()
+{
+    while(server_xdp_interfaces != NULL)
+    {
+        server_xdp_interface_s *intf = server_xdp_interfaces;
+        server_xdp_interfaces = intf->next;
+
+        // detaching first: the traffic goes back to the stack
+
+        if(intf->link_fd >= 0)
+        {
+            close_ex(intf->link_fd);
+        }
+
+        if(intf->workers != NULL)
+        {
+            for(int i = 0; i < intf->queue_count; ++i)
+            {
+                server_xdp_worker_finalize(intf->workers[i]);
+                free(intf->workers[i]);
+            }
+
+            free(intf->workers);
+        }
+
+        if(intf->prog_fd >= 0)
+        {
+            close_ex(intf->prog_fd);
+        }
+
+        if(intf->map_fd >= 0)
+        {
+            close_ex(intf->map_fd);
+        }
+
+        free(intf);
+    }
+
+    server_xdp_worker_count = 0;
+}
+
+bool
+server_xdp_supported()
+{
+    int fd = socket(AF_XDP, SOCK_RAW, 0);
+
+    if(fd < 0)
+    {
+        return FALSE;
+    }
+
+    close_ex(fd);
+
+    return TRUE;
+}
+
+ya_result
+server_xdp_context_start(host_address *addresses)
+{
+    ya_result ret = SUCCESS;
+
+    if((addresses == NULL) || server_xdp_context_done)
+    {
+        return SUCCESS;
+    }
+
+    server_xdp_context_done = TRUE;
+
+    struct ifaddrs *ifas;
+
+    if(getifaddrs(&ifas) < 0)
+    {
+        return ERRNO_ERROR;
+    }
+
+    for(host_address *ha = addresses; ha != NULL; ha = ha->next)
+    {
+        char name[IF_NAMESIZE];
+        int sockfd;
+
+        if((sockfd = server_xdp_listen_socket(ha)) < 0)
+        {
+            log_err("server-xdp: %{hostaddr} is not a listened address", ha);
+            ret = INVALID_STATE_ERROR;
+            break;
+        }
+
+        if(!server_xdp_address_interface(ha, ifas, name))
+        {
+            log_err("server-xdp: %{hostaddr} is not the address of an interface", ha);
+            ret = INVALID_STATE_ERROR;
+            break;
+        }
+
+        server_xdp_interface_s *intf;
+
+        for(intf = server_xdp_interfaces; intf != NULL; intf = intf->next)
+        {
+            if(strcmp(intf->name, name) == 0)
+            {
+                break;
+            }
+        }
+
+        if(intf == NULL)
+        {
+            MALLOC_OR_DIE(server_xdp_interface_s*, intf, sizeof(server_xdp_interface_s), XDPINTF_TAG);
+            ZEROMEMORY(intf, sizeof(server_xdp_interface_s));
+            memcpy(intf->name, name, IF_NAMESIZE);
+            intf->ifindex = if_nametoindex(name);
+            intf->queue_count = server_xdp_interface_queue_count(name);
+            intf->mtu = server_xdp_interface_mtu(name);
+            intf->node = sys_numa_interface_node(name);
+            intf->map_fd = -1;
+            intf->prog_fd = -1;
+            intf->link_fd = -1;
+            intf->next = server_xdp_interfaces;
+            server_xdp_interfaces = intf;
+        }
+
+        if(intf->address_count == SERVER_XDP_ADDRESS_MAX)
+        {
+            log_err("server-xdp: %s: more than %i addresses", name, SERVER_XDP_ADDRESS_MAX);
+            ret = INVALID_STATE_ERROR;
+            break;
+        }
+
+        server_xdp_address_s *a = &intf->address[intf->address_count++];
+        memcpy(a->ip, (ha->version == HOST_ADDRESS_IPV4)?ha->ip.v4.bytes:ha->ip.v6.bytes, (ha->version == HOST_ADDRESS_IPV4)?4:16);
+        a->port = ha->port;
+        a->version = ha->version;
+        a->sockfd = sockfd;
+
+        log_info("server-xdp: %{hostaddr} on %s (%i queues, mtu %i)", ha, name, intf->queue_count, intf->mtu);
+    }
+
+    freeifaddrs(ifas);
+
+    for(server_xdp_interface_s *intf = server_xdp_interfaces; (intf != NULL) && ISOK(ret); intf = intf->next)
+    {
+        if(FAIL(ret = server_xdp_program_load(intf)))
+        {
+            break;
+        }
+
+        MALLOC_OR_DIE(server_xdp_worker_s**, intf->workers, sizeof(server_xdp_worker_s*) * intf->queue_count, XDPWRKR_TAG);
+        ZEROMEMORY(intf->workers, sizeof(server_xdp_worker_s*) * intf->queue_count);
+
+        for(int i = 0; i < intf->queue_count; ++i)
+        {
+            server_xdp_worker_s *w;
+            MALLOC_OR_DIE(server_xdp_worker_s*, w, sizeof(server_xdp_worker_s), XDPWRKR_TAG);
+            ZEROMEMORY(w, sizeof(server_xdp_worker_s));
+            w->intf = intf;
+            w->fd = -1;
+            w->queue = i;
+            w->idx = server_xdp_worker_count++;
+            intf->workers[i] = w;
+
+            if(FAIL(ret = server_xdp_worker_init(w)))
+            {
+                log_err("server-xdp: %s queue %i: could not set the socket up: %r", intf->name, i, ret);
+                break;
+            }
+        }
+
+        if(ISOK(ret))
+        {
+            ret = server_xdp_program_attach(intf);
+        }
+    }
+
+    if(FAIL(ret))
+    {
+        server_xdp_interfaces_finalize();
+    }
+
+    return ret;
+}
+
+ya_result
+server_xdp_start()
+{
+    if(server_xdp_worker_count == 0)
+    {
+        return SUCCESS;
+    }
+
+    server_xdp_thread_pool = thread_pool_init_ex(server_xdp_worker_count, 1, "svrxdp");
+
+    if(server_xdp_thread_pool == NULL)
+    {
+        return THREAD_CREATION_ERROR;
+    }
+
+    for(server_xdp_interface_s *intf = server_xdp_interfaces; intf != NULL; intf = intf->next)
+    {
+        for(int i = 0; i < intf->queue_count; ++i)
+        {
+            ya_result ret;
+
+            if(FAIL(ret = thread_pool_enqueue_call(server_xdp_thread_pool, server_xdp_thread, intf->workers[i], NULL, "server-xdp")))
+            {
+                log_err("unable to schedule task : %r", ret);
+                return ret;
+            }
+        }
+    }
+
+    return SUCCESS;
+}
+
+void
+server_xdp_stop()
+{
+    if(server_xdp_thread_pool != NULL)
+    {
+        // the threads are waiting for at most a second
+
+        for(server_xdp_interface_s *intf = server_xdp_interfaces; intf != NULL; intf = intf->next)
+        {
+            for(int i = 0; i < intf->queue_count; ++i)
+            {
+                while(!intf->workers[i]->terminated)
+                {
+                    usleep(1000);
+                }
+            }
+        }
+
+        thread_pool_destroy(server_xdp_thread_pool);
+        server_xdp_thread_pool = NULL;
+    }
+
+    server_xdp_interfaces_finalize();
+
+    server_xdp_context_done = FALSE;
+}
+
+void
+server_xdp_statistics_add(server_statistics_t *sum)
+{
+    for(server_xdp_interface_s *intf = server_xdp_interfaces; intf != NULL; intf = intf->next)
+    {
+        for(int i = 0; i < intf->queue_count; ++i)
+        {
+            server_statistics_t *stats = &intf->workers[i]->statistics;
+
+            sum->input_loop_count += stats->input_loop_count;
+            sum->udp_output_size_total += stats->udp_output_size_total;
+            sum->udp_referrals_count += stats->udp_referrals_count;
+            sum->udp_input_count += stats->udp_input_count;
+            sum->udp_dropped_count += stats->udp_dropped_count;
+            sum->udp_queries_count += stats->udp_queries_count;
+#if HAS_RRL_SUPPORT
+            sum->rrl_slip += stats->rrl_slip;
+            sum->rrl_drop += stats->rrl_drop;
+#endif
+            for(u32 j = 0; j < SERVER_STATISTICS_ERROR_CODES_COUNT; j++)
+            {
+                sum->udp_fp[j] += stats->udp_fp[j];
+            }
+
+            server_statistics_node_add(sum, stats);
+        }
+    }
+}
+
+#else // SERVER_XDP_SUPPORT
+
+bool
+server_xdp_supported()
+{
+    return FALSE;
+}
+
+ya_result
+server_xdp_context_start(host_address *addresses)
+{
+    if(addresses != NULL)
+    {
+        log_err("AF_XDP is not supported on this system.");
+        return FEATURE_NOT_SUPPORTED;
+    }
+
+    return SUCCESS;
+}
+
+ya_result
+server_xdp_start()
+{
+    return SUCCESS;
+}
+
+void
+server_xdp_stop()
+{
+}
+
+void
+server_xdp_statistics_add(server_statistics_t *sum)
+{
+    (void)sum;
+}
+
+#endif // SERVER_XDP_SUPPORT
+
+/**
+ * @}
+ */
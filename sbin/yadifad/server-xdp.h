@@ -0,0 +1,91 @@
+/*------------------------------------------------------------------------------
+*
+* Copyright (c) 2011-2019, EURid vzw. All rights reserved.
+* The YADIFA TM software product is provided under the BSD 3-clause license:
+* 
+* Redistribution and use in source and binary forms, with or without 
+* modification, are permitted provided that the following conditions
+* are met:
+*
+*        * Redistributions of source code must retain the above copyright 
+*          notice, this list of conditions and the following disclaimer.
+*        * Redistributions in binary form must reproduce the above copyright 
+*          notice, this list of conditions and the following disclaimer in the 
+*          documentation and/or other materials provided with the distribution.
+*        * Neither the name of EURid nor the names of its contributors may be 
+*          used to endorse or promote products derived from this software 
+*          without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*------------------------------------------------------------------------------
+*
+*/
+
+/** @defgroup server Server
+ *  @ingroup yadifad
+ *  @brief AF_XDP fast path
+ *
+ *  UDP queries to the addresses of xdp-listen are taken from the NIC by an XDP program and answered by
+ *  dedicated threads, bypassing the kernel network stack.  Any other traffic goes through the stack.
+ *
+ *  It works alongside any network model.
+ *
+ * @{
+ */
+
+#pragma once
+
+#include <dnscore/host_address.h>
+
+#include "server.h"
+
+/**
+ * Tells if the system can run the AF_XDP fast path.
+ */
+
+bool server_xdp_supported();
+
+/**
+ * Sets up the AF_XDP sockets and attaches the XDP program to the interfaces of the addresses.
+ * Requires the privileges of the network administration, so it has to be called before they are dropped.
+ *
+ * @param addresses the addresses, each one has to be in the listen list
+ *
+ * @return an error code
+ */
+
+ya_result server_xdp_context_start(host_address *addresses);
+
+/**
+ * Starts the threads answering the queries.
+ */
+
+ya_result server_xdp_start();
+
+/**
+ * Waits for the threads to stop (they stop with the program), detaches the XDP programs and releases
+ * everything.
+ */
+
+void server_xdp_stop();
+
+/**
+ * Adds the counters of the AF_XDP threads to the statistics.
+ */
+
+void server_xdp_statistics_add(server_statistics_t *sum);
+
+/**
+ * @}
+ */
@@ -58,6 +58,7 @@
 #include <dnscore/thread_pool.h>
 #include <dnscore/ctrl-rfc.h>
 #include <dnscore/service.h>
+#include <dnscore/timems.h>
 
 logger_handle *g_server_logger;
 #define MODULE_MSG_HANDLE g_server_logger
@@ -68,11 +69,14 @@ logger_handle *g_server_logger;
 #include "poll-util.h"
 #include "server-mt.h"
 #include "server-rw.h"
+#include "server-uring.h"
+#include "server-xdp.h"
 #include "notify.h"
 #include "server_context.h"
 #include "axfr.h"
 #include "ixfr.h"
 #include "process_class_ch.h"
+#include "query_statistics.h"
 #if HAS_DYNUPDATE_SUPPORT
 #include "dynupdate_query_service.h"
 #endif
@@ -102,7 +106,7 @@ static bool server_statistics_initialised = FALSE;
 
 volatile int program_mode = SA_CONT; /** @note must be volatile */
 
-static struct server_desc_s server_type[2] =
+static struct server_desc_s server_type[3] =
 {
     {
         server_mt_context_init,
@@ -113,6 +117,11 @@ static struct server_desc_s server_type[2] =
         server_rw_context_init,
         server_rw_query_loop,
         "multithreaded deferred resolve"
+    },
+    {
+        server_uring_context_init,
+        server_uring_query_loop,
+        "io_uring"
     }
 };
 
@@ -241,6 +250,7 @@ server_process_tcp_task(zdb *database, message_data *mesg, u16 svr_sockfd)
         }
         
         mesg->received = received;
+        mesg->recv_ns = timens_monotonic();
         
 #ifdef DEBUG
 #if DUMP_TCP_RECEIVED_WIRE
@@ -264,7 +274,11 @@ server_process_tcp_task(zdb *database, message_data *mesg, u16 svr_sockfd)
                     {
                         case CLASS_IN:
                         {
-                            log_query(svr_sockfd, mesg);                                                        
+                            log_query(svr_sockfd, mesg);
+                            
+                            query_statistics_s *local_query_statistics = query_statistics_get();
+                            
+                            query_statistics_qtype_count(local_query_statistics, mesg->qtype);
 
                             if(mesg->qtype == TYPE_AXFR)
                             {
@@ -276,7 +290,7 @@ server_process_tcp_task(zdb *database, message_data *mesg, u16 svr_sockfd)
                                  * ACL/TSIG is not taken in account yet.
                                  */
 
-                                TCPSTATS(tcp_axfr_count++);
+                                TCPSTATS(tcp_axfr_count);
 
                                 return_code = axfr_process(mesg);
 
@@ -296,7 +310,7 @@ server_process_tcp_task(zdb *database, message_data *mesg, u16 svr_sockfd)
                                  * ACL/TSIG is not taken in account yet.
                                  */
 
-                                TCPSTATS(tcp_ixfr_count++);
+                                TCPSTATS(tcp_ixfr_count);
                                 return_code = ixfr_process(mesg);
 
     #ifdef DEBUG
@@ -310,23 +324,34 @@ server_process_tcp_task(zdb *database, message_data *mesg, u16 svr_sockfd)
                             log_debug("server_process_tcp query");
     #endif
 
-                            TCPSTATS(tcp_queries_count++);
+                            TCPSTATS(tcp_queries_count);
 
                             /*
                              * This query must go through the task channel.
                              */
 
+                            u64 lookup_ns = timens_monotonic();
+                            
                             database_query(database, mesg);
+                            
+                            u64 send_ns = timens_monotonic();
+                            
+                            histogram_record(&local_query_statistics->stage[QUERY_STATISTICS_LOOKUP], send_ns - lookup_ns);
 
     #ifdef DEBUG
                             log_debug("server_process_tcp write");
     #endif
 
                             tcp_send_message_data(mesg);
+                            
+                            u64 sent_ns = timens_monotonic();
+                            
+                            histogram_record(&local_query_statistics->stage[QUERY_STATISTICS_SEND], sent_ns - send_ns);
+                            histogram_record(&local_query_statistics->stage[QUERY_STATISTICS_LATENCY], sent_ns - mesg->recv_ns);
 
-                            TCPSTATS(tcp_referrals_count += mesg->referral);
-                            TCPSTATS(tcp_fp[mesg->status]++);
-                            TCPSTATS(tcp_output_size_total += mesg->send_length);
+                            TCPSTATS_ADD(tcp_referrals_count, mesg->referral);
+                            TCPSTATS(tcp_fp[mesg->status]);
+                            TCPSTATS_ADD(tcp_output_size_total, mesg->send_length);
 
                             break;
                         } // case query IN
@@ -334,7 +359,7 @@ server_process_tcp_task(zdb *database, message_data *mesg, u16 svr_sockfd)
                         {
                             log_query(svr_sockfd, mesg);
                             class_ch_process(mesg);
-                            TCPSTATS(tcp_fp[mesg->status]++);
+                            TCPSTATS(tcp_fp[mesg->status]);
                             tcp_send_message_data(mesg);
 
                             break;
@@ -343,7 +368,7 @@ server_process_tcp_task(zdb *database, message_data *mesg, u16 svr_sockfd)
                         {
 
                             message_make_error(mesg, FP_NOT_SUPP_CLASS);
-                            TCPSTATS(tcp_fp[FP_NOT_SUPP_CLASS]++);
+                            TCPSTATS(tcp_fp[FP_NOT_SUPP_CLASS]);
                             break;
                         }
                     } // query class
@@ -352,7 +377,7 @@ server_process_tcp_task(zdb *database, message_data *mesg, u16 svr_sockfd)
                 {
                     log_warn("query [%04hx] error %i : %r", ntohs(MESSAGE_ID(mesg->buffer)), mesg->status, return_code);
 
-                    TCPSTATS(tcp_fp[mesg->status]++);
+                    TCPSTATS(tcp_fp[mesg->status]);
                     
                     if(return_code == UNPROCESSABLE_MESSAGE && (g_config->server_flags & SERVER_FL_LOG_UNPROCESSABLE))
                     {
@@ -370,7 +395,7 @@ server_process_tcp_task(zdb *database, message_data *mesg, u16 svr_sockfd)
                     }
                     else
                     {
-                        TCPSTATS(tcp_dropped_count++);
+                        TCPSTATS(tcp_dropped_count);
                         tcp_set_agressive_close(mesg->sockfd, 1);
                     }
                 }
@@ -391,14 +416,14 @@ server_process_tcp_task(zdb *database, message_data *mesg, u16 svr_sockfd)
                         {
                             /// @todo 20140521 edf -- notify on TCP
 
-                            TCPSTATS(tcp_notify_input_count++);
+                            TCPSTATS(tcp_notify_input_count);
                             break;
                         }
                         default:
                         {
 
                             message_make_error(mesg, FP_NOT_SUPP_CLASS);
-                            TCPSTATS(tcp_fp[FP_NOT_SUPP_CLASS]++);
+                            TCPSTATS(tcp_fp[FP_NOT_SUPP_CLASS]);
                             break;
                         }
                     } // notify class
@@ -407,7 +432,7 @@ server_process_tcp_task(zdb *database, message_data *mesg, u16 svr_sockfd)
                 {
                     log_warn("notify [%04hx] error %i : %r", ntohs(MESSAGE_ID(mesg->buffer)), mesg->status, return_code);
 
-                    TCPSTATS(tcp_fp[mesg->status]++);
+                    TCPSTATS(tcp_fp[mesg->status]);
 #ifdef DEBUG
                     log_memdump_ex(MODULE_MSG_HANDLE, MSG_DEBUG5, mesg->buffer, mesg->received, 16, OSPRINT_DUMP_ALL);
 #endif
@@ -422,7 +447,7 @@ server_process_tcp_task(zdb *database, message_data *mesg, u16 svr_sockfd)
                     }
                     else
                     {
-                        TCPSTATS(tcp_dropped_count++);
+                        TCPSTATS(tcp_dropped_count);
                         tcp_set_agressive_close(mesg->sockfd, 1);
                     }
                 }
@@ -452,7 +477,7 @@ server_process_tcp_task(zdb *database, message_data *mesg, u16 svr_sockfd)
 
 #if HAS_DYNUPDATE_SUPPORT
                             
-                            TCPSTATS(tcp_updates_count++);
+                            TCPSTATS(tcp_updates_count);
 
                             log_info("update (%04hx) %{dnsname} %{dnstype} (%{sockaddr})",
                                     ntohs(MESSAGE_ID(mesg->buffer)),
@@ -463,12 +488,12 @@ server_process_tcp_task(zdb *database, message_data *mesg, u16 svr_sockfd)
                             if(ISOK(database_update(database, mesg)))
                             {
                                 tcp_send_message_data(mesg);
-                                TCPSTATS(tcp_fp[mesg->status]++);
+                                TCPSTATS(tcp_fp[mesg->status]);
                             }
 #else
                             message_make_error(mesg, FP_FEATURE_DISABLED);
                             tcp_send_message_data(mesg);
-                            TCPSTATS(tcp_fp[FP_FEATURE_DISABLED]++);
+                            TCPSTATS(tcp_fp[FP_FEATURE_DISABLED]);
 #endif
 
                             break;
@@ -477,7 +502,7 @@ server_process_tcp_task(zdb *database, message_data *mesg, u16 svr_sockfd)
                         {
 
                             message_make_error(mesg, FP_NOT_SUPP_CLASS);
-                            TCPSTATS(tcp_fp[FP_NOT_SUPP_CLASS]++);
+                            TCPSTATS(tcp_fp[FP_NOT_SUPP_CLASS]);
                             break;
                         }
                     } // update class
@@ -486,7 +511,7 @@ server_process_tcp_task(zdb *database, message_data *mesg, u16 svr_sockfd)
                 {
                     log_warn("update [%04hx] error %i : %r", ntohs(MESSAGE_ID(mesg->buffer)), mesg->status, return_code);
 
-                    TCPSTATS(tcp_fp[mesg->status]++);
+                    TCPSTATS(tcp_fp[mesg->status]);
 #ifdef DEBUG
                     log_memdump_ex(MODULE_MSG_HANDLE, MSG_DEBUG5, mesg->buffer, mesg->received, 16, OSPRINT_DUMP_ALL);
 #endif
@@ -501,7 +526,7 @@ server_process_tcp_task(zdb *database, message_data *mesg, u16 svr_sockfd)
                     }
                     else
                     {
-                        TCPSTATS(tcp_dropped_count++);
+                        TCPSTATS(tcp_dropped_count);
                         tcp_set_agressive_close(mesg->sockfd, 1);
                     }
                 }
@@ -542,12 +567,12 @@ server_process_tcp_task(zdb *database, message_data *mesg, u16 svr_sockfd)
                     
                     if(mesg->status != FP_PACKET_DROPPED)
                     {
-                        TCPSTATS(tcp_fp[mesg->status]++);
+                        TCPSTATS(tcp_fp[mesg->status]);
                         tcp_send_message_data(mesg);
                     }
                     else
                     {
-                        TCPSTATS(tcp_dropped_count++);
+                        TCPSTATS(tcp_dropped_count);
                         tcp_set_agressive_close(mesg->sockfd, 1);
                     }
                 }
@@ -555,7 +580,7 @@ server_process_tcp_task(zdb *database, message_data *mesg, u16 svr_sockfd)
                 {
                     log_warn("ctrl [%04hx] error %i : %r", ntohs(MESSAGE_ID(mesg->buffer)), mesg->status, return_code);
 
-                    TCPSTATS(tcp_fp[mesg->status]++);
+                    TCPSTATS(tcp_fp[mesg->status]);
 #ifdef DEBUG
                    log_memdump_ex(MODULE_MSG_HANDLE, MSG_DEBUG5, mesg->buffer, mesg->received, 16, OSPRINT_DUMP_ALL);
 #endif
@@ -572,13 +597,13 @@ server_process_tcp_task(zdb *database, message_data *mesg, u16 svr_sockfd)
                         {
                             /// @todo 20150428 edf -- handle this more nicely
                             
-                            TCPSTATS(tcp_dropped_count++);
+                            TCPSTATS(tcp_dropped_count);
                             tcp_set_agressive_close(mesg->sockfd, 1);
                         }
                     }
                     else
                     {
-                        TCPSTATS(tcp_dropped_count++);
+                        TCPSTATS(tcp_dropped_count);
                         tcp_set_agressive_close(mesg->sockfd, 1);
                     }
                 }
@@ -601,7 +626,7 @@ server_process_tcp_task(zdb *database, message_data *mesg, u16 svr_sockfd)
                 }
                 else
                 {
-                    TCPSTATS(tcp_dropped_count++);
+                    TCPSTATS(tcp_dropped_count);
                     tcp_set_agressive_close(mesg->sockfd, 1);
                 }
             }
@@ -711,10 +736,66 @@ server_process_tcp_thread(void* parm)
     return NULL;
 }
 
+/**
+ * Schedules the processing of an accepted connection.
+ * Takes ownership of the socket.
+ */
+
+static void
+server_process_tcp_schedule(zdb *database, int svr_sockfd, int sockfd, const socketaddress *addr, socklen_t addr_len, int current_tcp)
+{
+    server_process_tcp_thread_parm* parm;
+    
+    if(addr_len > MAX(sizeof(struct sockaddr_in),sizeof(struct sockaddr_in6)))
+    {
+        log_err("tcp: addr_len = %i, max allowed is %i", addr_len, MAX(sizeof(struct sockaddr_in),sizeof(struct sockaddr_in6)));
+
+        close_ex(sockfd);
+
+        return;
+    }
+    
+    MALLOC_OR_DIE(server_process_tcp_thread_parm*, parm, sizeof(server_process_tcp_thread_parm), TPROCPRM_TAG);
+    parm->database = database;
+    parm->sockfd = sockfd;
+    memcpy(&parm->sa, addr, addr_len);
+    parm->addr_len = addr_len;
+    parm->svr_sockfd = svr_sockfd;
+    
+    if(poll_add(parm->sockfd))
+    {
+        log_debug("tcp: using slot %d/%d", current_tcp + 1 , g_config->max_tcp_queries);
+
+        /*
+         * And here is the AXFR change: if it's an AXFR, then we need to ensure that
+         * _ we are allowed (TSIG, time limit between two AXFR "milestones", ...)
+         * _ we have the AXFR file ready and if not, fork to generate it
+         *
+         * The thread is launched anyway and waits for the file with the right serial to be generated.
+         * When the file is finally available, it is sent to the caller.
+         *
+         * If it's not an AXFR, then we do as ever.
+         */
+
+#ifdef DEBUG
+        log_debug("server_process_tcp_thread_start scheduling job");
+#endif
+
+        thread_pool_enqueue_call(server_tcp_thread_pool, server_process_tcp_thread, parm, NULL, "server_process_tcp_thread_start");
+    }
+    else
+    {
+        log_debug("server_process_tcp_thread_start tcp overflow");
+        
+        close_ex(parm->sockfd);
+        free(parm);
+    }
+}
+
 void
 server_process_tcp(zdb *database, int sockfd)
 {
-    server_process_tcp_thread_parm* parm;
+    int tcpfd;
     socklen_t addr_len;
     socketaddress addr;
     addr_len = sizeof(addr);
@@ -750,78 +831,91 @@ server_process_tcp(zdb *database, int sockfd)
         tcp_set_abortive_close(rejected_fd);
         close_ex(rejected_fd);
 
-        TCPSTATS(tcp_overflow_count++);
+        TCPSTATS(tcp_overflow_count);
         
         return;
     }
 
-    TCPSTATS(tcp_input_count++);
-
-    MALLOC_OR_DIE(server_process_tcp_thread_parm*, parm, sizeof(server_process_tcp_thread_parm), TPROCPRM_TAG);
-    parm->database = database;
+    TCPSTATS(tcp_input_count);
 
     /** @todo 20120706 edf -- test: timeout */
 
     /* don't test -1, test < 0 instead (test + js instead of add + stall + jz */
-    while((parm->sockfd = accept(sockfd, &addr.sa, &addr_len)) < 0)
+    while((tcpfd = accept(sockfd, &addr.sa, &addr_len)) < 0)
     {
         int err = errno;
 
         if(err != EINTR)
         {
             log_err("tcp: accept returned %r", MAKE_ERRNO_ERROR(err));
-            free(parm);
             return;
         }
     }
+    
+    server_process_tcp_schedule(database, sockfd, tcpfd, &addr, addr_len, current_tcp);
 
-    if(addr_len > MAX(sizeof(struct sockaddr_in),sizeof(struct sockaddr_in6)))
-    {
-        log_err("tcp: addr_len = %i, max allowed is %i", addr_len, MAX(sizeof(struct sockaddr_in),sizeof(struct sockaddr_in6)));
+#ifdef DEBUG
+    log_debug("server_process_tcp_thread_start end");
+#endif
+}
 
-        close_ex(parm->sockfd);
+void
+server_process_tcp_accepted(zdb *database, int svr_sockfd, int sockfd)
+{
+    socklen_t addr_len;
+    socketaddress addr;
+    addr_len = sizeof(addr);
+    
+    int current_tcp = poll_update();
+    
+    if(current_tcp >= g_config->max_tcp_queries)
+    {
+        log_info("tcp: rejecting: already %d/%d handled", current_tcp, g_config->max_tcp_queries);
         
-        free(parm);
+        tcp_set_abortive_close(sockfd);
+        close_ex(sockfd);
 
+        TCPSTATS(tcp_overflow_count);
+        
         return;
     }
-
-    memcpy(&parm->sa, &addr, addr_len);
-    parm->addr_len = addr_len;
-    parm->svr_sockfd = sockfd;
     
-    if(poll_add(parm->sockfd))
+    TCPSTATS(tcp_input_count);
+    
+    if(getpeername(sockfd, &addr.sa, &addr_len) < 0)
     {
-        log_debug("tcp: using slot %d/%d", current_tcp + 1 , g_config->max_tcp_queries);
+        log_err("tcp: getpeername returned %r", ERRNO_ERROR);
+        
+        close_ex(sockfd);
+        
+        return;
+    }
+    
+    server_process_tcp_schedule(database, svr_sockfd, sockfd, &addr, addr_len, current_tcp);
+}
 
-        /*
-         * And here is the AXFR change: if it's an AXFR, then we need to ensure that
-         * _ we are allowed (TSIG, time limit between two AXFR "milestones", ...)
-         * _ we have the AXFR file ready and if not, fork to generate it
-         *
-         * The thread is launched anyway and waits for the file with the right serial to be generated.
-         * When the file is finally available, it is sent to the caller.
-         *
-         * If it's not an AXFR, then we do as ever.
-         */
+int
+server_worker_cpu(int slot, int nic_node)
+{
+    return sys_numa_node_cpu(nic_node, g_config->thread_affinity_base + slot * g_config->thread_affinity_multiplier);
+}
 
-#ifdef DEBUG
-        log_debug("server_process_tcp_thread_start scheduling job");
-#endif
+void
+server_statistics_set_node(server_statistics_t *stats, int nic_node)
+{
+    stats->node = sys_numa_current_node();
+    stats->remote = (nic_node >= 0) && (nic_node != stats->node);
+}
 
-        thread_pool_enqueue_call(server_tcp_thread_pool, server_process_tcp_thread, parm, NULL, "server_process_tcp_thread_start");
-    }
-    else
+void
+server_statistics_node_add(server_statistics_t *sum, const server_statistics_t *stats)
+{
+    sum->udp_node_input_count[stats->node] += stats->udp_input_count;
+
+    if(stats->remote)
     {
-        log_debug("server_process_tcp_thread_start tcp overflow");
-        
-        close_ex(parm->sockfd);
-        free(parm);
+        sum->udp_remote_input_count += stats->udp_input_count;
     }
-
-#ifdef DEBUG
-    log_debug("server_process_tcp_thread_start end");
-#endif
 }
 
 /*******************************************************************************************************************
@@ -844,6 +938,11 @@ server_init()
     log_info("using %i working modules per TCP interface (%i threads per TCP module)", server_context.tcp_unit_per_interface, server_context.thread_per_tcp_worker_count);
     
     ret = server_context_start(g_config->listen);
+
+    if(ISOK(ret))
+    {
+        ret = server_xdp_context_start(g_config->xdp_listen);
+    }
         
     return ret;
 }
@@ -902,7 +1001,7 @@ server_run()
     
     if(server_tcp_thread_pool == NULL && g_config->max_tcp_queries > 0)
     {
-        server_tcp_thread_pool = thread_pool_init_ex(g_config->max_tcp_queries, g_config->max_tcp_queries * 2, "svrtcp");
+        server_tcp_thread_pool = thread_pool_init_work_stealing(g_config->max_tcp_queries, g_config->max_tcp_queries * 2, "svrtcp");
         
         if(server_tcp_thread_pool == NULL)
         {
@@ -937,8 +1036,17 @@ server_run()
     /* Go to work */
         
     log_debug("thread count by address: %i", g_config->thread_count_by_address);
+
+    ya_result ret;
+
+    if(FAIL(ret = server_xdp_start()))
+    {
+        log_err("could not start the AF_XDP threads: %r", ret);
+    }
     
     server_run_loop();
+
+    server_xdp_stop();
     
 
     
@@ -60,6 +60,7 @@ extern volatile int program_mode;
 #endif
 
 #include <dnscore/mutex.h>
+#include <dnscore/sys_numa.h>
 
 #define SOA_MIN_REFRESH 60
 #define SOA_MIN_RETRY   60
@@ -142,9 +143,24 @@ struct server_statistics_t
     volatile u64 udp_fp[SERVER_STATISTICS_ERROR_CODES_COUNT];
     
     volatile u64 tcp_fp[SERVER_STATISTICS_ERROR_CODES_COUNT];
+    
+    /* numa, by node of the UDP workers, only in the sum */
+    
+    volatile u64 udp_node_input_count[SYS_NUMA_NODE_COUNT_MAX];
+    volatile u64 udp_remote_input_count;    // received by workers not on the node of their network interface
+    
+    /* numa, of the UDP worker */
+    
+    s8 node;
+    bool remote;
 };
 
-#define TCPSTATS(__field__) mutex_lock(&server_statistics.mtx);server_statistics. __field__ ;mutex_unlock(&server_statistics.mtx)
+/*
+ * The TCP counters are shared by all the TCP threads: they are updated atomically.
+ */
+
+#define TCPSTATS_ADD(__field__, __value__) __sync_fetch_and_add(&server_statistics. __field__, (__value__))
+#define TCPSTATS(__field__) TCPSTATS_ADD(__field__, 1)
 
 #ifndef SERVER_C_
 extern server_statistics_t server_statistics;
@@ -157,6 +173,36 @@ void tcp_send_message_data(message_data* mesg);
 
 void server_process_tcp(zdb *database, int sockfd);
 
+/**
+ * Processes a connection already accepted on the listening socket svr_sockfd.
+ * Takes ownership of sockfd.
+ */
+
+void server_process_tcp_accepted(zdb *database, int svr_sockfd, int sockfd);
+
+/**
+ * Returns the CPU for a worker thread: thread_affinity_base + slot * thread_affinity_multiplier, taken among the CPUs
+ * of the node of its network interface when it is known.
+ * 
+ * @param slot the index of the thread
+ * @param nic_node the node of the network interface, or -1
+ */
+
+int server_worker_cpu(int slot, int nic_node);
+
+/**
+ * Records in the statistics of a worker the node it is running on and if it is remote from its network interface.
+ * To be called by the worker once its affinity has been set.
+ */
+
+void server_statistics_set_node(server_statistics_t *stats, int nic_node);
+
+/**
+ * Adds the input of a worker to the counters by node of the sum.
+ */
+
+void server_statistics_node_add(server_statistics_t *sum, const server_statistics_t *stats);
+
 void log_msghdr(logger_handle* hndl, u32 level, struct msghdr *hdr);
 
 /**
@@ -57,6 +57,7 @@
 #include <dnscore/ptr_vector.h>
 
 #include <dnscore/fdtools.h>
+#include <dnscore/sys_numa.h>
 
 #include "server_context.h"
 
@@ -193,6 +194,20 @@ server_context_append_socket_name(char *buffer, u16 s)
 
 /*----------------------------------------------------------------------------*/
 
+int
+server_context_socket_node(int sockfd)
+{
+    for(int i = 0; i < server_context.udp_socket_count; ++i)
+    {
+        if(server_context.udp_socket[i] == sockfd)
+        {
+            return server_context.udp_socket_node[i];
+        }
+    }
+    
+    return -1;
+}
+
 /** \brief Closes all sockets and remove pid file
  *
  *  @param[in] config
@@ -443,6 +458,8 @@ server_context_start(host_address *interfaces)
     assert(server_context.udp_socket_count > 0);
     MALLOC_OR_DIE(int*, server_context.udp_socket, sizeof(int) * server_context.udp_socket_count, SCTXSOCK_TAG);
     memset(server_context.udp_socket, 0xff, sizeof(int) * server_context.udp_socket_count);
+    MALLOC_OR_DIE(int*, server_context.udp_socket_node, sizeof(int) * server_context.udp_socket_count, SCTXSOCK_TAG);
+    memset(server_context.udp_socket_node, 0xff, sizeof(int) * server_context.udp_socket_count);
     
     server_context.tcp_socket_count = server_context.tcp_interface_count * server_context.tcp_unit_per_interface;
     //if(server_context.reuse) server_context.tcp_socket_count *= server_context.tcp_unit_per_interface;
@@ -473,6 +490,12 @@ server_context_start(host_address *interfaces)
         // udp
         
         int total_udp_socket_count_for_interface = server_context.udp_socket_count / server_context.udp_interface_count;
+        int udp_node = sys_numa_address_node((struct sockaddr*)udp_addr->ai_addr);
+        
+        if(udp_node >= 0)
+        {
+            log_info("UDP interface %{sockaddr} is on NUMA node %i", udp_addr->ai_addr, udp_node);
+        }
         
         for(int n = 0; n < total_udp_socket_count_for_interface; ++n)
         {
@@ -481,6 +504,7 @@ server_context_start(host_address *interfaces)
             if(ISOK(sockfd = server_context_new_socket(udp_addr, SOCK_DGRAM, server_context.reuse)))
             {                                
                 server_context_set_socket_name(sockfd, (struct sockaddr*)udp_addr->ai_addr);
+                server_context.udp_socket_node[udp_sockfd_idx] = udp_node;
                 server_context.udp_socket[udp_sockfd_idx++] = sockfd;                
                 
                 //intf->udp.sockfd = sockfd;
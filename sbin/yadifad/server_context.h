@@ -104,12 +104,13 @@ struct server_context_s
     int tcp_interface_count;
     //
     int *udp_socket; // sorted by interface
+    int *udp_socket_node; // NUMA node of the network interface of each UDP socket, -1 if not known
     int udp_socket_count;
     //
     int *tcp_socket;
     int tcp_socket_count;
     
-    // the fields below have to be set by the network model setup in server-mt.c or server-rw.c
+    // the fields below have to be set by the network model setup in server-mt.c, server-rw.c or server-uring.c
     
     int udp_unit_per_interface; // = udp_socket_count / listen_count
     int tcp_unit_per_interface; // = tcp_socket_count / listen_count
@@ -119,7 +120,7 @@ struct server_context_s
     unsigned int reuse:1,ready:1;
 };
 
-#define SERVER_CONTEXT_INITIALISER {NULL, 0, NULL, 0, NULL, 0, NULL, 0, NULL, 0,  0, 0, 1, 1, 0, 0}
+#define SERVER_CONTEXT_INITIALISER {NULL, 0, NULL, 0, NULL, 0, NULL, NULL, 0, NULL, 0,  0, 0, 1, 1, 0, 0}
 
 #ifndef SERVER_CONTEXT_C
 extern server_context_s server_context;
@@ -151,6 +152,16 @@ int server_context_start(host_address *interfaces);
     
 u32 server_context_append_socket_name(char *buffer, u16 s);
 
+/**
+ * Returns the NUMA node of the network interface of a UDP socket.
+ * 
+ * @param sockfd the UDP socket
+ * 
+ * @return the node, -1 if it is not known
+ */
+
+int server_context_socket_node(int sockfd);
+
 /** \brief Closes all sockets and remove pid file
  *
  *  @param[in] config
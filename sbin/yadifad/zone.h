@@ -332,6 +332,12 @@ zone_is_drop_before_load(zone_desc_s *zone_desc)
     return (zone_desc->flags & ZONE_FLAG_DROP_BEFORE_LOAD) != 0;
 }
 
+static inline bool
+zone_is_incremental_reload(zone_desc_s *zone_desc)
+{
+    return (zone_desc->flags & ZONE_FLAG_INCREMENTAL_RELOAD) != 0;
+}
+
 static inline bool
 zone_rrsig_nsupdate_allowed(zone_desc_s *zone_desc)
 {
@@ -95,6 +95,7 @@ extern "C" {
 #define     ZONE_FLAG_TRUE_MULTIMASTER            16        // drops a zone whenever changing the master
 #define     ZONE_FLAG_DROP_CURRENT_ZONE_ON_LOAD   32        // only triggered while changing the true master: the current zone will be dropped
 #define     ZONE_FLAG_RRSIG_NSUPDATE_ALLOWED      64        // allows to push a signature with an update
+#define     ZONE_FLAG_INCREMENTAL_RELOAD         128        // a reload of the file is applied as an update of the zone
     
 // status flags
 // iIclLMUdDzZaAsSeERxX#---T---ur/!